@@ -39,6 +39,7 @@ icam_cost_func::icam_cost_func( const vil_image_view<float>& source_img,
 #endif
   use_gradient_ = false;
   vnl_least_squares_function::init(dt_.n_params(), dest_samples_.size());
+  dt_.rays(dest_image_.ni(), dest_image_.nj(), rays_);
 }
 
 //: The main function.
@@ -153,21 +154,19 @@ joint_probability(vnl_vector_fixed<double, 3> rodrigues,
   pr[0]=rodrigues[0];   pr[1]=rodrigues[1];   pr[2]=rodrigues[2];
   pr[3]=trans.x();   pr[4]=trans.y();   pr[5]=trans.z();
   dt_.set_params(pr);
-  vnl_vector<double> from_samples, from_mask;
-  icam_sample::sample(dest_image_.ni(), dest_image_.nj(), source_image_,
-                      dt_, from_samples, from_mask, n_samples_);
+  icam_sample::sample(source_image_, dt_, rays_, from_samples_, from_mask_, n_samples_);
 
   #if 0
   std::cout << "Native produced ";
   std::cout << "mapped/dest/mask samples\n";
   int cent = dest_samples_.size()/2-(dest_image_.ni()-2)/2;
   for (int i = -10; i<=10; ++i) {
-    std::cout << from_samples[i+cent] << ' '
+    std::cout << from_samples_[i+cent] << ' '
              << dest_samples_[i+cent] << ' '
-             << 50.0f*from_mask[i+cent] << '\n';
+             << 50.0f*from_mask_[i+cent] << '\n';
   }
 #endif
-  return joint_probability(from_samples, from_mask);
+  return joint_probability(from_samples_, from_mask_);
 }
 
 vbl_array_2d<double>
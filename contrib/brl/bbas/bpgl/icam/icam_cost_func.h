@@ -103,6 +103,10 @@ class icam_cost_func : public vnl_least_squares_function
   vil_image_view<float> dest_image_;
   vnl_vector<double> dest_samples_;
   icam_depth_transform dt_;
+  //: the rays of the destination pixels, computed once; only the rotation and translation change in a search
+  icam_depth_rays rays_;
+  //: mapped source samples and their mask, kept to avoid an allocation per evaluation
+  vnl_vector<double> from_samples_, from_mask_;
   unsigned max_samples_;
   unsigned n_samples_;
   unsigned nbins_;
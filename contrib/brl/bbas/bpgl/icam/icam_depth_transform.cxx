@@ -3,6 +3,10 @@
 #include <vnl/vnl_inverse.h>
 #include <vnl/vnl_vector_fixed.h>
 #include <vnl/vnl_numeric_traits.h>
+#include <vxl_config.h>
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 
 void icam_depth_transform::cache_k()
 {
@@ -162,6 +166,74 @@ bool icam_depth_transform::transform(double from_u, double from_v,
   return true;
 }
 
+void icam_depth_transform::rays(unsigned ni, unsigned nj, icam_depth_rays& rays) const
+{
+  rays.ni = ni;  rays.nj = nj;
+  unsigned n = (ni-2)*(nj-2);
+  rays.fw0.resize(n);  rays.fw1.resize(n);  rays.zinv.resize(n);
+  float mval = vnl_numeric_traits<float>::maxval;
+  unsigned dni = depth_.ni(), dnj = depth_.nj();
+  unsigned index = 0;
+  for (unsigned j = 1; j<nj-1; ++j)
+    for (unsigned i = 1; i<ni-1; ++i, ++index) {
+      rays.fw0[index] = k00_*static_cast<float>(i)+ k02_;
+      rays.fw1[index] = k11_*static_cast<float>(j)+ k12_;
+      float Zinv = (i<dni && j<dnj) ? inv_depth_(i,j) : mval;
+      rays.zinv[index] = Zinv==mval ? 0.0f : Zinv;
+    }
+}
+
+void icam_depth_transform::transform(icam_depth_rays const& rays, unsigned first, unsigned n,
+                                     float* to_u, float* to_v) const
+{
+  float const* fw0 = &rays.fw0[first];
+  float const* fw1 = &rays.fw1[first];
+  float const* zinv = &rays.zinv[first];
+  float tx = static_cast<float>(trans_.x()), ty = static_cast<float>(trans_.y()),
+        tz = static_cast<float>(trans_.z());
+  float fl = static_cast<float>(to_fl_), pu = static_cast<float>(to_pu_),
+        pv = static_cast<float>(to_pv_);
+  unsigned k = 0;
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+  // four rays at a time, with the operations of the scalar loop below in the same order
+  const __m128 zero = _mm_setzero_ps(), none = _mm_set1_ps(-1.0f), min_den = _mm_set1_ps(1e-6f);
+  const __m128 vtx = _mm_set1_ps(tx), vty = _mm_set1_ps(ty), vtz = _mm_set1_ps(tz);
+  const __m128 vfl = _mm_set1_ps(fl), vpu = _mm_set1_ps(pu), vpv = _mm_set1_ps(pv);
+  for (; k+4<=n; k+=4) {
+    __m128 z = _mm_loadu_ps(zinv+k), f0 = _mm_loadu_ps(fw0+k), f1 = _mm_loadu_ps(fw1+k);
+    __m128 t0 = _mm_mul_ps(z, vtx), t1 = _mm_mul_ps(z, vty), t2 = _mm_mul_ps(z, vtz);
+    __m128 den = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r20_), f0),
+                                                  _mm_mul_ps(_mm_set1_ps(r21_), f1)),
+                                       _mm_set1_ps(r22_)), t2);
+    __m128 valid = _mm_and_ps(_mm_cmpgt_ps(z, zero), _mm_cmpge_ps(den, min_den));
+    den = _mm_div_ps(_mm_set1_ps(1.0f), den);
+    __m128 ut = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r00_), f0),
+                                                            _mm_mul_ps(_mm_set1_ps(r01_), f1)),
+                                                 _mm_set1_ps(r02_)), t0), den);
+    __m128 vt = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(r10_), f0),
+                                                            _mm_mul_ps(_mm_set1_ps(r11_), f1)),
+                                                 _mm_set1_ps(r12_)), t1), den);
+    __m128 u = _mm_add_ps(_mm_mul_ps(ut, vfl), vpu), v = _mm_add_ps(_mm_mul_ps(vt, vfl), vpv);
+    _mm_storeu_ps(to_u+k, _mm_or_ps(_mm_and_ps(valid, u), _mm_andnot_ps(valid, none)));
+    _mm_storeu_ps(to_v+k, _mm_or_ps(_mm_and_ps(valid, v), _mm_andnot_ps(valid, none)));
+  }
+#endif
+  for (; k<n; ++k) {
+    float z = zinv[k];
+    float t0 = z*tx, t1 = z*ty, t2 = z*tz;
+    float den = r20_*fw0[k] + r21_*fw1[k] + r22_+ t2;
+    if (!(z>0.0f) || den<1e-6f) {
+      to_u[k] = -1.0f; to_v[k] = -1.0f;
+      continue;
+    }
+    den = 1.0f/den;
+    float ut = (r00_*fw0[k] + r01_*fw1[k] +r02_ + t0)*den;
+    float vt = (r10_*fw0[k] + r11_*fw1[k] +r12_ + t1)*den;
+    to_u[k] = ut*fl + pu;
+    to_v[k] = vt*fl + pv;
+  }
+}
+
 void icam_depth_transform::set_params(vnl_vector<double> const& params)
 {
   vnl_vector<double> unscl_params = element_quotient(params, scale_factors_);
@@ -39,6 +39,7 @@
 //   None
 // \endverbatim
 
+#include <vector>
 #include <vsl/vsl_binary_io.h>
 #include <vgl/algo/vgl_rotation_3d.h>
 #include <vgl/vgl_vector_3d.h>
@@ -47,6 +48,16 @@
 #include <vnl/vnl_vector.h>
 #include <vil/vil_image_view.h>
 
+//: The rotation independent part of icam_depth_transform::transform() for the interior pixels of an image
+// For the pixels (i,j), 1<=i<ni-1, 1<=j<nj-1, in the order icam_sample scans them,
+// the pixel position with the inverse calibration applied and the inverse depth;
+// zinv is 0 where the depth is not valid.
+struct icam_depth_rays
+{
+  unsigned ni, nj;
+  std::vector<float> fw0, fw1, zinv;
+};
+
 class icam_depth_transform
 {
  public:
@@ -108,6 +119,14 @@ class icam_depth_transform
                  vgl_point_2d<double>& to_p ) const
   { double u, v; bool r = transform(from_p.x(), from_p.y(), u, v); to_p.set(u,v); return r; }
 
+  //: the rays of the interior pixels of an ni x nj image; they do not change with the rotation and translation
+  void rays(unsigned ni, unsigned nj, icam_depth_rays& rays) const;
+
+  //: transform n rays starting at index first, as transform() does but in single precision.
+  //  Rays that do not map to a point in front of the camera get to_u = to_v = -1.
+  void transform(icam_depth_rays const& rays, unsigned first, unsigned n,
+                 float* to_u, float* to_v) const;
+
   //: support for cost function
   unsigned n_params() {if (adjust_to_fl_)return 7; return 6;}
 
@@ -20,6 +20,7 @@
 #include <icam/icam_depth_trans_pyramid.h>
 #include <icam/icam_sample.h>
 #include <vpgl/algo/vpgl_ray.h>
+#include <vpl/vpl_parallel_for.h>
 
 #include <vil/vil_image_view.h>
 
@@ -58,13 +59,78 @@ static bool smallest_local_minima(vbl_array_3d<double> const& in,
   return found_minima;
 }
 
+//: Evaluates the cost of a list of rotations; each thread has its own copy of the cost function and its sample buffers
+class icam_rotation_cost_body : public vpl_parallel_for_body
+{
+ public:
+  icam_rotation_cost_body(icam_cost_func const& cost_fn, unsigned n_threads,
+                          std::vector<vnl_vector_fixed<double, 3> > const& rods,
+                          vgl_vector_3d<double> const& trans,
+                          double min_allowed_overlap)
+  : cost(rods.size()), frac(rods.size()), cost_fns_(n_threads, cost_fn),
+    rods_(rods), trans_(trans), min_allowed_overlap_(min_allowed_overlap) {}
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    icam_cost_func& cf = cost_fns_[thread_id];
+    for (unsigned k = begin; k<end; ++k) {
+      cost[k] = cf.entropy_diff(rods_[k], trans_, min_allowed_overlap_);
+      frac[k] = cf.frac_samples();
+    }
+  }
+
+  std::vector<double> cost;
+  std::vector<double> frac;
+
+ private:
+  std::vector<icam_cost_func> cost_fns_;
+  std::vector<vnl_vector_fixed<double, 3> > const& rods_;
+  vgl_vector_3d<double> trans_;
+  double min_allowed_overlap_;
+};
+
+//: The rotation of smallest cost in the list, evaluated on several threads.
+//  The list is reduced in order, so the result is the one of a serial scan.
+//  If \p progress, a dot is printed for every 10 rotations.
+static bool min_cost_rotation(icam_cost_func const& cost_fn,
+                              std::vector<vnl_vector_fixed<double, 3> > const& rods,
+                              vgl_vector_3d<double> const& trans,
+                              double min_allowed_overlap,
+                              unsigned num_threads,
+                              vnl_vector_fixed<double, 3>& min_rod,
+                              double& min_cost,
+                              double& min_overlap_fraction,
+                              bool progress = false)
+{
+  unsigned nt = vpl_parallel_for_num_threads(num_threads);
+  icam_rotation_cost_body body(cost_fn, nt, rods, trans, min_allowed_overlap);
+  vpl_parallel_for(static_cast<unsigned>(rods.size()), body, nt);
+  unsigned n_succ = 0;
+  min_overlap_fraction = 0.0;
+  min_cost = vnl_numeric_traits<double>::maxval;
+  for (unsigned k = 0; k<rods.size(); ++k) {
+    if (progress && k%10 == 0) std::cout << '.';
+    double c = body.cost[k];
+    if (c==vnl_numeric_traits<double>::maxval)
+      continue;
+    if (c<min_cost) {
+      min_cost = c;
+      min_rod = rods[k];
+      min_overlap_fraction = body.frac[k];
+      n_succ++;
+    }
+  }
+  return n_succ>0;
+}
+
 //: Constructor
 icam_minimizer::icam_minimizer( const vil_image_view<float>& source_img,
                                 const vil_image_view<float>& dest_img,
                                 const icam_depth_transform& dt,
                                 icam_minimizer_params const& params,
                                 bool verbose)
-  : params_(params), cam_search_valid_(false), end_error_(0.0), verbose_(verbose)
+  : params_(params), cam_search_valid_(false), end_error_(0.0), verbose_(verbose),
+    n_threads_(0)
 {
   unsigned n_levels =
     icam_depth_trans_pyramid::required_levels(dest_img.ni(), dest_img.nj(),
@@ -82,7 +148,8 @@ icam_minimizer::icam_minimizer(const vil_image_view<float>& dest_img,
                                const icam_depth_transform& dt,
                                icam_minimizer_params const& params,
                                bool verbose)
- : params_(params), cam_search_valid_(false), end_error_(0.0), verbose_(verbose)
+ : params_(params), cam_search_valid_(false), end_error_(0.0), verbose_(verbose),
+   n_threads_(0)
 {
   unsigned n_levels =
     icam_depth_trans_pyramid::required_levels(dest_img.ni(), dest_img.nj(),
@@ -243,32 +310,15 @@ exhaustive_rotation_search(vgl_vector_3d<double> const& trans,
   vnl_vector_fixed<double,3> min_rod;
   icam_cost_func cost = this->cost_fn(level);
   vul_timer tim;
-  unsigned n_succ = 0;
-  min_overlap_fraction = 0.0;
-  min_cost = vnl_numeric_traits<double>::maxval;
-  for (prs.reset(); prs.next();) {
+  std::vector<vnl_vector_fixed<double, 3> > rods;
+  for (prs.reset(); prs.next();)
     for (double ang = -polar_range; ang<=polar_range; ang+=plar_inc)
-    {
-      vgl_rotation_3d<double> rot = prs.rot(ang);
-      vnl_vector_fixed<double, 3> rod = rot.as_rodrigues();
-      //double c = cost.error(rod, trans,min_allowed_overlap);
-      //double c = cost.entropy(rod, trans,min_allowed_overlap);
-      //double c = cost.mutual_info(rod, trans,min_allowed_overlap);
-      double c = cost.entropy_diff(rod, trans,min_allowed_overlap);
-      if (c==vnl_numeric_traits<double>::maxval)
-        continue;
-      //c = -c;
-      if (c<min_cost) {
-        min_cost = c;
-        min_rod = rod;
-        min_overlap_fraction = cost.frac_samples();
-        n_succ++;
-      }
-    }
-  }
+      rods.push_back(prs.rot(ang).as_rodrigues());
+  bool found = min_cost_rotation(cost, rods, trans, min_allowed_overlap, n_threads_,
+                                 min_rod, min_cost, min_overlap_fraction);
   if (verbose_)
     std::cout << "scan took " << tim.real()/1000.0 << " seconds" << std::endl;
-  if (n_succ==0) return false;
+  if (!found) return false;
   min_rot = vgl_rotation_3d<double>(min_rod);
   return true;
 }
@@ -347,39 +397,19 @@ bool icam_minimizer::rot_search(vgl_vector_3d<double> const& trans,
              << static_cast<unsigned>(n_samples*np)
              << " rotations\n" << std::flush;
 #endif
-  unsigned n_succ = 0;
-  min_overlap_fraction = 0.0;
-  min_cost = vnl_numeric_traits<double>::maxval;
   icam_cost_func cost = this->cost_fn(search_level);
   vnl_vector_fixed<double,3> min_rod;
   vul_timer tim;
-  unsigned nc = 0;
-  for (prs.reset(); prs.next();) {
+  std::vector<vnl_vector_fixed<double, 3> > rods;
+  for (prs.reset(); prs.next();)
     for (double ang = -(polar_range/2); ang<=(polar_range/2); ang+=polar_inc)
-    {
-      vgl_rotation_3d<double> rot = prs.rot(ang);
       // pre or post multiply? Or something else?
-      vgl_rotation_3d<double> comp_rot = initial_rot*rot;
-      vnl_vector_fixed<double, 3> rod = comp_rot.as_rodrigues();
-      //double c = cost.error(rod, trans,min_allowed_overlap);
-      //double c = cost.entropy(rod, trans,min_allowed_overlap);
-      //double c = cost.mutual_info(rod, trans,min_allowed_overlap);
-      double c = cost.entropy_diff(rod, trans,min_allowed_overlap);
-      if ((nc++)%10 == 0) std::cout << '.';
-      if (c==vnl_numeric_traits<double>::maxval)
-        continue;
-      //c = -c;
-      if (c<min_cost) {
-        min_cost = c;
-        min_rod = rod;
-        min_overlap_fraction = cost.frac_samples();
-        n_succ++;
-      }
-    }
-  }
+      rods.push_back((initial_rot*prs.rot(ang)).as_rodrigues());
+  bool found = min_cost_rotation(cost, rods, trans, min_allowed_overlap, n_threads_,
+                                 min_rod, min_cost, min_overlap_fraction, true);
   std::cout << "\nscan took " << tim.real()/1000.0 << " seconds\n" << std::flush;
 
-  if (n_succ==0) return false;
+  if (!found) return false;
   min_rot = vgl_rotation_3d<double>(min_rod);
   return true;
 }
@@ -411,37 +441,19 @@ initialized_rot_search(vgl_vector_3d<double> const& trans,
              << static_cast<unsigned>(naxis_steps*npolar_steps)
              << " rotations\n" << std::flush;*/
 #endif
-  unsigned n_succ = 0;
-  min_overlap_fraction = 0.0;
-  min_cost = vnl_numeric_traits<double>::maxval;
   icam_cost_func cost = this->cost_fn(search_level);
   vnl_vector_fixed<double,3> min_rod;
   vul_timer tim;
-  for (prs.reset(); prs.next();) {
+  std::vector<vnl_vector_fixed<double, 3> > rods;
+  for (prs.reset(); prs.next();)
     for (double ang = -(polar_range/2); ang<=(polar_range/2); ang+=polar_inc)
-    {
-      vgl_rotation_3d<double> rot = prs.rot(ang);
       // pre or post multiply? Or something else?
-      vgl_rotation_3d<double> comp_rot = initial_rot*rot;
-      vnl_vector_fixed<double, 3> rod = comp_rot.as_rodrigues();
-      //double c = cost.error(rod, trans,min_allowed_overlap);
-      //double c = cost.entropy(rod, trans,min_allowed_overlap);
-      //double c = cost.mutual_info(rod, trans,min_allowed_overlap);
-      double c = cost.entropy_diff(rod, trans,min_allowed_overlap);
-      if (c==vnl_numeric_traits<double>::maxval)
-        continue;
-      //c = -c;
-      if (c<min_cost) {
-        min_cost = c;
-        min_rod = rod;
-        min_overlap_fraction = cost.frac_samples();
-        n_succ++;
-      }
-    }
-  }
+      rods.push_back((initial_rot*prs.rot(ang)).as_rodrigues());
+  bool found = min_cost_rotation(cost, rods, trans, min_allowed_overlap, n_threads_,
+                                 min_rod, min_cost, min_overlap_fraction);
   std::cout << "scan took " << tim.real()/1000.0 << " seconds\n" << std::flush;
 
-  if (n_succ==0) return false;
+  if (!found) return false;
   min_rot = vgl_rotation_3d<double>(min_rod);
   return true;
 }
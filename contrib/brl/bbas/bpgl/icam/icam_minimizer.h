@@ -67,6 +67,10 @@ class icam_minimizer
 
   bool verbose() {return verbose_;}
 
+  //: number of threads for the rotation searches, 0 (the default) for one per processor
+  void set_num_threads(unsigned n) {n_threads_ = n;}
+  unsigned num_threads() const {return n_threads_;}
+
   //: print parameters
   void print_params();
 
@@ -124,6 +128,7 @@ class icam_minimizer
                  double& min_cost,
                  double& min_overlap_fraction);
   //: exhaustive search for rotation, given the camera translation
+  // The rotations are evaluated on num_threads() threads.
   // This virtual method is implemented in both C++ and in OpenCL
   // setup and finish are particular to OpenCL to signal setup and
   // finish of GPU context and buffers
@@ -292,6 +297,7 @@ bool  pyramid_camera_search(vgl_vector_3d<double> const&
   bool verbose_;
   vgl_vector_3d<double> actual_trans_;
   vgl_rotation_3d<double> actual_rot_;
+  unsigned n_threads_;
 };
 
 #endif // icam_minimizer_h_
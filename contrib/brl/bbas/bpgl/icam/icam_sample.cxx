@@ -1,7 +1,12 @@
 #include "icam_sample.h"
 //:
 // \file
+#include <vector>
 #include <vil/vil_bilin_interp.h>
+#include <vxl_config.h>
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 
 void icam_sample::sample( unsigned int ni_dest,  unsigned int nj_dest,
                           vil_image_view<float> const& source,
@@ -30,8 +35,11 @@ void icam_sample::sample( unsigned int ni_dest,  unsigned int nj_dest,
   for (unsigned j = 1; j<dest_lj; j++)
     for (unsigned i = 1; i<dest_li; i++)
     {
-      if (!dt.transform(i,j,to_u, to_v))
+      // the sample stays in place, so that it lines up with the destination pixel
+      if (!dt.transform(i,j,to_u, to_v)) {
+        mask[index++] = 0.0f;
         continue;
+      }
 
       //check to see if the source is being accessed out of bounds
       //then non bounds-checking bilinear interpolation can be called
@@ -52,6 +60,80 @@ void icam_sample::sample( unsigned int ni_dest,  unsigned int nj_dest,
     }
 }
 
+void icam_sample::sample(vil_image_view<float> const& source,
+                         icam_depth_transform const& dt,
+                         icam_depth_rays const& rays,
+                         vnl_vector<double>& samples,
+                         vnl_vector<double>& mask,
+                         unsigned& n_samples)
+{
+  unsigned row = rays.ni-2, max_samples = row*(rays.nj-2);
+  samples.set_size(max_samples);
+  mask.set_size(max_samples);
+  n_samples = 0;
+  float src_li = static_cast<float>(source.ni()-1), src_lj = static_cast<float>(source.nj()-1);
+  std::ptrdiff_t src_istep = source.istep(), src_jstep = source.jstep();
+  const float* src_ptr = &source(0,0);
+  std::vector<float> to_u(row), to_v(row), v(row);
+  std::vector<unsigned char> valid(row);
+  // a row of destination pixels at a time: map them to the source, then interpolate
+  for (unsigned first = 0; first<max_samples; first+=row) {
+    dt.transform(rays, first, row, &to_u[0], &to_v[0]);
+    unsigned k = 0;
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), li = _mm_set1_ps(src_li), lj = _mm_set1_ps(src_lj);
+    for (; k+4<=row; k+=4) {
+      __m128 u = _mm_loadu_ps(&to_u[k]), w = _mm_loadu_ps(&to_v[k]);
+      __m128 in = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmpge_ps(w, zero)),
+                             _mm_and_ps(_mm_cmplt_ps(u, li), _mm_cmplt_ps(w, lj)));
+      // pixels outside the source read pixel (0,0)
+      u = _mm_and_ps(in, u);  w = _mm_and_ps(in, w);
+      __m128i iu = _mm_cvttps_epi32(u), iw = _mm_cvttps_epi32(w);
+      __m128 fx = _mm_sub_ps(u, _mm_cvtepi32_ps(iu)), fy = _mm_sub_ps(w, _mm_cvtepi32_ps(iw));
+      int ia[4], ja[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ia), iu);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ja), iw);
+      float p00[4], p10[4], p01[4], p11[4];
+      for (unsigned l = 0; l<4; ++l) {
+        const float* p = src_ptr + ja[l]*src_jstep + ia[l]*src_istep;
+        p00[l] = p[0];  p10[l] = p[src_istep];
+        p01[l] = p[src_jstep];  p11[l] = p[src_istep+src_jstep];
+      }
+      __m128 a = _mm_loadu_ps(p00), b = _mm_loadu_ps(p10), c = _mm_loadu_ps(p01), d = _mm_loadu_ps(p11);
+      __m128 i1 = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(c, a), fy));
+      __m128 i2 = _mm_add_ps(b, _mm_mul_ps(_mm_sub_ps(d, b), fy));
+      _mm_storeu_ps(&v[k], _mm_add_ps(i1, _mm_mul_ps(_mm_sub_ps(i2, i1), fx)));
+      int m = _mm_movemask_ps(in);
+      for (unsigned l = 0; l<4; ++l)
+        valid[k+l] = (m>>l)&1;
+    }
+#endif
+    for (; k<row; ++k) {
+      float u = to_u[k], w = to_v[k];
+      valid[k] = u>=0.0f && w>=0.0f && u<src_li && w<src_lj;
+      if (!valid[k])
+        continue;
+      int iu = static_cast<int>(u), iw = static_cast<int>(w);
+      float fx = u - static_cast<float>(iu), fy = w - static_cast<float>(iw);
+      const float* p = src_ptr + iw*src_jstep + iu*src_istep;
+      float i1 = p[0] + (p[src_jstep]-p[0])*fy;
+      float i2 = p[src_istep] + (p[src_istep+src_jstep]-p[src_istep])*fy;
+      v[k] = i1 + (i2-i1)*fx;
+    }
+    for (k = 0; k<row; ++k) {
+      if (valid[k]) {
+        samples[first+k] = v[k];
+        mask[first+k] = 1.0;
+        n_samples++;
+      }
+      else {
+        samples[first+k] = 0.0;
+        mask[first+k] = 0.0;
+      }
+    }
+  }
+}
+
 void icam_sample::resample(unsigned int ni_dest,  unsigned int nj_dest,
                            vil_image_view<float> const& source,
                            icam_depth_transform const& dt,
@@ -34,6 +34,19 @@ class icam_sample
                       vnl_vector<double>& mask,
                       unsigned& n_samples);
 
+  //:
+  //  as above, for the destination image that rays were computed for
+  //  (see icam_depth_transform::rays()); only the rotation and translation
+  //  of dt are applied to the rays. The warp and the bilinear interpolation
+  //  are computed in single precision, four pixels at a time where SSE2 is
+  //  available, so the samples may differ from those above in the last bits.
+  static void sample(vil_image_view<float> const& source,
+                     icam_depth_transform const& dt,
+                     icam_depth_rays const& rays,
+                     vnl_vector<double>& samples,
+                     vnl_vector<double>& mask,
+                     unsigned& n_samples);
+
   //:
   //  given a depth transform from dest to source, produce an image
   //  is the resampling of the source to the destination. The mask
@@ -4,6 +4,7 @@ DECLARE( test_icam_transform );
 DECLARE( test_minimizer );
 DECLARE( test_cylinder_map );
 DECLARE( test_spherical_map );
+DECLARE( test_sample );
 
 void
 register_tests()
@@ -12,6 +13,7 @@ register_tests()
   REGISTER( test_icam_transform );
   REGISTER( test_cylinder_map );
   REGISTER( test_spherical_map );
+  REGISTER( test_sample );
 }
 
 DEFINE_MAIN;
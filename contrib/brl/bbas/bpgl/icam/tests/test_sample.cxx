@@ -0,0 +1,76 @@
+#include <iostream>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+
+#include <vgl/vgl_vector_3d.h>
+#include <vgl/algo/vgl_rotation_3d.h>
+#include <vil/vil_image_view.h>
+#include <vnl/vnl_matrix_fixed.h>
+#include <vnl/vnl_vector_fixed.h>
+
+#include <icam/icam_depth_transform.h>
+#include <icam/icam_sample.h>
+#include <icam/icam_minimizer.h>
+
+static void test_sample()
+{
+  unsigned ni = 64, nj = 48;
+  vil_image_view<float> source(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      source(i,j) = static_cast<float>(128.0 + 100.0*std::sin(0.3*i)*std::cos(0.2*j));
+  // constant depth with a hole
+  vil_image_view<double> depth(ni, nj);
+  depth.fill(10.0);
+  depth(20,10) = 0.0;
+  vnl_matrix_fixed<double, 3, 3> K(0.0);
+  K[0][0] = 100.0;  K[1][1] = 100.0;  K[0][2] = ni/2.0;  K[1][2] = nj/2.0;  K[2][2] = 1.0;
+  vnl_vector_fixed<double, 3> rod(0.01, 0.02, -0.005);
+  icam_depth_transform dt(K, depth, vgl_rotation_3d<double>(rod), vgl_vector_3d<double>(0.3, -0.1, 0.2));
+
+  vnl_vector<double> samples, mask, fast_samples, fast_mask;
+  unsigned n_samples, n_fast;
+  icam_sample::sample(ni, nj, source, dt, samples, mask, n_samples);
+  icam_depth_rays rays;
+  dt.rays(ni, nj, rays);
+  icam_sample::sample(source, dt, rays, fast_samples, fast_mask, n_fast);
+  TEST("number of samples", fast_samples.size(), samples.size());
+  unsigned hole = (10-1)*(ni-2) + (20-1);
+  TEST("no sample at the depth hole", mask[hole] == 0.0 && fast_mask[hole] == 0.0, true);
+  unsigned n_diff_mask = 0;
+  double max_diff = 0.0;
+  for (unsigned k = 0; k<samples.size(); ++k) {
+    if (mask[k] != fast_mask[k]) {
+      ++n_diff_mask;
+      continue;
+    }
+    if (mask[k] > 0.0)
+      max_diff = std::max(max_diff, std::fabs(samples[k]-fast_samples[k]));
+  }
+  std::cout << n_samples << " samples, " << n_diff_mask << " differ in the mask, max difference "
+            << max_diff << std::endl;
+  TEST("valid samples", n_samples > samples.size()/2, true);
+  TEST("masks agree", n_diff_mask <= 2, true);
+  TEST_NEAR("single precision samples", max_diff, 0.0, 1e-2);
+
+  // the threaded rotation search does not depend on the number of threads
+  icam_depth_transform dt0(K, depth, vgl_rotation_3d<double>(), vgl_vector_3d<double>());
+  icam_minimizer_params params;
+  icam_minimizer minimizer(source, source, dt0, params);
+  unsigned level = minimizer.n_levels()-1;
+  vgl_vector_3d<double> trans(0.0, 0.0, 0.0);
+  vgl_rotation_3d<double> rot1, rot3;
+  double cost1 = 0, cost3 = 0, overlap1 = 0, overlap3 = 0;
+  minimizer.set_num_threads(1);
+  bool found1 = minimizer.exhaustive_rotation_search(trans, level, 0.5, rot1, cost1, overlap1, false, false);
+  minimizer.set_num_threads(3);
+  bool found3 = minimizer.exhaustive_rotation_search(trans, level, 0.5, rot3, cost3, overlap3, false, false);
+  std::cout << "min cost " << cost1 << " at " << rot1.as_rodrigues() << ", overlap " << overlap1 << std::endl;
+  TEST("rotation found", found1 && found3, true);
+  TEST("same cost for 1 and 3 threads", cost1 == cost3 && overlap1 == overlap3, true);
+  TEST_NEAR("same rotation for 1 and 3 threads", (rot1.as_rodrigues()-rot3.as_rodrigues()).magnitude(), 0.0, 1e-12);
+  TEST_NEAR("identity found", rot1.angle(), 0.0, 0.1);
+}
+
+TESTMAIN( test_sample );
@@ -3,7 +3,48 @@
 //:
 // \file
 
+#include <ihog/ihog_sample_grid_bilin.h>
 #include <vil/algo/vil_gauss_filter.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+
+//: Computes the residuals of a range of grid rows on one thread
+class ihog_lsqr_rows_body : public vpl_parallel_for_body
+{
+ public:
+  const vil_image_view<float>* to_;
+  const vil_image_view<float>* to_mask_;      //!< null if no mask
+  double x0_, y0_, dx1_, dy1_, dx2_, dy2_;
+  int n2_;
+  const double* from_;
+  const double* from_mask_;                   //!< null if no mask
+  double* fx_;
+  std::vector<std::vector<double> >* rows_;
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    double* to_row = &(*rows_)[thread_id][0];
+    double* mask_row = to_row + n2_;
+    for (unsigned i = begin; i<end; ++i)
+    {
+      ihog_sample_grid_bilin_rows(to_row, *to_, x0_, y0_, dx1_, dy1_, dx2_, dy2_, n2_, i, i+1);
+      if (to_mask_)
+        ihog_sample_grid_bilin_rows(mask_row, *to_mask_, x0_, y0_, dx1_, dy1_, dx2_, dy2_, n2_, i, i+1);
+      std::size_t k = std::size_t(i)*n2_;
+      for (int j = 0; j<n2_; ++j, ++k)
+      {
+        double r = from_[k] - to_row[j];
+        if (from_mask_ && to_mask_)
+          r *= from_mask_[k]*mask_row[j];
+        else if (from_mask_)
+          r *= from_mask_[k];
+        else if (to_mask_)
+          r *= mask_row[j];
+        fx_[k] = r;
+      }
+    }
+  }
+};
 
 //: Constructor
 ihog_lsqr_cost_func::ihog_lsqr_cost_func( const ihog_image<float>& image1,
@@ -16,7 +57,8 @@ ihog_lsqr_cost_func::ihog_lsqr_cost_func( const ihog_image<float>& image1,
    roi_(roi),
    form_(init_xform.form()),
    from_mask_(false),
-   to_mask_(false)
+   to_mask_(false),
+   n_threads_(0)
 {
   vnl_vector<double> params;
   init_xform.params(params);
@@ -38,7 +80,8 @@ ihog_lsqr_cost_func::ihog_lsqr_cost_func( const ihog_image<float>& image1,
    roi_(roi),
    form_(init_xform.form()),
    from_mask_(image1_mask),
-   to_mask_(!image1_mask)
+   to_mask_(!image1_mask),
+   n_threads_(0)
 {
   if (from_mask_) {
     from_mask_image_ = mask;
@@ -49,6 +92,8 @@ ihog_lsqr_cost_func::ihog_lsqr_cost_func( const ihog_image<float>& image1,
   vnl_vector<double> params;
   init_xform.params(params);
   from_samples_ = roi_.sample(from_image_);
+  if (from_mask_)
+    from_mask_samples_ = roi_.sample(from_mask_image_);
   int number_of_residuals = from_samples_.size();
   use_gradient_ = false;
   vnl_least_squares_function::init(params.size(), number_of_residuals);
@@ -68,11 +113,14 @@ ihog_lsqr_cost_func::ihog_lsqr_cost_func(const ihog_image<float>& image1,
    roi_(roi),
    form_(init_xform.form()),
    from_mask_(true),
-   to_mask_(true)
+   to_mask_(true),
+   n_threads_(0)
 {
   vnl_vector<double> params;
   init_xform.params(params);
   from_samples_ = roi_.sample(from_image_);
+  if (from_mask_)
+    from_mask_samples_ = roi_.sample(from_mask_image_);
   int number_of_residuals = from_samples_.size();
   use_gradient_ = false;
   vnl_least_squares_function::init(params.size(), number_of_residuals);
@@ -87,6 +135,9 @@ ihog_lsqr_cost_func::f(vnl_vector<double> const& x, vnl_vector<double>& fx)
 {
   ihog_transform_2d new_xform;
   new_xform.set(x, form_);
+  if (f_rows(new_xform, fx))
+    return;
+
   ihog_image<float> test_image(to_image_);
   test_image.set_world2im(new_xform*to_image_.world2im());
   vnl_vector<double> to_samples = roi_.sample(test_image);
@@ -94,7 +145,7 @@ ihog_lsqr_cost_func::f(vnl_vector<double> const& x, vnl_vector<double>& fx)
   if (from_mask_ || to_mask_) {
     vnl_vector<double> mask_samples;
     if (from_mask_) {
-      mask_samples = roi_.sample(from_mask_image_);
+      mask_samples = from_mask_samples_;
     }
     if (to_mask_) {
       ihog_image<float> mask_test_image(to_mask_image_);
@@ -127,6 +178,38 @@ ihog_lsqr_cost_func::f(vnl_vector<double> const& x, vnl_vector<double>& fx)
 }
 
 
+//: f() for an affine transform and single plane images, one grid row at a time on several threads
+bool
+ihog_lsqr_cost_func::f_rows(ihog_transform_2d const& xform, vnl_vector<double>& fx)
+{
+  ihog_image<float> test_image(to_image_.image(), xform*to_image_.world2im());
+  unsigned n1 = roi_.size_in_u(), n2 = roi_.size_in_v();
+  ihog_lsqr_rows_body body;
+  if (to_image_.image().nplanes()!=1 ||
+      (to_mask_ && to_mask_image_.image().nplanes()!=1) ||
+      from_samples_.size()!=std::size_t(n1)*n2 ||
+      (from_mask_ && from_mask_samples_.size()!=from_samples_.size()) ||
+      n1==0 || n2==0 ||
+      !roi_.image_grid(test_image, body.x0_, body.y0_, body.dx1_, body.dy1_, body.dx2_, body.dy2_))
+    return false;
+
+  unsigned nt = vpl_parallel_for_num_threads(n_threads_);
+  rows_.resize(nt);
+  for (unsigned t = 0; t<nt; ++t)
+    rows_[t].resize(2*n2);
+  fx.set_size(from_samples_.size());
+  body.to_ = &to_image_.image();
+  body.to_mask_ = to_mask_ ? &to_mask_image_.image() : VXL_NULLPTR;
+  body.n2_ = int(n2);
+  body.from_ = from_samples_.data_block();
+  body.from_mask_ = from_mask_ ? from_mask_samples_.data_block() : VXL_NULLPTR;
+  body.fx_ = fx.data_block();
+  body.rows_ = &rows_;
+  vpl_parallel_for(n1, body, n_threads_, 4);
+  return true;
+}
+
+
 //: Returns the transformed second image
 vil_image_view<float>
 ihog_lsqr_cost_func::last_xformed_image()
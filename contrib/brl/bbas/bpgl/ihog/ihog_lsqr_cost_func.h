@@ -10,8 +10,10 @@
 // \verbatim
 //  Modifications
 //   G. Tunali - Aug 2010 - removed dependency on vimt
+//   f() samples the grid rows on several threads
 // \endverbatim
 
+#include <vector>
 #include <vnl/vnl_vector.h>
 #include <vnl/vnl_least_squares_function.h>
 #include <vil/vil_image_view.h>
@@ -51,7 +53,15 @@ class ihog_lsqr_cost_func : public vnl_least_squares_function
   //: Returns the transformed second image
   vil_image_view<float> last_xformed_image();
 
+  //: Set the number of threads that evaluate f(); 0 (the default) means one per processor
+  void set_num_threads(unsigned n) { n_threads_ = n; }
+  unsigned num_threads() const { return n_threads_; }
+
  protected:
+  //: f() for an affine transform and single plane images, one grid row at a time on several threads
+  //  Returns false if the images can not be sampled that way.
+  bool f_rows(ihog_transform_2d const& xform, vnl_vector<double>& fx);
+
   ihog_image<float> from_image_;
   ihog_image<float> to_image_;
   ihog_image<float> from_mask_image_;
@@ -63,6 +73,12 @@ class ihog_lsqr_cost_func : public vnl_least_squares_function
 
   bool from_mask_; //!< true if mask associated with from_image_
   bool to_mask_;   //!< true if mask associsted with to_image_
+
+  //: samples of from_mask_image_, which do not change with the transform
+  vnl_vector<double> from_mask_samples_;
+  //: sample row buffer of each thread
+  std::vector<std::vector<double> > rows_;
+  unsigned n_threads_;
 };
 
 #endif // ihog_lsqr_cost_func_h_
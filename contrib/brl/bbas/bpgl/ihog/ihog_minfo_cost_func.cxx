@@ -3,9 +3,57 @@
 //:
 // \file
 
+#include <cmath>
+#include <ihog/ihog_sample_grid_bilin.h>
 #include <vil/algo/vil_gauss_filter.h>
-#include <vbl/vbl_array_2d.h>
 #include <vbl/vbl_array_1d.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+
+//: Accumulates the joint histogram of a range of grid rows on one thread
+class ihog_minfo_rows_body : public vpl_parallel_for_body
+{
+ public:
+  const vil_image_view<float>* to_;
+  const vil_image_view<float>* to_mask_;      //!< null if no mask
+  double x0_, y0_, dx1_, dy1_, dx2_, dy2_;
+  int n2_;
+  const int* from_bins_;
+  const double* from_mask_;                   //!< null if no mask
+  double scl_;
+  unsigned nbins_;
+  std::vector<std::vector<double> >* hist_;
+  std::vector<std::vector<double> >* rows_;
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    double* to_row = &(*rows_)[thread_id][0];
+    double* mask_row = to_row + n2_;
+    double* h = &(*hist_)[thread_id][0];
+    for (unsigned i = begin; i<end; ++i)
+    {
+      ihog_sample_grid_bilin_rows(to_row, *to_, x0_, y0_, dx1_, dy1_, dx2_, dy2_, n2_, i, i+1);
+      if (to_mask_)
+        ihog_sample_grid_bilin_rows(mask_row, *to_mask_, x0_, y0_, dx1_, dy1_, dx2_, dy2_, n2_, i, i+1);
+      std::size_t k = std::size_t(i)*n2_;
+      for (int j = 0; j<n2_; ++j, ++k)
+      {
+        int id = from_bins_[k];
+        if (id<0)
+          continue;
+        double m = from_mask_ ? from_mask_[k] : 1.0;
+        if (to_mask_)
+          m *= mask_row[j];
+        if (!(m>0.0))
+          continue;
+        double is = std::floor(to_row[j]*scl_);
+        if (is<0.0 || is>=nbins_)
+          continue;
+        h[id*nbins_ + unsigned(is)] += 1.0;
+      }
+    }
+  }
+};
 
 //: Constructor
 ihog_minfo_cost_func::ihog_minfo_cost_func( const ihog_image<float>& image1,
@@ -21,11 +69,13 @@ ihog_minfo_cost_func::ihog_minfo_cost_func( const ihog_image<float>& image1,
    form_(init_xform.form()),
    from_mask_(false),
    to_mask_(false),
-   nbins_(nbins)
+   nbins_(nbins),
+   n_threads_(0)
 {
   vnl_vector<double> params;
   init_xform.params(params);
   from_samples_ = roi_.sample(from_image_);
+  init();
   //use_gradient_ = false;
   //int number_of_residuals = from_samples_.size();
 #if 0
@@ -48,7 +98,8 @@ ihog_minfo_cost_func::ihog_minfo_cost_func( const ihog_image<float>& image1,
    form_(init_xform.form()),
    from_mask_(image1_mask),
    to_mask_(!image1_mask),
-   nbins_(nbins)
+   nbins_(nbins),
+   n_threads_(0)
 {
   if (from_mask_) {
     from_mask_image_ = mask;
@@ -59,6 +110,7 @@ ihog_minfo_cost_func::ihog_minfo_cost_func( const ihog_image<float>& image1,
   vnl_vector<double> params;
   init_xform.params(params);
   from_samples_ = roi_.sample(from_image_);
+  init();
 #if 0
   int number_of_residuals = from_samples_.size();
       number_of_residuals = 1;  // just the mutual info
@@ -83,11 +135,13 @@ ihog_minfo_cost_func::ihog_minfo_cost_func(const ihog_image<float>& image1,
    form_(init_xform.form()),
    from_mask_(true),
    to_mask_(true),
-   nbins_(nbins)
+   nbins_(nbins),
+   n_threads_(0)
 {
   vnl_vector<double> params;
   init_xform.params(params);
   from_samples_ = roi_.sample(from_image_);
+  init();
 #if 0
   int number_of_residuals = from_samples_.size();
       number_of_residuals = 1;  // just the mutual info
@@ -97,6 +151,21 @@ ihog_minfo_cost_func::ihog_minfo_cost_func(const ihog_image<float>& image1,
 }
 
 
+//: Set up the buffers that do not depend on the transform
+void ihog_minfo_cost_func::init()
+{
+  if (from_mask_)
+    from_mask_samples_ = roi_.sample(from_mask_image_);
+  // the from image bins, computed as entropy_diff() does
+  double scl = 1.0/(256.0/nbins_);
+  from_bins_.resize(from_samples_.size());
+  for (unsigned i = 0; i<from_samples_.size(); ++i) {
+    double id = std::floor(from_samples_[i]*scl);
+    from_bins_[i] = (id<0.0 || id>=nbins_) ? -1 : int(id);
+  }
+}
+
+
 //: The main function.
 //  Given the parameter vector x, compute the vector of residuals fx.
 //  Fx has been sized appropriately before the call.  it should have dimension 1
@@ -106,6 +175,10 @@ double ihog_minfo_cost_func::f(vnl_vector<double> const& x)
 {
   ihog_transform_2d new_xform;
   new_xform.set(x, form_);
+  double cost;
+  if (f_rows(new_xform, cost))
+    return cost;
+
   ihog_image<float> test_image(to_image_);
   test_image.set_world2im(new_xform*to_image_.world2im());
   vnl_vector<double> to_samples = roi_.sample(test_image);
@@ -113,7 +186,7 @@ double ihog_minfo_cost_func::f(vnl_vector<double> const& x)
   if (from_mask_ || to_mask_) {
     vnl_vector<double> mask_samples;
     if (from_mask_) {
-      mask_samples = roi_.sample(from_mask_image_);
+      mask_samples = from_mask_samples_;
     }
     if (to_mask_) {
       ihog_image<float> mask_test_image(to_mask_image_);
@@ -141,6 +214,49 @@ double ihog_minfo_cost_func::f(vnl_vector<double> const& x)
 }
 
 
+//: f() for an affine transform and single plane images, one grid row at a time on several threads
+bool ihog_minfo_cost_func::f_rows(ihog_transform_2d const& xform, double& cost)
+{
+  ihog_image<float> test_image(to_image_.image(), xform*to_image_.world2im());
+  unsigned n1 = roi_.size_in_u(), n2 = roi_.size_in_v();
+  ihog_minfo_rows_body body;
+  if (to_image_.image().nplanes()!=1 ||
+      (to_mask_ && to_mask_image_.image().nplanes()!=1) ||
+      from_samples_.size()!=std::size_t(n1)*n2 ||
+      (from_mask_ && from_mask_samples_.size()!=from_samples_.size()) ||
+      n1==0 || n2==0 ||
+      !roi_.image_grid(test_image, body.x0_, body.y0_, body.dx1_, body.dy1_, body.dx2_, body.dy2_))
+    return false;
+
+  unsigned nt = vpl_parallel_for_num_threads(n_threads_);
+  unsigned nh = nbins_*nbins_;
+  hist_.resize(nt);
+  rows_.resize(nt);
+  for (unsigned t = 0; t<nt; ++t) {
+    hist_[t].assign(nh, 0.0);
+    rows_[t].resize(2*n2);
+  }
+  body.to_ = &to_image_.image();
+  body.to_mask_ = to_mask_ ? &to_mask_image_.image() : VXL_NULLPTR;
+  body.n2_ = int(n2);
+  body.from_bins_ = &from_bins_[0];
+  body.from_mask_ = from_mask_ ? from_mask_samples_.data_block() : VXL_NULLPTR;
+  body.scl_ = 1.0/(256.0/nbins_);
+  body.nbins_ = nbins_;
+  body.hist_ = &hist_;
+  body.rows_ = &rows_;
+  vpl_parallel_for(n1, body, n_threads_, 4);
+
+  // the counts are integers, so the sum does not depend on the thread count
+  std::vector<double>& h = hist_[0];
+  for (unsigned t = 1; t<nt; ++t)
+    for (unsigned k = 0; k<nh; ++k)
+      h[k] += hist_[t][k];
+  cost = histogram_entropy_diff(&h[0], nbins_);
+  return true;
+}
+
+
 //: Returns the transformed second image
 vil_image_view<float>
 ihog_minfo_cost_func::last_xformed_image()
@@ -152,42 +268,47 @@ ihog_minfo_cost_func::last_xformed_image()
 double ihog_minfo_cost_func::entropy_diff(vnl_vector<double>& mask_samples, vnl_vector<double>& from_samples, vnl_vector<double>& to_samples, int nbins)
 {
   double scl = 1.0/(256.0/nbins);
-  vbl_array_2d<double> h(nbins, nbins, 0.0);
+  std::vector<double> h(nbins*nbins, 0.0);
 
   //compute the intensity histogram
-  double total_weight = 0.0;
   for (unsigned i = 0; i<to_samples.size(); ++i)
     if (mask_samples[i]>0.0) {
       //match the gpu implementation, which does a floor operation
-      unsigned id = static_cast<unsigned>(std::floor(from_samples[i]*scl)),
-               is = static_cast<unsigned>(std::floor(to_samples[i]*scl));
+      double id = std::floor(from_samples[i]*scl),
+             is = std::floor(to_samples[i]*scl);
 
-      if (id+1>(unsigned)nbins || is+1>(unsigned)nbins)
+      if (id<0.0 || is<0.0 || id>=nbins || is>=nbins)
         continue;
-      h[id][is] += 1.0;
-      total_weight += 1.0;
+      h[unsigned(id)*nbins + unsigned(is)] += 1.0;
     }
+  return histogram_entropy_diff(&h[0], nbins);
+}
+
+
+double ihog_minfo_cost_func::histogram_entropy_diff(double* h, unsigned nbins)
+{
+  double total_weight = 0.0;
+  for (unsigned k = 0; k<nbins*nbins; ++k)
+    total_weight += h[k];
   // convert to probability
-  for (int r = 0; r<nbins; ++r)
-    for (int c = 0; c<nbins; ++c)
-      h[r][c] /= total_weight;
+  for (unsigned k = 0; k<nbins*nbins; ++k)
+    h[k] /= total_weight;
 
-  unsigned nr = (unsigned)h.rows(), nc = (unsigned)h.cols();
   //marginal distribution for mapped dest intensities
-  vbl_array_1d<double> pmr(nc,0.0);
-  for (unsigned r = 0; r<nr; ++r)
-    for (unsigned c = 0; c<nc; ++c)
-      pmr[c]+=h[r][c];
+  vbl_array_1d<double> pmr(nbins,0.0);
+  for (unsigned r = 0; r<nbins; ++r)
+    for (unsigned c = 0; c<nbins; ++c)
+      pmr[c]+=h[r*nbins+c];
   double jsum = 0.0, msum = 0.0;
-  for (unsigned c = 0; c<nc; ++c)
+  for (unsigned c = 0; c<nbins; ++c)
   {
     double pr = pmr[c];
     if (pr>0)
       msum += pr*std::log(pr);
   }
-  for (unsigned r = 0; r<nr; ++r)
-    for (unsigned c = 0; c<nc; ++c) {
-        double prc = h[r][c];
+  for (unsigned r = 0; r<nbins; ++r)
+    for (unsigned c = 0; c<nbins; ++c) {
+        double prc = h[r*nbins+c];
         if (prc>0)
           jsum+= prc*std::log(prc);
     }
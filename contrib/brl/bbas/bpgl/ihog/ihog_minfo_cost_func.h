@@ -9,9 +9,10 @@
 //
 // \verbatim
 //  Modifications
-//  <none yet>
+//   f() samples the grid rows on several threads into reused histogram buffers
 // \endverbatim
 
+#include <vector>
 #include <vnl/vnl_vector.h>
 #include <vnl/vnl_cost_function.h>
 #include <vil/vil_image_view.h>
@@ -57,7 +58,20 @@ class ihog_minfo_cost_func : public vnl_cost_function
 
   static double entropy_diff(vnl_vector<double>& mask_samples, vnl_vector<double>& from_samples, vnl_vector<double>& to_samples, int nbins);
 
+  //: Set the number of threads that evaluate f(); 0 (the default) means one per processor
+  void set_num_threads(unsigned n) { n_threads_ = n; }
+  unsigned num_threads() const { return n_threads_; }
+
  protected:
+  //: Set up the buffers that do not depend on the transform
+  void init();
+
+  //: f() for an affine transform and single plane images, one grid row at a time on several threads
+  //  Returns false if the images can not be sampled that way.
+  bool f_rows(ihog_transform_2d const& xform, double& cost);
+
+  //: The entropy difference of an nbins x nbins joint histogram of counts, which is normalized in place
+  static double histogram_entropy_diff(double* h, unsigned nbins);
 
   ihog_image<float> from_image_;
   ihog_image<float> to_image_;
@@ -72,6 +86,16 @@ class ihog_minfo_cost_func : public vnl_cost_function
   bool to_mask_;   //!< true if mask associsted with to_image_
 
   unsigned nbins_;
+
+  //: samples of from_mask_image_, which do not change with the transform
+  vnl_vector<double> from_mask_samples_;
+  //: histogram bin of each of from_samples_, -1 if out of range
+  std::vector<int> from_bins_;
+  //: joint histogram buffer of each thread
+  std::vector<std::vector<double> > hist_;
+  //: sample row buffer of each thread
+  std::vector<std::vector<double> > rows_;
+  unsigned n_threads_;
 };
 
 #endif // ihog_minfo_cost_func_h_
@@ -33,7 +33,7 @@ w2img_pyramid(ihog_transform_2d const& w2img, int n_levels)
 ihog_minimizer::ihog_minimizer( const ihog_image<float>& image1,
                                 const ihog_image<float>& image2,
                                 const ihog_world_roi& roi )
-  : end_error_(0.0), from_mask_(false), to_mask_(false)
+  : end_error_(0.0), n_threads_(0), from_mask_(false), to_mask_(false)
 {
   ihog_world_roi roi_L(roi);
   int levels = 0;
@@ -67,7 +67,7 @@ ihog_minimizer::ihog_minimizer( const ihog_image<float>& image1,
                                 const ihog_image<float>& image2,
                                 const ihog_image<float>& image_mask,
                                 const ihog_world_roi& roi, bool image1_mask )
-  : end_error_(0.0), from_mask_(image1_mask), to_mask_(!image1_mask)
+  : end_error_(0.0), n_threads_(0), from_mask_(image1_mask), to_mask_(!image1_mask)
 {
   ihog_world_roi roi_L(roi);
   int levels = 0;
@@ -117,7 +117,7 @@ ihog_minimizer::ihog_minimizer( const ihog_image<float>& image1,
                                 const ihog_image<float>& image1_mask,
                                 const ihog_image<float>& image2_mask,
                                 const ihog_world_roi& roi)
-  : end_error_(0.0), from_mask_(true), to_mask_(true)
+  : end_error_(0.0), n_threads_(0), from_mask_(true), to_mask_(true)
 {
   ihog_world_roi roi_L(roi);
   int levels = 0;
@@ -243,6 +243,7 @@ ihog_minimizer::minimize(ihog_transform_2d& xform)
 
       cost = new ihog_lsqr_cost_func( im1, im2, f_immask, t_immask, roi_pyramid_[L], xform);
     }
+    cost->set_num_threads(n_threads_);
     vnl_levenberg_marquardt minimizer(*cost);
 #if 0
     minimizer.set_x_tolerance(1e-16);
@@ -335,6 +336,8 @@ void ihog_minimizer::minimize_exhaustive_minfo(int radius, ihog_transform_2d& xf
       cost = new ihog_minfo_cost_func( im1, im2, f_immask, t_immask, roi_pyramid_[L], xform);
     }
 
+    cost->set_num_threads(n_threads_);
+
     // now at this level first minimize using exhaustive search
     double min = 1000.0f; int min_tx, min_ty;
     int ix = int(xform.get_translation().x()),
@@ -460,6 +463,7 @@ void ihog_minimizer::minimize_using_minfo(ihog_transform_2d& xform)
       cost = new ihog_minfo_cost_func( im1, im2, f_immask, t_immask, roi_pyramid_[L], xform);
     }
 
+    cost->set_num_threads(n_threads_);
     vnl_powell minimizer(cost); // was: vnl_levenberg_marquardt minimizer(*cost);
 
 #ifdef DEBUG
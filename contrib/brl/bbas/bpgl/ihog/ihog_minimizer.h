@@ -57,6 +57,11 @@ class ihog_minimizer
   void minimize_using_minfo(ihog_transform_2d& xform);
 
   double get_end_error(){return end_error_;}
+
+  //: Set the number of threads that evaluate the cost functions; 0 (the default) means one per processor
+  void set_num_threads(unsigned n) { n_threads_ = n; }
+  unsigned num_threads() const { return n_threads_; }
+
   //:debug purposes
   vil_pyramid_image_view<float>& from_pyr() {return from_pyramid_;}
   vil_pyramid_image_view<float>& to_pyr() {return to_pyramid_;}
@@ -77,6 +82,7 @@ class ihog_minimizer
   //  static const unsigned min_level_size_ = 256;
   static const unsigned min_level_size_ = 8;
   double end_error_;
+  unsigned n_threads_;
   bool from_mask_; // true if mask is associated with from_pyramid_
   bool to_mask_; // true if mask is associated with to_pyramid_
 };
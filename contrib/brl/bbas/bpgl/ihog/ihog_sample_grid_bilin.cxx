@@ -9,6 +9,12 @@
 #include <vnl/vnl_vector.h>
 #include <vgl/vgl_point_2d.h>
 #include <vgl/vgl_vector_2d.h>
+#include <vcl_cassert.h>
+#include <vxl_config.h>
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+# include <emmintrin.h>
+# define IHOG_SAMPLE_SSE2 1
+#endif
 
 inline bool ihog_grid_corner_in_image(const vgl_point_2d<double>& p,
                                       const vil_image_view_base& image)
@@ -132,3 +138,88 @@ void ihog_sample_grid_bilin(vnl_vector<double>& vec,
   }
 }
 
+
+//: Bilinear interpolation at (x,y), zero outside the image
+//  The image must be at least 2x2; the top left pixel of the interpolation
+//  cell is clamped to (ni-2,nj-2) so that the last row and column are never
+//  stepped past.
+static inline double ihog_bilin_interp_clamped(double x, double y, const float* plane,
+                                               unsigned ni, unsigned nj,
+                                               std::ptrdiff_t istep, std::ptrdiff_t jstep)
+{
+  if (!(x>=0.0 && y>=0.0 && x<=ni-1.0 && y<=nj-1.0))
+    return 0.0;
+  int ci = int(x), cj = int(y);
+  if (ci>int(ni)-2) ci = int(ni)-2;
+  if (cj>int(nj)-2) cj = int(nj)-2;
+  double nx = x-ci, ny = y-cj;
+  const float* p = plane + ci*istep + cj*jstep;
+  double i1 = p[0]+(p[jstep]-p[0])*ny;
+  double i2 = p[istep]+(p[istep+jstep]-p[istep])*ny;
+  return i1+(i2-i1)*nx;
+}
+
+void ihog_sample_grid_bilin_rows(double* vec,
+                                 const vil_image_view<float>& image,
+                                 double x0, double y0, double dx1, double dy1,
+                                 double dx2, double dy2,
+                                 int n2, int i_begin, int i_end)
+{
+  assert(image.nplanes()==1);
+  const unsigned ni = image.ni(), nj = image.nj();
+  const std::ptrdiff_t istep = image.istep(), jstep = image.jstep();
+  const float* plane0 = image.top_left_ptr();
+
+  if (ni<2 || nj<2)
+  {
+    // too small for the clamped cell; vil does the edge cases
+    for (int i=i_begin; i<i_end; ++i)
+      for (int j=0; j<n2; ++j,++vec)
+        *vec = vil_bilin_interp_safe(x0+i*dx1+j*dx2, y0+i*dy1+j*dy2,
+                                     plane0, ni, nj, istep, jstep);
+    return;
+  }
+
+  for (int i=i_begin; i<i_end; ++i)
+  {
+    const double xr = x0+i*dx1, yr = y0+i*dy1;  // start of row i
+    int j = 0;
+#if IHOG_SAMPLE_SSE2
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d xmax = _mm_set1_pd(ni-1.0), ymax = _mm_set1_pd(nj-1.0);
+    const __m128d imax = _mm_set1_pd(ni-2.0), jmax = _mm_set1_pd(nj-2.0);
+    const __m128d vxr = _mm_set1_pd(xr), vyr = _mm_set1_pd(yr);
+    const __m128d vdx = _mm_set1_pd(dx2), vdy = _mm_set1_pd(dy2);
+    for (; j+2<=n2; j+=2)
+    {
+      __m128d jj = _mm_set_pd(double(j+1), double(j));
+      __m128d x = _mm_add_pd(vxr, _mm_mul_pd(jj, vdx));
+      __m128d y = _mm_add_pd(vyr, _mm_mul_pd(jj, vdy));
+      __m128d inside = _mm_and_pd(_mm_and_pd(_mm_cmpge_pd(x, zero), _mm_cmpge_pd(y, zero)),
+                                  _mm_and_pd(_mm_cmple_pd(x, xmax), _mm_cmple_pd(y, ymax)));
+      // clamp so that the points outside still address valid pixels
+      x = _mm_min_pd(_mm_max_pd(x, zero), xmax);
+      y = _mm_min_pd(_mm_max_pd(y, zero), ymax);
+      __m128d fi = _mm_min_pd(_mm_cvtepi32_pd(_mm_cvttpd_epi32(x)), imax);
+      __m128d fj = _mm_min_pd(_mm_cvtepi32_pd(_mm_cvttpd_epi32(y)), jmax);
+      __m128d nx = _mm_sub_pd(x, fi), ny = _mm_sub_pd(y, fj);
+      int ci[4], cj[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ci), _mm_cvttpd_epi32(fi));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(cj), _mm_cvttpd_epi32(fj));
+      const float* p0 = plane0 + ci[0]*istep + cj[0]*jstep;
+      const float* p1 = plane0 + ci[1]*istep + cj[1]*jstep;
+      __m128d v00 = _mm_set_pd(p1[0], p0[0]);
+      __m128d v01 = _mm_set_pd(p1[jstep], p0[jstep]);
+      __m128d v10 = _mm_set_pd(p1[istep], p0[istep]);
+      __m128d v11 = _mm_set_pd(p1[istep+jstep], p0[istep+jstep]);
+      __m128d i1 = _mm_add_pd(v00, _mm_mul_pd(_mm_sub_pd(v01, v00), ny));
+      __m128d i2 = _mm_add_pd(v10, _mm_mul_pd(_mm_sub_pd(v11, v10), ny));
+      __m128d r = _mm_add_pd(i1, _mm_mul_pd(_mm_sub_pd(i2, i1), nx));
+      _mm_storeu_pd(vec, _mm_and_pd(r, inside));
+      vec += 2;
+    }
+#endif
+    for (; j<n2; ++j,++vec)
+      *vec = ihog_bilin_interp_clamped(xr+j*dx2, yr+j*dy2, plane0, ni, nj, istep, jstep);
+  }
+}
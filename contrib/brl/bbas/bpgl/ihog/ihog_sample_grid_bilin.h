@@ -31,6 +31,18 @@ void ihog_sample_grid_bilin(vnl_vector<double>& vec,
                             const vgl_vector_2d<double>& v,
                             int n1, int n2);
 
+//: Sample rows [i_begin,i_end) of a grid from a single plane float image, using bilinear interpolation
+//  Grid points are (x0,y0)+i.(dx1,dy1)+j.(dx2,dy2) in image co-ordinates, j=[0..n2-1].
+//  The n2 samples of row i are written to vec[(i-i_begin)*n2] onwards.
+//  The values are those of vil_sample_grid_bilin(), computed two points at
+//  a time where SSE2 is available.
+//  Points outside image return zero.
+void ihog_sample_grid_bilin_rows(double* vec,
+                                 const vil_image_view<float>& image,
+                                 double x0, double y0, double dx1, double dy1,
+                                 double dx2, double dy2,
+                                 int n2, int i_begin, int i_end);
+
 //: Sample grid of points in one image and place in another, using bilinear interpolation.
 //  dest_image(i,j,p) is sampled from the src_image at
 //  p+i.u+j.v, where i=[0..n1-1], j=[0..n2-1] in world co-ordinates.
@@ -27,6 +27,31 @@ ihog_world_roi::sample( const ihog_image<float>& image) const
 }
 
 
+//: The grid in the image co-ordinates of \p image
+bool
+ihog_world_roi::image_grid( const ihog_image<float>& image,
+                            double& x0, double& y0, double& dx1, double& dy1,
+                            double& dx2, double& dy2) const
+{
+  const ihog_transform_2d& w2i = image.world2im();
+  if (w2i.form()==ihog_transform_2d::Projective)
+    return false;
+  // as in ihog_sample_grid_bilin()
+  vgl_point_2d<double> im_p0 = w2i(p0_);
+  x0 = im_p0.x(); y0 = im_p0.y();
+  dx1 = dy1 = dx2 = dy2 = 0.0;
+  if (n_u_>1) {
+    vgl_vector_2d<double> im_u = (w2i(p0_+(n_u_-1.0)*u_)-im_p0)/(n_u_-1.0);
+    dx1 = im_u.x(); dy1 = im_u.y();
+  }
+  if (n_v_>1) {
+    vgl_vector_2d<double> im_v = (w2i(p0_+(n_v_-1.0)*v_)-im_p0)/(n_v_-1.0);
+    dx2 = im_v.x(); dy2 = im_v.y();
+  }
+  return true;
+}
+
+
 //: Create a vector of weights for the sample of \p image
 //  Weights are based on distance from the image boundaries
 vnl_vector<double>
@@ -36,6 +36,14 @@ class ihog_world_roi : public vbl_ref_count
   //: Sample the image in the ROI and return a vector of values
   vnl_vector<double> sample( const ihog_image<float>& image) const;
 
+  //: The grid in the image co-ordinates of \p image
+  //  Grid point (i,j) lies at (x0,y0)+i.(dx1,dy1)+j.(dx2,dy2) in the image.
+  //  Returns false if the world to image transform is projective, as the
+  //  steps are then not constant.
+  bool image_grid( const ihog_image<float>& image,
+                   double& x0, double& y0, double& dx1, double& dy1,
+                   double& dx2, double& dy2) const;
+
   //: Create a vector of weights for the sample of \p image
   //  Weights are based on distance from the image boundaries
   vnl_vector<double> sample_weights( const ihog_image<float>& image) const;
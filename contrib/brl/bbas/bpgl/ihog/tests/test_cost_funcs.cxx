@@ -0,0 +1,119 @@
+#include <iostream>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <vgl/vgl_vector_2d.h>
+#include <vgl/vgl_point_2d.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_sample_grid_bilin.h>
+#include <vnl/vnl_vector.h>
+#include <vnl/vnl_double_2x3.h>
+
+#include <ihog/ihog_transform_2d.h>
+#include <ihog/ihog_world_roi.h>
+#include <ihog/ihog_image.h>
+#include <ihog/ihog_sample_grid_bilin.h>
+#include <ihog/ihog_minfo_cost_func.h>
+#include <ihog/ihog_lsqr_cost_func.h>
+
+static vil_image_view<float> test_image(unsigned ni, unsigned nj)
+{
+  vil_image_view<float> img(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      img(i,j) = float(127.5 + 60.0*std::sin(0.11*i + 0.05*j) + 60.0*std::cos(0.07*j - 0.03*i*i/ni));
+  return img;
+}
+
+static void test_sample_rows()
+{
+  vil_image_view<float> img = test_image(61, 47);
+  // a rotated, scaled grid that runs off the image on two sides, and one inside it
+  double grids[2][6] = { { -3.3, 5.1, 0.93, 0.31, -0.27, 0.88 },
+                         { 7.25, 3.5, 0.75, 0.1, -0.1, 0.65 } };
+  int n1 = 67, n2 = 53;
+  for (unsigned g = 0; g<2; ++g) {
+    double const* d = grids[g];
+    vnl_vector<double> ref(n1*n2);
+    vil_sample_grid_bilin(ref.data_block(), img, d[0], d[1], d[2], d[3], d[4], d[5], n1, n2);
+    vnl_vector<double> rows(n1*n2, -1.0);
+    // in two bands, as the cost functions do
+    ihog_sample_grid_bilin_rows(rows.data_block(), img, d[0], d[1], d[2], d[3], d[4], d[5], n2, 0, 20);
+    ihog_sample_grid_bilin_rows(rows.data_block()+20*n2, img, d[0], d[1], d[2], d[3], d[4], d[5], n2, 20, n1);
+    double max_err = 0.0;
+    unsigned n_zero = 0;
+    for (int k = 0; k<n1*n2; ++k) {
+      max_err = std::max(max_err, std::fabs(ref[k]-rows[k]));
+      if (ref[k]==0.0) ++n_zero;
+    }
+    std::cout << "grid " << g << ": max error " << max_err << ", " << n_zero << " samples outside\n";
+    TEST_NEAR("rows match vil_sample_grid_bilin", max_err, 0.0, 1e-9);
+    TEST("outside samples", g==0 ? n_zero>0 : n_zero==0, true);
+  }
+}
+
+static void test_cost_funcs()
+{
+  test_sample_rows();
+
+  unsigned ni = 120, nj = 100;
+  vil_image_view<float> img0 = test_image(ni, nj);
+  vil_image_view<float> mask(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      mask(i,j) = (i+j)%7 ? 1.0f : 0.0f;
+
+  vnl_double_2x3 H(std::cos(0.05), std::sin(0.05), 3.0,
+                   -std::sin(0.05), std::cos(0.05), -2.0);
+  ihog_transform_2d xform;
+  xform.set_affine(H);
+  ihog_image<float> warped;
+  ihog_resample_bilin(ihog_image<float>(img0, xform.inverse()), warped,
+                      vgl_point_2d<double>(0,0), vgl_vector_2d<double>(1,0),
+                      vgl_vector_2d<double>(0,1), ni, nj);
+
+  ihog_world_roi roi(ni-10, nj-10, vgl_point_2d<double>(5,5));
+  ihog_image<float> from_img(img0), to_img(warped.image()), mask_img(mask);
+  ihog_transform_2d near_xform;
+  near_xform.set_rigid_body(0.04, 2.0, -1.0);
+  vnl_vector<double> x;
+  near_xform.params(x);
+
+  // the reference: the whole grid sampled in double precision
+  ihog_image<float> test_img(to_img);
+  test_img.set_world2im(near_xform*to_img.world2im());
+  vnl_vector<double> from_s = roi.sample(from_img), to_s = roi.sample(test_img);
+  vnl_vector<double> mask_s = roi.sample(mask_img);
+  double ref_mi = ihog_minfo_cost_func::entropy_diff(mask_s, from_s, to_s, 16);
+
+  ihog_minfo_cost_func minfo(from_img, to_img, mask_img, roi, near_xform, true);
+  minfo.set_num_threads(1);
+  double mi1 = minfo.f(x);
+  minfo.set_num_threads(3);
+  double mi3 = minfo.f(x);
+  std::cout << "mutual info cost " << mi1 << ", reference " << ref_mi << '\n';
+  TEST_NEAR("minfo matches the reference", mi1, ref_mi, 1e-12);
+  TEST("minfo independent of thread count", mi1 == mi3, true);
+  TEST("minfo repeatable", minfo.f(x) == mi3, true);
+
+  // a to mask as well; the rows path must agree with entropy_diff of the masked samples
+  ihog_image<float> to_mask_test(mask_img);
+  to_mask_test.set_world2im(near_xform*to_img.world2im());
+  vnl_vector<double> both_s = element_product(mask_s, roi.sample(to_mask_test));
+  double ref_mi2 = ihog_minfo_cost_func::entropy_diff(both_s, from_s, to_s, 16);
+  ihog_minfo_cost_func minfo2(from_img, to_img, mask_img, mask_img, roi, near_xform);
+  TEST_NEAR("minfo with two masks", minfo2.f(x), ref_mi2, 1e-12);
+
+  ihog_lsqr_cost_func lsqr(from_img, to_img, mask_img, roi, near_xform, true);
+  vnl_vector<double> fx1(lsqr.get_number_of_residuals()), fx3(lsqr.get_number_of_residuals());
+  lsqr.set_num_threads(1);
+  lsqr.f(x, fx1);
+  lsqr.set_num_threads(3);
+  lsqr.f(x, fx3);
+  vnl_vector<double> ref_fx = element_product(mask_s, from_s - to_s);
+  TEST("lsqr residual count", fx1.size(), ref_fx.size());
+  TEST_NEAR("lsqr matches the reference", (fx1-ref_fx).inf_norm(), 0.0, 1e-9);
+  TEST("lsqr independent of thread count", fx1 == fx3, true);
+}
+
+TESTMAIN( test_cost_funcs );
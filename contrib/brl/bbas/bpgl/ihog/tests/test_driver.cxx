@@ -2,11 +2,13 @@
 
 
 DECLARE( test_minimizer );
+DECLARE( test_cost_funcs );
 
 void
 register_tests()
 {
   REGISTER( test_minimizer );
+  REGISTER( test_cost_funcs );
 }
 
 DEFINE_MAIN;
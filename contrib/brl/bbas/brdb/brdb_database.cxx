@@ -48,6 +48,7 @@ brdb_database::brdb_database(std::vector<brdb_relation_sptr> relations, std::vec
 int
 brdb_database::size() const
 {
+  brdb_read_locker lock(lock_);
   return relations_.size(); // because vcl_mat will crash if it is empty
 }
 
@@ -55,6 +56,7 @@ brdb_database::size() const
 void
 brdb_database::clear()
 {
+  brdb_write_locker lock(lock_);
   relations_.clear();
 }
 
@@ -63,9 +65,7 @@ brdb_database::clear()
 bool
 brdb_database::exists(const std::string& name) const
 {
-  if (empty())
-    return false;
-
+  brdb_read_locker lock(lock_);
   std::map<std::string, brdb_relation_sptr>::const_iterator itr = relations_.find(name);
   return itr != relations_.end();
 }
@@ -76,14 +76,11 @@ bool
 brdb_database::exists(const std::string& relation_name,
                       const std::string& attribute_name) const
 {
-  if (empty())
-    return false;
-
-  std::map<std::string, brdb_relation_sptr>::const_iterator itr = relations_.find(relation_name);
-  if (itr == relations_.end())
+  brdb_relation_sptr relation = this->get_relation(relation_name);
+  if (!relation)
     return false;
 
-  return itr->second->exists(attribute_name);
+  return relation->exists(attribute_name);
 }
 
 
@@ -91,15 +88,16 @@ brdb_database::exists(const std::string& relation_name,
 bool
 brdb_database::add_tuple(const std::string& name, const brdb_tuple_sptr& new_tuple)
 {
-  std::map<std::string, brdb_relation_sptr>::iterator itr = relations_.find(name);
-  if (itr == relations_.end())
+  // the relation locks its tuples, so the database needs only be locked for the lookup
+  brdb_relation_sptr relation = this->get_relation(name);
+  if (!relation)
   {
     std::cerr << "Database warning: trying to add new tuple to an unknown relation: "
              << name << std::endl;
     return false;
   }
 
-  return itr->second->add_tuple(new_tuple);
+  return relation->add_tuple(new_tuple);
 }
 
 
@@ -107,6 +105,7 @@ brdb_database::add_tuple(const std::string& name, const brdb_tuple_sptr& new_tup
 bool
 brdb_database::remove_relation(const std::string& name)
 {
+  brdb_write_locker lock(lock_);
   std::map<std::string, brdb_relation_sptr>::iterator itr = relations_.find(name);
   if (itr == relations_.end())
   {
@@ -124,15 +123,15 @@ brdb_database::remove_relation(const std::string& name)
 bool
 brdb_database::clear_relation(const std::string& name)
 {
-  std::map<std::string, brdb_relation_sptr>::iterator itr = relations_.find(name);
-  if (itr == relations_.end())
+  brdb_relation_sptr relation = this->get_relation(name);
+  if (!relation)
   {
     std::cerr << "Database warning: trying to clear a relation that does not exist: "
              << name << std::endl;
     return false;
   }
 
-  itr->second->clear();
+  relation->clear();
   return true;
 }
 
@@ -143,6 +142,7 @@ brdb_database::add_relation(const std::string& name, const brdb_relation_sptr& n
 {
   //std::cout << "Adding relation " << name << '\n';
 
+  brdb_write_locker lock(lock_);
   std::map<std::string, brdb_relation_sptr>::iterator itr = relations_.find(name);
   if (itr != relations_.end())
   {
@@ -159,6 +159,7 @@ brdb_database::add_relation(const std::string& name, const brdb_relation_sptr& n
 brdb_relation_sptr
 brdb_database::get_relation(const std::string& name) const
 {
+  brdb_read_locker lock(lock_);
   std::map<std::string, brdb_relation_sptr>::const_iterator itr = relations_.find(name);
   if (itr == relations_.end())
     return VXL_NULLPTR;
@@ -166,10 +167,27 @@ brdb_database::get_relation(const std::string& name) const
 }
 
 
+//: index the tuples of a relation by the value of an attribute
+bool
+brdb_database::create_index(const std::string& relation_name, const std::string& attribute_name)
+{
+  brdb_relation_sptr relation = this->get_relation(relation_name);
+  if (!relation)
+  {
+    std::cerr << "Database warning: trying to index a relation that does not exist: "
+             << relation_name << std::endl;
+    return false;
+  }
+
+  return relation->create_index(attribute_name);
+}
+
+
 //: print the whole database
 void
 brdb_database::print() const
 {
+  brdb_read_locker lock(lock_);
   std::cout << "\n<<<<<<<<<<<<<<<<<<<<---- Printing database ---->>>>>>>>>>>>>>>>>>>>>>>\n";
   std::map<std::string, brdb_relation_sptr>::const_iterator itr = relations_.begin();
   for (; itr != relations_.end(); itr++)
@@ -188,6 +206,7 @@ brdb_database::get_all_relation_names() const
 {
   std::set<std::string> names;
 
+  brdb_read_locker lock(lock_);
   for (std::map<std::string, brdb_relation_sptr>::const_iterator itr = relations_.begin(); itr != relations_.end(); ++itr)
   {
     names.insert((*itr).first);
@@ -201,17 +220,17 @@ brdb_database::get_all_relation_names() const
 brdb_relation_sptr
 brdb_database::join(const std::string& r1, const std::string& r2) const
 {
-  std::map<std::string, brdb_relation_sptr>::const_iterator find_r1 = relations_.find(r1);
-  std::map<std::string, brdb_relation_sptr>::const_iterator find_r2 = relations_.find(r2);
+  brdb_relation_sptr find_r1 = this->get_relation(r1);
+  brdb_relation_sptr find_r2 = this->get_relation(r2);
 
-  if (find_r1 == relations_.end() || find_r2 == relations_.end())
+  if (!find_r1 || !find_r2)
   {
     std::cerr << "Database warning: trying to join relation that does not exist in database: "
              << r1 << " or " << r2 << std::endl;
     return VXL_NULLPTR;
   }
 
-  return brdb_join(find_r1->second, find_r2->second);
+  return brdb_join(find_r1, find_r2);
 }
 
 
@@ -219,8 +238,7 @@ brdb_database::join(const std::string& r1, const std::string& r2) const
 bool
 brdb_database::join(const std::string& r1, const std::string& r2, const std::string& result )
 {
-  std::map<std::string, brdb_relation_sptr>::iterator itr = relations_.find(result);
-  if (itr != relations_.end()){
+  if (this->exists(result)){
     return false;
   }
 
@@ -236,14 +254,13 @@ brdb_database::join(const std::string& r1, const std::string& r2, const std::str
 brdb_selection_sptr
 brdb_database::select(const std::string& relation_name, brdb_query_aptr q) const
 {
-  if (!exists(relation_name)){
+  brdb_relation_sptr relation = this->get_relation(relation_name);
+  if (!relation){
     std::cerr << "Database warning: trying to select in a nonexisting relation: "
              << relation_name << std::endl;
     return VXL_NULLPTR;
   }
 
-  brdb_relation_sptr relation = this->get_relation(relation_name);
-
   return new brdb_selection(relation, q);
 }
 
@@ -256,27 +273,36 @@ brdb_database::merge(const brdb_database_sptr& other)
   if (this == other.ptr())
     return false;
 
+  typedef std::map<std::string, brdb_relation_sptr> r_map;
+
+  // copy the relations of the other database, so that the two locks are never held together
+  r_map other_relations;
+  {
+    brdb_read_locker lock(other->lock_);
+    other_relations = other->relations_;
+  }
+
+  brdb_write_locker lock(lock_);
+
   // simple copying case
-  if (this->empty())
+  if (this->relations_.empty())
   {
-    this->relations_ = other->relations_;
+    this->relations_ = other_relations;
     return true;
   }
 
-  typedef std::map<std::string, brdb_relation_sptr> r_map;
-
   // copy the current relations so that the original relations
   // are only modified if all merging is successful.
   r_map new_relations(this->relations_);
 
   // for each relation in the other database
-  for (r_map::iterator oi = other->relations_.begin();
-       oi!=other->relations_.end(); ++oi)
+  for (r_map::iterator oi = other_relations.begin();
+       oi!=other_relations.end(); ++oi)
   {
     // look for a relation with the same name in this database
     r_map::iterator ti = new_relations.find(oi->first);
     // if not found
-    if (ti == this->relations_.end())
+    if (ti == new_relations.end())
     {
       new_relations.insert(*oi);
       continue;
@@ -309,7 +335,8 @@ void brdb_database::b_write(vsl_b_ostream os)
   vsl_b_write(os, ver);
 
   // then write the size of the database
-  unsigned int database_size = this->size();
+  brdb_read_locker lock(lock_);
+  unsigned int database_size = static_cast<unsigned int>(relations_.size());
   vsl_b_write(os, database_size);
 
   // the write each relation and it name
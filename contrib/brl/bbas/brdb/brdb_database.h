@@ -25,9 +25,14 @@
 #include <brdb/brdb_selection_sptr.h>
 #include <brdb/brdb_query.h>
 #include <brdb/brdb_database_sptr.h>
+#include <brdb/brdb_rw_lock.h>
 #include <vsl/vsl_binary_io.h>
 
 
+//: A database of named relations
+//  The relations are looked up, added and removed under a reader-writer
+//  lock, and each relation locks its own tuples, so that several threads
+//  can share a database.
 class brdb_database : public vbl_ref_count
 {
 public:
@@ -67,6 +72,9 @@ public:
   //: get a relation by name
   brdb_relation_sptr get_relation(const std::string& name) const;
 
+  //: index the tuples of a relation by the value of an attribute (see brdb_relation::create_index)
+  bool create_index(const std::string& relation_name, const std::string& attribute_name);
+
   //: print the whole database
   void print() const;
 
@@ -93,6 +101,8 @@ public:
 
 private:
   std::map<std::string, brdb_relation_sptr> relations_;
+  //: guards the map of relations
+  mutable brdb_rw_lock lock_;
 };
 
 
@@ -15,6 +15,13 @@
 #include <brdb/brdb_tuple.h>
 #include <brdb/brdb_tuple_sptr.h>
 #include <brdb/brdb_value.h>
+#include <vxl_config.h>
+
+#if VXL_HAS_PTHREAD_H
+#include <pthread.h>
+//: guards the creation of the instance and the ids (statically initialized, so usable before main)
+static pthread_mutex_t brdb_database_manager_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 brdb_database_sptr brdb_database_manager::instance_ = VXL_NULLPTR;
 
@@ -22,10 +29,30 @@ unsigned brdb_database_manager::id_ = 0;
 //: Insure only one instance is created
 brdb_database_sptr brdb_database_manager::instance()
 {
+#if VXL_HAS_PTHREAD_H
+  pthread_mutex_lock(&brdb_database_manager_mutex);
+#endif
   if (!instance_){
     instance_ = new brdb_database();
   }
-  return brdb_database_manager::instance_;
+  brdb_database_sptr db = brdb_database_manager::instance_;
+#if VXL_HAS_PTHREAD_H
+  pthread_mutex_unlock(&brdb_database_manager_mutex);
+#endif
+  return db;
+}
+
+//: a unique id
+unsigned brdb_database_manager::id()
+{
+#if VXL_HAS_PTHREAD_H
+  pthread_mutex_lock(&brdb_database_manager_mutex);
+#endif
+  unsigned id = id_++;
+#if VXL_HAS_PTHREAD_H
+  pthread_mutex_unlock(&brdb_database_manager_mutex);
+#endif
+  return id;
 }
 
 //: clear all relations
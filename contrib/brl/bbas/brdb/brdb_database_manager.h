@@ -28,8 +28,8 @@ class brdb_database_manager
   //: the global database instance
   static brdb_database_sptr instance();
 
-  //: a unique id
-  static unsigned id() {return id_++;}
+  //: a unique id, also when called from several threads
+  static unsigned id();
 
   //: clear all relations
   static bool clear_all();
@@ -0,0 +1,83 @@
+// This is brl/bbas/brdb/brdb_index.h
+#ifndef brdb_index_h_
+#define brdb_index_h_
+//:
+// \file
+// \brief An ordered index of the tuples of a relation by the value of one attribute
+//
+//  A brdb_relation keeps an index for each attribute named in
+//  create_index().  The index holds a typed copy of the values of the
+//  attribute, ordered by the operator< of the value type (the one used by
+//  brdb_value::lt), with the positions of their tuples in the relation.
+//  A comparison query on the attribute is then answered with a binary
+//  search instead of a virtual comparison with each tuple.
+//
+//  Indices are created by brdb_value::make_index(), so every value type
+//  instantiated with BRDB_VALUE_INSTANTIATE can be indexed.
+//
+// \verbatim
+//  Modifications
+//   None
+// \endverbatim
+
+#include <vector>
+#include <map>
+#include <vcl_compiler.h>
+#include <brdb/brdb_query.h>
+
+//: An index of tuple positions by value (abstract base class)
+class brdb_index
+{
+ public:
+  virtual ~brdb_index() {}
+
+  //: Create a copy of the index on the heap
+  virtual brdb_index* clone() const = 0;
+
+  //: the number of indexed tuples
+  virtual unsigned size() const = 0;
+
+  //: remove all the entries
+  virtual void clear() = 0;
+
+  //: add the tuple at \p position in the relation whose value is \p value
+  //  Returns false if \p value is not of the indexed type.
+  virtual bool insert(const brdb_value& value, unsigned position) = 0;
+
+  //: append the positions of the tuples whose value passes the comparison \p type with \p value
+  //  The positions are appended in increasing order.  Returns false if
+  //  \p value is not of the indexed type.
+  virtual bool select(brdb_query::comp_type type, const brdb_value& value,
+                      std::vector<unsigned>& positions) const = 0;
+};
+
+
+//: An index of the values of type T
+template <class T>
+class brdb_index_t : public brdb_index
+{
+ public:
+  brdb_index_t() {}
+
+  virtual brdb_index* clone() const { return new brdb_index_t<T>(*this); }
+
+  virtual unsigned size() const { return static_cast<unsigned>(entries_.size()); }
+
+  virtual void clear() { entries_.clear(); }
+
+  virtual bool insert(const brdb_value& value, unsigned position);
+
+  virtual bool select(brdb_query::comp_type type, const brdb_value& value,
+                      std::vector<unsigned>& positions) const;
+
+ private:
+  typedef std::multimap<T, unsigned> map_type;
+  //: append the positions of the entries in [begin, end)
+  static void append(typename map_type::const_iterator begin,
+                     typename map_type::const_iterator end,
+                     std::vector<unsigned>& positions);
+
+  map_type entries_;
+};
+
+#endif // brdb_index_h_
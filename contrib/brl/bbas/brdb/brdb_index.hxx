@@ -0,0 +1,91 @@
+// This is brl/bbas/brdb/brdb_index.hxx
+#ifndef brdb_index_hxx_
+#define brdb_index_hxx_
+//:
+// \file
+// \brief Templated code for brdb_index_t
+//
+//  Instantiated with brdb_value_t (see BRDB_VALUE_INSTANTIATE).
+
+#include <algorithm>
+#include "brdb_index.h"
+#include "brdb_value.h"
+#include <vcl_cassert.h>
+
+template <class T>
+bool
+brdb_index_t<T>::insert(const brdb_value& value, unsigned position)
+{
+  const brdb_value_t<T>* v = dynamic_cast<const brdb_value_t<T>*>(&value);
+  if (!v)
+    return false;
+  // the tuples are mostly appended, so the end is a good hint
+  entries_.insert(entries_.end(), typename map_type::value_type(v->value(), position));
+  return true;
+}
+
+
+template <class T>
+void
+brdb_index_t<T>::append(typename map_type::const_iterator begin,
+                        typename map_type::const_iterator end,
+                        std::vector<unsigned>& positions)
+{
+  std::size_t n = positions.size();
+  for (typename map_type::const_iterator it = begin; it != end; ++it)
+    positions.push_back(it->second);
+  std::sort(positions.begin()+n, positions.end());
+}
+
+
+template <class T>
+bool
+brdb_index_t<T>::select(brdb_query::comp_type type, const brdb_value& value,
+                        std::vector<unsigned>& positions) const
+{
+  const brdb_value_t<T>* v = dynamic_cast<const brdb_value_t<T>*>(&value);
+  if (!v)
+    return false;
+  T key = v->value();
+  typename map_type::const_iterator b = entries_.begin(), e = entries_.end();
+  switch (type)
+  {
+   case brdb_query::EQ:
+    append(entries_.lower_bound(key), entries_.upper_bound(key), positions);
+    break;
+   case brdb_query::NEQ:
+   {
+    std::size_t n = positions.size();
+    typename map_type::const_iterator lo = entries_.lower_bound(key), hi = entries_.upper_bound(key);
+    for (typename map_type::const_iterator it = b; it != lo; ++it)
+      positions.push_back(it->second);
+    for (typename map_type::const_iterator it = hi; it != e; ++it)
+      positions.push_back(it->second);
+    std::sort(positions.begin()+n, positions.end());
+    break;
+   }
+   case brdb_query::LT:
+    append(b, entries_.lower_bound(key), positions);
+    break;
+   case brdb_query::LEQ:
+    append(b, entries_.upper_bound(key), positions);
+    break;
+   case brdb_query::GT:
+    append(entries_.upper_bound(key), e, positions);
+    break;
+   case brdb_query::GEQ:
+    append(entries_.lower_bound(key), e, positions);
+    break;
+   case brdb_query::ALL:
+    append(b, e, positions);
+    break;
+   case brdb_query::NONE:
+    break;
+   default:
+    assert(!"nonexisting operator; use EQ, NEQ, GT, GEQ, LT, LEQ, ALL or NONE");
+    return false;
+  }
+  return true;
+}
+
+#endif // brdb_index_hxx_
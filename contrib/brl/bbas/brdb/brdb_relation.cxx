@@ -1,5 +1,6 @@
 // This is brl/bbas/brdb/brdb_relation.cxx
 #include <set>
+#include <map>
 #include <iostream>
 #include <algorithm>
 #include "brdb_relation.h"
@@ -15,12 +16,15 @@
 #include <vsl/vsl_vector_io.h>
 #include <brdb/brdb_value.h>
 #include <brdb/brdb_tuple.h>
+#include <brdb/brdb_query.h>
+#include <brdb/brdb_index.h>
 
 //======================= Constructors / Destructors ========================
 
 
 //: Default Constructor (0-tuple)
 brdb_relation::brdb_relation()
+ : indices_valid_(true)
 {
   names_.clear();
   types_.clear();
@@ -32,7 +36,7 @@ brdb_relation::brdb_relation()
 //: Constructor - create an empty relation but define the columns
 brdb_relation::brdb_relation( const std::vector<std::string>& names,
                               const std::vector<std::string>& types )
- : names_(names), types_(types)
+ : names_(names), types_(types), indices_valid_(true)
 {
   assert(this->is_valid());
   // init the time stamp;
@@ -43,7 +47,7 @@ brdb_relation::brdb_relation( const std::vector<std::string>& names,
 brdb_relation::brdb_relation( const std::vector<std::string>& names,
                               const std::vector<brdb_tuple_sptr>& tuples,
                               const std::vector<std::string>& types )
- : names_(names), types_(types), tuples_(tuples)
+ : names_(names), types_(types), tuples_(tuples), indices_valid_(true)
 {
   // if no types are specified infer them from the data
   if (types_.empty())
@@ -66,9 +70,46 @@ brdb_relation::brdb_relation( const std::vector<std::string>& names,
   this->time_stamp_ = 0;
 }
 
+//: Copy Constructor
+brdb_relation::brdb_relation(const brdb_relation& other)
+ : vbl_ref_count(), indices_valid_(true)
+{
+  *this = other;
+}
+
+//: Assignment operator
+brdb_relation&
+brdb_relation::operator = (const brdb_relation& rhs)
+{
+  if (this == &rhs)
+    return *this;
+  // copy the other relation first, so that the two locks are never held together
+  std::vector<brdb_index*> indices;
+  std::vector<std::string> names, types;
+  std::vector<brdb_tuple_sptr> tuples;
+  unsigned long time_stamp;
+  bool indices_valid;
+  {
+    brdb_read_locker lock(rhs.lock_);
+    names = rhs.names_;  types = rhs.types_;  tuples = rhs.tuples_;
+    time_stamp = rhs.time_stamp_;
+    indices_valid = rhs.indices_valid_;
+    for (unsigned int i=0; i<rhs.indices_.size(); ++i)
+      indices.push_back(rhs.indices_[i] ? rhs.indices_[i]->clone() : VXL_NULLPTR);
+  }
+  brdb_write_locker lock(lock_);
+  this->delete_indices();
+  names_.swap(names);  types_.swap(types);  tuples_.swap(tuples);
+  time_stamp_ = time_stamp;
+  indices_.swap(indices);
+  indices_valid_ = indices_valid;
+  return *this;
+}
+
 //: Destructor
 brdb_relation::~brdb_relation()
 {
+  this->delete_indices();
 }
 
 
@@ -117,7 +158,9 @@ brdb_relation::is_valid(const brdb_tuple_sptr& tuple) const
 bool
 brdb_relation::set_value(std::vector<brdb_tuple_sptr>::iterator pos, const std::string& name, const brdb_value& value)
 {
+  brdb_write_locker lock(lock_);
   update_timestamp();
+  indices_valid_ = false;
 
   return (*pos)->set_value(index(name), value);
 }
@@ -200,7 +243,6 @@ brdb_relation::exists(const std::string& name) const
 bool
 brdb_relation::order_by(const std::string& name, bool ascending)
 {
-   update_timestamp();
    return this->order_by(this->index(name), ascending);
 }
 
@@ -208,7 +250,9 @@ brdb_relation::order_by(const std::string& name, bool ascending)
 bool
 brdb_relation::order_by(unsigned int index, bool ascending)
 {
+  brdb_write_locker lock(lock_);
   update_timestamp();
+  indices_valid_ = false;
 
   if (index < names_.size()){
     if (ascending)
@@ -225,11 +269,13 @@ brdb_relation::order_by(unsigned int index, bool ascending)
 bool
 brdb_relation::add_tuple(const brdb_tuple_sptr& new_tuple)
 {
+  brdb_write_locker lock(lock_);
   update_timestamp();
 
   if (is_valid(new_tuple))
   {
     tuples_.push_back(new brdb_tuple(*new_tuple));
+    this->index_tuple(this->size()-1);
 
     return true;
   }
@@ -242,12 +288,18 @@ brdb_relation::add_tuple(const brdb_tuple_sptr& new_tuple)
 bool
 brdb_relation::insert_tuple(const brdb_tuple_sptr& new_tuple, const std::vector<brdb_tuple_sptr>::iterator& pos)
 {
+  brdb_write_locker lock(lock_);
   update_timestamp();
 
   if (is_valid(new_tuple))
   {
     brdb_tuple_sptr ins_tuple = new brdb_tuple(*new_tuple);
+    // the tuples after pos move, so their positions in the indices change
+    if (pos != tuples_.end())
+      indices_valid_ = false;
     tuples_.insert(pos, ins_tuple);
+    if (indices_valid_)
+      this->index_tuple(this->size()-1);
 
     return true;
   }
@@ -260,7 +312,9 @@ brdb_relation::insert_tuple(const brdb_tuple_sptr& new_tuple, const std::vector<
 bool
 brdb_relation::remove_tuple(const std::vector<brdb_tuple_sptr>::iterator& pos)
 {
+  brdb_write_locker lock(lock_);
   update_timestamp();
+  indices_valid_ = false;
 
   // erase a tuple
   tuples_.erase(pos);
@@ -272,6 +326,7 @@ brdb_relation::remove_tuple(const std::vector<brdb_tuple_sptr>::iterator& pos)
 void
 brdb_relation::print() const
 {
+  brdb_read_locker lock(lock_);
   // print the attributes name and type
   for (unsigned int i=0; i<arity(); i++)
   {
@@ -290,12 +345,15 @@ brdb_relation::print() const
 void
 brdb_relation::b_read(vsl_b_istream &is)
 {
-  update_timestamp();
-
-  // clear the relation including tuples, names and types.
+  // clear the relation including tuples, names, types and indices.
   this->clear();
-  this->names_.clear();
-  this->types_.clear();
+  {
+    brdb_write_locker lock(lock_);
+    update_timestamp();
+    this->delete_indices();
+    this->names_.clear();
+    this->types_.clear();
+  }
 
   // first read the version
   unsigned int ver;
@@ -336,6 +394,8 @@ brdb_relation::b_read(vsl_b_istream &is)
 void
 brdb_relation::b_write(vsl_b_ostream &os) const
 {
+  brdb_read_locker lock(lock_);
+
   // first write the version
   unsigned int ver = 1;
   vsl_b_write(os, ver);
@@ -377,8 +437,13 @@ brdb_relation::check_timestamp(const unsigned& time_stamp_check) const
 void
 brdb_relation::clear()
 {
+  brdb_write_locker lock(lock_);
   this->update_timestamp();
-  return tuples_.clear();
+  tuples_.clear();
+  for (unsigned int i=0; i<indices_.size(); ++i)
+    if (indices_[i])
+      indices_[i]->clear();
+  indices_valid_ = true;
 }
 
 //: check whether another relation is compatible with this relation;
@@ -431,14 +496,153 @@ brdb_relation::merge(const brdb_relation_sptr& other)
   if (!other || !this->is_compatible(other))
     return false;
 
-  for (std::vector<brdb_tuple_sptr>::const_iterator itr = other->tuples_.begin();
-       itr != other->tuples_.end(); ++itr)
+  std::vector<brdb_tuple_sptr> tuples;
+  {
+    brdb_read_locker lock(other->lock_);
+    tuples = other->tuples_;
+  }
+  brdb_write_locker lock(lock_);
+  for (std::vector<brdb_tuple_sptr>::const_iterator itr = tuples.begin();
+       itr != tuples.end(); ++itr)
   {
     tuples_.push_back(new brdb_tuple(**itr));
+    this->index_tuple(this->size()-1);
+  }
+  return true;
+}
+
+
+//========================= Indices ===========================
+
+//: Index the tuples by the value of the attribute with \p name
+bool
+brdb_relation::create_index(const std::string& name)
+{
+  brdb_write_locker lock(lock_);
+  unsigned int attr = this->index(name);
+  if (attr >= this->arity())
+    return false;
+  if (attr < indices_.size() && indices_[attr])
+    return true;
+  // the registered exemplar of the value type makes the typed index
+  std::map<std::string, const brdb_value*>::const_iterator reg = brdb_value::registry().find(types_[attr]);
+  brdb_index* idx = reg != brdb_value::registry().end() ? reg->second->make_index() : VXL_NULLPTR;
+  if (!idx)
+    return false;
+  if (indices_.size() < this->arity())
+    indices_.resize(this->arity(), VXL_NULLPTR);
+  indices_[attr] = idx;
+  if (indices_valid_) {
+    for (unsigned int i=0; i<tuples_.size(); ++i)
+      idx->insert((*tuples_[i])[attr], i);
   }
   return true;
 }
 
+//: Remove the index of the attribute with \p name
+bool
+brdb_relation::drop_index(const std::string& name)
+{
+  brdb_write_locker lock(lock_);
+  unsigned int attr = this->index(name);
+  if (attr >= indices_.size() || !indices_[attr])
+    return false;
+  delete indices_[attr];
+  indices_[attr] = VXL_NULLPTR;
+  return true;
+}
+
+//: Return true if the attribute with \p name is indexed
+bool
+brdb_relation::has_index(const std::string& name) const
+{
+  brdb_read_locker lock(lock_);
+  unsigned int attr = this->index(name);
+  return attr < indices_.size() && indices_[attr] != VXL_NULLPTR;
+}
+
+//: Rebuild the indices on their next use
+void
+brdb_relation::invalidate_indices()
+{
+  brdb_write_locker lock(lock_);
+  indices_valid_ = false;
+}
+
+//: Get the positions of the tuples that pass a comparison query, in increasing order
+void
+brdb_relation::select(const brdb_query_comp& query, std::vector<unsigned>& positions) const
+{
+  this->rebuild_invalid_indices();
+  brdb_read_locker lock(lock_);
+  this->select_locked(query, positions);
+}
+
+//: select as select() does, with the lock held
+void
+brdb_relation::select_locked(const brdb_query_comp& query, std::vector<unsigned>& positions) const
+{
+  unsigned int attr = this->index(query.attribute_name());
+  if (attr >= this->arity())
+    return;
+  bool indexed = indices_valid_ && attr < indices_.size() && indices_[attr];
+  if (!indexed || !indices_[attr]->select(query.comparison_type(), query.value(), positions))
+  {
+    for (unsigned int i=0; i<tuples_.size(); ++i)
+      if (query.pass((*tuples_[i])[attr]))
+        positions.push_back(i);
+  }
+}
+
+//: rebuild the indices if they are not valid, taking the write lock
+void
+brdb_relation::rebuild_invalid_indices() const
+{
+  {
+    brdb_read_locker lock(lock_);
+    if (indices_valid_)
+      return;
+  }
+  brdb_write_locker lock(lock_);
+  if (!indices_valid_)
+    this->rebuild_indices();
+}
+
+//: rebuild the indices from the tuples (with the write lock held)
+void
+brdb_relation::rebuild_indices() const
+{
+  for (unsigned int a=0; a<indices_.size(); ++a)
+  {
+    if (!indices_[a])
+      continue;
+    indices_[a]->clear();
+    for (unsigned int i=0; i<tuples_.size(); ++i)
+      indices_[a]->insert((*tuples_[i])[a], i);
+  }
+  indices_valid_ = true;
+}
+
+//: add the tuple at \p position to the indices (with the write lock held)
+void
+brdb_relation::index_tuple(unsigned position)
+{
+  if (!indices_valid_)
+    return;
+  for (unsigned int a=0; a<indices_.size(); ++a)
+    if (indices_[a])
+      indices_[a]->insert((*tuples_[position])[a], position);
+}
+
+//: delete the indices
+void
+brdb_relation::delete_indices()
+{
+  for (unsigned int a=0; a<indices_.size(); ++a)
+    delete indices_[a];
+  indices_.clear();
+}
+
 
 //========================= External Functions ===========================
 
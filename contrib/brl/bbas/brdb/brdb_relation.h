@@ -24,15 +24,28 @@
 #include <vbl/vbl_ref_count.h>
 #include <brdb/brdb_tuple_sptr.h>
 #include <brdb/brdb_relation_sptr.h>
+#include <brdb/brdb_rw_lock.h>
 #include <vsl/vsl_binary_io.h>
 
 // forward declarations
 class brdb_value;
-
-
-//: A database tuple
+class brdb_index;
+class brdb_query_comp;
+
+
+//: A database relation
+//  Attributes can be indexed (see create_index()) to answer comparison
+//  queries without visiting every tuple.  The member functions that add,
+//  remove, reorder or modify tuples and those that select or print them
+//  hold a reader-writer lock, so that several threads can add tuples to
+//  and select from one relation.  A brdb_selection holds the lock while it
+//  selects tuples and while it reads or changes them.  The iterators of the
+//  relation, and those of brdb_selection::begin(), are not protected by the
+//  lock and are only valid until the relation changes.
 class brdb_relation : public vbl_ref_count
 {
+  friend class brdb_selection;
+
   //======================= Constructors / Destructors ========================
  public:
   // Default Constructor
@@ -49,6 +62,12 @@ class brdb_relation : public vbl_ref_count
                  const std::vector<brdb_tuple_sptr>& tuples,
                  const std::vector<std::string>& types = std::vector<std::string>() );
 
+  //: Copy Constructor
+  brdb_relation(const brdb_relation& other);
+
+  //: Assignment operator
+  brdb_relation& operator = (const brdb_relation& rhs);
+
   // Destructor
   virtual ~brdb_relation();
 
@@ -139,6 +158,26 @@ class brdb_relation : public vbl_ref_count
   //: if compatible, add tuples from the other relation into this one
   bool merge(const brdb_relation_sptr& other);
 
+  //========================= Indices ===========================
+
+  //: Index the tuples by the value of the attribute with \p name
+  //  Returns false if there is no such attribute or its type can not be indexed.
+  bool create_index(const std::string& name);
+
+  //: Remove the index of the attribute with \p name
+  bool drop_index(const std::string& name);
+
+  //: Return true if the attribute with \p name is indexed
+  bool has_index(const std::string& name) const;
+
+  //: Rebuild the indices on their next use
+  //  Call this after changing tuples through the iterators of the relation.
+  void invalidate_indices();
+
+  //: Get the positions of the tuples that pass a comparison query, in increasing order
+  //  Uses the index of the attribute if there is one, otherwise compares each tuple.
+  void select(const brdb_query_comp& query, std::vector<unsigned>& positions) const;
+
  private:
   //: Verify that the data stored in this class make a valid relation
   // \note called by the constructors
@@ -150,6 +189,22 @@ class brdb_relation : public vbl_ref_count
   //: update the timestamp of this relation
   void update_timestamp();
 
+  //: rebuild the indices from the tuples (with the write lock held)
+  void rebuild_indices() const;
+
+  //: rebuild the indices if they are not valid, taking the write lock
+  void rebuild_invalid_indices() const;
+
+  //: select as select() does, with the lock held
+  //  Uses an index only if the indices are valid.
+  void select_locked(const brdb_query_comp& query, std::vector<unsigned>& positions) const;
+
+  //: add the tuple at \p position to the indices (with the write lock held)
+  void index_tuple(unsigned position);
+
+  //: delete the indices
+  void delete_indices();
+
  private:
   //: The time stamp of this relation
   unsigned long time_stamp_;
@@ -159,6 +214,12 @@ class brdb_relation : public vbl_ref_count
   std::vector<std::string> types_;
   //: The tuples of the attributes
   std::vector<brdb_tuple_sptr> tuples_;
+  //: The index of each attribute, null if it is not indexed
+  mutable std::vector<brdb_index*> indices_;
+  //: False if the indices must be rebuilt before they are used
+  mutable bool indices_valid_;
+  //: Guards the tuples and the indices
+  mutable brdb_rw_lock lock_;
 };
 
 
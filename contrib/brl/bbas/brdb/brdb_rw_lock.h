@@ -0,0 +1,75 @@
+// This is brl/bbas/brdb/brdb_rw_lock.h
+#ifndef brdb_rw_lock_h_
+#define brdb_rw_lock_h_
+//:
+// \file
+// \brief A reader-writer lock for the relations and the database
+//
+//  Any number of threads may hold the read lock at once, the write lock is
+//  exclusive.  Without pthreads the locks do nothing.  A copy of a lock is
+//  a new, unlocked lock, so that classes holding one can be copied.
+//
+// \verbatim
+//  Modifications
+//   None
+// \endverbatim
+
+#include <vxl_config.h>
+#include <vcl_compiler.h>
+
+#if VXL_HAS_PTHREAD_H
+# include <pthread.h>
+#endif
+
+class brdb_rw_lock
+{
+ public:
+  brdb_rw_lock() { init(); }
+  brdb_rw_lock(brdb_rw_lock const&) { init(); }
+  brdb_rw_lock& operator=(brdb_rw_lock const&) { return *this; }
+#if VXL_HAS_PTHREAD_H
+  ~brdb_rw_lock() { pthread_rwlock_destroy(&lock_); }
+
+  void read_lock() { pthread_rwlock_rdlock(&lock_); }
+  void write_lock() { pthread_rwlock_wrlock(&lock_); }
+  //: release a read or a write lock
+  void unlock() { pthread_rwlock_unlock(&lock_); }
+
+ private:
+  void init() { pthread_rwlock_init(&lock_, VXL_NULLPTR); }
+  pthread_rwlock_t lock_;
+#else
+  void read_lock() {}
+  void write_lock() {}
+  void unlock() {}
+
+ private:
+  void init() {}
+#endif
+};
+
+//: Holds the read lock of a brdb_rw_lock while in scope
+class brdb_read_locker
+{
+ public:
+  brdb_read_locker(brdb_rw_lock& lock) : lock_(lock) { lock_.read_lock(); }
+  ~brdb_read_locker() { lock_.unlock(); }
+ private:
+  brdb_rw_lock& lock_;
+  brdb_read_locker(brdb_read_locker const&);
+  brdb_read_locker& operator=(brdb_read_locker const&);
+};
+
+//: Holds the write lock of a brdb_rw_lock while in scope
+class brdb_write_locker
+{
+ public:
+  brdb_write_locker(brdb_rw_lock& lock) : lock_(lock) { lock_.write_lock(); }
+  ~brdb_write_locker() { lock_.unlock(); }
+ private:
+  brdb_rw_lock& lock_;
+  brdb_write_locker(brdb_write_locker const&);
+  brdb_write_locker& operator=(brdb_write_locker const&);
+};
+
+#endif // brdb_rw_lock_h_
@@ -19,6 +19,8 @@
 brdb_selection::brdb_selection(const brdb_relation_sptr& relation, brdb_query_aptr query)
   : relation_(relation), query_(query)
 {
+  relation_->rebuild_invalid_indices();
+  brdb_read_locker lock(relation_->lock_);
   this->time_stamp_ = relation->get_timestamp();
   produce(query_, selected_set_);
 }
@@ -28,6 +30,8 @@ brdb_selection::brdb_selection(const brdb_selection_sptr& selection, brdb_query_
 {
   if (selection && selection->relation_ && selection->query_.get()) {
     this->relation_ = selection->relation_;
+    relation_->rebuild_invalid_indices();
+    brdb_read_locker lock(relation_->lock_);
     this->time_stamp_ = relation_->get_timestamp();
     selection->check_and_update();
     this->selected_set_ = selection->selected_set_;
@@ -58,7 +62,7 @@ selection_t::const_iterator
 brdb_selection::begin()
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
   return selected_set_.begin();
 }
 
@@ -67,7 +71,7 @@ selection_t::const_iterator
 brdb_selection::end()
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
   return selected_set_.end();
 }
 
@@ -76,7 +80,7 @@ bool
 brdb_selection::empty()
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
   return selected_set_.empty();
 }
 
@@ -84,11 +88,15 @@ brdb_selection::empty()
 bool
 brdb_selection::update_selected_tuple(const brdb_tuple_sptr& new_tuple)
 {
+  if (this->relation_ == VXL_NULLPTR)
+    return false;
+
   // check and make sure that the selection is updated.
+  brdb_write_locker lock(relation_->lock_);
   this->check_and_update();
 
   // make sure that the size of this selection is 1;
-  if (size()!=1)
+  if (selected_set_.size()!=1)
   {
     std::cout << "DB Selection error: trying to update tuples with zero or more than one new tuples. " << std::endl;
     return false;
@@ -97,6 +105,7 @@ brdb_selection::update_selected_tuple(const brdb_tuple_sptr& new_tuple)
   selection_t::iterator itr = selected_set_.begin();
 
   (*(*(itr))) = new_tuple;
+  relation_->indices_valid_ = false;
   return true;
 }
 
@@ -104,11 +113,15 @@ brdb_selection::update_selected_tuple(const brdb_tuple_sptr& new_tuple)
 bool
 brdb_selection::update_selected_tuple(const std::string& attribute_name, const brdb_value& value)
 {
+  if (this->relation_ == VXL_NULLPTR)
+    return false;
+
   // check and make sure that the selection is updated.
+  brdb_write_locker lock(relation_->lock_);
   this->check_and_update();
 
   // make sure that the size of this selection is 1;
-  if (size()!=1)
+  if (selected_set_.size()!=1)
   {
     std::cout << "DB Selection error: trying to update tuples with zero or more than one new tuple. " << std::endl;
     return false;
@@ -117,7 +130,9 @@ brdb_selection::update_selected_tuple(const std::string& attribute_name, const b
   selection_t::iterator itr = selected_set_.begin();
 
   unsigned int index = this->relation_->index(attribute_name);
-  return (*(*(itr)))->set_value(index, value);
+  bool set = (*(*(itr)))->set_value(index, value);
+  relation_->indices_valid_ = false;
+  return set;
 }
 
 
@@ -126,10 +141,10 @@ bool
 brdb_selection::get_value(const std::string& attribute_name, brdb_value& value)
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
 
   // make sure that the size of this selection is 1;
-  if (size()!=1)
+  if (selected_set_.size()!=1)
   {
     std::cout << "DB Selection error: trying to update tuples with zero or more than one new tuple. " << std::endl;
     return false;
@@ -146,10 +161,10 @@ brdb_selection::get_value(const std::string& attribute_name,
                           brdb_value_sptr& value)
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
 
   // make sure that the size of this selection is 1;
-  if (size()!=1)
+  if (selected_set_.size()!=1)
   {
     std::cout << "DB Selection error: trying to update tuples with zero or more than one new tuple. " << std::endl;
     return false;
@@ -166,9 +181,9 @@ bool
 brdb_selection::get_value(const std::string& attribute_name, unsigned int index, brdb_value& value)
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
 
-  if (index >= size())
+  if (index >= selected_set_.size())
   {
     std::cout << "DB warning: trying to get value from an invalid index!" << std::endl;
     return false;
@@ -192,7 +207,7 @@ brdb_relation_sptr
 brdb_selection::get_sqlview()
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
 
   // get the names and types information from selection;
   unsigned int arity = relation_->arity();
@@ -206,7 +221,7 @@ brdb_selection::get_sqlview()
 
   brdb_relation_sptr sql_view = new brdb_relation(names, types);
 
-  if (size() == 0)
+  if (selected_set_.empty())
     return sql_view;
 
   for (selection_t::const_iterator itr = selected_set_.begin();
@@ -233,7 +248,7 @@ brdb_selection::selection_and(const brdb_selection_sptr& s)
   result->query_ = brdb_query_aptr(new brdb_query_and(*this->query_, *s->query_));
 
   // check and make sure that each selection is updated.
-  this->check_and_update();
+  reader lock(this);
   s->check_and_update();
 
   std::set_intersection(this->selected_set_.begin(), this->selected_set_.end(),
@@ -260,7 +275,7 @@ brdb_selection::selection_or(const brdb_selection_sptr& s)
   result->query_ = brdb_query_aptr(new brdb_query_or(*this->query_, *s->query_));
 
   // check and make sure that each selection is updated.
-  this->check_and_update();
+  reader lock(this);
   s->check_and_update();
 
   std::set_union(this->selected_set_.begin(), this->selected_set_.end(),
@@ -287,7 +302,7 @@ brdb_selection::selection_xor(const brdb_selection_sptr& s)
   result->query_ = brdb_query_aptr(new brdb_query_or(*this->query_, *s->query_));
 
   // check and make sure that each selection is updated.
-  this->check_and_update();
+  reader lock(this);
   s->check_and_update();
 
   std::set_symmetric_difference(
@@ -307,7 +322,7 @@ brdb_selection::selection_not()
   result->query_ = this->query_->complement();
 
   // check and make sure that each selection is updated.
-  this->check_and_update();
+  reader lock(this);
 
   for (std::vector<brdb_tuple_sptr>::iterator itr = relation_->begin();
        itr != relation_->end(); ++itr)
@@ -329,7 +344,7 @@ void
 brdb_selection::print()
 {
     // check and make sure that the selection is updated.
-    this->check_and_update();
+    reader lock(this);
 
     std::cout << "print selection: " << std::endl;
 
@@ -356,23 +371,23 @@ brdb_selection::print()
 void
 brdb_selection::delete_tuples()
 {
+    if (this->relation_ == VXL_NULLPTR)
+      return;
+
     // check and make sure that the selection is updated.
+    brdb_write_locker lock(relation_->lock_);
     this->check_and_update();
 
-    if (empty())
+    if (selected_set_.empty())
     {
       return;
     }
 
     // deletion must be done from back to front, because each time an element is deleted, the iterators after it will be updated.
-    selection_t::iterator itr = selected_set_.end();
-    // notice, everytime anything happens to the original relation, the size() will reflect the new information.
-    unsigned int original_selection_size = this->size();
-    for (unsigned int i=0; i<original_selection_size; i++)
-    {
-      --itr;
-      relation_->remove_tuple((*itr));
-    }
+    for (selection_t::reverse_iterator itr = selected_set_.rbegin(); itr != selected_set_.rend(); ++itr)
+      relation_->tuples_.erase(*itr);
+    relation_->update_timestamp();
+    relation_->indices_valid_ = false;
 
     // clear the selection;
     selected_set_.clear();
@@ -383,7 +398,7 @@ unsigned int
 brdb_selection::size()
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
+  reader lock(this);
   return selected_set_.size();
 }
 
@@ -393,12 +408,9 @@ bool
 brdb_selection::tuple_exist(const brdb_tuple_sptr& tuple)
 {
   // check and make sure that the selection is updated.
-  this->check_and_update();
-
-  if (this->empty())
-    return false;
+  reader lock(this);
 
-  for (selection_t::const_iterator itr = this->begin(); itr != this->end(); ++ itr)
+  for (selection_t::const_iterator itr = selected_set_.begin(); itr != selected_set_.end(); ++ itr)
   {
     if ((*(*itr)) == tuple)
       return true;
@@ -418,6 +430,26 @@ brdb_selection::contains(const std::vector<brdb_tuple_sptr>::iterator& relation_
 }
 
 
+//: take the read lock of the relation, after rebuilding its invalid indices, and update the selection
+void
+brdb_selection::read_lock()
+{
+  if (this->relation_ == VXL_NULLPTR)
+    return;
+  relation_->rebuild_invalid_indices();
+  relation_->lock_.read_lock();
+  this->check_and_update();
+}
+
+//: release the lock taken by read_lock()
+void
+brdb_selection::unlock()
+{
+  if (this->relation_ != VXL_NULLPTR)
+    relation_->lock_.unlock();
+}
+
+
 //: check timestamp of selection and update selection if needed;
 void
 brdb_selection::check_and_update()
@@ -454,17 +486,14 @@ brdb_selection::produce(const brdb_query_aptr& q, selection_t& s)
   }
   else if (const brdb_query_comp* qc = dynamic_cast<const brdb_query_comp*>(q.get()))
   {
-    unsigned int attr_index = relation_->index(qc->attribute_name());
-    // go through all the tuples
-    for (std::vector<brdb_tuple_sptr>::iterator itr = relation_->begin();
-         itr != relation_->end(); ++itr)
+    // the positions of the tuples that pass, from the index of the attribute if there is one
+    std::vector<unsigned> positions;
+    relation_->select_locked(*qc, positions);
+    std::vector<brdb_tuple_sptr>::iterator first = relation_->begin();
+    for (unsigned int i=0; i<positions.size(); ++i)
     {
-      // check the attribute against the query
-      if (qc->pass((*(*itr))[attr_index]))
-      {
-        //add the iterator to this tuple to selection
-        s.insert(itr);
-      }
+      //add the iterator to this tuple to selection, in increasing order
+      s.insert(s.end(), first + positions[i]);
     }
   }
   else
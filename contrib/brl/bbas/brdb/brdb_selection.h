@@ -26,6 +26,12 @@
 
 typedef std::set<std::vector<brdb_tuple_sptr>::iterator> selection_t;
 
+//: The tuples of a relation selected by a query
+//  The member functions hold the lock of the relation while they select
+//  tuples and read or change them, so that other threads may add tuples
+//  to the relation meanwhile.  The iterators returned by begin() and end()
+//  are only valid until the relation changes.  A selection itself should
+//  be used by one thread at a time.
 class brdb_selection : public vbl_ref_count
 {
  public:
@@ -128,9 +134,25 @@ class brdb_selection : public vbl_ref_count
   unsigned int size();
 
  private:
+  //: Holds the read lock of the relation of a selection, with the selection updated, while in scope
+  class reader
+  {
+   public:
+    reader(brdb_selection* s) : s_(s) { s_->read_lock(); }
+    ~reader() { s_->unlock(); }
+   private:
+    brdb_selection* s_;
+  };
+
   //: Constructor with no query
   brdb_selection(const brdb_relation_sptr& relation);
 
+  //: take the read lock of the relation, after rebuilding its invalid indices, and update the selection
+  void read_lock();
+
+  //: release the lock taken by read_lock()
+  void unlock();
+
   //: check timestamp of selection and update selection if needed;
   void check_and_update();
 
@@ -23,6 +23,7 @@
 
 // forward declaration
 template< class T > class brdb_value_t;
+class brdb_index;
 
 //: This abstract class is the base class for database values
 class brdb_value : public vbl_ref_count
@@ -70,6 +71,10 @@ class brdb_value : public vbl_ref_count
   //: Print out the value
   virtual void print() const = 0;
 
+  //: Create an empty index of values of this type on the heap, or null if they can not be indexed
+  // The caller is responsible for deletion
+  virtual brdb_index* make_index() const { return VXL_NULLPTR; }
+
   //: Return a const reference to the global registry of database value classes
   static std::map<std::string, const brdb_value*> const & registry() { return mut_registry(); }
 
@@ -188,6 +193,9 @@ class brdb_value_t : public brdb_value
   //: Return the string identifying this class
   virtual void print() const { std::cout << value_ << "   ";}
 
+  //: Create an empty index of values of type T
+  virtual brdb_index* make_index() const;
+
   //: Return the value
   T value() const { return value_; }
 
@@ -13,6 +13,7 @@
 // \endverbatim
 
 #include "brdb_value.h"
+#include "brdb_index.hxx"
 #include <vcl_cassert.h>
 #include <vbl/io/vbl_io_smart_ptr.h>
 
@@ -50,6 +51,15 @@ brdb_value_t<T>::assign(const brdb_value& other)
 }
 
 
+//: Create an empty index of values of type T
+template< class T >
+brdb_index*
+brdb_value_t<T>::make_index() const
+{
+  return new brdb_index_t<T>;
+}
+
+
 //: binary io read value only
 // handles only the value (without version or type info)
 template< class T >
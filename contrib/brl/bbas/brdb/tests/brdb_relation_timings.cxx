@@ -0,0 +1,119 @@
+//:
+// \file
+// \brief Timings of inserting into and selecting from a relation, with and without an index
+//        The relation has the (id, value) layout of the relations of the
+//        process database.  Tuples are appended with increasing ids, then
+//        single tuples are selected by id as set_input_from_db() does,
+//        first by comparing every tuple and then with an index of the ids.
+//        Finally several threads add tuples to and select them from one
+//        indexed relation of a database.
+//        Usage: brdb_relation_timings [n_tuples [n_selects [n_threads]]]
+
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <brdb/brdb_value.h>
+#include <brdb/brdb_tuple.h>
+#include <brdb/brdb_relation.h>
+#include <brdb/brdb_selection.h>
+#include <brdb/brdb_query.h>
+#include <brdb/brdb_database.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vul/vul_timer.h>
+#include <vcl_compiler.h>
+
+static brdb_relation_sptr make_relation()
+{
+  std::vector<std::string> names(2), types(2);
+  names[0] = "id";    types[0] = brdb_value_t<unsigned>::type();
+  names[1] = "value"; types[1] = brdb_value_t<float>::type();
+  return new brdb_relation(names, types);
+}
+
+//: insert n tuples, returns the rate in tuples per second
+static double time_inserts(brdb_relation_sptr const& r, unsigned n)
+{
+  vul_timer t;
+  for (unsigned i = 0; i < n; ++i)
+    r->add_tuple(new brdb_tuple(i, float(i)));
+  return n/(t.real()/1000.0 + 1e-9);
+}
+
+//: select and read n_selects single tuples by id, returns the rate in selects per second
+static double time_selects(brdb_relation_sptr const& r, unsigned n_selects, unsigned& n_found)
+{
+  unsigned n = r->size();
+  n_found = 0;
+  vul_timer t;
+  for (unsigned k = 0; k < n_selects; ++k) {
+    unsigned id = unsigned((k*2654435761u) % n);
+    brdb_selection_sptr s = new brdb_selection(r, brdb_query_comp_new("id", brdb_query::EQ, id));
+    brdb_value_sptr v;
+    if (s->size() == 1 && s->get_value(std::string("value"), v))
+      ++n_found;
+  }
+  return n_selects/(t.real()/1000.0 + 1e-9);
+}
+
+//: Adds tuples to a relation of a database and selects each back
+class brdb_timings_body : public vpl_parallel_for_body
+{
+ public:
+  brdb_timings_body(brdb_database_sptr const& db) : db_(db) {}
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned i = begin; i < end; ++i) {
+      db_->add_tuple("float_data", new brdb_tuple(i, float(i)));
+      brdb_selection_sptr s = db_->select("float_data", brdb_query_comp_new("id", brdb_query::EQ, i));
+      s->size();
+    }
+  }
+ private:
+  brdb_database_sptr db_;
+};
+
+int main(int argc, char** argv)
+{
+  unsigned n = argc > 1 ? std::atoi(argv[1]) : 100000;
+  unsigned n_selects = argc > 2 ? std::atoi(argv[2]) : 1000;
+  unsigned n_threads = argc > 3 ? std::atoi(argv[3]) : 0;
+  n_threads = vpl_parallel_for_num_threads(n_threads);
+
+  brdb_relation_sptr plain = make_relation(), indexed = make_relation();
+  indexed->create_index("id");
+  std::cout << "inserting " << n << " tuples\n"
+            << "  without an index: " << time_inserts(plain, n) << " tuples/s\n"
+            << "  with an index:    " << time_inserts(indexed, n) << " tuples/s\n";
+
+  unsigned found_plain, found_indexed;
+  double rate_plain = time_selects(plain, n_selects, found_plain);
+  double rate_indexed = time_selects(indexed, n_selects, found_indexed);
+  std::cout << "selecting " << n_selects << " tuples by id from " << n << '\n'
+            << "  without an index: " << rate_plain << " selects/s\n"
+            << "  with an index:    " << rate_indexed << " selects/s ("
+            << rate_indexed/rate_plain << " times faster)\n";
+  if (found_plain != n_selects || found_indexed != n_selects) {
+    std::cerr << "missing tuples: " << found_plain << ' ' << found_indexed << '\n';
+    return 1;
+  }
+
+  // add and select on one thread, then on several
+  for (unsigned pass = 0; pass < 2; ++pass) {
+    unsigned threads = pass == 0 ? 1 : n_threads;
+    brdb_database_sptr db = new brdb_database();
+    db->add_relation("float_data", make_relation());
+    db->create_index("float_data", "id");
+    brdb_timings_body body(db);
+    vul_timer t;
+    vpl_parallel_for(n, body, threads, 64);
+    double s = t.real()/1000.0 + 1e-9;
+    std::cout << "adding and selecting " << n << " tuples of a database on " << threads << " thread(s): "
+              << n/s << " pairs/s\n";
+    if (db->get_relation("float_data")->size() != n) {
+      std::cerr << "lost tuples\n";
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -6,6 +6,7 @@ DECLARE( test_tuple );
 DECLARE( test_relation );
 DECLARE( test_database );
 DECLARE( test_query );
+DECLARE( test_index );
 //DECLARE( test_database_manager );
 
 void
@@ -16,6 +17,7 @@ register_tests()
   REGISTER( test_relation );
   REGISTER( test_database );
   REGISTER( test_query );
+  REGISTER( test_index );
 //  REGISTER( test_database_manager );
 }
 
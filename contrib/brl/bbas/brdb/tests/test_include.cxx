@@ -11,5 +11,7 @@
 #include <brdb/brdb_database_manager.h>
 #include <brdb/brdb_query.h>
 #include <brdb/brdb_query_aptr.h>
+#include <brdb/brdb_index.h>
+#include <brdb/brdb_rw_lock.h>
 
 int main() { return 0; }
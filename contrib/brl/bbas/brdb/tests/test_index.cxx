@@ -0,0 +1,162 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <testlib/testlib_test.h>
+#include <brdb/brdb_value.h>
+#include <brdb/brdb_tuple.h>
+#include <brdb/brdb_relation.h>
+#include <brdb/brdb_selection.h>
+#include <brdb/brdb_query.h>
+#include <brdb/brdb_database.h>
+#include <brdb/brdb_database_manager.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+
+//: the ids of the tuples selected by \p q, in the order of the relation
+static std::vector<int> selected_ids(const brdb_relation_sptr& r, brdb_query_aptr q)
+{
+  std::vector<int> ids;
+  brdb_selection_sptr s = new brdb_selection(r, q);
+  for (unsigned i = 0; i < s->size(); ++i) {
+    int id;
+    s->get("id", i, id);
+    ids.push_back(id);
+  }
+  return ids;
+}
+
+//: true if each comparison of \p attr with \p v selects the same tuples in \p a and \p b
+template <class T>
+static bool same_selections(const brdb_relation_sptr& a, const brdb_relation_sptr& b,
+                            const std::string& attr, const T& v)
+{
+  brdb_query::comp_type types[] = { brdb_query::EQ, brdb_query::NEQ, brdb_query::LT, brdb_query::LEQ,
+                                    brdb_query::GT, brdb_query::GEQ, brdb_query::ALL, brdb_query::NONE };
+  for (unsigned t = 0; t < 8; ++t)
+    if (selected_ids(a, brdb_query_comp_new(attr, types[t], v)) != selected_ids(b, brdb_query_comp_new(attr, types[t], v)))
+      return false;
+  return true;
+}
+
+//: Adds tuples to a relation of the database and reads them back through selections, on several threads
+class test_index_body : public vpl_parallel_for_body
+{
+ public:
+  test_index_body(brdb_database_sptr const& db, unsigned n_threads) : n_failed_(n_threads, 0), db_(db) {}
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    for (unsigned k = begin; k < end; ++k) {
+      unsigned id = brdb_database_manager::id();
+      brdb_tuple_sptr t = new brdb_tuple(id, float(k));
+      bool good = db_->add_tuple("float_data", t);
+      brdb_selection_sptr s = db_->select("float_data", brdb_query_comp_new("id", brdb_query::EQ, id));
+      // read the tuple back through the selection while the other threads add theirs
+      unsigned id_read = 0;
+      float value = -1.0f;
+      if (!good || !s || s->size() != 1 || !s->get("value", value) || !s->get("id", 0, id_read) ||
+          value != float(k) || id_read != id)
+        ++n_failed_[thread_id];
+    }
+  }
+  //: the number of failures of each thread
+  std::vector<unsigned> n_failed_;
+ private:
+  brdb_database_sptr db_;
+};
+
+static void test_index()
+{
+  std::vector<std::string> names(3), types(3);
+  names[0] = "id";    types[0] = brdb_value_t<int>::type();
+  names[1] = "value"; types[1] = brdb_value_t<double>::type();
+  names[2] = "name";  types[2] = brdb_value_t<std::string>::type();
+
+  // values with duplicates, in no order
+  brdb_relation_sptr indexed = new brdb_relation(names, types);
+  for (int i = 0; i < 200; ++i) {
+    char name[2] = { char('a' + (i*7)%13), 0 };
+    indexed->add_tuple(new brdb_tuple(i, double((i*37)%50), std::string(name)));
+  }
+  brdb_relation_sptr plain = new brdb_relation(*indexed);
+
+  TEST("create index", indexed->create_index("value"), true);
+  TEST("create index twice", indexed->create_index("value"), true);
+  TEST("index a string", indexed->create_index("name"), true);
+  TEST("no such attribute", indexed->create_index("nothing"), false);
+  TEST("has index", indexed->has_index("value") && indexed->has_index("name") && !indexed->has_index("id"), true);
+  TEST("copy has no index", plain->has_index("value"), false);
+
+  TEST("EQ selects the duplicates", selected_ids(indexed, brdb_query_comp_new("value", brdb_query::EQ, 11.0)).size(), 4);
+  TEST("comparisons of an indexed double", same_selections(indexed, plain, "value", 11.0), true);
+  TEST("comparisons beyond the values", same_selections(indexed, plain, "value", 100.0) &&
+                                        same_selections(indexed, plain, "value", -1.0), true);
+  TEST("comparisons of an indexed string", same_selections(indexed, plain, "name", std::string("f")), true);
+
+  // appended tuples are indexed as they are added
+  for (int i = 200; i < 220; ++i) {
+    indexed->add_tuple(new brdb_tuple(i, 11.0, std::string("z")));
+    plain->add_tuple(new brdb_tuple(i, 11.0, std::string("z")));
+  }
+  TEST("after adding tuples", same_selections(indexed, plain, "value", 11.0), true);
+
+  // changes that move tuples rebuild the index
+  indexed->remove_tuple(indexed->begin() + 3);  plain->remove_tuple(plain->begin() + 3);
+  indexed->insert_tuple(new brdb_tuple(-1, 11.0, std::string("y")), indexed->begin() + 5);
+  plain->insert_tuple(new brdb_tuple(-1, 11.0, std::string("y")), plain->begin() + 5);
+  TEST("after removing and inserting", same_selections(indexed, plain, "value", 11.0), true);
+  indexed->order_by("name");  plain->order_by("name");
+  TEST("after ordering", same_selections(indexed, plain, "value", 11.0) &&
+                         same_selections(indexed, plain, "name", std::string("z")), true);
+  indexed->set_value(indexed->begin(), "value", brdb_value_t<double>(1000.0));
+  plain->set_value(plain->begin(), "value", brdb_value_t<double>(1000.0));
+  TEST("after setting a value", same_selections(indexed, plain, "value", 1000.0), true);
+
+  // a value changed through a selection
+  brdb_selection_sptr s = new brdb_selection(indexed, brdb_query_comp_new("id", brdb_query::EQ, 7));
+  s->update_selected_tuple_value("value", 2000.0);
+  s = new brdb_selection(plain, brdb_query_comp_new("id", brdb_query::EQ, 7));
+  s->update_selected_tuple_value("value", 2000.0);
+  TEST("after updating a selection", same_selections(indexed, plain, "value", 2000.0), true);
+
+  // selections that combine comparisons
+  std::vector<int> a = selected_ids(indexed, brdb_query_comp_new("value", brdb_query::GT, 10.0) &
+                                             brdb_query_comp_new("name", brdb_query::LEQ, std::string("f")));
+  std::vector<int> b = selected_ids(plain, brdb_query_comp_new("value", brdb_query::GT, 10.0) &
+                                           brdb_query_comp_new("name", brdb_query::LEQ, std::string("f")));
+  TEST("and of two indexed comparisons", !a.empty() && a == b, true);
+
+  // an index on a copied relation and after clearing
+  brdb_relation_sptr copy = new brdb_relation(*indexed);
+  TEST("copied index", copy->has_index("value") && same_selections(copy, plain, "value", 11.0), true);
+  indexed->clear();
+  TEST("cleared", selected_ids(indexed, brdb_query_comp_new("value", brdb_query::ALL, 0.0)).size(), 0);
+  indexed->add_tuple(new brdb_tuple(1, 5.0, std::string("a")));
+  TEST("indexed after clearing", selected_ids(indexed, brdb_query_comp_new("value", brdb_query::EQ, 5.0)).size(), 1);
+  TEST("drop index", indexed->drop_index("value") && !indexed->has_index("value"), true);
+  TEST("copy keeps its index", copy->has_index("value"), true);
+
+  // several threads add to and select from one relation of a database
+  brdb_database_sptr db = new brdb_database();
+  std::vector<std::string> fnames(2), ftypes(2);
+  fnames[0] = "id";    ftypes[0] = brdb_value_t<unsigned>::type();
+  fnames[1] = "value"; ftypes[1] = brdb_value_t<float>::type();
+  db->add_relation("float_data", new brdb_relation(fnames, ftypes));
+  TEST("index in the database", db->create_index("float_data", "id"), true);
+  TEST("no relation to index", db->create_index("nothing_data", "id"), false);
+  unsigned n = 2000, n_threads = vpl_parallel_for_num_threads(4);
+  test_index_body body(db, n_threads);
+  vpl_parallel_for(n, body, n_threads, 16);
+  unsigned n_failed = 0;
+  for (unsigned t = 0; t < n_threads; ++t)
+    n_failed += body.n_failed_[t];
+  TEST("all added and selected", n_failed, 0);
+  TEST("number of tuples", db->get_relation("float_data")->size(), n);
+  bool unique = true;
+  brdb_relation_sptr r = db->get_relation("float_data");
+  r->order_by("id");
+  for (std::vector<brdb_tuple_sptr>::iterator it = r->begin(); it+1 < r->end(); ++it)
+    unique = unique && (**it)[0] < (**(it+1))[0];
+  TEST("unique ids", unique, true);
+}
+
+TESTMAIN(test_index);
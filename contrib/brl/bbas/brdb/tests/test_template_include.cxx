@@ -1,3 +1,4 @@
 #include <brdb/brdb_value.hxx>
+#include <brdb/brdb_index.hxx>
 
 int main() { return 0; }
@@ -0,0 +1,2 @@
+#include <bsta/algo/bsta_batch_fit.hxx>
+BSTA_BATCH_FIT_INSTANTIATE(float);
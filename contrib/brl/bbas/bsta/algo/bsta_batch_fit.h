@@ -0,0 +1,133 @@
+// This is brl/bbas/bsta/algo/bsta_batch_fit.h
+#ifndef bsta_batch_fit_h_
+#define bsta_batch_fit_h_
+//:
+// \file
+// \brief Accelerated k-means and EM fitting of mixtures, for single and batched sample sets
+//
+// bsta_k_means() computes the distance from every sample to every centre in
+// every pass, on vectors of vnl_vector.  The functions here work on flat
+// sample arrays stored by dimension (structure of arrays: sample i has
+// coordinates data[d*n + i], d < dim), which is the layout the boxm2 and volm
+// training code already gathers its samples in:
+//
+// - bsta_k_means_hamerly() is k-means with Hamerly's bounds: an upper bound
+//   on the distance to the assigned centre and a lower bound on the distance
+//   to every other centre are carried from pass to pass, so most samples are
+//   not compared against any centre once the clustering settles.  It reaches
+//   the same clustering as bsta_k_means (up to ties in the distances).
+// - bsta_fit_mixture_em() fits a mixture of Gaussians with independent
+//   dimensions by EM, initialised by bsta_k_means_hamerly().  The E-step
+//   computes the responsibilities of each component for all samples in one
+//   loop over contiguous arrays.
+// - bsta_k_means_batch() and bsta_fit_mixture_em_batch() fit many small,
+//   independent sample sets, spreading them over threads and reusing the
+//   work arrays of each thread.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <vcl_compiler.h>
+#include <bsta/bsta_mixture.h>
+#include <bsta/bsta_gaussian_indep.h>
+
+//: A mixture of Gaussians with independent dimensions as flat arrays
+template <class T>
+struct bsta_flat_mixture
+{
+  bsta_flat_mixture() : dim(0), log_likelihood(T(0)) {}
+
+  //: Number of components
+  unsigned size() const { return static_cast<unsigned>(weights.size()); }
+
+  //: Mean of dimension d of component c
+  T mean(unsigned c, unsigned d) const { return means[c*dim + d]; }
+  //: Variance of dimension d of component c
+  T var(unsigned c, unsigned d) const { return vars[c*dim + d]; }
+
+  unsigned dim;
+  //: the weight of each component
+  std::vector<T> weights;
+  //: component c has means[c*dim, (c+1)*dim)
+  std::vector<T> means;
+  //: component c has vars[c*dim, (c+1)*dim)
+  std::vector<T> vars;
+  //: log likelihood of the samples the mixture was fitted to
+  T log_likelihood;
+};
+
+//: Parameters of bsta_fit_mixture_em()
+template <class T>
+struct bsta_em_params
+{
+  bsta_em_params(unsigned k = 3, unsigned max_iter = 100, T tol = T(1e-6), T min_var = T(1e-6))
+  : k_(k), max_iter_(max_iter), tol_(tol), min_var_(min_var) {}
+
+  //: number of components (fewer if the k-means initialisation loses clusters)
+  unsigned k_;
+  //: maximum number of EM iterations
+  unsigned max_iter_;
+  //: stop when the log likelihood improves by less than tol times its magnitude
+  T tol_;
+  //: lower limit of the variances
+  T min_var_;
+};
+
+//: Find k cluster centres of n samples of dimension dim with Hamerly's algorithm
+//  data holds the samples by dimension (sample i is data[d*n + i]).
+//  centres holds k*dim values, centre c at [c*dim, (c+1)*dim).  If it has that
+//  size on entry it gives the initial centres; otherwise the first k samples
+//  are used.  As in bsta_k_means, centres without samples are removed and k is
+//  reduced.  If partition is given it receives the cluster of each sample.
+//  Returns the number of passes over the data.
+template <class T>
+unsigned bsta_k_means_hamerly(T const* data, unsigned n, unsigned dim, unsigned& k,
+                              std::vector<T>& centres,
+                              std::vector<unsigned>* partition = VXL_NULLPTR,
+                              unsigned max_iter = 1000);
+
+//: Fit a mixture of Gaussians with independent dimensions to n samples by EM
+//  data is laid out as for bsta_k_means_hamerly().  Returns the number of EM
+//  iterations.
+template <class T>
+unsigned bsta_fit_mixture_em(T const* data, unsigned n, unsigned dim,
+                             bsta_em_params<T> const& params,
+                             bsta_flat_mixture<T>& mixture);
+
+//: k-means of each of a batch of independent sample sets, on num_threads threads (0 = one per processor)
+//  Set s has sizes[s] samples at data[s], laid out as for bsta_k_means_hamerly(),
+//  and is initialised with its first k samples.  centres[s] and partitions[s]
+//  receive its result; ks[s] its number of clusters.
+template <class T>
+void bsta_k_means_batch(std::vector<T const*> const& data,
+                        std::vector<unsigned> const& sizes, unsigned dim, unsigned k,
+                        std::vector<std::vector<T> >& centres,
+                        std::vector<std::vector<unsigned> >& partitions,
+                        std::vector<unsigned>& ks,
+                        unsigned num_threads = 0);
+
+//: EM fit of a mixture to each of a batch of independent sample sets, on num_threads threads
+template <class T>
+void bsta_fit_mixture_em_batch(std::vector<T const*> const& data,
+                               std::vector<unsigned> const& sizes, unsigned dim,
+                               bsta_em_params<T> const& params,
+                               std::vector<bsta_flat_mixture<T> >& mixtures,
+                               unsigned num_threads = 0);
+
+//: Convert a flat mixture to a bsta mixture of bsta_gaussian_indep<T,n>
+template <class T, unsigned n>
+bsta_mixture<bsta_gaussian_indep<T,n> > bsta_to_mixture(bsta_flat_mixture<T> const& fm)
+{
+  bsta_mixture<bsta_gaussian_indep<T,n> > mix;
+  if (fm.dim != n)
+    return mix;
+  for (unsigned c = 0; c<fm.size(); ++c) {
+    vnl_vector_fixed<T,n> mean(&fm.means[c*n]), var(&fm.vars[c*n]);
+    mix.insert(bsta_gaussian_indep<T,n>(mean, var), fm.weights[c]);
+  }
+  return mix;
+}
+
+#endif // bsta_batch_fit_h_
@@ -0,0 +1,448 @@
+// This is brl/bbas/bsta/algo/bsta_batch_fit.hxx
+#ifndef bsta_batch_fit_hxx_
+#define bsta_batch_fit_hxx_
+//:
+// \file
+#include <vector>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "bsta_batch_fit.h"
+#include <vpl/vpl_parallel_for.h>
+#include <vnl/vnl_math.h>
+#include <vcl_cassert.h>
+
+//: Work arrays of the fitting functions, reused across the sets of a batch
+struct bsta_batch_fit_workspace
+{
+  std::vector<unsigned> assign, counts;
+  std::vector<double> upper, lower, half_sep, drift, centres, sums;
+  std::vector<double> resp, max_log, sum_exp;
+};
+
+//: Distance from sample i to centre c
+template <class T>
+inline double bsta_batch_fit_dist(T const* data, unsigned n, unsigned dim,
+                                  double const* centre, unsigned i)
+{
+  double s = 0.0;
+  for (unsigned d = 0; d<dim; ++d) {
+    double diff = double(data[std::size_t(d)*n + i]) - centre[d];
+    s += diff*diff;
+  }
+  return std::sqrt(s);
+}
+
+//: Nearest and second nearest centre distances of sample i (first index wins ties)
+template <class T>
+inline unsigned bsta_batch_fit_nearest(T const* data, unsigned n, unsigned dim,
+                                       std::vector<double> const& centres, unsigned k,
+                                       unsigned i, double& d1, double& d2)
+{
+  unsigned best = 0;
+  double s1 = std::numeric_limits<double>::infinity(), s2 = s1;
+  for (unsigned c = 0; c<k; ++c) {
+    double s = 0.0;
+    for (unsigned d = 0; d<dim; ++d) {
+      double diff = double(data[std::size_t(d)*n + i]) - centres[c*dim + d];
+      s += diff*diff;
+    }
+    if (s < s1) {
+      s2 = s1;
+      s1 = s;
+      best = c;
+    }
+    else if (s < s2)
+      s2 = s;
+  }
+  d1 = std::sqrt(s1);
+  d2 = std::sqrt(s2);
+  return best;
+}
+
+template <class T>
+unsigned bsta_k_means_hamerly(T const* data, unsigned n, unsigned dim, unsigned& k,
+                              std::vector<T>& centres, std::vector<unsigned>* partition,
+                              unsigned max_iter, bsta_batch_fit_workspace& ws)
+{
+  if (n == 0 || k == 0)
+    return 0;
+  assert(n >= k);
+
+  std::vector<double>& cen = ws.centres;
+  cen.resize(k*dim);
+  if (centres.size() == k*dim)
+    for (unsigned j = 0; j<k*dim; ++j)
+      cen[j] = centres[j];
+  else
+    for (unsigned c = 0; c<k; ++c)
+      for (unsigned d = 0; d<dim; ++d)
+        cen[c*dim + d] = data[std::size_t(d)*n + c];
+
+  std::vector<unsigned>& assign = ws.assign;
+  std::vector<double>& upper = ws.upper;
+  std::vector<double>& lower = ws.lower;
+  assign.resize(n);
+  upper.resize(n);
+  lower.resize(n);
+  for (unsigned i = 0; i<n; ++i)
+    assign[i] = bsta_batch_fit_nearest(data, n, dim, cen, k, i, upper[i], lower[i]);
+
+  unsigned iterations = 1;
+  bool changed = true;
+  while (true)
+  {
+    // new centres from the assignment; the samples are summed one dimension at a time
+    ws.sums.assign(k*dim, 0.0);
+    ws.counts.assign(k, 0);
+    for (unsigned i = 0; i<n; ++i)
+      ++ws.counts[assign[i]];
+    for (unsigned d = 0; d<dim; ++d) {
+      T const* x = data + std::size_t(d)*n;
+      for (unsigned i = 0; i<n; ++i)
+        ws.sums[assign[i]*dim + d] += x[i];
+    }
+
+    // remove the centres without samples, as bsta_k_means does
+    unsigned kk = 0;
+    std::vector<unsigned> index(k);
+    for (unsigned c = 0; c<k; ++c) {
+      index[c] = kk;
+      if (ws.counts[c] == 0)
+        continue;
+      for (unsigned d = 0; d<dim; ++d) {
+        cen[kk*dim + d] = cen[c*dim + d];
+        ws.sums[kk*dim + d] = ws.sums[c*dim + d];
+      }
+      ws.counts[kk++] = ws.counts[c];
+    }
+    if (kk < k) {
+      k = kk;
+      cen.resize(k*dim);
+      for (unsigned i = 0; i<n; ++i) {
+        assign[i] = index[assign[i]];
+        lower[i] = 0.0;
+      }
+      changed = true;
+    }
+
+    // move the centres
+    ws.drift.resize(k);
+    for (unsigned c = 0; c<k; ++c) {
+      double s = 0.0;
+      for (unsigned d = 0; d<dim; ++d) {
+        double m = ws.sums[c*dim + d]/ws.counts[c];
+        double diff = m - cen[c*dim + d];
+        s += diff*diff;
+        cen[c*dim + d] = m;
+      }
+      ws.drift[c] = std::sqrt(s);
+    }
+    if (!changed || iterations >= max_iter)
+      break;
+
+    // the bounds follow the centres
+    unsigned r1 = 0;
+    double max1 = 0.0, max2 = 0.0;
+    for (unsigned c = 0; c<k; ++c) {
+      if (ws.drift[c] > max1) {
+        max2 = max1;
+        max1 = ws.drift[c];
+        r1 = c;
+      }
+      else if (ws.drift[c] > max2)
+        max2 = ws.drift[c];
+    }
+    for (unsigned i = 0; i<n; ++i) {
+      upper[i] += ws.drift[assign[i]];
+      lower[i] -= assign[i] == r1 ? max2 : max1;
+    }
+
+    // half the distance from each centre to the nearest other centre
+    ws.half_sep.assign(k, std::numeric_limits<double>::infinity());
+    for (unsigned c = 0; c<k; ++c)
+      for (unsigned c2 = c+1; c2<k; ++c2) {
+        double s = 0.0;
+        for (unsigned d = 0; d<dim; ++d) {
+          double diff = cen[c*dim + d] - cen[c2*dim + d];
+          s += diff*diff;
+        }
+        double h = 0.5*std::sqrt(s);
+        ws.half_sep[c] = std::min(ws.half_sep[c], h);
+        ws.half_sep[c2] = std::min(ws.half_sep[c2], h);
+      }
+
+    changed = false;
+    for (unsigned i = 0; i<n; ++i) {
+      unsigned a = assign[i];
+      double m = std::max(ws.half_sep[a], lower[i]);
+      if (upper[i] <= m)
+        continue;
+      upper[i] = bsta_batch_fit_dist(data, n, dim, &cen[a*dim], i);
+      if (upper[i] <= m)
+        continue;
+      unsigned b = bsta_batch_fit_nearest(data, n, dim, cen, k, i, upper[i], lower[i]);
+      if (b != a) {
+        assign[i] = b;
+        changed = true;
+      }
+    }
+    ++iterations;
+  }
+
+  centres.resize(k*dim);
+  for (unsigned j = 0; j<k*dim; ++j)
+    centres[j] = T(cen[j]);
+  if (partition)
+    partition->assign(assign.begin(), assign.end());
+  return iterations;
+}
+
+template <class T>
+unsigned bsta_k_means_hamerly(T const* data, unsigned n, unsigned dim, unsigned& k,
+                              std::vector<T>& centres, std::vector<unsigned>* partition,
+                              unsigned max_iter)
+{
+  bsta_batch_fit_workspace ws;
+  return bsta_k_means_hamerly(data, n, dim, k, centres, partition, max_iter, ws);
+}
+
+template <class T>
+unsigned bsta_fit_mixture_em(T const* data, unsigned n, unsigned dim,
+                             bsta_em_params<T> const& params,
+                             bsta_flat_mixture<T>& mixture,
+                             bsta_batch_fit_workspace& ws)
+{
+  mixture.dim = dim;
+  mixture.weights.clear();
+  mixture.means.clear();
+  mixture.vars.clear();
+  mixture.log_likelihood = T(0);
+  unsigned k = std::min(params.k_, n);
+  if (k == 0)
+    return 0;
+
+  // k-means from samples spread evenly through the set
+  std::vector<T> centres(k*dim);
+  for (unsigned c = 0; c<k; ++c)
+    for (unsigned d = 0; d<dim; ++d)
+      centres[c*dim + d] = data[std::size_t(d)*n + std::size_t(c)*n/k];
+  bsta_k_means_hamerly(data, n, dim, k, centres, VXL_NULLPTR, 1000, ws);
+
+  // initial components from the clusters
+  std::vector<double> weight(k), mean(k*dim), var(k*dim, 0.0);
+  for (unsigned c = 0; c<k; ++c)
+    weight[c] = double(ws.counts[c])/n;
+  for (unsigned j = 0; j<k*dim; ++j)
+    mean[j] = ws.centres[j];
+  for (unsigned d = 0; d<dim; ++d) {
+    T const* x = data + std::size_t(d)*n;
+    for (unsigned i = 0; i<n; ++i) {
+      double diff = x[i] - mean[ws.assign[i]*dim + d];
+      var[ws.assign[i]*dim + d] += diff*diff;
+    }
+  }
+  const double min_var = params.min_var_;
+  for (unsigned c = 0; c<k; ++c)
+    for (unsigned d = 0; d<dim; ++d)
+      var[c*dim + d] = std::max(min_var, var[c*dim + d]/ws.counts[c]);
+
+  std::vector<double>& resp = ws.resp;
+  std::vector<double>& mx = ws.max_log;
+  std::vector<double>& se = ws.sum_exp;
+  resp.resize(std::size_t(k)*n);
+  mx.resize(n);
+  se.resize(n);
+  const double log_2pi = std::log(vnl_math::twopi);
+
+  unsigned iter = 0;
+  double prev_ll = -std::numeric_limits<double>::infinity(), ll = prev_ll;
+  while (iter < params.max_iter_)
+  {
+    // E-step: log of the weighted component densities, one component at a time
+    for (unsigned c = 0; c<k; ++c) {
+      double* r = &resp[std::size_t(c)*n];
+      double lw = weight[c] > 0.0 ? std::log(weight[c]) : -std::numeric_limits<double>::infinity();
+      for (unsigned d = 0; d<dim; ++d)
+        lw -= 0.5*(log_2pi + std::log(var[c*dim + d]));
+      std::fill(r, r + n, lw);
+      for (unsigned d = 0; d<dim; ++d) {
+        T const* x = data + std::size_t(d)*n;
+        const double m = mean[c*dim + d], h = 0.5/var[c*dim + d];
+        for (unsigned i = 0; i<n; ++i) {
+          double diff = x[i] - m;
+          r[i] -= h*diff*diff;
+        }
+      }
+    }
+    std::copy(resp.begin(), resp.begin() + n, mx.begin());
+    for (unsigned c = 1; c<k; ++c) {
+      double const* r = &resp[std::size_t(c)*n];
+      for (unsigned i = 0; i<n; ++i)
+        mx[i] = std::max(mx[i], r[i]);
+    }
+    std::fill(se.begin(), se.end(), 0.0);
+    for (unsigned c = 0; c<k; ++c) {
+      double* r = &resp[std::size_t(c)*n];
+      for (unsigned i = 0; i<n; ++i) {
+        r[i] = std::exp(r[i] - mx[i]);
+        se[i] += r[i];
+      }
+    }
+    ll = 0.0;
+    for (unsigned i = 0; i<n; ++i) {
+      ll += mx[i] + std::log(se[i]);
+      se[i] = 1.0/se[i];
+    }
+    // M-step
+    for (unsigned c = 0; c<k; ++c) {
+      double* r = &resp[std::size_t(c)*n];
+      double nc = 0.0;
+      for (unsigned i = 0; i<n; ++i) {
+        r[i] *= se[i];
+        nc += r[i];
+      }
+      weight[c] = nc/n;
+      if (nc <= 0.0)
+        continue;
+      for (unsigned d = 0; d<dim; ++d) {
+        T const* x = data + std::size_t(d)*n;
+        double s1 = 0.0;
+        for (unsigned i = 0; i<n; ++i)
+          s1 += r[i]*x[i];
+        const double m = s1/nc;
+        double s2 = 0.0;
+        for (unsigned i = 0; i<n; ++i) {
+          double diff = x[i] - m;
+          s2 += r[i]*diff*diff;
+        }
+        mean[c*dim + d] = m;
+        var[c*dim + d] = std::max(min_var, s2/nc);
+      }
+    }
+    ++iter;
+    if (std::fabs(ll - prev_ll) <= params.tol_*std::fabs(ll))
+      break;
+    prev_ll = ll;
+  }
+
+  mixture.weights.assign(weight.begin(), weight.end());
+  mixture.means.assign(mean.begin(), mean.end());
+  mixture.vars.assign(var.begin(), var.end());
+  mixture.log_likelihood = T(ll);
+  return iter;
+}
+
+template <class T>
+unsigned bsta_fit_mixture_em(T const* data, unsigned n, unsigned dim,
+                             bsta_em_params<T> const& params,
+                             bsta_flat_mixture<T>& mixture)
+{
+  bsta_batch_fit_workspace ws;
+  return bsta_fit_mixture_em(data, n, dim, params, mixture, ws);
+}
+
+//: k-means of a range of sample sets
+template <class T>
+struct bsta_k_means_batch_body : public vpl_parallel_for_body
+{
+  std::vector<T const*> const* data;
+  std::vector<unsigned> const* sizes;
+  unsigned dim, k;
+  std::vector<std::vector<T> >* centres;
+  std::vector<std::vector<unsigned> >* partitions;
+  std::vector<unsigned>* ks;
+  //: per thread work arrays
+  std::vector<bsta_batch_fit_workspace> ws;
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    for (unsigned s = begin; s<end; ++s) {
+      unsigned kk = std::min(k, (*sizes)[s]);
+      (*centres)[s].clear();
+      bsta_k_means_hamerly((*data)[s], (*sizes)[s], dim, kk, (*centres)[s],
+                           &(*partitions)[s], 1000, ws[thread_id]);
+      (*ks)[s] = kk;
+    }
+  }
+};
+
+template <class T>
+void bsta_k_means_batch(std::vector<T const*> const& data,
+                        std::vector<unsigned> const& sizes, unsigned dim, unsigned k,
+                        std::vector<std::vector<T> >& centres,
+                        std::vector<std::vector<unsigned> >& partitions,
+                        std::vector<unsigned>& ks,
+                        unsigned num_threads)
+{
+  assert(data.size() == sizes.size());
+  const unsigned ns = static_cast<unsigned>(data.size());
+  centres.resize(ns);
+  partitions.resize(ns);
+  ks.resize(ns);
+  bsta_k_means_batch_body<T> body;
+  body.data = &data;
+  body.sizes = &sizes;
+  body.dim = dim;
+  body.k = k;
+  body.centres = &centres;
+  body.partitions = &partitions;
+  body.ks = &ks;
+  body.ws.resize(vpl_parallel_for_num_threads(num_threads));
+  vpl_parallel_for(ns, body, num_threads);
+}
+
+//: EM fits of a range of sample sets
+template <class T>
+struct bsta_fit_mixture_em_batch_body : public vpl_parallel_for_body
+{
+  std::vector<T const*> const* data;
+  std::vector<unsigned> const* sizes;
+  unsigned dim;
+  bsta_em_params<T> const* params;
+  std::vector<bsta_flat_mixture<T> >* mixtures;
+  //: per thread work arrays
+  std::vector<bsta_batch_fit_workspace> ws;
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    for (unsigned s = begin; s<end; ++s)
+      bsta_fit_mixture_em((*data)[s], (*sizes)[s], dim, *params, (*mixtures)[s], ws[thread_id]);
+  }
+};
+
+template <class T>
+void bsta_fit_mixture_em_batch(std::vector<T const*> const& data,
+                               std::vector<unsigned> const& sizes, unsigned dim,
+                               bsta_em_params<T> const& params,
+                               std::vector<bsta_flat_mixture<T> >& mixtures,
+                               unsigned num_threads)
+{
+  assert(data.size() == sizes.size());
+  const unsigned ns = static_cast<unsigned>(data.size());
+  mixtures.resize(ns);
+  bsta_fit_mixture_em_batch_body<T> body;
+  body.data = &data;
+  body.sizes = &sizes;
+  body.dim = dim;
+  body.params = &params;
+  body.mixtures = &mixtures;
+  body.ws.resize(vpl_parallel_for_num_threads(num_threads));
+  vpl_parallel_for(ns, body, num_threads);
+}
+
+#undef BSTA_BATCH_FIT_INSTANTIATE
+#define BSTA_BATCH_FIT_INSTANTIATE(T) \
+template struct bsta_flat_mixture<T >; \
+template unsigned bsta_k_means_hamerly(T const*, unsigned, unsigned, unsigned&, std::vector<T >&, \
+                                       std::vector<unsigned>*, unsigned); \
+template unsigned bsta_fit_mixture_em(T const*, unsigned, unsigned, bsta_em_params<T > const&, \
+                                      bsta_flat_mixture<T >&); \
+template void bsta_k_means_batch(std::vector<T const*> const&, std::vector<unsigned> const&, \
+                                 unsigned, unsigned, std::vector<std::vector<T > >&, \
+                                 std::vector<std::vector<unsigned> >&, std::vector<unsigned>&, unsigned); \
+template void bsta_fit_mixture_em_batch(std::vector<T const*> const&, std::vector<unsigned> const&, \
+                                        unsigned, bsta_em_params<T > const&, \
+                                        std::vector<bsta_flat_mixture<T > >&, unsigned)
+
+#endif // bsta_batch_fit_hxx_
@@ -0,0 +1,728 @@
+// This is brl/bbas/bsta/algo/bsta_mog3_kernels.cxx
+#include <cmath>
+#include <algorithm>
+#include "bsta_mog3_kernels.h"
+//:
+// \file
+#include <vcl_cassert.h>
+#include <vxl_config.h>
+#include <vnl/vnl_math.h>
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+# include <emmintrin.h>
+#endif
+
+bsta_mog3_soa::bsta_mog3_soa(unsigned dim, unsigned n)
+: dim_(dim), n_(0)
+{
+  assert(dim == 1 || dim == 3);
+  resize(n);
+}
+
+void bsta_mog3_soa::resize(unsigned n)
+{
+  n_ = n;
+  data_.resize(std::size_t(n_planes())*n);
+  ncomp_.resize(n);
+}
+
+//: copy the mixture models[k] to index i of the arrays
+template <class mix_t, unsigned dim>
+static void pack_models(mix_t const* models, unsigned n, bsta_mog3_soa& soa, unsigned offset)
+{
+  assert(soa.dim() == dim);
+  assert(offset + n <= soa.size());
+  for (unsigned k = 0; k < n; ++k) {
+    mix_t const& mix = models[k];
+    unsigned i = offset + k;
+    unsigned nc = mix.num_components();
+    soa.num_components()[i] = (unsigned char)nc;
+    soa.num_obs()[i] = mix.num_observations;
+    for (unsigned c = 0; c < bsta_mog3_soa::n_comp; ++c) {
+      if (c < nc) {
+        soa.weight(c)[i] = mix.weight(c);
+        soa.comp_obs(c)[i] = mix.distribution(c).num_observations;
+      }
+      else {
+        soa.weight(c)[i] = 0.0f;
+        soa.comp_obs(c)[i] = 0.0f;
+      }
+    }
+  }
+}
+
+void bsta_mog3_pack(bsta_mog3_grey_type const* models, unsigned n, bsta_mog3_soa& soa, unsigned offset)
+{
+  pack_models<bsta_mog3_grey_type, 1>(models, n, soa, offset);
+  for (unsigned c = 0; c < bsta_mog3_soa::n_comp; ++c) {
+    float* mean = soa.mean(c) + offset;
+    float* var = soa.var(c) + offset;
+    for (unsigned k = 0; k < n; ++k) {
+      if (c < models[k].num_components()) {
+        mean[k] = models[k].distribution(c).mean();
+        var[k] = models[k].distribution(c).var();
+      }
+      else {
+        mean[k] = 0.0f;
+        var[k] = 0.0f;
+      }
+    }
+  }
+}
+
+void bsta_mog3_pack(bsta_mog3_rgb_type const* models, unsigned n, bsta_mog3_soa& soa, unsigned offset)
+{
+  pack_models<bsta_mog3_rgb_type, 3>(models, n, soa, offset);
+  for (unsigned c = 0; c < bsta_mog3_soa::n_comp; ++c)
+    for (unsigned d = 0; d < 3; ++d) {
+      float* mean = soa.mean(c,d) + offset;
+      float* var = soa.var(c,d) + offset;
+      for (unsigned k = 0; k < n; ++k) {
+        if (c < models[k].num_components()) {
+          mean[k] = models[k].distribution(c).mean()[d];
+          var[k] = models[k].distribution(c).diag_covar()[d];
+        }
+        else {
+          mean[k] = 0.0f;
+          var[k] = 0.0f;
+        }
+      }
+    }
+}
+
+void bsta_mog3_unpack(bsta_mog3_soa const& soa, bsta_mog3_grey_type* models, unsigned n, unsigned offset)
+{
+  assert(soa.dim() == 1);
+  assert(offset + n <= soa.size());
+  for (unsigned k = 0; k < n; ++k) {
+    unsigned i = offset + k;
+    bsta_mog3_grey_type mix;
+    for (unsigned c = 0; c < soa.num_components()[i]; ++c) {
+      bsta_gauss_sf1 g(soa.mean(c)[i], soa.var(c)[i]);
+      mix.insert(bsta_num_obs<bsta_gauss_sf1>(g, soa.comp_obs(c)[i]), soa.weight(c)[i]);
+    }
+    mix.num_observations = soa.num_obs()[i];
+    models[k] = mix;
+  }
+}
+
+void bsta_mog3_unpack(bsta_mog3_soa const& soa, bsta_mog3_rgb_type* models, unsigned n, unsigned offset)
+{
+  assert(soa.dim() == 3);
+  assert(offset + n <= soa.size());
+  for (unsigned k = 0; k < n; ++k) {
+    unsigned i = offset + k;
+    bsta_mog3_rgb_type mix;
+    for (unsigned c = 0; c < soa.num_components()[i]; ++c) {
+      vnl_vector_fixed<float,3> mean, var;
+      for (unsigned d = 0; d < 3; ++d) {
+        mean[d] = soa.mean(c,d)[i];
+        var[d] = soa.var(c,d)[i];
+      }
+      bsta_gauss_if3 g(mean, var);
+      mix.insert(bsta_num_obs<bsta_gauss_if3>(g, soa.comp_obs(c)[i]), soa.weight(c)[i]);
+    }
+    mix.num_observations = soa.num_obs()[i];
+    models[k] = mix;
+  }
+}
+
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+//: exp() of 4 floats, the cephes single precision polynomial (relative error about 2e-7)
+static inline __m128 mog3_exp_ps(__m128 x)
+{
+  const __m128 one = _mm_set1_ps(1.0f);
+  x = _mm_min_ps(x, _mm_set1_ps(88.3762626647949f));
+  x = _mm_max_ps(x, _mm_set1_ps(-88.3762626647949f));
+
+  // exp(x) = 2^n exp(r) with n = floor(x/log(2) + 1/2)
+  __m128 fx = _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(1.44269504088896341f)), _mm_set1_ps(0.5f));
+  __m128 tmp = _mm_cvtepi32_ps(_mm_cvttps_epi32(fx));
+  fx = _mm_sub_ps(tmp, _mm_and_ps(_mm_cmpgt_ps(tmp, fx), one));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(0.693359375f)));
+  x = _mm_sub_ps(x, _mm_mul_ps(fx, _mm_set1_ps(-2.12194440e-4f)));
+
+  __m128 z = _mm_mul_ps(x, x);
+  __m128 y = _mm_set1_ps(1.9875691500e-4f);
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.3981999507e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(8.3334519073e-3f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(4.1665795894e-2f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(1.6666665459e-1f));
+  y = _mm_add_ps(_mm_mul_ps(y, x), _mm_set1_ps(5.0000001201e-1f));
+  y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(y, z), x), one);
+
+  __m128i e = _mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(fx), _mm_set1_epi32(0x7f)), 23);
+  return _mm_mul_ps(y, _mm_castsi128_ps(e));
+}
+
+//: a ? b : c for masks a
+static inline __m128 mog3_select_ps(__m128 a, __m128 b, __m128 c)
+{
+  return _mm_or_ps(_mm_and_ps(a, b), _mm_andnot_ps(a, c));
+}
+#endif
+
+//: 1/sqrt((2 pi)^dim)
+static inline float mog3_norm(unsigned dim)
+{
+  return dim == 1 ? float(vnl_math::one_over_sqrt2pi)
+                  : float(vnl_math::one_over_sqrt2pi*vnl_math::one_over_sqrt2pi*vnl_math::one_over_sqrt2pi);
+}
+
+//: the scalar density kernel, used without SSE2 and for the last few models
+static void mog3_prob_density_scalar(bsta_mog3_soa const& soa, float const* x, float* p,
+                                     unsigned begin, unsigned end)
+{
+  const unsigned dim = soa.dim();
+  const float norm = mog3_norm(dim);
+  unsigned char const* nc = soa.num_components();
+  for (unsigned i = begin; i < end; ++i) {
+    if (nc[i] == 0) {
+      p[i] = 1.0f;
+      continue;
+    }
+    float sum = 0.0f;
+    for (unsigned c = 0; c < nc[i]; ++c) {
+      float det = 1.0f, m = 0.0f;
+      for (unsigned d = 0; d < dim; ++d) {
+        float v = soa.var(c,d)[i];
+        float diff = x[dim*i + d] - soa.mean(c,d)[i];
+        det *= v;
+        m += diff*diff/v;
+      }
+      if (det > 0.0f)
+        sum += soa.weight(c)[i]*norm/std::sqrt(det)*std::exp(-0.5f*m);
+    }
+    p[i] = sum;
+  }
+}
+
+void bsta_mog3_prob_density(bsta_mog3_soa const& soa, float const* x, float* p,
+                            unsigned begin, unsigned end)
+{
+  assert(end <= soa.size());
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+  // four models at a time, all three components evaluated and masked
+  // with the number of components in use
+  const unsigned dim = soa.dim();
+  unsigned char const* nc = soa.num_components();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 neg_half = _mm_set1_ps(-0.5f);
+  const __m128 norm = _mm_set1_ps(mog3_norm(dim));
+  float const* mean_p[3][3];
+  float const* var_p[3][3];
+  float const* weight_p[3];
+  for (unsigned c = 0; c < bsta_mog3_soa::n_comp; ++c) {
+    for (unsigned d = 0; d < dim; ++d) {
+      mean_p[c][d] = soa.mean(c,d);
+      var_p[c][d] = soa.var(c,d);
+    }
+    weight_p[c] = soa.weight(c);
+  }
+  unsigned i = begin;
+  for (; i + 4 <= end; i += 4) {
+    __m128 ncf = _mm_setr_ps(nc[i], nc[i+1], nc[i+2], nc[i+3]);
+    __m128 xv[3];
+    for (unsigned d = 0; d < dim; ++d)
+      xv[d] = _mm_setr_ps(x[dim*i+d], x[dim*(i+1)+d], x[dim*(i+2)+d], x[dim*(i+3)+d]);
+    __m128 sum = zero;
+    for (unsigned c = 0; c < bsta_mog3_soa::n_comp; ++c) {
+      __m128 used = _mm_cmpgt_ps(ncf, _mm_set1_ps(float(c)));
+      if (_mm_movemask_ps(used) == 0)
+        break; // none of the four models has more components
+      __m128 det = one, m = zero;
+      for (unsigned d = 0; d < dim; ++d) {
+        __m128 v = _mm_loadu_ps(var_p[c][d] + i);
+        __m128 diff = _mm_sub_ps(xv[d], _mm_loadu_ps(mean_p[c][d] + i));
+        det = _mm_mul_ps(det, v);
+        m = _mm_add_ps(m, _mm_div_ps(_mm_mul_ps(diff, diff), v));
+      }
+      __m128 ok = _mm_and_ps(used, _mm_cmpgt_ps(det, zero));
+      det = mog3_select_ps(ok, det, one);
+      m = mog3_select_ps(ok, m, zero);
+      __m128 g = _mm_mul_ps(_mm_div_ps(norm, _mm_sqrt_ps(det)), mog3_exp_ps(_mm_mul_ps(neg_half, m)));
+      sum = _mm_add_ps(sum, _mm_and_ps(ok, _mm_mul_ps(_mm_loadu_ps(weight_p[c] + i), g)));
+    }
+    _mm_storeu_ps(p + i, mog3_select_ps(_mm_cmpeq_ps(ncf, zero), one, sum));
+  }
+  mog3_prob_density_scalar(soa, x, p, i, end);
+#else
+  mog3_prob_density_scalar(soa, x, p, begin, end);
+#endif
+}
+
+void bsta_mog3_expected_value(bsta_mog3_soa const& soa, float* ev,
+                              unsigned begin, unsigned end)
+{
+  assert(end <= soa.size());
+  const unsigned dim = soa.dim();
+  unsigned char const* nc = soa.num_components();
+  float const* w0 = soa.weight(0);
+  float const* w1 = soa.weight(1);
+  float const* w2 = soa.weight(2);
+  for (unsigned d = 0; d < dim; ++d) {
+    float const* mu0 = soa.mean(0,d);
+    float const* mu1 = soa.mean(1,d);
+    float const* mu2 = soa.mean(2,d);
+    for (unsigned i = begin; i < end; ++i) {
+      float a = nc[i] > 0 ? w0[i] : 0.0f;
+      float b = nc[i] > 1 ? w1[i] : 0.0f;
+      float c = nc[i] > 2 ? w2[i] : 0.0f;
+      float sum_w = a + b + c;
+      float sum = a*mu0[i] + b*mu1[i] + c*mu2[i];
+      ev[dim*i + d] = sum_w > 0.0f ? sum/sum_w : 0.0f;
+    }
+  }
+}
+
+//: Order of bsta_gaussian_fitness: w^2/var for spheres, (w^2)^3/det for independent Gaussians
+static inline float mog3_fitness(float w, float const* var, unsigned dim)
+{
+  if (dim == 1)
+    return w*w/var[0];
+  float w2 = w*w;
+  return w2*w2*w2/(var[0]*var[1]*var[2]);
+}
+
+//: the scalar update kernel, used without SSE2 and for the last few models
+static void mog3_update_scalar(bsta_mog3_soa& soa, float const* x, float const* w,
+                               bsta_mog3_update_params const& params,
+                               unsigned begin, unsigned end)
+{
+  const unsigned dim = soa.dim();
+  const unsigned nmax = bsta_mog3_soa::n_comp;
+  const float gt2 = params.g_thresh_*params.g_thresh_;
+  const float min_var = params.min_stdev_*params.min_stdev_;
+  unsigned char* ncomp = soa.num_components();
+  float* num_obs = soa.num_obs();
+  float* mean_p[3][3];
+  float* var_p[3][3];
+  float* weight_p[3];
+  float* obs_p[3];
+  for (unsigned c = 0; c < nmax; ++c) {
+    for (unsigned d = 0; d < dim; ++d) {
+      mean_p[c][d] = soa.mean(c,d);
+      var_p[c][d] = soa.var(c,d);
+    }
+    weight_p[c] = soa.weight(c);
+    obs_p[c] = soa.comp_obs(c);
+  }
+
+  for (unsigned i = begin; i < end; ++i)
+  {
+    float alpha;
+    if (w) {
+      if (!(w[i] > 0.0f))
+        continue;
+      num_obs[i] += w[i];
+      alpha = w[i]/num_obs[i];
+    }
+    else {
+      if (num_obs[i] < float(params.window_size_))
+        num_obs[i] += 1.0f;
+      alpha = 1.0f/num_obs[i];
+    }
+    float const* xi = x + dim*i;
+
+    // gather the model into registers
+    unsigned nc = ncomp[i];
+    float mu[3][3], var[3][3], wt[3], no[3];
+    for (unsigned c = 0; c < nc; ++c) {
+      for (unsigned d = 0; d < dim; ++d) {
+        mu[c][d] = mean_p[c][d][i];
+        var[c][d] = var_p[c][d][i];
+      }
+      wt[c] = weight_p[c][i];
+      no[c] = obs_p[c][i];
+    }
+
+    // bsta_mg_grimson_statistical_updater::update()
+    int match = -1;
+    for (unsigned c = 0; c < nc; ++c) {
+      float weight = (1.0f-alpha)*wt[c];
+      if (match < 0) {
+        float det = 1.0f, m = 0.0f;
+        for (unsigned d = 0; d < dim; ++d) {
+          float diff = mu[c][d] - xi[d];
+          det *= var[c][d];
+          m += diff*diff/var[c][d];
+        }
+        if (det > 0.0f && m < gt2) {
+          weight += alpha;
+          no[c] += 1.0f;
+          float rho = (1.0f-alpha)/no[c] + alpha;
+          float rho_comp = 1.0f - rho;
+          for (unsigned d = 0; d < dim; ++d) {
+            float diff = xi[d] - mu[c][d];
+            float v = rho_comp*var[c][d] + (rho*rho_comp)*diff*diff;
+            var[c][d] = v < min_var ? min_var : v;
+            mu[c][d] += rho*diff;
+          }
+          match = int(c);
+        }
+      }
+      wt[c] = weight;
+    }
+    if (match < 0) {
+      // bsta_mg_adaptive_updater::insert()
+      if (nc >= nmax) {
+        nc = nmax - 1;
+        float adjust = 0.0f;
+        for (unsigned c = 0; c < nc; ++c)
+          adjust += wt[c];
+        adjust = (1.0f-alpha)/adjust;
+        for (unsigned c = 0; c < nc; ++c)
+          wt[c] *= adjust;
+      }
+      for (unsigned d = 0; d < dim; ++d) {
+        mu[nc][d] = xi[d];
+        var[nc][d] = params.init_var_;
+      }
+      wt[nc] = nc > 0 ? alpha : 1.0f;
+      no[nc] = 1.0f;
+      match = int(nc);
+      ++nc;
+    }
+    // sort components [0,match] by decreasing fitness; a bubble sort keeps
+    // equal components in place, as the insertion sort of std::sort does
+    // for so few elements
+    for (int pass = match; pass > 0; --pass)
+      for (int c = 0; c < pass; ++c)
+        if (mog3_fitness(wt[c+1], var[c+1], dim) > mog3_fitness(wt[c], var[c], dim)) {
+          for (unsigned d = 0; d < dim; ++d) {
+            std::swap(mu[c][d], mu[c+1][d]);
+            std::swap(var[c][d], var[c+1][d]);
+          }
+          std::swap(wt[c], wt[c+1]);
+          std::swap(no[c], no[c+1]);
+        }
+
+    // scatter the model back
+    ncomp[i] = (unsigned char)nc;
+    for (unsigned c = 0; c < nc; ++c) {
+      for (unsigned d = 0; d < dim; ++d) {
+        mean_p[c][d][i] = mu[c][d];
+        var_p[c][d][i] = var[c][d];
+      }
+      weight_p[c][i] = wt[c];
+      obs_p[c][i] = no[c];
+    }
+  }
+}
+
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+//: fitness of component c in four models, see mog3_fitness()
+static inline __m128 mog3_fitness_ps(__m128 const* wt, __m128 const (*var)[3], unsigned c, unsigned dim)
+{
+  __m128 w2 = _mm_mul_ps(wt[c], wt[c]);
+  if (dim == 1)
+    return _mm_div_ps(w2, var[c][0]);
+  return _mm_div_ps(_mm_mul_ps(_mm_mul_ps(w2, w2), w2),
+                    _mm_mul_ps(_mm_mul_ps(var[c][0], var[c][1]), var[c][2]));
+}
+
+//: swap components a and b of the lanes in mask that are out of order
+static inline void mog3_sort_pair_ps(__m128 mask, unsigned a, unsigned b, unsigned dim,
+                                     __m128 (*mu)[3], __m128 (*var)[3], __m128* wt, __m128* no)
+{
+  __m128 sw = _mm_and_ps(mask, _mm_cmpgt_ps(mog3_fitness_ps(wt, var, b, dim),
+                                            mog3_fitness_ps(wt, var, a, dim)));
+  for (unsigned d = 0; d < dim; ++d) {
+    __m128 t = mu[a][d];
+    mu[a][d] = mog3_select_ps(sw, mu[b][d], t);
+    mu[b][d] = mog3_select_ps(sw, t, mu[b][d]);
+    t = var[a][d];
+    var[a][d] = mog3_select_ps(sw, var[b][d], t);
+    var[b][d] = mog3_select_ps(sw, t, var[b][d]);
+  }
+  __m128 t = wt[a];
+  wt[a] = mog3_select_ps(sw, wt[b], t);
+  wt[b] = mog3_select_ps(sw, t, wt[b]);
+  t = no[a];
+  no[a] = mog3_select_ps(sw, no[b], t);
+  no[b] = mog3_select_ps(sw, t, no[b]);
+}
+
+//: the update of mog3_update_scalar() for four models at a time
+//  The branches of the scalar kernel become lane masks; every arithmetic
+//  operation is the same, so the results are identical.  Returns the index of
+//  the first model that was not updated.
+static unsigned mog3_update_sse(bsta_mog3_soa& soa, float const* x, float const* w,
+                                bsta_mog3_update_params const& params,
+                                unsigned begin, unsigned end)
+{
+  const unsigned dim = soa.dim();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 all = _mm_cmpeq_ps(zero, zero);
+  const __m128 gt2 = _mm_set1_ps(params.g_thresh_*params.g_thresh_);
+  const __m128 min_var = _mm_set1_ps(params.min_stdev_*params.min_stdev_);
+  const __m128 init_var = _mm_set1_ps(params.init_var_);
+  const __m128 window = _mm_set1_ps(float(params.window_size_));
+  const __m128 comp_idx[3] = { zero, one, _mm_set1_ps(2.0f) };
+  unsigned char* ncomp = soa.num_components();
+  float* num_obs = soa.num_obs();
+  float* mean_p[3][3];
+  float* var_p[3][3];
+  float* weight_p[3];
+  float* obs_p[3];
+  for (unsigned c = 0; c < 3; ++c) {
+    for (unsigned d = 0; d < dim; ++d) {
+      mean_p[c][d] = soa.mean(c,d);
+      var_p[c][d] = soa.var(c,d);
+    }
+    weight_p[c] = soa.weight(c);
+    obs_p[c] = soa.comp_obs(c);
+  }
+
+  unsigned i = begin;
+  for (; i + 4 <= end; i += 4)
+  {
+    __m128 nobs = _mm_loadu_ps(num_obs + i);
+    __m128 active, alpha;
+    if (w) {
+      __m128 wv = _mm_loadu_ps(w + i);
+      active = _mm_cmpgt_ps(wv, zero);
+      if (_mm_movemask_ps(active) == 0)
+        continue;
+      nobs = mog3_select_ps(active, _mm_add_ps(nobs, wv), nobs);
+      alpha = _mm_div_ps(wv, nobs);
+    }
+    else {
+      active = all;
+      nobs = mog3_select_ps(_mm_cmplt_ps(nobs, window), _mm_add_ps(nobs, one), nobs);
+      alpha = _mm_div_ps(one, nobs);
+    }
+    __m128 one_m_alpha = _mm_sub_ps(one, alpha);
+
+    __m128 ncf = _mm_setr_ps(ncomp[i], ncomp[i+1], ncomp[i+2], ncomp[i+3]);
+    __m128 xv[3], mu[3][3], var[3][3], wt[3], no[3];
+    for (unsigned d = 0; d < dim; ++d)
+      xv[d] = _mm_setr_ps(x[dim*i+d], x[dim*(i+1)+d], x[dim*(i+2)+d], x[dim*(i+3)+d]);
+    for (unsigned c = 0; c < 3; ++c) {
+      for (unsigned d = 0; d < dim; ++d) {
+        mu[c][d] = _mm_loadu_ps(mean_p[c][d] + i);
+        var[c][d] = _mm_loadu_ps(var_p[c][d] + i);
+      }
+      wt[c] = _mm_loadu_ps(weight_p[c] + i);
+      no[c] = _mm_loadu_ps(obs_p[c] + i);
+    }
+
+    // match and update the first component within the threshold
+    __m128 matched = zero, match = zero;
+    for (unsigned c = 0; c < 3; ++c) {
+      __m128 used = _mm_and_ps(active, _mm_cmpgt_ps(ncf, comp_idx[c]));
+      __m128 det = one, m = zero;
+      for (unsigned d = 0; d < dim; ++d) {
+        __m128 diff = _mm_sub_ps(mu[c][d], xv[d]);
+        det = _mm_mul_ps(det, var[c][d]);
+        m = _mm_add_ps(m, _mm_div_ps(_mm_mul_ps(diff, diff), var[c][d]));
+      }
+      __m128 hit = _mm_andnot_ps(matched, _mm_and_ps(used, _mm_and_ps(_mm_cmpgt_ps(det, zero),
+                                                                      _mm_cmplt_ps(m, gt2))));
+      __m128 weight = _mm_mul_ps(one_m_alpha, wt[c]);
+      weight = mog3_select_ps(hit, _mm_add_ps(weight, alpha), weight);
+      __m128 no_c = _mm_add_ps(no[c], one);
+      __m128 rho = _mm_add_ps(_mm_div_ps(one_m_alpha, no_c), alpha);
+      __m128 rho_comp = _mm_sub_ps(one, rho);
+      __m128 rr = _mm_mul_ps(rho, rho_comp);
+      for (unsigned d = 0; d < dim; ++d) {
+        __m128 diff = _mm_sub_ps(xv[d], mu[c][d]);
+        __m128 v = _mm_add_ps(_mm_mul_ps(rho_comp, var[c][d]), _mm_mul_ps(_mm_mul_ps(rr, diff), diff));
+        v = mog3_select_ps(_mm_cmplt_ps(v, min_var), min_var, v);
+        var[c][d] = mog3_select_ps(hit, v, var[c][d]);
+        mu[c][d] = mog3_select_ps(hit, _mm_add_ps(mu[c][d], _mm_mul_ps(rho, diff)), mu[c][d]);
+      }
+      no[c] = mog3_select_ps(hit, no_c, no[c]);
+      wt[c] = mog3_select_ps(used, weight, wt[c]);
+      match = mog3_select_ps(hit, comp_idx[c], match);
+      matched = _mm_or_ps(matched, hit);
+    }
+
+    // insert a new component where nothing matched
+    __m128 ins = _mm_andnot_ps(matched, active);
+    if (_mm_movemask_ps(ins)) {
+      __m128 full = _mm_cmpge_ps(ncf, _mm_set1_ps(3.0f));
+      __m128 adjust = _mm_div_ps(one_m_alpha, _mm_add_ps(wt[0], wt[1]));
+      __m128 rn = _mm_and_ps(ins, full);
+      wt[0] = mog3_select_ps(rn, _mm_mul_ps(wt[0], adjust), wt[0]);
+      wt[1] = mog3_select_ps(rn, _mm_mul_ps(wt[1], adjust), wt[1]);
+      __m128 pos = mog3_select_ps(full, comp_idx[2], ncf);
+      __m128 new_w = mog3_select_ps(_mm_cmpgt_ps(pos, zero), alpha, one);
+      for (unsigned c = 0; c < 3; ++c) {
+        __m128 at = _mm_and_ps(ins, _mm_cmpeq_ps(pos, comp_idx[c]));
+        for (unsigned d = 0; d < dim; ++d) {
+          mu[c][d] = mog3_select_ps(at, xv[d], mu[c][d]);
+          var[c][d] = mog3_select_ps(at, init_var, var[c][d]);
+        }
+        wt[c] = mog3_select_ps(at, new_w, wt[c]);
+        no[c] = mog3_select_ps(at, one, no[c]);
+      }
+      match = mog3_select_ps(ins, pos, match);
+      ncf = mog3_select_ps(ins, _mm_add_ps(pos, one), ncf);
+    }
+
+    // the bubble sort of [0,match] of the scalar kernel
+    __m128 m1 = _mm_and_ps(active, _mm_cmpge_ps(match, one));
+    __m128 m2 = _mm_and_ps(active, _mm_cmpeq_ps(match, comp_idx[2]));
+    if (_mm_movemask_ps(m1)) {
+      mog3_sort_pair_ps(m1, 0, 1, dim, mu, var, wt, no);
+      if (_mm_movemask_ps(m2)) {
+        mog3_sort_pair_ps(m2, 1, 2, dim, mu, var, wt, no);
+        mog3_sort_pair_ps(m2, 0, 1, dim, mu, var, wt, no);
+      }
+    }
+
+    _mm_storeu_ps(num_obs + i, nobs);
+    for (unsigned c = 0; c < 3; ++c) {
+      for (unsigned d = 0; d < dim; ++d) {
+        _mm_storeu_ps(mean_p[c][d] + i, mu[c][d]);
+        _mm_storeu_ps(var_p[c][d] + i, var[c][d]);
+      }
+      _mm_storeu_ps(weight_p[c] + i, wt[c]);
+      _mm_storeu_ps(obs_p[c] + i, no[c]);
+    }
+    int nc_out[4];
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(nc_out), _mm_cvtps_epi32(ncf));
+    for (unsigned k = 0; k < 4; ++k)
+      ncomp[i+k] = (unsigned char)nc_out[k];
+  }
+  return i;
+}
+#endif
+
+void bsta_mog3_update(bsta_mog3_soa& soa, float const* x, float const* w,
+                      bsta_mog3_update_params const& params,
+                      unsigned begin, unsigned end)
+{
+  assert(end <= soa.size());
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+  begin = mog3_update_sse(soa, x, w, params, begin, end);
+#endif
+  mog3_update_scalar(soa, x, w, params, begin, end);
+}
+
+//--------------------------------------------------------------------------
+// boxm2 packed grey mixtures
+
+static inline float mog3_clamp01(float x) { return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x); }
+
+void bsta_mog3_packed_prob_density(unsigned char const* mog3, float const* x, float* p,
+                                   unsigned begin, unsigned end)
+{
+  const float norm = 0.398942280f;
+  for (unsigned i = begin; i < end; ++i) {
+    unsigned char const* m = mog3 + 8*i;
+    float mu0 = m[0]/255.0f, sigma0 = m[1]/255.0f, w0 = m[2]/255.0f;
+    float mu1 = m[3]/255.0f, sigma1 = m[4]/255.0f, w1 = m[5]/255.0f;
+    float mu2 = m[6]/255.0f, sigma2 = m[7]/255.0f;
+    float w2 = (w0 > 0.0f && w1 > 0.0f) ? 1.0f - w0 - w1 : 0.0f;
+    // as boxm2_mog3_grey_processor::prob_density(), a component is only
+    // used if all the components before it are valid
+    bool v0 = w0 > 0.0f && sigma0 > 0.0f;
+    bool v1 = v0 && w1 > 0.0f && sigma1 > 0.0f;
+    bool v2 = v1 && w2 > 0.0f && sigma2 > 0.0f;
+    float s0 = v0 ? sigma0 : 1.0f, s1 = v1 ? sigma1 : 1.0f, s2 = v2 ? sigma2 : 1.0f;
+    float d0 = x[i] - mu0, d1 = x[i] - mu1, d2 = x[i] - mu2;
+    float g0 = w0*(norm*std::exp(-0.5f*d0*d0/(s0*s0))/s0);
+    float g1 = w1*(norm*std::exp(-0.5f*d1*d1/(s1*s1))/s1);
+    float g2 = w2*(norm*std::exp(-0.5f*d2*d2/(s2*s2))/s2);
+    p[i] = v0 ? g0 + (v1 ? g1 : 0.0f) + (v2 ? g2 : 0.0f) : 1.0f;
+  }
+}
+
+void bsta_mog3_packed_expected_value(unsigned char const* mog3, float* ev,
+                                     unsigned begin, unsigned end)
+{
+  for (unsigned i = begin; i < end; ++i) {
+    unsigned char const* m = mog3 + 8*i;
+    float w2 = (m[2] > 0 && m[5] > 0) ? float(255 - m[2] - m[5]) : 0.0f;
+    ev[i] = (float(m[0])*float(m[2]) + float(m[3])*float(m[5]) + float(m[6])*w2)/(255.0f*255.0f);
+  }
+}
+
+void bsta_mog3_packed_update(unsigned char* mog3, float* nobs, float const* x, float const* w,
+                             float init_sigma, float min_sigma,
+                             unsigned begin, unsigned end)
+{
+  const float tsq = 2.5f*2.5f;
+  for (unsigned i = begin; i < end; ++i)
+  {
+    unsigned char* m = mog3 + 8*i;
+    float* no = nobs + 4*i;
+    float mu[3] = { m[0]/255.0f, m[3]/255.0f, m[6]/255.0f };
+    float sigma[3] = { m[1]/255.0f, m[4]/255.0f, m[7]/255.0f };
+    float wt[3] = { m[2]/255.0f, m[5]/255.0f, 0.0f };
+    if (wt[0] > 0.0f && wt[1] > 0.0f)
+      wt[2] = 1 - wt[0] - wt[1];
+
+    // as in the scalar path, the model is re-quantized even if the weight is zero
+    if (w[i] > 0.0f)
+    {
+      int match = -1;
+      no[3] += w[i];
+      float alpha = w[i]/no[3];
+      const float xi = x[i];
+      for (unsigned c = 0; c < 3; ++c) {
+        if (wt[c] > 0.0f && sigma[c] > 0.0f) {
+          float weight = (1.0f-alpha)*wt[c];
+          float diff = xi - mu[c];
+          bool hit = c == 0 ? (diff*diff/(sigma[c]*sigma[c])) < tsq
+                            : diff*diff < sigma[c]*sigma[c]*tsq;
+          if (match < 0 && hit) {
+            weight += alpha;
+            no[c]++;
+            float rho = (1.0f-alpha)/no[c] + alpha;
+            float var = (1.0f-rho)*(sigma[c]*sigma[c] + rho*diff*diff);
+            mu[c] += rho*diff;
+            sigma[c] = std::sqrt(var);
+            sigma[c] = sigma[c] < min_sigma ? min_sigma : sigma[c];
+            match = int(c);
+          }
+          wt[c] = weight;
+        }
+      }
+      if (match < 0) {
+        // boxm2_mog3_grey_processor::insert_gauss_3()
+        unsigned c;
+        if (wt[1] > 0.0f && sigma[1] > 0.0f) {
+          float adjust = (1.0f - alpha)/(wt[0] + wt[1]);
+          wt[0] *= adjust;
+          wt[1] *= adjust;
+          wt[2] = alpha;
+          c = 2;
+        }
+        else if (wt[0] > 0.0f) {
+          wt[0] = 1.0f - alpha;
+          wt[1] = alpha;
+          c = 1;
+        }
+        else {
+          wt[0] = 1.0f;
+          c = 0;
+        }
+        mu[c] = xi;
+        sigma[c] = init_sigma;
+        no[c] = 1;
+      }
+      // boxm2_mog3_grey_processor::sort_mix_3() only orders the first two
+      // components, and only while the third one is unused
+      if (wt[1] > 0.0f && sigma[1] > 0.0f && (wt[2] == 0.0f || sigma[2] == 0.0f) &&
+          wt[0]/sigma[0] < wt[1]/sigma[1]) {
+        std::swap(mu[0], mu[1]);
+        std::swap(sigma[0], sigma[1]);
+        std::swap(wt[0], wt[1]);
+        std::swap(no[0], no[1]);
+      }
+    }
+
+    m[0] = (unsigned char)std::floor(mog3_clamp01(mu[0])*255.0f);
+    m[1] = (unsigned char)std::floor(mog3_clamp01(sigma[0])*255.0f);
+    m[2] = (unsigned char)std::floor(mog3_clamp01(wt[0])*255.0f);
+    m[3] = (unsigned char)std::floor(mog3_clamp01(mu[1])*255.0f);
+    m[4] = (unsigned char)std::floor(mog3_clamp01(sigma[1])*255.0f);
+    m[5] = (unsigned char)std::floor(mog3_clamp01(wt[1])*255.0f);
+    m[6] = (unsigned char)std::floor(mog3_clamp01(mu[2])*255.0f);
+    m[7] = (unsigned char)std::floor(mog3_clamp01(sigma[2])*255.0f);
+  }
+}
@@ -0,0 +1,159 @@
+// This is brl/bbas/bsta/algo/bsta_mog3_kernels.h
+#ifndef bsta_mog3_kernels_h_
+#define bsta_mog3_kernels_h_
+//:
+// \file
+// \brief Batched kernels for fixed size mixtures of 3 grey or RGB Gaussians
+//
+// The appearance models of bvxm (bvxm_mog_grey_processor, bvxm_mog_rgb_processor)
+// and the background models of bbgm are arrays of
+// bsta_num_obs<bsta_mixture_fixed<bsta_num_obs<gauss>,3> > objects, updated one
+// at a time through bsta_mg_grimson_weighted_updater (or the window updater).
+// boxm2 stores the grey mixture packed into 8 bytes per cell, see
+// boxm2_mog3_grey_processor.
+//
+// This file provides kernels that process whole arrays of such models:
+//  - bsta_mog3_soa holds n mixtures as a structure of arrays (one array per
+//    parameter), so the kernels run over contiguous floats without virtual
+//    calls.  Where SSE2 is available the density and the update process four
+//    models at a time, turning the branches of the updater into lane masks.
+//  - bsta_mog3_pack()/bsta_mog3_unpack() convert between the bsta mixture
+//    objects and the structure of arrays.
+//  - bsta_mog3_update() reproduces the grimson weighted/window updaters,
+//    including the partial sort of the components by fitness.
+//  - the bsta_mog3_packed_*() functions work directly on the 8 byte boxm2
+//    encoding and reproduce boxm2_mog3_grey_processor.
+//
+// All kernels take a range [begin,end) of models, so that callers can split the
+// work between threads.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <cstddef>
+#include <vcl_compiler.h>
+#include <bsta/bsta_attributes.h>
+#include <bsta/bsta_mixture_fixed.h>
+#include <bsta/bsta_gauss_sf1.h>
+#include <bsta/bsta_gauss_if3.h>
+
+//: The grey mixture type of bvxm_mog_grey_processor and bbgm
+typedef bsta_num_obs<bsta_mixture_fixed<bsta_num_obs<bsta_gauss_sf1>, 3> > bsta_mog3_grey_type;
+//: The RGB mixture type of bvxm_mog_rgb_processor and bbgm
+typedef bsta_num_obs<bsta_mixture_fixed<bsta_num_obs<bsta_gauss_if3>, 3> > bsta_mog3_rgb_type;
+
+//: n mixtures of (up to) 3 Gaussians with independent dimensions, stored as a structure of arrays
+//  dim is 1 (grey) or 3 (RGB).  Components at or beyond num_components()[i]
+//  are unused and their parameters are ignored.
+class bsta_mog3_soa
+{
+ public:
+  enum { n_comp = 3 };
+
+  bsta_mog3_soa(unsigned dim = 1, unsigned n = 0);
+
+  //: Change the number of models; the contents are undefined afterwards
+  void resize(unsigned n);
+
+  unsigned size() const { return n_; }
+  unsigned dim() const { return dim_; }
+
+  //: Mean of dimension d of component c, one value per model
+  float* mean(unsigned c, unsigned d = 0) { return plane(c*dim_ + d); }
+  float const* mean(unsigned c, unsigned d = 0) const { return plane(c*dim_ + d); }
+
+  //: Variance of dimension d of component c
+  float* var(unsigned c, unsigned d = 0) { return plane((n_comp + c)*dim_ + d); }
+  float const* var(unsigned c, unsigned d = 0) const { return plane((n_comp + c)*dim_ + d); }
+
+  //: Weight of component c
+  float* weight(unsigned c) { return plane(2*n_comp*dim_ + c); }
+  float const* weight(unsigned c) const { return plane(2*n_comp*dim_ + c); }
+
+  //: Number of observations of component c
+  float* comp_obs(unsigned c) { return plane(2*n_comp*dim_ + n_comp + c); }
+  float const* comp_obs(unsigned c) const { return plane(2*n_comp*dim_ + n_comp + c); }
+
+  //: Number of observations of the mixture
+  float* num_obs() { return plane(2*n_comp*dim_ + 2*n_comp); }
+  float const* num_obs() const { return plane(2*n_comp*dim_ + 2*n_comp); }
+
+  //: Number of components in use
+  unsigned char* num_components() { return ncomp_.empty() ? VXL_NULLPTR : &ncomp_[0]; }
+  unsigned char const* num_components() const { return ncomp_.empty() ? VXL_NULLPTR : &ncomp_[0]; }
+
+ private:
+  unsigned dim_;
+  unsigned n_;
+  std::vector<float> data_;
+  std::vector<unsigned char> ncomp_;
+
+  unsigned n_planes() const { return 2*n_comp*dim_ + 2*n_comp + 1; }
+  float* plane(unsigned p) { return data_.empty() ? VXL_NULLPTR : &data_[0] + std::size_t(p)*n_; }
+  float const* plane(unsigned p) const { return data_.empty() ? VXL_NULLPTR : &data_[0] + std::size_t(p)*n_; }
+};
+
+//: Parameters of bsta_mog3_update(), the same as those of the grimson updaters
+struct bsta_mog3_update_params
+{
+  bsta_mog3_update_params(float init_var, float g_thresh = 3.0f, float min_stdev = 0.0f,
+                          unsigned window_size = 0)
+  : init_var_(init_var), g_thresh_(g_thresh), min_stdev_(min_stdev), window_size_(window_size) {}
+
+  //: variance of inserted components
+  float init_var_;
+  //: number of standard deviations within which a sample matches a component
+  float g_thresh_;
+  //: lower limit of the standard deviation of updated components
+  float min_stdev_;
+  //: if weights are not given, the window size of bsta_mg_grimson_window_updater
+  unsigned window_size_;
+};
+
+//: Copy models [0,n) into soa[offset, offset+n)
+void bsta_mog3_pack(bsta_mog3_grey_type const* models, unsigned n, bsta_mog3_soa& soa, unsigned offset = 0);
+void bsta_mog3_pack(bsta_mog3_rgb_type const* models, unsigned n, bsta_mog3_soa& soa, unsigned offset = 0);
+
+//: Copy soa[offset, offset+n) back into models [0,n)
+void bsta_mog3_unpack(bsta_mog3_soa const& soa, bsta_mog3_grey_type* models, unsigned n, unsigned offset = 0);
+void bsta_mog3_unpack(bsta_mog3_soa const& soa, bsta_mog3_rgb_type* models, unsigned n, unsigned offset = 0);
+
+//: Probability density of the samples x under models [begin,end)
+//  x holds dim() values per model, p one value per model.  As in the bvxm
+//  processors, the density of a model without components is 1.
+void bsta_mog3_prob_density(bsta_mog3_soa const& soa, float const* x, float* p,
+                            unsigned begin, unsigned end);
+
+//: Expected value (weighted mean of the component means) of models [begin,end)
+//  ev holds dim() values per model; it is 0 for models without components.
+void bsta_mog3_expected_value(bsta_mog3_soa const& soa, float* ev,
+                              unsigned begin, unsigned end);
+
+//: Update models [begin,end) with the samples x
+//  If w is not null the models are updated as by bsta_mg_grimson_weighted_updater
+//  with weight w[i] (models with w[i] <= 0 are left unchanged, as in the bvxm
+//  processors); otherwise as by bsta_mg_grimson_window_updater.
+void bsta_mog3_update(bsta_mog3_soa& soa, float const* x, float const* w,
+                      bsta_mog3_update_params const& params,
+                      unsigned begin, unsigned end);
+
+//: Probability density of x under the boxm2 packed grey mixtures [begin,end)
+//  mog3 holds 8 bytes per model (mu0,sigma0,w0,mu1,sigma1,w1,mu2,sigma2).
+void bsta_mog3_packed_prob_density(unsigned char const* mog3, float const* x, float* p,
+                                   unsigned begin, unsigned end);
+
+//: Expected intensity of the boxm2 packed grey mixtures [begin,end)
+void bsta_mog3_packed_expected_value(unsigned char const* mog3, float* ev,
+                                     unsigned begin, unsigned end);
+
+//: Online update of the boxm2 packed grey mixtures [begin,end)
+//  nobs holds 4 floats per model (the per component and the total observation
+//  counts), x and w one value per model.  The result is identical to that of
+//  boxm2_mog3_grey_processor::update_gauss_mixture_3().
+void bsta_mog3_packed_update(unsigned char* mog3, float* nobs, float const* x, float const* w,
+                             float init_sigma, float min_sigma,
+                             unsigned begin, unsigned end);
+
+#endif // bsta_mog3_kernels_h_
@@ -0,0 +1,177 @@
+//:
+// \file
+// \brief Compare the batched mixture kernels of bsta_mog3_kernels.h with the bsta mixture objects
+//        When run, updates and evaluates the same arrays of grey and RGB mixtures
+//        through both paths and reports the time per model.  The samples cycle
+//        through a few sets, so that most mixtures use all three components.
+//        Usage: bsta_algo_mog3_kernel_timings [n_models [n_iterations]]
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <bsta/algo/bsta_mog3_kernels.h>
+#include <bsta/algo/bsta_adaptive_updater.h>
+#include <vnl/vnl_random.h>
+#include <vul/vul_timer.h>
+#include <vcl_compiler.h>
+
+typedef bsta_mixture_fixed<bsta_num_obs<bsta_gauss_sf1>, 3> grey_mix;
+typedef bsta_mixture_fixed<bsta_num_obs<bsta_gauss_if3>, 3> rgb_mix;
+
+const unsigned n_sets = 4;
+
+static void make_samples(vnl_random& rng, unsigned n, unsigned dim,
+                         std::vector<float>& x, std::vector<float>& w)
+{
+  x.resize(n_sets*n*dim);
+  w.resize(n_sets*n);
+  for (unsigned i = 0; i < n_sets*n; ++i) {
+    float base = float(rng.lrand32(0,2))*0.35f + 0.1f;
+    for (unsigned d = 0; d < dim; ++d)
+      x[i*dim+d] = base + float(rng.normal())*0.03f;
+    w[i] = float(rng.drand32(0.05, 1.0));
+  }
+}
+
+static void report(char const* what, long t_obj, long t_soa, unsigned n, unsigned iters)
+{
+  double ns = 1.0e6/(double(n)*iters);
+  std::cout << what << ": objects " << t_obj*ns << " ns/model, kernels " << t_soa*ns
+            << " ns/model, speedup " << (t_soa > 0 ? double(t_obj)/t_soa : 0.0) << '\n';
+}
+
+static void time_grey(unsigned n, unsigned iters)
+{
+  vnl_random rng(1234);
+  std::vector<float> x, w, p(n), ev(n);
+  make_samples(rng, n, 1, x, w);
+
+  bsta_gauss_sf1 init_gauss(0.0f, 0.008f);
+  bsta_mg_grimson_weighted_updater<grey_mix> updater(init_gauss, 3, 2.5f, 0.02f);
+  bsta_mog3_update_params params(0.008f, 2.5f, 0.02f);
+  std::vector<bsta_mog3_grey_type> models(n);
+  bsta_mog3_soa soa(1, n);
+  bsta_mog3_pack(&models[0], n, soa);
+
+  vul_timer timer;
+  for (unsigned t = 0; t < iters; ++t)
+    for (unsigned i = 0; i < n; ++i)
+      updater(models[i], x[(t%n_sets)*n+i], w[(t%n_sets)*n+i]);
+  long t_obj = timer.user();
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    bsta_mog3_update(soa, &x[(t%n_sets)*n], &w[(t%n_sets)*n], params, 0, n);
+  report("grey update", t_obj, timer.user(), n, iters);
+
+  float sum = 0.0f;
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    for (unsigned i = 0; i < n; ++i)
+      sum += models[i].num_components() == 0 ? 1.0f : models[i].prob_density(x[(t%n_sets)*n+i]);
+  t_obj = timer.user();
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t) {
+    bsta_mog3_prob_density(soa, &x[(t%n_sets)*n], &p[0], 0, n);
+    sum += p[t % n];
+  }
+  report("grey prob_density", t_obj, timer.user(), n, iters);
+
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    for (unsigned i = 0; i < n; ++i) {
+      float sw = 0.0f, s = 0.0f;
+      for (unsigned c = 0; c < models[i].num_components(); ++c) {
+        sw += models[i].weight(c);
+        s += models[i].weight(c)*models[i].distribution(c).mean();
+      }
+      sum += sw > 0.0f ? s/sw : 0.0f;
+    }
+  t_obj = timer.user();
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t) {
+    bsta_mog3_expected_value(soa, &ev[0], 0, n);
+    sum += ev[t % n];
+  }
+  report("grey expected value", t_obj, timer.user(), n, iters);
+
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t) {
+    bsta_mog3_unpack(soa, &models[0], n);
+    bsta_mog3_pack(&models[0], n, soa);
+  }
+  std::cout << "grey pack+unpack: " << timer.user()*1.0e6/(double(n)*iters) << " ns/model"
+            << " (checksum " << sum << ")\n";
+}
+
+static void time_rgb(unsigned n, unsigned iters)
+{
+  vnl_random rng(4321);
+  std::vector<float> x, w, p(n);
+  make_samples(rng, n, 3, x, w);
+
+  bsta_gauss_if3 init_gauss(vnl_vector_fixed<float,3>(0.0f), vnl_vector_fixed<float,3>(0.008f));
+  bsta_mg_grimson_weighted_updater<rgb_mix> updater(init_gauss, 3, 2.5f, 0.02f);
+  bsta_mog3_update_params params(0.008f, 2.5f, 0.02f);
+  std::vector<bsta_mog3_rgb_type> models(n);
+  bsta_mog3_soa soa(3, n);
+  bsta_mog3_pack(&models[0], n, soa);
+
+  vul_timer timer;
+  for (unsigned t = 0; t < iters; ++t)
+    for (unsigned i = 0; i < n; ++i)
+      updater(models[i], vnl_vector_fixed<float,3>(&x[3*((t%n_sets)*n+i)]), w[(t%n_sets)*n+i]);
+  long t_obj = timer.user();
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    bsta_mog3_update(soa, &x[3*(t%n_sets)*n], &w[(t%n_sets)*n], params, 0, n);
+  report("rgb update", t_obj, timer.user(), n, iters);
+
+  float sum = 0.0f;
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    for (unsigned i = 0; i < n; ++i)
+      sum += models[i].num_components() == 0 ? 1.0f
+           : models[i].prob_density(vnl_vector_fixed<float,3>(&x[3*((t%n_sets)*n+i)]));
+  t_obj = timer.user();
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t) {
+    bsta_mog3_prob_density(soa, &x[3*(t%n_sets)*n], &p[0], 0, n);
+    sum += p[t % n];
+  }
+  report("rgb prob_density", t_obj, timer.user(), n, iters);
+  std::cout << "(checksum " << sum << ")\n";
+}
+
+static void time_packed(unsigned n, unsigned iters)
+{
+  vnl_random rng(5678);
+  std::vector<float> x, w, p(n);
+  make_samples(rng, n, 1, x, w);
+  std::vector<unsigned char> mog3(8*n, 0);
+  std::vector<float> nobs(4*n, 0.0f);
+
+  vul_timer timer;
+  for (unsigned t = 0; t < iters; ++t)
+    bsta_mog3_packed_update(&mog3[0], &nobs[0], &x[(t%n_sets)*n], &w[(t%n_sets)*n], 0.09f, 0.03f, 0, n);
+  long t_upd = timer.user();
+  timer.mark();
+  float sum = 0.0f;
+  for (unsigned t = 0; t < iters; ++t) {
+    bsta_mog3_packed_prob_density(&mog3[0], &x[(t%n_sets)*n], &p[0], 0, n);
+    sum += p[t % n];
+  }
+  double ns = 1.0e6/(double(n)*iters);
+  std::cout << "packed grey: update " << t_upd*ns << " ns/model, prob_density "
+            << timer.user()*ns << " ns/model (checksum " << sum << ")\n";
+}
+
+int main(int argc, char** argv)
+{
+  unsigned n = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  unsigned iters = argc > 2 ? std::atoi(argv[2]) : 10;
+  std::cout << n << " models, " << iters << " iterations\n";
+  time_grey(n, iters);
+  time_rgb(n, iters);
+  time_packed(n, iters);
+  return 0;
+}
@@ -0,0 +1,205 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <testlib/testlib_test.h>
+
+#include <bsta/algo/bsta_batch_fit.h>
+#include <bsta/bsta_k_means.h>
+#include <vnl/vnl_random.h>
+#include <vnl/vnl_vector.h>
+#include <vnl/vnl_math.h>
+#include <bsta/bsta_gauss_if2.h>
+
+#include <vcl_compiler.h>
+
+// n samples of dimension dim around the given centres, stored by dimension
+static void make_samples(vnl_random& rng, unsigned n, unsigned dim,
+                         std::vector<double> const& centres, std::vector<double> const& sigmas,
+                         std::vector<double>& data, std::vector<unsigned>& label)
+{
+  const unsigned k = static_cast<unsigned>(sigmas.size());
+  data.resize(n*dim);
+  label.resize(n);
+  for (unsigned i = 0; i<n; ++i) {
+    // unequal cluster sizes: 1/2, 1/3, 1/6 of the samples for k = 3
+    unsigned c = rng.lrand32(0, 5);
+    c = c<3 ? 0 : (c<5 ? 1 : 2);
+    c %= k;
+    label[i] = c;
+    for (unsigned d = 0; d<dim; ++d)
+      data[d*n + i] = centres[c*dim + d] + rng.normal()*sigmas[c];
+  }
+}
+
+static void test_k_means(vnl_random& rng)
+{
+  const unsigned n = 3000, dim = 3;
+  std::vector<double> truth(9), sigmas(3);
+  truth[0] = 0; truth[1] = 0; truth[2] = 0;
+  truth[3] = 4; truth[4] = 1; truth[5] = -2;
+  truth[6] = -3; truth[7] = 5; truth[8] = 1;
+  sigmas[0] = 1.0; sigmas[1] = 0.7; sigmas[2] = 1.2;
+  std::vector<double> data;
+  std::vector<unsigned> label;
+  make_samples(rng, n, dim, truth, sigmas, data, label);
+
+  // bsta_k_means from the same initial centres
+  std::vector<vnl_vector<double> > vdata(n, vnl_vector<double>(dim)), vcentres(3, vnl_vector<double>(dim));
+  for (unsigned i = 0; i<n; ++i)
+    for (unsigned d = 0; d<dim; ++d)
+      vdata[i][d] = data[d*n + i];
+  std::vector<double> centres(3*dim);
+  for (unsigned c = 0; c<3; ++c)
+    for (unsigned d = 0; d<dim; ++d)
+      vcentres[c][d] = centres[c*dim + d] = data[d*n + 17*c];
+  unsigned k0 = 3, k1 = 3;
+  std::vector<unsigned> p0, p1;
+  bsta_k_means(vdata, k0, &vcentres, &p0);
+  unsigned iters = bsta_k_means_hamerly(&data[0], n, dim, k1, centres, &p1);
+  TEST("same number of clusters", k0 == k1 && k1 == 3, true);
+  TEST("same partition", p0 == p1, true);
+  double err = 0.0;
+  for (unsigned c = 0; c<k1; ++c)
+    for (unsigned d = 0; d<dim; ++d)
+      err = std::max(err, std::fabs(vcentres[c][d] - centres[c*dim + d]));
+  TEST_NEAR("same centres", err, 0.0, 1e-9);
+  std::cout << "Hamerly k-means converged in " << iters << " passes\n";
+
+  // duplicate initial centres lose a cluster, as in bsta_k_means
+  std::vector<double> dup(3*dim);
+  for (unsigned d = 0; d<dim; ++d)
+    dup[d] = dup[dim + d] = dup[2*dim + d] = data[d*n];
+  dup[2*dim] += 5.0;
+  unsigned k2 = 3;
+  bsta_k_means_hamerly(&data[0], n, dim, k2, dup, &p1);
+  TEST("empty cluster removed", k2 == 2 && dup.size() == 2*dim && *std::max_element(p1.begin(), p1.end()) == 1, true);
+}
+
+static void test_em(vnl_random& rng)
+{
+  const unsigned n = 6000, dim = 2;
+  std::vector<double> truth(6), sigmas(3);
+  truth[0] = 0; truth[1] = 0;
+  truth[2] = 6; truth[3] = 1;
+  truth[4] = -2; truth[5] = 7;
+  sigmas[0] = 1.0; sigmas[1] = 0.5; sigmas[2] = 1.5;
+  std::vector<double> data;
+  std::vector<unsigned> label;
+  make_samples(rng, n, dim, truth, sigmas, data, label);
+
+  bsta_em_params<double> params(3, 200, 1e-9);
+  bsta_flat_mixture<double> fm;
+  unsigned iters = bsta_fit_mixture_em(&data[0], n, dim, params, fm);
+  std::cout << "EM converged in " << iters << " iterations, log likelihood " << fm.log_likelihood << '\n';
+  TEST("three components", fm.size() == 3 && fm.dim == dim, true);
+
+  // match each true component to the nearest fitted mean
+  const double true_w[3] = { 0.5, 1.0/3.0, 1.0/6.0 };
+  double err_m = 0.0, err_v = 0.0, err_w = 0.0;
+  for (unsigned t = 0; t<3; ++t) {
+    unsigned best = 0;
+    double bd = 1e30;
+    for (unsigned c = 0; c<fm.size(); ++c) {
+      double dd = 0.0;
+      for (unsigned d = 0; d<dim; ++d)
+        dd += (fm.mean(c,d) - truth[t*dim + d])*(fm.mean(c,d) - truth[t*dim + d]);
+      if (dd < bd) { bd = dd; best = c; }
+    }
+    err_m = std::max(err_m, std::sqrt(bd));
+    for (unsigned d = 0; d<dim; ++d)
+      err_v = std::max(err_v, std::fabs(std::sqrt(fm.var(best,d)) - sigmas[t])/sigmas[t]);
+    err_w = std::max(err_w, std::fabs(fm.weights[best] - true_w[t]));
+  }
+  TEST_NEAR("EM means", err_m, 0.0, 0.1);
+  TEST_NEAR("EM standard deviations", err_v, 0.0, 0.1);
+  TEST_NEAR("EM weights", err_w, 0.0, 0.03);
+
+  // the log likelihood is that of the fitted densities
+  double ll = 0.0;
+  for (unsigned i = 0; i<n; ++i) {
+    double p = 0.0;
+    for (unsigned c = 0; c<fm.size(); ++c) {
+      double e = 0.0, det = 1.0;
+      for (unsigned d = 0; d<dim; ++d) {
+        e += (data[d*n + i] - fm.mean(c,d))*(data[d*n + i] - fm.mean(c,d))/fm.var(c,d);
+        det *= 2.0*vnl_math::pi*fm.var(c,d);
+      }
+      p += fm.weights[c]*std::exp(-0.5*e)/std::sqrt(det);
+    }
+    ll += std::log(p);
+  }
+  TEST_NEAR("log likelihood", (ll - fm.log_likelihood)/n, 0.0, 1e-6);
+}
+
+static void test_batches(vnl_random& rng)
+{
+  // many small independent sets of different sizes
+  const unsigned ns = 60, dim = 2;
+  std::vector<double> truth(6), sigmas(3, 0.8);
+  truth[0] = 0; truth[1] = 0; truth[2] = 5; truth[3] = 0; truth[4] = 0; truth[5] = 5;
+  std::vector<std::vector<double> > sets(ns);
+  std::vector<double const*> data(ns);
+  std::vector<unsigned> sizes(ns), label;
+  for (unsigned s = 0; s<ns; ++s) {
+    sizes[s] = s == 7 ? 2 : 20 + 13*s;
+    make_samples(rng, sizes[s], dim, truth, sigmas, sets[s], label);
+    data[s] = &sets[s][0];
+  }
+
+  std::vector<std::vector<double> > centres1, centres3;
+  std::vector<std::vector<unsigned> > parts1, parts3;
+  std::vector<unsigned> ks1, ks3;
+  bsta_k_means_batch(data, sizes, dim, 3, centres1, parts1, ks1, 1);
+  bsta_k_means_batch(data, sizes, dim, 3, centres3, parts3, ks3, 3);
+  bool same = centres1 == centres3 && parts1 == parts3 && ks1 == ks3;
+  for (unsigned s = 0; s<ns && same; ++s) {
+    unsigned k = std::min(3u, sizes[s]);
+    std::vector<double> c;
+    std::vector<unsigned> p;
+    bsta_k_means_hamerly(data[s], sizes[s], dim, k, c, &p);
+    same = c == centres1[s] && p == parts1[s] && k == ks1[s];
+  }
+  TEST("k-means batch equals single fits", same, true);
+  TEST("small set clustered", ks1[7] <= 2 && parts1[7].size() == 2, true);
+
+  bsta_em_params<double> params(3);
+  std::vector<bsta_flat_mixture<double> > mix1, mix3;
+  bsta_fit_mixture_em_batch(data, sizes, dim, params, mix1, 1);
+  bsta_fit_mixture_em_batch(data, sizes, dim, params, mix3, 3);
+  same = true;
+  for (unsigned s = 0; s<ns; ++s) {
+    bsta_flat_mixture<double> fm;
+    bsta_fit_mixture_em(data[s], sizes[s], dim, params, fm);
+    same = same && fm.means == mix1[s].means && fm.vars == mix1[s].vars && fm.weights == mix1[s].weights &&
+           mix3[s].means == mix1[s].means && mix3[s].log_likelihood == mix1[s].log_likelihood;
+  }
+  TEST("EM batch equals single fits", same, true);
+
+  // float samples
+  std::vector<float> fdata(sets[40].begin(), sets[40].end());
+  bsta_flat_mixture<float> ffm;
+  bsta_fit_mixture_em(&fdata[0], sizes[40], dim, bsta_em_params<float>(3), ffm);
+  double err = 0.0;
+  for (unsigned j = 0; j<ffm.means.size(); ++j)
+    err = std::max(err, std::fabs(ffm.means[j] - mix1[40].means[j]));
+  TEST_NEAR("float EM", err, 0.0, 1e-3);
+
+  // conversion to a bsta mixture
+  bsta_mixture<bsta_gaussian_indep<float,2> > mix = bsta_to_mixture<float,2>(ffm);
+  bool ok = mix.num_components() == ffm.size();
+  for (unsigned c = 0; c<mix.num_components() && ok; ++c)
+    ok = mix.weight(c) == ffm.weights[c] && mix.distribution(c).mean()[1] == ffm.mean(c,1) &&
+         mix.distribution(c).diag_covar()[0] == ffm.var(c,0);
+  TEST("bsta_to_mixture", ok, true);
+}
+
+static void test_batch_fit()
+{
+  vnl_random rng(31337);
+  test_k_means(rng);
+  test_em(rng);
+  test_batches(rng);
+}
+
+TESTMAIN(test_batch_fit);
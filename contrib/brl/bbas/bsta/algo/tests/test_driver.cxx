@@ -8,6 +8,8 @@ DECLARE( test_von_mises_update );
 DECLARE( test_beta_updater );
 DECLARE( test_rand_sampling );
 DECLARE( test_display_vrml );
+DECLARE( test_mog3_kernels );
+DECLARE( test_batch_fit );
 
 void
 register_tests()
@@ -20,6 +22,8 @@ register_tests()
   REGISTER( test_beta_updater );
   REGISTER( test_rand_sampling );
   REGISTER( test_display_vrml );
+  REGISTER( test_mog3_kernels );
+  REGISTER( test_batch_fit );
 
 }
 
@@ -1,4 +1,5 @@
 #include <bsta/algo/bsta_adaptive_updater.h>
+#include <bsta/algo/bsta_batch_fit.h>
 #include <bsta/algo/bsta_bayes_functor.h>
 #include <bsta/algo/bsta_beta_updater.h>
 #include <bsta/algo/bsta_fit_gaussian.h>
@@ -7,6 +8,7 @@
 #include <bsta/algo/bsta_gaussian_updater.h>
 #include <bsta/algo/bsta_mean_shift.h>
 #include <bsta/algo/bsta_mixture_functors.h>
+#include <bsta/algo/bsta_mog3_kernels.h>
 #include <bsta/algo/bsta_parzen_updater.h>
 #include <bsta/algo/bsta_sample_set.h>
 #include <bsta/algo/bsta_sigma_normalizer.h>
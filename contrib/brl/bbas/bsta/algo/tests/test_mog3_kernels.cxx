@@ -0,0 +1,184 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <testlib/testlib_test.h>
+
+#include <bsta/algo/bsta_mog3_kernels.h>
+#include <bsta/algo/bsta_adaptive_updater.h>
+#include <vnl/vnl_random.h>
+
+#include <vcl_compiler.h>
+
+typedef bsta_mixture_fixed<bsta_num_obs<bsta_gauss_sf1>, 3> grey_mix;
+typedef bsta_mixture_fixed<bsta_num_obs<bsta_gauss_if3>, 3> rgb_mix;
+
+static bool same_model(bsta_mog3_grey_type const& a, bsta_mog3_grey_type const& b, float tol)
+{
+  if (a.num_components() != b.num_components() ||
+      std::fabs(a.num_observations - b.num_observations) > tol)
+    return false;
+  for (unsigned c = 0; c < a.num_components(); ++c)
+    if (std::fabs(a.weight(c) - b.weight(c)) > tol ||
+        std::fabs(a.distribution(c).mean() - b.distribution(c).mean()) > tol ||
+        std::fabs(a.distribution(c).var() - b.distribution(c).var()) > tol ||
+        a.distribution(c).num_observations != b.distribution(c).num_observations)
+      return false;
+  return true;
+}
+
+static bool same_model(bsta_mog3_rgb_type const& a, bsta_mog3_rgb_type const& b, float tol)
+{
+  if (a.num_components() != b.num_components() ||
+      std::fabs(a.num_observations - b.num_observations) > tol)
+    return false;
+  for (unsigned c = 0; c < a.num_components(); ++c) {
+    if (std::fabs(a.weight(c) - b.weight(c)) > tol ||
+        a.distribution(c).num_observations != b.distribution(c).num_observations)
+      return false;
+    for (unsigned d = 0; d < 3; ++d)
+      if (std::fabs(a.distribution(c).mean()[d] - b.distribution(c).mean()[d]) > tol ||
+          std::fabs(a.distribution(c).diag_covar()[d] - b.distribution(c).diag_covar()[d]) > tol)
+        return false;
+  }
+  return true;
+}
+
+// samples drawn around one of three intensities per model, so that the
+// mixtures fill up, match, insert and reorder their components
+static void make_samples(vnl_random& rng, unsigned n, unsigned dim,
+                         std::vector<float>& x, std::vector<float>& w)
+{
+  x.resize(n*dim);
+  w.resize(n);
+  for (unsigned i = 0; i < n; ++i) {
+    float base = float(rng.lrand32(0,2))*0.35f + 0.1f;
+    for (unsigned d = 0; d < dim; ++d)
+      x[i*dim+d] = base + float(rng.normal())*0.03f + 0.05f*d;
+    w[i] = rng.lrand32(0,9) == 0 ? 0.0f : float(rng.drand32(0.05, 1.0));
+  }
+}
+
+static void test_grey(vnl_random& rng, bool weighted)
+{
+  const unsigned n = 500, iters = 40;
+  bsta_gauss_sf1 init_gauss(0.0f, 0.008f);
+  bsta_mg_grimson_weighted_updater<grey_mix> wupdater(init_gauss, 3, 2.5f, 0.02f);
+  bsta_mg_grimson_window_updater<grey_mix> updater(init_gauss, 3, 2.5f, 0.02f, 20);
+  bsta_mog3_update_params params(0.008f, 2.5f, 0.02f, 20);
+
+  std::vector<bsta_mog3_grey_type> models(n), result(n);
+  bsta_mog3_soa soa(1, n);
+  bsta_mog3_pack(&models[0], n, soa);
+
+  std::vector<float> x, w;
+  for (unsigned t = 0; t < iters; ++t) {
+    make_samples(rng, n, 1, x, w);
+    for (unsigned i = 0; i < n; ++i) {
+      if (weighted) {
+        if (w[i] > 0.0f)
+          wupdater(models[i], x[i], w[i]);
+      }
+      else
+        updater(models[i], x[i]);
+    }
+    // split the batch to exercise the [begin,end) ranges
+    bsta_mog3_update(soa, &x[0], weighted ? &w[0] : VXL_NULLPTR, params, 0, n/3);
+    bsta_mog3_update(soa, &x[0], weighted ? &w[0] : VXL_NULLPTR, params, n/3, n);
+  }
+  bsta_mog3_unpack(soa, &result[0], n);
+  unsigned n_same = 0;
+  for (unsigned i = 0; i < n; ++i)
+    if (same_model(models[i], result[i], 1e-5f))
+      ++n_same;
+  TEST_EQUAL(weighted ? "grey weighted update" : "grey window update", n_same, n);
+
+  // densities and expected values
+  make_samples(rng, n, 1, x, w);
+  std::vector<float> p(n), ev(n);
+  bsta_mog3_prob_density(soa, &x[0], &p[0], 0, n);
+  bsta_mog3_expected_value(soa, &ev[0], 0, n);
+  double max_dp = 0.0, max_dev = 0.0;
+  for (unsigned i = 0; i < n; ++i) {
+    float p_obj = models[i].num_components() == 0 ? 1.0f : models[i].prob_density(x[i]);
+    float sum_w = 0.0f, sum = 0.0f;
+    for (unsigned c = 0; c < models[i].num_components(); ++c) {
+      sum_w += models[i].weight(c);
+      sum += models[i].weight(c)*models[i].distribution(c).mean();
+    }
+    float ev_obj = sum_w > 0.0f ? sum/sum_w : 0.0f;
+    max_dp = std::max(max_dp, double(std::fabs(p_obj - p[i]))/std::max(1.0, double(p_obj)));
+    max_dev = std::max(max_dev, double(std::fabs(ev_obj - ev[i])));
+  }
+  TEST_NEAR("grey prob_density", max_dp, 0.0, 1e-5);
+  TEST_NEAR("grey expected value", max_dev, 0.0, 1e-6);
+}
+
+static void test_rgb(vnl_random& rng)
+{
+  const unsigned n = 300, iters = 40;
+  bsta_gauss_if3 init_gauss(vnl_vector_fixed<float,3>(0.0f), vnl_vector_fixed<float,3>(0.008f));
+  bsta_mg_grimson_weighted_updater<rgb_mix> updater(init_gauss, 3, 2.5f, 0.02f);
+  bsta_mog3_update_params params(0.008f, 2.5f, 0.02f);
+
+  std::vector<bsta_mog3_rgb_type> models(n), result(n);
+  bsta_mog3_soa soa(3, n);
+  bsta_mog3_pack(&models[0], n, soa);
+
+  std::vector<float> x, w;
+  for (unsigned t = 0; t < iters; ++t) {
+    make_samples(rng, n, 3, x, w);
+    for (unsigned i = 0; i < n; ++i)
+      if (w[i] > 0.0f)
+        updater(models[i], vnl_vector_fixed<float,3>(&x[3*i]), w[i]);
+    bsta_mog3_update(soa, &x[0], &w[0], params, 0, n);
+  }
+  bsta_mog3_unpack(soa, &result[0], n);
+  unsigned n_same = 0;
+  for (unsigned i = 0; i < n; ++i)
+    if (same_model(models[i], result[i], 1e-5f))
+      ++n_same;
+  TEST_EQUAL("rgb weighted update", n_same, n);
+
+  make_samples(rng, n, 3, x, w);
+  std::vector<float> p(n), ev(3*n);
+  bsta_mog3_prob_density(soa, &x[0], &p[0], 0, n);
+  bsta_mog3_expected_value(soa, &ev[0], 0, n);
+  double max_dp = 0.0, max_dev = 0.0;
+  for (unsigned i = 0; i < n; ++i) {
+    float p_obj = models[i].num_components() == 0 ? 1.0f
+                : models[i].prob_density(vnl_vector_fixed<float,3>(&x[3*i]));
+    max_dp = std::max(max_dp, double(std::fabs(p_obj - p[i]))/std::max(1.0, double(p_obj)));
+    float sum_w = 0.0f;
+    vnl_vector_fixed<float,3> sum(0.0f);
+    for (unsigned c = 0; c < models[i].num_components(); ++c) {
+      sum_w += models[i].weight(c);
+      sum += models[i].weight(c)*models[i].distribution(c).mean();
+    }
+    for (unsigned d = 0; d < 3; ++d)
+      max_dev = std::max(max_dev, double(std::fabs((sum_w > 0.0f ? sum[d]/sum_w : 0.0f) - ev[3*i+d])));
+  }
+  TEST_NEAR("rgb prob_density", max_dp, 0.0, 1e-5);
+  TEST_NEAR("rgb expected value", max_dev, 0.0, 1e-6);
+}
+
+static void test_mog3_kernels()
+{
+  vnl_random rng(9667566);
+  test_grey(rng, true);
+  test_grey(rng, false);
+  test_rgb(rng);
+
+  // pack/unpack round trip, with an offset
+  bsta_mog3_grey_type mix;
+  mix.insert(bsta_num_obs<bsta_gauss_sf1>(bsta_gauss_sf1(0.25f, 0.01f), 4.0f), 0.75f);
+  mix.insert(bsta_num_obs<bsta_gauss_sf1>(bsta_gauss_sf1(0.5f, 0.02f), 2.0f), 0.25f);
+  mix.num_observations = 6.0f;
+  bsta_mog3_soa soa(1, 4);
+  bsta_mog3_pack(&mix, 1, soa, 2);
+  bsta_mog3_grey_type back;
+  bsta_mog3_unpack(soa, &back, 1, 2);
+  TEST("pack/unpack", same_model(mix, back, 0.0f), true);
+}
+
+TESTMAIN(test_mog3_kernels);
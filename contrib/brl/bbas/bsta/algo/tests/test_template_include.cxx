@@ -1,4 +1,5 @@
 #include <bsta/algo/bsta_adaptive_updater.hxx>
+#include <bsta/algo/bsta_batch_fit.hxx>
 #include <bsta/algo/bsta_beta_updater.hxx>
 #include <bsta/algo/bsta_mean_shift.hxx>
 #include <bsta/algo/bsta_parzen_updater.hxx>
@@ -51,6 +51,15 @@ inline std::ostream& operator<< (std::ostream& os,
   return os;
 }
 
+//: Equal if the distributions and the numbers of observations are equal
+template <class dist_>
+inline bool operator==(bsta_num_obs<dist_> const& a,
+                       bsta_num_obs<dist_> const& b)
+{
+  return a.num_observations == b.num_observations &&
+         static_cast<dist_ const&>(a) == static_cast<dist_ const&>(b);
+}
+
 //: for compatibility with vpdl/vpdt
 template <class dist>
 struct vpdt_is_mixture<bsta_num_obs<dist> >
@@ -93,6 +102,15 @@ inline std::ostream& operator<< (std::ostream& os,
   return os;
 }
 
+//: Equal if the distributions, the vector sums and the numbers of observations are equal
+template <class dist_>
+inline bool operator==(bsta_vsum_num_obs<dist_> const& a,
+                       bsta_vsum_num_obs<dist_> const& b)
+{
+  return a.num_observations == b.num_observations && a.vector_sum == b.vector_sum &&
+         static_cast<dist_ const&>(a) == static_cast<dist_ const&>(b);
+}
+
 //: for compatibility with vpdl/vpdt
 template <class dist>
 struct vpdt_is_mixture<bsta_vsum_num_obs<dist> >
@@ -111,4 +111,12 @@ inline std::ostream& operator<< (std::ostream& os,
   return os;
 }
 
+//: Equal if the means and the covariances are equal
+template <class T , unsigned n>
+inline bool operator==(bsta_gaussian_indep<T, n> const& a,
+                       bsta_gaussian_indep<T, n> const& b)
+{
+  return a.mean() == b.mean() && a.diag_covar() == b.diag_covar();
+}
+
 #endif // bsta_gaussian_indep_h_
@@ -97,4 +97,12 @@ inline std::ostream& operator<< (std::ostream& os,
   return os;
 }
 
+//: Equal if the means and the variances are equal
+template <class T , unsigned n>
+inline bool operator==(bsta_gaussian_sphere<T, n> const& a,
+                       bsta_gaussian_sphere<T, n> const& b)
+{
+  return a.mean() == b.mean() && a.var() == b.var();
+}
+
 #endif // bsta_gaussian_sphere_h_
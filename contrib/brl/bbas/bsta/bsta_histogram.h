@@ -13,6 +13,9 @@
 //  J.L. Mundy added min,max, percentile methods
 //  B.A. Mayer add clear() method so a single instance can revert
 //             to the default constructor to be reused.
+//  Oct 2026 - bulk upcount_array() with constant time bin lookup and optional
+//             per thread counts; entropy and percentile queries cached until
+//             the next update
 // \endverbatim
 
 #include <vector>
@@ -126,12 +129,25 @@ template <class T> class bsta_histogram : public bsta_histogram_base
  //: Increase the count of the bin corresponding to val by mag
   void upcount(T val, T mag);
 
+  //: Increase the counts of the bins of n values by mag each
+  //  Same result as upcount(vals[i], mag) for each value, but the bin is found
+  //  in constant time.  With num_threads > 1 (0 = one per processor) blocks of
+  //  values are counted on separate threads and added in order at the end.
+  void upcount_array(T const* vals, unsigned n, T mag = T(1), unsigned num_threads = 1);
+
+  //: Increase the count of the bin of each of n values by the corresponding magnitude
+  void upcount_array(T const* vals, T const* mags, unsigned n, unsigned num_threads = 1);
+
+  //: Increase the counts of the bins of n byte values by mag each
+  //  The bin of each of the 256 values is found once.
+  void upcount_array(unsigned char const* vals, unsigned n, T mag = T(1), unsigned num_threads = 1);
+
   //: Return the bin this element would fall on - it doesn't modify the current count
   int bin_at_val(T val);
 
   //: set the count for a given bin
   void set_count(const unsigned bin, const T count)
-  { if (bin<nbins_){ counts_[bin]=count; area_valid_ = false;}}
+  { if (bin<nbins_){ counts_[bin]=count; invalidate();}}
 
   //: array of bin values
   std::vector<T> value_array() const {
@@ -170,6 +186,9 @@ template <class T> class bsta_histogram : public bsta_histogram_base
 
  private:
   void compute_area() const; // mutable const
+  //: mark the area and the cached statistics as out of date
+  void invalidate() const
+  { area_valid_ = false; entropy_valid_ = false; renyi_valid_ = false; cum_valid_ = false; }
   mutable bool area_valid_;
   mutable T area_;
   unsigned int nbins_;
@@ -179,6 +198,12 @@ template <class T> class bsta_histogram : public bsta_histogram_base
   T min_;
   T max_;
   std::vector<T> counts_;
+  //: cached statistics, valid until the counts change
+  mutable bool entropy_valid_, renyi_valid_, cum_valid_;
+  mutable T entropy_, renyi_entropy_;
+  //: cumulative counts of bins [0,i], and whether they never decrease
+  mutable std::vector<T> cum_counts_;
+  mutable bool cum_monotone_;
 };
 
 //: Write histogram to stream
@@ -4,17 +4,20 @@
 // \file
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "bsta_histogram.h"
 
 #include <vcl_compiler.h>
 #include <vcl_cassert.h>
 #include "bsta_gauss.h"
+#include "bsta_histogram_bins.h"
 #include <vnl/vnl_math.h> // for log2e == 1/std::log(2.0)
 
 template <class T>
 bsta_histogram<T>::bsta_histogram()
   : area_valid_(false), area_(0), nbins_(0), range_(0),
-    delta_(0),min_prob_(0), min_(0), max_(0)
+    delta_(0),min_prob_(0), min_(0), max_(0), entropy_valid_(false), renyi_valid_(false), cum_valid_(false),
+    entropy_(0), renyi_entropy_(0), cum_monotone_(true)
 {
   bsta_histogram_base::type_ = bsta_histogram_traits<T>::type();
 }
@@ -23,7 +26,8 @@ template <class T>
 bsta_histogram<T>::bsta_histogram(const T range, const unsigned int nbins,
                                   const T min_prob)
   : area_valid_(false), area_(0), nbins_(nbins), range_(range),
-    delta_(0),min_prob_(min_prob), min_(0), max_(range)
+    delta_(0),min_prob_(min_prob), min_(0), max_(range), entropy_valid_(false), renyi_valid_(false), cum_valid_(false),
+    entropy_(0), renyi_entropy_(0), cum_monotone_(true)
 {
   bsta_histogram_base::type_ = bsta_histogram_traits<T>::type();
   if (nbins>0)
@@ -38,7 +42,8 @@ bsta_histogram<T>::bsta_histogram(const T min, const T max,
                                   const unsigned int nbins,
                                   const T min_prob)
   : area_valid_(false), area_(0), nbins_(nbins), delta_(0),
-    min_prob_(min_prob), min_(min), max_(max)
+    min_prob_(min_prob), min_(min), max_(max), entropy_valid_(false), renyi_valid_(false), cum_valid_(false),
+    entropy_(0), renyi_entropy_(0), cum_monotone_(true)
 {
   bsta_histogram_base::type_ = bsta_histogram_traits<T>::type();
   if (nbins>0)
@@ -58,7 +63,8 @@ template <class T>
 bsta_histogram<T>::bsta_histogram(const unsigned int nbins, const T min, const T delta,
                                   const T min_prob)
  : area_valid_(false), area_(0), nbins_(nbins), delta_(delta),
-    min_prob_(min_prob), min_(min), max_(min+nbins*delta)
+    min_prob_(min_prob), min_(min), max_(min+nbins*delta), entropy_valid_(false), renyi_valid_(false), cum_valid_(false),
+    entropy_(0), renyi_entropy_(0), cum_monotone_(true)
 {
   bsta_histogram_base::type_ = bsta_histogram_traits<T>::type();
   if (nbins>0)
@@ -74,7 +80,8 @@ template <class T>
 bsta_histogram<T>::bsta_histogram(const T min, const T max,
                                   std::vector<T> const& data, const T min_prob)
   : area_valid_(false), area_(0), delta_(0), min_prob_(min_prob),
-    min_(min), max_(max), counts_(data)
+    min_(min), max_(max), counts_(data), entropy_valid_(false), renyi_valid_(false), cum_valid_(false),
+    entropy_(0), renyi_entropy_(0), cum_monotone_(true)
 {
   bsta_histogram_base::type_ = bsta_histogram_traits<T>::type();
   nbins_ = data.size();
@@ -90,13 +97,92 @@ void bsta_histogram<T>::upcount(T x, T mag)
 {
   if (x<min_||x>max_)
     return;
-  for (unsigned int i = 0; i<nbins_; ++i)
-    if (T((i+1)*delta_) + min_ >= x)
-    {
-      counts_[i] += mag;
-      break;
-    }
-  area_valid_ = false;
+  int i = bsta_value_bin(x, min_, delta_, bsta_inv_delta(delta_), nbins_);
+  if (i >= 0)
+    counts_[i] += mag;
+  invalidate();
+}
+
+//: Bin of a value, the first bin of upcount() at constant cost
+template <class T>
+struct bsta_histogram_value_binner
+{
+  T const* vals;
+  T const* mags;
+  T mag0, min, max, delta;
+  double inv_delta;
+  unsigned nbins;
+
+  int bin(unsigned i) const
+  {
+    T x = vals[i];
+    if (x<min||x>max)
+      return -1;
+    return bsta_value_bin(x, min, delta, inv_delta, nbins);
+  }
+  T mag(unsigned i) const { return mags ? mags[i] : mag0; }
+};
+
+//: Bin of a byte value from a table
+template <class T>
+struct bsta_histogram_byte_binner
+{
+  unsigned char const* vals;
+  int table[256];
+  T mag0;
+
+  int bin(unsigned i) const { return table[vals[i]]; }
+  T mag(unsigned /*i*/) const { return mag0; }
+};
+
+template <class T>
+void bsta_histogram<T>::upcount_array(T const* vals, unsigned n, T mag, unsigned num_threads)
+{
+  bsta_histogram_value_binner<T> binner;
+  binner.vals = vals;
+  binner.mags = VXL_NULLPTR;
+  binner.mag0 = mag;
+  binner.min = min_;
+  binner.max = max_;
+  binner.delta = delta_;
+  binner.inv_delta = bsta_inv_delta(delta_);
+  binner.nbins = nbins_;
+  if (nbins_ > 0)
+    bsta_bulk_upcount(binner, n, &counts_[0], nbins_, num_threads);
+  invalidate();
+}
+
+template <class T>
+void bsta_histogram<T>::upcount_array(T const* vals, T const* mags, unsigned n, unsigned num_threads)
+{
+  bsta_histogram_value_binner<T> binner;
+  binner.vals = vals;
+  binner.mags = mags;
+  binner.mag0 = T(0);
+  binner.min = min_;
+  binner.max = max_;
+  binner.delta = delta_;
+  binner.inv_delta = bsta_inv_delta(delta_);
+  binner.nbins = nbins_;
+  if (nbins_ > 0)
+    bsta_bulk_upcount(binner, n, &counts_[0], nbins_, num_threads);
+  invalidate();
+}
+
+template <class T>
+void bsta_histogram<T>::upcount_array(unsigned char const* vals, unsigned n, T mag, unsigned num_threads)
+{
+  bsta_histogram_byte_binner<T> binner;
+  binner.vals = vals;
+  binner.mag0 = mag;
+  const double inv_delta = bsta_inv_delta(delta_);
+  for (unsigned v = 0; v<256; ++v) {
+    T x = T(v);
+    binner.table[v] = (x<min_||x>max_) ? -1 : bsta_value_bin(x, min_, delta_, inv_delta, nbins_);
+  }
+  if (nbins_ > 0)
+    bsta_bulk_upcount(binner, n, &counts_[0], nbins_, num_threads);
+  invalidate();
 }
 
 template <class T>
@@ -105,12 +191,7 @@ int bsta_histogram<T>::bin_at_val(T x)
 {
   if (x<min_||x>max_)
     return -1;
-  for (unsigned int i = 0; i<nbins_; ++i)
-    if (T((i+1)*delta_) + min_ >= x)
-    {
-      return i;
-    }
-  return -1;
+  return bsta_value_bin(x, min_, delta_, bsta_inv_delta(delta_), nbins_);
 }
 
 template <class T>
@@ -153,11 +234,8 @@ T bsta_histogram<T>::p(const T val) const
     compute_area();
   if (area_ == T(0))
     return 0;
-  else
-    for (unsigned int i = 0; i<nbins_; ++i)
-      if (T((i+1)*delta_) + min_ >= val)
-        return counts_[i]/area_;
-  return 0;
+  int i = bsta_value_bin(val, min_, delta_, bsta_inv_delta(delta_), nbins_);
+  return i >= 0 ? counts_[i]/area_ : T(0);
 }
 
 template <class T>
@@ -269,6 +347,8 @@ variance_vals(const T low, const T high) const
 template <class T>
 T bsta_histogram<T>::entropy() const
 {
+  if (entropy_valid_)
+    return entropy_;
   double ent = 0;
   for (unsigned int i = 0; i<nbins_; ++i)
   {
@@ -277,12 +357,16 @@ T bsta_histogram<T>::entropy() const
       ent -= pi*std::log(pi);
   }
   ent *= vnl_math::log2e;
-  return T(ent);
+  entropy_ = T(ent);
+  entropy_valid_ = true;
+  return entropy_;
 }
 
 template <class T>
 T bsta_histogram<T>::renyi_entropy() const
 {
+  if (renyi_valid_)
+    return renyi_entropy_;
   double sum = 0, ent = 0;
   for (unsigned int i = 0; i<nbins_; ++i)
   {
@@ -291,7 +375,9 @@ T bsta_histogram<T>::renyi_entropy() const
   }
   if (sum>min_prob_)
     ent = - std::log(sum)*vnl_math::log2e;
-  return T(ent);
+  renyi_entropy_ = T(ent);
+  renyi_valid_ = true;
+  return renyi_entropy_;
 }
 
 template <class T>
@@ -306,6 +392,7 @@ void bsta_histogram<T>::parzen(const T sigma)
   bsta_gauss::bsta_1d_gaussian(sd, in, out);
   for (unsigned int i=0; i<nbins_; ++i)
     counts_[i]=(T)out[i];
+  invalidate();
 }
 
 //The first non-zero bin starting at index = 0
@@ -372,13 +459,26 @@ T bsta_histogram<T>::value_with_area_below(const T area_fraction) const
     compute_area();
   if (area_ == T(0))
     return 0;
-  T sum = 0;
-  for (unsigned int i=0; i<nbins_; ++i)
-  {
-    sum += counts_[i];
-    if (sum>=area_fraction*area_)
-      return (i+1)*delta_+min_;
+  // the running sums of the bin counts are kept until the next update
+  if (!cum_valid_) {
+    cum_counts_.resize(nbins_);
+    cum_monotone_ = true;
+    T sum = 0;
+    for (unsigned int i=0; i<nbins_; ++i) {
+      sum += counts_[i];
+      cum_monotone_ = cum_monotone_ && counts_[i] >= T(0);
+      cum_counts_[i] = sum;
+    }
+    cum_valid_ = true;
   }
+  const T target = area_fraction*area_;
+  unsigned i;
+  if (cum_monotone_)
+    i = static_cast<unsigned>(std::lower_bound(cum_counts_.begin(), cum_counts_.end(), target) - cum_counts_.begin());
+  else
+    for (i = 0; i<nbins_ && !(cum_counts_[i]>=target); ++i) /*nothing*/;
+  if (i<nbins_)
+    return (i+1)*delta_+min_;
   return 0;
 }
 
@@ -406,7 +506,7 @@ T  bsta_histogram<T>::value_with_area_above(const T area_fraction) const
 template <class T>
 void bsta_histogram<T>::clear()
 {
-    area_valid_ = false;
+    invalidate();
     area_ = T(0);
     counts_.assign(nbins_,T(0));
 }
@@ -503,6 +603,7 @@ std::istream& bsta_histogram<T>::read(std::istream& s)
   counts_.resize(nbins_);
   for (unsigned i = 0; i < counts_.size() ; ++i)
     s >> counts_[i] ;
+  entropy_valid_ = renyi_valid_ = cum_valid_ = false;
   return  s;
 }
 
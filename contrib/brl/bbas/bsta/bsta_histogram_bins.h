@@ -0,0 +1,125 @@
+// This is brl/bbas/bsta/bsta_histogram_bins.h
+#ifndef bsta_histogram_bins_h_
+#define bsta_histogram_bins_h_
+//:
+// \file
+// \brief Constant time bin lookup and bulk accumulation for the bsta histograms
+//
+// The histograms find the bin of a value by scanning the bins for the first
+// whose upper limit is not below the value.  The functions here find the same
+// bin from a precomputed reciprocal of the bin width, and then step to the
+// neighbouring bins with the comparison of the scan until it holds, so the
+// result is identical to that of the scan (the comparisons round exactly as
+// in the scan) at the cost of a multiply and one or two comparisons.
+//
+// bsta_bulk_upcount() accumulates many samples into a histogram, optionally
+// on several threads, each filling a private set of counts that are added to
+// the histogram in a fixed order at the end.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <vcl_compiler.h>
+#include <vpl/vpl_parallel_for.h>
+
+//: First bin i < nbins with (i+1)*delta >= offset, the rule of bsta_joint_histogram; -1 if none
+//  inv_delta is 1/delta.
+template <class T>
+inline int bsta_offset_bin(T offset, T delta, double inv_delta, unsigned nbins)
+{
+  if (nbins == 0)
+    return -1;
+  double e = double(offset)*inv_delta;
+  unsigned i = 0;
+  if (delta > T(0) && e > 0.0)
+    i = e < double(nbins-1) ? static_cast<unsigned>(e) : nbins-1;
+  while (i>0 && i*delta>=offset)
+    --i;
+  while (i<nbins && !((i+1)*delta>=offset))
+    ++i;
+  return i<nbins ? static_cast<int>(i) : -1;
+}
+
+//: First bin i < nbins with T((i+1)*delta) + min >= x, the rule of bsta_histogram; -1 if none
+template <class T>
+inline int bsta_value_bin(T x, T min, T delta, double inv_delta, unsigned nbins)
+{
+  if (nbins == 0)
+    return -1;
+  double e = double(x - min)*inv_delta;
+  unsigned i = 0;
+  if (delta > T(0) && e > 0.0)
+    i = e < double(nbins-1) ? static_cast<unsigned>(e) : nbins-1;
+  while (i>0 && T(i*delta) + min >= x)
+    --i;
+  while (i<nbins && !(T((i+1)*delta) + min >= x))
+    ++i;
+  return i<nbins ? static_cast<int>(i) : -1;
+}
+
+//: Reciprocal of a bin width, 0 for an empty width
+template <class T>
+inline double bsta_inv_delta(T delta)
+{
+  return delta > T(0) ? 1.0/double(delta) : 0.0;
+}
+
+//: Counts of the samples of blocks [begin,end) of a bulk update
+template <class T, class binner_>
+struct bsta_bulk_upcount_body : public vpl_parallel_for_body
+{
+  binner_ const* binner;
+  unsigned n, n_blocks, size;
+  //: the counts of each block
+  std::vector<std::vector<T> > sub;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned b = begin; b<end; ++b) {
+      std::vector<T>& counts = sub[b];
+      counts.assign(size, T(0));
+      unsigned i0 = static_cast<unsigned>((unsigned long long)(n)*b/n_blocks);
+      unsigned i1 = static_cast<unsigned>((unsigned long long)(n)*(b+1)/n_blocks);
+      for (unsigned i = i0; i<i1; ++i) {
+        int k = binner->bin(i);
+        if (k >= 0)
+          counts[k] += binner->mag(i);
+      }
+    }
+  }
+};
+
+//: Add binner.mag(i) to counts[binner.bin(i)] for the samples i in [0,n)
+//  Samples with a negative bin are skipped.  On one thread the samples are
+//  added in order, as by the single sample upcount() of the histograms; on
+//  more threads each block of samples is counted separately and the blocks
+//  are added in order, so the result does not depend on the scheduling.
+template <class T, class binner_>
+void bsta_bulk_upcount(binner_ const& binner, unsigned n, T* counts, unsigned size,
+                       unsigned num_threads)
+{
+  unsigned nt = vpl_parallel_for_num_threads(num_threads);
+  // below a few samples per bin the private counts cost more than they save
+  if (nt <= 1 || n < 4*size || n < 4096) {
+    for (unsigned i = 0; i<n; ++i) {
+      int k = binner.bin(i);
+      if (k >= 0)
+        counts[k] += binner.mag(i);
+    }
+    return;
+  }
+  bsta_bulk_upcount_body<T, binner_> body;
+  body.binner = &binner;
+  body.n = n;
+  body.n_blocks = nt;
+  body.size = size;
+  body.sub.resize(nt);
+  vpl_parallel_for(nt, body, num_threads);
+  for (unsigned b = 0; b<nt; ++b)
+    for (unsigned k = 0; k<size; ++k)
+      counts[k] += body.sub[b][k];
+}
+
+#endif // bsta_histogram_bins_h_
@@ -14,6 +14,8 @@
 //   06/01/2010  Brandon A. Mayer. Added clear() function so that a single joint histogram
 //               instance may revert to the default constructor and be reused.
 //   06/01/2010  Brandon A. Mayer. Added mutual_information() function
+//   Oct 2026 - bulk upcount_array() with constant time bin lookup; entropy and
+//              mutual information cached until the next update
 // \endverbatim
 
 #include <vector>
@@ -79,6 +81,18 @@ template <class T> class bsta_joint_histogram : public bsta_joint_histogram_base
 
   void upcount(T a, T mag_a,
                T b, T mag_b);
+
+  //: Add mag to the cell of each of n value pairs (a[i], b[i])
+  //  Same result as upcount(a[i], mag, b[i], 0) for each pair, with the bins
+  //  found in constant time.  With num_threads > 1 (0 = one per processor)
+  //  blocks of pairs are counted on separate threads and added in order.
+  void upcount_array(T const* a, T const* b, unsigned n, T mag = T(1),
+                     unsigned num_threads = 1);
+
+  //: Add mag to the cell of each of n byte value pairs, binning each byte value once
+  void upcount_array(unsigned char const* a, unsigned char const* b, unsigned n,
+                     T mag = T(1), unsigned num_threads = 1);
+
   void parzen(const T sigma);
 
   //: access by bin index
@@ -101,7 +115,7 @@ template <class T> class bsta_joint_histogram : public bsta_joint_histogram_base
   void set_count(unsigned r, unsigned c, T cnt)
     { if (r<static_cast<unsigned>(counts_.rows())&&
           c<static_cast<unsigned>(counts_.cols()))
-      counts_[r][c]=cnt;
+      { counts_[r][c]=cnt; invalidate(); }
     }
 
   //:access by index
@@ -124,6 +138,12 @@ template <class T> class bsta_joint_histogram : public bsta_joint_histogram_base
 
  private:
   void compute_volume() const; // mutable const
+  //: bin of a value of a and b, -1 if outside the range
+  int bin_a(T a) const;
+  int bin_b(T b) const;
+  //: mark the volume and the cached statistics as out of date
+  void invalidate() const
+  { volume_valid_ = false; entropy_valid_ = false; mi_valid_ = false; }
   mutable bool volume_valid_;
   mutable T volume_;
   unsigned int nbins_a_, nbins_b_;
@@ -133,6 +153,9 @@ template <class T> class bsta_joint_histogram : public bsta_joint_histogram_base
   T min_b_, max_b_;
   T min_prob_;
   vbl_array_2d<T> counts_;
+  //: cached statistics, valid until the counts change
+  mutable bool entropy_valid_, mi_valid_;
+  mutable T entropy_, mutual_information_;
 };
 #include <bsta/bsta_joint_histogram_sptr.h>
 #define BSTA_JOINT_HISTOGRAM_INSTANTIATE(T) extern "Please #include <bsta/bsta_joint_histogram.hxx>"
@@ -8,6 +8,7 @@
 
 #include <vcl_compiler.h>
 #include "bsta_gauss.h"
+#include "bsta_histogram_bins.h"
 #include <vnl/vnl_math.h> // for log2e == 1/std::log(2.0)
 template <class T>
 bsta_joint_histogram<T>::bsta_joint_histogram()
@@ -18,7 +19,8 @@ bsta_joint_histogram<T>::bsta_joint_histogram()
     min_a_(0), max_a_(0),
     min_b_(0), max_b_(0),
     min_prob_(0),
-    counts_(1, 1, T(0))
+    counts_(1, 1, T(0)),
+    entropy_valid_(false), mi_valid_(false), entropy_(0), mutual_information_(0)
 {
   bsta_joint_histogram_base::type_ = bsta_joint_histogram_traits<T>::type();
 }
@@ -30,7 +32,8 @@ bsta_joint_histogram<T>::bsta_joint_histogram(const T range,
   : volume_valid_(false), volume_(0), nbins_a_(nbins), nbins_b_(nbins),
     range_a_(range), range_b_(range),delta_a_(0),delta_b_(0), min_a_(0),
     max_a_(range), min_b_(0), max_b_(range), min_prob_(min_prob),
-    counts_(nbins, nbins, T(0))
+    counts_(nbins, nbins, T(0)),
+    entropy_valid_(false), mi_valid_(false), entropy_(0), mutual_information_(0)
 {
   bsta_joint_histogram_base::type_ = bsta_joint_histogram_traits<T>::type();
   if (nbins_a_>0&&nbins_b_>0)
@@ -49,7 +52,8 @@ bsta_joint_histogram<T>::bsta_joint_histogram(const T range_a,
   : volume_valid_(false), volume_(0), nbins_a_(nbins_a), nbins_b_(nbins_b),
     range_a_(range_a), range_b_(range_b),delta_a_(0),delta_b_(0),min_a_(0),
     max_a_(range_a), min_b_(0), max_b_(range_b), min_prob_(min_prob),
-    counts_(nbins_a, nbins_b, T(0))
+    counts_(nbins_a, nbins_b, T(0)),
+    entropy_valid_(false), mi_valid_(false), entropy_(0), mutual_information_(0)
 {
   bsta_joint_histogram_base::type_ = bsta_joint_histogram_traits<T>::type();
   if (nbins_a_>0&&nbins_b_>0)
@@ -67,7 +71,8 @@ bsta_joint_histogram<T>::bsta_joint_histogram(const T min_a, const T max_a,
                                               const T min_prob)
   : volume_valid_(false), volume_(0), nbins_a_(nbins_a), nbins_b_(nbins_b),
     min_a_(min_a), max_a_(max_a), min_b_(min_b), max_b_(max_b),
-    min_prob_(min_prob), counts_(nbins_a, nbins_b, T(0))
+    min_prob_(min_prob), counts_(nbins_a, nbins_b, T(0)),
+    entropy_valid_(false), mi_valid_(false), entropy_(0), mutual_information_(0)
 {
   bsta_joint_histogram_base::type_ = bsta_joint_histogram_traits<T>::type();
   if (nbins_a>0) {
@@ -88,6 +93,22 @@ bsta_joint_histogram<T>::bsta_joint_histogram(const T min_a, const T max_a,
   }
 }
 
+template <class T>
+int bsta_joint_histogram<T>::bin_a(T a) const
+{
+  if (a<min_a_||a>max_a_)
+    return -1;
+  return bsta_offset_bin(T(a-min_a_), delta_a_, bsta_inv_delta(delta_a_), nbins_a_);
+}
+
+template <class T>
+int bsta_joint_histogram<T>::bin_b(T b) const
+{
+  if (b<min_b_||b>max_b_)
+    return -1;
+  return bsta_offset_bin(T(b-min_b_), delta_b_, bsta_inv_delta(delta_b_), nbins_b_);
+}
+
 template <class T>
 void bsta_joint_histogram<T>::upcount(T a, T mag_a,
                                       T b, T mag_b)
@@ -96,23 +117,91 @@ void bsta_joint_histogram<T>::upcount(T a, T mag_a,
     return;
   if (b<min_b_||b>max_b_)
     return;
-  int bin_a =-1, bin_b = -1;
-  for (unsigned int i = 0; i<nbins_a_; i++)
-    if ((i+1)*delta_a_>=(a-min_a_))
-    {
-      bin_a = i;
-      break;
-    }
-  for (unsigned int i = 0; i<nbins_b_; i++)
-    if ((i+1)*delta_b_>=(b-min_b_))
-    {
-      bin_b = i;
-      break;
-    }
-  if (bin_a<0||bin_b<0) return;
-  T v = counts_[bin_a][bin_b]+ mag_a + mag_b;
-  counts_.put(bin_a, bin_b, v);
-  volume_valid_ = false;
+  int ia = bin_a(a), ib = bin_b(b);
+  if (ia<0||ib<0) return;
+  T v = counts_[ia][ib]+ mag_a + mag_b;
+  counts_.put(ia, ib, v);
+  invalidate();
+}
+
+//: Cell of a value pair, at constant cost
+template <class T>
+struct bsta_joint_histogram_value_binner
+{
+  T const* a;
+  T const* b;
+  T mag0, min_a, max_a, min_b, max_b, delta_a, delta_b;
+  double inv_delta_a, inv_delta_b;
+  unsigned nbins_a, nbins_b;
+
+  int bin(unsigned i) const
+  {
+    T va = a[i], vb = b[i];
+    if (va<min_a||va>max_a||vb<min_b||vb>max_b)
+      return -1;
+    int ia = bsta_offset_bin(T(va-min_a), delta_a, inv_delta_a, nbins_a);
+    int ib = bsta_offset_bin(T(vb-min_b), delta_b, inv_delta_b, nbins_b);
+    return ia<0||ib<0 ? -1 : ia*int(nbins_b) + ib;
+  }
+  T mag(unsigned /*i*/) const { return mag0; }
+};
+
+//: Cell of a byte value pair from the bins of each byte value
+template <class T>
+struct bsta_joint_histogram_byte_binner
+{
+  unsigned char const* a;
+  unsigned char const* b;
+  int table_a[256], table_b[256];
+  T mag0;
+  unsigned nbins_b;
+
+  int bin(unsigned i) const
+  {
+    int ia = table_a[a[i]], ib = table_b[b[i]];
+    return ia<0||ib<0 ? -1 : ia*int(nbins_b) + ib;
+  }
+  T mag(unsigned /*i*/) const { return mag0; }
+};
+
+template <class T>
+void bsta_joint_histogram<T>::upcount_array(T const* a, T const* b, unsigned n,
+                                            T mag, unsigned num_threads)
+{
+  if (nbins_a_ == 0 || nbins_b_ == 0)
+    return;
+  bsta_joint_histogram_value_binner<T> binner;
+  binner.a = a;
+  binner.b = b;
+  binner.mag0 = mag;
+  binner.min_a = min_a_; binner.max_a = max_a_;
+  binner.min_b = min_b_; binner.max_b = max_b_;
+  binner.delta_a = delta_a_; binner.delta_b = delta_b_;
+  binner.inv_delta_a = bsta_inv_delta(delta_a_);
+  binner.inv_delta_b = bsta_inv_delta(delta_b_);
+  binner.nbins_a = nbins_a_; binner.nbins_b = nbins_b_;
+  // the cells are stored row by row, cell (ia,ib) at ia*nbins_b + ib
+  bsta_bulk_upcount(binner, n, counts_.begin(), nbins_a_*nbins_b_, num_threads);
+  invalidate();
+}
+
+template <class T>
+void bsta_joint_histogram<T>::upcount_array(unsigned char const* a, unsigned char const* b,
+                                            unsigned n, T mag, unsigned num_threads)
+{
+  if (nbins_a_ == 0 || nbins_b_ == 0)
+    return;
+  bsta_joint_histogram_byte_binner<T> binner;
+  binner.a = a;
+  binner.b = b;
+  binner.mag0 = mag;
+  binner.nbins_b = nbins_b_;
+  for (unsigned v = 0; v<256; ++v) {
+    binner.table_a[v] = this->bin_a(T(v));
+    binner.table_b[v] = this->bin_b(T(v));
+  }
+  bsta_bulk_upcount(binner, n, counts_.begin(), nbins_a_*nbins_b_, num_threads);
+  invalidate();
 }
 
 template <class T>
@@ -151,23 +240,9 @@ T bsta_joint_histogram<T>::p(T a, T b) const
     compute_volume();
   if (volume_ == T(0))
     return 0;
-  unsigned r = 0, c = 0;
-  bool found = false;
-  for (unsigned ia = 0; (ia<nbins_a_)&&!found; ++ia)
-    if ((ia+1)*delta_a_>=(a-min_a_)) {
-      r = ia;
-      found = true;
-    }
-  if (!found)
+  int r = bin_a(a), c = bin_b(b);
+  if (r<0||c<0)
     return 0;
-  found = false;
-  for (unsigned ib = 0; (ib<nbins_b_)&&!found; ++ib)
-    if ((ib+1)*delta_b_>=(b-min_b_)) {
-      c = ib;
-      found = true;
-    }
-  if (!found)
-    return false;
   return counts_[r][c]/volume_;
 }
 
@@ -210,6 +285,8 @@ T bsta_joint_histogram<T>::volume() const
 template <class T>
 T bsta_joint_histogram<T>::entropy() const
 {
+  if (entropy_valid_)
+    return entropy_;
   T ent = 0;
   for (unsigned int i = 0; i<nbins_a_; ++i)
     for (unsigned int j = 0; j<nbins_b_; ++j)
@@ -219,12 +296,16 @@ T bsta_joint_histogram<T>::entropy() const
         ent -= pij*T(std::log(pij));
     }
   ent *= (T)vnl_math::log2e;
+  entropy_ = ent;
+  entropy_valid_ = true;
   return ent;
 }
 
 template <class T>
 T bsta_joint_histogram<T>::mutual_information() const
 {
+  if (mi_valid_)
+    return mutual_information_;
   T mi = T(0);
 
   //calculate marginal distributions
@@ -245,6 +326,8 @@ T bsta_joint_histogram<T>::mutual_information() const
   //convert from natural log to base 2
   mi *= (T)vnl_math::log2e;
 
+  mutual_information_ = mi;
+  mi_valid_ = true;
   return mi;
 }
 
@@ -301,6 +384,7 @@ void bsta_joint_histogram<T>::parzen(const T sigma)
   for (unsigned int row = 0; row<nbins_a_; row++)
     for (unsigned int col = 0; col<nbins_b_; col++)
       counts_[row][col] = (T)out[row][col];
+  invalidate();
 }
 
 template <class T>
@@ -315,7 +399,7 @@ T bsta_joint_histogram<T>::get_count(T a, T b) const
 template <class T>
 void bsta_joint_histogram<T>::clear()
 {
-  volume_valid_ = false;
+  invalidate();
   volume_ = 0;
   counts_.fill(T(0));
 }
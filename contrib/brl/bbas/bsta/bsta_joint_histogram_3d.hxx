@@ -9,6 +9,7 @@
 #include <vcl_compiler.h>
 #include<vcl_cstdlib.h>//for div
 #include "bsta_gauss.h"
+#include "bsta_histogram_bins.h"
 #include <vnl/vnl_math.h> // for log2e == 1/std::log(2.0)
 template <class T>
 bsta_joint_histogram_3d<T>::bsta_joint_histogram_3d()
@@ -20,7 +21,8 @@ bsta_joint_histogram_3d<T>::bsta_joint_histogram_3d()
     min_b_(0), max_b_(0),
     min_c_(0), max_c_(0),
     min_prob_(0),
-    counts_(1, 1, 1, T(0))
+    counts_(1, 1, 1, T(0)),
+    entropy_valid_(false), entropy_(0)
 {
   bsta_joint_histogram_3d_base::type_ = bsta_joint_histogram_3d_traits<T>::type();
 }
@@ -36,7 +38,8 @@ bsta_joint_histogram_3d<T>::bsta_joint_histogram_3d(const T range,
     min_b_(0), max_b_(range),
     min_c_(0), max_c_(range),
     min_prob_(min_prob),
-    counts_(nbins, nbins, nbins, T(0))
+    counts_(nbins, nbins, nbins, T(0)),
+    entropy_valid_(false), entropy_(0)
 {
   bsta_joint_histogram_3d_base::type_ = bsta_joint_histogram_3d_traits<T>::type();
 
@@ -62,7 +65,8 @@ bsta_joint_histogram_3d<T>::bsta_joint_histogram_3d(const T range_a,
     delta_a_(0),delta_b_(0),delta_c_(0),
     min_a_(0), max_a_(range_a), min_b_(0), max_b_(range_b),
     min_c_(0), max_c_(range_c), min_prob_(min_prob),
-    counts_(nbins_a, nbins_b, nbins_c, T(0))
+    counts_(nbins_a, nbins_b, nbins_c, T(0)),
+    entropy_valid_(false), entropy_(0)
 {
   bsta_joint_histogram_3d_base::type_ = bsta_joint_histogram_3d_traits<T>::type();
 
@@ -81,7 +85,8 @@ bsta_joint_histogram_3d<T>::bsta_joint_histogram_3d(const T min, const T max,
  : volume_valid_(false), volume_(0), nbins_a_(nbins), nbins_b_(nbins),
     nbins_c_(nbins), min_a_(min), max_a_(max), min_b_(min), max_b_(max),
     min_c_(min), max_c_(max), min_prob_(min_prob),
-    counts_(nbins, nbins, nbins, T(0))
+    counts_(nbins, nbins, nbins, T(0)),
+    entropy_valid_(false), entropy_(0)
 {
   bsta_joint_histogram_3d_base::type_ = bsta_joint_histogram_3d_traits<T>::type();
 
@@ -116,7 +121,8 @@ bsta_joint_histogram_3d<T>::bsta_joint_histogram_3d(const T min_a, const T max_a
     min_b_(min_b), max_b_(max_b),
     min_c_(min_c), max_c_(max_c),
     min_prob_(min_prob),
-    counts_(nbins_a, nbins_b, nbins_c, T(0))
+    counts_(nbins_a, nbins_b, nbins_c, T(0)),
+    entropy_valid_(false), entropy_(0)
 {
   bsta_joint_histogram_3d_base::type_ = bsta_joint_histogram_3d_traits<T>::type();
 
@@ -151,13 +157,124 @@ void bsta_joint_histogram_3d<T>::upcount(T a, T mag_a,
                                          T b, T mag_b,
                                          T c, T mag_c)
 {
-  int bin_a = -1, bin_b = -1, bin_c = -1;
+  int ia = -1, ib = -1, ic = -1;
 
-  if(!this->bin_at_val(a, b, c, bin_a, bin_b, bin_c))
+  if(!this->bin_at_val(a, b, c, ia, ib, ic))
     return;
 
-  counts_[bin_a][bin_b][bin_c] += mag_a + mag_b + mag_c;
-  volume_valid_ = false;
+  counts_[ia][ib][ic] += mag_a + mag_b + mag_c;
+  invalidate();
+}
+
+template <class T>
+int bsta_joint_histogram_3d<T>::bin_a(T a) const
+{
+  if (a<min_a_||a>max_a_)
+    return -1;
+  return bsta_offset_bin(T(a-min_a_), delta_a_, bsta_inv_delta(delta_a_), nbins_a_);
+}
+
+template <class T>
+int bsta_joint_histogram_3d<T>::bin_b(T b) const
+{
+  if (b<min_b_||b>max_b_)
+    return -1;
+  return bsta_offset_bin(T(b-min_b_), delta_b_, bsta_inv_delta(delta_b_), nbins_b_);
+}
+
+template <class T>
+int bsta_joint_histogram_3d<T>::bin_c(T c) const
+{
+  if (c<min_c_||c>max_c_)
+    return -1;
+  return bsta_offset_bin(T(c-min_c_), delta_c_, bsta_inv_delta(delta_c_), nbins_c_);
+}
+
+//: Cell of a value triple, at constant cost
+template <class T>
+struct bsta_joint_histogram_3d_value_binner
+{
+  T const* v[3];
+  T min[3], max[3], delta[3];
+  double inv_delta[3];
+  unsigned nbins[3];
+  T mag0;
+
+  int bin(unsigned i) const
+  {
+    int cell = 0;
+    for (unsigned d = 0; d<3; ++d) {
+      T x = v[d][i];
+      if (x<min[d]||x>max[d])
+        return -1;
+      int k = bsta_offset_bin(T(x-min[d]), delta[d], inv_delta[d], nbins[d]);
+      if (k<0)
+        return -1;
+      cell = cell*int(nbins[d]) + k;
+    }
+    return cell;
+  }
+  T mag(unsigned /*i*/) const { return mag0; }
+};
+
+//: Cell of a byte value triple from the bins of each byte value
+template <class T>
+struct bsta_joint_histogram_3d_byte_binner
+{
+  unsigned char const* v[3];
+  int table[3][256];
+  unsigned nbins_b, nbins_c;
+  T mag0;
+
+  int bin(unsigned i) const
+  {
+    int ia = table[0][v[0][i]], ib = table[1][v[1][i]], ic = table[2][v[2][i]];
+    if (ia<0||ib<0||ic<0)
+      return -1;
+    return (ia*int(nbins_b) + ib)*int(nbins_c) + ic;
+  }
+  T mag(unsigned /*i*/) const { return mag0; }
+};
+
+template <class T>
+void bsta_joint_histogram_3d<T>::upcount_array(T const* a, T const* b, T const* c, unsigned n,
+                                               T mag, unsigned num_threads)
+{
+  if (nbins_a_ == 0 || nbins_b_ == 0 || nbins_c_ == 0)
+    return;
+  bsta_joint_histogram_3d_value_binner<T> binner;
+  binner.v[0] = a; binner.v[1] = b; binner.v[2] = c;
+  binner.min[0] = min_a_; binner.min[1] = min_b_; binner.min[2] = min_c_;
+  binner.max[0] = max_a_; binner.max[1] = max_b_; binner.max[2] = max_c_;
+  binner.delta[0] = delta_a_; binner.delta[1] = delta_b_; binner.delta[2] = delta_c_;
+  binner.nbins[0] = nbins_a_; binner.nbins[1] = nbins_b_; binner.nbins[2] = nbins_c_;
+  for (unsigned d = 0; d<3; ++d)
+    binner.inv_delta[d] = bsta_inv_delta(binner.delta[d]);
+  binner.mag0 = mag;
+  // the cells are stored in C order, cell (ia,ib,ic) at (ia*nbins_b + ib)*nbins_c + ic
+  bsta_bulk_upcount(binner, n, counts_.data_block(), nbins_a_*nbins_b_*nbins_c_, num_threads);
+  invalidate();
+}
+
+template <class T>
+void bsta_joint_histogram_3d<T>::upcount_array(unsigned char const* a, unsigned char const* b,
+                                               unsigned char const* c, unsigned n,
+                                               T mag, unsigned num_threads)
+{
+  if (nbins_a_ == 0 || nbins_b_ == 0 || nbins_c_ == 0)
+    return;
+  bsta_joint_histogram_3d_byte_binner<T> binner;
+  binner.v[0] = a; binner.v[1] = b; binner.v[2] = c;
+  binner.nbins_b = nbins_b_;
+  binner.nbins_c = nbins_c_;
+  binner.mag0 = mag;
+  for (unsigned x = 0; x<256; ++x) {
+    binner.table[0][x] = bin_a(T(x));
+    binner.table[1][x] = bin_b(T(x));
+    binner.table[2][x] = bin_c(T(x));
+  }
+  bsta_bulk_upcount(binner, n, counts_.data_block(), nbins_a_*nbins_b_*nbins_c_, num_threads);
+  invalidate();
 }
 
 template <class T>
@@ -172,25 +289,9 @@ bool bsta_joint_histogram_3d<T>::bin_at_val(
   if (c<min_c_||c>max_c_)
     return false;
 
-  ia = -1, ib = -1, ic = -1;
-  for (unsigned i = 0; i<nbins_a_; i++)
-    if ((i+1)*delta_a_>=(a-min_a_))
-    {
-      ia = i;
-      break;
-    }
-  for (unsigned i = 0; i<nbins_b_; i++)
-    if ((i+1)*delta_b_>=(b-min_b_))
-    {
-      ib = i;
-      break;
-    }
-  for (unsigned i = 0; i<nbins_c_; i++)
-    if ((i+1)*delta_c_>=(c-min_c_))
-    {
-      ic = i;
-      break;
-    }
+  ia = bin_a(a);
+  ib = bin_b(b);
+  ic = bin_c(c);
   if (ia<0||ib<0||ic<0) return false;
 
   return true;
@@ -255,6 +356,7 @@ void bsta_joint_histogram_3d<T>::parzen(const T sigma)
     for (unsigned int b = 0; b<nbins_b_; b++)
       for (unsigned int c = 0; c<nbins_c_; c++)
         counts_[a][b][c] = (T)out[a][b][c];
+  invalidate();
 }
 
 //: The average and variance bin value for row a using counts to compute probs
@@ -297,6 +399,8 @@ T bsta_joint_histogram_3d<T>::volume() const
 template <class T>
 T bsta_joint_histogram_3d<T>::entropy() const
 {
+  if (entropy_valid_)
+    return entropy_;
   T ent = 0;
   for (unsigned i = 0; i<nbins_a_; ++i)
     for (unsigned j = 0; j<nbins_b_; ++j)
@@ -307,6 +411,8 @@ T bsta_joint_histogram_3d<T>::entropy() const
           ent -= pijk*T(std::log(pijk));
       }
   ent *= (T)vnl_math::log2e;
+  entropy_ = ent;
+  entropy_valid_ = true;
   return ent;
 }
 
@@ -354,7 +460,7 @@ bin_max_count(unsigned& ia, unsigned& ib, unsigned & ic) const
 template <class T>
 void bsta_joint_histogram_3d<T>::clear()
 {
-  volume_valid_ = false;
+  invalidate();
   volume_ = 0;
   counts_.fill(T(0));
 }
@@ -250,6 +250,20 @@ inline std::ostream& operator<< (std::ostream& os,
   return os;
 }
 
+//: Equal if the active components and their weights are equal
+//  The unused entries of the component array are not compared.
+template <class dist_, unsigned s>
+inline bool operator==(bsta_mixture_fixed<dist_,s> const& a,
+                       bsta_mixture_fixed<dist_,s> const& b)
+{
+  if (a.num_components() != b.num_components())
+    return false;
+  for (unsigned i=0; i<a.num_components(); ++i)
+    if (!(a.weight(i) == b.weight(i) && a.distribution(i) == b.distribution(i)))
+      return false;
+  return true;
+}
+
 //: for compatibility with vpdl/vpdt
 template <class dist, unsigned s>
 struct vpdt_is_mixture<bsta_mixture_fixed<dist,s> >
@@ -131,4 +131,12 @@ inline std::ostream& operator<< (std::ostream& os,
      << "von_mises:kappa(" << vm.kappa() << ")\n";
   return os;
 }
+
+//: Equal if the means and the concentrations are equal
+template <class T , unsigned n>
+inline bool operator==(bsta_von_mises<T, n> const& a,
+                       bsta_von_mises<T, n> const& b)
+{
+  return a.mean() == b.mean() && a.kappa() == b.kappa();
+}
 #endif // bsta_von_mises_h_
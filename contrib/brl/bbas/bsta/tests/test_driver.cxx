@@ -8,6 +8,7 @@ DECLARE( test_weibull );
 DECLARE( test_von_mises );
 DECLARE( test_mixture );
 DECLARE( test_bsta_histogram );
+DECLARE( test_histogram_bulk );
 DECLARE( test_k_medoid );
 DECLARE( test_k_means );
 DECLARE( test_otsu_threshold );
@@ -26,6 +27,7 @@ register_tests()
   REGISTER( test_weibull );
   REGISTER( test_mixture );
   REGISTER( test_bsta_histogram );
+  REGISTER( test_histogram_bulk );
   REGISTER( test_k_medoid );
   REGISTER( test_k_means );
   REGISTER( test_otsu_threshold );
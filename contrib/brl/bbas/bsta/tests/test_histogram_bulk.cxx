@@ -0,0 +1,216 @@
+#include <iostream>
+#include <vector>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <bsta/bsta_histogram.h>
+#include <bsta/bsta_joint_histogram.h>
+#include <bsta/bsta_joint_histogram_3d.h>
+#include <bsta/bsta_histogram_bins.h>
+#include <vnl/vnl_random.h>
+
+// the bin searches the histograms used before the constant time lookup
+template <class T>
+static int scan_value_bin(T x, T min, T delta, unsigned nbins)
+{
+  for (unsigned i = 0; i<nbins; ++i)
+    if (T((i+1)*delta) + min >= x)
+      return i;
+  return -1;
+}
+
+template <class T>
+static int scan_offset_bin(T offset, T delta, unsigned nbins)
+{
+  for (unsigned i = 0; i<nbins; ++i)
+    if ((i+1)*delta >= offset)
+      return i;
+  return -1;
+}
+
+// values at, just below and just above each bin boundary, and random ones
+template <class T>
+static std::vector<T> test_values(vnl_random& rng, T min, T max, unsigned nbins)
+{
+  std::vector<T> v;
+  T delta = (max-min)/nbins;
+  for (unsigned i = 0; i<=nbins; ++i) {
+    T b = T(i*delta) + min;
+    v.push_back(b);
+    v.push_back(b - delta*T(1e-6));
+    v.push_back(b + delta*T(1e-6));
+  }
+  v.push_back(min);
+  v.push_back(max);
+  for (unsigned i = 0; i<2000; ++i)
+    v.push_back(T(rng.drand64(min, max)));
+  return v;
+}
+
+template <class T>
+static bool check_bins(vnl_random& rng, T min, T max, unsigned nbins)
+{
+  std::vector<T> v = test_values(rng, min, max, nbins);
+  T delta = (max-min)/nbins;
+  double inv = bsta_inv_delta(delta);
+  for (unsigned i = 0; i<v.size(); ++i) {
+    if (v[i]<min || v[i]>max)
+      continue;
+    if (bsta_value_bin(v[i], min, delta, inv, nbins) != scan_value_bin(v[i], min, delta, nbins))
+      return false;
+    T off = v[i]-min;
+    if (bsta_offset_bin(off, delta, inv, nbins) != scan_offset_bin(off, delta, nbins))
+      return false;
+  }
+  return true;
+}
+
+static void test_bin_lookup(vnl_random& rng)
+{
+  bool ok = check_bins<float>(rng, 0.0f, 1.0f, 7) && check_bins<float>(rng, -0.3f, 2.9f, 13) &&
+            check_bins<double>(rng, 0.0, 255.0, 64) && check_bins<double>(rng, -1.1, 0.7, 100) &&
+            check_bins<float>(rng, 0.0f, 255.0f, 256) && check_bins<float>(rng, 0.0f, 1.0f, 1);
+  TEST("constant time bins equal scanned bins", ok, true);
+  TEST("no bins", bsta_value_bin(0.5f, 0.0f, 0.0f, 0.0, 0), -1);
+}
+
+static void test_histogram_1d(vnl_random& rng)
+{
+  const unsigned n = 20000;
+  std::vector<float> v(n), m(n);
+  std::vector<unsigned char> bytes(n);
+  for (unsigned i = 0; i<n; ++i) {
+    v[i] = float(rng.drand64(-0.2, 1.2));
+    m[i] = float(rng.drand64(0.0, 2.0));
+    bytes[i] = static_cast<unsigned char>(rng.lrand32(0, 255));
+  }
+  bsta_histogram<float> h0(0.0f, 1.0f, 37), h1(0.0f, 1.0f, 37), h3(0.0f, 1.0f, 37);
+  for (unsigned i = 0; i<n; ++i)
+    h0.upcount(v[i], 1.0f);
+  h1.upcount_array(&v[0], n);
+  h3.upcount_array(&v[0], n, 1.0f, 3);
+  TEST("bulk upcount", h1.count_array() == h0.count_array(), true);
+  TEST("bulk upcount on 3 threads", h3.count_array() == h0.count_array(), true);
+
+  bsta_histogram<float> w0(0.0f, 1.0f, 37), w3(0.0f, 1.0f, 37);
+  for (unsigned i = 0; i<n; ++i)
+    w0.upcount(v[i], m[i]);
+  w3.upcount_array(&v[0], &m[0], n, 3);
+  double err = 0.0;
+  for (unsigned b = 0; b<37; ++b)
+    err = std::max(err, double(std::fabs(w0.counts(b) - w3.counts(b))/w0.counts(b)));
+  TEST_NEAR("weighted bulk upcount on 3 threads", err, 0.0, 1e-5);
+
+  // byte values agree with the same values as floats
+  std::vector<float> fbytes(bytes.begin(), bytes.end());
+  bsta_histogram<float> b0(10.0f, 200.0f, 19), b1(10.0f, 200.0f, 19), b3(10.0f, 200.0f, 19);
+  b0.upcount_array(&fbytes[0], n);
+  b1.upcount_array(&bytes[0], n);
+  b3.upcount_array(&bytes[0], n, 1.0f, 3);
+  TEST("byte bulk upcount", b1.count_array() == b0.count_array() && b3.count_array() == b0.count_array(), true);
+  TEST("bin_at_val", h0.bin_at_val(0.0f) == 0 && h0.bin_at_val(1.0f) == 36 && h0.bin_at_val(1.5f) == -1, true);
+}
+
+static void test_cached_queries(vnl_random& rng)
+{
+  bsta_histogram<double> h(0.0, 10.0, 20);
+  for (unsigned i = 0; i<500; ++i)
+    h.upcount(rng.drand64(0.0, 10.0), 1.0);
+  double e0 = h.entropy(), r0 = h.renyi_entropy();
+  TEST("cached entropy", h.entropy() == e0 && h.renyi_entropy() == r0, true);
+
+  // percentiles from the cumulative counts, against the running sum
+  bool ok = true;
+  for (double f = 0.0; f<=1.0; f += 0.05) {
+    double sum = 0.0, expected = 0.0;
+    for (unsigned b = 0; b<20; ++b) {
+      sum += h.counts(b);
+      if (sum >= f*h.area()) { expected = (b+1)*h.delta()+h.min(); break; }
+    }
+    ok = ok && h.value_with_area_below(f) == expected;
+  }
+  TEST("value_with_area_below", ok, true);
+
+  // every change of the counts is seen by the cached queries
+  h.set_count(3, 200.0);
+  bsta_histogram<double> fresh(0.0, 10.0, 20);
+  for (unsigned b = 0; b<20; ++b)
+    fresh.set_count(b, h.counts(b));
+  TEST("entropy after set_count", h.entropy() != e0 && h.entropy() == fresh.entropy(), true);
+  TEST("percentile after set_count", h.value_with_area_below(0.5) == fresh.value_with_area_below(0.5), true);
+  e0 = h.entropy();
+  double area0 = h.area();
+  h.parzen(1.0);
+  TEST("entropy after parzen", h.entropy() != e0 && h.area() != area0, true);
+  double v[3] = { 1.0, 2.0, 3.0 };
+  e0 = h.entropy();
+  h.upcount_array(v, 3, 50.0);
+  TEST("entropy after bulk upcount", h.entropy() != e0, true);
+  h.clear();
+  TEST("entropy after clear", h.entropy(), 0.0);
+
+  // negative counts fall back to the linear search of the running sum
+  bsta_histogram<double> neg(0.0, 4.0, 4);
+  neg.set_count(0, 3.0); neg.set_count(1, -2.0); neg.set_count(2, 1.0); neg.set_count(3, 2.0);
+  TEST("percentile with negative counts", neg.value_with_area_below(0.25), 1.0);
+}
+
+static void test_joint(vnl_random& rng)
+{
+  const unsigned n = 30000;
+  std::vector<float> a(n), b(n), c(n);
+  std::vector<unsigned char> ba(n), bb(n), bc(n);
+  for (unsigned i = 0; i<n; ++i) {
+    a[i] = float(rng.drand64(-1.0, 1.1));
+    b[i] = a[i]*0.5f + float(rng.drand64(0.0, 0.5));
+    c[i] = float(rng.drand64(0.0, 1.0));
+    ba[i] = static_cast<unsigned char>(rng.lrand32(0, 255));
+    bb[i] = static_cast<unsigned char>((ba[i] + rng.lrand32(0, 40)) & 255);
+    bc[i] = static_cast<unsigned char>(rng.lrand32(0, 255));
+  }
+  bsta_joint_histogram<float> j0(-1.0f, 1.0f, 17, -0.5f, 1.0f, 23), j1 = j0, j3 = j0;
+  for (unsigned i = 0; i<n; ++i)
+    j0.upcount(a[i], 1.0f, b[i], 0.0f);
+  j1.upcount_array(&a[0], &b[0], n);
+  j3.upcount_array(&a[0], &b[0], n, 1.0f, 3);
+  TEST("joint bulk upcount", j1.counts() == j0.counts() && j3.counts() == j0.counts(), true);
+  float mi = j0.mutual_information(), ent = j0.entropy();
+  TEST("joint cached queries", j0.mutual_information() == mi && j0.entropy() == ent && mi > 0.0f, true);
+  TEST("joint p by value", j0.p(0.2f, 0.3f) == j0.p(10u, 12u), true);
+
+  bsta_joint_histogram<float> jb(0.0f, 255.0f, 32, 0.0f, 255.0f, 32), jf = jb;
+  std::vector<float> fa(ba.begin(), ba.end()), fb(bb.begin(), bb.end());
+  jf.upcount_array(&fa[0], &fb[0], n);
+  jb.upcount_array(&ba[0], &bb[0], n, 1.0f, 2);
+  TEST("joint byte bulk upcount", jb.counts() == jf.counts(), true);
+  mi = jb.mutual_information();
+  jb.set_count(0, 0, 1000.0f);
+  TEST("mutual information after set_count", jb.mutual_information() != mi, true);
+
+  bsta_joint_histogram_3d<float> k0(-1.0f, 1.0f, 5, -0.5f, 1.0f, 7, 0.0f, 1.0f, 4), k1 = k0, k3 = k0;
+  for (unsigned i = 0; i<n; ++i)
+    k0.upcount(a[i], 1.0f, b[i], 0.0f, c[i], 0.0f);
+  k1.upcount_array(&a[0], &b[0], &c[0], n);
+  k3.upcount_array(&a[0], &b[0], &c[0], n, 1.0f, 3);
+  TEST("3d bulk upcount", k1.counts() == k0.counts() && k3.counts() == k0.counts(), true);
+  ent = k0.entropy();
+  k0.set_count(0, 0, 0, 5000.0f);
+  TEST("3d entropy after set_count", k0.entropy() != ent, true);
+
+  bsta_joint_histogram_3d<float> kb(0.0f, 255.0f, 8), kf = kb;
+  std::vector<float> fc(bc.begin(), bc.end());
+  kf.upcount_array(&fa[0], &fb[0], &fc[0], n);
+  kb.upcount_array(&ba[0], &bb[0], &bc[0], n, 1.0f, 3);
+  TEST("3d byte bulk upcount", kb.counts() == kf.counts(), true);
+}
+
+static void test_histogram_bulk()
+{
+  vnl_random rng(4242);
+  test_bin_lookup(rng);
+  test_histogram_1d(rng);
+  test_cached_queries(rng);
+  test_joint(rng);
+}
+
+TESTMAIN(test_histogram_bulk);
@@ -31,6 +31,7 @@
 #include <bsta/bsta_gaussian_sphere.h>
 #include <bsta/bsta_histogram.h>
 #include <bsta/bsta_histogram_base.h>
+#include <bsta/bsta_histogram_bins.h>
 #include <bsta/bsta_histogram_sptr.h>
 #include <bsta/bsta_int_histogram_1d.h>
 #include <bsta/bsta_int_histogram_2d.h>
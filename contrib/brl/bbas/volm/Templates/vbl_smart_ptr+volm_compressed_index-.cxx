@@ -0,0 +1,4 @@
+#include <volm/volm_compressed_index.h>
+#include <vbl/vbl_smart_ptr.hxx>
+
+VBL_SMART_PTR_INSTANTIATE(volm_compressed_index);
@@ -0,0 +1,4 @@
+#include <volm/volm_geo_index2_flat.h>
+#include <vbl/vbl_smart_ptr.hxx>
+
+VBL_SMART_PTR_INSTANTIATE(volm_geo_index2_flat);
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <testlib/testlib_test.h>
+#include <volm/volm_compressed_index.h>
+#include <volm/volm_buffered_index.h>
+#include <vpl/vpl.h>
+#include <vcl_compiler.h>
+
+// indices of neighbouring hypotheses differ in a few layers only
+static void make_layers(unsigned n, unsigned layer_size, std::vector<unsigned char>& values)
+{
+  values.resize(n*layer_size);
+  unsigned seed = 12345;
+  for (unsigned j = 0; j < layer_size; ++j) {
+    seed = seed*1103515245u + 12345u;
+    values[j] = (unsigned char)((seed >> 16) % 254);
+  }
+  for (unsigned i = 1; i < n; ++i)
+    for (unsigned j = 0; j < layer_size; ++j) {
+      seed = seed*1103515245u + 12345u;
+      unsigned char prev = values[(i-1)*layer_size + j];
+      values[i*layer_size + j] = ((seed >> 16) % 16 == 0) ? (unsigned char)((seed >> 8) % 254) : prev;
+    }
+}
+
+static bool same(unsigned char const* a, unsigned char const* b, std::size_t n)
+{
+  for (std::size_t i = 0; i < n; ++i)
+    if (a[i] != b[i])
+      return false;
+  return true;
+}
+
+static void test_compressed_index()
+{
+  unsigned layer_size = 500, n = 300, block_size = 32;
+  std::vector<unsigned char> values;
+  make_layers(n, layer_size, values);
+
+  // single blocks, including an incompressible one
+  std::vector<unsigned char> enc, dec(layer_size*4), scratch;
+  volm_compressed_index::encode_block(&values[0], 4, layer_size, enc);
+  TEST("decode block", volm_compressed_index::decode_block(&enc[0], enc.size(), 4, layer_size, &dec[0], scratch)
+                       && same(&dec[0], &values[0], 4*layer_size), true);
+  TEST("truncated block fails", volm_compressed_index::decode_block(&enc[0], enc.size()/2, 4, layer_size, &dec[0], scratch), false);
+  std::vector<unsigned char> noise(layer_size*4);
+  unsigned seed = 7;
+  for (unsigned i = 0; i < noise.size(); ++i) { seed = seed*1664525u + 1013904223u; noise[i] = (unsigned char)(seed >> 24); }
+  enc.clear();
+  volm_compressed_index::encode_block(&noise[0], 4, layer_size, enc);
+  TEST("raw block no larger than the data plus its header", enc.size() <= noise.size() + 8, true);
+  TEST("decode raw block", volm_compressed_index::decode_block(&enc[0], enc.size(), 4, layer_size, &dec[0], scratch)
+                           && same(&dec[0], &noise[0], noise.size()), true);
+
+  // write a file
+  std::string name = "test_compressed_index.vci";
+  {
+    volm_compressed_index ind(layer_size, block_size);
+    TEST("initialize write", ind.initialize_write(name), true);
+    bool ok = true;
+    for (unsigned i = 0; i < n; ++i)
+      ok = ok && ind.add_to_index(&values[i*layer_size]);
+    TEST("add to index", ok, true);
+    TEST("finalize", ind.finalize(), true);
+    std::cout << "raw size: " << values.size() << " compressed size: " << ind.file_size() << std::endl;
+    TEST("compressed file is smaller", ind.file_size() < values.size()/2, true);
+  }
+
+  // read it back
+  volm_compressed_index ind(1, 1);
+  TEST("initialize read", ind.initialize_read(name), true);
+  TEST("layer size from file", ind.layer_size(), layer_size);
+  TEST("block size from file", ind.block_size(), block_size);
+  TEST("number of hypotheses", ind.size(), (vxl_uint_64)n);
+  std::cout << "memory mapped: " << ind.mapped() << std::endl;
+
+  std::vector<unsigned char> v;
+  bool ok = true;
+  unsigned ids[] = { 0, 299, 31, 32, 150, 5, 287, 64, 63 };
+  for (unsigned i = 0; i < sizeof(ids)/sizeof(unsigned); ++i)
+    ok = ok && ind.get(ids[i], v) && same(&v[0], &values[ids[i]*layer_size], layer_size);
+  TEST("random access", ok, true);
+  TEST("out of range", ind.get(n, v), false);
+
+  ok = ind.get(40, v);
+  for (unsigned i = 41; i < n; ++i)
+    ok = ok && ind.get_next(v) && same(&v[0], &values[i*layer_size], layer_size);
+  TEST("get_next", ok, true);
+  TEST("get_next past the end", ind.get_next(v), false);
+
+  std::vector<unsigned char> range(n*layer_size);
+  for (unsigned t = 1; t <= 4; ++t) {
+    std::fill(range.begin(), range.end(), 0);
+    TEST("get_range", ind.get_range(10, 250, &range[0], t) && same(&range[0], &values[10*layer_size], 250*layer_size), true);
+  }
+  TEST("whole file", ind.get_range(0, n, &range[0]) && same(&range[0], &values[0], values.size()), true);
+  TEST("range out of bounds", ind.get_range(200, 101, &range[0]), false);
+  ind.finalize();
+
+  // convert a buffered index
+  std::string buf_name = "test_compressed_index.bin", conv_name = "test_compressed_index_conv.vci";
+  {
+    volm_buffered_index bind(layer_size, 0.1f);
+    bind.initialize_write(buf_name);
+    for (unsigned i = 0; i < n; ++i)
+      bind.add_to_index(&values[i*layer_size]);
+    bind.finalize();
+  }
+  TEST("convert", volm_compressed_index::convert(buf_name, conv_name, layer_size, 16), true);
+  volm_compressed_index conv(1);
+  TEST("read converted", conv.initialize_read(conv_name) && conv.size() == n && conv.block_size() == 16, true);
+  TEST("converted contents", conv.get_range(0, n, &range[0], 2) && same(&range[0], &values[0], values.size()), true);
+  conv.finalize();
+
+  // not an index
+  std::string bad_name = "test_compressed_index_bad.vci";
+  {
+    std::ofstream ofs(bad_name.c_str(), std::ios::binary);
+    ofs << "this is not a compressed index file";
+  }
+  volm_compressed_index bad(1);
+  TEST("reject bad file", bad.initialize_read(bad_name), false);
+  TEST("reject missing file", bad.initialize_read("no_such_file.vci"), false);
+
+  vpl_unlink(name.c_str());
+  vpl_unlink(buf_name.c_str());
+  vpl_unlink(conv_name.c_str());
+  vpl_unlink(bad_name.c_str());
+}
+
+TESTMAIN(test_compressed_index);
@@ -16,11 +16,14 @@ DECLARE( test_geo_index2 );
 DECLARE( test_osm_parser );
 DECLARE( test_category_io );
 DECLARE( test_osm_object );
+DECLARE( test_osm_stream_parser );
 DECLARE( test_candidate_region_parser );
 DECLARE( test_utils );
 DECLARE( test_overlapping_resources );
 DECLARE( test_intersecting_resources );
 DECLARE( test_compute_intersection );
+DECLARE( test_compressed_index );
+DECLARE( test_geo_index2_flat );
 
 void
 register_tests()
@@ -40,11 +43,14 @@ register_tests()
   REGISTER( test_osm_parser );
   REGISTER( test_category_io );
   REGISTER( test_osm_object );
+  REGISTER( test_osm_stream_parser );
   REGISTER( test_candidate_region_parser );
   REGISTER( test_utils );
   REGISTER( test_overlapping_resources );
   REGISTER( test_intersecting_resources );
   REGISTER( test_compute_intersection );
+  REGISTER( test_compressed_index );
+  REGISTER( test_geo_index2_flat );
 }
 
 DEFINE_MAIN;
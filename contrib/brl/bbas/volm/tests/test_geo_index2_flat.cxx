@@ -0,0 +1,174 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <testlib/testlib_test.h>
+#include <volm/volm_geo_index2.h>
+#include <volm/volm_geo_index2_flat.h>
+#include <vgl/vgl_point_2d.h>
+#include <vgl/vgl_polygon.h>
+#include <vpl/vpl.h>
+#include <vcl_compiler.h>
+
+static double next_random(unsigned& seed)
+{
+  seed = seed*1103515245u + 12345u;
+  return double((seed >> 8) & 0xffff) / 65536.0;
+}
+
+static vgl_polygon<double> square(double x, double y, double s)
+{
+  vgl_polygon<double> poly(1);
+  poly[0].push_back(vgl_point_2d<double>(x, y));
+  poly[0].push_back(vgl_point_2d<double>(x+s, y));
+  poly[0].push_back(vgl_point_2d<double>(x+s, y+s));
+  poly[0].push_back(vgl_point_2d<double>(x, y+s));
+  return poly;
+}
+
+static void test_geo_index2_flat()
+{
+  // a tree over the unit square, pruned to a triangle
+  vgl_box_2d<double> bbox(0.0, 1.0, 0.0, 1.0);
+  vgl_polygon<double> triangle(1);
+  triangle[0].push_back(vgl_point_2d<double>(0.05, 0.05));
+  triangle[0].push_back(vgl_point_2d<double>(0.95, 0.1));
+  triangle[0].push_back(vgl_point_2d<double>(0.3, 0.9));
+  volm_geo_index2_node_sptr root = volm_geo_index2::construct_tree<std::vector<unsigned> >(bbox, 0.1, triangle);
+  std::vector<volm_geo_index2_node_sptr> tree_leaves;
+  volm_geo_index2::get_leaves(root, tree_leaves);
+  for (unsigned i = 0; i < tree_leaves.size(); ++i) {
+    volm_geo_index2_node<std::vector<unsigned> >* leaf =
+      dynamic_cast<volm_geo_index2_node<std::vector<unsigned> >*>(tree_leaves[i].ptr());
+    for (unsigned k = 0; k < i % 5; ++k)
+      leaf->contents_.push_back(100*i + k);
+  }
+
+  volm_geo_index2_flat flat;
+  std::vector<volm_geo_index2_node_sptr> leaves;
+  flat.build(root, leaves);
+  TEST("number of leaves", flat.n_leaves(), (unsigned)tree_leaves.size());
+  TEST("leaf nodes returned", leaves.size(), tree_leaves.size());
+  TEST("set payload", flat.set_payload(leaves), true);
+  bool ok = true;
+  for (unsigned i = 0; i < leaves.size(); ++i) {
+    volm_geo_index2_node<std::vector<unsigned> >* leaf =
+      dynamic_cast<volm_geo_index2_node<std::vector<unsigned> >*>(leaves[i].ptr());
+    ok = ok && flat.payload_size(i) == leaf->contents_.size() &&
+         std::equal(leaf->contents_.begin(), leaf->contents_.end(), flat.payload(i)) &&
+         flat.leaf_node(i).extent() == leaf->extent_;
+  }
+  TEST("payload and extents", ok, true);
+
+  // Morton order: the leaves of every node are contiguous and its children are ordered by quadrant
+  ok = true;
+  for (unsigned i = 0; i < flat.n_nodes(); ++i) {
+    volm_geo_index2_flat_node const& n = flat.node(i);
+    for (unsigned c = 1; n.first_child >= 0 && c < n.n_children; ++c) {
+      volm_geo_index2_flat_node const& a = flat.node(n.first_child + c - 1);
+      volm_geo_index2_flat_node const& b = flat.node(n.first_child + c);
+      ok = ok && (a.min_y < b.min_y || (a.min_y == b.min_y && a.min_x < b.min_x)) && b.parent == (int)i;
+    }
+  }
+  TEST("children in Morton order", ok, true);
+
+  // points against the pointer tree
+  unsigned seed = 1;
+  std::vector<vgl_point_2d<double> > points;
+  for (unsigned i = 0; i < 5000; ++i)
+    points.push_back(vgl_point_2d<double>(1.2*next_random(seed) - 0.1, 1.2*next_random(seed) - 0.1));
+  ok = true;
+  unsigned n_inside = 0;
+  for (unsigned i = 0; i < points.size(); ++i) {
+    volm_geo_index2_node_sptr leaf;
+    volm_geo_index2::get_leaf(root, leaf, points[i]);
+    int id = flat.get_leaf(points[i]);
+    if (id >= 0)
+      ++n_inside;
+    ok = ok && (leaf ? (id >= 0 && leaves[id] == leaf) : id < 0);
+  }
+  std::cout << n_inside << " of " << points.size() << " points in a leaf" << std::endl;
+  TEST("point queries match the tree", ok && n_inside > 0, true);
+
+  std::vector<int> ids, ids_1;
+  flat.get_leaf(points, ids_1, 1);
+  for (unsigned t = 2; t <= 4; t += 2) {
+    flat.get_leaf(points, ids, t);
+    TEST("batch point query", ids == ids_1, true);
+  }
+  ok = true;
+  for (unsigned i = 0; i < points.size(); ++i)
+    ok = ok && ids_1[i] == flat.get_leaf(points[i]);
+  TEST("batch matches single queries", ok, true);
+
+  // polygons against the pointer tree
+  std::vector<vgl_polygon<double> > polys;
+  for (unsigned i = 0; i < 40; ++i)
+    polys.push_back(square(next_random(seed), next_random(seed), 0.3*next_random(seed)));
+  ok = true;
+  for (unsigned i = 0; i < polys.size(); ++i) {
+    std::vector<volm_geo_index2_node_sptr> tree_result;
+    volm_geo_index2::get_leaves(root, tree_result, polys[i]);
+    std::vector<unsigned> flat_ids;
+    flat.get_leaves(polys[i], flat_ids);
+    std::vector<volm_geo_index2_node_base*> a, b;
+    for (unsigned k = 0; k < tree_result.size(); ++k)
+      a.push_back(tree_result[k].ptr());
+    for (unsigned k = 0; k < flat_ids.size(); ++k)
+      b.push_back(leaves[flat_ids[k]].ptr());
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    ok = ok && a == b;
+    for (unsigned k = 1; k < flat_ids.size(); ++k)
+      ok = ok && flat_ids[k-1] < flat_ids[k];
+  }
+  TEST("polygon queries match the tree", ok, true);
+  std::vector<std::vector<unsigned> > poly_ids, poly_ids_1;
+  flat.get_leaves(polys, poly_ids_1, 1);
+  flat.get_leaves(polys, poly_ids, 3);
+  TEST("batch polygon query", poly_ids == poly_ids_1, true);
+
+  // binary file
+  std::string name = "test_geo_index2_flat.bin";
+  TEST("write", flat.write(name), true);
+  volm_geo_index2_flat_sptr read_flat = new volm_geo_index2_flat();
+  TEST("read", read_flat->read(name), true);
+  std::cout << "memory mapped: " << read_flat->mapped() << std::endl;
+  TEST("read sizes", read_flat->n_nodes() == flat.n_nodes() && read_flat->n_leaves() == flat.n_leaves(), true);
+  read_flat->get_leaf(points, ids);
+  TEST("read point queries", ids == ids_1, true);
+  read_flat->get_leaves(polys, poly_ids);
+  TEST("read polygon queries", poly_ids == poly_ids_1, true);
+  ok = true;
+  for (unsigned i = 0; i < flat.n_leaves(); ++i)
+    ok = ok && read_flat->payload_size(i) == flat.payload_size(i) &&
+         std::equal(flat.payload(i), flat.payload(i) + flat.payload_size(i), read_flat->payload(i));
+  TEST("read payload", ok, true);
+  read_flat = VXL_NULLPTR;
+
+  // a truncated file and a file that is not an index
+  std::string bad_name = "test_geo_index2_flat_bad.bin";
+  {
+    std::ifstream ifs(name.c_str(), std::ios::binary);
+    std::vector<char> data(200);
+    ifs.read(&data[0], 200);
+    std::ofstream ofs(bad_name.c_str(), std::ios::binary);
+    ofs.write(&data[0], 200);
+  }
+  volm_geo_index2_flat bad;
+  TEST("reject truncated file", bad.read(bad_name), false);
+  {
+    std::ofstream ofs(bad_name.c_str(), std::ios::binary);
+    ofs << "not a geo index";
+  }
+  TEST("reject bad file", bad.read(bad_name), false);
+  TEST("empty after a failed read", bad.n_nodes() == 0 && bad.get_leaf(points[0]) < 0, true);
+
+  // an empty tree
+  volm_geo_index2_flat empty((volm_geo_index2_node_sptr()));
+  TEST("empty tree", empty.n_nodes() == 0 && empty.get_leaf(points[0]) < 0, true);
+
+  vpl_unlink(name.c_str());
+  vpl_unlink(bad_name.c_str());
+}
+
+TESTMAIN(test_geo_index2_flat);
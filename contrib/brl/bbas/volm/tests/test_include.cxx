@@ -7,10 +7,14 @@
 //
 #include <volm/volm_camera_space.h>
 #include <volm/volm_char_codes.h>
+#include <volm/volm_compressed_index.h>
 #include <volm/volm_geo_index.h>
 #include <volm/volm_geo_index2.h>
+#include <volm/volm_geo_index2_flat.h>
 #include <volm/volm_io.h>
 #include <volm/volm_loc_hyp.h>
+#include <volm/volm_osm_stream_parser.h>
+#include <volm/volm_osm_tile_rasterizer.h>
 #include <volm/volm_query.h>
 #include <volm/volm_spherical_container.h>
 #include <volm/volm_spherical_index_query_matcher.h>
@@ -0,0 +1,351 @@
+#include <iostream>
+#include <fstream>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <volm/volm_osm_parser.h>
+#include <volm/volm_osm_stream_parser.h>
+#include <volm/volm_osm_tile_rasterizer.h>
+#include <volm/volm_osm_objects.h>
+#include <volm/volm_category_io.h>
+#include <volm/volm_io_tools.h>
+#include <volm/volm_tile.h>
+#include <vcl_where_root_dir.h>
+#include <vpl/vpl.h>
+#include <vgl/vgl_polygon_scan_iterator.h>
+
+typedef std::vector<std::vector<std::pair<std::string, std::string> > > keys_t;
+
+static bool same_polygons(std::vector<vgl_polygon<double> > const& a, std::vector<vgl_polygon<double> > const& b)
+{
+  if (a.size() != b.size())
+    return false;
+  for (unsigned i = 0; i < a.size(); ++i) {
+    if (a[i].num_sheets() != b[i].num_sheets())
+      return false;
+    for (unsigned s = 0; s < a[i].num_sheets(); ++s)
+      if (a[i][s] != b[i][s])
+        return false;
+  }
+  return true;
+}
+
+//: compare the single pass parse of \p file with the parse functions of volm_osm_parser
+static void compare_with_osm_parser(std::string const& file, std::string const& name)
+{
+  std::vector<vgl_point_2d<double> > pts, pts_ref;
+  std::vector<std::vector<vgl_point_2d<double> > > lines, lines_ref;
+  std::vector<vgl_polygon<double> > polys, polys_ref;
+  keys_t pt_keys, line_keys, poly_keys, pt_keys_ref, line_keys_ref, poly_keys_ref;
+  bool good = volm_osm_stream_parser::parse_objects(file, pts, pt_keys, lines, line_keys, polys, poly_keys);
+  volm_osm_parser::parse_points(pts_ref, pt_keys_ref, file);
+  volm_osm_parser::parse_lines(lines_ref, line_keys_ref, file);
+  volm_osm_parser::parse_polygons(polys_ref, poly_keys_ref, file);
+  std::cout << name << ": " << pts.size() << " points, " << lines.size() << " lines, " << polys.size() << " polygons\n";
+  TEST(("parse " + name).c_str(), good, true);
+  TEST(("points of " + name).c_str(), pts == pts_ref && pt_keys == pt_keys_ref, true);
+  TEST(("lines of " + name).c_str(), lines == lines_ref && line_keys == line_keys_ref, true);
+  TEST(("polygons of " + name).c_str(), same_polygons(polys, polys_ref) && poly_keys == poly_keys_ref, true);
+}
+
+//: keeps a copy of all the batches of a parse
+class test_osm_collector : public volm_osm_stream_handler
+{
+ public:
+  test_osm_collector() : n_batches(0), n_ends(0) {}
+  virtual void add_objects(volm_osm_stream_objects& batch, volm_osm_string_table const& strings)
+  {
+    ++n_batches;
+    for (unsigned o = 0; o < batch.size(); ++o) {
+      objs.begin_object(batch.type(o), batch.osm_id(o));
+      for (unsigned s = batch.sheet_begin(o); s < batch.sheet_end(o); ++s) {
+        objs.new_sheet();
+        for (unsigned c = batch.coord_begin(s); c < batch.coord_end(s); ++c)
+          objs.push_back(batch.coords()[c]);
+      }
+      std::vector<std::pair<std::string, std::string> > tags = batch.tags(o, strings);
+      for (unsigned t = 0; t < tags.size(); ++t)
+        objs.add_tag(names.intern(tags[t].first), names.intern(tags[t].second));
+      objs.end_object();
+    }
+  }
+  virtual void end_of_stream() { ++n_ends; }
+
+  volm_osm_stream_objects objs;
+  volm_osm_string_table names;
+  unsigned n_batches;
+  unsigned n_ends;
+};
+
+static void write_test_file(std::string const& file)
+{
+  std::ofstream ofs(file.c_str());
+  ofs << "<?xml version='1.0' encoding='UTF-8'?>\n"
+      << "<osm version=\"0.6\">\n"
+      << " <bounds minlat=\"10.0\" minlon=\"20.0\" maxlat=\"11.0\" maxlon=\"21.0\"/>\n"
+      // nodes out of order, and an id above 2^32
+      << " <node id=\"31\" lat=\"10.1\" lon=\"20.9\"/>\n"
+      << " <node id=\"30\" lat=\"10.1\" lon=\"20.6\"/>\n"
+      << " <node id=\"12\" lat=\"10.4\" lon=\"20.4\"/>\n"
+      << " <node id=\"10\" lat=\"10.3\" lon=\"20.3\"/>\n"
+      << " <node id=\"11\" lat=\"10.3\" lon=\"20.4\"/>\n"
+      << " <node id=\"13\" lat=\"10.4\" lon=\"20.3\"/>\n"
+      << " <node id=\"8589934592\" lat=\"10.65\" lon=\"20.75\">\n"
+      << "  <tag k=\"amenity\" v=\"school\"/>\n"
+      << "  <tag k=\"name\" v=\"a school\"/>\n"
+      << " </node>\n"
+      << " <node id=\"20\" lat=\"10.8\" lon=\"20.1\"/>\n"
+      << " <node id=\"21\" lat=\"10.8\" lon=\"20.5\"/>\n"
+      << " <node id=\"22\" lat=\"10.8\" lon=\"20.9\"/>\n"
+      << " <node id=\"32\" lat=\"10.4\" lon=\"20.9\"/>\n"
+      << " <node id=\"33\" lat=\"10.4\" lon=\"20.6\"/>\n"
+      << " <node id=\"34\" lat=\"10.6\" lon=\"20.2\"><tag k=\"man_made\" v=\"pier\"/><tag k=\"building\" v=\"yes\"/></node>\n"
+      // a closed way, an open way with a missing node and the two halves of a ring
+      << " <way id=\"100\"><nd ref=\"10\"/><nd ref=\"11\"/><nd ref=\"12\"/><nd ref=\"13\"/><nd ref=\"10\"/>\n"
+      << "  <tag k=\"building\" v=\"yes\"/></way>\n"
+      << " <way id=\"101\"><nd ref=\"20\"/><nd ref=\"999\"/><nd ref=\"21\"/><nd ref=\"22\"/>\n"
+      << "  <tag k=\"highway\" v=\"primary\"/></way>\n"
+      << " <way id=\"102\"><nd ref=\"30\"/><nd ref=\"31\"/><nd ref=\"32\"/></way>\n"
+      << " <way id=\"103\"><nd ref=\"32\"/><nd ref=\"33\"/><nd ref=\"30\"/></way>\n"
+      << " <way id=\"104\"><nd ref=\"20\"/><nd ref=\"21\"/></way>\n"
+      // a multipolygon, one with a missing way and a route
+      << " <relation id=\"300\"><member type=\"way\" ref=\"102\" role=\"outer\"/>\n"
+      << "  <member type=\"node\" ref=\"10\" role=\"\"/><member type=\"way\" ref=\"103\" role=\"outer\"/>\n"
+      << "  <tag k=\"type\" v=\"multipolygon\"/><tag k=\"landuse\" v=\"forest\"/></relation>\n"
+      << " <relation id=\"301\"><member type=\"way\" ref=\"105\" role=\"outer\"/>\n"
+      << "  <tag k=\"type\" v=\"multipolygon\"/><tag k=\"landuse\" v=\"forest\"/></relation>\n"
+      << " <relation id=\"302\"><member type=\"way\" ref=\"104\" role=\"\"/>\n"
+      << "  <tag k=\"type\" v=\"route\"/><tag k=\"route\" v=\"bus\"/></relation>\n"
+      << "</osm>\n";
+}
+
+//: roads and a region of the same level, with the road first in the file, and a point inside the region
+static void write_order_file(std::string const& file)
+{
+  std::ofstream ofs(file.c_str());
+  ofs << "<?xml version='1.0' encoding='UTF-8'?>\n"
+      << "<osm version=\"0.6\">\n"
+      << " <node id=\"1\" lat=\"10.1\" lon=\"20.1\"/>\n"
+      << " <node id=\"2\" lat=\"10.1\" lon=\"20.5\"/>\n"
+      << " <node id=\"3\" lat=\"10.5\" lon=\"20.5\"/>\n"
+      << " <node id=\"4\" lat=\"10.5\" lon=\"20.1\"/>\n"
+      << " <node id=\"5\" lat=\"10.3\" lon=\"20.0\"/>\n"
+      << " <node id=\"6\" lat=\"10.3\" lon=\"20.6\"/>\n"
+      << " <node id=\"7\" lat=\"10.05\" lon=\"20.3\"/>\n"
+      << " <node id=\"8\" lat=\"10.55\" lon=\"20.3\"/>\n"
+      << " <node id=\"9\" lat=\"10.2\" lon=\"20.2\"><tag k=\"amenity\" v=\"school\"/></node>\n"
+      << " <node id=\"10\" lat=\"10.4\" lon=\"20.4\"><tag k=\"building\" v=\"yes\"/></node>\n"
+      << " <way id=\"100\"><nd ref=\"5\"/><nd ref=\"6\"/><tag k=\"highway\" v=\"residential\"/></way>\n"
+      << " <way id=\"101\"><nd ref=\"1\"/><nd ref=\"2\"/><nd ref=\"3\"/><nd ref=\"4\"/><nd ref=\"1\"/>\n"
+      << "  <tag k=\"landuse\" v=\"grass\"/></way>\n"
+      << " <way id=\"102\"><nd ref=\"7\"/><nd ref=\"8\"/><tag k=\"highway\" v=\"primary\"/></way>\n"
+      << "</osm>\n";
+}
+
+static void write_category_table(std::string const& file)
+{
+  std::ofstream ofs(file.c_str());
+  ofs << "tag value id name level width\n"
+      << "building yes 5 building 2 0.0\n"
+      << "highway primary 9 primary 3 10.0\n"
+      << "highway residential 6 residential 2 5.0\n"
+      << "landuse forest 3 forest 1 0.0\n"
+      << "landuse grass 4 grass 2 0.0\n"
+      << "amenity school 7 school 2 0.0\n"
+      << "man_made pier 8 pier 3 0.0";
+}
+
+//: draw \p osm into tile \p t the way volm_create_osm_2d_map draws it into a leaf, with the pixels of \p r
+//  The roads of the tests are narrower than 1.1 pixels of the tiles.
+static void draw_as_osm_2d_map(volm_osm_objects& osm, volm_osm_tile_rasterizer const& r, unsigned t,
+                               vil_image_view<vxl_byte>& out_img, vil_image_view<vxl_byte>& level_img)
+{
+  out_img.set_size(r.label_image(t).ni(), r.label_image(t).nj());  out_img.fill(0);
+  level_img.set_size(out_img.ni(), out_img.nj());  level_img.fill(0);
+  int ni = (int)out_img.ni(), nj = (int)out_img.nj();
+  for (unsigned r_idx = 0; r_idx < osm.num_regions(); r_idx++) {
+    vgl_polygon<double> poly(osm.loc_polys()[r_idx]->poly()[0]);
+    bool ignore = false;
+    for (unsigned i = 0; i+1 < poly[0].size(); i++)
+      if (poly[0][i] == poly[0][i+1])  ignore = true;
+    unsigned char curr_level = osm.loc_polys()[r_idx]->prop().level_;
+    if (ignore || curr_level == 0)  continue;
+    unsigned char curr_id = osm.loc_polys()[r_idx]->prop().id_;
+    vgl_polygon<double> img_poly(1);
+    for (unsigned pt_idx = 0; pt_idx < poly[0].size(); pt_idx++)
+      img_poly[0].push_back(r.to_pixel(t, poly[0][pt_idx]));
+    vgl_polygon_scan_iterator<double> it(img_poly, true);
+    for (it.reset(); it.next(); ) {
+      int y = it.scany();
+      for (int x = it.startx(); x <= it.endx(); ++x)
+        if (x >= 0 && y >= 0 && x < ni && y < nj && curr_level > level_img(x, y))
+        {  out_img(x,y) = curr_id;  level_img(x,y) = curr_level;  }
+    }
+  }
+  for (unsigned r_idx = 0; r_idx < osm.num_roads(); r_idx++) {
+    std::vector<vgl_point_2d<double> > line_img;
+    for (unsigned pt_idx = 0; pt_idx < osm.loc_lines()[r_idx]->line().size(); pt_idx++)
+      line_img.push_back(r.to_pixel(t, osm.loc_lines()[r_idx]->line()[pt_idx]));
+    unsigned char curr_level = osm.loc_lines()[r_idx]->prop().level_;
+    unsigned char curr_id = osm.loc_lines()[r_idx]->prop().id_;
+    vgl_polygon<double> img_poly;
+    volm_io_tools::expend_line(line_img, 1.1, img_poly);
+    vgl_polygon_scan_iterator<double> it(img_poly, true);
+    for (it.reset(); it.next(); ) {
+      int y = it.scany();
+      for (int x = it.startx(); x <= it.endx(); ++x)
+        if (x >= 0 && y >= 0 && x < ni && y < nj && curr_level > level_img(x, y))
+        {  level_img(x,y) = curr_level;  out_img(x,y) = curr_id;  }
+    }
+  }
+  for (unsigned p_idx = 0; p_idx < osm.num_locs(); p_idx++) {
+    if (osm.loc_pts()[p_idx]->prop().name_ == "building")
+      continue;
+    unsigned char curr_level = osm.loc_pts()[p_idx]->prop().level_;
+    unsigned char curr_id = osm.loc_pts()[p_idx]->prop().id_;
+    vgl_point_2d<double> p = r.to_pixel(t, osm.loc_pts()[p_idx]->loc());
+    if (p.x() < 0.0 || p.y() < 0.0)  continue;  // outside of the leaf
+    int x = (int)p.x();  int y = (int)p.y();
+    if (x >= 0 && y >= 0 && x < ni && y < nj && curr_level >= level_img(x,y))
+    {  out_img(x, y) = curr_id;  level_img(x,y) = curr_level;  }
+  }
+}
+
+//: compare the rasterized tiles of \p osm_file with the drawing of volm_create_osm_2d_map
+static void compare_with_osm_2d_map(std::string const& osm_file, std::string const& table_file,
+                                    std::vector<volm_tile> const& tiles, std::string const& name)
+{
+  std::map<std::pair<std::string, std::string>, volm_land_layer> table;
+  volm_osm_category_io::load_category_table(table_file, table);
+  volm_osm_objects osm(osm_file, table_file);
+  volm_osm_tile_rasterizer r1(tiles, table, 1), r3(tiles, table, 3);
+  r1.rasterize(osm_file, 1);
+  r3.rasterize(osm_file);
+  bool same = true;
+  for (unsigned t = 0; t < tiles.size(); ++t) {
+    vil_image_view<vxl_byte> out_img, level_img;
+    draw_as_osm_2d_map(osm, r1, t, out_img, level_img);
+    for (unsigned j = 0; j < out_img.nj(); ++j)
+      for (unsigned i = 0; i < out_img.ni(); ++i)
+        if (r1.label_image(t)(i,j) != out_img(i,j) || r1.level_image(t)(i,j) != level_img(i,j) ||
+            r3.label_image(t)(i,j) != out_img(i,j) || r3.level_image(t)(i,j) != level_img(i,j))
+          same = false;
+  }
+  TEST(("tiles of " + name + " as volm_create_osm_2d_map draws them").c_str(), same, true);
+}
+
+static void test_osm_stream_parser()
+{
+  // the objects are those of volm_osm_parser, from a single pass
+  std::string filename = std::string(VCL_SOURCE_ROOT_DIR) + "/contrib/brl/bbas/volm/tests/test.osm";
+  compare_with_osm_parser(filename, "test.osm");
+
+  std::string stream_file = "./test_stream.osm";
+  write_test_file(stream_file);
+  std::vector<vgl_point_2d<double> > pts;
+  std::vector<std::vector<vgl_point_2d<double> > > lines;
+  std::vector<vgl_polygon<double> > polys;
+  keys_t pt_keys, line_keys, poly_keys;
+  volm_osm_stream_parser::parse_objects(stream_file, pts, pt_keys, lines, line_keys, polys, poly_keys);
+  TEST("points", pts.size(), 2);
+  TEST("lines", lines.size(), 1);
+  TEST("line skips a missing node", lines.empty() ? 0 : lines[0].size(), 3);
+  TEST("polygons from a way and a relation", polys.size(), 2);
+  TEST("relation polygon", polys.size() == 2 && polys[1].num_sheets() == 1 && polys[1][0].size() == 4, true);
+  TEST("relation tags", poly_keys.size() == 2 && poly_keys[1].size() == 1 && poly_keys[1][0].second == "forest", true);
+  TEST("64 bit node id", pts.size() == 2 && pts[1] == vgl_point_2d<double>(20.75, 10.65), true);
+
+  // small blocks and batches give the same objects, in the order of the file
+  test_osm_collector collector;
+  volm_osm_stream_parser batched(&collector, 2);
+  TEST("parse in small blocks", batched.parse(stream_file, 7), true);
+  volm_osm_stream_parser whole;
+  whole.parse(stream_file);
+  volm_osm_stream_objects& all = whole.objects();
+  TEST("number of batches", collector.n_batches, 3);
+  TEST("end of stream", collector.n_ends, 1);
+  bool same = collector.objs.size() == all.size() && collector.objs.coords() == all.coords();
+  for (unsigned o = 0; same && o < all.size(); ++o)
+    same = collector.objs.type(o) == all.type(o) && collector.objs.osm_id(o) == all.osm_id(o) &&
+           collector.objs.tags(o, collector.names) == all.tags(o, whole.strings());
+  TEST("batched objects", same, true);
+  TEST("file order", all.size() == 5 && all.type(0) == volm_osm_stream_objects::POINT &&
+                     all.type(4) == volm_osm_stream_objects::RELATION_POLYGON, true);
+  TEST("counts", whole.num_nodes() == 13 && whole.num_ways() == 5 && whole.num_relations() == 3, true);
+  TEST("bounding box", whole.bbox().min_x() == 20.0 && whole.bbox().max_y() == 11.0, true);
+  TEST("interned strings", whole.strings().find("forest") >= 0 && whole.strings().find("type") < 0, true);
+  TEST("missing file", whole.parse("./no_such_file.osm"), false);
+
+  // rasterize into tiles; the result does not depend on the threads or the batches
+  std::map<std::pair<std::string, std::string>, volm_land_layer> table;
+  table[std::pair<std::string, std::string>("building", "yes")] = volm_land_layer(5, "building", 2, 0.0);
+  table[std::pair<std::string, std::string>("highway", "primary")] = volm_land_layer(9, "primary", 3, 10.0);
+  table[std::pair<std::string, std::string>("landuse", "forest")] = volm_land_layer(3, "forest", 1, 0.0);
+  table[std::pair<std::string, std::string>("amenity", "school")] = volm_land_layer(7, "school", 4, 0.0);
+  table[std::pair<std::string, std::string>("man_made", "pier")] = volm_land_layer(8, "pier", 3, 0.0);
+  std::vector<volm_tile> tiles;
+  tiles.push_back(volm_tile(10.0f, 20.0f, 'N', 'E', 1.0f, 1.0f, 201, 201));
+  tiles.push_back(volm_tile(10.0f, 20.0f, 'N', 'E', 1.0f, 1.0f, 101, 101));
+  tiles.push_back(volm_tile(10.0f, 21.0f, 'N', 'E', 1.0f, 1.0f, 201, 201));
+  volm_osm_tile_rasterizer r1(tiles, table, 1), r3(tiles, table, 3);
+  TEST("rasterize", r1.rasterize(stream_file, 1), true);
+  r3.rasterize(stream_file);
+  TEST("classified objects", r1.n_classified(), 5);
+  bool same_images = true;
+  for (unsigned t = 0; t < tiles.size(); ++t)
+    for (unsigned j = 0; j < r1.label_image(t).nj(); ++j)
+      for (unsigned i = 0; i < r1.label_image(t).ni(); ++i)
+        if (r1.label_image(t)(i,j) != r3.label_image(t)(i,j) || r1.level_image(t)(i,j) != r3.level_image(t)(i,j))
+          same_images = false;
+  TEST("images independent of threads and batches", same_images, true);
+
+  // pixels agree with the tile camera
+  unsigned ti, tj;
+  tiles[0].global_to_img(20.35, 10.35, ti, tj);
+  vgl_point_2d<double> p = r1.to_pixel(0, vgl_point_2d<double>(20.35, 10.35));
+  TEST("pixel of the tile camera", (unsigned)p.x() == ti && (unsigned)p.y() == tj, true);
+  vil_image_view<vxl_byte> const& label = r1.label_image(0);
+  TEST("building", label(ti, tj), 5);
+  tiles[0].global_to_img(20.8, 10.2, ti, tj);
+  TEST("relation", label(ti, tj), 3);
+  tiles[0].global_to_img(20.3, 10.8, ti, tj);
+  TEST("road", label(ti, tj), 9);
+  tiles[0].global_to_img(20.3, 10.81, ti, tj);
+  TEST("road width", label(ti, tj), 0);
+  tiles[0].global_to_img(20.75, 10.65, ti, tj);
+  TEST("point", label(ti, tj), 7);
+  tiles[0].global_to_img(20.2, 10.6, ti, tj);
+  TEST("pier first", label(ti, tj), 8);
+  tiles[0].global_to_img(20.2, 10.2, ti, tj);
+  TEST("empty", label(ti, tj) == 0 && r1.level_image(0)(ti, tj) == 0, true);
+  unsigned n_set = 0;
+  for (unsigned j = 0; j < r1.label_image(2).nj(); ++j)
+    for (unsigned i = 0; i < r1.label_image(2).ni(); ++i)
+      if (r1.label_image(2)(i,j)) ++n_set;
+  TEST("neighbouring tile", n_set < 400, true);
+
+  // the regions, then the roads, then the points, as volm_create_osm_2d_map draws them
+  std::string order_file = "./test_stream_order.osm", table_file = "./test_stream_table.txt";
+  write_order_file(order_file);
+  write_category_table(table_file);
+  compare_with_osm_2d_map(stream_file, table_file, tiles, "test_stream.osm");
+  compare_with_osm_2d_map(order_file, table_file, tiles, "test_stream_order.osm");
+  std::map<std::pair<std::string, std::string>, volm_land_layer> file_table;
+  volm_osm_category_io::load_category_table(table_file, file_table);
+  volm_osm_tile_rasterizer ro(tiles, file_table, 2);
+  ro.rasterize(order_file, 1);
+  tiles[0].global_to_img(20.25, 10.3, ti, tj);
+  TEST("region over an earlier road of its level", ro.label_image(0)(ti, tj), 4);
+  tiles[0].global_to_img(20.3, 10.45, ti, tj);
+  TEST("later road of a higher level over a region", ro.label_image(0)(ti, tj), 9);
+  tiles[0].global_to_img(20.2, 10.2, ti, tj);
+  TEST("point over a region of its level", ro.label_image(0)(ti, tj), 7);
+  tiles[0].global_to_img(20.4, 10.4, ti, tj);
+  TEST("no building points", ro.label_image(0)(ti, tj), 4);
+  tiles[0].global_to_img(20.05, 10.3, ti, tj);
+  TEST("road outside of the region", ro.label_image(0)(ti, tj), 6);
+  vpl_unlink(stream_file.c_str());
+  vpl_unlink(order_file.c_str());
+  vpl_unlink(table_file.c_str());
+}
+
+TESTMAIN(test_osm_stream_parser);
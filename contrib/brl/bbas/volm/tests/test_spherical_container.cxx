@@ -4,6 +4,7 @@
 #include <vpl/vpl.h>
 #include <vsl/vsl_binary_io.h>
 #include <bbas/volm/volm_spherical_container.h>
+#include <vgl/vgl_vector_3d.h>
 
 static void test_spherical_container()
 {
@@ -84,6 +85,45 @@ static void test_spherical_container()
   TEST("depth interval for dmax..",   sph.get_depth_interval(10000), 240);
 #endif
 
+  // closest_voxels() against a scan of the layer: two shells of voxels on
+  // cubes about the centre, mapped to the directions of the inner one
+  volm_spherical_container shells(angle, vmin, dmax);
+  std::vector<volm_voxel>& voxels = shells.get_voxels();
+  voxels.clear();
+  double half[2] = { 10.0, 23.0 };
+  unsigned n_side[2] = { 16, 37 };
+  unsigned layer_end = 0;
+  for (unsigned s = 0; s < 2; ++s) {
+    double step = 2.0*half[s]/n_side[s];
+    for (unsigned f = 0; f < 6; ++f)
+      for (unsigned a = 0; a < n_side[s]; ++a)
+        for (unsigned b = 0; b < n_side[s]; ++b) {
+          double u = -half[s] + (a+0.5)*step, v = -half[s] + (b+0.5)*step;
+          double w = (f%2) ? half[s] : -half[s];
+          vgl_point_3d<double> c = f < 2 ? vgl_point_3d<double>(w, u, v)
+                                 : f < 4 ? vgl_point_3d<double>(u, w, v)
+                                         : vgl_point_3d<double>(u, v, w);
+          voxels.push_back(volm_voxel(step, c));
+        }
+    if (s == 0)
+      layer_end = (unsigned)voxels.size();
+  }
+  const std::vector<unsigned int>& closest = shells.closest_voxels(0, layer_end);
+  unsigned n_bad = 0;
+  for (unsigned i = 0; i < voxels.size(); ++i) {
+    vgl_vector_3d<double> d = normalized(voxels[i].center_ - vgl_point_3d<double>(0.0, 0.0, 0.0));
+    double best_dot = -2.0;
+    for (unsigned j = 0; j < layer_end; ++j) {
+      double dt = dot_product(d, normalized(voxels[j].center_ - vgl_point_3d<double>(0.0, 0.0, 0.0)));
+      if (dt > best_dot) best_dot = dt;
+    }
+    // ties between equally close layer voxels may go either way
+    double got = dot_product(d, normalized(voxels[closest[i]].center_ - vgl_point_3d<double>(0.0, 0.0, 0.0)));
+    if (closest[i] >= layer_end || got < best_dot - 1e-12) ++n_bad;
+  }
+  TEST("closest voxels size", closest.size(), voxels.size());
+  TEST("closest voxels match a scan of the layer", n_bad, 0);
+  TEST("layer voxels map to themselves", closest[5] == 5 && closest[layer_end-1] == layer_end-1, true);
 }
 
 
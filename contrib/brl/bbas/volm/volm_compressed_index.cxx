@@ -0,0 +1,583 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include "volm_compressed_index.h"
+//:
+// \file
+#include <volm/volm_buffered_index.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+
+#if !(defined(VCL_WIN32) && !defined(__CYGWIN__))
+#define VOLM_COMPRESSED_INDEX_MMAP 1
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+static const unsigned volm_ci_header_size = 12;
+static const unsigned volm_ci_trailer_size = 20;
+// rANS coder: 12 bit probabilities, 32 bit state kept in [2^23, 2^31)
+static const unsigned volm_ci_prob_bits = 12;
+static const unsigned volm_ci_prob_scale = 1u << volm_ci_prob_bits;
+static const vxl_uint_32 volm_ci_rans_l = 1u << 23;
+
+static void volm_ci_put16(std::vector<unsigned char>& out, unsigned v)
+{
+  out.push_back((unsigned char)(v & 0xff));
+  out.push_back((unsigned char)((v >> 8) & 0xff));
+}
+
+static void volm_ci_put32(std::vector<unsigned char>& out, vxl_uint_32 v)
+{
+  for (unsigned i = 0; i < 4; ++i)
+    out.push_back((unsigned char)((v >> (8*i)) & 0xff));
+}
+
+static void volm_ci_put64(std::vector<unsigned char>& out, vxl_uint_64 v)
+{
+  for (unsigned i = 0; i < 8; ++i)
+    out.push_back((unsigned char)((v >> (8*i)) & 0xff));
+}
+
+static unsigned volm_ci_get16(unsigned char const* p)
+{
+  return unsigned(p[0]) | (unsigned(p[1]) << 8);
+}
+
+static vxl_uint_32 volm_ci_get32(unsigned char const* p)
+{
+  return vxl_uint_32(p[0]) | (vxl_uint_32(p[1]) << 8) | (vxl_uint_32(p[2]) << 16) | (vxl_uint_32(p[3]) << 24);
+}
+
+static vxl_uint_64 volm_ci_get64(unsigned char const* p)
+{
+  return vxl_uint_64(volm_ci_get32(p)) | (vxl_uint_64(volm_ci_get32(p+4)) << 32);
+}
+
+//: Scale symbol counts to frequencies summing to volm_ci_prob_scale, every present symbol keeping at least 1
+static void volm_ci_normalize(std::vector<vxl_uint_64> const& count, vxl_uint_64 total, unsigned freq[256])
+{
+  unsigned sum = 0;
+  for (unsigned s = 0; s < 256; ++s) {
+    freq[s] = 0;
+    if (count[s] == 0)
+      continue;
+    freq[s] = (unsigned)((count[s] * volm_ci_prob_scale) / total);
+    if (freq[s] == 0)
+      freq[s] = 1;
+    sum += freq[s];
+  }
+  // correct the rounding on the most frequent symbol; it always keeps more than one slot
+  while (sum != volm_ci_prob_scale) {
+    unsigned best = 0;
+    for (unsigned s = 1; s < 256; ++s)
+      if (freq[s] > freq[best])
+        best = s;
+    if (sum > volm_ci_prob_scale) { --freq[best]; --sum; }
+    else                          { ++freq[best]; ++sum; }
+  }
+}
+
+void volm_compressed_index::encode_block(unsigned char const* values, unsigned n, unsigned layer_size,
+                                         std::vector<unsigned char>& out)
+{
+  std::size_t len = std::size_t(n)*layer_size;
+
+  // difference to the previous hypothesis, then run length code the zeros:
+  // a zero byte is followed by the run length - 1 in 7 bit groups
+  std::vector<unsigned char> rle;
+  rle.reserve(len/4 + 16);
+  std::size_t i = 0;
+  while (i < len) {
+    unsigned char d = i < layer_size ? values[i] : (unsigned char)(values[i] - values[i-layer_size]);
+    if (d != 0) {
+      rle.push_back(d);
+      ++i;
+      continue;
+    }
+    std::size_t j = i+1;
+    while (j < len && values[j] == (j < layer_size ? 0 : values[j-layer_size]))
+      ++j;
+    vxl_uint_64 r = j - i - 1;
+    rle.push_back(0);
+    while (r >= 128) {
+      rle.push_back((unsigned char)(0x80 | (r & 0x7f)));
+      r >>= 7;
+    }
+    rle.push_back((unsigned char)r);
+    i = j;
+  }
+
+  std::vector<vxl_uint_64> count(256, 0);
+  for (std::size_t k = 0; k < rle.size(); ++k)
+    ++count[rle[k]];
+  unsigned freq[256], cum[257];
+  volm_ci_normalize(count, rle.size(), freq);
+  cum[0] = 0;
+  for (unsigned s = 0; s < 256; ++s)
+    cum[s+1] = cum[s] + freq[s];
+
+  // rANS encodes backwards; the decoder reads the final state first, then the bytes in reverse order
+  std::vector<unsigned char> emitted;
+  emitted.reserve(rle.size()/2 + 16);
+  vxl_uint_32 x = volm_ci_rans_l;
+  for (std::size_t k = rle.size(); k > 0; --k) {
+    unsigned s = rle[k-1];
+    vxl_uint_32 f = freq[s];
+    vxl_uint_32 x_max = ((volm_ci_rans_l >> volm_ci_prob_bits) << 8) * f;
+    while (x >= x_max) {
+      emitted.push_back((unsigned char)(x & 0xff));
+      x >>= 8;
+    }
+    x = ((x / f) << volm_ci_prob_bits) + (x % f) + cum[s];
+  }
+
+  unsigned n_sym = 0;
+  for (unsigned s = 0; s < 256; ++s)
+    n_sym += freq[s] ? 1 : 0;
+  std::size_t coded = 1 + 4 + 2 + 3*n_sym + 4 + 4 + emitted.size();
+  if (coded >= 1 + len) {
+    out.push_back(0);
+    out.insert(out.end(), values, values + len);
+    return;
+  }
+  out.push_back(1);
+  volm_ci_put32(out, (vxl_uint_32)rle.size());
+  volm_ci_put16(out, n_sym);
+  for (unsigned s = 0; s < 256; ++s)
+    if (freq[s]) {
+      out.push_back((unsigned char)s);
+      volm_ci_put16(out, freq[s]);
+    }
+  volm_ci_put32(out, (vxl_uint_32)(4 + emitted.size()));
+  volm_ci_put32(out, x);
+  out.insert(out.end(), emitted.rbegin(), emitted.rend());
+}
+
+bool volm_compressed_index::decode_block(unsigned char const* data, std::size_t len, unsigned n, unsigned layer_size,
+                                         unsigned char* values, std::vector<unsigned char>& scratch)
+{
+  std::size_t out_len = std::size_t(n)*layer_size;
+  if (len < 1)
+    return false;
+  if (data[0] == 0) {
+    if (len != 1 + out_len)
+      return false;
+    std::memcpy(values, data+1, out_len);
+    return true;
+  }
+  if (data[0] != 1 || len < 1+4+2)
+    return false;
+  unsigned char const* p = data + 1;
+  unsigned char const* end = data + len;
+  vxl_uint_32 rle_len = volm_ci_get32(p);  p += 4;
+  unsigned n_sym = volm_ci_get16(p);  p += 2;
+  if (n_sym == 0 || n_sym > 256 || std::size_t(end - p) < 3*std::size_t(n_sym) + 4)
+    return false;
+  unsigned freq[256], cum[256];
+  unsigned char slot_sym[volm_ci_prob_scale];
+  std::fill(freq, freq+256, 0u);
+  unsigned total = 0;
+  for (unsigned k = 0; k < n_sym; ++k, p += 3) {
+    unsigned s = p[0], f = volm_ci_get16(p+1);
+    if (f == 0 || total + f > volm_ci_prob_scale)
+      return false;
+    freq[s] = f;
+    cum[s] = total;
+    std::fill(slot_sym + total, slot_sym + total + f, (unsigned char)s);
+    total += f;
+  }
+  if (total != volm_ci_prob_scale)
+    return false;
+  vxl_uint_32 rans_len = volm_ci_get32(p);  p += 4;
+  if (rans_len < 4 || std::size_t(end - p) != rans_len)
+    return false;
+  vxl_uint_32 x = volm_ci_get32(p);  p += 4;
+
+  scratch.resize(rle_len);
+  for (vxl_uint_32 k = 0; k < rle_len; ++k) {
+    unsigned slot = x & (volm_ci_prob_scale - 1);
+    unsigned s = slot_sym[slot];
+    scratch[k] = (unsigned char)s;
+    x = freq[s] * (x >> volm_ci_prob_bits) + slot - cum[s];
+    while (x < volm_ci_rans_l) {
+      if (p == end)
+        return false;
+      x = (x << 8) | *p++;
+    }
+  }
+
+  // undo the run length coding, then the differences
+  std::size_t o = 0;
+  for (vxl_uint_32 k = 0; k < rle_len; ) {
+    unsigned char d = scratch[k++];
+    if (d != 0) {
+      if (o == out_len)
+        return false;
+      values[o++] = d;
+      continue;
+    }
+    vxl_uint_64 r = 0;
+    unsigned shift = 0;
+    while (true) {
+      if (k == rle_len || shift > 56)
+        return false;
+      unsigned char b = scratch[k++];
+      r |= vxl_uint_64(b & 0x7f) << shift;
+      shift += 7;
+      if (!(b & 0x80))
+        break;
+    }
+    if (r + 1 > out_len - o)
+      return false;
+    std::memset(values + o, 0, std::size_t(r + 1));
+    o += std::size_t(r + 1);
+  }
+  if (o != out_len)
+    return false;
+  for (std::size_t k = layer_size; k < out_len; ++k)
+    values[k] = (unsigned char)(values[k] + values[k-layer_size]);
+  return true;
+}
+
+volm_compressed_index::volm_compressed_index(unsigned layer_size, unsigned block_size)
+: layer_size_(layer_size), block_size_(block_size ? block_size : 1), m_(NOT_INITIALIZED),
+  n_hyps_(0), file_size_(0), map_(VXL_NULLPTR), current_(0), cached_block_((unsigned)-1)
+{
+}
+
+volm_compressed_index::~volm_compressed_index()
+{
+  finalize();
+}
+
+bool volm_compressed_index::initialize_write(std::string const& file_name)
+{
+  finalize();
+  file_name_ = file_name;
+  of_obj_.open(file_name.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!of_obj_.good() || layer_size_ == 0)
+    return false;
+  m_ = WRITE;
+  n_hyps_ = 0;
+  offsets_.clear();
+  pending_.clear();
+  std::vector<unsigned char> header;
+  header.push_back('V'); header.push_back('C'); header.push_back('I'); header.push_back('1');
+  volm_ci_put32(header, layer_size_);
+  volm_ci_put32(header, block_size_);
+  of_obj_.write((char const*)&header[0], header.size());
+  file_size_ = header.size();
+  return of_obj_.good();
+}
+
+bool volm_compressed_index::add_to_index(unsigned char const* values)
+{
+  if (m_ != WRITE) {
+    std::cerr << "compressed index is not in WRITE mode! cannot add to index!\n";
+    return false;
+  }
+  pending_.insert(pending_.end(), values, values + layer_size_);
+  ++n_hyps_;
+  if (pending_.size() == std::size_t(block_size_)*layer_size_)
+    return flush_block();
+  return true;
+}
+
+bool volm_compressed_index::add_to_index(std::vector<unsigned char> const& values)
+{
+  if (values.size() < layer_size_)
+    return false;
+  return add_to_index(&values[0]);
+}
+
+bool volm_compressed_index::flush_block()
+{
+  if (pending_.empty())
+    return true;
+  encoded_.clear();
+  encode_block(&pending_[0], (unsigned)(pending_.size() / layer_size_), layer_size_, encoded_);
+  offsets_.push_back(file_size_);
+  of_obj_.write((char const*)&encoded_[0], encoded_.size());
+  file_size_ += encoded_.size();
+  pending_.clear();
+  return of_obj_.good();
+}
+
+bool volm_compressed_index::finalize()
+{
+  bool ok = true;
+  if (m_ == WRITE) {
+    ok = flush_block();
+    offsets_.push_back(file_size_);
+    std::vector<unsigned char> table;
+    for (unsigned b = 0; b < offsets_.size(); ++b)
+      volm_ci_put64(table, offsets_[b]);
+    volm_ci_put64(table, n_hyps_);
+    volm_ci_put64(table, file_size_);
+    table.push_back('V'); table.push_back('C'); table.push_back('I'); table.push_back('E');
+    of_obj_.write((char const*)&table[0], table.size());
+    file_size_ += table.size();
+    ok = ok && of_obj_.good();
+    of_obj_.close();
+  }
+  if (m_ == READ) {
+    unmap();
+    if (if_obj_.is_open())
+      if_obj_.close();
+    cache_.clear();
+    cached_block_ = (unsigned)-1;
+  }
+  m_ = NOT_INITIALIZED;
+  return ok;
+}
+
+void volm_compressed_index::unmap()
+{
+#ifdef VOLM_COMPRESSED_INDEX_MMAP
+  if (map_)
+    munmap(const_cast<unsigned char*>(map_), (std::size_t)file_size_);
+#endif
+  map_ = VXL_NULLPTR;
+}
+
+bool volm_compressed_index::read_at(vxl_uint_64 pos, std::size_t len, unsigned char* buf)
+{
+  if (pos + len > file_size_)
+    return false;
+  if (map_) {
+    std::memcpy(buf, map_ + pos, len);
+    return true;
+  }
+  if_obj_.clear();
+  if_obj_.seekg((std::streamoff)pos, std::ios::beg);
+  if_obj_.read((char*)buf, (std::streamsize)len);
+  return if_obj_.good();
+}
+
+bool volm_compressed_index::initialize_read(std::string const& file_name)
+{
+  finalize();
+  file_name_ = file_name;
+  file_size_ = 0;
+#ifdef VOLM_COMPRESSED_INDEX_MMAP
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* p = mmap(VXL_NULLPTR, (std::size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (p != MAP_FAILED) {
+        map_ = static_cast<unsigned char const*>(p);
+        file_size_ = (vxl_uint_64)st.st_size;
+      }
+    }
+    close(fd);
+  }
+#endif
+  if (!map_) {
+    if_obj_.open(file_name.c_str(), std::ios::in | std::ios::binary);
+    if (!if_obj_.good())
+      return false;
+    if_obj_.seekg(0, std::ios::end);
+    file_size_ = (vxl_uint_64)if_obj_.tellg();
+  }
+  m_ = READ;
+
+  unsigned char header[volm_ci_header_size], trailer[volm_ci_trailer_size];
+  if (file_size_ < volm_ci_header_size + volm_ci_trailer_size + 8 ||
+      !read_at(0, volm_ci_header_size, header) ||
+      !read_at(file_size_ - volm_ci_trailer_size, volm_ci_trailer_size, trailer) ||
+      std::memcmp(header, "VCI1", 4) != 0 || std::memcmp(trailer + 16, "VCIE", 4) != 0) {
+    std::cerr << "error: " << file_name << " is not a compressed volm index\n";
+    finalize();
+    return false;
+  }
+  layer_size_ = volm_ci_get32(header + 4);
+  block_size_ = volm_ci_get32(header + 8);
+  n_hyps_ = volm_ci_get64(trailer);
+  vxl_uint_64 table_pos = volm_ci_get64(trailer + 8);
+  unsigned nb = this->n_blocks();
+  if (layer_size_ == 0 || block_size_ == 0 ||
+      table_pos + 8*(vxl_uint_64(nb)+1) + volm_ci_trailer_size != file_size_) {
+    std::cerr << "error: corrupt offset table in " << file_name << '\n';
+    finalize();
+    return false;
+  }
+  std::vector<unsigned char> table(8*(std::size_t(nb)+1));
+  if (!read_at(table_pos, table.size(), &table[0])) {
+    finalize();
+    return false;
+  }
+  offsets_.resize(nb+1);
+  for (unsigned b = 0; b <= nb; ++b) {
+    offsets_[b] = volm_ci_get64(&table[8*b]);
+    if ((b > 0 && offsets_[b] < offsets_[b-1]) || offsets_[b] > table_pos) {
+      std::cerr << "error: corrupt offset table in " << file_name << '\n';
+      finalize();
+      return false;
+    }
+  }
+  current_ = 0;
+  cached_block_ = (unsigned)-1;
+  return true;
+}
+
+unsigned volm_compressed_index::block_count(unsigned b) const
+{
+  vxl_uint_64 first = vxl_uint_64(b)*block_size_;
+  return (unsigned)std::min<vxl_uint_64>(block_size_, n_hyps_ - first);
+}
+
+unsigned char const* volm_compressed_index::block_data(unsigned b, std::vector<unsigned char>& buf)
+{
+  vxl_uint_64 pos = offsets_[b], len = offsets_[b+1] - offsets_[b];
+  if (map_)
+    return map_ + pos;
+  buf.resize((std::size_t)len);
+  if (len == 0 || !read_at(pos, (std::size_t)len, &buf[0]))
+    return VXL_NULLPTR;
+  return &buf[0];
+}
+
+bool volm_compressed_index::get(vxl_uint_64 k, unsigned char* values)
+{
+  if (m_ != READ || k >= n_hyps_)
+    return false;
+  unsigned b = (unsigned)(k / block_size_);
+  if (b != cached_block_) {
+    unsigned n = block_count(b);
+    cache_.resize(std::size_t(n)*layer_size_);
+    unsigned char const* data = block_data(b, staging_);
+    cached_block_ = (unsigned)-1;
+    if (!data ||
+        !decode_block(data, (std::size_t)(offsets_[b+1] - offsets_[b]), n, layer_size_, &cache_[0], scratch_)) {
+      std::cerr << "error: corrupt block " << b << " in " << file_name_ << '\n';
+      return false;
+    }
+    cached_block_ = b;
+  }
+  std::memcpy(values, &cache_[std::size_t(k - vxl_uint_64(b)*block_size_)*layer_size_], layer_size_);
+  current_ = k+1;
+  return true;
+}
+
+bool volm_compressed_index::get(vxl_uint_64 k, std::vector<unsigned char>& values)
+{
+  values.resize(layer_size_);
+  return get(k, &values[0]);
+}
+
+bool volm_compressed_index::get_next(unsigned char* values)
+{
+  return get(current_, values);
+}
+
+bool volm_compressed_index::get_next(std::vector<unsigned char>& values)
+{
+  return get(current_, values);
+}
+
+//: Decodes the blocks of a range of hypotheses, one block per index
+class volm_compressed_index_decode_body : public vpl_parallel_for_body
+{
+ public:
+  volm_compressed_index_decode_body(unsigned n_threads)
+  : scratch(n_threads), partial(n_threads) {}
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    for (unsigned i = begin; i < end; ++i) {
+      vxl_uint_64 b0 = vxl_uint_64(b_first + i) * block_size;
+      unsigned n = count[i];
+      // the part of the block inside the range
+      vxl_uint_64 lo = std::max(b0, first), hi = std::min(b0 + n, first + n_range);
+      unsigned char* dest = values + std::size_t(lo - first)*layer_size;
+      bool whole = lo == b0 && hi == b0 + n;
+      unsigned char* out = dest;
+      if (!whole) {
+        partial[thread_id].resize(std::size_t(n)*layer_size);
+        out = &partial[thread_id][0];
+      }
+      ok[i] = data[i] && volm_compressed_index::decode_block(data[i], len[i], n, layer_size, out, scratch[thread_id]);
+      if (ok[i] && !whole)
+        std::memcpy(dest, out + std::size_t(lo - b0)*layer_size, std::size_t(hi - lo)*layer_size);
+    }
+  }
+
+  unsigned layer_size;
+  unsigned block_size;
+  unsigned b_first;
+  vxl_uint_64 first;
+  unsigned n_range;
+  unsigned char* values;
+  std::vector<unsigned char const*> data;
+  std::vector<std::size_t> len;
+  std::vector<unsigned> count;
+  std::vector<char> ok;
+  std::vector<std::vector<unsigned char> > scratch;
+  std::vector<std::vector<unsigned char> > partial;
+};
+
+bool volm_compressed_index::get_range(vxl_uint_64 first, unsigned n, unsigned char* values, unsigned num_threads)
+{
+  if (m_ != READ || first + n > n_hyps_)
+    return false;
+  if (n == 0)
+    return true;
+  unsigned b0 = (unsigned)(first / block_size_), b1 = (unsigned)((first + n - 1) / block_size_);
+  unsigned nb = b1 - b0 + 1;
+  unsigned nt = vpl_parallel_for_num_threads(num_threads);
+  volm_compressed_index_decode_body body(nt);
+  body.layer_size = layer_size_;
+  body.block_size = block_size_;
+  body.b_first = b0;
+  body.first = first;
+  body.n_range = n;
+  body.values = values;
+  body.data.resize(nb);
+  body.len.resize(nb);
+  body.count.resize(nb);
+  body.ok.assign(nb, 0);
+
+  // without a map, read the compressed blocks first, one after the other
+  std::vector<unsigned char> staged;
+  if (!map_) {
+    staged.resize((std::size_t)(offsets_[b1+1] - offsets_[b0]));
+    if (!read_at(offsets_[b0], staged.size(), &staged[0]))
+      return false;
+  }
+  for (unsigned i = 0; i < nb; ++i) {
+    unsigned b = b0 + i;
+    body.len[i] = (std::size_t)(offsets_[b+1] - offsets_[b]);
+    body.count[i] = block_count(b);
+    body.data[i] = map_ ? map_ + offsets_[b] : &staged[0] + (offsets_[b] - offsets_[b0]);
+  }
+  vpl_parallel_for(nb, body, nt);
+  for (unsigned i = 0; i < nb; ++i)
+    if (!body.ok[i]) {
+      std::cerr << "error: corrupt block " << b0+i << " in " << file_name_ << '\n';
+      return false;
+    }
+  current_ = first + n;
+  return true;
+}
+
+bool volm_compressed_index::convert(std::string const& buffered_file, std::string const& compressed_file,
+                                    unsigned layer_size, unsigned block_size)
+{
+  volm_buffered_index in(layer_size, 0.1f);
+  if (!in.initialize_read(buffered_file))
+    return false;
+  volm_compressed_index out(layer_size, block_size);
+  if (!out.initialize_write(compressed_file))
+    return false;
+  std::vector<unsigned char> values(layer_size);
+  bool ok = true;
+  while (ok && in.get_next(&values[0], layer_size))
+    ok = out.add_to_index(&values[0]);
+  in.finalize();
+  return out.finalize() && ok;
+}
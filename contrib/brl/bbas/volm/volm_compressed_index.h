@@ -0,0 +1,136 @@
+//This is brl/bbas/volm/volm_compressed_index.h
+#ifndef volm_compressed_index_h_
+#define volm_compressed_index_h_
+//:
+// \file
+// \brief  A block compressed index file with random access to the index of every location hypothesis
+//
+// Holds the same data as volm_buffered_index, one vector of layer_size values per
+// hypothesis, but compressed and with an offset table, so that hypothesis k can be
+// fetched without reading the ones before it.
+//
+// Hypotheses are grouped in blocks of block_size, each compressed on its own:
+// every layer is replaced by its difference to the previous hypothesis of the block
+// (neighbouring hypotheses see nearly the same depths, so most differences are 0),
+// runs of zeros are run length coded, and the result is entropy coded with a static
+// rANS coder whose frequency table is stored with the block.  A block that does not
+// shrink is stored raw.
+//
+// For reading, the file is memory mapped where the platform allows it, and the
+// blocks of a range of hypotheses are decoded on several threads.
+//
+// File layout (all integers little endian):
+// \verbatim
+//   "VCI1"  layer_size(u32)  block_size(u32)
+//   block 0, block 1, ...
+//   offset of every block and of the end of the last block (u64 each)
+//   number of hypotheses (u64)  offset of the offset table (u64)  "VCIE"
+// \endverbatim
+//
+// \verbatim
+//   Modifications
+// \endverbatim
+//
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <vbl/vbl_ref_count.h>
+#include <vxl_config.h>
+#include <vcl_compiler.h>
+
+class volm_compressed_index : public vbl_ref_count
+{
+ public:
+  enum mode { READ = 0, WRITE = 1, NOT_INITIALIZED = 2 };
+
+  //: layer_size is the size of the index of each hypothesis, block_size the number of hypotheses compressed together
+  volm_compressed_index(unsigned layer_size, unsigned block_size = 64);
+  ~volm_compressed_index();
+
+  bool initialize_write(std::string const& file_name);
+  //: Open a file for reading; layer_size and block_size are taken from the file
+  bool initialize_read(std::string const& file_name);
+  //: write the pending block and the offset table (in WRITE mode), close the file
+  bool finalize();
+
+  unsigned layer_size() const { return layer_size_; }
+  unsigned block_size() const { return block_size_; }
+  //: number of hypotheses in the file, or added so far
+  vxl_uint_64 size() const { return n_hyps_; }
+  unsigned n_blocks() const { return (unsigned)((n_hyps_ + block_size_ - 1) / block_size_); }
+  //: size of the file written or read, in bytes
+  vxl_uint_64 file_size() const { return file_size_; }
+  //: true if the file is read through a memory map
+  bool mapped() const { return map_ != VXL_NULLPTR; }
+
+  //: append the index of the next hypothesis, layer_size values
+  bool add_to_index(unsigned char const* values);
+  bool add_to_index(std::vector<unsigned char> const& values);
+
+  //: the index of hypothesis k, layer_size values; keeps the last decoded block
+  bool get(vxl_uint_64 k, unsigned char* values);
+  bool get(vxl_uint_64 k, std::vector<unsigned char>& values);
+
+  //: the index of the hypothesis after the last one retrieved by get or get_next
+  bool get_next(unsigned char* values);
+  bool get_next(std::vector<unsigned char>& values);
+
+  //: the indices of hypotheses first .. first+n-1, n*layer_size values, decoding blocks on several threads
+  //  num_threads = 0 uses one thread per processor
+  bool get_range(vxl_uint_64 first, unsigned n, unsigned char* values, unsigned num_threads = 0);
+
+  //: compress a volm_buffered_index file
+  static bool convert(std::string const& buffered_file, std::string const& compressed_file,
+                      unsigned layer_size, unsigned block_size = 64);
+
+  //: compress n hypotheses of layer_size values (n <= block_size), appending to out
+  static void encode_block(unsigned char const* values, unsigned n, unsigned layer_size,
+                           std::vector<unsigned char>& out);
+  //: decode a block of n hypotheses into values; returns false if the data are corrupt
+  static bool decode_block(unsigned char const* data, std::size_t len, unsigned n, unsigned layer_size,
+                           unsigned char* values, std::vector<unsigned char>& scratch);
+
+ protected:
+  unsigned layer_size_;
+  unsigned block_size_;
+  mode m_;
+  std::string file_name_;
+  vxl_uint_64 n_hyps_;
+  vxl_uint_64 file_size_;
+  //: offset of every block in the file, and of the end of the last one
+  std::vector<vxl_uint_64> offsets_;
+
+  // writing
+  std::ofstream of_obj_;
+  std::vector<unsigned char> pending_;
+  std::vector<unsigned char> encoded_;
+
+  // reading
+  std::ifstream if_obj_;
+  unsigned char const* map_;
+  vxl_uint_64 current_;
+  unsigned cached_block_;
+  std::vector<unsigned char> cache_;
+  std::vector<unsigned char> scratch_;
+  std::vector<unsigned char> staging_;
+
+  //: encode and write the pending hypotheses
+  bool flush_block();
+  //: number of hypotheses in block b
+  unsigned block_count(unsigned b) const;
+  //: the compressed bytes of block b, from the map or read into buf
+  unsigned char const* block_data(unsigned b, std::vector<unsigned char>& buf);
+  //: read len bytes at file position pos
+  bool read_at(vxl_uint_64 pos, std::size_t len, unsigned char* buf);
+  void unmap();
+
+  // not copyable
+  volm_compressed_index(volm_compressed_index const&);
+  volm_compressed_index& operator=(volm_compressed_index const&);
+};
+
+#include <vbl/vbl_smart_ptr.h>
+typedef vbl_smart_ptr<volm_compressed_index> volm_compressed_index_sptr;
+
+#endif  // volm_compressed_index_h_
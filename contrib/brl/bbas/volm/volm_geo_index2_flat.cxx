@@ -0,0 +1,418 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include "volm_geo_index2_flat.h"
+//:
+// \file
+#include "volm_geo_index2.h"
+#include <vgl/vgl_intersection.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+
+#if !(defined(VCL_WIN32) && !defined(__CYGWIN__))
+#define VOLM_GEO_INDEX2_FLAT_MMAP 1
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// file header: "VGF1", byte order mark, node size, n_nodes, n_leaves, unused, n_payload
+static const unsigned volm_gf_header_size = 32;
+static const vxl_uint_32 volm_gf_byte_order = 0x01020304;
+
+volm_geo_index2_flat::volm_geo_index2_flat()
+: n_nodes_(0), n_leaves_(0), n_payload_(0), map_(VXL_NULLPTR), map_size_(0)
+{
+  this->clear();
+}
+
+volm_geo_index2_flat::volm_geo_index2_flat(volm_geo_index2_node_sptr const& root)
+: n_nodes_(0), n_leaves_(0), n_payload_(0), map_(VXL_NULLPTR), map_size_(0)
+{
+  this->build(root);
+}
+
+volm_geo_index2_flat::~volm_geo_index2_flat()
+{
+  this->unmap();
+}
+
+void volm_geo_index2_flat::attach()
+{
+  n_nodes_ = (unsigned)node_data_.size();
+  n_leaves_ = (unsigned)leaf_node_data_.size();
+  n_payload_ = payload_data_.size();
+  nodes_ = node_data_.empty() ? VXL_NULLPTR : &node_data_[0];
+  leaf_nodes_ = leaf_node_data_.empty() ? VXL_NULLPTR : &leaf_node_data_[0];
+  payload_offset_ = &payload_offset_data_[0];
+  payload_ = payload_data_.empty() ? VXL_NULLPTR : &payload_data_[0];
+}
+
+void volm_geo_index2_flat::clear()
+{
+  this->unmap();
+  node_data_.clear();
+  leaf_node_data_.clear();
+  payload_offset_data_.assign(1, 0);
+  payload_data_.clear();
+  this->attach();
+}
+
+void volm_geo_index2_flat::unmap()
+{
+#ifdef VOLM_GEO_INDEX2_FLAT_MMAP
+  if (map_)
+    munmap(const_cast<unsigned char*>(map_), (std::size_t)map_size_);
+#endif
+  map_ = VXL_NULLPTR;
+  map_size_ = 0;
+}
+
+//: Morton quadrant of a child: bit 0 set for the right half, bit 1 for the upper half
+static unsigned volm_gf_quadrant(vgl_box_2d<double> const& parent, vgl_box_2d<double> const& child)
+{
+  vgl_point_2d<double> p = parent.centroid(), c = child.centroid();
+  return (c.x() >= p.x() ? 1u : 0u) | (c.y() >= p.y() ? 2u : 0u);
+}
+
+//: orders children by quadrant only, keeping the tree order otherwise
+struct volm_gf_first_less
+{
+  bool operator()(std::pair<unsigned, volm_geo_index2_node_base*> const& a,
+                  std::pair<unsigned, volm_geo_index2_node_base*> const& b) const
+  { return a.first < b.first; }
+};
+
+void volm_geo_index2_flat::build(volm_geo_index2_node_sptr const& root, std::vector<volm_geo_index2_node_sptr>& leaves)
+{
+  this->clear();
+  leaves.clear();
+  if (!root)
+    return;
+
+  // breadth first, so that the children of a node are contiguous
+  std::vector<volm_geo_index2_node_base*> src(1, root.ptr());
+  volm_geo_index2_flat_node r;
+  r.min_x = root->extent_.min_x();  r.min_y = root->extent_.min_y();
+  r.max_x = root->extent_.max_x();  r.max_y = root->extent_.max_y();
+  r.parent = -1;  r.first_child = -1;  r.n_children = 0;  r.leaf_id = -1;
+  node_data_.push_back(r);
+  for (std::size_t i = 0; i < src.size(); ++i) {
+    volm_geo_index2_node_base* n = src[i];
+    std::vector<std::pair<unsigned, volm_geo_index2_node_base*> > children;
+    for (unsigned c = 0; c < n->children_.size(); ++c)
+      if (n->children_[c])
+        children.push_back(std::make_pair(volm_gf_quadrant(n->extent_, n->children_[c]->extent_), n->children_[c].ptr()));
+    if (children.empty())
+      continue;
+    std::stable_sort(children.begin(), children.end(), volm_gf_first_less());
+    node_data_[i].first_child = (vxl_int_32)node_data_.size();
+    node_data_[i].n_children = (vxl_uint_32)children.size();
+    for (unsigned c = 0; c < children.size(); ++c) {
+      vgl_box_2d<double> const& e = children[c].second->extent_;
+      volm_geo_index2_flat_node cn;
+      cn.min_x = e.min_x();  cn.min_y = e.min_y();  cn.max_x = e.max_x();  cn.max_y = e.max_y();
+      cn.parent = (vxl_int_32)i;  cn.first_child = -1;  cn.n_children = 0;  cn.leaf_id = -1;
+      node_data_.push_back(cn);
+      src.push_back(children[c].second);
+    }
+  }
+
+  // number the leaves depth first, which is Morton order
+  std::vector<unsigned> stack(1, 0);
+  while (!stack.empty()) {
+    unsigned i = stack.back();
+    stack.pop_back();
+    volm_geo_index2_flat_node& n = node_data_[i];
+    if (n.first_child < 0) {
+      n.leaf_id = (vxl_int_32)leaf_node_data_.size();
+      leaf_node_data_.push_back(i);
+      leaves.push_back(src[i]);
+      continue;
+    }
+    for (unsigned c = n.n_children; c > 0; --c)
+      stack.push_back(n.first_child + c - 1);
+  }
+  payload_offset_data_.assign(leaf_node_data_.size() + 1, 0);
+  this->attach();
+}
+
+void volm_geo_index2_flat::build(volm_geo_index2_node_sptr const& root)
+{
+  std::vector<volm_geo_index2_node_sptr> leaves;
+  this->build(root, leaves);
+}
+
+bool volm_geo_index2_flat::set_payload(std::vector<std::vector<unsigned> > const& contents)
+{
+  if (map_ || contents.size() != n_leaves_)
+    return false;
+  payload_offset_data_.resize(n_leaves_ + 1);
+  payload_offset_data_[0] = 0;
+  for (unsigned i = 0; i < n_leaves_; ++i)
+    payload_offset_data_[i+1] = payload_offset_data_[i] + contents[i].size();
+  payload_data_.clear();
+  payload_data_.reserve((std::size_t)payload_offset_data_[n_leaves_]);
+  for (unsigned i = 0; i < n_leaves_; ++i)
+    payload_data_.insert(payload_data_.end(), contents[i].begin(), contents[i].end());
+  this->attach();
+  return true;
+}
+
+bool volm_geo_index2_flat::set_payload(std::vector<volm_geo_index2_node_sptr> const& leaves)
+{
+  if (leaves.size() != n_leaves_)
+    return false;
+  std::vector<std::vector<unsigned> > contents(leaves.size());
+  for (unsigned i = 0; i < leaves.size(); ++i) {
+    volm_geo_index2_node<std::vector<unsigned> >* leaf =
+      dynamic_cast<volm_geo_index2_node<std::vector<unsigned> >*>(leaves[i].ptr());
+    if (!leaf)
+      return false;
+    contents[i] = leaf->contents_;
+  }
+  return this->set_payload(contents);
+}
+
+int volm_geo_index2_flat::find_leaf(unsigned i, double x, double y) const
+{
+  volm_geo_index2_flat_node const& n = nodes_[i];
+  if (!n.contains(x, y))
+    return -1;
+  if (n.first_child < 0)
+    return n.leaf_id;
+  // a point on a border lies in several children; the first that has a leaf there wins
+  for (unsigned c = 0; c < n.n_children; ++c) {
+    int leaf = this->find_leaf(n.first_child + c, x, y);
+    if (leaf >= 0)
+      return leaf;
+  }
+  return -1;
+}
+
+int volm_geo_index2_flat::get_leaf(vgl_point_2d<double> const& point) const
+{
+  if (n_nodes_ == 0)
+    return -1;
+  return this->find_leaf(0, point.x(), point.y());
+}
+
+void volm_geo_index2_flat::get_leaves(vgl_polygon<double> const& poly, std::vector<unsigned>& leaf_ids) const
+{
+  leaf_ids.clear();
+  if (n_nodes_ == 0)
+    return;
+  // depth first with the children pushed in reverse, so that the leaves come out in Morton order
+  std::vector<unsigned> stack(1, 0);
+  while (!stack.empty()) {
+    volm_geo_index2_flat_node const& n = nodes_[stack.back()];
+    stack.pop_back();
+    if (!vgl_intersection(n.extent(), poly))
+      continue;
+    if (n.first_child < 0) {
+      leaf_ids.push_back((unsigned)n.leaf_id);
+      continue;
+    }
+    for (unsigned c = n.n_children; c > 0; --c)
+      stack.push_back(n.first_child + c - 1);
+  }
+}
+
+//: Finds the leaves of a range of points
+class volm_geo_index2_flat_point_body : public vpl_parallel_for_body
+{
+ public:
+  volm_geo_index2_flat_point_body(volm_geo_index2_flat const& tree,
+                                  std::vector<vgl_point_2d<double> > const& points,
+                                  std::vector<int>& leaf_ids)
+  : tree_(tree), points_(points), leaf_ids_(leaf_ids) {}
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned i = begin; i < end; ++i)
+      leaf_ids_[i] = tree_.get_leaf(points_[i]);
+  }
+
+ private:
+  volm_geo_index2_flat const& tree_;
+  std::vector<vgl_point_2d<double> > const& points_;
+  std::vector<int>& leaf_ids_;
+};
+
+void volm_geo_index2_flat::get_leaf(std::vector<vgl_point_2d<double> > const& points, std::vector<int>& leaf_ids,
+                                    unsigned num_threads) const
+{
+  leaf_ids.resize(points.size());
+  volm_geo_index2_flat_point_body body(*this, points, leaf_ids);
+  // a point costs little; hand them out in chunks
+  vpl_parallel_for((unsigned)points.size(), body, num_threads, 1024);
+}
+
+//: Finds the leaves of a range of polygons
+class volm_geo_index2_flat_poly_body : public vpl_parallel_for_body
+{
+ public:
+  volm_geo_index2_flat_poly_body(volm_geo_index2_flat const& tree,
+                                 std::vector<vgl_polygon<double> > const& polys,
+                                 std::vector<std::vector<unsigned> >& leaf_ids)
+  : tree_(tree), polys_(polys), leaf_ids_(leaf_ids) {}
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned i = begin; i < end; ++i)
+      tree_.get_leaves(polys_[i], leaf_ids_[i]);
+  }
+
+ private:
+  volm_geo_index2_flat const& tree_;
+  std::vector<vgl_polygon<double> > const& polys_;
+  std::vector<std::vector<unsigned> >& leaf_ids_;
+};
+
+void volm_geo_index2_flat::get_leaves(std::vector<vgl_polygon<double> > const& polys,
+                                      std::vector<std::vector<unsigned> >& leaf_ids, unsigned num_threads) const
+{
+  leaf_ids.resize(polys.size());
+  volm_geo_index2_flat_poly_body body(*this, polys, leaf_ids);
+  vpl_parallel_for((unsigned)polys.size(), body, num_threads);
+}
+
+//: size in bytes of the file holding the given arrays
+static vxl_uint_64 volm_gf_file_size(vxl_uint_64 n_nodes, vxl_uint_64 n_leaves, vxl_uint_64 n_payload)
+{
+  return volm_gf_header_size + n_nodes*sizeof(volm_geo_index2_flat_node) + 8*(n_leaves+1) + 4*n_leaves + 4*n_payload;
+}
+
+bool volm_geo_index2_flat::write(std::string const& file_name) const
+{
+  std::ofstream ofs(file_name.c_str(), std::ios::out | std::ios::binary);
+  if (!ofs.good()) {
+    std::cerr << "error: can not open " << file_name << " for writing\n";
+    return false;
+  }
+  unsigned char header[volm_gf_header_size];
+  std::memset(header, 0, volm_gf_header_size);
+  vxl_uint_32 node_size = sizeof(volm_geo_index2_flat_node);
+  std::memcpy(header, "VGF1", 4);
+  std::memcpy(header + 4, &volm_gf_byte_order, 4);
+  std::memcpy(header + 8, &node_size, 4);
+  std::memcpy(header + 12, &n_nodes_, 4);
+  std::memcpy(header + 16, &n_leaves_, 4);
+  std::memcpy(header + 24, &n_payload_, 8);
+  ofs.write((char const*)header, volm_gf_header_size);
+  // the sections follow each other at 8 byte aligned offsets: nodes, payload offsets, leaf nodes, payload
+  if (n_nodes_)
+    ofs.write((char const*)nodes_, (std::streamsize)(n_nodes_*sizeof(volm_geo_index2_flat_node)));
+  ofs.write((char const*)payload_offset_, (std::streamsize)(8*(vxl_uint_64(n_leaves_)+1)));
+  if (n_leaves_)
+    ofs.write((char const*)leaf_nodes_, (std::streamsize)(4*vxl_uint_64(n_leaves_)));
+  if (n_payload_)
+    ofs.write((char const*)payload_, (std::streamsize)(4*n_payload_));
+  return ofs.good();
+}
+
+bool volm_geo_index2_flat::read(std::string const& file_name)
+{
+  this->clear();
+  unsigned char const* data = VXL_NULLPTR;
+  vxl_uint_64 size = 0;
+  std::vector<vxl_uint_64> buffer;
+#ifdef VOLM_GEO_INDEX2_FLAT_MMAP
+  int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      void* p = mmap(VXL_NULLPTR, (std::size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+      if (p != MAP_FAILED) {
+        map_ = static_cast<unsigned char const*>(p);
+        map_size_ = (vxl_uint_64)st.st_size;
+        data = map_;
+        size = map_size_;
+      }
+    }
+    close(fd);
+  }
+#endif
+  if (!data) {
+    std::ifstream ifs(file_name.c_str(), std::ios::in | std::ios::binary);
+    if (!ifs.good()) {
+      std::cerr << "error: can not open " << file_name << '\n';
+      return false;
+    }
+    ifs.seekg(0, std::ios::end);
+    size = (vxl_uint_64)ifs.tellg();
+    ifs.seekg(0, std::ios::beg);
+    // read into 8 byte aligned storage
+    buffer.resize((std::size_t)(size/8) + 1);
+    ifs.read((char*)&buffer[0], (std::streamsize)size);
+    if (!ifs.good())
+      size = 0;
+    data = (unsigned char const*)&buffer[0];
+  }
+
+  vxl_uint_32 byte_order = 0, node_size = 0, n_nodes = 0, n_leaves = 0;
+  vxl_uint_64 n_payload = 0;
+  if (size >= volm_gf_header_size) {
+    std::memcpy(&byte_order, data + 4, 4);
+    std::memcpy(&node_size, data + 8, 4);
+    std::memcpy(&n_nodes, data + 12, 4);
+    std::memcpy(&n_leaves, data + 16, 4);
+    std::memcpy(&n_payload, data + 24, 8);
+  }
+  if (size < volm_gf_header_size || std::memcmp(data, "VGF1", 4) != 0 ||
+      byte_order != volm_gf_byte_order || node_size != sizeof(volm_geo_index2_flat_node) ||
+      n_leaves > n_nodes || size != volm_gf_file_size(n_nodes, n_leaves, n_payload)) {
+    std::cerr << "error: " << file_name << " is not a flat geo index of this platform\n";
+    this->clear();
+    return false;
+  }
+
+  unsigned char const* p = data + volm_gf_header_size;
+  volm_geo_index2_flat_node const* nodes = reinterpret_cast<volm_geo_index2_flat_node const*>(p);
+  p += vxl_uint_64(n_nodes)*sizeof(volm_geo_index2_flat_node);
+  vxl_uint_64 const* payload_offset = reinterpret_cast<vxl_uint_64 const*>(p);
+  p += 8*(vxl_uint_64(n_leaves)+1);
+  vxl_uint_32 const* leaf_nodes = reinterpret_cast<vxl_uint_32 const*>(p);
+  p += 4*vxl_uint_64(n_leaves);
+  unsigned const* payload = reinterpret_cast<unsigned const*>(p);
+
+  // check the links, so that the queries stay inside the arrays
+  bool ok = payload_offset[0] == 0 && payload_offset[n_leaves] == n_payload;
+  for (unsigned i = 0; ok && i < n_leaves; ++i)
+    ok = payload_offset[i] <= payload_offset[i+1] && leaf_nodes[i] < n_nodes &&
+         nodes[leaf_nodes[i]].leaf_id == (vxl_int_32)i;
+  for (unsigned i = 0; ok && i < n_nodes; ++i) {
+    volm_geo_index2_flat_node const& n = nodes[i];
+    if (n.first_child < 0)
+      ok = n.leaf_id >= 0 && (vxl_uint_32)n.leaf_id < n_leaves;
+    else // children come after their parent, so that a descent always ends
+      ok = (vxl_uint_32)n.first_child > i && n.n_children > 0 && n.n_children <= 4 &&
+           vxl_uint_64(n.first_child) + n.n_children <= n_nodes;
+  }
+  if (!ok) {
+    std::cerr << "error: corrupt flat geo index " << file_name << '\n';
+    this->clear();
+    return false;
+  }
+
+  if (map_) {
+    n_nodes_ = n_nodes;
+    n_leaves_ = n_leaves;
+    n_payload_ = n_payload;
+    nodes_ = nodes;
+    leaf_nodes_ = leaf_nodes;
+    payload_offset_ = payload_offset;
+    payload_ = payload;
+  }
+  else {
+    node_data_.assign(nodes, nodes + n_nodes);
+    leaf_node_data_.assign(leaf_nodes, leaf_nodes + n_leaves);
+    payload_offset_data_.assign(payload_offset, payload_offset + n_leaves + 1);
+    payload_data_.assign(payload, payload + n_payload);
+    this->attach();
+  }
+  return true;
+}
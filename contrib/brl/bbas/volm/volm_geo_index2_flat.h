@@ -0,0 +1,136 @@
+// This is brl/bbas/volm/volm_geo_index2_flat.h
+#ifndef volm_geo_index2_flat_h_
+#define volm_geo_index2_flat_h_
+//:
+// \file
+// \brief A volm_geo_index2 quadtree stored in flat arrays, for batch queries
+//
+// The nodes of a volm_geo_index2 tree are copied into one array, level by
+// level, with the (up to 4) children of a node next to each other in Morton
+// order: lower left, lower right, upper left, upper right.  A node refers to
+// its children and parent by array index, so a query walks the array without
+// smart pointer copies.  Leaves are numbered in Morton (depth first) order,
+// and leaf i owns the payload values payload_offset(i) .. payload_offset(i+1)-1
+// of one array, e.g. the hypothesis or object ids stored on the leaf.
+//
+// As in volm_geo_index2, a node whose children are all pruned is a leaf.
+// When a point lies on the border of two leaves, the first of them in
+// Morton order is returned.
+//
+// The binary file written by write() holds the same arrays, so read() maps
+// it into memory (where the platform allows it) instead of parsing it.
+// The arrays are stored in the byte order of the machine that wrote them;
+// read() rejects a file of the other byte order.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+//
+
+#include <string>
+#include <vector>
+#include <vbl/vbl_ref_count.h>
+#include <vgl/vgl_box_2d.h>
+#include <vgl/vgl_point_2d.h>
+#include <vgl/vgl_polygon.h>
+#include <vxl_config.h>
+#include <vcl_compiler.h>
+#include "volm_geo_index2_sptr.h"
+
+//: a node of the flat tree; 48 bytes, stored as is in the binary file
+struct volm_geo_index2_flat_node
+{
+  //: extent, x is lon and y is lat
+  double min_x, min_y, max_x, max_y;
+  //: index of the parent, -1 for the root
+  vxl_int_32 parent;
+  //: index of the first child, -1 for a leaf
+  vxl_int_32 first_child;
+  vxl_uint_32 n_children;
+  //: leaf id, -1 for an interior node
+  vxl_int_32 leaf_id;
+
+  vgl_box_2d<double> extent() const { return vgl_box_2d<double>(min_x, max_x, min_y, max_y); }
+  bool contains(double x, double y) const { return min_x <= x && x <= max_x && min_y <= y && y <= max_y; }
+};
+
+class volm_geo_index2_flat : public vbl_ref_count
+{
+ public:
+  volm_geo_index2_flat();
+  //: Flatten the tree at root; see build()
+  volm_geo_index2_flat(volm_geo_index2_node_sptr const& root);
+  ~volm_geo_index2_flat();
+
+  //: Flatten the tree at root, without payload.
+  //  leaves receives the leaf nodes of the tree in leaf id order.
+  void build(volm_geo_index2_node_sptr const& root, std::vector<volm_geo_index2_node_sptr>& leaves);
+  void build(volm_geo_index2_node_sptr const& root);
+
+  //: Set the payload, one vector of values per leaf in leaf id order
+  bool set_payload(std::vector<std::vector<unsigned> > const& contents);
+  //: Set the payload from the contents of the leaves returned by build(), which must be volm_geo_index2_node<std::vector<unsigned> >
+  bool set_payload(std::vector<volm_geo_index2_node_sptr> const& leaves);
+
+  unsigned n_nodes() const { return n_nodes_; }
+  unsigned n_leaves() const { return n_leaves_; }
+  volm_geo_index2_flat_node const& node(unsigned i) const { return nodes_[i]; }
+  //: the node of leaf i
+  volm_geo_index2_flat_node const& leaf_node(unsigned i) const { return nodes_[leaf_nodes_[i]]; }
+
+  //: number of payload values of leaf i, and a pointer to the first of them
+  unsigned payload_size(unsigned i) const { return (unsigned)(payload_offset_[i+1] - payload_offset_[i]); }
+  unsigned const* payload(unsigned i) const { return payload_ + payload_offset_[i]; }
+
+  //: the id of the leaf that contains the point, -1 if it is outside the tree or in a pruned area
+  int get_leaf(vgl_point_2d<double> const& point) const;
+  //: the leaves of a batch of points, computed on several threads (num_threads = 0 uses one per processor)
+  void get_leaf(std::vector<vgl_point_2d<double> > const& points, std::vector<int>& leaf_ids,
+                unsigned num_threads = 0) const;
+
+  //: the ids of the leaves that intersect the polygon, in increasing order
+  void get_leaves(vgl_polygon<double> const& poly, std::vector<unsigned>& leaf_ids) const;
+  //: the leaves of a batch of polygons, computed on several threads
+  void get_leaves(std::vector<vgl_polygon<double> > const& polys, std::vector<std::vector<unsigned> >& leaf_ids,
+                  unsigned num_threads = 0) const;
+
+  //: write the arrays to a binary file
+  bool write(std::string const& file_name) const;
+  //: read a file written by write(), memory mapping it if possible
+  bool read(std::string const& file_name);
+  //: true if the arrays are in a memory mapped file
+  bool mapped() const { return map_ != VXL_NULLPTR; }
+
+ private:
+  unsigned n_nodes_;
+  unsigned n_leaves_;
+  vxl_uint_64 n_payload_;
+  // the arrays, pointing either into the vectors below or into the mapped file
+  volm_geo_index2_flat_node const* nodes_;
+  vxl_uint_32 const* leaf_nodes_;
+  vxl_uint_64 const* payload_offset_;
+  unsigned const* payload_;
+
+  std::vector<volm_geo_index2_flat_node> node_data_;
+  std::vector<vxl_uint_32> leaf_node_data_;
+  std::vector<vxl_uint_64> payload_offset_data_;
+  std::vector<unsigned> payload_data_;
+
+  unsigned char const* map_;
+  vxl_uint_64 map_size_;
+
+  //: point the arrays at the vectors
+  void attach();
+  void clear();
+  void unmap();
+  int find_leaf(unsigned n, double x, double y) const;
+
+  // not copyable
+  volm_geo_index2_flat(volm_geo_index2_flat const&);
+  volm_geo_index2_flat& operator=(volm_geo_index2_flat const&);
+};
+
+#include <vbl/vbl_smart_ptr.h>
+typedef vbl_smart_ptr<volm_geo_index2_flat> volm_geo_index2_flat_sptr;
+
+#endif // volm_geo_index2_flat_h_
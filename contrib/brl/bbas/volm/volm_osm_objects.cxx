@@ -3,6 +3,7 @@
 #include "volm_osm_objects.h"
 //:
 // \file
+#include "volm_osm_stream_parser.h"
 #include <vul/vul_file.h>
 #include <bkml/bkml_write.h>
 #include <vcl_compiler.h>
@@ -14,18 +15,14 @@ volm_osm_objects::volm_osm_objects(std::string const& osm_file, std::string cons
   std::map<std::pair<std::string, std::string>, volm_land_layer> osm_land_table;
   volm_osm_category_io::load_category_table(osm_to_volm_file, osm_land_table);
 
-  // load all open street map objects from
+  // load all open street map objects from the file in a single pass
   std::vector<vgl_point_2d<double> > osm_pts;
   std::vector<std::vector<std::pair<std::string, std::string> > > osm_pt_keys;
-  volm_osm_parser::parse_points(osm_pts, osm_pt_keys, osm_file);
-
   std::vector<std::vector<vgl_point_2d<double> > > osm_lines;
   std::vector<std::vector<std::pair<std::string, std::string> > > osm_line_keys;
-  volm_osm_parser::parse_lines(osm_lines, osm_line_keys, osm_file);
-
   std::vector<vgl_polygon<double> > osm_polys;
   std::vector<std::vector<std::pair<std::string, std::string> > > osm_poly_keys;
-  volm_osm_parser::parse_polygons(osm_polys, osm_poly_keys, osm_file);
+  volm_osm_stream_parser::parse_objects(osm_file, osm_pts, osm_pt_keys, osm_lines, osm_line_keys, osm_polys, osm_poly_keys);
 
   // transfer osm objects to volm_osm_objects (ignore the osm objects whose properties is not defined in osm_to_volm table)
   std::map<std::pair<std::string, std::string>, volm_land_layer>::iterator mit;
@@ -96,4 +96,12 @@ private:
 
 };
 
+//: compose the polygon of a relation from its ways \p way_ids, whose node lists are in \p ways
+//  Returns false if the ways do not form closed sheets or a node is missing from \p nodes.
+bool compose_polygon_from_relation(vgl_box_2d<double> const& osm_bbox,
+                                   std::map<unsigned long long, vgl_point_2d<double> >& nodes,
+                                   std::vector<std::pair<unsigned long long, std::vector<unsigned long long> > > ways,
+                                   std::vector<unsigned long long>& way_ids,
+                                   vgl_polygon<double>& poly);
+
 #endif // volm_osm_parser_h_
@@ -0,0 +1,437 @@
+// This is brl/bbas/volm/volm_osm_stream_parser.cxx
+#include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "volm_osm_stream_parser.h"
+//:
+// \file
+#include "volm_osm_parser.h"
+#include <vcl_compiler.h>
+
+//: the numbers in osm attributes, without the cost of a stringstream per value
+static unsigned long long parse_id(const char* s)
+{
+  return std::strtoull(s, VXL_NULLPTR, 10);
+}
+
+static double parse_double(const char* s)
+{
+  return std::strtod(s, VXL_NULLPTR);
+}
+
+unsigned volm_osm_string_table::intern(const char* s)
+{
+  std::pair<std::map<std::string, unsigned>::iterator, bool> ins =
+    ids_.insert(std::pair<std::string, unsigned>(std::string(s), (unsigned)strings_.size()));
+  if (ins.second)
+    strings_.push_back(ins.first->first);
+  return ins.first->second;
+}
+
+int volm_osm_string_table::find(std::string const& s) const
+{
+  std::map<std::string, unsigned>::const_iterator mit = ids_.find(s);
+  return mit == ids_.end() ? -1 : int(mit->second);
+}
+
+std::vector<vgl_point_2d<double> > volm_osm_stream_objects::line(unsigned o) const
+{
+  unsigned s = sheet_offsets_[o];
+  return std::vector<vgl_point_2d<double> >(coords_.begin() + coord_offsets_[s], coords_.begin() + coord_offsets_[s+1]);
+}
+
+vgl_polygon<double> volm_osm_stream_objects::polygon(unsigned o) const
+{
+  vgl_polygon<double> poly;
+  for (unsigned s = sheet_offsets_[o]; s < sheet_offsets_[o+1]; ++s) {
+    poly.new_sheet();
+    for (unsigned c = coord_offsets_[s]; c < coord_offsets_[s+1]; ++c)
+      poly.push_back(coords_[c]);
+  }
+  return poly;
+}
+
+std::vector<std::pair<std::string, std::string> >
+volm_osm_stream_objects::tags(unsigned o, volm_osm_string_table const& strings) const
+{
+  std::vector<std::pair<std::string, std::string> > keys;
+  for (unsigned t = tag_offsets_[o]; t < tag_offsets_[o+1]; ++t)
+    keys.push_back(std::pair<std::string, std::string>(strings.str(tags_[t].first), strings.str(tags_[t].second)));
+  return keys;
+}
+
+vgl_box_2d<double> volm_osm_stream_objects::bounding_box(unsigned o) const
+{
+  vgl_box_2d<double> box;
+  unsigned c_end = coord_offsets_[sheet_offsets_[o+1]];
+  for (unsigned c = coord_offsets_[sheet_offsets_[o]]; c < c_end; ++c)
+    box.add(coords_[c]);
+  return box;
+}
+
+void volm_osm_stream_objects::begin_object(object_type type, unsigned long long osm_id)
+{
+  types_.push_back((unsigned char)type);
+  ids_.push_back(osm_id);
+}
+
+void volm_osm_stream_objects::end_object()
+{
+  sheet_offsets_.push_back((unsigned)coord_offsets_.size()-1);
+  tag_offsets_.push_back((unsigned)tags_.size());
+}
+
+void volm_osm_stream_objects::clear()
+{
+  types_.clear();  ids_.clear();  coords_.clear();  tags_.clear();
+  sheet_offsets_.assign(1, 0);
+  coord_offsets_.assign(1, 0);
+  tag_offsets_.assign(1, 0);
+}
+
+void volm_osm_stream_objects::swap(volm_osm_stream_objects& that)
+{
+  types_.swap(that.types_);
+  ids_.swap(that.ids_);
+  sheet_offsets_.swap(that.sheet_offsets_);
+  coord_offsets_.swap(that.coord_offsets_);
+  coords_.swap(that.coords_);
+  tag_offsets_.swap(that.tag_offsets_);
+  tags_.swap(that.tags_);
+}
+
+volm_osm_stream_parser::volm_osm_stream_parser(volm_osm_stream_handler* handler, unsigned batch_size)
+: handler_(handler), batch_size_(batch_size > 0 ? batch_size : 1),
+  current_(NONE), current_id_(0), has_type_(false), n_sorted_nodes_(0), n_relations_(0)
+{
+  way_offsets_.push_back(0);
+}
+
+void volm_osm_stream_parser::startElement(const XML_Char* name, const XML_Char** atts)
+{
+  if (!atts)
+    return;
+  if (std::strcmp(name, OSM_NODE) == 0) {
+    node_loc n;
+    n.id = 0;
+    double lon = 0.0, lat = 0.0;
+    for (unsigned i = 0; atts[i]; i+=2) {
+      if (std::strcmp(atts[i], "id") == 0)
+        n.id = parse_id(atts[i+1]);
+      else if (std::strcmp(atts[i], "lat") == 0)
+        lat = parse_double(atts[i+1]);
+      else if (std::strcmp(atts[i], "lon") == 0)
+        lon = parse_double(atts[i+1]);
+    }
+    n.loc.set(lon, lat);
+    if (n_sorted_nodes_ == nodes_.size() && (nodes_.empty() || nodes_.back().id <= n.id))
+      ++n_sorted_nodes_;
+    nodes_.push_back(n);
+    current_ = NODE;  current_id_ = n.id;
+    current_tags_.clear();
+  }
+  else if (std::strcmp(name, OSM_WAY) == 0 || std::strcmp(name, OSM_RELATION) == 0) {
+    current_id_ = 0;
+    for (unsigned i = 0; atts[i]; i+=2)
+      if (std::strcmp(atts[i], "id") == 0)
+        current_id_ = parse_id(atts[i+1]);
+    current_ = std::strcmp(name, OSM_WAY) == 0 ? WAY : RELATION;
+    current_tags_.clear();  current_refs_.clear();  current_members_.clear();
+    has_type_ = false;
+  }
+  else if (std::strcmp(name, OSM_WAY_ND) == 0) {
+    if (current_ != WAY)
+      return;
+    for (unsigned i = 0; atts[i]; i+=2)
+      if (std::strcmp(atts[i], "ref") == 0)
+        current_refs_.push_back(parse_id(atts[i+1]));
+  }
+  else if (std::strcmp(name, OSM_RELATION_MEM) == 0) {
+    if (current_ != RELATION)
+      return;
+    // only the ways are used to compose polygons
+    bool is_way = false;
+    unsigned long long ref = 0;
+    for (unsigned i = 0; atts[i]; i+=2) {
+      if (std::strcmp(atts[i], "type") == 0)
+        is_way = std::strcmp(atts[i+1], "way") == 0;
+      else if (std::strcmp(atts[i], "ref") == 0)
+        ref = parse_id(atts[i+1]);
+    }
+    if (is_way)
+      current_members_.push_back(ref);
+  }
+  else if (std::strcmp(name, OSM_TAG) == 0) {
+    if (current_ == NONE)
+      return;
+    const char* key = "";
+    const char* value = "";
+    for (unsigned i = 0; atts[i]; i+=2) {
+      if (std::strcmp(atts[i], "k") == 0)
+        key = atts[i+1];
+      else if (std::strcmp(atts[i], "v") == 0)
+        value = atts[i+1];
+    }
+    // the type of a relation is not one of its tags, and the first one counts
+    if (current_ == RELATION && std::strcmp(key, "type") == 0) {
+      if (!has_type_) {
+        current_type_ = value;  has_type_ = true;
+      }
+      return;
+    }
+    current_tags_.push_back(std::pair<unsigned, unsigned>(strings_.intern(key), strings_.intern(value)));
+  }
+  else if (std::strcmp(name, OSM_BOUND) == 0) {
+    double min_lon = 0.0, min_lat = 0.0, max_lon = 0.0, max_lat = 0.0;
+    for (unsigned i = 0; atts[i]; i+=2) {
+      if (std::strcmp(atts[i], "minlat") == 0)
+        min_lat = parse_double(atts[i+1]);
+      else if (std::strcmp(atts[i], "minlon") == 0)
+        min_lon = parse_double(atts[i+1]);
+      else if (std::strcmp(atts[i], "maxlat") == 0)
+        max_lat = parse_double(atts[i+1]);
+      else if (std::strcmp(atts[i], "maxlon") == 0)
+        max_lon = parse_double(atts[i+1]);
+    }
+    bbox_.set_min_point(vgl_point_2d<double>(min_lon, min_lat));
+    bbox_.set_max_point(vgl_point_2d<double>(max_lon, max_lat));
+  }
+}
+
+void volm_osm_stream_parser::endElement(const XML_Char* name)
+{
+  if (current_ == NODE && std::strcmp(name, OSM_NODE) == 0)
+    this->end_node();
+  else if (current_ == WAY && std::strcmp(name, OSM_WAY) == 0)
+    this->end_way();
+  else if (current_ == RELATION && std::strcmp(name, OSM_RELATION) == 0)
+    this->end_relation();
+  else
+    return;
+  current_ = NONE;
+  this->flush(false);
+}
+
+bool volm_osm_stream_parser::find_node(unsigned long long id, vgl_point_2d<double>& p)
+{
+  if (n_sorted_nodes_ < nodes_.size()) {
+    // merge the nodes that came out of order; both sorts are stable, so the first of equal ids stays first
+    std::vector<node_loc>::iterator mid = nodes_.begin() + n_sorted_nodes_;
+    std::stable_sort(mid, nodes_.end(), node_id_less);
+    std::inplace_merge(nodes_.begin(), mid, nodes_.end(), node_id_less);
+    n_sorted_nodes_ = (unsigned)nodes_.size();
+  }
+  node_loc key;
+  key.id = id;
+  std::vector<node_loc>::const_iterator it = std::lower_bound(nodes_.begin(), nodes_.end(), key, node_id_less);
+  if (it == nodes_.end() || it->id != id)
+    return false;
+  p = it->loc;
+  return true;
+}
+
+//: orders way indices by the ids of the ways
+class volm_osm_way_id_less
+{
+ public:
+  volm_osm_way_id_less(std::vector<unsigned long long> const& ids) : ids_(ids) {}
+  bool operator()(unsigned a, unsigned b) const { return ids_[a] < ids_[b]; }
+ private:
+  std::vector<unsigned long long> const& ids_;
+};
+
+bool volm_osm_stream_parser::find_way(unsigned long long id, unsigned& begin, unsigned& end)
+{
+  volm_osm_way_id_less less(way_ids_);
+  unsigned n_sorted = (unsigned)way_order_.size();
+  if (n_sorted < way_ids_.size()) {
+    for (unsigned w = n_sorted; w < way_ids_.size(); ++w)
+      way_order_.push_back(w);
+    std::stable_sort(way_order_.begin() + n_sorted, way_order_.end(), less);
+    std::inplace_merge(way_order_.begin(), way_order_.begin() + n_sorted, way_order_.end(), less);
+  }
+  // binary search of the way ids through the order
+  unsigned lo = 0, hi = (unsigned)way_order_.size();
+  while (lo < hi) {
+    unsigned mid = (lo + hi)/2;
+    if (way_ids_[way_order_[mid]] < id) lo = mid+1;
+    else                                hi = mid;
+  }
+  if (lo == way_order_.size() || way_ids_[way_order_[lo]] != id)
+    return false;
+  begin = way_offsets_[way_order_[lo]];
+  end = way_offsets_[way_order_[lo]+1];
+  return true;
+}
+
+void volm_osm_stream_parser::end_node()
+{
+  if (current_tags_.empty())
+    return;
+  objects_.begin_object(volm_osm_stream_objects::POINT, current_id_);
+  objects_.new_sheet();
+  objects_.push_back(nodes_.back().loc);
+  for (unsigned t = 0; t < current_tags_.size(); ++t)
+    objects_.add_tag(current_tags_[t].first, current_tags_[t].second);
+  objects_.end_object();
+}
+
+void volm_osm_stream_parser::end_way()
+{
+  // keep the node list for the relations
+  way_ids_.push_back(current_id_);
+  way_refs_.insert(way_refs_.end(), current_refs_.begin(), current_refs_.end());
+  way_offsets_.push_back((unsigned)way_refs_.size());
+
+  if (current_tags_.empty())
+    return;
+  unsigned n = (unsigned)current_refs_.size();
+  if (n > 1 && current_refs_.front() != current_refs_.back()) {
+    // a polyline, skipping the nodes that are not in the file
+    objects_.begin_object(volm_osm_stream_objects::LINE, current_id_);
+    objects_.new_sheet();
+    vgl_point_2d<double> p;
+    for (unsigned i = 0; i < n; ++i)
+      if (this->find_node(current_refs_[i], p))
+        objects_.push_back(p);
+  }
+  else if (n > 2 && current_refs_.front() == current_refs_.back()) {
+    // an enclosed polygon sheet, which is ignored if one of its nodes is missing
+    std::vector<vgl_point_2d<double> > sheet(n-1);
+    for (unsigned i = 0; i < n-1; ++i)
+      if (!this->find_node(current_refs_[i], sheet[i]))
+        return;
+    objects_.begin_object(volm_osm_stream_objects::POLYGON, current_id_);
+    objects_.new_sheet();
+    for (unsigned i = 0; i < n-1; ++i)
+      objects_.push_back(sheet[i]);
+  }
+  else
+    return;
+  for (unsigned t = 0; t < current_tags_.size(); ++t)
+    objects_.add_tag(current_tags_[t].first, current_tags_[t].second);
+  objects_.end_object();
+}
+
+void volm_osm_stream_parser::end_relation()
+{
+  ++n_relations_;
+  if (!has_type_ || (current_type_ != "boundary" && current_type_ != "multipolygon"))
+    return;
+  // the relation is ignored if one of its ways is not in the file
+  std::vector<std::pair<unsigned long long, std::vector<unsigned long long> > > ways;
+  std::map<unsigned long long, vgl_point_2d<double> > nodes;
+  for (unsigned m = 0; m < current_members_.size(); ++m) {
+    unsigned begin, end;
+    if (!this->find_way(current_members_[m], begin, end))
+      return;
+    std::vector<unsigned long long> refs(way_refs_.begin() + begin, way_refs_.begin() + end);
+    vgl_point_2d<double> p;
+    for (unsigned i = 0; i < refs.size(); ++i)
+      if (this->find_node(refs[i], p))
+        nodes[refs[i]] = p;
+    ways.push_back(std::pair<unsigned long long, std::vector<unsigned long long> >(current_members_[m], refs));
+  }
+  vgl_polygon<double> poly;
+  if (!compose_polygon_from_relation(bbox_, nodes, ways, current_members_, poly))
+    return;
+  objects_.begin_object(volm_osm_stream_objects::RELATION_POLYGON, current_id_);
+  for (unsigned s = 0; s < poly.num_sheets(); ++s) {
+    objects_.new_sheet();
+    for (unsigned i = 0; i < poly[s].size(); ++i)
+      objects_.push_back(poly[s][i]);
+  }
+  for (unsigned t = 0; t < current_tags_.size(); ++t)
+    objects_.add_tag(current_tags_[t].first, current_tags_[t].second);
+  objects_.end_object();
+}
+
+void volm_osm_stream_parser::flush(bool force)
+{
+  if (!handler_ || objects_.empty())
+    return;
+  if (force || objects_.size() >= batch_size_) {
+    handler_->add_objects(objects_, strings_);
+    objects_.clear();
+  }
+}
+
+bool volm_osm_stream_parser::parse(std::string const& osm_file, unsigned block_size)
+{
+  std::FILE* xml_file = std::fopen(osm_file.c_str(), "rb");
+  if (!xml_file) {
+    std::cerr << " can not find osm file to parse: " << osm_file << '\n';
+    return false;
+  }
+  std::vector<char> buf(block_size > 0 ? block_size : 1);
+  bool good = true;
+  bool done = false;
+  while (!done) {
+    std::size_t len = std::fread(&buf[0], 1, buf.size(), xml_file);
+    done = len < buf.size();
+    if (this->XML_Parse(&buf[0], (int)len, done) == XML_STATUS_ERROR) {
+      std::cerr << XML_ErrorString(this->XML_GetErrorCode()) << " at line " << this->XML_GetCurrentLineNumber()
+                << " of osm file " << osm_file << '\n';
+      good = false;
+      break;
+    }
+  }
+  std::fclose(xml_file);
+  this->flush(true);
+  if (handler_)
+    handler_->end_of_stream();
+  return good;
+}
+
+//: orders object indices by kind and osm id, i.e. the order of volm_osm_parser
+class volm_osm_object_less
+{
+ public:
+  volm_osm_object_less(volm_osm_stream_objects const& objs) : objs_(objs) {}
+  bool operator()(unsigned a, unsigned b) const
+  {
+    if (objs_.type(a) != objs_.type(b))
+      return objs_.type(a) < objs_.type(b);
+    return objs_.osm_id(a) < objs_.osm_id(b);
+  }
+ private:
+  volm_osm_stream_objects const& objs_;
+};
+
+bool volm_osm_stream_parser::parse_objects(std::string const& osm_file,
+                                           std::vector<vgl_point_2d<double> >& points,
+                                           std::vector<std::vector<std::pair<std::string, std::string> > >& point_keys,
+                                           std::vector<std::vector<vgl_point_2d<double> > >& lines,
+                                           std::vector<std::vector<std::pair<std::string, std::string> > >& line_keys,
+                                           std::vector<vgl_polygon<double> >& polys,
+                                           std::vector<std::vector<std::pair<std::string, std::string> > >& poly_keys)
+{
+  volm_osm_stream_parser parser;
+  bool good = parser.parse(osm_file);
+  volm_osm_stream_objects const& objs = parser.objects();
+  std::vector<unsigned> order(objs.size());
+  for (unsigned o = 0; o < objs.size(); ++o)
+    order[o] = o;
+  std::stable_sort(order.begin(), order.end(), volm_osm_object_less(objs));
+  for (unsigned k = 0; k < order.size(); ++k) {
+    unsigned o = order[k];
+    switch (objs.type(o))
+    {
+     case volm_osm_stream_objects::POINT:
+      points.push_back(objs.point(o));
+      point_keys.push_back(objs.tags(o, parser.strings()));
+      break;
+     case volm_osm_stream_objects::LINE:
+      lines.push_back(objs.line(o));
+      line_keys.push_back(objs.tags(o, parser.strings()));
+      break;
+     default:
+      polys.push_back(objs.polygon(o));
+      poly_keys.push_back(objs.tags(o, parser.strings()));
+      break;
+    }
+  }
+  return good;
+}
@@ -0,0 +1,231 @@
+// This is brl/bbas/volm/volm_osm_stream_parser.h
+#ifndef volm_osm_stream_parser_h_
+#define volm_osm_stream_parser_h_
+//:
+// \file
+// \brief A single pass, streaming parser for open street map xml files
+//
+//  volm_osm_parser keeps every node, way and relation of the file in
+//  std::maps of strings and vectors, and each of its parse_* functions
+//  reads the whole file again (into a 1 GB buffer).  The stream parser
+//  reads the file once in small blocks and emits each point, line and
+//  polygon as soon as its element closes.  The objects go into flat arrays
+//  (volm_osm_stream_objects) whose tags are ids into a table of interned
+//  strings, and are handed over in batches to a volm_osm_stream_handler,
+//  e.g. volm_osm_tile_rasterizer, while the rest of the file is parsed.
+//
+//  The objects are those of volm_osm_parser: tagged nodes are points;
+//  tagged, open ways of more than one node are lines; tagged, closed ways
+//  of more than two nodes are polygons, as are relations of type
+//  "boundary" or "multipolygon" whose ways compose closed sheets.  Only the
+//  node co-ordinates and the node lists of the ways are kept while parsing,
+//  in flat sorted arrays.  As in files written by the OSM API and osmosis,
+//  nodes are expected before the ways that use them, and ways before the
+//  relations; references to later elements are treated as missing.
+//
+// \verbatim
+//  Modifications
+//   None
+// \endverbatim
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <expatpplib.h>
+#include <vcl_compiler.h>
+#include <vgl/vgl_point_2d.h>
+#include <vgl/vgl_polygon.h>
+#include <vgl/vgl_box_2d.h>
+
+//: A table of interned strings, each stored once and referred to by id
+class volm_osm_string_table
+{
+ public:
+  volm_osm_string_table() {}
+
+  //: the id of \p s, added to the table if it is new
+  unsigned intern(const char* s);
+  unsigned intern(std::string const& s) { return this->intern(s.c_str()); }
+
+  //: the id of \p s, or -1 if it is not in the table
+  int find(std::string const& s) const;
+
+  //: the string of \p id
+  std::string const& str(unsigned id) const { return strings_[id]; }
+
+  unsigned size() const { return (unsigned)strings_.size(); }
+
+  void clear() { ids_.clear();  strings_.clear(); }
+
+ private:
+  std::map<std::string, unsigned> ids_;
+  std::vector<std::string> strings_;
+};
+
+//: Points, lines and polygons parsed from osm, in flat arrays
+//  Object o has sheets [sheet_begin(o), sheet_end(o)) and sheet s has the
+//  points [coord_begin(s), coord_end(s)) of coords(); a point has one sheet
+//  of one point and a line one sheet.  The tags of object o are the
+//  (key, value) string ids [tag_begin(o), tag_end(o)) of tags().
+class volm_osm_stream_objects
+{
+ public:
+  //: the kind of an object; polygons composed from relations are kept apart from those of closed ways
+  enum object_type { POINT = 0, LINE = 1, POLYGON = 2, RELATION_POLYGON = 3 };
+
+  volm_osm_stream_objects() { this->clear(); }
+
+  unsigned size() const { return (unsigned)types_.size(); }
+  bool empty() const { return types_.empty(); }
+
+  object_type type(unsigned o) const { return object_type(types_[o]); }
+  bool is_polygon(unsigned o) const { return types_[o] >= POLYGON; }
+  //: the osm id of the node, way or relation the object came from
+  unsigned long long osm_id(unsigned o) const { return ids_[o]; }
+
+  unsigned sheet_begin(unsigned o) const { return sheet_offsets_[o]; }
+  unsigned sheet_end(unsigned o) const { return sheet_offsets_[o+1]; }
+  unsigned coord_begin(unsigned s) const { return coord_offsets_[s]; }
+  unsigned coord_end(unsigned s) const { return coord_offsets_[s+1]; }
+  std::vector<vgl_point_2d<double> > const& coords() const { return coords_; }
+
+  unsigned tag_begin(unsigned o) const { return tag_offsets_[o]; }
+  unsigned tag_end(unsigned o) const { return tag_offsets_[o+1]; }
+  std::vector<std::pair<unsigned, unsigned> > const& tags() const { return tags_; }
+
+  //: the location of a point object (x = lon, y = lat)
+  vgl_point_2d<double> const& point(unsigned o) const { return coords_[coord_offsets_[sheet_offsets_[o]]]; }
+  //: the points of a line object
+  std::vector<vgl_point_2d<double> > line(unsigned o) const;
+  //: the sheets of a polygon object
+  vgl_polygon<double> polygon(unsigned o) const;
+  //: the tags of object o as strings
+  std::vector<std::pair<std::string, std::string> > tags(unsigned o, volm_osm_string_table const& strings) const;
+  //: the bounding box of object o
+  vgl_box_2d<double> bounding_box(unsigned o) const;
+
+  //: start a new object; add its sheets, points and tags, then call end_object()
+  void begin_object(object_type type, unsigned long long osm_id);
+  void new_sheet() { coord_offsets_.push_back((unsigned)coords_.size()); }
+  void push_back(vgl_point_2d<double> const& p) { coords_.push_back(p);  coord_offsets_.back() = (unsigned)coords_.size(); }
+  void add_tag(unsigned key, unsigned value) { tags_.push_back(std::pair<unsigned, unsigned>(key, value)); }
+  void end_object();
+
+  //: remove all objects, keeping the allocated storage for reuse
+  void clear();
+  void swap(volm_osm_stream_objects& that);
+
+ private:
+  std::vector<unsigned char> types_;
+  std::vector<unsigned long long> ids_;
+  std::vector<unsigned> sheet_offsets_;
+  std::vector<unsigned> coord_offsets_;
+  std::vector<vgl_point_2d<double> > coords_;
+  std::vector<unsigned> tag_offsets_;
+  std::vector<std::pair<unsigned, unsigned> > tags_;
+};
+
+//: Receives the objects of a volm_osm_stream_parser in batches
+class volm_osm_stream_handler
+{
+ public:
+  virtual ~volm_osm_stream_handler() {}
+
+  //: the next batch of objects, in the order of the file
+  //  The handler may keep the objects by swapping \p batch with its own
+  //  (cleared) volm_osm_stream_objects; the parser clears \p batch on return.
+  //  The string table only grows, so the tag ids remain valid.
+  virtual void add_objects(volm_osm_stream_objects& batch, volm_osm_string_table const& strings) = 0;
+
+  //: called once after the last batch
+  virtual void end_of_stream() {}
+};
+
+class volm_osm_stream_parser : public expatpp
+{
+ public:
+  //: a parser that passes objects to \p handler every \p batch_size objects, or keeps all of them if there is no handler
+  volm_osm_stream_parser(volm_osm_stream_handler* handler = VXL_NULLPTR, unsigned batch_size = 4096);
+  ~volm_osm_stream_parser() {}
+
+  //: parse \p osm_file, reading \p block_size bytes at a time
+  //  Returns false if the file can not be opened or is not well formed xml.
+  bool parse(std::string const& osm_file, unsigned block_size = 1<<20);
+
+  //: the objects not yet handed to the handler (all of them if there is none)
+  volm_osm_stream_objects& objects() { return objects_; }
+  volm_osm_string_table const& strings() const { return strings_; }
+
+  //: boundary of the osm file
+  vgl_box_2d<double> const& bbox() const { return bbox_; }
+
+  unsigned long long num_nodes() const { return (unsigned long long)nodes_.size(); }
+  unsigned long long num_ways() const { return (unsigned long long)way_ids_.size(); }
+  unsigned long long num_relations() const { return n_relations_; }
+
+  //: parse all the points, lines and polygons of \p osm_file in one pass
+  //  The objects and their tags are those of volm_osm_parser::parse_points(),
+  //  parse_lines() and parse_polygons(), in the same order.
+  static bool parse_objects(std::string const& osm_file,
+                            std::vector<vgl_point_2d<double> >& points,
+                            std::vector<std::vector<std::pair<std::string, std::string> > >& point_keys,
+                            std::vector<std::vector<vgl_point_2d<double> > >& lines,
+                            std::vector<std::vector<std::pair<std::string, std::string> > >& line_keys,
+                            std::vector<vgl_polygon<double> >& polys,
+                            std::vector<std::vector<std::pair<std::string, std::string> > >& poly_keys);
+
+ private:
+  virtual void startElement(const XML_Char* name, const XML_Char** atts);
+  virtual void endElement(const XML_Char* name);
+  virtual void charData(const XML_Char* s, int len) {}
+
+  //: the element being parsed
+  enum element { NONE, NODE, WAY, RELATION };
+
+  //: find the location of a node, false if it has not been seen
+  bool find_node(unsigned long long id, vgl_point_2d<double>& p);
+  //: find the node list [begin, end) of a way in way_refs_, false if it has not been seen
+  bool find_way(unsigned long long id, unsigned& begin, unsigned& end);
+
+  void end_node();
+  void end_way();
+  void end_relation();
+  //: pass the objects to the handler once there are enough of them
+  void flush(bool force);
+
+  volm_osm_stream_handler* handler_;
+  unsigned batch_size_;
+  volm_osm_stream_objects objects_;
+  volm_osm_string_table strings_;
+  vgl_box_2d<double> bbox_;
+
+  // the element being parsed and its tags
+  element current_;
+  unsigned long long current_id_;
+  std::vector<std::pair<unsigned, unsigned> > current_tags_;
+  std::vector<unsigned long long> current_refs_;
+  std::vector<unsigned long long> current_members_;
+  std::string current_type_;
+  bool has_type_;
+
+  //: the location of a node
+  struct node_loc
+  {
+    unsigned long long id;
+    vgl_point_2d<double> loc;
+  };
+  static bool node_id_less(node_loc const& a, node_loc const& b) { return a.id < b.id; }
+
+  // locations of all nodes; the first n_sorted_nodes_ are sorted by id
+  std::vector<node_loc> nodes_;
+  unsigned n_sorted_nodes_;
+  // node lists of all ways in the order of the file, and the ways ordered by id
+  std::vector<unsigned long long> way_ids_;
+  std::vector<unsigned> way_offsets_;
+  std::vector<unsigned long long> way_refs_;
+  std::vector<unsigned> way_order_;
+  unsigned long long n_relations_;
+};
+
+#endif // volm_osm_stream_parser_h_
@@ -0,0 +1,272 @@
+// This is brl/bbas/volm/volm_osm_tile_rasterizer.cxx
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "volm_osm_tile_rasterizer.h"
+//:
+// \file
+#include "volm_io_tools.h"
+#include <vgl/vgl_polygon_scan_iterator.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+
+#if VXL_HAS_PTHREAD_H
+#include <pthread.h>
+#endif
+
+volm_osm_tile_rasterizer::volm_osm_tile_rasterizer(std::vector<volm_tile> const& tiles,
+                                                   std::map<std::pair<std::string, std::string>, volm_land_layer> const& osm_land_table,
+                                                   unsigned n_threads)
+: osm_land_table_(osm_land_table), n_threads_(n_threads), n_classified_(0), running_(false)
+{
+  unsigned n = (unsigned)tiles.size();
+  labels_.resize(n);  levels_.resize(n);
+  road_labels_.resize(n);  road_levels_.resize(n);  points_.resize(n);
+  geo_to_img_.resize(6*n);  meters_per_pixel_.resize(n);
+  for (unsigned t = 0; t < n; ++t) {
+    volm_tile tile = tiles[t];
+    labels_[t].set_size(tile.ni(), tile.nj());  labels_[t].fill(0);
+    levels_[t].set_size(tile.ni(), tile.nj());  levels_[t].fill(0);
+    road_labels_[t].set_size(tile.ni(), tile.nj());  road_labels_[t].fill(0);
+    road_levels_[t].set_size(tile.ni(), tile.nj());  road_levels_[t].fill(0);
+    // the tile camera is affine; invert lon = l0 + l1*i + l2*j, lat = b0 + b1*i + b2*j once, so drawing needs no camera
+    unsigned si = tile.ni() > 1 ? tile.ni()-1 : 1, sj = tile.nj() > 1 ? tile.nj()-1 : 1;
+    double lon0, lat0, lon_i, lat_i, lon_j, lat_j;
+    tile.img_to_global(0, 0, lon0, lat0);
+    tile.img_to_global(si, 0, lon_i, lat_i);
+    tile.img_to_global(0, sj, lon_j, lat_j);
+    double l1 = (lon_i-lon0)/si, l2 = (lon_j-lon0)/sj;
+    double b1 = (lat_i-lat0)/si, b2 = (lat_j-lat0)/sj;
+    double det = l1*b2 - l2*b1;
+    double* a = &geo_to_img_[6*t];
+    // as in volm_tile::global_to_img(), pixel i covers [i, i+1)
+    a[1] =  b2/det;  a[2] = -l2/det;  a[0] = -a[1]*lon0 - a[2]*lat0;
+    a[4] = -b1/det;  a[5] =  l1/det;  a[3] = -a[4]*lon0 - a[5]*lat0;
+    meters_per_pixel_[t] = 0.5*(tile.calculate_width()/si + tile.calculate_height()/sj);
+  }
+#if VXL_HAS_PTHREAD_H
+  thread_ = new pthread_t;
+#endif
+}
+
+volm_osm_tile_rasterizer::~volm_osm_tile_rasterizer()
+{
+  this->wait();
+#if VXL_HAS_PTHREAD_H
+  delete static_cast<pthread_t*>(thread_);
+#endif
+}
+
+bool volm_osm_tile_rasterizer::rasterize(std::string const& osm_file, unsigned batch_size)
+{
+  volm_osm_stream_parser parser(this, batch_size);
+  return parser.parse(osm_file);
+}
+
+int volm_osm_tile_rasterizer::classify(volm_osm_stream_objects const& batch, unsigned o, volm_osm_string_table const& strings)
+{
+  int first = -1;
+  for (unsigned t = batch.tag_begin(o); t < batch.tag_end(o); ++t) {
+    std::pair<unsigned, unsigned> const& tag = batch.tags()[t];
+    std::map<std::pair<unsigned, unsigned>, tag_class>::iterator cit = tag_classes_.find(tag);
+    if (cit == tag_classes_.end()) {
+      std::pair<std::string, std::string> key(strings.str(tag.first), strings.str(tag.second));
+      tag_class c;
+      c.layer = -1;
+      c.pier = key.first == "man_made" && key.second == "pier";
+      std::map<std::pair<std::string, std::string>, volm_land_layer>::const_iterator mit = osm_land_table_.find(key);
+      if (mit != osm_land_table_.end()) {
+        c.layer = (int)layers_.size();
+        layers_.push_back(mit->second);
+      }
+      cit = tag_classes_.insert(std::pair<std::pair<unsigned, unsigned>, tag_class>(tag, c)).first;
+    }
+    if (cit->second.layer < 0)
+      continue;
+    // the pier has the first priority
+    if (cit->second.pier)
+      return cit->second.layer;
+    if (first < 0)
+      first = cit->second.layer;
+  }
+  return first;
+}
+
+void volm_osm_tile_rasterizer::add_objects(volm_osm_stream_objects& batch, volm_osm_string_table const& strings)
+{
+  // classify on the calling thread while the previous batch is drawn
+  next_layers_.resize(batch.size());
+  for (unsigned o = 0; o < batch.size(); ++o) {
+    next_layers_[o] = this->classify(batch, o, strings);
+    if (next_layers_[o] >= 0)
+      ++n_classified_;
+  }
+  this->wait();
+  pending_.swap(batch);
+  pending_layers_.swap(next_layers_);
+  if (drawn_layers_.size() != layers_.size())
+    drawn_layers_ = layers_;
+  this->start();
+}
+
+void volm_osm_tile_rasterizer::end_of_stream()
+{
+  this->wait();
+  this->run(true);
+}
+
+void volm_osm_tile_rasterizer::start()
+{
+  running_ = true;
+#if VXL_HAS_PTHREAD_H
+  if (pthread_create(static_cast<pthread_t*>(thread_), VXL_NULLPTR, &volm_osm_tile_rasterizer::thread_main, this) == 0)
+    return;
+#endif
+  this->run();
+  running_ = false;
+}
+
+void volm_osm_tile_rasterizer::wait()
+{
+  if (!running_)
+    return;
+#if VXL_HAS_PTHREAD_H
+  pthread_join(*static_cast<pthread_t*>(thread_), VXL_NULLPTR);
+#endif
+  running_ = false;
+}
+
+#if VXL_HAS_PTHREAD_H
+void* volm_osm_tile_rasterizer::thread_main(void* self)
+{
+  static_cast<volm_osm_tile_rasterizer*>(self)->run();
+  return VXL_NULLPTR;
+}
+#endif
+
+//: Draws the pending batch into a range of tiles, or finishes them
+class volm_osm_tile_rasterizer_body : public vpl_parallel_for_body
+{
+ public:
+  volm_osm_tile_rasterizer_body(volm_osm_tile_rasterizer& r, bool finish) : r_(r), finish_(finish) {}
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned t = begin; t < end; ++t)
+      if (finish_)
+        r_.finish_tile(t);
+      else
+        r_.rasterize_tile(t);
+  }
+ private:
+  volm_osm_tile_rasterizer& r_;
+  bool finish_;
+};
+
+void volm_osm_tile_rasterizer::run(bool finish)
+{
+  volm_osm_tile_rasterizer_body body(*this, finish);
+  vpl_parallel_for(this->n_tiles(), body, n_threads_);
+}
+
+//: write \p id at level \p level into the pixels of \p poly whose level is lower
+static void fill_polygon(vgl_polygon<double> const& poly, unsigned char id, unsigned char level,
+                         vil_image_view<vxl_byte>& label, vil_image_view<vxl_byte>& level_img)
+{
+  int ni = (int)label.ni(), nj = (int)label.nj();
+  vgl_box_2d<double> window(0.0, double(ni), 0.0, double(nj));
+  vgl_polygon_scan_iterator<double> it(poly, true, window);
+  for (it.reset(); it.next(); ) {
+    int y = it.scany();
+    if (y < 0 || y >= nj)
+      continue;
+    int x0 = std::max(it.startx(), 0), x1 = std::min(it.endx(), ni-1);
+    for (int x = x0; x <= x1; ++x)
+      if (level > level_img(x, y)) {
+        label(x, y) = id;  level_img(x, y) = level;
+      }
+  }
+}
+
+void volm_osm_tile_rasterizer::rasterize_tile(unsigned t)
+{
+  double ni = double(labels_[t].ni()), nj = double(labels_[t].nj());
+  std::vector<vgl_point_2d<double> > const& coords = pending_.coords();
+  std::vector<vgl_point_2d<double> > pts;
+  for (unsigned o = 0; o < pending_.size(); ++o)
+  {
+    if (pending_layers_[o] < 0)
+      continue;
+    volm_land_layer const& layer = drawn_layers_[pending_layers_[o]];
+    volm_osm_stream_objects::object_type type = pending_.type(o);
+    if (type == volm_osm_stream_objects::POINT) {
+      // buildings are not drawn as points
+      if (layer.name_ == "building")
+        continue;
+      vgl_point_2d<double> p = this->to_pixel(t, pending_.point(o));
+      if (p.x() < 0.0 || p.y() < 0.0 || p.x() >= ni || p.y() >= nj)
+        continue;
+      tile_point tp;
+      tp.x = (unsigned)p.x();  tp.y = (unsigned)p.y();
+      tp.id = layer.id_;  tp.level = layer.level_;
+      points_[t].push_back(tp);
+      continue;
+    }
+    // the pixel extent of the object, widened for roads
+    double half_width = 0.0;
+    if (type == volm_osm_stream_objects::LINE) {
+      double width = layer.width_ < 1.0 ? 1.1 : layer.width_;
+      half_width = 0.5*std::max(width/meters_per_pixel_[t], 1.1);
+    }
+    else if (layer.level_ == 0)  // regions of level 0 are already in the base land map
+      continue;
+    vgl_box_2d<double> box = pending_.bounding_box(o);
+    if (box.is_empty())
+      continue;
+    vgl_point_2d<double> c0 = this->to_pixel(t, box.min_point()), c1 = this->to_pixel(t, box.max_point());
+    if (std::max(c0.x(), c1.x()) + half_width < 0.0 || std::min(c0.x(), c1.x()) - half_width > ni ||
+        std::max(c0.y(), c1.y()) + half_width < 0.0 || std::min(c0.y(), c1.y()) - half_width > nj)
+      continue;
+    vgl_polygon<double> img_poly;
+    for (unsigned s = pending_.sheet_begin(o); s < pending_.sheet_end(o); ++s) {
+      pts.clear();
+      for (unsigned c = pending_.coord_begin(s); c < pending_.coord_end(s); ++c) {
+        vgl_point_2d<double> p = this->to_pixel(t, coords[c]);
+        if (pts.empty() || p != pts.back())
+          pts.push_back(p);
+      }
+      if (type == volm_osm_stream_objects::LINE) {
+        if (pts.size() > 1)
+          volm_io_tools::expend_line(pts, 2.0*half_width, img_poly);
+      }
+      else if (pts.size() > 2)
+        img_poly.push_back(pts);
+    }
+    if (img_poly.num_sheets() == 0)
+      continue;
+    if (type == volm_osm_stream_objects::LINE)
+      fill_polygon(img_poly, layer.id_, layer.level_, road_labels_[t], road_levels_[t]);
+    else
+      fill_polygon(img_poly, layer.id_, layer.level_, labels_[t], levels_[t]);
+  }
+}
+
+void volm_osm_tile_rasterizer::finish_tile(unsigned t)
+{
+  vil_image_view<vxl_byte>& label = labels_[t];
+  vil_image_view<vxl_byte>& level_img = levels_[t];
+  vil_image_view<vxl_byte>& road_label = road_labels_[t];
+  vil_image_view<vxl_byte>& road_level = road_levels_[t];
+  // each road pixel holds the first road of the highest level, which is the one that wins when the roads are drawn one by one
+  for (unsigned j = 0; j < label.nj(); ++j)
+    for (unsigned i = 0; i < label.ni(); ++i)
+      if (road_level(i, j) > level_img(i, j)) {
+        label(i, j) = road_label(i, j);  level_img(i, j) = road_level(i, j);
+      }
+  road_label.fill(0);  road_level.fill(0);
+  std::vector<tile_point>& pts = points_[t];
+  for (unsigned p = 0; p < pts.size(); ++p)
+    if (pts[p].level >= level_img(pts[p].x, pts[p].y)) {
+      label(pts[p].x, pts[p].y) = pts[p].id;  level_img(pts[p].x, pts[p].y) = pts[p].level;
+    }
+  pts.clear();
+}
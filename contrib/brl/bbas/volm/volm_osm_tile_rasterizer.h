@@ -0,0 +1,138 @@
+// This is brl/bbas/volm/volm_osm_tile_rasterizer.h
+#ifndef volm_osm_tile_rasterizer_h_
+#define volm_osm_tile_rasterizer_h_
+//:
+// \file
+// \brief Rasterizes open street map objects into land category images of volm tiles as they are parsed
+//
+//  The rasterizer is a volm_osm_stream_handler: each batch of objects from
+//  a volm_osm_stream_parser is classified into land layers (as in
+//  volm_osm_objects, the man_made=pier tag first, then the first tag found
+//  in the osm to volm table) and then drawn into all the tiles on a helper
+//  thread, which uses several threads over the tiles, while the parser
+//  reads the next batch.  Each tile is drawn by one thread, so the images
+//  do not depend on the number of threads.
+//
+//  The drawing rules are those of the osm part of the 2D land map of
+//  volm_create_osm_2d_map (its compiled "Phase 1A" main): all the regions
+//  are drawn first, then all the roads, then all the points, each phase in
+//  the order of the file.  A region or a road writes its land id into the
+//  label image where its level is above that of the level image, a point
+//  where its level is at or above it.  Regions of level 0 are ignored and
+//  buildings are not drawn as points.  As the parser meets the points of a
+//  file first, the roads are drawn into images of their own and the points
+//  are kept in a list, and both are put over the regions in end_of_stream().
+//
+//  The geometry is that of the tiles rather than of the 1 m leaves of the
+//  tool: roads are widened to their width (at least 1.1 m) in pixels of the
+//  tile, but to at least 1.1 pixels so they stay connected, lines are not
+//  cut at the tile border, all the sheets of a region are drawn and repeated
+//  points of a region are dropped rather than the region being ignored.
+//  Road junctions are not drawn.
+//
+// \verbatim
+//  Modifications
+//   None
+// \endverbatim
+
+#include <string>
+#include <vector>
+#include <map>
+#include <utility>
+#include <vcl_compiler.h>
+#include <vil/vil_image_view.h>
+#include <vxl_config.h>
+#include "volm_osm_stream_parser.h"
+#include "volm_category_io.h"
+#include "volm_tile.h"
+
+class volm_osm_tile_rasterizer : public volm_osm_stream_handler
+{
+ public:
+  //: draw into label and level images of \p tiles, classified by \p osm_land_table (see volm_osm_category_io::load_category_table)
+  //  The tiles are drawn on up to \p n_threads threads (0 means one per processor).
+  volm_osm_tile_rasterizer(std::vector<volm_tile> const& tiles,
+                           std::map<std::pair<std::string, std::string>, volm_land_layer> const& osm_land_table,
+                           unsigned n_threads = 0);
+  ~volm_osm_tile_rasterizer();
+
+  //: parse \p osm_file and draw its objects, returns false if the file can not be parsed
+  bool rasterize(std::string const& osm_file, unsigned batch_size = 4096);
+
+  virtual void add_objects(volm_osm_stream_objects& batch, volm_osm_string_table const& strings);
+  virtual void end_of_stream();
+
+  unsigned n_tiles() const { return (unsigned)labels_.size(); }
+  //: the land ids of tile \p t, valid after end_of_stream()
+  vil_image_view<vxl_byte> const& label_image(unsigned t) const { return labels_[t]; }
+  //: the levels of the land ids of tile \p t
+  vil_image_view<vxl_byte> const& level_image(unsigned t) const { return levels_[t]; }
+
+  //: the number of objects with a land layer
+  unsigned n_classified() const { return n_classified_; }
+
+  //: the continuous pixel co-ordinates of (lon, lat) in tile \p t, where pixel (i,j) covers [i,i+1)x[j,j+1)
+  vgl_point_2d<double> to_pixel(unsigned t, vgl_point_2d<double> const& p) const
+  {
+    double const* a = &geo_to_img_[6*t];
+    return vgl_point_2d<double>(a[0] + a[1]*p.x() + a[2]*p.y(), a[3] + a[4]*p.x() + a[5]*p.y());
+  }
+
+  //: draw the pending batch into tile \p t
+  void rasterize_tile(unsigned t);
+  //: put the roads and then the points of tile \p t over its regions
+  void finish_tile(unsigned t);
+
+ private:
+  //: the layer of a tag, or -1, and whether it is the man_made=pier tag
+  struct tag_class
+  {
+    int layer;
+    bool pier;
+  };
+  //: a point waiting to be drawn over the roads of a tile
+  struct tile_point
+  {
+    unsigned x, y;
+    unsigned char id, level;
+  };
+  //: the index in layers_ of the layer of object o of \p batch, or -1
+  int classify(volm_osm_stream_objects const& batch, unsigned o, volm_osm_string_table const& strings);
+
+  //: draw the pending batch into all the tiles, on the helper thread
+  void start();
+  void wait();
+  //: draw the pending batch into the tiles, or finish them if \p finish
+  void run(bool finish = false);
+#if VXL_HAS_PTHREAD_H
+  static void* thread_main(void* self);
+#endif
+
+  std::map<std::pair<std::string, std::string>, volm_land_layer> osm_land_table_;
+  unsigned n_threads_;
+  // per tile: the images, the affine map from (lon, lat) to pixels and the pixel size in meters
+  std::vector<vil_image_view<vxl_byte> > labels_;
+  std::vector<vil_image_view<vxl_byte> > levels_;
+  // per tile: the roads, drawn apart from the regions, and the points in the order of the file
+  std::vector<vil_image_view<vxl_byte> > road_labels_;
+  std::vector<vil_image_view<vxl_byte> > road_levels_;
+  std::vector<std::vector<tile_point> > points_;
+  std::vector<double> geo_to_img_;
+  std::vector<double> meters_per_pixel_;
+  // the classification of the tags and the distinct land layers
+  std::map<std::pair<unsigned, unsigned>, tag_class> tag_classes_;
+  std::vector<volm_land_layer> layers_;
+  unsigned n_classified_;
+  // the batch being drawn, the layers of its objects and a copy of layers_ for the helper thread,
+  // as the next batch adds to layers_ while it draws
+  volm_osm_stream_objects pending_;
+  std::vector<volm_land_layer> drawn_layers_;
+  std::vector<int> pending_layers_;
+  std::vector<int> next_layers_;
+  bool running_;
+#if VXL_HAS_PTHREAD_H
+  void* thread_;  // a pthread_t, kept out of this header
+#endif
+};
+
+#endif // volm_osm_tile_rasterizer_h_
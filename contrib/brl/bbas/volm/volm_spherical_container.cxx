@@ -4,6 +4,7 @@
 //:
 // \file
 #include <vcl_compiler.h>
+#include <vsph/vsph_healpix_index.h>
 
 double RoundUp(double x, double unit)
 {
@@ -31,7 +32,7 @@ double RoundUp2Vmin(double x, double vmin)
 }
 
 volm_spherical_container::volm_spherical_container(float d_solid_ang, float voxel_min, float max_dist)
-  : depth_offset_(0), ds_(d_solid_ang), vmin_(voxel_min)
+  : depth_offset_(0), ds_(d_solid_ang), vmin_(voxel_min), closest_offset_(0), closest_end_(0)
  {
   dmax_ = (float)RoundUp(max_dist,vmin_);
   double vmin = vmin_;
@@ -380,6 +381,41 @@ void volm_spherical_container::first_res(double res, unsigned int& offset, unsig
   }
 }
 
+const std::vector<unsigned int>& volm_spherical_container::closest_voxels(unsigned int offset, unsigned int end_offset)
+{
+  if (closest_offset_ == offset && closest_end_ == end_offset && closest_.size() == voxels_.size())
+    return closest_;
+  closest_offset_ = offset;
+  closest_end_ = end_offset;
+  closest_.assign(voxels_.size(), offset);
+  if (end_offset <= offset)
+    return closest_;
+  // directions of the layer voxels, in cells of about the voxel spacing
+  std::vector<vgl_vector_3d<double> > layer;
+  for (unsigned int i = offset; i < end_offset; i++)
+    layer.push_back(voxels_[i].center_ - vgl_point_3d<double>(0.0, 0.0, 0.0));
+  vsph_healpix_index index(vsph_healpix_index::order_for_angle(std::sqrt(4.0*vnl_math::pi/layer.size())));
+  index.set_points(layer);
+  std::vector<vgl_vector_3d<double> > dirs;
+  std::vector<unsigned int> ids;
+  for (unsigned int i = 0; i < voxels_.size(); i++) {
+    if (i >= offset && i < end_offset) {  // the layer maps to itself
+      closest_[i] = i;
+      continue;
+    }
+    vgl_vector_3d<double> dir = voxels_[i].center_ - vgl_point_3d<double>(0.0, 0.0, 0.0);
+    if (dir.length() == 0.0)  // no direction; keep the first voxel of the layer
+      continue;
+    dirs.push_back(dir);
+    ids.push_back(i);
+  }
+  std::vector<int> nearest;
+  index.nearest_points(dirs, nearest);
+  for (unsigned int k = 0; k < ids.size(); k++)
+    closest_[ids[k]] = offset + (unsigned int)nearest[k];
+  return closest_;
+}
+
 void volm_spherical_container::get_depth_intervals(std::vector<float>& ints)
 {
   std::map<double, unsigned char>::iterator iter = depth_interval_map_.begin();
@@ -9,7 +9,7 @@
 // \date October 07, 2012
 // \verbatim
 //  Modifications
-//   <none yet>
+//   closest_voxels() maps voxels to a layer through a vsph_healpix_index
 // \endverbatim
 //
 
@@ -43,7 +43,7 @@ class volm_spherical_container : public vbl_ref_count
 {
  public:
   // constructor
-  volm_spherical_container() {}
+  volm_spherical_container() : closest_offset_(0), closest_end_(0) {}
   volm_spherical_container(float d_solid_ang, float voxel_min, float max_dist);
 
   // accessor
@@ -68,6 +68,12 @@ class volm_spherical_container : public vbl_ref_count
   //: return the offset and depth of the first layer with the given resolution
   void first_res(double res, unsigned int& offset, unsigned int& end_offset, double& depth);
 
+  //: for each voxel, the voxel of the layer [offset, end_offset) in the closest direction from the container centre
+  //  The layer is bucketed in a vsph_healpix_index, so each voxel visits only
+  //  the layer voxels in nearby cells.  The result is kept until it is asked
+  //  for with a different layer.
+  const std::vector<unsigned int>& closest_voxels(unsigned int offset, unsigned int end_offset);
+
 protected:
   bool meshcurrentlayer(double d, double vc);
   std::vector<volm_voxel> voxels_;
@@ -78,6 +84,10 @@ protected:
   float ds_;
   float vmin_;
   float dmax_;
+  //: the cached result of closest_voxels()
+  std::vector<unsigned int> closest_;
+  unsigned int closest_offset_;
+  unsigned int closest_end_;
 };
 
 #endif  // volm_spherical_container_h_
@@ -10,6 +10,7 @@ DECLARE( test_sph_segment );
 DECLARE( test_utils );
 DECLARE( test_grid_index );
 DECLARE( test_sph_cover );
+DECLARE( test_healpix_index );
 
 void
 register_tests()
@@ -23,6 +24,7 @@ register_tests()
   REGISTER( test_utils );
   REGISTER( test_grid_index );
   REGISTER( test_sph_cover);
+  REGISTER( test_healpix_index );
 }
 
 DEFINE_MAIN;
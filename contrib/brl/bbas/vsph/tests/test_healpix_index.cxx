@@ -0,0 +1,164 @@
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include <testlib/testlib_test.h>
+#include <vnl/vnl_math.h>
+#include <vnl/vnl_random.h>
+#include <vgl/vgl_vector_3d.h>
+#include <vsph/vsph_healpix_index.h>
+#include <vsph/vsph_sph_point_2d.h>
+
+static vgl_vector_3d<double> random_dir(vnl_random& rng)
+{
+  double z = rng.drand64(-1.0, 1.0), ph = rng.drand64(0.0, vnl_math::twopi);
+  double s = std::sqrt(1.0-z*z);
+  return vgl_vector_3d<double>(s*std::cos(ph), s*std::sin(ph), z);
+}
+
+static double angle(vgl_vector_3d<double> const& a, vgl_vector_3d<double> const& b)
+{
+  return std::atan2(cross_product(a, b).length(), dot_product(a, b));
+}
+
+static void test_healpix_index()
+{
+  vnl_random rng(1234567);
+
+  // the cells at order 0 are the twelve base cells
+  vsph_healpix_index idx0(0);
+  TEST("base cells", idx0.n_cells(), 12);
+  TEST("north pole", idx0.cell(vgl_vector_3d<double>(0.0, 0.0, 1.0)) < 4, true);
+  TEST("south pole", idx0.cell(vgl_vector_3d<double>(0.0, 0.0, -1.0)) >= 8, true);
+  TEST("equator", idx0.cell(vgl_vector_3d<double>(1.0, 0.0, 0.0)), 4);
+
+  unsigned order = 4;
+  vsph_healpix_index idx(order);
+  unsigned n = idx.n_cells();
+  TEST("number of cells", n, 12*16*16);
+
+  // every centre maps to its own cell
+  unsigned n_bad = 0;
+  for (unsigned c = 0; c<n; ++c)
+    if (idx.cell(idx.centre(c))!=c) ++n_bad;
+  TEST("centres map to their cells", n_bad, 0);
+
+  // the cells are of equal area, so uniform directions fill them evenly,
+  // and the nested ids agree with the lower order indices
+  vsph_healpix_index idx2(2);
+  std::vector<unsigned> counts(n, 0);
+  unsigned n_dirs = 200000, n_nested_bad = 0, n_radius_bad = 0;
+  std::vector<vgl_vector_3d<double> > dirs(n_dirs);
+  for (unsigned i = 0; i<n_dirs; ++i) {
+    dirs[i] = random_dir(rng);
+    unsigned c = idx.cell(dirs[i]);
+    ++counts[c];
+    if (idx.parent(c, 2)!=idx2.cell(dirs[i])) ++n_nested_bad;
+    if (angle(dirs[i], idx.centre(c))>idx.max_cell_radius()) ++n_radius_bad;
+  }
+  TEST("nested ids", n_nested_bad, 0);
+  TEST("cell radius bound", n_radius_bad, 0);
+  double mean = double(n_dirs)/n;
+  double var = 0.0;
+  for (unsigned c = 0; c<n; ++c)
+    var += (counts[c]-mean)*(counts[c]-mean);
+  var /= n;
+  // for equal areas the counts are Poisson, with variance equal to the mean
+  std::cout << "cell count mean " << mean << ", variance " << var << '\n';
+  TEST("equal area", var > 0.85*mean && var < 1.15*mean, true);
+
+  // spherical points in degrees and radians
+  vsph_sph_point_2d sp(60.0, -135.0, false), spr(vnl_math::pi/3.0, -0.75*vnl_math::pi, true);
+  vgl_vector_3d<double> v(std::sin(vnl_math::pi/3.0)*std::cos(-0.75*vnl_math::pi),
+                          std::sin(vnl_math::pi/3.0)*std::sin(-0.75*vnl_math::pi),
+                          std::cos(vnl_math::pi/3.0));
+  TEST("spherical point in degrees", idx.cell(sp), idx.cell(v));
+  TEST("spherical point in radians", idx.cell(spr), idx.cell(v));
+
+  // the batch matches the single lookups whatever the number of threads
+  std::vector<unsigned> ids1, ids3;
+  idx.cells(dirs, ids1, 1);
+  idx.cells(dirs, ids3, 3);
+  bool batch_ok = ids1==ids3;
+  for (unsigned i = 0; i<n_dirs && batch_ok; i+=97)
+    batch_ok = ids1[i]==idx.cell(dirs[i]);
+  TEST("batched cells", batch_ok, true);
+
+  // neighbours: symmetric, eight of them except at the 24 cells where three base cells meet
+  unsigned n_seven = 0, n_asym = 0, n_other = 0;
+  for (unsigned c = 0; c<n; ++c) {
+    const int* nb = idx.neighbours(c);
+    unsigned k = 0;
+    while (k<8 && nb[k]>=0) ++k;
+    if (k==7) ++n_seven;
+    else if (k!=8) ++n_other;
+    for (unsigned i = 0; i<k; ++i) {
+      const int* nb2 = idx.neighbours(nb[i]);
+      if (std::find(nb2, nb2+8, int(c))==nb2+8) ++n_asym;
+    }
+  }
+  TEST("cells with seven neighbours", n_seven, 24);
+  TEST("cells with other neighbour counts", n_other, 0);
+  TEST("neighbours are symmetric", n_asym, 0);
+
+  // query_disc against a scan of the centres
+  unsigned n_disc_bad = 0, n_incl_bad = 0;
+  for (unsigned q = 0; q<50; ++q) {
+    vgl_vector_3d<double> d = random_dir(rng);
+    double r = rng.drand64(0.01, 1.5);
+    std::vector<unsigned> found, incl, ref;
+    idx.query_disc(d, r, found);
+    idx.query_disc(d, r, incl, true);
+    for (unsigned c = 0; c<n; ++c)
+      if (angle(d, idx.centre(c))<=r) ref.push_back(c);
+    if (found!=ref) ++n_disc_bad;
+    // every direction in the cap lies in one of the inclusive cells
+    for (unsigned i = 0; i<2000; ++i)
+      if (angle(d, dirs[i])<=r && !std::binary_search(incl.begin(), incl.end(), ids1[i]))
+        ++n_incl_bad;
+  }
+  TEST("query_disc", n_disc_bad, 0);
+  TEST("inclusive query_disc", n_incl_bad, 0);
+
+  // nearest points against a linear scan, with clustered and sparse points
+  std::vector<vgl_vector_3d<double> > pts;
+  for (unsigned i = 0; i<3000; ++i)
+    pts.push_back(random_dir(rng));
+  for (unsigned i = 0; i<200; ++i) {
+    vgl_vector_3d<double> p = vgl_vector_3d<double>(0.1, 0.2, 1.0) + 0.01*random_dir(rng);
+    pts.push_back(p);
+  }
+  vsph_healpix_index pidx(3);
+  TEST("nearest point of no points", pidx.nearest_point(vgl_vector_3d<double>(1,0,0)), -1);
+  pidx.set_points(pts);
+  TEST("number of points", pidx.n_points(), pts.size());
+  unsigned n_in = 0;
+  for (unsigned c = 0; c<pidx.n_cells(); ++c) n_in += pidx.n_points_in(c);
+  TEST("points bucketed", n_in, pts.size());
+  std::vector<vgl_vector_3d<double> > qs(dirs.begin(), dirs.begin()+5000);
+  std::vector<int> near1, near3;
+  pidx.nearest_points(qs, near1, 1);
+  pidx.nearest_points(qs, near3, 3);
+  unsigned n_near_bad = 0;
+  for (unsigned i = 0; i<qs.size(); ++i) {
+    int best = -1; double best_dot = -2.0;
+    for (unsigned k = 0; k<pts.size(); ++k) {
+      double dt = dot_product(qs[i], normalized(pts[k]));
+      if (dt>best_dot) { best_dot = dt; best = int(k); }
+    }
+    if (near1[i]!=best) ++n_near_bad;
+  }
+  TEST("nearest points", n_near_bad, 0);
+  TEST("nearest points independent of thread count", near1==near3, true);
+
+  // a single point is found from anywhere
+  std::vector<vgl_vector_3d<double> > one(1, vgl_vector_3d<double>(0.0, 0.0, -1.0));
+  vsph_healpix_index oidx(5);
+  oidx.set_points(one);
+  TEST("nearest of a single point", oidx.nearest_point(vgl_vector_3d<double>(0.0, 0.1, 1.0)), 0);
+
+  TEST("order for angle", vsph_healpix_index::order_for_angle(0.02) >= 5, true);
+  vsph_healpix_index aidx(vsph_healpix_index::order_for_angle(0.02));
+  TEST("cell radius below the angle", aidx.max_cell_radius() < 0.02, true);
+}
+
+TESTMAIN(test_healpix_index);
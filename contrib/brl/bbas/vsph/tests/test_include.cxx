@@ -4,6 +4,7 @@
 #include <vsph/vsph_camera_bounds.h>
 #include <vsph/vsph_defs.h>
 #include <vsph/vsph_grid_index_2d.h>
+#include <vsph/vsph_healpix_index.h>
 #include <vsph/vsph_segment_sphere.h>
 #include <vsph/vsph_sph_box_2d.h>
 #include <vsph/vsph_sph_cover_2d.h>
@@ -47,6 +47,32 @@ static void test_sph_cover()
  double cover_inter_area = intersection_area(cov_a, cov_b);
  TEST_NEAR("intersection area of two covers", orig_int_area, cover_inter_area, 0.001);
 
+ // a cover of a ring shaped region of rays; the area fraction of each box
+ // must match a scan of all the region rays
+ std::vector<vsph_sph_point_2d> rays;
+ for (double th = 70.25; th < 110.0; th += 0.5)
+   for (double ph = -40.25; ph < 40.0; ph += 0.5) {
+     double r = std::sqrt((th-90.0)*(th-90.0) + ph*ph);
+     if (r > 8.0 && r < 18.0)
+       rays.push_back(vsph_sph_point_2d(th, ph, false));
+   }
+ vsph_sph_point_2d q0(70.0, -40.0, false), q1(110.0, 40.0, false), qc(90.0, 0.0, false);
+ vsph_sph_box_2d region_bb(q0, q1, qc);
+ double ray_area = 0.25*(vnl_math::pi_over_180*vnl_math::pi_over_180);
+ vsph_sph_cover_2d ring(region_bb, rays, ray_area, 0.8);
+ const std::vector<cover_el>& cels = ring.cover();
+ unsigned n_bad = 0;
+ for (std::vector<cover_el>::const_iterator cit = cels.begin(); cit != cels.end(); ++cit) {
+   unsigned n_in = 0;
+   for (unsigned i = 0; i<rays.size(); ++i)
+     if (cit->box_.contains(rays[i])) ++n_in;
+   if (std::fabs(cit->frac_inside_ - n_in*ray_area/cit->box_.area()) > 1e-12) ++n_bad;
+ }
+ std::cout << "ring cover: " << cels.size() << " boxes, area fraction "
+           << ring.actual_area_fraction() << '\n';
+ TEST("ring cover has boxes", cels.size() > 4, true);
+ TEST("ring cover area fractions match a scan of the rays", n_bad, 0);
+
 }
 
 TESTMAIN(test_sph_cover);
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <testlib/testlib_test.h>
 
 #include <vsph/vsph_unit_sphere.h>
@@ -37,6 +38,26 @@ static void test_unit_sphere()
   }
   TEST("binary read write - vsph_unit_sphere", good, true);
   vpl_unlink("./temp.bin");
+
+  // nearest vertices from the healpix index against a scan of the vertices
+  const std::vector<vgl_vector_3d<double> >& verts = usph->cart_vectors_ref();
+  std::vector<vgl_vector_3d<double> > dirs;
+  for (unsigned i = 0; i<60; ++i)
+    for (unsigned j = 0; j<30; ++j) {
+      double th = (j+0.37)*vnl_math::pi/30.0, ph = (i+0.61)*vnl_math::twopi/60.0;
+      dirs.push_back(vgl_vector_3d<double>(std::sin(th)*std::cos(ph), std::sin(th)*std::sin(ph), std::cos(th)));
+    }
+  std::vector<int> ids;
+  usph->nearest_vertices(dirs, ids);
+  unsigned n_bad = 0;
+  for (unsigned k = 0; k<dirs.size(); ++k) {
+    int best = -1; double best_dot = -2.0;
+    for (unsigned v = 0; v<verts.size(); ++v)
+      if (dot_product(dirs[k], verts[v])>best_dot) { best_dot = dot_product(dirs[k], verts[v]); best = int(v); }
+    if (ids[k]!=best || usph->nearest_vertex(dirs[k])!=best) ++n_bad;
+  }
+  TEST("nearest vertices", n_bad, 0);
+  TEST("nearest vertex after binary read", usph_in->nearest_vertex(dirs[17]), ids[17]);
 }
 TESTMAIN(test_unit_sphere);
 
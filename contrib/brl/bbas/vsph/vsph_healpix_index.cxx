@@ -0,0 +1,345 @@
+#include <algorithm>
+#include <cmath>
+#include "vsph_healpix_index.h"
+#include <vnl/vnl_math.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_cassert.h>
+
+// the ring of the southern corner and the azimuth of each base cell, in the HEALPix convention
+static const int jrll[12] = { 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4 };
+static const int jpll[12] = { 1, 3, 5, 7, 0, 2, 4, 6, 1, 3, 5, 7 };
+
+// the steps to the eight neighbours in face co-ordinates, and for a step
+// off base cell f in direction (dx,dy), at row 4+dx+3*dy, the base cell it
+// lands in (-1 if there is none) and how its co-ordinates flip and swap
+static const int nb_xoffset[8] = { -1, -1, 0, 1, 1, 1, 0, -1 };
+static const int nb_yoffset[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int nb_facearray[9][12] =
+  { {  8, 9,10,11,-1,-1,-1,-1,10,11, 8, 9 },   // S
+    {  5, 6, 7, 4, 8, 9,10,11, 9,10,11, 8 },   // SE
+    { -1,-1,-1,-1, 5, 6, 7, 4,-1,-1,-1,-1 },   // E
+    {  4, 5, 6, 7,11, 8, 9,10,11, 8, 9,10 },   // SW
+    {  0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10,11 },   // centre
+    {  1, 2, 3, 0, 0, 1, 2, 3, 5, 6, 7, 4 },   // NE
+    { -1,-1,-1,-1, 7, 4, 5, 6,-1,-1,-1,-1 },   // W
+    {  3, 0, 1, 2, 3, 0, 1, 2, 4, 5, 6, 7 },   // NW
+    {  2, 3, 0, 1,-1,-1,-1,-1, 0, 1, 2, 3 } }; // N
+static const int nb_swaparray[9][3] =
+  { { 0,0,3 }, { 0,0,6 }, { 0,0,0 }, { 0,0,5 }, { 0,0,0 },
+    { 5,0,0 }, { 0,0,0 }, { 6,0,0 }, { 3,0,0 } };
+
+//: interleave the low 16 bits of v with zeros
+static unsigned spread_bits(unsigned v)
+{
+  v &= 0xffffu;
+  v = (v|(v<<8)) & 0x00ff00ffu;
+  v = (v|(v<<4)) & 0x0f0f0f0fu;
+  v = (v|(v<<2)) & 0x33333333u;
+  v = (v|(v<<1)) & 0x55555555u;
+  return v;
+}
+
+//: the inverse of spread_bits()
+static unsigned compress_bits(unsigned v)
+{
+  v &= 0x55555555u;
+  v = (v|(v>>1)) & 0x33333333u;
+  v = (v|(v>>2)) & 0x0f0f0f0fu;
+  v = (v|(v>>4)) & 0x00ff00ffu;
+  v = (v|(v>>8)) & 0x0000ffffu;
+  return v;
+}
+
+static unsigned xyf_to_cell(unsigned ix, unsigned iy, unsigned face, unsigned order)
+{
+  return (face<<(2*order)) + spread_bits(ix) + (spread_bits(iy)<<1);
+}
+
+static void cell_to_xyf(unsigned cell, unsigned order, unsigned& ix, unsigned& iy, unsigned& face)
+{
+  face = cell>>(2*order);
+  unsigned p = cell & ((1u<<(2*order))-1u);
+  ix = compress_bits(p);
+  iy = compress_bits(p>>1);
+}
+
+static double angle(vgl_vector_3d<double> const& a, vgl_vector_3d<double> const& b)
+{
+  return std::atan2(cross_product(a, b).length(), dot_product(a, b));
+}
+
+vgl_vector_3d<double> vsph_healpix_index::face_point(unsigned face, double x, double y)
+{
+  double jr = jrll[face] - x - y;
+  double nr, z, sth;
+  if (jr<1.0) {        // north polar cap
+    nr = jr;
+    z = 1.0 - nr*nr/3.0;
+    sth = nr*std::sqrt((1.0+z)/3.0);
+  }
+  else if (jr>3.0) {   // south polar cap
+    nr = 4.0 - jr;
+    z = nr*nr/3.0 - 1.0;
+    sth = nr*std::sqrt((1.0-z)/3.0);
+  }
+  else {               // equatorial belt
+    nr = 1.0;
+    z = (2.0-jr)*2.0/3.0;
+    sth = std::sqrt((1.0-z)*(1.0+z));
+  }
+  double phi = nr>1e-15 ? vnl_math::pi_over_4*(jpll[face]*nr + x - y)/nr : 0.0;
+  return vgl_vector_3d<double>(sth*std::cos(phi), sth*std::sin(phi), z);
+}
+
+vgl_vector_3d<double> vsph_healpix_index::centre(unsigned cell, unsigned order)
+{
+  unsigned ix, iy, face;
+  cell_to_xyf(cell, order, ix, iy, face);
+  double s = 1.0/double(1u<<order);
+  return face_point(face, (ix+0.5)*s, (iy+0.5)*s);
+}
+
+unsigned vsph_healpix_index::cell_unit(double x, double y, double z) const
+{
+  const int ns = int(nside_);
+  double za = std::fabs(z);
+  double tt = std::atan2(y, x)/vnl_math::pi_over_2;
+  if (tt<0.0) tt += 4.0;
+  if (tt>=4.0) tt -= 4.0;
+  if (za<=2.0/3.0) {
+    double temp1 = ns*(0.5+tt), temp2 = ns*(z*0.75);
+    int jp = int(temp1-temp2);  // index of the ascending edge line
+    int jm = int(temp1+temp2);  // index of the descending edge line
+    int ifp = jp>>order_, ifm = jm>>order_;
+    int face = (ifp==ifm) ? (ifp|4) : ((ifp<ifm) ? ifp : (ifm+8));
+    int ix = jm & (ns-1), iy = ns - (jp & (ns-1)) - 1;
+    return xyf_to_cell(ix, iy, face, order_);
+  }
+  int ntt = std::min(3, int(tt));
+  double tp = tt-ntt;
+  // nside*sqrt(3*(1-za)), without cancellation near the poles
+  double tmp = ns*std::sqrt(x*x+y*y)*std::sqrt(3.0/(1.0+za));
+  int jp = std::min(int(tp*tmp), ns-1);        // increasing edge line index
+  int jm = std::min(int((1.0-tp)*tmp), ns-1);  // decreasing edge line index
+  return z>0.0 ? xyf_to_cell(ns-jm-1, ns-jp-1, ntt, order_)
+               : xyf_to_cell(jp, jm, ntt+8, order_);
+}
+
+vsph_healpix_index::vsph_healpix_index(unsigned order)
+: order_(order), nside_(1u<<order)
+{
+  assert(order<=13);
+  unsigned n = n_cells();
+  centres_.resize(n);
+  for (unsigned c = 0; c<n; ++c)
+    centres_[c] = centre(c, order_);
+
+  // The cell radii, from the corners and edge points of every cell.  The
+  // edges are not great circles, hence the margin.
+  const double ts[5] = { 0.0, 0.25, 0.5, 0.75, 1.0 };
+  max_radius_.resize(order_+1);
+  for (unsigned k = 0; k<=order_; ++k) {
+    unsigned nk = 12u<<(2*k);
+    double s = 1.0/double(1u<<k), rmax = 0.0;
+    for (unsigned c = 0; c<nk; ++c) {
+      unsigned ix, iy, face;
+      cell_to_xyf(c, k, ix, iy, face);
+      vgl_vector_3d<double> cc = (k==order_) ? centres_[c] : centre(c, k);
+      for (unsigned t = 0; t<5; ++t) {
+        rmax = std::max(rmax, angle(cc, face_point(face, (ix+ts[t])*s, iy*s)));
+        rmax = std::max(rmax, angle(cc, face_point(face, (ix+ts[t])*s, (iy+1)*s)));
+        rmax = std::max(rmax, angle(cc, face_point(face, ix*s, (iy+ts[t])*s)));
+        rmax = std::max(rmax, angle(cc, face_point(face, (ix+1)*s, (iy+ts[t])*s)));
+      }
+    }
+    max_radius_[k] = 1.05*rmax;
+  }
+
+  // The neighbours, by stepping one cell in each of the eight directions
+  // within the base cell, or across to the adjacent base cell.
+  neighbours_.assign(8*n, -1);
+  const int ns = int(nside_);
+  for (unsigned c = 0; c<n; ++c) {
+    unsigned ix, iy, face;
+    cell_to_xyf(c, order_, ix, iy, face);
+    std::vector<unsigned> found;
+    for (unsigned m = 0; m<8; ++m) {
+      int x = int(ix)+nb_xoffset[m], y = int(iy)+nb_yoffset[m];
+      int nbnum = 4;
+      if (x<0)        { x += ns; nbnum -= 1; }
+      else if (x>=ns) { x -= ns; nbnum += 1; }
+      if (y<0)        { y += ns; nbnum -= 3; }
+      else if (y>=ns) { y -= ns; nbnum += 3; }
+      int f = nb_facearray[nbnum][face];
+      if (f<0)
+        continue;
+      int bits = nb_swaparray[nbnum][face>>2];
+      if (bits&1) x = ns-x-1;
+      if (bits&2) y = ns-y-1;
+      if (bits&4) std::swap(x, y);
+      unsigned nc = xyf_to_cell(x, y, f, order_);
+      if (nc!=c)
+        found.push_back(nc);
+    }
+    std::sort(found.begin(), found.end());
+    found.erase(std::unique(found.begin(), found.end()), found.end());
+    for (unsigned i = 0; i<found.size(); ++i)
+      neighbours_[8*c+i] = int(found[i]);
+  }
+}
+
+unsigned vsph_healpix_index::order_for_angle(double cell_angle)
+{
+  // the cells are sqrt(pi/3)/nside across on average
+  unsigned order = 0;
+  while (order<13 && std::sqrt(vnl_math::pi/3.0)/double(1u<<order) > cell_angle)
+    ++order;
+  return order;
+}
+
+unsigned vsph_healpix_index::cell(vgl_vector_3d<double> const& dir) const
+{
+  double len = dir.length();
+  return cell_unit(dir.x()/len, dir.y()/len, dir.z()/len);
+}
+
+unsigned vsph_healpix_index::cell(vsph_sph_point_2d const& sp) const
+{
+  double th = sp.theta_, ph = sp.phi_;
+  if (!sp.in_radians_) {
+    th *= vnl_math::pi_over_180;
+    ph *= vnl_math::pi_over_180;
+  }
+  double st = std::sin(th);
+  return cell_unit(st*std::cos(ph), st*std::sin(ph), std::cos(th));
+}
+
+//: maps a range of directions to cells
+class vsph_healpix_cells_body : public vpl_parallel_for_body
+{
+ public:
+  const vsph_healpix_index* index_;
+  const vgl_vector_3d<double>* dirs_;
+  unsigned* ids_;
+  void execute(unsigned begin, unsigned end, unsigned)
+  {
+    for (unsigned i = begin; i<end; ++i)
+      ids_[i] = index_->cell(dirs_[i]);
+  }
+};
+
+void vsph_healpix_index::cells(std::vector<vgl_vector_3d<double> > const& dirs,
+                               std::vector<unsigned>& ids, unsigned n_threads) const
+{
+  ids.resize(dirs.size());
+  if (dirs.empty())
+    return;
+  vsph_healpix_cells_body body;
+  body.index_ = this;
+  body.dirs_ = &dirs[0];
+  body.ids_ = &ids[0];
+  vpl_parallel_for((unsigned)dirs.size(), body, n_threads, 1024);
+}
+
+void vsph_healpix_index::query_disc(vgl_vector_3d<double> const& dir, double radius,
+                                    std::vector<unsigned>& cells, bool inclusive) const
+{
+  cells.clear();
+  if (nside_==0)
+    return;
+  vgl_vector_3d<double> d = normalized(dir);
+  // descend from the base cells into those that may hold a cell of the result
+  std::vector<unsigned> level, next;
+  for (unsigned c = 0; c<12; ++c)
+    level.push_back(c);
+  for (unsigned k = 0; k<order_; ++k) {
+    next.clear();
+    for (unsigned i = 0; i<level.size(); ++i)
+      if (angle(d, centre(level[i], k)) <= radius + max_radius_[k])
+        for (unsigned ch = 0; ch<4; ++ch)
+          next.push_back(4*level[i]+ch);
+    level.swap(next);
+  }
+  double r = inclusive ? radius + max_radius_[order_] : radius;
+  for (unsigned i = 0; i<level.size(); ++i)
+    if (angle(d, centres_[level[i]]) <= r)
+      cells.push_back(level[i]);
+  std::sort(cells.begin(), cells.end());
+}
+
+void vsph_healpix_index::set_points(std::vector<vgl_vector_3d<double> > const& points)
+{
+  unsigned n = n_cells();
+  points_.resize(points.size());
+  std::vector<unsigned> pc(points.size());
+  point_offsets_.assign(n+1, 0);
+  for (unsigned i = 0; i<points.size(); ++i) {
+    points_[i] = normalized(points[i]);
+    pc[i] = cell(points_[i]);
+    ++point_offsets_[pc[i]+1];
+  }
+  for (unsigned c = 0; c<n; ++c)
+    point_offsets_[c+1] += point_offsets_[c];
+  // ids in ascending order within each cell
+  point_ids_.resize(points.size());
+  std::vector<unsigned> fill(point_offsets_.begin(), point_offsets_.end()-1);
+  for (unsigned i = 0; i<points.size(); ++i)
+    point_ids_[fill[pc[i]]++] = i;
+}
+
+int vsph_healpix_index::nearest_point(vgl_vector_3d<double> const& dir) const
+{
+  if (points_.empty())
+    return -1;
+  vgl_vector_3d<double> d = normalized(dir);
+  int best = -1;
+  double best_dot = -2.0;
+  unsigned c = cell(d);
+  for (unsigned k = point_offsets_[c]; k<point_offsets_[c+1]; ++k) {
+    double dt = dot_product(d, points_[point_ids_[k]]);
+    if (dt>best_dot) { best_dot = dt; best = int(point_ids_[k]); }
+  }
+  // every point closer than the best so far lies in a cell that may overlap
+  // the cap through it; widen the cap until it holds a point
+  double r = best>=0 ? angle(d, points_[best]) : 2.0*max_radius_[order_];
+  std::vector<unsigned> cand;
+  while (true) {
+    query_disc(d, r, cand, true);
+    for (unsigned i = 0; i<cand.size(); ++i)
+      for (unsigned k = point_offsets_[cand[i]]; k<point_offsets_[cand[i]+1]; ++k) {
+        int id = int(point_ids_[k]);
+        double dt = dot_product(d, points_[id]);
+        if (dt>best_dot || (dt==best_dot && id<best)) { best_dot = dt; best = id; }
+      }
+    if ((best>=0 && angle(d, points_[best])<=r) || r>=vnl_math::pi)
+      return best;
+    r = std::min(2.0*r, vnl_math::pi);
+  }
+}
+
+//: finds the nearest points of a range of directions
+class vsph_healpix_nearest_body : public vpl_parallel_for_body
+{
+ public:
+  const vsph_healpix_index* index_;
+  const vgl_vector_3d<double>* dirs_;
+  int* ids_;
+  void execute(unsigned begin, unsigned end, unsigned)
+  {
+    for (unsigned i = begin; i<end; ++i)
+      ids_[i] = index_->nearest_point(dirs_[i]);
+  }
+};
+
+void vsph_healpix_index::nearest_points(std::vector<vgl_vector_3d<double> > const& dirs,
+                                        std::vector<int>& ids, unsigned n_threads) const
+{
+  ids.resize(dirs.size());
+  if (dirs.empty())
+    return;
+  vsph_healpix_nearest_body body;
+  body.index_ = this;
+  body.dirs_ = &dirs[0];
+  body.ids_ = &ids[0];
+  vpl_parallel_for((unsigned)dirs.size(), body, n_threads, 64);
+}
@@ -0,0 +1,110 @@
+#ifndef vsph_healpix_index_h_
+#define vsph_healpix_index_h_
+//:
+// \file
+// \brief  A hierarchical equal area index of directions on the unit sphere
+//
+//  The cells are those of the HEALPix pixelization in the nested scheme:
+//  twelve base cells (four about each pole and four about the equator),
+//  each divided into nside x nside cells with nside = 2^order.  All cells
+//  have the same area, so unlike a grid over (theta, phi) the index does
+//  not degrade near the poles.  A direction is mapped to its cell in
+//  constant time, and the cell ids are nested, i.e. cell c at order k
+//  lies in cell c>>2 at order k-1.
+//
+//  The index can also hold a set of points on the sphere (e.g. the
+//  vertices of a vsph_unit_sphere) bucketed by cell, for exact nearest
+//  point queries that visit only the cells near the query direction.
+//
+// \verbatim
+//  Modifications
+//   None
+// \endverbatim
+#include <vector>
+#include <vgl/vgl_vector_3d.h>
+#include "vsph_sph_point_2d.h"
+#include <vcl_compiler.h>
+
+class vsph_healpix_index
+{
+ public:
+  //: an empty index
+  vsph_healpix_index(): order_(0), nside_(0) {}
+
+  //: an index of 12*4^order cells, 0 <= order <= 13
+  explicit vsph_healpix_index(unsigned order);
+
+  //: the lowest order whose cells are at most \p cell_angle (radians) across
+  static unsigned order_for_angle(double cell_angle);
+
+  unsigned order() const { return order_; }
+  unsigned nside() const { return nside_; }
+  unsigned n_cells() const { return 12*nside_*nside_; }
+
+  //: the cell containing the direction \p dir, which need not be of unit length
+  unsigned cell(vgl_vector_3d<double> const& dir) const;
+
+  //: the cell containing a spherical point, in radians or degrees
+  unsigned cell(vsph_sph_point_2d const& sp) const;
+
+  //: the cells of a batch of directions, on up to \p n_threads threads (0 means one per processor)
+  void cells(std::vector<vgl_vector_3d<double> > const& dirs,
+             std::vector<unsigned>& ids, unsigned n_threads = 0) const;
+
+  //: the unit vector at the centre of \p cell
+  vgl_vector_3d<double> const& centre(unsigned cell) const { return centres_[cell]; }
+
+  //: the cell at the lower order \p order that contains \p cell
+  unsigned parent(unsigned cell, unsigned order) const { return cell >> (2*(order_-order)); }
+
+  //: the cells sharing an edge or a corner with \p cell, in ascending order
+  //  Points at 8 ids; the last is -1 for the 24 cells at the corners where
+  //  only three base cells meet.
+  const int* neighbours(unsigned cell) const { return &neighbours_[8*cell]; }
+
+  //: an upper bound on the angle between the centre of a cell at \p order and any point of it
+  double max_cell_radius(unsigned order) const { return max_radius_[order]; }
+  double max_cell_radius() const { return max_radius_[order_]; }
+
+  //: the cells with centre within \p radius (radians) of \p dir, in ascending order
+  //  If \p inclusive is true, all the cells that may overlap the spherical cap instead.
+  void query_disc(vgl_vector_3d<double> const& dir, double radius,
+                  std::vector<unsigned>& cells, bool inclusive = false) const;
+
+  //: bucket \p points by cell for nearest_point(); they need not be of unit length
+  void set_points(std::vector<vgl_vector_3d<double> > const& points);
+
+  unsigned n_points() const { return (unsigned)points_.size(); }
+
+  //: the number of points in \p cell and their ids
+  unsigned n_points_in(unsigned cell) const { return point_offsets_[cell+1]-point_offsets_[cell]; }
+  const unsigned* points_in(unsigned cell) const { return &point_ids_[0] + point_offsets_[cell]; }
+
+  //: the id of the point at the smallest angle from \p dir, the lowest id on ties; -1 if there are no points
+  int nearest_point(vgl_vector_3d<double> const& dir) const;
+
+  //: nearest_point() of a batch of directions, on up to \p n_threads threads (0 means one per processor)
+  void nearest_points(std::vector<vgl_vector_3d<double> > const& dirs,
+                      std::vector<int>& ids, unsigned n_threads = 0) const;
+
+  //: the unit vector at face co-ordinates (x,y) in [0,1]x[0,1] of base cell \p face
+  static vgl_vector_3d<double> face_point(unsigned face, double x, double y);
+
+ private:
+  //: the cell of a unit vector
+  unsigned cell_unit(double x, double y, double z) const;
+  //: the centre of \p cell at \p order <= order_
+  static vgl_vector_3d<double> centre(unsigned cell, unsigned order);
+
+  unsigned order_;
+  unsigned nside_;
+  std::vector<vgl_vector_3d<double> > centres_;
+  std::vector<int> neighbours_;
+  std::vector<double> max_radius_;
+  // the bucketed points
+  std::vector<vgl_vector_3d<double> > points_;
+  std::vector<unsigned> point_offsets_;
+  std::vector<unsigned> point_ids_;
+};
+
+#endif // vsph_healpix_index_h_
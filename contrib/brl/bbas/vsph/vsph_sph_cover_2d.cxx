@@ -17,6 +17,20 @@ inside_area(vsph_sph_box_2d const& bb,
   return inside_area;
 }
 
+double vsph_sph_cover_2d::
+inside_area(vsph_sph_box_2d const& bb,
+            std::vector<vsph_sph_point_2d> const& region_rays,
+            std::vector<unsigned> const& ids,
+            double ray_area, std::vector<unsigned>& inside_ids) const
+{
+  inside_ids.clear();
+  for (std::vector<unsigned>::const_iterator iit = ids.begin();
+       iit != ids.end(); ++iit)
+    if (bb.contains(region_rays[*iit]))
+      inside_ids.push_back(*iit);
+  return inside_ids.size()*ray_area;
+}
+
 vsph_sph_cover_2d::
 vsph_sph_cover_2d(vsph_sph_box_2d const& cover_bb,
                   std::vector<vsph_sph_point_2d> const& region_rays,
@@ -26,12 +40,17 @@ vsph_sph_cover_2d(vsph_sph_box_2d const& cover_bb,
 {
   double total_area = cover_bb.area();
   assert(total_area > 0.0);
-  double inside_ar = this->inside_area(cover_bb, region_rays, ray_area);
+  std::vector<unsigned> all_ids(region_rays.size()), inside_ids;
+  for (unsigned i = 0; i<all_ids.size(); ++i)
+    all_ids[i] = i;
+  double inside_ar = this->inside_area(cover_bb, region_rays, all_ids, ray_area, inside_ids);
   double area_fraction = inside_ar/total_area;
   if (area_fraction>=min_area_fraction) {
     return;//no sub-boxes
   }
   cover_.push_back(cover_el(cover_bb, area_fraction));
+  // the region rays inside each box of cover_
+  std::vector<std::vector<unsigned> > cover_ids(1, inside_ids);
   double c_area = 1.0, in_area = 0.0;
 
   std::vector<cover_el> keep;
@@ -39,9 +58,11 @@ vsph_sph_cover_2d(vsph_sph_box_2d const& cover_bb,
   while (sub_divide) {
     sub_divide = false;
     std::vector<cover_el> temp;
+    std::vector<std::vector<unsigned> > temp_ids;
     for (std::vector<cover_el>::iterator cit = cover_.begin();
          cit != cover_.end(); ++cit)
     {
+      std::vector<unsigned> const& ids = cover_ids[cit-cover_.begin()];
       area_fraction = (*cit).frac_inside_;
       if (area_fraction == 0.0)
         continue;
@@ -55,14 +76,16 @@ vsph_sph_cover_2d(vsph_sph_box_2d const& cover_bb,
            bit != sub_regions.end(); ++bit) {
         c_area = (*bit).area();
         assert(c_area>0.0);
-        in_area = inside_area(*bit, region_rays, ray_area);
+        in_area = inside_area(*bit, region_rays, ids, ray_area, inside_ids);
         area_fraction = in_area/c_area;
         temp.push_back(cover_el(*bit, area_fraction));
+        temp_ids.push_back(inside_ids);
       }
     }
     if (sub_divide){
       cover_.clear();
       cover_ = temp;
+      cover_ids.swap(temp_ids);
     }
   }
   //all done, add the kept boxes to the cover
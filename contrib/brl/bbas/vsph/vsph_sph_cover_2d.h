@@ -9,7 +9,7 @@
 // \date March 2, 2013
 // \verbatim
 //  Modifications
-// None
+//   Subdivision tests only the region rays found in the parent box
 // \endverbatim
 // The parameter, min_area_fraction, determines if a box in the cover is to
 // be subdivided. Boxes containing a fractional area of the spherical region
@@ -70,6 +70,12 @@ class vsph_sph_cover_2d
   double inside_area(vsph_sph_box_2d const& bb,
                      std::vector<vsph_sph_point_2d> const& region_rays,
                      double ray_area) const;
+  //: the area inside the region of the rays \p ids in \p bb, and the ids of those rays
+  //  A sub-box lies inside its parent, so only the rays found in the parent need be tested.
+  double inside_area(vsph_sph_box_2d const& bb,
+                     std::vector<vsph_sph_point_2d> const& region_rays,
+                     std::vector<unsigned> const& ids,
+                     double ray_area, std::vector<unsigned>& inside_ids) const;
   //: the enclosing bounding box
   vsph_sph_box_2d cover_bb_;
   //: the minimum overall fractional area allowed
@@ -379,9 +379,13 @@ find_near_equal(vgl_vector_3d<double>const& p, int& id, double tol)
 // construct Cartesian vectors from spherical points
 void vsph_unit_sphere::set_cart_points()
 {
+  cart_pts_.clear();
   for (std::vector<vsph_sph_point_2d>::iterator sit = sph_pts_.begin();
        sit != sph_pts_.end(); ++sit)
     cart_pts_.push_back(cart_coord(*sit));
+  // about one vertex per cell
+  healpix_ = vsph_healpix_index(vsph_healpix_index::order_for_angle(point_angle_/vnl_math::deg_per_rad));
+  healpix_.set_points(cart_pts_);
 }
 
 
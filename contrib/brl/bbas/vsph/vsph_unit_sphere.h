@@ -18,6 +18,7 @@
 #include "vsph_sph_point_2d.h"
 #include "vsph_sph_box_2d.h"
 #include "vsph_grid_index_2d.h"
+#include "vsph_healpix_index.h"
 #include "vsph_defs.h"//DIST_TOL, MARGIN
 #include <vbl/vbl_ref_count.h>
 #include <vgl/vgl_vector_3d.h>
@@ -87,6 +88,18 @@ class vsph_unit_sphere : public vbl_ref_count
   // \returns a const reference
   const std::vector<vgl_vector_3d<double> >& cart_vectors_ref() const { return cart_pts_; }
 
+  //: the id of the vertex at the smallest angle from direction \p dir, -1 if there are none
+  //  Only the vertices in the cells of healpix_index() near \p dir are visited.
+  int nearest_vertex(vgl_vector_3d<double> const& dir) const { return healpix_.nearest_point(dir); }
+
+  //: nearest_vertex() of a batch of directions, on up to \p n_threads threads (0 means one per processor)
+  void nearest_vertices(std::vector<vgl_vector_3d<double> > const& dirs,
+                        std::vector<int>& ids, unsigned n_threads = 0) const
+  { healpix_.nearest_points(dirs, ids, n_threads); }
+
+  //: the vertices bucketed by equal area cells of about point_angle() across
+  const vsph_healpix_index& healpix_index() const { return healpix_; }
+
   //: get the triangle edges
   std::vector<vsph_edge> edges() const {return edges_;}
 
@@ -151,7 +164,7 @@ class vsph_unit_sphere : public vbl_ref_count
   //: eliminate vertices above min_theta and below max_theta in elevation
   void remove_top_and_bottom();
 
-  //: construct Cartesian vectors from spherical points
+  //: construct Cartesian vectors from spherical points, and the healpix index of them
   void set_cart_points();
 
   bool find_near_equal(vgl_vector_3d<double>const& p,int& id,double tol=DIST_TOL);
@@ -165,6 +178,7 @@ class vsph_unit_sphere : public vbl_ref_count
   std::vector<int> equivalent_ids_;
   std::vector<std::set<int> > neighbors_;
   vsph_grid_index_2d index_;
+  vsph_healpix_index healpix_;
  private:
   bool neighbors_valid_;
   //: these angles are stored in degrees for convenient interpretation
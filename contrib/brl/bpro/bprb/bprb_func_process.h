@@ -47,6 +47,12 @@ class bprb_func_process: public bprb_process_ext
 
   void set_finish_func(bool(*fpt)(bprb_func_process&)) { fpt_finish_ = fpt; }
 
+  //: true if an init function is set; init() returns false without one
+  bool has_init_func() const { return fpt_init_ != 0; }
+
+  //: true if a finish function is set; finish() returns false without one
+  bool has_finish_func() const { return fpt_finish_ != 0; }
+
   virtual std::string name() const { return name_; }
 
   template <class T>
@@ -55,6 +55,7 @@ bprb_batch_process_manager::register_process( bprb_process_sptr( new bprb_func_p
   r_##T##_types[0]=brdb_value_t<unsigned>::type(); \
   r_##T##_types[1]=brdb_value_t<T>::type(); \
   brdb_relation_sptr r_##T  = new brdb_relation(r_##T##_names,r_##T##_types); \
+  r_##T->create_index("id"); \
   DATABASE->add_relation(s##T, r_##T); \
   }
 
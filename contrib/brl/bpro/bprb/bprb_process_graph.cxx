@@ -0,0 +1,386 @@
+// This is brl/bpro/bprb/bprb_process_graph.cxx
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include "bprb_process_graph.h"
+//:
+// \file
+#include <bprb/bprb_process.h>
+#include <bprb/bprb_func_process.h>
+#include <bprb/bprb_batch_process_manager.h>
+#include <brdb/brdb_value.h>
+#include <vul/vul_timer.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+#include <vxl_config.h>
+
+#if VXL_HAS_PTHREAD_H
+#include <pthread.h>
+#endif
+
+//: The worker threads and the lock over the state of the nodes
+struct bprb_process_graph::sync
+{
+  sync()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_mutex_init(&mutex, VXL_NULLPTR);
+    pthread_cond_init(&changed, VXL_NULLPTR);
+#endif
+  }
+  ~sync()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&mutex);
+#endif
+  }
+  void lock()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_mutex_lock(&mutex);
+#endif
+  }
+  void unlock()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_mutex_unlock(&mutex);
+#endif
+  }
+  //: wait for a change of state, with the lock held
+  void wait()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_cond_wait(&changed, &mutex);
+#endif
+  }
+  void broadcast()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_cond_broadcast(&changed);
+#endif
+  }
+
+#if VXL_HAS_PTHREAD_H
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+  std::vector<pthread_t> threads;
+#endif
+  vul_timer clock;
+};
+
+bool bprb_process_future::ready() const
+{
+  bprb_process_graph::status s = graph_->node_status(node_);
+  return s != bprb_process_graph::NOT_RUN && s != bprb_process_graph::RUNNING;
+}
+
+brdb_value_sptr bprb_process_future::get() const
+{
+  return graph_->wait_for(node_, output_);
+}
+
+bprb_process_graph::bprb_process_graph()
+: n_remaining_(0), running_(false), failed_(false), total_time_(0.0), sync_(new sync)
+{
+}
+
+bprb_process_graph::~bprb_process_graph()
+{
+  this->wait();
+  delete sync_;
+}
+
+unsigned bprb_process_graph::add_process(bprb_process_sptr const& process)
+{
+  node n;
+  n.process = process;
+  unsigned n_in = process->n_inputs();
+  n.values.resize(n_in);
+  n.source_nodes.resize(n_in, -1);
+  n.source_outputs.resize(n_in, 0);
+  nodes_.push_back(n);
+  return (unsigned)nodes_.size()-1;
+}
+
+int bprb_process_graph::add_process(std::string const& name)
+{
+  bprb_process_sptr p = bprb_batch_process_manager::instance()->get_process_by_name(name);
+  if (!p) {
+    std::cout << "In bprb_process_graph::add_process(.) - process " << name << " is not registered\n";
+    return -1;
+  }
+  return (int)this->add_process(bprb_process_sptr(p->clone()));
+}
+
+bool bprb_process_graph::set_input(unsigned node, unsigned i, brdb_value_sptr const& value)
+{
+  if (node >= nodes_.size() || i >= nodes_[node].values.size() || !value) {
+    std::cout << "In bprb_process_graph::set_input(.) - no input " << i << " of process " << node << '\n';
+    return false;
+  }
+  if (value->is_a() != nodes_[node].process->input_type(i)) {
+    std::cout << "In bprb_process_graph::set_input(.) - type mismatch, " << value->is_a() << " for input "
+             << i << " of " << nodes_[node].process->name() << " of type " << nodes_[node].process->input_type(i) << '\n';
+    return false;
+  }
+  nodes_[node].values[i] = value;
+  nodes_[node].source_nodes[i] = -1;
+  return true;
+}
+
+bool bprb_process_graph::set_input(unsigned node, unsigned i, bprb_process_future const& source)
+{
+  unsigned from = source.node(), o = source.output();
+  if (node >= nodes_.size() || i >= nodes_[node].values.size() || source.graph() != this ||
+      from >= nodes_.size() || o >= nodes_[from].process->n_outputs()) {
+    std::cout << "In bprb_process_graph::set_input(.) - invalid connection to input " << i << " of process " << node << '\n';
+    return false;
+  }
+  if (nodes_[from].process->output_type(o) != nodes_[node].process->input_type(i)) {
+    std::cout << "In bprb_process_graph::set_input(.) - type mismatch, output " << o << " of "
+             << nodes_[from].process->name() << " is " << nodes_[from].process->output_type(o)
+             << ", input " << i << " of " << nodes_[node].process->name() << " is " << nodes_[node].process->input_type(i) << '\n';
+    return false;
+  }
+  nodes_[node].values[i] = VXL_NULLPTR;
+  nodes_[node].source_nodes[i] = (int)from;
+  nodes_[node].source_outputs[i] = o;
+  return true;
+}
+
+unsigned bprb_process_graph::connect(unsigned from, unsigned to)
+{
+  if (from >= nodes_.size() || to >= nodes_.size())
+    return 0;
+  node& n = nodes_[to];
+  std::vector<std::string> const& out_types = nodes_[from].process->output_types();
+  std::vector<bool> used(out_types.size(), false);
+  // outputs of from already connected to this process are used
+  for (unsigned i = 0; i < n.values.size(); ++i)
+    if (n.source_nodes[i] == (int)from)
+      used[n.source_outputs[i]] = true;
+  unsigned n_connected = 0;
+  for (unsigned i = 0; i < n.values.size(); ++i) {
+    if (n.values[i] || n.source_nodes[i] >= 0)
+      continue;
+    std::string const& type = n.process->input_type(i);
+    for (unsigned o = 0; o < out_types.size(); ++o)
+      if (!used[o] && out_types[o] == type) {
+        used[o] = true;
+        n.source_nodes[i] = (int)from;  n.source_outputs[i] = o;
+        ++n_connected;
+        break;
+      }
+  }
+  return n_connected;
+}
+
+bprb_process_graph::status bprb_process_graph::node_status(unsigned node) const
+{
+  sync_->lock();
+  status s = nodes_[node].state;
+  sync_->unlock();
+  return s;
+}
+
+brdb_value_sptr bprb_process_graph::wait_for(unsigned n, unsigned o)
+{
+  sync_->lock();
+  while (running_ && (nodes_[n].state == NOT_RUN || nodes_[n].state == RUNNING))
+    sync_->wait();
+  brdb_value_sptr v = nodes_[n].state == SUCCEEDED ? nodes_[n].process->output(o) : brdb_value_sptr(VXL_NULLPTR);
+  sync_->unlock();
+  return v;
+}
+
+bool bprb_process_graph::start(unsigned n_threads)
+{
+  this->wait();
+  unsigned n = (unsigned)nodes_.size();
+  // the consumers of each process, and the processes with nothing to wait for
+  for (unsigned k = 0; k < n; ++k) {
+    nodes_[k].consumers.clear();
+    nodes_[k].state = NOT_RUN;
+    nodes_[k].start_time = nodes_[k].run_time = 0.0;
+  }
+  ready_.clear();
+  for (unsigned k = 0; k < n; ++k) {
+    std::vector<int> sources;
+    for (unsigned i = 0; i < nodes_[k].source_nodes.size(); ++i)
+      if (nodes_[k].source_nodes[i] >= 0)
+        sources.push_back(nodes_[k].source_nodes[i]);
+    std::sort(sources.begin(), sources.end());
+    sources.erase(std::unique(sources.begin(), sources.end()), sources.end());
+    nodes_[k].n_waiting = (unsigned)sources.size();
+    for (unsigned s = 0; s < sources.size(); ++s)
+      nodes_[sources[s]].consumers.push_back(k);
+    if (sources.empty())
+      ready_.push_back(k);
+  }
+  // a cycle leaves some processes unreachable from the ready ones
+  std::vector<unsigned> waiting(n), queue(ready_);
+  for (unsigned k = 0; k < n; ++k)
+    waiting[k] = nodes_[k].n_waiting;
+  for (unsigned q = 0; q < queue.size(); ++q)
+    for (unsigned c = 0; c < nodes_[queue[q]].consumers.size(); ++c)
+      if (--waiting[nodes_[queue[q]].consumers[c]] == 0)
+        queue.push_back(nodes_[queue[q]].consumers[c]);
+  if (queue.size() < n) {
+    std::cout << "In bprb_process_graph::start(.) - the process graph has a cycle\n";
+    return false;
+  }
+  // the lowest ids first
+  std::reverse(ready_.begin(), ready_.end());
+  n_remaining_ = n;
+  failed_ = false;
+  running_ = true;
+  sync_->clock.mark();
+
+  unsigned n_workers = std::min(vpl_parallel_for_num_threads(n_threads), std::max(n, 1u));
+#if VXL_HAS_PTHREAD_H
+  sync_->threads.resize(n_workers);
+  unsigned n_started = 0;
+  for (; n_started < n_workers; ++n_started)
+    if (pthread_create(&sync_->threads[n_started], VXL_NULLPTR, &bprb_process_graph::thread_main, this) != 0)
+      break;
+  sync_->threads.resize(n_started);
+  if (n_started > 0)
+    return true;
+#endif
+  (void)n_workers;
+  this->work();
+  return true;
+}
+
+bool bprb_process_graph::wait()
+{
+  if (!running_)
+    return !failed_;
+#if VXL_HAS_PTHREAD_H
+  for (unsigned t = 0; t < sync_->threads.size(); ++t)
+    pthread_join(sync_->threads[t], VXL_NULLPTR);
+  sync_->threads.clear();
+#endif
+  sync_->lock();
+  running_ = false;
+  total_time_ = sync_->clock.real()/1000.0;
+  sync_->broadcast();
+  sync_->unlock();
+  return !failed_;
+}
+
+bool bprb_process_graph::run(unsigned n_threads)
+{
+  return this->start(n_threads) && this->wait();
+}
+
+void* bprb_process_graph::thread_main(void* self)
+{
+  static_cast<bprb_process_graph*>(self)->work();
+  return VXL_NULLPTR;
+}
+
+void bprb_process_graph::work()
+{
+  sync_->lock();
+  while (true) {
+    while (ready_.empty() && n_remaining_ > 0)
+      sync_->wait();
+    if (n_remaining_ == 0)
+      break;
+    unsigned n = ready_.back();
+    ready_.pop_back();
+    nodes_[n].state = RUNNING;
+    nodes_[n].start_time = sync_->clock.real()/1000.0;
+    sync_->unlock();
+
+    vul_timer t;
+    status s = this->execute(n);
+    double run_time = t.real()/1000.0;
+
+    sync_->lock();
+    nodes_[n].state = s;
+    nodes_[n].run_time = run_time;
+    --n_remaining_;
+    if (s != SUCCEEDED)
+      failed_ = true;
+    // pass on to the consumers, which are skipped if this one did not succeed
+    std::vector<unsigned> done(1, n);
+    for (unsigned d = 0; d < done.size(); ++d) {
+      node& dn = nodes_[done[d]];
+      for (unsigned c = 0; c < dn.consumers.size(); ++c) {
+        node& cn = nodes_[dn.consumers[c]];
+        if (cn.state != NOT_RUN)
+          continue;
+        if (dn.state != SUCCEEDED) {
+          cn.state = SKIPPED;
+          --n_remaining_;
+          done.push_back(dn.consumers[c]);
+        }
+        else if (--cn.n_waiting == 0)
+          ready_.insert(ready_.begin(), dn.consumers[c]);
+      }
+    }
+    sync_->broadcast();
+  }
+  sync_->unlock();
+}
+
+bprb_process_graph::status bprb_process_graph::execute(unsigned n)
+{
+  // the sources of the inputs have finished, so their outputs can be read without the lock
+  node& nd = nodes_[n];
+  for (unsigned i = 0; i < nd.values.size(); ++i) {
+    brdb_value_sptr v = nd.source_nodes[i] >= 0 ? nodes_[nd.source_nodes[i]].process->output(nd.source_outputs[i]) : nd.values[i];
+    if (!v) {
+      std::cout << "In bprb_process_graph::execute(.) - input " << i << " of " << nd.process->name() << " is not set\n";
+      return FAILED;
+    }
+    if (!nd.process->set_input(i, v))
+      return FAILED;
+  }
+  // init() and finish() are called around execute() as the batch process manager does;
+  // a function process without an init or a finish function returns false from them
+  bprb_func_process* fp = dynamic_cast<bprb_func_process*>(nd.process.ptr());
+  if ((!fp || fp->has_init_func()) && !nd.process->init()) {
+    std::cout << "In bprb_process_graph::execute(.) - init of " << nd.process->name() << " failed\n";
+    return FAILED;
+  }
+  if (!nd.process->execute())
+    return FAILED;
+  if ((!fp || fp->has_finish_func()) && !nd.process->finish()) {
+    std::cout << "In bprb_process_graph::execute(.) - finish of " << nd.process->name() << " failed\n";
+    return FAILED;
+  }
+  return SUCCEEDED;
+}
+
+//: orders the processes by decreasing run time
+class bprb_process_graph_slower
+{
+ public:
+  bprb_process_graph_slower(bprb_process_graph const& g) : g_(g) {}
+  bool operator()(unsigned a, unsigned b) const { return g_.run_time(a) > g_.run_time(b); }
+ private:
+  bprb_process_graph const& g_;
+};
+
+void bprb_process_graph::print_profile(std::ostream& os) const
+{
+  static const char* status_names[] = { "not run", "running", "succeeded", "failed", "skipped" };
+  std::vector<unsigned> order(nodes_.size());
+  double busy = 0.0;
+  for (unsigned k = 0; k < nodes_.size(); ++k) {
+    order[k] = k;
+    busy += nodes_[k].run_time;
+  }
+  std::stable_sort(order.begin(), order.end(), bprb_process_graph_slower(*this));
+  os << nodes_.size() << " processes in " << total_time_ << " s, " << busy << " s of execution\n"
+     << "    id  status        start(s)   time(s)  process\n";
+  for (unsigned k = 0; k < order.size(); ++k) {
+    node const& nd = nodes_[order[k]];
+    os << std::setw(6) << order[k] << "  " << std::setw(10) << std::left << status_names[nd.state] << std::right
+       << std::setw(10) << nd.start_time << std::setw(10) << nd.run_time << "  " << nd.process->name() << '\n';
+  }
+}
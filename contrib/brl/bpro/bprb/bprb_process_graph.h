@@ -0,0 +1,160 @@
+// This is brl/bpro/bprb/bprb_process_graph.h
+#ifndef bprb_process_graph_h_
+#define bprb_process_graph_h_
+//:
+// \file
+// \brief A graph of processes whose independent processes are executed concurrently
+//
+//  The batch process manager executes one process at a time, and passes
+//  data between them through the brdb database.  A process graph instead
+//  holds several process instances, each with its inputs given either as
+//  values or as outputs of other processes in the graph.  The outputs are
+//  passed on directly, and run() executes every process as soon as the
+//  processes it depends on have finished, on a pool of threads.  As in the
+//  batch process manager, init() is called before execute() and finish()
+//  after it, on the same thread; a process fails if either returns false,
+//  except for a bprb_func_process without an init or a finish function.
+//
+//  Connections are checked against the input and output types declared by
+//  the processes, and connect(from, to) resolves them from the types alone.
+//  The result of a process output can be held as a bprb_process_future
+//  before the graph runs; get() waits for it while the graph runs in the
+//  background (start() and wait()).  The start time and duration of each
+//  execution are recorded, and print_profile() lists them.
+//
+//  Each process in the graph must be a separate instance, e.g. a clone()
+//  of a registered process (see add_process(std::string)), and processes
+//  that run concurrently must not share unprotected state.
+//
+// \verbatim
+//  Modifications
+//   None
+// \endverbatim
+
+#include <vector>
+#include <iostream>
+#include <string>
+#include <vcl_compiler.h>
+#include <vbl/vbl_ref_count.h>
+#include <bprb/bprb_process_sptr.h>
+#include <brdb/brdb_value_sptr.h>
+
+class bprb_process_graph;
+
+//: The future value of an output of a process in a bprb_process_graph
+class bprb_process_future
+{
+ public:
+  bprb_process_future() : graph_(VXL_NULLPTR), node_(0), output_(0) {}
+  bprb_process_future(bprb_process_graph* graph, unsigned node, unsigned output)
+  : graph_(graph), node_(node), output_(output) {}
+
+  bool valid() const { return graph_ != VXL_NULLPTR; }
+  unsigned node() const { return node_; }
+  unsigned output() const { return output_; }
+  bprb_process_graph* graph() const { return graph_; }
+
+  //: true once the process has run (whether or not it succeeded)
+  bool ready() const;
+
+  //: the output value, waiting for the process if the graph is running; null if it failed or did not run
+  brdb_value_sptr get() const;
+
+ private:
+  bprb_process_graph* graph_;
+  unsigned node_;
+  unsigned output_;
+};
+
+class bprb_process_graph : public vbl_ref_count
+{
+ public:
+  //: the state of a process in the graph
+  enum status { NOT_RUN = 0, RUNNING, SUCCEEDED, FAILED, SKIPPED };
+
+  bprb_process_graph();
+  ~bprb_process_graph();
+
+  //: add a process instance, returns its id in the graph
+  unsigned add_process(bprb_process_sptr const& process);
+
+  //: add a clone of the process registered with the batch process manager under \p name, returns its id or -1
+  int add_process(std::string const& name);
+
+  unsigned size() const { return (unsigned)nodes_.size(); }
+  bprb_process_sptr process(unsigned node) const { return nodes_[node].process; }
+
+  //: set input \p i of \p node to a value
+  bool set_input(unsigned node, unsigned i, brdb_value_sptr const& value);
+
+  //: set input \p i of \p node to an output of another process, whose declared types must agree
+  bool set_input(unsigned node, unsigned i, bprb_process_future const& source);
+
+  //: connect each unset input of \p to to the first unused output of \p from with the same declared type
+  //  Returns the number of inputs connected.
+  unsigned connect(unsigned from, unsigned to);
+
+  //: the future value of output \p o of \p node
+  bprb_process_future output(unsigned node, unsigned o) { return bprb_process_future(this, node, o); }
+
+  //: execute all the processes on up to \p n_threads threads (0 means one per processor)
+  //  Returns false if the graph has a cycle or a process failed; the
+  //  processes that depend on a failed one are skipped.
+  bool run(unsigned n_threads = 0);
+
+  //: start executing the processes in the background, returns false if the graph has a cycle
+  bool start(unsigned n_threads = 0);
+
+  //: wait for the processes started by start(), returns false if one failed
+  bool wait();
+
+  status node_status(unsigned node) const;
+
+  //: wall clock seconds from the start of the run to the start of the execution of \p node
+  double start_time(unsigned node) const { return nodes_[node].start_time; }
+  //: wall clock seconds spent executing \p node
+  double run_time(unsigned node) const { return nodes_[node].run_time; }
+  //: wall clock seconds of the last run
+  double total_time() const { return total_time_; }
+
+  //: print the status, start and duration of each process, slowest first
+  void print_profile(std::ostream& os) const;
+
+ private:
+  friend class bprb_process_future;
+  struct node
+  {
+    node() : state(NOT_RUN), n_waiting(0), start_time(0.0), run_time(0.0) {}
+    bprb_process_sptr process;
+    // per input: a value, or the node and output it comes from (node -1 if none)
+    std::vector<brdb_value_sptr> values;
+    std::vector<int> source_nodes;
+    std::vector<unsigned> source_outputs;
+    std::vector<unsigned> consumers;
+    status state;
+    unsigned n_waiting;
+    double start_time;
+    double run_time;
+  };
+
+  //: the output of \p n, waiting for it while the graph runs
+  brdb_value_sptr wait_for(unsigned n, unsigned o);
+  //: execute the ready processes until none are left
+  void work();
+  //: set the inputs of \p n and init, execute and finish it
+  status execute(unsigned n);
+
+  static void* thread_main(void* self);
+
+  std::vector<node> nodes_;
+  std::vector<unsigned> ready_;
+  unsigned n_remaining_;
+  bool running_;
+  bool failed_;
+  double total_time_;
+  // the threads and their synchronization, defined in the .cxx
+  struct sync;
+  sync* sync_;
+};
+
+#endif // bprb_process_graph_h_
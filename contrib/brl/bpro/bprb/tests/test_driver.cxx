@@ -2,6 +2,7 @@
 
 DECLARE( test_process );
 DECLARE( test_process_params );
+DECLARE( test_process_graph );
 
 void
 register_tests()
@@ -9,6 +10,7 @@ register_tests()
 
   REGISTER( test_process );
   REGISTER( test_process_params );
+  REGISTER( test_process_graph );
 
 }
 
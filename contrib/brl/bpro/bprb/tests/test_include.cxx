@@ -7,6 +7,7 @@
 #include <bpro/bprb/bprb_null_process.h>
 #include <bpro/bprb/bprb_parameters.h>
 #include <bpro/bprb/bprb_process.h>
+#include <bpro/bprb/bprb_process_graph.h>
 #include <bpro/bprb/bprb_process_ext.h>
 #include <bpro/bprb/bprb_process_manager.h>
 
@@ -0,0 +1,238 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <testlib/testlib_test.h>
+#include <brdb/brdb_value.h>
+#include <vcl_compiler.h>
+#include "bprb_test_process.h"
+#include <bprb/bprb_process_graph.h>
+#include <bprb/bprb_batch_process_manager.h>
+#include <bprb/bprb_parameters.h>
+#include <bprb/bprb_macros.h>
+#include <bprb/bprb_func_process.h>
+
+//: A process that fails, or converts its float input to an int, and records the calls of init, execute and finish
+class bprb_test_graph_process : public bprb_process
+{
+ public:
+  bprb_test_graph_process(bool fail, bool fail_init = false) : fail_(fail), fail_init_(fail_init)
+  {
+    input_data_.resize(1);  output_data_.resize(1);
+    input_types_.resize(1, "float");  output_types_.resize(1, "int");
+  }
+  virtual bprb_process* clone() const { return new bprb_test_graph_process(*this); }
+  virtual std::string name() const { return fail_ ? "Fail" : "ToInt"; }
+  virtual bool init() { calls += 'i';  return !fail_init_; }
+  virtual bool execute()
+  {
+    calls += 'e';
+    if (fail_)
+      return false;
+    float v = static_cast<brdb_value_t<float>*>(input_data_[0].ptr())->value();
+    output_data_[0] = new brdb_value_t<int>(int(v));
+    return true;
+  }
+  virtual bool finish() { calls += 'f';  return true; }
+  //: the calls of init ('i'), execute ('e') and finish ('f'), in order
+  std::string calls;
+ private:
+  bool fail_;
+  bool fail_init_;
+};
+
+//: a function process that adds 1 to its float input, with optional init and finish functions
+static bool bprb_test_func_cons(bprb_func_process& pro)
+{
+  std::vector<std::string> in(1, "float"), out(1, "float");
+  return pro.set_input_types(in) && pro.set_output_types(out);
+}
+static bool bprb_test_func_execute(bprb_func_process& pro)
+{
+  pro.set_output_val<float>(0, pro.get_input<float>(0) + 1.0f);
+  return true;
+}
+static bool bprb_test_func_finish(bprb_func_process& pro)
+{
+  // the output of execute is there when finish is called
+  return pro.output(0);
+}
+
+static float float_value(brdb_value_sptr const& v)
+{
+  return v ? static_cast<brdb_value_t<float>*>(v.ptr())->value() : -1.0f;
+}
+
+//: a diamond: a = 1+2+4, b = a+a+4, c = a+1+4, d = b+c+4
+static void build_diamond(bprb_process_graph& g)
+{
+  int a = g.add_process("Process");
+  int b = g.add_process("Process");
+  int c = g.add_process("Process");
+  int d = g.add_process("Process");
+  g.set_input(a, 0, new brdb_value_t<float>(1.0f));
+  g.set_input(a, 1, new brdb_value_t<float>(2.0f));
+  g.set_input(b, 0, g.output(a, 0));
+  g.set_input(b, 1, g.output(a, 0));
+  g.set_input(c, 0, g.output(a, 0));
+  g.set_input(c, 1, new brdb_value_t<float>(1.0f));
+  g.set_input(d, 0, g.output(b, 0));
+  g.set_input(d, 1, g.output(c, 0));
+}
+
+static void test_process_graph()
+{
+  REG_PROCESS(bprb_test_process, bprb_batch_process_manager);
+  REGISTER_DATATYPE(float);
+
+  // the same results on one and on several threads
+  for (unsigned n_threads = 1; n_threads <= 4; n_threads += 3)
+  {
+    std::cout << "diamond on " << n_threads << " threads\n";
+    bprb_process_graph g;
+    build_diamond(g);
+    TEST("four processes", g.size(), 4);
+    bprb_process_future fd = g.output(3, 0);
+    TEST("not ready before run", fd.ready(), false);
+    TEST("run", g.run(n_threads), true);
+    TEST("ready after run", fd.ready(), true);
+    TEST_NEAR("a", float_value(g.output(0, 0).get()), 7.0f, 1e-6);
+    TEST_NEAR("b", float_value(g.output(1, 0).get()), 18.0f, 1e-6);
+    TEST_NEAR("c", float_value(g.output(2, 0).get()), 12.0f, 1e-6);
+    TEST_NEAR("d", float_value(fd.get()), 34.0f, 1e-6);
+    bool all_succeeded = true, ordered = true;
+    for (unsigned k = 0; k < g.size(); ++k)
+      all_succeeded = all_succeeded && g.node_status(k) == bprb_process_graph::SUCCEEDED;
+    // the consumers start after their producers
+    ordered = g.start_time(1) >= g.start_time(0) + g.run_time(0) &&
+              g.start_time(3) >= g.start_time(2) + g.run_time(2);
+    TEST("all succeeded", all_succeeded, true);
+    TEST("dependencies respected", ordered, true);
+    TEST("total time", g.total_time() >= 0.0, true);
+    std::stringstream ss;
+    g.print_profile(ss);
+    TEST("profile lists the processes", ss.str().find("Process") != std::string::npos, true);
+
+    // running again gives the same results
+    g.set_input(0, 0, new brdb_value_t<float>(2.0f));
+    TEST("run again", g.run(n_threads), true);
+    TEST_NEAR("d again", float_value(fd.get()), 37.0f, 1e-6);
+  }
+
+  // futures in the background
+  {
+    bprb_process_graph g;
+    build_diamond(g);
+    bprb_process_future fd = g.output(3, 0);
+    TEST("start", g.start(2), true);
+    TEST_NEAR("future while running", float_value(fd.get()), 34.0f, 1e-6);
+    TEST("wait", g.wait(), true);
+  }
+
+  // connections are checked against the declared types
+  {
+    bprb_process_graph g;
+    int a = g.add_process("Process");
+    unsigned t = g.add_process(new bprb_test_graph_process(false));
+    int b = g.add_process("Process");
+    TEST("unknown process", g.add_process("NoSuchProcess"), -1);
+    TEST("float to float", g.set_input(t, 0, g.output(a, 0)), true);
+    TEST("int to float rejected", g.set_input(b, 0, g.output(t, 0)), false);
+    TEST("int value to float rejected", g.set_input(b, 0, new brdb_value_t<int>(1)), false);
+    TEST("no such input", g.set_input(t, 1, g.output(a, 0)), false);
+
+    // a chain connected from the types: the two inputs take the one output of a once
+    bprb_process_graph chain;
+    unsigned p0 = chain.add_process("Process"), p1 = chain.add_process("Process");
+    chain.set_input(p0, 0, new brdb_value_t<float>(1.0f));
+    chain.set_input(p0, 1, new brdb_value_t<float>(1.0f));
+    chain.set_input(p1, 1, new brdb_value_t<float>(0.5f));
+    TEST("connect by type", chain.connect(p0, p1), 1);
+    TEST("nothing left to connect", chain.connect(p0, p1), 0);
+    TEST("run chain", chain.run(), true);
+    TEST_NEAR("chain result", float_value(chain.output(p1, 0).get()), 10.5f, 1e-6);
+  }
+
+  // a cycle is not run
+  {
+    bprb_process_graph g;
+    unsigned a = g.add_process("Process"), b = g.add_process("Process");
+    g.set_input(a, 1, new brdb_value_t<float>(1.0f));
+    g.set_input(b, 1, new brdb_value_t<float>(1.0f));
+    g.connect(a, b);
+    g.connect(b, a);
+    TEST("cycle rejected", g.run(2), false);
+    TEST("cycle not run", g.node_status(a), bprb_process_graph::NOT_RUN);
+  }
+
+  // the processes after a failure are skipped, the independent ones still run
+  {
+    bprb_process_graph g;
+    unsigned a = g.add_process("Process");
+    unsigned f = g.add_process(new bprb_test_graph_process(true));
+    unsigned b = g.add_process(new bprb_test_graph_process(false));
+    unsigned c = g.add_process("Process");
+    unsigned d = g.add_process("Process");
+    g.set_input(a, 0, new brdb_value_t<float>(1.0f));
+    g.set_input(a, 1, new brdb_value_t<float>(1.0f));
+    g.set_input(f, 0, g.output(a, 0));
+    g.set_input(b, 0, g.output(a, 0));
+    g.set_input(c, 0, new brdb_value_t<float>(1.0f));
+    g.set_input(c, 1, new brdb_value_t<float>(1.0f));
+    // d depends on c and on nothing set for input 1: it fails
+    g.set_input(d, 0, g.output(c, 0));
+    TEST("run with failures", g.run(3), false);
+    TEST("failed", g.node_status(f), bprb_process_graph::FAILED);
+    TEST("independent ran", g.node_status(b), bprb_process_graph::SUCCEEDED);
+    TEST("unset input fails", g.node_status(d), bprb_process_graph::FAILED);
+    TEST("failed future is null", !g.output(f, 0).get(), true);
+
+    bprb_process_graph other;
+    unsigned o = other.add_process("Process");
+    TEST("connection from another graph rejected", other.set_input(o, 0, g.output(a, 0)), false);
+  }
+
+  // init and finish are called around execute
+  {
+    bprb_process_graph g;
+    bprb_test_graph_process* p = new bprb_test_graph_process(false);
+    bprb_test_graph_process* bad_init = new bprb_test_graph_process(false, true);
+    unsigned a = g.add_process(p), b = g.add_process(bad_init);
+    g.set_input(a, 0, new brdb_value_t<float>(1.5f));
+    g.set_input(b, 0, new brdb_value_t<float>(1.5f));
+    TEST("run with a failing init", g.run(2), false);
+    TEST("init, execute, finish", p->calls, "ief");
+    TEST("not executed after a failed init", bad_init->calls == "i" && g.node_status(b) == bprb_process_graph::FAILED, true);
+
+    // a function process without init or finish functions runs, one with a finish function has it called
+    bprb_process_graph fg;
+    unsigned f0 = fg.add_process(new bprb_func_process(bprb_test_func_execute, "FuncNoHooks", bprb_test_func_cons, 0, 0));
+    unsigned f1 = fg.add_process(new bprb_func_process(bprb_test_func_execute, "FuncFinish", bprb_test_func_cons, 0,
+                                                       bprb_test_func_finish));
+    fg.set_input(f0, 0, new brdb_value_t<float>(1.0f));
+    fg.set_input(f1, 0, fg.output(f0, 0));
+    TEST("function processes", fg.run(2), true);
+    TEST_NEAR("function process result", float_value(fg.output(f1, 0).get()), 3.0f, 1e-6);
+  }
+
+  // a failure propagates down a chain
+  {
+    bprb_process_graph g;
+    unsigned a = g.add_process("Process");
+    unsigned b = g.add_process("Process");
+    unsigned c = g.add_process("Process");
+    g.set_input(a, 0, new brdb_value_t<float>(1.0f));
+    g.set_input(a, 1, new brdb_value_t<float>(1.0f));
+    g.process(a)->parameters()->set_value("prm1", 1.0f);
+    g.set_input(b, 0, g.output(a, 0));
+    g.set_input(c, 0, g.output(b, 0));
+    g.set_input(c, 1, g.output(a, 0));
+    // input 1 of b is never set, so b fails and c is skipped
+    TEST("run chain with a failure", g.run(2), false);
+    TEST_NEAR("a with its own parameter", float_value(g.output(a, 0).get()), 3.0f, 1e-6);
+    TEST("b failed", g.node_status(b), bprb_process_graph::FAILED);
+    TEST("c skipped", g.node_status(c), bprb_process_graph::SKIPPED);
+    TEST("skipped future is null", !g.output(c, 0).get(), true);
+  }
+}
+
+TESTMAIN(test_process_graph);
@@ -0,0 +1,326 @@
+// This is brl/bseg/bbgm/bbgm_mog3_image.cxx
+#include <vector>
+#include <algorithm>
+#include "bbgm_mog3_image.h"
+//:
+// \file
+#include <vpl/vpl_parallel_for.h>
+#include <vil/algo/vil_structuring_element.h>
+#include <vcl_cassert.h>
+
+namespace
+{
+  //: Copy row j of image into x, interleaved (dim values per pixel)
+  void bbgm_gather_row(vil_image_view<float> const& image, unsigned j, float* x)
+  {
+    const unsigned ni = image.ni(), np = image.nplanes();
+    const std::ptrdiff_t istep = image.istep(), pstep = image.planestep();
+    float const* row = image.top_left_ptr() + j*image.jstep();
+    for (unsigned p = 0; p<np; ++p, row += pstep) {
+      float const* src = row;
+      float* dst = x + p;
+      for (unsigned i = 0; i<ni; ++i, src += istep, dst += np)
+        *dst = *src;
+    }
+  }
+
+  //: Copy the interleaved values of x into row j of image
+  void bbgm_scatter_row(float const* x, unsigned j, vil_image_view<float>& image)
+  {
+    const unsigned ni = image.ni(), np = image.nplanes();
+    const std::ptrdiff_t istep = image.istep(), pstep = image.planestep();
+    float* row = image.top_left_ptr() + j*image.jstep();
+    for (unsigned p = 0; p<np; ++p, row += pstep) {
+      float* dst = row;
+      float const* src = x + p;
+      for (unsigned i = 0; i<ni; ++i, dst += istep, src += np)
+        *dst = *src;
+    }
+  }
+
+  //: A loop over the rows of the image, with interleaved sample and result buffers
+  //  The kernels index the samples by model, so the buffers cover the whole
+  //  image; each row is gathered and scattered by the thread that processes it.
+  struct bbgm_mog3_row_body : public vpl_parallel_for_body
+  {
+    bbgm_mog3_row_body(unsigned x_size, unsigned y_size)
+    : x(x_size), y(y_size) {}
+
+    std::vector<float> x, y;
+  };
+
+  struct bbgm_mog3_update_body : public bbgm_mog3_row_body
+  {
+    bbgm_mog3_update_body(unsigned x_size, unsigned y_size)
+    : bbgm_mog3_row_body(x_size, y_size) {}
+
+    bsta_mog3_soa* soa;
+    vil_image_view<float> const* image;
+    //: weights image, or null for the window updater
+    vil_image_view<float> const* weights;
+    bsta_mog3_update_params const* params;
+
+    void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+    {
+      const unsigned ni = image->ni(), dim = soa->dim();
+      for (unsigned j = begin; j<end; ++j) {
+        bbgm_gather_row(*image, j, &x[j*ni*dim]);
+        if (weights)
+          bbgm_gather_row(*weights, j, &y[j*ni]);
+        bsta_mog3_update(*soa, &x[0], weights ? &y[0] : VXL_NULLPTR, *params, j*ni, (j+1)*ni);
+      }
+    }
+  };
+
+  struct bbgm_mog3_density_body : public bbgm_mog3_row_body
+  {
+    bbgm_mog3_density_body(unsigned x_size, unsigned y_size)
+    : bbgm_mog3_row_body(x_size, y_size) {}
+
+    bsta_mog3_soa const* soa;
+    vil_image_view<float> const* image;
+    vil_image_view<float>* prob;
+
+    void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+    {
+      const unsigned ni = image->ni(), dim = soa->dim();
+      for (unsigned j = begin; j<end; ++j) {
+        bbgm_gather_row(*image, j, &x[j*ni*dim]);
+        bsta_mog3_prob_density(*soa, &x[0], &y[0], j*ni, (j+1)*ni);
+        bbgm_scatter_row(&y[j*ni], j, *prob);
+      }
+    }
+  };
+
+  struct bbgm_mog3_expected_body : public bbgm_mog3_row_body
+  {
+    bbgm_mog3_expected_body(unsigned x_size, unsigned y_size)
+    : bbgm_mog3_row_body(x_size, y_size) {}
+
+    bsta_mog3_soa const* soa;
+    vil_image_view<float>* ev;
+
+    void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+    {
+      const unsigned ni = ev->ni(), dim = soa->dim();
+      for (unsigned j = begin; j<end; ++j) {
+        bsta_mog3_expected_value(*soa, &y[0], j*ni, (j+1)*ni);
+        bbgm_scatter_row(&y[j*ni*dim], j, *ev);
+      }
+    }
+  };
+
+  //: The top weight Mahalanobis detector of model k at sample s
+  //  The sums are accumulated in the order of bsta_gaussian_indep::sqr_mahalanobis_dist
+  inline bool bbgm_mog3_detect_model(bsta_mog3_soa const& soa, unsigned k, float const* s,
+                                     float sqr_thresh, float weight_thresh)
+  {
+    const unsigned dim = soa.dim();
+    const unsigned nc = soa.num_components()[k];
+    float total_weight = 0.0f;
+    for (unsigned c = 0; c<nc; ++c) {
+      if (total_weight > weight_thresh)
+        return false;
+      float d2 = 0.0f;
+      bool valid = true;
+      for (unsigned d = 0; d<dim; ++d) {
+        float v = soa.var(c, d)[k];
+        if (v <= 0.0f) {
+          valid = false;
+          break;
+        }
+        float diff = soa.mean(c, d)[k] - s[d];
+        d2 = diff*diff/v + d2;
+      }
+      if (valid && d2 < sqr_thresh)
+        return true;
+      total_weight += soa.weight(c)[k];
+    }
+    return false;
+  }
+
+  struct bbgm_mog3_detect_body : public bbgm_mog3_row_body
+  {
+    bbgm_mog3_detect_body(unsigned x_size, unsigned y_size)
+    : bbgm_mog3_row_body(x_size, y_size) {}
+
+    bsta_mog3_soa const* soa;
+    vil_image_view<float> const* image;
+    vil_image_view<bool>* result;
+    vil_structuring_element const* se;
+    float sqr_thresh, weight_thresh;
+
+    void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+    {
+      const int ni = image->ni(), nj = image->nj();
+      const unsigned dim = soa->dim();
+      const unsigned size_se = se ? se->p_i().size() : 1;
+      for (unsigned j = begin; j<end; ++j) {
+        float const* xb = &x[j*ni*dim];
+        bbgm_gather_row(*image, j, &x[j*ni*dim]);
+        bool* r = result->top_left_ptr() + j*result->jstep();
+        for (int i = 0; i<ni; ++i, r += result->istep()) {
+          bool detected = false;
+          for (unsigned n = 0; n<size_se && !detected; ++n) {
+            int ri = se ? i + se->p_i()[n] : i;
+            int rj = se ? int(j) + se->p_j()[n] : int(j);
+            if (ri < 0 || ri >= ni || rj < 0 || rj >= nj)
+              continue;
+            detected = bbgm_mog3_detect_model(*soa, unsigned(ri + rj*ni), xb + i*dim,
+                                              sqr_thresh, weight_thresh);
+          }
+          *r = detected;
+        }
+      }
+    }
+  };
+}
+
+bbgm_mog3_image::bbgm_mog3_image(unsigned ni, unsigned nj, unsigned dim)
+  : ni_(ni), nj_(nj), num_threads_(0), soa_(dim, ni*nj)
+{
+  clear();
+}
+
+bbgm_mog3_image::bbgm_mog3_image(bbgm_image_of<bsta_mog3_grey_type> const& img)
+  : ni_(0), nj_(0), num_threads_(0), soa_(1)
+{
+  pack(img);
+}
+
+bbgm_mog3_image::bbgm_mog3_image(bbgm_image_of<bsta_mog3_rgb_type> const& img)
+  : ni_(0), nj_(0), num_threads_(0), soa_(3)
+{
+  pack(img);
+}
+
+//: Zero all parameters; every model is left without components
+void bbgm_mog3_image::clear()
+{
+  const unsigned n = soa_.size();
+  for (unsigned c = 0; c<bsta_mog3_soa::n_comp; ++c) {
+    for (unsigned d = 0; d<soa_.dim(); ++d) {
+      std::fill(soa_.mean(c, d), soa_.mean(c, d) + n, 0.0f);
+      std::fill(soa_.var(c, d), soa_.var(c, d) + n, 0.0f);
+    }
+    std::fill(soa_.weight(c), soa_.weight(c) + n, 0.0f);
+    std::fill(soa_.comp_obs(c), soa_.comp_obs(c) + n, 0.0f);
+  }
+  std::fill(soa_.num_obs(), soa_.num_obs() + n, 0.0f);
+  std::fill(soa_.num_components(), soa_.num_components() + n, 0);
+}
+
+void bbgm_mog3_image::pack(bbgm_image_of<bsta_mog3_grey_type> const& img)
+{
+  ni_ = img.ni();
+  nj_ = img.nj();
+  soa_ = bsta_mog3_soa(1, ni_*nj_);
+  if (ni_*nj_ > 0)
+    bsta_mog3_pack(&*img.begin(), ni_*nj_, soa_);
+}
+
+void bbgm_mog3_image::pack(bbgm_image_of<bsta_mog3_rgb_type> const& img)
+{
+  ni_ = img.ni();
+  nj_ = img.nj();
+  soa_ = bsta_mog3_soa(3, ni_*nj_);
+  if (ni_*nj_ > 0)
+    bsta_mog3_pack(&*img.begin(), ni_*nj_, soa_);
+}
+
+void bbgm_mog3_image::unpack(bbgm_image_of<bsta_mog3_grey_type>& img) const
+{
+  assert(dim() == 1);
+  if (img.ni() != ni_ || img.nj() != nj_)
+    img.set_size(ni_, nj_);
+  if (ni_*nj_ > 0)
+    bsta_mog3_unpack(soa_, &*img.begin(), ni_*nj_);
+}
+
+void bbgm_mog3_image::unpack(bbgm_image_of<bsta_mog3_rgb_type>& img) const
+{
+  assert(dim() == 3);
+  if (img.ni() != ni_ || img.nj() != nj_)
+    img.set_size(ni_, nj_);
+  if (ni_*nj_ > 0)
+    bsta_mog3_unpack(soa_, &*img.begin(), ni_*nj_);
+}
+
+void bbgm_mog3_image::update(vil_image_view<float> const& image,
+                             bsta_mog3_update_params const& params)
+{
+  assert(image.ni() == ni_ && image.nj() == nj_ && image.nplanes() == dim());
+  bbgm_mog3_update_body body(ni_*nj_*dim(), 0);
+  body.soa = &soa_;
+  body.image = &image;
+  body.weights = VXL_NULLPTR;
+  body.params = &params;
+  vpl_parallel_for(nj_, body, num_threads_);
+}
+
+void bbgm_mog3_image::update(vil_image_view<float> const& image,
+                             vil_image_view<float> const& weights,
+                             bsta_mog3_update_params const& params)
+{
+  assert(image.ni() == ni_ && image.nj() == nj_ && image.nplanes() == dim());
+  assert(weights.ni() == ni_ && weights.nj() == nj_ && weights.nplanes() == 1);
+  bbgm_mog3_update_body body(ni_*nj_*dim(), ni_*nj_);
+  body.soa = &soa_;
+  body.image = &image;
+  body.weights = &weights;
+  body.params = &params;
+  vpl_parallel_for(nj_, body, num_threads_);
+}
+
+void bbgm_mog3_image::prob_density(vil_image_view<float> const& image,
+                                   vil_image_view<float>& prob) const
+{
+  assert(image.ni() == ni_ && image.nj() == nj_ && image.nplanes() == dim());
+  prob.set_size(ni_, nj_, 1);
+  bbgm_mog3_density_body body(ni_*nj_*dim(), ni_*nj_);
+  body.soa = &soa_;
+  body.image = &image;
+  body.prob = &prob;
+  vpl_parallel_for(nj_, body, num_threads_);
+}
+
+void bbgm_mog3_image::expected_value(vil_image_view<float>& ev) const
+{
+  ev.set_size(ni_, nj_, dim());
+  bbgm_mog3_expected_body body(0, ni_*nj_*dim());
+  body.soa = &soa_;
+  body.ev = &ev;
+  vpl_parallel_for(nj_, body, num_threads_);
+}
+
+void bbgm_mog3_image::detect(vil_image_view<float> const& image,
+                             vil_image_view<bool>& result,
+                             float mdist_thresh, float weight_thresh) const
+{
+  detect(image, result, VXL_NULLPTR, mdist_thresh, weight_thresh);
+}
+
+void bbgm_mog3_image::detect(vil_image_view<float> const& image,
+                             vil_image_view<bool>& result,
+                             vil_structuring_element const& se,
+                             float mdist_thresh, float weight_thresh) const
+{
+  detect(image, result, &se, mdist_thresh, weight_thresh);
+}
+
+void bbgm_mog3_image::detect(vil_image_view<float> const& image,
+                             vil_image_view<bool>& result,
+                             vil_structuring_element const* se,
+                             float mdist_thresh, float weight_thresh) const
+{
+  assert(image.ni() == ni_ && image.nj() == nj_ && image.nplanes() == dim());
+  result.set_size(ni_, nj_, 1);
+  bbgm_mog3_detect_body body(ni_*nj_*dim(), 0);
+  body.soa = &soa_;
+  body.image = &image;
+  body.result = &result;
+  body.se = se;
+  body.sqr_thresh = mdist_thresh*mdist_thresh;
+  body.weight_thresh = weight_thresh;
+  vpl_parallel_for(nj_, body, num_threads_);
+}
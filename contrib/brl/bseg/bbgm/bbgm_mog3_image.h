@@ -0,0 +1,113 @@
+// This is brl/bseg/bbgm/bbgm_mog3_image.h
+#ifndef bbgm_mog3_image_h_
+#define bbgm_mog3_image_h_
+//:
+// \file
+// \brief An image of mixtures of 3 Gaussians stored as packed arrays
+//
+// bbgm_image_of<dist> stores one mixture object per pixel and update(),
+// detect() and bbgm_apply() call the updaters and detectors on each of
+// them in turn.  bbgm_mog3_image holds the same grey or RGB mixtures of
+// (up to) 3 Gaussians as a bsta_mog3_soa, one array per parameter in
+// raster order, and processes whole rows with the bsta_mog3 kernels
+// (SSE2 where available).  The rows are spread over threads.
+//
+// The models are the bsta_mog3_grey_type and bsta_mog3_rgb_type mixtures
+// of bbgm_image_of; pack() and unpack() convert from and to those images,
+// so models saved as bbgm_image_of can be loaded, updated here and saved
+// again.  The results are those of update() with a
+// bsta_mg_grimson_window_updater (or weighted updater), of bbgm_apply()
+// with the probability density, and of detect() with a
+// bsta_top_weight_detector of bsta_g_mdist_detector at each pixel.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vil/vil_image_view.h>
+#include <bsta/algo/bsta_mog3_kernels.h>
+#include <vcl_compiler.h>
+#include "bbgm_image_of.h"
+
+class vil_structuring_element;
+
+class bbgm_mog3_image
+{
+ public:
+  //: An ni x nj image of empty grey (dim 1) or RGB (dim 3) mixtures
+  bbgm_mog3_image(unsigned ni = 0, unsigned nj = 0, unsigned dim = 1);
+
+  //: Copy of a grey mixture image
+  explicit bbgm_mog3_image(bbgm_image_of<bsta_mog3_grey_type> const& img);
+
+  //: Copy of an RGB mixture image
+  explicit bbgm_mog3_image(bbgm_image_of<bsta_mog3_rgb_type> const& img);
+
+  unsigned ni() const { return ni_; }
+  unsigned nj() const { return nj_; }
+  //: Number of planes of the samples, 1 (grey) or 3 (RGB)
+  unsigned dim() const { return soa_.dim(); }
+
+  //: The mixture parameters, model i + ni*j is pixel (i,j)
+  bsta_mog3_soa& soa() { return soa_; }
+  bsta_mog3_soa const& soa() const { return soa_; }
+
+  //: Number of threads used for the rows (0 = one per processor)
+  void set_num_threads(unsigned n) { num_threads_ = n; }
+  unsigned num_threads() const { return num_threads_; }
+
+  //: Replace the models with those of a grey mixture image
+  void pack(bbgm_image_of<bsta_mog3_grey_type> const& img);
+  //: Replace the models with those of an RGB mixture image
+  void pack(bbgm_image_of<bsta_mog3_rgb_type> const& img);
+
+  //: Copy the models into a grey mixture image (resized as needed)
+  void unpack(bbgm_image_of<bsta_mog3_grey_type>& img) const;
+  //: Copy the models into an RGB mixture image (resized as needed)
+  void unpack(bbgm_image_of<bsta_mog3_rgb_type>& img) const;
+
+  //: Update every model with the pixel of image, as bsta_mg_grimson_window_updater
+  void update(vil_image_view<float> const& image,
+              bsta_mog3_update_params const& params);
+
+  //: Update with a weight per pixel, as bsta_mg_grimson_weighted_updater
+  //  Pixels of zero weight are left unchanged.
+  void update(vil_image_view<float> const& image,
+              vil_image_view<float> const& weights,
+              bsta_mog3_update_params const& params);
+
+  //: Probability density of each pixel of image under its model
+  void prob_density(vil_image_view<float> const& image,
+                    vil_image_view<float>& prob) const;
+
+  //: Expected value of each model, dim() planes
+  void expected_value(vil_image_view<float>& ev) const;
+
+  //: Background test of each pixel
+  //  A pixel is background if it lies within mdist_thresh standard deviations
+  //  (Mahalanobis distance) of one of the components, taken in order while
+  //  their total weight does not exceed weight_thresh.
+  void detect(vil_image_view<float> const& image,
+              vil_image_view<bool>& result,
+              float mdist_thresh = 2.5f, float weight_thresh = 0.5f) const;
+
+  //: Background test of each pixel against the models of its \a se neighbours
+  //  As bbgm detect(), a pixel is background if the test succeeds for any neighbour.
+  void detect(vil_image_view<float> const& image,
+              vil_image_view<bool>& result,
+              vil_structuring_element const& se,
+              float mdist_thresh = 2.5f, float weight_thresh = 0.5f) const;
+
+ private:
+  unsigned ni_;
+  unsigned nj_;
+  unsigned num_threads_;
+  bsta_mog3_soa soa_;
+
+  void clear();
+  void detect(vil_image_view<float> const& image, vil_image_view<bool>& result,
+              vil_structuring_element const* se,
+              float mdist_thresh, float weight_thresh) const;
+};
+
+#endif // bbgm_mog3_image_h_
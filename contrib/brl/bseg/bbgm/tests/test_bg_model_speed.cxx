@@ -11,6 +11,7 @@
 #include <bsta/algo/bsta_adaptive_updater.h>
 
 #include <bbgm/bbgm_update.h>
+#include <bbgm/bbgm_mog3_image.h>
 #include <bsta/bsta_gaussian_indep.h>
 #include <vil/vil_image_view.h>
 #include <vul/vul_timer.h>
@@ -104,6 +105,19 @@ static void test_bg_model_speed()
       std::cout << " updated in " << up_time << " sec" <<std::endl;
     }
   }
+
+  std::cout << "testing packed mixture image speeds" << std::endl;
+  {
+    bsta_mog3_update_params params(init_var, 3.0f, 0.0f, unsigned(window_size));
+    bbgm_mog3_image model(ni,nj,3);
+
+    for (unsigned int t=0; t<images.size(); ++t){
+      vul_timer time;
+      model.update(images[t],params);
+      double up_time = time.real() / 1000.0;
+      std::cout << " updated in " << up_time << " sec" <<std::endl;
+    }
+  }
 }
 
 TESTMAIN(test_bg_model_speed);
@@ -3,11 +3,13 @@
 
 DECLARE( test_bg_model_speed );
 DECLARE( test_measure );
+DECLARE( test_mog3_image );
 void
 register_tests()
 {
   REGISTER( test_bg_model_speed );
   REGISTER( test_measure );
+  REGISTER( test_mog3_image );
 }
 
 DEFINE_MAIN;
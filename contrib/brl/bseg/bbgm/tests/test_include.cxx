@@ -10,6 +10,7 @@
 #include <bbgm/bbgm_image_of.h>
 #include <bbgm/bbgm_loader.h>
 #include <bbgm/bbgm_measure.h>
+#include <bbgm/bbgm_mog3_image.h>
 #include <bbgm/bbgm_planes_to_sample.h>
 #include <bbgm/bbgm_update.h>
 #include <bbgm/bbgm_view_maker.h>
@@ -0,0 +1,245 @@
+#include <iostream>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+
+#include <bbgm/bbgm_mog3_image.h>
+#include <bbgm/bbgm_image_of.h>
+#include <bbgm/bbgm_update.h>
+#include <bbgm/bbgm_detect.h>
+#include <bsta/bsta_detector_gaussian.h>
+#include <bsta/bsta_detector_mixture.h>
+#include <bsta/algo/bsta_adaptive_updater.h>
+#include <vil/vil_image_view.h>
+#include <vil/algo/vil_structuring_element.h>
+#include <vnl/vnl_random.h>
+
+namespace {
+
+typedef bsta_mixture_fixed<bsta_num_obs<bsta_gauss_sf1>, 3> grey_mix;
+typedef bsta_mixture_fixed<bsta_num_obs<bsta_gauss_if3>, 3> rgb_mix;
+
+// pixels drawn around one of three intensities, so that the mixtures
+// fill up, match, insert and reorder their components
+void make_frame(vnl_random& rng, vil_image_view<float>& img, vil_image_view<float>& w)
+{
+  for (unsigned j = 0; j<img.nj(); ++j)
+    for (unsigned i = 0; i<img.ni(); ++i) {
+      float base = float(rng.lrand32(0,2))*0.35f + 0.1f;
+      for (unsigned p = 0; p<img.nplanes(); ++p)
+        img(i,j,p) = base + float(rng.normal())*0.03f + 0.05f*p;
+      w(i,j) = rng.lrand32(0,9) == 0 ? 0.0f : float(rng.drand32(0.05, 1.0));
+    }
+}
+
+bool same_model(bsta_mog3_grey_type const& a, bsta_mog3_grey_type const& b, float tol)
+{
+  if (a.num_components() != b.num_components() ||
+      std::fabs(a.num_observations - b.num_observations) > tol)
+    return false;
+  for (unsigned c = 0; c<a.num_components(); ++c)
+    if (std::fabs(a.weight(c) - b.weight(c)) > tol ||
+        std::fabs(a.distribution(c).mean() - b.distribution(c).mean()) > tol ||
+        std::fabs(a.distribution(c).var() - b.distribution(c).var()) > tol)
+      return false;
+  return true;
+}
+
+bool same_model(bsta_mog3_rgb_type const& a, bsta_mog3_rgb_type const& b, float tol)
+{
+  if (a.num_components() != b.num_components() ||
+      std::fabs(a.num_observations - b.num_observations) > tol)
+    return false;
+  for (unsigned c = 0; c<a.num_components(); ++c) {
+    if (std::fabs(a.weight(c) - b.weight(c)) > tol)
+      return false;
+    for (unsigned d = 0; d<3; ++d)
+      if (std::fabs(a.distribution(c).mean()[d] - b.distribution(c).mean()[d]) > tol ||
+          std::fabs(a.distribution(c).diag_covar()[d] - b.distribution(c).diag_covar()[d]) > tol)
+        return false;
+  }
+  return true;
+}
+
+template <class dist_>
+unsigned count_same(bbgm_image_of<dist_> const& a, bbgm_image_of<dist_> const& b)
+{
+  unsigned n = 0;
+  for (unsigned j = 0; j<a.nj(); ++j)
+    for (unsigned i = 0; i<a.ni(); ++i)
+      if (same_model(a(i,j), b(i,j), 1e-5f))
+        ++n;
+  return n;
+}
+
+// bbgm detect() needs vector samples; the same loop for grey images
+template <class detector_>
+void grey_detect(bbgm_image_of<bsta_mog3_grey_type>& dimg, vil_image_view<float> const& img,
+                 vil_image_view<bool>& result, detector_ const& detector,
+                 vil_structuring_element const& se)
+{
+  result.set_size(img.ni(), img.nj());
+  for (int j = 0; j<int(img.nj()); ++j)
+    for (int i = 0; i<int(img.ni()); ++i) {
+      result(i,j) = false;
+      for (unsigned k = 0; k<se.p_i().size() && !result(i,j); ++k) {
+        int ri = i+se.p_i()[k], rj = j+se.p_j()[k];
+        bool val;
+        if (ri >= 0 && rj >= 0 && ri<int(img.ni()) && rj<int(img.nj()) &&
+            detector(dimg(ri,rj), img(i,j), val) && val)
+          result(i,j) = true;
+      }
+    }
+}
+
+void weighted_update(bbgm_image_of<bsta_mog3_rgb_type>& model, vil_image_view<float> const& img,
+                     vil_image_view<float> const& w,
+                     bsta_mg_grimson_weighted_updater<rgb_mix> const& updater)
+{
+  for (unsigned j = 0; j<img.nj(); ++j)
+    for (unsigned i = 0; i<img.ni(); ++i)
+      if (w(i,j) > 0.0f)
+        updater(model(i,j), vnl_vector_fixed<float,3>(img(i,j,0), img(i,j,1), img(i,j,2)), w(i,j));
+}
+
+unsigned count_equal(vil_image_view<bool> const& a, vil_image_view<bool> const& b)
+{
+  unsigned n = 0;
+  for (unsigned j = 0; j<a.nj(); ++j)
+    for (unsigned i = 0; i<a.ni(); ++i)
+      if (a(i,j) == b(i,j))
+        ++n;
+  return n;
+}
+
+}; // namespace
+
+static void test_grey(vnl_random& rng)
+{
+  // an odd width leaves a partial SIMD block at the end of each row
+  const unsigned ni = 37, nj = 23, n = ni*nj, frames = 30;
+  bsta_gauss_sf1 init_gauss(0.0f, 0.008f);
+  bsta_mg_grimson_window_updater<grey_mix> updater(init_gauss, 3, 2.5f, 0.02f, 20);
+  bsta_mog3_update_params params(0.008f, 2.5f, 0.02f, 20);
+
+  bbgm_image_of<bsta_mog3_grey_type> model(ni, nj, bsta_mog3_grey_type());
+  bbgm_mog3_image soa1(ni, nj, 1), soa3(ni, nj, 1);
+  soa1.set_num_threads(1);
+  soa3.set_num_threads(3);
+
+  vil_image_view<float> img(ni, nj, 1), w(ni, nj, 1);
+  for (unsigned t = 0; t<frames; ++t) {
+    make_frame(rng, img, w);
+    update(model, img, updater);
+    soa1.update(img, params);
+    soa3.update(img, params);
+  }
+  bbgm_image_of<bsta_mog3_grey_type> result1, result3;
+  soa1.unpack(result1);
+  soa3.unpack(result3);
+  TEST_EQUAL("grey window update", count_same(model, result1), n);
+  TEST("grey update on 3 threads", soa1.soa().num_obs()[n-1] == soa3.soa().num_obs()[n-1] &&
+                                   count_same(result1, result3) == n, true);
+
+  // densities and expected values of the unpacked models
+  make_frame(rng, img, w);
+  vil_image_view<float> prob, ev;
+  soa3.prob_density(img, prob);
+  soa3.expected_value(ev);
+  double max_dp = 0.0, max_dev = 0.0;
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i) {
+      bsta_mog3_grey_type& mix = result3(i,j);
+      float p = mix.num_components() ? mix.prob_density(img(i,j)) : 1.0f;
+      max_dp = std::max(max_dp, double(std::fabs(p - prob(i,j))/std::max(1.0f, p)));
+      float e = mix.num_components() ? mix.expected_value() : 0.0f;
+      max_dev = std::max(max_dev, double(std::fabs(e - ev(i,j))));
+    }
+  TEST_NEAR("grey prob_density", max_dp, 0.0, 1e-5);
+  TEST_NEAR("grey expected value", max_dev, 0.0, 1e-6);
+
+  // detection agrees with the bsta detectors
+  typedef bsta_g_mdist_detector<bsta_gauss_sf1> g_detector;
+  bsta_top_weight_detector<grey_mix, g_detector> detector(g_detector(2.5f), 0.6f);
+  vil_structuring_element centre, disk;
+  centre.set_to_disk(0.5);
+  disk.set_to_disk(1.5);
+  vil_image_view<bool> expected, found;
+  grey_detect(result3, img, expected, detector, centre);
+  soa3.detect(img, found, 2.5f, 0.6f);
+  TEST_EQUAL("grey detect", count_equal(expected, found), n);
+  grey_detect(result3, img, expected, detector, disk);
+  soa3.detect(img, found, disk, 2.5f, 0.6f);
+  TEST_EQUAL("grey detect with structuring element", count_equal(expected, found), n);
+}
+
+static void test_rgb(vnl_random& rng)
+{
+  const unsigned ni = 29, nj = 17, n = ni*nj, frames = 30;
+  bsta_gauss_if3 init_gauss(vnl_vector_fixed<float,3>(0.0f), vnl_vector_fixed<float,3>(0.008f));
+  bsta_mg_grimson_weighted_updater<rgb_mix> updater(init_gauss, 3, 2.5f, 0.02f);
+  bsta_mog3_update_params params(0.008f, 2.5f, 0.02f);
+
+  // start from a model saved part way through, as a loaded background model would
+  bbgm_image_of<bsta_mog3_rgb_type> model(ni, nj, bsta_mog3_rgb_type());
+  vil_image_view<float> img(ni, nj, 3), w(ni, nj, 1);
+  for (unsigned t = 0; t<5; ++t) {
+    make_frame(rng, img, w);
+    weighted_update(model, img, w, updater);
+  }
+  bbgm_mog3_image soa(model);
+  TEST("rgb pack", soa.dim() == 3 && soa.ni() == ni && soa.nj() == nj, true);
+  soa.set_num_threads(2);
+
+  for (unsigned t = 0; t<frames; ++t) {
+    make_frame(rng, img, w);
+    weighted_update(model, img, w, updater);
+    soa.update(img, w, params);
+  }
+  bbgm_image_of<bsta_mog3_rgb_type> result;
+  soa.unpack(result);
+  TEST_EQUAL("rgb weighted update", count_same(model, result), n);
+
+  make_frame(rng, img, w);
+  vil_image_view<float> prob, ev;
+  soa.prob_density(img, prob);
+  soa.expected_value(ev);
+  double max_dp = 0.0, max_dev = 0.0;
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i) {
+      bsta_mog3_rgb_type& mix = result(i,j);
+      vnl_vector_fixed<float,3> x(img(i,j,0), img(i,j,1), img(i,j,2));
+      float p = mix.num_components() ? mix.prob_density(x) : 1.0f;
+      max_dp = std::max(max_dp, double(std::fabs(p - prob(i,j))/std::max(1.0f, p)));
+      vnl_vector_fixed<float,3> e(0.0f);
+      if (mix.num_components())
+        e = mix.expected_value();
+      for (unsigned d = 0; d<3; ++d)
+        max_dev = std::max(max_dev, double(std::fabs(e[d] - ev(i,j,d))));
+    }
+  TEST_NEAR("rgb prob_density", max_dp, 0.0, 1e-5);
+  TEST_NEAR("rgb expected value", max_dev, 0.0, 1e-6);
+
+  typedef bsta_g_mdist_detector<bsta_gauss_if3> g_detector;
+  bsta_top_weight_detector<rgb_mix, g_detector> detector(g_detector(2.5f), 0.6f);
+  vil_structuring_element centre;
+  centre.set_to_disk(0.5);
+  vil_image_view<bool> expected, found;
+  detect(result, img, expected, detector, centre);
+  soa.detect(img, found, 2.5f, 0.6f);
+  TEST_EQUAL("rgb detect", count_equal(expected, found), n);
+
+  // a round trip through the packed image leaves the models unchanged
+  bbgm_image_of<bsta_mog3_rgb_type> back;
+  bbgm_mog3_image(result).unpack(back);
+  TEST_EQUAL("rgb pack/unpack", count_same(result, back), n);
+}
+
+static void test_mog3_image()
+{
+  vnl_random rng(9667);
+  test_grey(rng);
+  test_rgb(rng);
+}
+
+TESTMAIN(test_mog3_image);
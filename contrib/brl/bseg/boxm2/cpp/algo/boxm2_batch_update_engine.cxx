@@ -0,0 +1,557 @@
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include "boxm2_batch_update_engine.h"
+//:
+// \file
+
+#include <boxm2/boxm2_data_traits.h>
+#include <boxm2/cpp/algo/boxm2_batch_functors.h>
+#include <boxm2/cpp/algo/boxm2_cast_ray_function.h>
+#include <vpl/vpl.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vul/vul_file.h>
+
+//: Casts the three passes of a set of views and compacts them into samples (one view per index)
+template <boxm2_data_type APM_TYPE>
+class boxm2_batch_update_engine_gather : public vpl_parallel_for_body
+{
+ public:
+  typedef typename boxm2_data_traits<APM_TYPE>::datatype apm_datatype;
+  typedef boxm2_batch_update_engine::sample sample;
+
+  boxm2_batch_update_engine_gather(boxm2_batch_update_engine& engine) : e_(engine) {}
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    for (unsigned v = begin; v < end; ++v)
+      this->gather_view(v, thread_id);
+  }
+
+ private:
+  boxm2_batch_update_engine& e_;
+
+  void gather_view(unsigned v, unsigned thread_id);
+  void compact(boxm2_batch_update_engine::view_state& view, unsigned b, unsigned thread_id);
+};
+
+template <boxm2_data_type APM_TYPE>
+void boxm2_batch_update_engine_gather<APM_TYPE>::gather_view(unsigned v, unsigned thread_id)
+{
+  boxm2_batch_update_engine::view_state& view = e_.views_[v];
+  boxm2_batch_update_engine::thread_state& ts = e_.threads_[thread_id];
+  unsigned ni = view.img.ni(), nj = view.img.nj();
+  std::vector<unsigned>::const_iterator bit;
+
+  // the scratch buffers of this worker start from zero for every view
+  for (bit = view.vis_blocks.begin(); bit != view.vis_blocks.end(); ++bit) {
+    std::memset(ts.aux0[*bit]->data_buffer(), 0, ts.aux0[*bit]->buffer_length());
+    std::memset(ts.aux1[*bit]->data_buffer(), 0, ts.aux1[*bit]->buffer_length());
+    std::memset(ts.nobs[*bit]->data_buffer(), 0, ts.nobs[*bit]->buffer_length());
+  }
+
+  // pass 0: segment length weighted intensities
+  for (bit = view.vis_blocks.begin(); bit != view.vis_blocks.end(); ++bit) {
+    boxm2_batch_update_engine::block_state& blk = e_.blocks_[*bit];
+    std::vector<boxm2_data_base*> datas;
+    datas.push_back(ts.aux0[*bit]);
+    datas.push_back(ts.aux1[*bit]);
+    datas.push_back(ts.nobs[*bit]);
+    boxm2_batch_update_pass0_functor pass0;
+    pass0.init_data(datas, &view.img);
+    cast_ray_per_block<boxm2_batch_update_pass0_functor>(pass0, blk.info, blk.blk, view.cam, ni, nj);
+  }
+
+  // pass 1: pre and vis at infinity
+  vil_image_view<float> pre_inf_img(ni, nj), vis_inf_img(ni, nj);
+  pre_inf_img.fill(0.0f);
+  vis_inf_img.fill(1.0f);
+  for (bit = view.vis_blocks.begin(); bit != view.vis_blocks.end(); ++bit) {
+    boxm2_batch_update_engine::block_state& blk = e_.blocks_[*bit];
+    std::vector<boxm2_data_base*> datas;
+    datas.push_back(ts.aux0[*bit]);
+    datas.push_back(ts.aux1[*bit]);
+    datas.push_back(blk.alpha);
+    datas.push_back(blk.apm);
+    boxm2_batch_update_pass1_functor<APM_TYPE> pass1;
+    pass1.init_data(datas, &pre_inf_img, &vis_inf_img);
+    cast_ray_per_block<boxm2_batch_update_pass1_functor<APM_TYPE> >(pass1, blk.info, blk.blk, view.cam, ni, nj);
+  }
+
+  // pass 2: per cell averages of pre, vis and post, compacted block by block
+  vil_image_view<float> pre_img(ni, nj), vis_img(ni, nj);
+  pre_img.fill(0.0f);
+  vis_img.fill(1.0f);
+  for (bit = view.vis_blocks.begin(); bit != view.vis_blocks.end(); ++bit) {
+    boxm2_batch_update_engine::block_state& blk = e_.blocks_[*bit];
+    // the aux buffer is large enough for any block, pass 2 only uses the cells of this one
+    std::memset(ts.aux->data_buffer(), 0, blk.ncells*sizeof(boxm2_data_traits<BOXM2_AUX>::datatype));
+    std::vector<boxm2_data_base*> datas;
+    datas.push_back(ts.aux0[*bit]);
+    datas.push_back(ts.aux1[*bit]);
+    datas.push_back(blk.alpha);
+    datas.push_back(blk.apm);
+    datas.push_back(ts.aux);
+    boxm2_batch_update_pass2_functor<APM_TYPE> pass2;
+    pass2.init_data(datas, &pre_img, &vis_img, &pre_inf_img, &vis_inf_img);
+    cast_ray_per_block<boxm2_batch_update_pass2_functor<APM_TYPE> >(pass2, blk.info, blk.blk, view.cam, ni, nj);
+    this->compact(view, *bit, thread_id);
+  }
+}
+
+//: Turns the scratch aux buffers of one block into samples
+template <boxm2_data_type APM_TYPE>
+void boxm2_batch_update_engine_gather<APM_TYPE>::compact(boxm2_batch_update_engine::view_state& view,
+                                                         unsigned b, unsigned thread_id)
+{
+  boxm2_batch_update_engine::block_state& blk = e_.blocks_[b];
+  boxm2_batch_update_engine::thread_state& ts = e_.threads_[thread_id];
+  boxm2_batch_update_engine::sample_list& list = view.lists[b];
+
+  const float* aux0 = reinterpret_cast<const float*>(ts.aux0[b]->data_buffer());
+  const float* aux1 = reinterpret_cast<const float*>(ts.aux1[b]->data_buffer());
+  const unsigned short* nobs = reinterpret_cast<const unsigned short*>(ts.nobs[b]->data_buffer());
+  const boxm2_data_traits<BOXM2_AUX>::datatype* aux =
+    reinterpret_cast<const boxm2_data_traits<BOXM2_AUX>::datatype*>(ts.aux->data_buffer());
+
+  unsigned nchunks = (blk.ncells + boxm2_batch_update_engine::chunk_size - 1) / boxm2_batch_update_engine::chunk_size;
+  list.samples.clear();
+  list.chunk_start.assign(nchunks+1, 0);
+  for (unsigned c = 0; c < blk.ncells; ++c)
+  {
+    if (c % boxm2_batch_update_engine::chunk_size == 0)
+      list.chunk_start[c / boxm2_batch_update_engine::chunk_size] = (unsigned)list.samples.size();
+    float obs_seg_len = aux1[c];
+    if (obs_seg_len <= 1e-8f)
+      continue;
+    sample s;
+    s.index = c;
+    s.obs = aux0[c]/obs_seg_len;
+    s.pre = aux[c][0]/obs_seg_len;
+    s.vis = aux[c][1]/obs_seg_len;
+    s.post = aux[c][2]/obs_seg_len;
+    s.seg_len = nobs[c] > 0 ? obs_seg_len/nobs[c] : 0.0f;
+    list.samples.push_back(s);
+  }
+  list.chunk_start[nchunks] = (unsigned)list.samples.size();
+
+  // keep the samples in memory if this worker's share of the budget allows it
+  std::size_t nbytes = list.samples.size()*sizeof(sample);
+  std::size_t share = e_.sample_budget_bytes_ / e_.threads_.size();
+  if (nbytes == 0 || ts.in_memory_bytes + nbytes <= share) {
+    ts.in_memory_bytes += nbytes;
+    return;
+  }
+  if (!ts.spill) {
+    std::ostringstream fname;
+    fname << e_.spill_dir_ << "/boxm2_batch_update_spill_" << vpl_getpid() << '_' << thread_id << ".bin";
+    ts.spill_file = fname.str();
+    ts.spill = new std::ofstream(ts.spill_file.c_str(), std::ios::out | std::ios::binary);
+  }
+  if (!ts.spill->good()) {
+    std::cerr << "boxm2_batch_update_engine: cannot write " << ts.spill_file << ", keeping samples in memory\n";
+    ts.in_memory_bytes += nbytes;
+    return;
+  }
+  ts.spill->write(reinterpret_cast<const char*>(&list.samples[0]), nbytes);
+  if (!ts.spill->good()) {
+    std::cerr << "boxm2_batch_update_engine: failed to write " << ts.spill_file << ", keeping samples in memory\n";
+    ts.in_memory_bytes += nbytes;
+    return;
+  }
+  list.spill_thread = (int)thread_id;
+  list.file_offset = ts.spilled_bytes;
+  ts.spilled_bytes += nbytes;
+  std::vector<sample>().swap(list.samples);
+}
+
+//: Updates alpha and the appearance model of the cells, one (block, chunk of cells) pair per index
+//  The cells are updated in a staged copy of the scene data, see commit().
+template <boxm2_data_type APM_TYPE>
+class boxm2_batch_update_engine_update : public vpl_parallel_for_body
+{
+ public:
+  typedef typename boxm2_data_traits<APM_TYPE>::datatype apm_datatype;
+  typedef boxm2_batch_update_engine::sample sample;
+
+  boxm2_batch_update_engine_update(boxm2_batch_update_engine& engine,
+                                   bsta_sigma_normalizer_sptr n_table,
+                                   unsigned num_threads)
+  : e_(engine), n_table_(n_table), readers_(num_threads), buffers_(num_threads), failed_(num_threads, 0)
+  {
+    for (unsigned b = 0; b < e_.blocks_.size(); ++b) {
+      boxm2_batch_update_engine::block_state& blk = e_.blocks_[b];
+      unsigned nchunks = (blk.ncells + boxm2_batch_update_engine::chunk_size - 1) / boxm2_batch_update_engine::chunk_size;
+      for (unsigned k = 0; k < nchunks; ++k)
+        tasks_.push_back(std::pair<unsigned, unsigned>(b, k));
+      alpha_.push_back(std::vector<float>(reinterpret_cast<float*>(blk.alpha->data_buffer()),
+                                          reinterpret_cast<float*>(blk.alpha->data_buffer()) + blk.ncells));
+      apm_.push_back(std::vector<apm_datatype>(reinterpret_cast<apm_datatype*>(blk.apm->data_buffer()),
+                                               reinterpret_cast<apm_datatype*>(blk.apm->data_buffer()) + blk.ncells));
+    }
+    for (unsigned t = 0; t < num_threads; ++t) {
+      readers_[t].assign(e_.threads_.size(), VXL_NULLPTR);
+      buffers_[t].resize(e_.views_.size());
+    }
+  }
+
+  ~boxm2_batch_update_engine_update()
+  {
+    for (unsigned t = 0; t < readers_.size(); ++t)
+      for (unsigned s = 0; s < readers_[t].size(); ++s)
+        delete readers_[t][s];
+  }
+
+  unsigned num_tasks() const { return (unsigned)tasks_.size(); }
+
+  //: true if the samples of some chunk could not be read back from a spill file
+  bool failed() const { return std::find(failed_.begin(), failed_.end(), 1) != failed_.end(); }
+
+  //: Replace alpha and the appearance model of the scene by the updated copies
+  void commit()
+  {
+    for (unsigned b = 0; b < e_.blocks_.size(); ++b) {
+      boxm2_batch_update_engine::block_state& blk = e_.blocks_[b];
+      if (blk.ncells == 0)
+        continue;
+      std::memcpy(blk.alpha->data_buffer(), &alpha_[b][0], blk.ncells*sizeof(float));
+      std::memcpy(blk.apm->data_buffer(), &apm_[b][0], blk.ncells*sizeof(apm_datatype));
+    }
+  }
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    for (unsigned t = begin; t < end; ++t)
+      this->update_chunk(tasks_[t].first, tasks_[t].second, thread_id);
+  }
+
+ private:
+  boxm2_batch_update_engine& e_;
+  bsta_sigma_normalizer_sptr n_table_;
+  std::vector<std::pair<unsigned, unsigned> > tasks_;
+  //: per worker readers of the spill files and read buffers, one per view
+  std::vector<std::vector<std::ifstream*> > readers_;
+  std::vector<std::vector<std::vector<sample> > > buffers_;
+  //: per worker, set when a chunk was left unchanged because a spill file could not be read
+  std::vector<char> failed_;
+  //: the staged alpha and appearance model of each block
+  std::vector<std::vector<float> > alpha_;
+  std::vector<std::vector<apm_datatype> > apm_;
+
+  void update_chunk(unsigned b, unsigned k, unsigned thread_id);
+};
+
+template <boxm2_data_type APM_TYPE>
+void boxm2_batch_update_engine_update<APM_TYPE>::update_chunk(unsigned b, unsigned k, unsigned thread_id)
+{
+  boxm2_batch_update_engine::block_state& blk = e_.blocks_[b];
+  unsigned nviews = (unsigned)e_.views_.size();
+  unsigned c0 = k*boxm2_batch_update_engine::chunk_size;
+  unsigned c1 = c0 + boxm2_batch_update_engine::chunk_size;
+  if (c1 > blk.ncells) c1 = blk.ncells;
+
+  // locate the samples of this chunk in every view
+  std::vector<const sample*> cur(nviews, VXL_NULLPTR), last(nviews, VXL_NULLPTR);
+  for (unsigned v = 0; v < nviews; ++v)
+  {
+    boxm2_batch_update_engine::sample_list& list = e_.views_[v].lists[b];
+    if (list.chunk_start.empty())
+      continue;  // block not visible in this view
+    unsigned s0 = list.chunk_start[k], s1 = list.chunk_start[k+1];
+    if (s0 == s1)
+      continue;
+    if (list.spill_thread < 0) {
+      cur[v] = &list.samples[s0];
+      last[v] = cur[v] + (s1-s0);
+      continue;
+    }
+    std::ifstream*& is = readers_[thread_id][list.spill_thread];
+    if (!is)
+      is = new std::ifstream(e_.threads_[list.spill_thread].spill_file.c_str(), std::ios::in | std::ios::binary);
+    std::vector<sample>& buf = buffers_[thread_id][v];
+    buf.resize(s1-s0);
+    is->clear();
+    is->seekg(std::streamoff(list.file_offset + std::size_t(s0)*sizeof(sample)));
+    is->read(reinterpret_cast<char*>(&buf[0]), std::streamsize((s1-s0)*sizeof(sample)));
+    if (!is->good()) {
+      // without the samples of this view the cells would be updated from the other views only
+      std::cerr << "boxm2_batch_update_engine: failed to read back " << e_.threads_[list.spill_thread].spill_file << '\n';
+      failed_[thread_id] = 1;
+      return;
+    }
+    cur[v] = &buf[0];
+    last[v] = cur[v] + (s1-s0);
+  }
+
+  float* alpha_data = &alpha_[b][0];
+  apm_datatype* apm_data = &apm_[b][0];
+  std::vector<float> obs, pre, vis;
+  for (unsigned c = c0; c < c1; ++c)
+  {
+    // the likelihoods use the appearance model before this cell is updated,
+    // as in boxm2_batch_update_functor
+    float term1 = 0.0f, term2 = 0.0f, max_obs_seg_len = 0.0f;
+    obs.clear(); pre.clear(); vis.clear();
+    for (unsigned v = 0; v < nviews; ++v)
+      if (cur[v] != last[v] && cur[v]->index == c) {
+        const sample& s = *cur[v];
+        obs.push_back(s.obs);
+        pre.push_back(s.pre);
+        vis.push_back(s.vis);
+        float PI = boxm2_processor_type<APM_TYPE>::type::prob_density(apm_data[c], s.obs);
+        term1 += std::log(s.pre + s.vis*PI);
+        term2 += std::log(s.pre + s.post);
+        if (max_obs_seg_len < s.seg_len)
+          max_obs_seg_len = s.seg_len;
+        ++cur[v];
+      }
+
+    // same update as boxm2_batch_update_functor::process_cell()
+    if (max_obs_seg_len > 1e-8f)
+    {
+      float& alpha = alpha_data[c];
+      float p_q = 1.0f-std::exp(-alpha*max_obs_seg_len);
+      term1 = std::exp(term1);
+      term2 = std::exp(term2);
+      float p_q_new = p_q*term1 / (p_q*term1 + (1.0f-p_q)*term2);
+      alpha = -std::log(1.0f-p_q_new)/max_obs_seg_len;
+
+      float alpha_min = -std::log(1.f-0.0001f)/max_obs_seg_len;
+      float alpha_max = -std::log(1.f-0.995f)/max_obs_seg_len;
+      if (alpha < alpha_min)
+        alpha = alpha_min;
+      if (alpha > alpha_max)
+        alpha = alpha_max;
+
+      boxm2_processor_type<APM_TYPE>::type::compute_app_model(apm_data[c], obs, pre, vis, n_table_, 0.03f);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+
+boxm2_batch_update_engine::boxm2_batch_update_engine(boxm2_scene_sptr scene, boxm2_cache_sptr cache,
+                                                     unsigned num_threads,
+                                                     float mem_budget_gb,
+                                                     std::string const& spill_dir)
+: scene_(scene), cache_(cache),
+  num_threads_(vpl_parallel_for_num_threads(num_threads)),
+  mem_budget_bytes_((std::size_t)(mem_budget_gb*std::pow(2.0, 30.0))),
+  scratch_bytes_(0), staging_bytes_(0), sample_budget_bytes_(0),
+  spill_dir_(spill_dir)
+{
+  if (spill_dir_.empty())
+    spill_dir_ = scene_->data_path();
+  if (spill_dir_.empty())
+    spill_dir_ = ".";
+}
+
+boxm2_batch_update_engine::~boxm2_batch_update_engine()
+{
+  this->remove_spill_files();
+  this->clear_threads();
+  for (unsigned b = 0; b < blocks_.size(); ++b)
+    delete blocks_[b].info;
+}
+
+void boxm2_batch_update_engine::add_view(vpgl_camera_double_sptr const& cam, vil_image_view<float> const& img)
+{
+  view_state view;
+  view.cam = cam;
+  view.img = img;
+  views_.push_back(view);
+}
+
+std::size_t boxm2_batch_update_engine::spilled_bytes() const
+{
+  std::size_t n = 0;
+  for (unsigned t = 0; t < threads_.size(); ++t)
+    n += threads_[t].spilled_bytes;
+  return n;
+}
+
+std::size_t boxm2_batch_update_engine::in_memory_bytes() const
+{
+  std::size_t n = 0;
+  for (unsigned t = 0; t < threads_.size(); ++t)
+    n += threads_[t].in_memory_bytes;
+  return n;
+}
+
+void boxm2_batch_update_engine::remove_spill_files()
+{
+  for (unsigned t = 0; t < threads_.size(); ++t) {
+    if (threads_[t].spill) {
+      delete threads_[t].spill;
+      threads_[t].spill = VXL_NULLPTR;
+    }
+    if (!threads_[t].spill_file.empty() && vul_file::exists(threads_[t].spill_file))
+      vpl_unlink(threads_[t].spill_file.c_str());
+    threads_[t].spill_file.clear();
+  }
+}
+
+bool boxm2_batch_update_engine::init_blocks()
+{
+  // same appearance types as boxm2_cpp_batch_update_process
+  data_type_.clear();
+  std::vector<std::string> apps = scene_->appearances();
+  for (unsigned int i=0; i<apps.size(); ++i) {
+    if ( apps[i] == boxm2_data_traits<BOXM2_MOG3_GREY>::prefix() ||
+         apps[i] == boxm2_data_traits<BOXM2_GAUSS_GREY>::prefix() )
+      data_type_ = apps[i];
+    else if ( apps[i] == boxm2_data_traits<BOXM2_MOG3_GREY_16>::prefix() ) {
+      std::cout << "boxm2_batch_update_engine ERROR: datatype BOXM2_MOG3_GREY_16 not implemented!\n";
+      return false;
+    }
+  }
+  if (data_type_.empty()) {
+    std::cout << "boxm2_batch_update_engine ERROR: scene doesn't have BOXM2_MOG3_GREY or BOXM2_GAUSS_GREY data type\n";
+    return false;
+  }
+
+  for (unsigned b = 0; b < blocks_.size(); ++b)
+    delete blocks_[b].info;
+  blocks_.clear();
+
+  // everything the workers touch is fetched here, so the cache is never used concurrently
+  std::size_t alphaTypeSize = boxm2_data_info::datasize(boxm2_data_traits<BOXM2_ALPHA>::prefix());
+  std::size_t appTypeSize = boxm2_data_info::datasize(data_type_);
+  std::vector<boxm2_block_id> ids = scene_->get_block_ids();
+  for (unsigned b = 0; b < ids.size(); ++b) {
+    block_state bs;
+    bs.id = ids[b];
+    bs.info = scene_->get_blk_metadata(ids[b]);
+    bs.blk = cache_->get_block(scene_, ids[b]);
+    bs.alpha = cache_->get_data_base(scene_, ids[b], boxm2_data_traits<BOXM2_ALPHA>::prefix(), 0, false);
+    bs.ncells = (unsigned)(bs.alpha->buffer_length() / alphaTypeSize);
+    bs.apm = cache_->get_data_base(scene_, ids[b], data_type_, bs.ncells*appTypeSize, false);
+    blocks_.push_back(bs);
+  }
+  return true;
+}
+
+void boxm2_batch_update_engine::init_threads()
+{
+  this->remove_spill_files();
+  this->clear_threads();
+
+  // every worker needs aux0, aux1 and the ray counts of every block and the aux of the largest
+  // block; the update needs a copy of alpha and the appearance model of the scene
+  typedef boxm2_data_traits<BOXM2_AUX>::datatype aux_datatype;
+  std::size_t total_cells = 0, max_cells = 0;
+  for (unsigned b = 0; b < blocks_.size(); ++b) {
+    total_cells += blocks_[b].ncells;
+    if (max_cells < blocks_[b].ncells)
+      max_cells = blocks_[b].ncells;
+  }
+  scratch_bytes_ = total_cells*(2*sizeof(float) + sizeof(unsigned short)) + max_cells*sizeof(aux_datatype);
+  staging_bytes_ = total_cells*(boxm2_data_info::datasize(boxm2_data_traits<BOXM2_ALPHA>::prefix()) +
+                                boxm2_data_info::datasize(data_type_));
+
+  // as many workers as fit the budget, but at least one
+  std::size_t avail = mem_budget_bytes_ > staging_bytes_ ? mem_budget_bytes_ - staging_bytes_ : 0;
+  unsigned nthreads = num_threads_ < views_.size() ? num_threads_ : (unsigned)views_.size();
+  while (nthreads > 1 && nthreads*scratch_bytes_ > avail)
+    --nthreads;
+  if (nthreads*scratch_bytes_ > avail)
+    std::cout << "boxm2_batch_update_engine: the memory budget of " << mem_budget_bytes_
+              << " bytes is too small for one worker, which needs " << scratch_bytes_ + staging_bytes_ << " bytes\n";
+  sample_budget_bytes_ = avail > nthreads*scratch_bytes_ ? avail - nthreads*scratch_bytes_ : 0;
+
+  threads_.resize(nthreads);
+  for (unsigned t = 0; t < nthreads; ++t)
+  {
+    thread_state& ts = threads_[t];
+    for (unsigned b = 0; b < blocks_.size(); ++b) {
+      std::size_t n = blocks_[b].ncells;
+      boxm2_block_id id = blocks_[b].id;
+      ts.aux0.push_back(new boxm2_data_base(new char[n*sizeof(float)], n*sizeof(float), id));
+      ts.aux1.push_back(new boxm2_data_base(new char[n*sizeof(float)], n*sizeof(float), id));
+      ts.nobs.push_back(new boxm2_data_base(new char[n*sizeof(unsigned short)], n*sizeof(unsigned short), id));
+    }
+    std::size_t aux_size = max_cells*sizeof(aux_datatype);
+    ts.aux = new boxm2_data_base(new char[aux_size], aux_size, blocks_.empty() ? boxm2_block_id() : blocks_[0].id);
+  }
+}
+
+void boxm2_batch_update_engine::clear_threads()
+{
+  for (unsigned t = 0; t < threads_.size(); ++t)
+  {
+    thread_state& ts = threads_[t];
+    for (unsigned b = 0; b < ts.aux0.size(); ++b) {
+      delete ts.aux0[b];
+      delete ts.aux1[b];
+      delete ts.nobs[b];
+    }
+    delete ts.aux;
+    delete ts.spill;
+  }
+  threads_.clear();
+}
+
+bool boxm2_batch_update_engine::flush_spill_files()
+{
+  bool good = true;
+  for (unsigned t = 0; t < threads_.size(); ++t) {
+    if (!threads_[t].spill)
+      continue;
+    threads_[t].spill->flush();
+    if (!threads_[t].spill->good()) {
+      std::cerr << "boxm2_batch_update_engine: failed to write " << threads_[t].spill_file << '\n';
+      good = false;
+    }
+  }
+  return good;
+}
+
+bool boxm2_batch_update_engine::run(bsta_sigma_normalizer_sptr n_table)
+{
+  if (views_.empty())
+    return true;
+  if (!this->init_blocks())
+    return false;
+
+  std::map<boxm2_block_id, unsigned> block_index;
+  for (unsigned b = 0; b < blocks_.size(); ++b)
+    block_index[blocks_[b].id] = b;
+  for (unsigned v = 0; v < views_.size(); ++v) {
+    view_state& view = views_[v];
+    std::vector<boxm2_block_id> vis_order = scene_->get_vis_blocks(view.cam);
+    view.vis_blocks.clear();
+    for (unsigned i = 0; i < vis_order.size(); ++i)
+      view.vis_blocks.push_back(block_index[vis_order[i]]);
+    view.lists.assign(blocks_.size(), sample_list());
+  }
+  this->init_threads();
+
+  if (data_type_ == boxm2_data_traits<BOXM2_MOG3_GREY>::prefix())
+  {
+    boxm2_batch_update_engine_gather<BOXM2_MOG3_GREY> gather(*this);
+    vpl_parallel_for((unsigned)views_.size(), gather, (unsigned)threads_.size());
+    if (!this->flush_spill_files())
+      return false;
+    boxm2_batch_update_engine_update<BOXM2_MOG3_GREY> update(*this, n_table, num_threads_);
+    vpl_parallel_for(update.num_tasks(), update, num_threads_);
+    if (update.failed())
+      return false;
+    update.commit();
+  }
+  else
+  {
+    boxm2_batch_update_engine_gather<BOXM2_GAUSS_GREY> gather(*this);
+    vpl_parallel_for((unsigned)views_.size(), gather, (unsigned)threads_.size());
+    if (!this->flush_spill_files())
+      return false;
+    boxm2_batch_update_engine_update<BOXM2_GAUSS_GREY> update(*this, n_table, num_threads_);
+    vpl_parallel_for(update.num_tasks(), update, num_threads_);
+    if (update.failed())
+      return false;
+    update.commit();
+  }
+  return true;
+}
@@ -0,0 +1,176 @@
+#ifndef boxm2_batch_update_engine_h_
+#define boxm2_batch_update_engine_h_
+//:
+// \file
+// \brief In-memory, multi-view driver for the cpp batch update
+//
+// The batch update of boxm2_cpp_batch_update_processes works image by image:
+// pass0/pass1/pass2 of boxm2_batch_functors.h write per-image aux0/aux1/aux
+// data blocks to disk, which boxm2_stream_cache reads back cell by cell in
+// boxm2_batch_update_functor.  This engine performs the same computation
+// without the round trip through per-image aux files:
+//
+//  - the views are distributed over worker threads (vpl_parallel_for); each
+//    worker casts the three passes of one view into its own scratch aux
+//    buffers and then compacts each block into a sorted list of per-cell
+//    samples (mean observation, pre, vis and post, and the segment length
+//    per ray) for the cells the view hit.
+//  - samples are kept in memory up to a budget; a worker that exceeds its
+//    share of the budget writes further sample lists to a spill file.
+//  - finally the cells are updated in parallel chunks, gathering the samples
+//    of each cell in view order so that alpha and the appearance model see
+//    the same observation sequence as the serial stream cache path.  The
+//    chunks are updated into a staged copy of alpha and the appearance model,
+//    which replaces the scene data only if every chunk could be updated.
+//
+// The memory budget covers the scratch buffers of the workers (aux0, aux1
+// and the ray counts of every block and the aux of one block), the staged
+// copy of the scene data and the samples kept in memory.  Fewer workers cast
+// the views if their scratch buffers do not fit; what is left of the budget
+// holds samples.
+//
+// The results agree with boxm2CppCreateNormIntensitiesProcess +
+// boxm2CppCreateAuxDataProcess + boxm2CppBatchUpdateProcess.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+#include <boxm2/boxm2_scene.h>
+#include <boxm2/boxm2_block.h>
+#include <boxm2/io/boxm2_cache.h>
+#include <vpgl/vpgl_camera_double_sptr.h>
+#include <vil/vil_image_view.h>
+#include <bsta/algo/bsta_sigma_normalizer.h>
+#include <vcl_compiler.h>
+
+class boxm2_batch_update_engine
+{
+ public:
+  //: One gathered observation of a cell by a view, averaged over the rays hitting it
+  struct sample
+  {
+    unsigned index;  // data index of the cell within its block
+    float obs;       // mean observed intensity
+    float pre;       // mean pre
+    float vis;       // mean visibility
+    float post;      // mean post
+    float seg_len;   // segment length per ray, 0 if no ray was counted
+  };
+
+  //: Constructor
+  // \param num_threads   number of worker threads, 0 means one per processor
+  // \param mem_budget_gb memory budget for the gathered samples (in GB)
+  // \param spill_dir     directory for sample lists that do not fit the budget
+  boxm2_batch_update_engine(boxm2_scene_sptr scene, boxm2_cache_sptr cache,
+                            unsigned num_threads = 0,
+                            float mem_budget_gb = 1.0f,
+                            std::string const& spill_dir = "");
+
+  ~boxm2_batch_update_engine();
+
+  //: Add a view, the image must be grey float in [0,1] (see boxm2_util::prepare_input_image)
+  void add_view(vpgl_camera_double_sptr const& cam, vil_image_view<float> const& img);
+
+  //: Number of views added so far
+  unsigned num_views() const { return (unsigned)views_.size(); }
+
+  //: Gather the statistics of all views and update alpha and the appearance model of every cell.
+  //  Only BOXM2_MOG3_GREY and BOXM2_GAUSS_GREY appearance models are supported,
+  //  as in boxm2CppBatchUpdateProcess.  Returns false on an unsupported scene,
+  //  or if the samples written to a spill file can not be read back; the scene
+  //  data is then left unchanged.
+  bool run(bsta_sigma_normalizer_sptr n_table);
+
+  //: Number of bytes of samples that were written to spill files by the last run()
+  std::size_t spilled_bytes() const;
+
+  //: Number of bytes of samples that were kept in memory by the last run()
+  std::size_t in_memory_bytes() const;
+
+  //: Number of bytes of scratch buffers and staged scene data charged against the budget by the last run()
+  std::size_t working_bytes() const { return threads_.size()*scratch_bytes_ + staging_bytes_; }
+
+  //: Number of workers that cast the views in the last run()
+  unsigned num_workers() const { return (unsigned)threads_.size(); }
+
+  //: Remove the spill files of the last run() (also done by the destructor)
+  void remove_spill_files();
+
+  //: The cells are updated in chunks of this many cells
+  enum { chunk_size = 4096 };
+
+  //: Per-block state shared by all views
+  struct block_state
+  {
+    boxm2_block_id id;
+    boxm2_scene_info* info;
+    boxm2_data_base* alpha;
+    boxm2_data_base* apm;
+    boxm2_block* blk;
+    unsigned ncells;
+  };
+
+  //: Where the samples of one view in one block live
+  struct sample_list
+  {
+    sample_list() : spill_thread(-1), file_offset(0) {}
+    std::vector<sample> samples;        // in memory, sorted by cell index
+    int spill_thread;                   // if >= 0 the samples are in this worker's spill file
+    std::size_t file_offset;            // byte offset of the list in that spill file
+    std::vector<unsigned> chunk_start;  // position of the first sample of each chunk, plus the end
+  };
+
+  struct view_state
+  {
+    vpgl_camera_double_sptr cam;
+    vil_image_view<float> img;
+    std::vector<unsigned> vis_blocks;   // indices into blocks_, in visibility order
+    std::vector<sample_list> lists;     // one per entry of blocks_
+  };
+
+  //: Per worker scratch buffers and spill file
+  struct thread_state
+  {
+    thread_state() : aux(VXL_NULLPTR), in_memory_bytes(0), spilled_bytes(0), spill(VXL_NULLPTR) {}
+    std::vector<boxm2_data_base*> aux0, aux1, nobs;  // one per block, owned
+    boxm2_data_base* aux;                            // pass 2 of one block at a time, owned
+    std::size_t in_memory_bytes;
+    std::size_t spilled_bytes;
+    std::string spill_file;
+    std::ofstream* spill;
+  };
+
+ private:
+  boxm2_scene_sptr scene_;
+  boxm2_cache_sptr cache_;
+  unsigned num_threads_;
+  std::size_t mem_budget_bytes_;
+  //: scratch buffers of one worker and staged scene data of the last run()
+  std::size_t scratch_bytes_, staging_bytes_;
+  //: what is left of the budget for samples
+  std::size_t sample_budget_bytes_;
+  std::string spill_dir_;
+  std::string data_type_;
+
+  std::vector<block_state> blocks_;
+  std::vector<view_state> views_;
+  std::vector<thread_state> threads_;
+
+  //: fetch the blocks and the data the passes need from the cache
+  bool init_blocks();
+  //: choose the number of workers that fit the budget and allocate their scratch buffers
+  void init_threads();
+  void clear_threads();
+  //: flush the spill files before the samples are read back, false if one could not be written
+  bool flush_spill_files();
+
+  template <boxm2_data_type APM_TYPE> friend class boxm2_batch_update_engine_gather;
+  template <boxm2_data_type APM_TYPE> friend class boxm2_batch_update_engine_update;
+};
+
+#endif // boxm2_batch_update_engine_h_
@@ -15,6 +15,7 @@
 #include <bsta/bsta_mixture_fixed.h>
 #include <bsta/bsta_gaussian_indep.h>
 #include <bsta/algo/bsta_fit_gaussian.h>
+#include <bsta/algo/bsta_mog3_kernels.h>
 
 
 bool sort_components (vnl_vector_fixed<float,3> i,vnl_vector_fixed<float,3> j)
@@ -269,6 +270,25 @@ boxm2_mog3_grey_processor::update_gauss_mixture_3(vnl_vector_fixed<unsigned char
   mog3[7]=(unsigned char)std::floor(boxm2_mog3_grey_processor::clamp(sigma2,0,1)*255.0f);
 }
 
+void boxm2_mog3_grey_processor::prob_density(vnl_vector_fixed<unsigned char, 8> const* mog3, float const* x,
+                                             float* p, unsigned n)
+{
+  bsta_mog3_packed_prob_density(mog3[0].data_block(), x, p, 0, n);
+}
+
+void boxm2_mog3_grey_processor::expected_color(vnl_vector_fixed<unsigned char, 8> const* mog3, float* ev, unsigned n)
+{
+  bsta_mog3_packed_expected_value(mog3[0].data_block(), ev, 0, n);
+}
+
+void boxm2_mog3_grey_processor::update_gauss_mixture_3(vnl_vector_fixed<unsigned char, 8>* mog3,
+                                                       vnl_vector_fixed<float, 4>* nobs,
+                                                       float const* x, float const* w, unsigned n,
+                                                       float init_sigma, float min_sigma)
+{
+  bsta_mog3_packed_update(mog3[0].data_block(), nobs[0].data_block(), x, w, init_sigma, min_sigma, 0, n);
+}
+
 bool boxm2_mog3_grey_processor::merge_gauss(float mu1,float var1, float w1,
                                             float mu2,float var2, float w2,
                                             vnl_vector_fixed<float, 3> & new_component)
@@ -47,6 +47,17 @@ class  boxm2_mog3_grey_processor
                                 float& mu2, float& sigma2, float& w2, float& Nobs2);
      static float clamp(float x, float a, float b) { return x < a ? a : (x > b ? b : x); }
 
+     //: Batched versions of prob_density(), expected_color() and update_gauss_mixture_3()
+     //  for n models stored contiguously, as in the BOXM2_MOG3_GREY data blocks.
+     //  The results are identical to those of the per model functions.
+     static void prob_density(vnl_vector_fixed<unsigned char, 8> const* mog3, float const* x,
+                              float* p, unsigned n);
+     static void expected_color(vnl_vector_fixed<unsigned char, 8> const* mog3, float* ev, unsigned n);
+     static void update_gauss_mixture_3(vnl_vector_fixed<unsigned char, 8>* mog3,
+                                        vnl_vector_fixed<float, 4>* nobs,
+                                        float const* x, float const* w, unsigned n,
+                                        float init_sigma, float min_sigma);
+
      static bool merge_gauss(float mu1,float var1, float w1,
                             float mu2,float var2, float w2,
                             vnl_vector_fixed<float, 3> & new_component);
@@ -0,0 +1,282 @@
+//:
+// \file
+// \brief Checks the multi-view batch update engine against the per-image batch update
+//  The engine is compared with the aux files written by the passes of
+//  boxm2CppCreateNormIntensitiesProcess and boxm2CppCreateAuxDataProcess and
+//  read back by boxm2CppBatchUpdateProcess, and with itself on several
+//  threads with every sample list spilled to disk.
+#include <vector>
+#include <string>
+#include <sstream>
+#include <cstring>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vul/vul_file.h>
+#include <vpl/vpl.h>
+#include <vgl/vgl_point_3d.h>
+#include <vpgl/vpgl_perspective_camera.h>
+#include <vil/vil_image_view.h>
+
+#include <boct/boct_bit_tree.h>
+
+#include <boxm2/boxm2_scene.h>
+#include <boxm2/boxm2_block.h>
+#include <boxm2/boxm2_data.h>
+#include <boxm2/boxm2_block_metadata.h>
+#include <boxm2/io/boxm2_lru_cache.h>
+#include <boxm2/io/boxm2_stream_cache.h>
+#include <boxm2/cpp/algo/boxm2_batch_update_engine.h>
+#include <boxm2/cpp/algo/boxm2_batch_functors.h>
+#include <boxm2/cpp/algo/boxm2_cast_ray_function.h>
+#include <boxm2/cpp/algo/boxm2_data_serial_iterator.h>
+#include <bsta/algo/bsta_sigma_normalizer.h>
+
+static vpgl_camera_double_sptr engine_test_camera(double x, double y)
+{
+  vnl_matrix_fixed<double, 3, 3> mk(0.0);
+  mk[0][0]=990.0; mk[0][2]=4.0;
+  mk[1][1]=990.0; mk[1][2]=4.0; mk[2][2]=8.0/7.0;
+  vpgl_calibration_matrix<double> K(mk);
+  vnl_matrix_fixed<double, 3, 3> mr(0.0);
+  mr[0][0]=1.0; mr[1][1]=-1.0; mr[2][2]=-1.0;
+  vgl_rotation_3d<double> R(mr);
+  vgl_point_3d<double> t(x,y,100);
+  return new vpgl_perspective_camera<double>(K,t,R);
+}
+
+//: Runs the engine, returns the number of workers, if it spilled and the memory it kept
+static void run_engine(boxm2_scene_sptr scene, unsigned nthreads, float budget_gb,
+                       std::vector<vpgl_camera_double_sptr> const& cams,
+                       std::vector<vil_image_view<float> > const& imgs,
+                       bsta_sigma_normalizer_sptr n_table,
+                       unsigned& workers, bool& spilled, std::size_t& memory)
+{
+  boxm2_batch_update_engine engine(scene, boxm2_cache::instance(), nthreads, budget_gb);
+  for (unsigned v = 0; v < cams.size(); ++v)
+    engine.add_view(cams[v], imgs[v]);
+  TEST("engine run", engine.run(n_table), true);
+  workers = engine.num_workers();
+  spilled = engine.spilled_bytes() > 0;
+  memory = engine.working_bytes() + engine.in_memory_bytes();
+}
+
+//: The largest relative difference of alpha and the largest difference of an appearance byte
+static void compare(std::vector<float> const& alpha_ref, std::vector<char> const& mog_ref,
+                    boxm2_data_base* alph, boxm2_data_base* mog,
+                    float& alpha_diff, unsigned& mog_diff)
+{
+  const float* alpha = reinterpret_cast<const float*>(alph->data_buffer());
+  alpha_diff = 0.0f;
+  for (unsigned c = 0; c < alpha_ref.size(); ++c)
+    alpha_diff = std::max(alpha_diff, std::fabs(alpha[c]-alpha_ref[c])/std::max(1.0f, std::fabs(alpha_ref[c])));
+  mog_diff = 0;
+  for (unsigned b = 0; b < mog_ref.size(); ++b) {
+    int d = int((unsigned char)mog_ref[b]) - int((unsigned char)mog->data_buffer()[b]);
+    if (d < 0) d = -d;
+    if (unsigned(d) > mog_diff) mog_diff = unsigned(d);
+  }
+}
+
+//: The passes of boxm2CppCreateNormIntensitiesProcess and boxm2CppCreateAuxDataProcess for one image,
+//  writing the aux data of the image to the data path of the scene
+static void legacy_aux_data(boxm2_scene_sptr scene, vpgl_camera_double_sptr cam,
+                            vil_image_view<float>& img, std::string const& identifier)
+{
+  boxm2_cache_sptr cache = boxm2_cache::instance();
+  std::string aux0_type = boxm2_data_traits<BOXM2_AUX0>::prefix(identifier);
+  std::string aux1_type = boxm2_data_traits<BOXM2_AUX1>::prefix(identifier);
+  std::string nobs_type = boxm2_data_traits<BOXM2_NUM_OBS_SINGLE>::prefix(identifier);
+  std::string aux_type = boxm2_data_traits<BOXM2_AUX>::prefix(identifier);
+  std::vector<boxm2_block_id> vis_order = scene->get_vis_blocks(cam);
+  std::vector<boxm2_block_id>::iterator id;
+
+  for (id = vis_order.begin(); id != vis_order.end(); ++id) {
+    boxm2_scene_info* info = scene->get_blk_metadata(*id);
+    std::vector<boxm2_data_base*> datas;
+    datas.push_back(cache->get_data_base_new(scene, *id, aux0_type, 0, false));
+    datas.push_back(cache->get_data_base_new(scene, *id, aux1_type, 0, false));
+    datas.push_back(cache->get_data_base_new(scene, *id, nobs_type, 0, false));
+    boxm2_batch_update_pass0_functor pass0;
+    pass0.init_data(datas, &img);
+    cast_ray_per_block<boxm2_batch_update_pass0_functor>(pass0, info, cache->get_block(scene, *id), cam, img.ni(), img.nj());
+    delete info;
+  }
+
+  vil_image_view<float> pre_inf_img(img.ni(), img.nj()), vis_inf_img(img.ni(), img.nj());
+  pre_inf_img.fill(0.0f);
+  vis_inf_img.fill(1.0f);
+  for (id = vis_order.begin(); id != vis_order.end(); ++id) {
+    boxm2_scene_info* info = scene->get_blk_metadata(*id);
+    std::vector<boxm2_data_base*> datas;
+    datas.push_back(cache->get_data_base(scene, *id, aux0_type));
+    datas.push_back(cache->get_data_base(scene, *id, aux1_type));
+    datas.push_back(cache->get_data_base(scene, *id, boxm2_data_traits<BOXM2_ALPHA>::prefix(), 0, false));
+    datas.push_back(cache->get_data_base(scene, *id, boxm2_data_traits<BOXM2_MOG3_GREY>::prefix(), 0, false));
+    boxm2_batch_update_pass1_functor<BOXM2_MOG3_GREY> pass1;
+    pass1.init_data(datas, &pre_inf_img, &vis_inf_img);
+    cast_ray_per_block<boxm2_batch_update_pass1_functor<BOXM2_MOG3_GREY> >(pass1, info, cache->get_block(scene, *id), cam, img.ni(), img.nj());
+    delete info;
+  }
+
+  vil_image_view<float> pre_img(img.ni(), img.nj()), vis_img(img.ni(), img.nj());
+  pre_img.fill(0.0f);
+  vis_img.fill(1.0f);
+  for (id = vis_order.begin(); id != vis_order.end(); ++id) {
+    boxm2_scene_info* info = scene->get_blk_metadata(*id);
+    std::vector<boxm2_data_base*> datas;
+    datas.push_back(cache->get_data_base(scene, *id, aux0_type));
+    datas.push_back(cache->get_data_base(scene, *id, aux1_type));
+    datas.push_back(cache->get_data_base(scene, *id, boxm2_data_traits<BOXM2_ALPHA>::prefix(), 0, false));
+    datas.push_back(cache->get_data_base(scene, *id, boxm2_data_traits<BOXM2_MOG3_GREY>::prefix(), 0, false));
+    datas.push_back(cache->get_data_base_new(scene, *id, aux_type, 0, false));
+    boxm2_batch_update_pass2_functor<BOXM2_MOG3_GREY> pass2;
+    pass2.init_data(datas, &pre_img, &vis_img, &pre_inf_img, &vis_inf_img);
+    cast_ray_per_block<boxm2_batch_update_pass2_functor<BOXM2_MOG3_GREY> >(pass2, info, cache->get_block(scene, *id), cam, img.ni(), img.nj());
+    delete info;
+  }
+
+  // the stream cache reads the aux data from disk
+  for (id = vis_order.begin(); id != vis_order.end(); ++id) {
+    cache->remove_data_base(scene, *id, aux0_type);
+    cache->remove_data_base(scene, *id, aux1_type);
+    cache->remove_data_base(scene, *id, nobs_type);
+    cache->remove_data_base(scene, *id, aux_type);
+  }
+}
+
+//: The update of boxm2CppBatchUpdateProcess from the aux data of the images
+static void legacy_batch_update(boxm2_scene_sptr scene, std::vector<std::string> const& identifiers,
+                                bsta_sigma_normalizer_sptr n_table)
+{
+  std::vector<std::string> types;
+  types.push_back(boxm2_data_traits<BOXM2_AUX0>::prefix());
+  types.push_back(boxm2_data_traits<BOXM2_AUX1>::prefix());
+  types.push_back(boxm2_data_traits<BOXM2_AUX>::prefix());
+  types.push_back(boxm2_data_traits<BOXM2_NUM_OBS_SINGLE>::prefix());
+  boxm2_stream_cache_sptr str_cache = new boxm2_stream_cache(scene, types, identifiers, 0.01f);
+
+  boxm2_cache_sptr cache = boxm2_cache::instance();
+  std::vector<boxm2_block_id> ids = scene->get_block_ids();
+  for (std::vector<boxm2_block_id>::iterator id = ids.begin(); id != ids.end(); ++id) {
+    boxm2_data_base* alph = cache->get_data_base(scene, *id, boxm2_data_traits<BOXM2_ALPHA>::prefix(), 0, false);
+    boxm2_data_base* mog = cache->get_data_base(scene, *id, boxm2_data_traits<BOXM2_MOG3_GREY>::prefix(), 0, false);
+    boxm2_batch_update_functor<BOXM2_MOG3_GREY> data_functor;
+    data_functor.init_data(alph, mog, str_cache, n_table);
+    boxm2_data_serial_iterator<boxm2_batch_update_functor<BOXM2_MOG3_GREY> >(int(alph->buffer_length()/sizeof(float)), data_functor);
+  }
+  str_cache->close_streams();
+}
+
+void test_batch_update_engine()
+{
+  // the aux data of the images and the spill files go to a directory of their own
+  std::string data_dir = "boxm2_test_batch_update_engine";
+  vul_file::make_directory(data_dir);
+  vul_file::delete_file_glob(data_dir + "/*");
+  boxm2_scene_sptr scene = new boxm2_scene();
+  scene->set_data_path(data_dir);
+  scene->set_local_origin( vgl_point_3d<double>(0,0,0) );
+  std::map<boxm2_block_id, boxm2_block_metadata> blocks;
+  boxm2_block_id id(0,0,0);
+  boxm2_block_metadata data(id,
+                            vgl_point_3d<double>(0,0,0),
+                            vgl_vector_3d<double>(1.0/8.0, 1.0/8.0, 1.0/8.0),
+                            vgl_vector_3d<unsigned>(8,8,1),
+                            1, 1, 100,
+                            0.01);
+  blocks[id] = data;
+  scene->set_blocks(blocks);
+  std::vector<std::string> appearances;
+  appearances.push_back(boxm2_data_traits<BOXM2_MOG3_GREY>::prefix());
+  scene->set_appearances(appearances);
+
+  boxm2_lru_cache::create(scene);
+  boxm2_data_base* alph = boxm2_cache::instance()->get_data_base(scene,id,boxm2_data_traits<BOXM2_ALPHA>::prefix(),0,false);
+  boxm2_data_base* mog = boxm2_cache::instance()->get_data_base(scene,id,boxm2_data_traits<BOXM2_MOG3_GREY>::prefix(),0,false);
+  unsigned ncells = (unsigned)(alph->buffer_length()/sizeof(float));
+  float* alpha = reinterpret_cast<float*>(alph->data_buffer());
+  for (unsigned c = 0; c < ncells; ++c)
+    alpha[c] = 0.5f + 0.1f*float(c%7);
+
+  // three views from slightly different positions, each with its own intensity pattern
+  std::vector<vpgl_camera_double_sptr> cams;
+  std::vector<vil_image_view<float> > imgs;
+  for (unsigned v = 0; v < 3; ++v) {
+    cams.push_back(engine_test_camera(0.45+0.05*v, 0.5));
+    vil_image_view<float> img(8,8);
+    for (unsigned i=0;i<8;i++)
+      for (unsigned j=0;j<8;j++)
+        img(i,j)=float((i+j+v)%8)/8.0f;
+    imgs.push_back(img);
+  }
+  bsta_sigma_normalizer_sptr n_table = new bsta_sigma_normalizer(0.95f, 20);
+
+  std::vector<char> alpha0(alph->data_buffer(), alph->data_buffer()+alph->buffer_length());
+  std::vector<char> mog0(mog->data_buffer(), mog->data_buffer()+mog->buffer_length());
+
+  // reference: one thread, everything in memory
+  unsigned workers = 0;
+  bool spilled = true;
+  std::size_t memory = 0;
+  run_engine(scene, 1, 1.0f, cams, imgs, n_table, workers, spilled, memory);
+  TEST("serial run keeps samples in memory", spilled, false);
+  std::vector<float> alpha_ref(alpha, alpha+ncells);
+  std::vector<char> mog_ref(mog->data_buffer(), mog->data_buffer()+mog->buffer_length());
+  bool changed = false;
+  for (unsigned c = 0; c < ncells; ++c)
+    changed = changed || alpha_ref[c] != reinterpret_cast<float*>(&alpha0[0])[c];
+  TEST("alpha updated", changed, true);
+
+  // the per-image passes, aux files and stream cache of the process based batch update
+  std::memcpy(alph->data_buffer(), &alpha0[0], alpha0.size());
+  std::memcpy(mog->data_buffer(), &mog0[0], mog0.size());
+  std::vector<std::string> identifiers;
+  for (unsigned v = 0; v < cams.size(); ++v) {
+    std::ostringstream identifier;
+    identifier << "img_" << v;
+    identifiers.push_back(identifier.str());
+    legacy_aux_data(scene, cams[v], imgs[v], identifiers.back());
+  }
+  legacy_batch_update(scene, identifiers, n_table);
+  float alpha_diff = 0.0f;
+  unsigned mog_diff = 0;
+  compare(alpha_ref, mog_ref, alph, mog, alpha_diff, mog_diff);
+  TEST_NEAR("alpha matches the process based batch update", alpha_diff, 0.0f, 1e-4f);
+  TEST("appearance matches the process based batch update (within one quantization step)", mog_diff <= 1, true);
+
+  // three threads, everything in memory
+  std::memcpy(alph->data_buffer(), &alpha0[0], alpha0.size());
+  std::memcpy(mog->data_buffer(), &mog0[0], mog0.size());
+  run_engine(scene, 3, 1.0f, cams, imgs, n_table, workers, spilled, memory);
+  TEST("three workers", workers, 3);
+  compare(alpha_ref, mog_ref, alph, mog, alpha_diff, mog_diff);
+  TEST_NEAR("threaded alpha matches serial", alpha_diff, 0.0f, 1e-4f);
+  TEST("threaded appearance matches serial (within one quantization step)", mog_diff <= 1, true);
+
+  // a budget that only just holds the scratch buffers of three workers: the sample lists are spilled
+  std::size_t budget = memory - 16;
+  std::memcpy(alph->data_buffer(), &alpha0[0], alpha0.size());
+  std::memcpy(mog->data_buffer(), &mog0[0], mog0.size());
+  run_engine(scene, 3, float(budget/std::pow(2.0, 30.0)), cams, imgs, n_table, workers, spilled, memory);
+  TEST("three workers in a small budget", workers, 3);
+  TEST("small budget spills", spilled, true);
+  TEST("memory within the budget", memory <= budget, true);
+  compare(alpha_ref, mog_ref, alph, mog, alpha_diff, mog_diff);
+  TEST_NEAR("threaded, spilled alpha matches serial", alpha_diff, 0.0f, 1e-4f);
+  TEST("threaded, spilled appearance matches serial (within one quantization step)", mog_diff <= 1, true);
+
+  // no budget: a single worker, everything spilled
+  std::memcpy(alph->data_buffer(), &alpha0[0], alpha0.size());
+  std::memcpy(mog->data_buffer(), &mog0[0], mog0.size());
+  run_engine(scene, 3, 0.0f, cams, imgs, n_table, workers, spilled, memory);
+  TEST("zero budget leaves one worker", workers, 1);
+  TEST("zero budget spills", spilled, true);
+  compare(alpha_ref, mog_ref, alph, mog, alpha_diff, mog_diff);
+  TEST_NEAR("zero budget alpha matches serial", alpha_diff, 0.0f, 1e-4f);
+  TEST("zero budget appearance matches serial (within one quantization step)", mog_diff <= 1, true);
+
+  vul_file::delete_file_glob(data_dir + "/*");
+  vpl_rmdir(data_dir.c_str());
+}
+
+TESTMAIN(test_batch_update_engine);
@@ -4,6 +4,8 @@ DECLARE( test_merge_mixtures );
 DECLARE( test_cone_ray_trace );
 DECLARE( test_cone_update );
 DECLARE( test_merge_function );
+DECLARE( test_batch_update_engine );
+DECLARE( test_mog3_batch );
 
 void register_tests()
 {
@@ -11,6 +13,8 @@ void register_tests()
   REGISTER( test_cone_ray_trace );
   REGISTER( test_cone_update );
   REGISTER( test_merge_function );
+  REGISTER( test_batch_update_engine );
+  REGISTER( test_mog3_batch );
 }
 
 
@@ -2,6 +2,7 @@
 #include <boxm2/cpp/algo/boxm2_batch_functors.h>
 #include <boxm2/cpp/algo/boxm2_batch_opt2_functors.h>
 #include <boxm2/cpp/algo/boxm2_batch_opt2_phongs_functors.h>
+#include <boxm2/cpp/algo/boxm2_batch_update_engine.h>
 #include <boxm2/cpp/algo/boxm2_cast_cone_ray_function.h>
 #include <boxm2/cpp/algo/boxm2_cast_intensities_functor.h>
 #include <boxm2/cpp/algo/boxm2_cast_ray_function.h>
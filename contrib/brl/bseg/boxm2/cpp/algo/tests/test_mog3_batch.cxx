@@ -0,0 +1,49 @@
+//:
+// \file
+// \brief Test the batched boxm2_mog3_grey_processor functions against the per cell ones
+
+#include <vector>
+#include <testlib/testlib_test.h>
+#include <vnl/vnl_random.h>
+
+#include <boxm2/cpp/algo/boxm2_mog3_grey_processor.h>
+
+void test_mog3_batch()
+{
+  const unsigned n = 1000, iters = 30;
+  vnl_random rng(12345);
+  std::vector<vnl_vector_fixed<unsigned char,8> > mog_s(n, vnl_vector_fixed<unsigned char,8>((unsigned char)0));
+  std::vector<vnl_vector_fixed<float,4> > nobs_s(n, vnl_vector_fixed<float,4>(0.0f));
+  std::vector<vnl_vector_fixed<unsigned char,8> > mog_b(mog_s);
+  std::vector<vnl_vector_fixed<float,4> > nobs_b(nobs_s);
+  std::vector<float> x(n), w(n), p_s(n), p_b(n), ev_s(n), ev_b(n);
+
+  bool same_update = true, same_density = true, same_color = true;
+  for (unsigned t = 0; t < iters; ++t) {
+    for (unsigned i = 0; i < n; ++i) {
+      // three clusters of intensities, so the mixtures fill up and get reordered
+      x[i] = float(rng.lrand32(0,2))*0.3f + 0.15f + float(rng.normal())*0.04f;
+      w[i] = rng.lrand32(0,7) == 0 ? 0.0f : float(rng.drand32(0.05, 1.0));
+    }
+    for (unsigned i = 0; i < n; ++i)
+      boxm2_mog3_grey_processor::update_gauss_mixture_3(mog_s[i], nobs_s[i], x[i], w[i], 0.09f, 0.03f);
+    boxm2_mog3_grey_processor::update_gauss_mixture_3(&mog_b[0], &nobs_b[0], &x[0], &w[0], n, 0.09f, 0.03f);
+
+    for (unsigned i = 0; i < n; ++i) {
+      p_s[i] = boxm2_mog3_grey_processor::prob_density(mog_s[i], x[i]);
+      ev_s[i] = boxm2_mog3_grey_processor::expected_color(mog_s[i]);
+    }
+    boxm2_mog3_grey_processor::prob_density(&mog_b[0], &x[0], &p_b[0], n);
+    boxm2_mog3_grey_processor::expected_color(&mog_b[0], &ev_b[0], n);
+    for (unsigned i = 0; i < n; ++i) {
+      same_update = same_update && mog_s[i] == mog_b[i] && nobs_s[i] == nobs_b[i];
+      same_density = same_density && p_s[i] == p_b[i];
+      same_color = same_color && ev_s[i] == ev_b[i];
+    }
+  }
+  TEST("batched update is identical", same_update, true);
+  TEST("batched prob_density is identical", same_density, true);
+  TEST("batched expected_color is identical", same_color, true);
+}
+
+TESTMAIN(test_mog3_batch);
@@ -50,6 +50,7 @@ DECLARE_FUNC_CONS(boxm2_cpp_batch_update_opt2_process);
 DECLARE_FUNC_CONS(boxm2_cpp_image_density_process);
 DECLARE_FUNC_CONS(boxm2_cpp_batch_update_app_process);
 DECLARE_FUNC_CONS(boxm2_cpp_batch_update_alpha_process);
+DECLARE_FUNC_CONS(boxm2_cpp_batch_update_multi_view_process);
 
 DECLARE_FUNC_CONS(boxm2_cpp_merge_process);
 
@@ -61,6 +61,7 @@ void boxm2_cpp_register::register_process()
 
   REG_PROCESS_FUNC_CONS(bprb_func_process, bprb_batch_process_manager, boxm2_cpp_batch_update_app_process, "boxm2CppBatchUpdateAppProcess");
   REG_PROCESS_FUNC_CONS(bprb_func_process, bprb_batch_process_manager, boxm2_cpp_batch_update_alpha_process, "boxm2CppBatchUpdateAlphaProcess");
+  REG_PROCESS_FUNC_CONS(bprb_func_process, bprb_batch_process_manager, boxm2_cpp_batch_update_multi_view_process, "boxm2CppBatchUpdateMultiViewProcess");
 
   REG_PROCESS_FUNC_CONS(bprb_func_process, bprb_batch_process_manager, boxm2_cpp_update_with_shadow_process, "boxm2CppUpdateWithShadowProcess");
   REG_PROCESS_FUNC_CONS(bprb_func_process, bprb_batch_process_manager, boxm2_cpp_image_density_masked_process, "boxm2CppImageDensityMaskedProcess");
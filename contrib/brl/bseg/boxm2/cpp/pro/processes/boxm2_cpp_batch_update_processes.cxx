@@ -20,6 +20,7 @@
 #include <boxm2/boxm2_util.h>
 
 #include <boxm2/cpp/algo/boxm2_batch_functors.h>
+#include <boxm2/cpp/algo/boxm2_batch_update_engine.h>
 #include <boxm2/cpp/algo/boxm2_data_serial_iterator.h>
 
 
@@ -614,3 +615,85 @@ bool boxm2_cpp_batch_update_alpha_process(bprb_func_process& pro)
   return true;
 }
 
+
+//: run the whole batch update (norm intensities, aux data and cell update) for a list of views in memory
+//  The views are cast concurrently by boxm2_batch_update_engine, no per-image aux data is written to disk.
+namespace boxm2_cpp_batch_update_multi_view_process_globals
+{
+  const unsigned n_inputs_ = 7;
+  const unsigned n_outputs_ = 0;
+}
+
+bool boxm2_cpp_batch_update_multi_view_process_cons(bprb_func_process& pro)
+{
+  using namespace boxm2_cpp_batch_update_multi_view_process_globals;
+
+  //process takes 7 inputs
+  // 0) scene
+  // 1) cache
+  // 2) the pre-computed sigma normalizer table
+  // 3) view list file: the number of views followed by an image path and a camera path per view
+  // 4) number of threads, 0 to use one per processor
+  // 5) number of gigabytes available for the scratch buffers of the threads and the gathered samples
+  // 6) directory for the samples exceeding the memory budget, empty to use the scene data path
+  std::vector<std::string> input_types_(n_inputs_);
+  input_types_[0] = "boxm2_scene_sptr";
+  input_types_[1] = "boxm2_cache_sptr";
+  input_types_[2] = "bsta_sigma_normalizer_sptr";
+  input_types_[3] = "vcl_string";
+  input_types_[4] = "unsigned";
+  input_types_[5] = "float";
+  input_types_[6] = "vcl_string";
+  // process has 0 output:
+  std::vector<std::string>  output_types_(n_outputs_);
+
+  return pro.set_input_types(input_types_) && pro.set_output_types(output_types_);
+}
+
+bool boxm2_cpp_batch_update_multi_view_process(bprb_func_process& pro)
+{
+  using namespace boxm2_cpp_batch_update_multi_view_process_globals;
+
+  if ( pro.n_inputs() < n_inputs_ ){
+      std::cout << pro.name() << ": The number of inputs should be " << n_inputs_<< std::endl;
+      return false;
+  }
+  //get the inputs
+  unsigned i = 0;
+  boxm2_scene_sptr scene =pro.get_input<boxm2_scene_sptr>(i++);
+  boxm2_cache_sptr cache= pro.get_input<boxm2_cache_sptr>(i++);
+  bsta_sigma_normalizer_sptr n_table = pro.get_input<bsta_sigma_normalizer_sptr>(i++);
+  std::string view_list = pro.get_input<std::string>(i++);
+  unsigned num_threads = pro.get_input<unsigned>(i++);
+  float num_giga = pro.get_input<float>(i++);
+  std::string spill_dir = pro.get_input<std::string>(i++);
+
+  std::ifstream ifs(view_list.c_str());
+  if (!ifs.good()) {
+    std::cerr << "error opening file " << view_list << '\n';
+    return false;
+  }
+  boxm2_batch_update_engine engine(scene, cache, num_threads, num_giga, spill_dir);
+  unsigned int n_views = 0;
+  ifs >> n_views;
+  for (unsigned int v=0; v<n_views; ++v) {
+    std::string img_file, cam_file;
+    ifs >> img_file >> cam_file;
+    vpgl_camera_double_sptr cam = boxm2_util::camera_from_file(cam_file);
+    vil_image_view_base_sptr float_image = boxm2_util::prepare_input_image(img_file, true);
+    vil_image_view<float> * input_image = dynamic_cast<vil_image_view<float> * > (float_image.ptr());
+    if (!cam || !input_image) {
+      std::cerr << pro.name() << ": cannot load view " << img_file << ' ' << cam_file << '\n';
+      return false;
+    }
+    engine.add_view(cam, *input_image);
+  }
+  ifs.close();
+
+  if (!engine.run(n_table))
+    return false;
+  std::cout << pro.name() << ": updated with " << engine.num_views() << " views, "
+           << engine.in_memory_bytes() << " bytes of samples in memory, "
+           << engine.spilled_bytes() << " bytes spilled" << std::endl;
+  return true;
+}
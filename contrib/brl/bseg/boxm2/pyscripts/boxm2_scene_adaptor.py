@@ -651,6 +651,31 @@ class boxm2_scene_adaptor(object):
 
         self.write_cache()
 
+    # batch update from a list of views without per-image aux files, the
+    # views are cast concurrently on num_threads threads (0: one per core)
+    def cpu_batch_update_multi_view(self, view_list_file, num_threads=0, mem_gb=4.0, spill_dir=""):
+        under_estimation_probability = 0.2
+        boxm2_batch.init_process("bstaSigmaNormTableProcess")
+        boxm2_batch.set_input_float(0, under_estimation_probability)
+        boxm2_batch.run_process()
+        (id, type) = boxm2_batch.commit_output(0)
+        n_table = dbvalue(id, type)
+
+        boxm2_batch.init_process("boxm2CppBatchUpdateMultiViewProcess")
+        boxm2_batch.set_input_from_db(0, self.scene)
+        boxm2_batch.set_input_from_db(1, self.cpu_cache)
+        boxm2_batch.set_input_from_db(2, n_table)
+        boxm2_batch.set_input_string(3, view_list_file)
+        boxm2_batch.set_input_unsigned(4, num_threads)
+        boxm2_batch.set_input_float(5, mem_gb)
+        boxm2_batch.set_input_string(6, spill_dir)
+        status = boxm2_batch.run_process()
+
+        # the scene is only written when every cell could be updated
+        if status:
+            self.write_cache()
+        return status
+
     def cpu_batch_compute_normal_albedo(self, metadata_filename_list, atmospheric_params_filename_list):
         boxm2_batch.init_process("boxm2CppBatchComputeNormalAlbedoProcess")
         boxm2_batch.set_input_from_db(0, self.scene)
@@ -0,0 +1,542 @@
+// This is brl/bseg/boxm2/volm/boxm2_volm_matcher_p1_cpu.cxx
+#include <iostream>
+#include <algorithm>
+#include "boxm2_volm_matcher_p1_cpu.h"
+//:
+// \file
+#include <volm/volm_query.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+#include <vxl_config.h>
+
+#if VXL_HAS_PTHREAD_H
+#include <pthread.h>
+#endif
+
+boxm2_volm_p1_query::boxm2_volm_p1_query()
+: n_cam(0), n_obj(0), layer_size(0), fallback_size(0), grd_weight(0.0f), sky_weight(0.0f)
+{
+  grd_wgt_attri[0] = grd_wgt_attri[1] = grd_wgt_attri[2] = 0.0f;
+  for (unsigned d = 0; d < 256; ++d) {
+    depth_value[d] = 0.0f;
+    depth_valid[d] = 0;
+  }
+}
+
+bool boxm2_volm_p1_query::set(volm_query_sptr const& query, std::vector<volm_weight> const& weights,
+                              std::vector<float> const& depth_intervals)
+{
+  bool is_grd = query->depth_scene()->ground_plane().size() != 0;
+  bool is_sky = query->depth_scene()->sky().size() != 0;
+  n_cam = query->get_cam_num();
+  n_obj = (unsigned)query->depth_regions().size();
+  layer_size = query->get_query_size();
+  unsigned char fs;
+  volm_fallback_label::size(fs);
+  fallback_size = fs;
+  depth_interval = depth_intervals;
+  if (n_obj == 0) {
+    std::cerr << "\n ERROR: pass 1 matcher is not able to match query without any non_grd, non_sky object\n";
+    return false;
+  }
+  unsigned first_obj = (is_sky ? 1 : 0) + (is_grd ? 1 : 0);
+  if (weights.size() != first_obj + n_obj) {
+    std::cerr << "\n ERROR: inconsistency between volm_query and volm_weight\n";
+    return false;
+  }
+
+  // weights, sky first then ground then the objects
+  sky_weight = is_sky ? weights[0].w_obj_ : 0.0f;
+  if (is_grd) {
+    volm_weight const& w = weights[is_sky ? 1 : 0];
+    grd_weight = w.w_obj_;
+    grd_wgt_attri[0] = w.w_ori_;  grd_wgt_attri[1] = w.w_lnd_;  grd_wgt_attri[2] = w.w_dst_;
+  }
+  obj_weight.resize(n_obj);
+  obj_wgt_attri.resize(4*n_obj);
+  for (unsigned k = 0; k < n_obj; ++k) {
+    volm_weight const& w = weights[first_obj + k];
+    obj_wgt_attri[4*k]   = w.w_ori_;
+    obj_wgt_attri[4*k+1] = w.w_lnd_;
+    obj_wgt_attri[4*k+2] = w.w_dst_;
+    obj_wgt_attri[4*k+3] = w.w_ord_;
+    obj_weight[k] = w.w_obj_;
+  }
+
+  grd_id.clear();  grd_offset.clear();  grd_dist.clear();  grd_land.clear();  grd_land_wgt.clear();
+  if (is_grd) {
+    std::vector<std::vector<unsigned> >& gid = query->ground_id();
+    std::vector<std::vector<unsigned char> >& gdist = query->ground_dist();
+    std::vector<std::vector<std::vector<unsigned char> > >& gland = query->ground_land_id();
+    std::vector<std::vector<std::vector<float> > >& gwgt = query->ground_land_wgt();
+    for (unsigned c = 0; c < n_cam; ++c) {
+      grd_offset.push_back((unsigned)grd_id.size());
+      for (unsigned v = 0; v < gid[c].size(); ++v) {
+        grd_id.push_back(gid[c][v]);
+        grd_dist.push_back(gdist[c][v]);
+        for (unsigned f = 0; f < fallback_size; ++f) {
+          grd_land.push_back(gland[c][v][f]);
+          grd_land_wgt.push_back(gwgt[c][v][f]);
+        }
+      }
+    }
+    grd_offset.push_back((unsigned)grd_id.size());
+  }
+
+  sky_id.clear();  sky_offset.clear();
+  if (is_sky) {
+    std::vector<std::vector<unsigned> >& sid = query->sky_id();
+    for (unsigned c = 0; c < n_cam; ++c) {
+      sky_offset.push_back((unsigned)sky_id.size());
+      sky_id.insert(sky_id.end(), sid[c].begin(), sid[c].end());
+    }
+    sky_offset.push_back((unsigned)sky_id.size());
+  }
+
+  obj_id.clear();  obj_offset.clear();
+  std::vector<std::vector<std::vector<unsigned> > >& did = query->dist_id();
+  for (unsigned c = 0; c < n_cam; ++c)
+    for (unsigned k = 0; k < n_obj; ++k) {
+      obj_offset.push_back((unsigned)obj_id.size());
+      obj_id.insert(obj_id.end(), did[c][k].begin(), did[c][k].end());
+    }
+  obj_offset.push_back((unsigned)obj_id.size());
+
+  obj_min_dist.resize(n_obj);
+  obj_orient.resize(n_obj);
+  obj_land.resize(n_obj*fallback_size);
+  obj_land_wgt.resize(n_obj*fallback_size);
+  for (unsigned k = 0; k < n_obj; ++k) {
+    obj_min_dist[k] = query->min_obj_dist()[k];
+    // horizontal is 1, front parallel and slanted are vertical (2), anything else is invalid
+    unsigned char o = query->obj_orient()[k];
+    if (o == depth_map_region::HORIZONTAL)
+      obj_orient[k] = 1;
+    else if (o == depth_map_region::FRONT_PARALLEL ||
+             o == depth_map_region::SLANTED_LEFT ||
+             o == depth_map_region::SLANTED_RIGHT)
+      obj_orient[k] = 2;
+    else
+      obj_orient[k] = 0;
+    for (unsigned f = 0; f < fallback_size; ++f) {
+      obj_land[k*fallback_size+f] = query->obj_land_id()[k][f];
+      obj_land_wgt[k*fallback_size+f] = query->obj_land_wgt()[k][f];
+    }
+  }
+  this->build_tables();
+  return true;
+}
+
+void boxm2_volm_p1_query::build_tables()
+{
+  unsigned len = (unsigned)depth_interval.size();
+  for (unsigned d = 0; d < 256; ++d) {
+    depth_value[d] = d < len ? depth_interval[d] : 0.0f;
+    depth_valid[d] = (d < 253 && d < len) ? 1 : 0;
+  }
+
+  // the altitude in the index may be up to 3 meters, which gives a tolerance of twice the ground distance
+  const unsigned char alt_ratio = 2;
+  grd_dst_ok.assign(256*256, 0);
+  for (unsigned g = 0; g < 256 && g < len; ++g) {
+    float grd_d = depth_interval[g];
+    float delta_d = alt_ratio * grd_d;
+    for (unsigned d = 0; d < 256 && d < len; ++d) {
+      float ind_d = depth_interval[d];
+      grd_dst_ok[256*g+d] = (ind_d >= (grd_d - delta_d) && ind_d <= (grd_d + delta_d)) ? 1 : 0;
+    }
+  }
+
+  obj_min_ok.assign(256*n_obj, 0);
+  obj_ori_ok.assign(256*n_obj, 0);
+  obj_lnd_score.assign(256*n_obj, 0.0f);
+  for (unsigned k = 0; k < n_obj; ++k)
+    for (unsigned v = 0; v < 256; ++v) {
+      obj_min_ok[256*k+v] = (depth_valid[v] && v > obj_min_dist[k]) ? 1 : 0;
+      if (obj_orient[k] == 1)
+        obj_ori_ok[256*k+v] = v == 1 ? 1 : 0;
+      else
+        obj_ori_ok[256*k+v] = (v > 1 && v < 10 && obj_orient[k] != 0) ? 1 : 0;
+      // the first fallback category that matches
+      if (v == 0)
+        continue;
+      for (unsigned f = 0; f < fallback_size; ++f)
+        if (obj_land[k*fallback_size+f] == v) {
+          obj_lnd_score[256*k+v] = obj_land_wgt[k*fallback_size+f];
+          break;
+        }
+    }
+}
+
+//: Orders locations, better first: higher max score, then lower leaf and hypothesis id
+static bool boxm2_volm_p1_better(volm_score_sptr const& a, volm_score_sptr const& b)
+{
+  if (a->max_score_ != b->max_score_)
+    return a->max_score_ > b->max_score_;
+  if (a->leaf_id_ != b->leaf_id_)
+    return a->leaf_id_ < b->leaf_id_;
+  return a->hypo_id_ < b->hypo_id_;
+}
+
+boxm2_volm_matcher_p1_cpu::boxm2_volm_matcher_p1_cpu(boxm2_volm_p1_query const& query,
+                                                     std::vector<unsigned> const& valid_cam_ids,
+                                                     float threshold, unsigned max_cam_per_loc,
+                                                     unsigned n_best, unsigned num_threads,
+                                                     unsigned batch_size)
+: q_(query), cam_ids_(valid_cam_ids), threshold_(threshold), max_cam_per_loc_(max_cam_per_loc),
+  n_best_(n_best), n_threads_(vpl_parallel_for_num_threads(num_threads)),
+  batch_size_(batch_size ? batch_size : 1), best_(n_threads_)
+{
+}
+
+void boxm2_volm_matcher_p1_cpu::score_location(unsigned char const* dst, unsigned char const* ori,
+                                               unsigned char const* lnd, float* scores,
+                                               std::vector<float>& mu,
+                                               std::vector<unsigned char>& gathered) const
+{
+  boxm2_volm_p1_query const& q = q_;
+  unsigned no = q.n_obj;
+  mu.resize(no);
+  for (unsigned c = 0; c < q.n_cam; ++c)
+  {
+    float score_sky = 0.0f;
+    if (q.has_sky()) {
+      unsigned start = q.sky_offset[c], end = q.sky_offset[c+1];
+      unsigned cnt = 0;
+      for (unsigned k = start; k < end; ++k)
+        cnt += dst[q.sky_id[k]] == 254;
+      score_sky = (end != start) ? (float)cnt/(end-start) : 0;
+      score_sky = score_sky * q.sky_weight;
+    }
+
+    float score_grd = 0.0f;
+    if (q.has_ground()) {
+      unsigned start = q.grd_offset[c], end = q.grd_offset[c+1];
+      unsigned dst_cnt = 0, ori_cnt = 0;
+      float lnd_sum = 0.0f;
+      for (unsigned k = start; k < end; ++k) {
+        unsigned id = q.grd_id[k];
+        dst_cnt += q.grd_dst_ok[256*q.grd_dist[k] + dst[id]];
+        ori_cnt += ori[id] == 1;
+        unsigned char l = lnd[id];
+        if (l != 0) {
+          unsigned char const* fl = &q.grd_land[k*q.fallback_size];
+          for (unsigned f = 0; f < q.fallback_size; ++f)
+            if (fl[f] == l) {
+              lnd_sum += q.grd_land_wgt[k*q.fallback_size+f];
+              break;
+            }
+        }
+      }
+      score_grd = q.grd_wgt_attri[0]*ori_cnt + q.grd_wgt_attri[1]*lnd_sum + q.grd_wgt_attri[2]*dst_cnt;
+      score_grd = (end != start) ? score_grd/(end-start) : 0;
+      score_grd = score_grd * q.grd_weight;
+    }
+
+    // gather the depth, orientation and land bytes of all objects seen by camera c,
+    // so that both passes below run over contiguous bytes
+    unsigned obj_start = q.obj_offset[no*c], obj_end = q.obj_offset[no*c+no];
+    unsigned nv = obj_end - obj_start;
+    if (gathered.size() < 3*nv)
+      gathered.resize(3*nv);
+    unsigned char* gd = nv ? &gathered[0] : VXL_NULLPTR;
+    unsigned char* go = gd + nv;
+    unsigned char* gl = go + nv;
+    for (unsigned i = 0; i < nv; ++i) {
+      unsigned id = q.obj_id[obj_start+i];
+      gd[i] = dst[id];
+      go[i] = ori[id];
+      gl[i] = lnd[id];
+    }
+
+    // mean depth of each object
+    for (unsigned k = 0; k < no; ++k) {
+      unsigned b = q.obj_offset[k+no*c] - obj_start, e = q.obj_offset[k+no*c+1] - obj_start;
+      float sum = 0;
+      unsigned cnt = 0;
+      for (unsigned i = b; i < e; ++i)
+        if (q.depth_valid[gd[i]]) {
+          sum += q.depth_value[gd[i]];
+          ++cnt;
+        }
+      mu[k] = (cnt > 0) ? sum/cnt : 0;
+    }
+
+    float score_obj = 0.0f;
+    for (unsigned k = 0; k < no; ++k)
+    {
+      // a voxel is in order when it is not nearer than any object before k
+      // and not farther than any object after k (objects with zero mean are ignored)
+      bool has_lo = false, has_hi = false;
+      float lo = 0.0f, hi = 0.0f;
+      for (unsigned j = 0; j < no; ++j) {
+        if (j == k || !(mu[j]*mu[j] > 1E-7))
+          continue;
+        if (j < k) {
+          lo = has_lo ? std::max(lo, mu[j]) : mu[j];
+          has_lo = true;
+        }
+        else {
+          hi = has_hi ? std::min(hi, mu[j]) : mu[j];
+          has_hi = true;
+        }
+      }
+      unsigned b = q.obj_offset[k+no*c] - obj_start, e = q.obj_offset[k+no*c+1] - obj_start;
+      unsigned char const* min_ok = &q.obj_min_ok[256*k];
+      unsigned char const* ori_ok = &q.obj_ori_ok[256*k];
+      float const* lnd_score = &q.obj_lnd_score[256*k];
+      unsigned n_ord = 0, n_min = 0, n_ori = 0;
+      float s_lnd = 0.0f;
+      for (unsigned i = b; i < e; ++i) {
+        unsigned char d = gd[i];
+        if (q.depth_valid[d]) {
+          float depth_d = q.depth_value[d];
+          n_ord += (!has_lo || depth_d - lo > -1E-5) && (!has_hi || depth_d - hi < 1E-5);
+        }
+        n_min += min_ok[d];
+        n_ori += ori_ok[go[i]];
+        s_lnd += lnd_score[gl[i]];
+      }
+      float const* w = &q.obj_wgt_attri[4*k];
+      float score_k = w[0]*(float)n_ori + w[1]*s_lnd + w[2]*(float)n_min + w[3]*(float)n_ord;
+      score_k = (e != b) ? score_k/(e-b) : 0;
+      score_k *= q.obj_weight[k];
+      score_obj += score_k;
+    }
+    scores[c] = score_sky + score_grd + score_obj;
+  }
+}
+
+volm_score_sptr boxm2_volm_matcher_p1_cpu::summarize(float const* scores, unsigned leaf_id, unsigned hypo_id) const
+{
+  // the same selection as boxm2_volm_matcher_p1
+  float max_score = 0.0f;
+  unsigned max_cam_id = 0;
+  float min_score_in_list = 0.0f;
+  std::vector<unsigned> cam_ids;
+  std::vector<float> cam_scores;
+  for (unsigned c = 0; c < q_.n_cam; ++c) {
+    float s = scores[c];
+    if (s > max_score) {
+      max_score = s;  max_cam_id = cam_ids_[c];
+    }
+    if (s > threshold_) {
+      if (cam_ids.size() < max_cam_per_loc_) {
+        cam_ids.push_back(cam_ids_[c]);
+        cam_scores.push_back(s);
+      }
+      else if (s > min_score_in_list) {
+        min_score_in_list = cam_scores[0];
+        unsigned min_score_id = 0;
+        for (unsigned jj = 0; jj < cam_ids.size(); ++jj)
+          if (min_score_in_list > cam_scores[jj]) {
+            min_score_in_list = cam_scores[jj];
+            min_score_id = jj;
+          }
+        cam_scores[min_score_id] = s;
+        cam_ids[min_score_id] = cam_ids_[c];
+      }
+    }
+  }
+  return new volm_score(leaf_id, hypo_id, max_score, max_cam_id, cam_ids);
+}
+
+//: Scores the locations of a batch, each thread with its own scratch and heap
+class boxm2_volm_p1_batch_body : public vpl_parallel_for_body
+{
+ public:
+  boxm2_volm_p1_batch_body(boxm2_volm_matcher_p1_cpu& m)
+  : m_(m), dst(VXL_NULLPTR), ori(VXL_NULLPTR), lnd(VXL_NULLPTR), leaf_id(0), first_hypo_id(0), out(VXL_NULLPTR),
+    scores_(m.n_threads_), mu_(m.n_threads_), gathered_(m.n_threads_)
+  {
+    for (unsigned t = 0; t < m.n_threads_; ++t)
+      scores_[t].resize(m.q_.n_cam > 0 ? m.q_.n_cam : 1);
+  }
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    unsigned ls = m_.q_.layer_size;
+    float* s = &scores_[thread_id][0];
+    std::vector<volm_score_sptr>& heap = m_.best_[thread_id];
+    for (unsigned i = begin; i < end; ++i) {
+      std::size_t off = std::size_t(i)*ls;
+      m_.score_location(dst+off, ori+off, lnd+off, s, mu_[thread_id], gathered_[thread_id]);
+      volm_score_sptr r = m_.summarize(s, leaf_id, first_hypo_id+i);
+      (*out)[i] = r;
+      if (m_.n_best_ == 0)
+        continue;
+      // keep the n_best best, the worst of them on top of the heap
+      if (heap.size() < m_.n_best_) {
+        heap.push_back(r);
+        std::push_heap(heap.begin(), heap.end(), boxm2_volm_p1_better);
+      }
+      else if (boxm2_volm_p1_better(r, heap.front())) {
+        std::pop_heap(heap.begin(), heap.end(), boxm2_volm_p1_better);
+        heap.back() = r;
+        std::push_heap(heap.begin(), heap.end(), boxm2_volm_p1_better);
+      }
+    }
+  }
+
+ private:
+  boxm2_volm_matcher_p1_cpu& m_;
+ public:
+  unsigned char const* dst;
+  unsigned char const* ori;
+  unsigned char const* lnd;
+  unsigned leaf_id;
+  unsigned first_hypo_id;
+  std::vector<volm_score_sptr>* out;
+ private:
+  std::vector<std::vector<float> > scores_;
+  std::vector<std::vector<float> > mu_;
+  std::vector<std::vector<unsigned char> > gathered_;
+};
+
+void boxm2_volm_matcher_p1_cpu::score(unsigned char const* dst, unsigned char const* ori, unsigned char const* lnd,
+                                      unsigned n, float* scores) const
+{
+  std::vector<float> mu;
+  std::vector<unsigned char> gathered;
+  for (unsigned i = 0; i < n; ++i) {
+    std::size_t off = std::size_t(i)*q_.layer_size;
+    this->score_location(dst+off, ori+off, lnd+off, scores + std::size_t(i)*q_.n_cam, mu, gathered);
+  }
+}
+
+//: Reads batches of the three index layers on a helper thread
+class boxm2_volm_p1_reader
+{
+ public:
+  boxm2_volm_p1_reader(volm_buffered_index& dst, volm_buffered_index& ori, volm_buffered_index& lnd, unsigned layer_size)
+  : n_(0), ls_(layer_size), running_(false), ok_(true)
+  {
+    ind_[0] = &dst;  ind_[1] = &ori;  ind_[2] = &lnd;
+#if VXL_HAS_PTHREAD_H
+    thread_ = new pthread_t;
+#endif
+  }
+  ~boxm2_volm_p1_reader()
+  {
+    wait();
+#if VXL_HAS_PTHREAD_H
+    delete thread_;
+#endif
+  }
+
+  //: start reading n locations into buf[0..2], each of n*layer_size bytes
+  void start(unsigned char* buf[3], unsigned n)
+  {
+    wait();
+    for (unsigned l = 0; l < 3; ++l)
+      buf_[l] = buf[l];
+    n_ = n;
+    running_ = true;
+#if VXL_HAS_PTHREAD_H
+    if (pthread_create(thread_, VXL_NULLPTR, &boxm2_volm_p1_reader::thread_main, this) == 0)
+      return;
+#endif
+    run();
+    running_ = false;
+  }
+
+  //: wait for the running read, returns false if an index ran out
+  bool wait()
+  {
+    if (running_) {
+#if VXL_HAS_PTHREAD_H
+      pthread_join(*thread_, VXL_NULLPTR);
+#endif
+      running_ = false;
+    }
+    bool ok = ok_;
+    ok_ = true;
+    return ok;
+  }
+
+ private:
+  volm_buffered_index* ind_[3];
+  unsigned char* buf_[3];
+  unsigned n_;
+  unsigned ls_;
+  bool running_;
+  bool ok_;
+#if VXL_HAS_PTHREAD_H
+  pthread_t* thread_;
+#endif
+
+  static void* thread_main(void* self)
+  {
+    static_cast<boxm2_volm_p1_reader*>(self)->run();
+    return VXL_NULLPTR;
+  }
+  void run()
+  {
+    for (unsigned i = 0; i < n_ && ok_; ++i)
+      for (unsigned l = 0; l < 3 && ok_; ++l)
+        ok_ = ind_[l]->get_next(buf_[l] + std::size_t(i)*ls_, ls_);
+  }
+};
+
+bool boxm2_volm_matcher_p1_cpu::match(volm_buffered_index& dst, volm_buffered_index& ori, volm_buffered_index& lnd,
+                                      unsigned n_ind, unsigned leaf_id, unsigned first_hypo_id,
+                                      std::vector<volm_score_sptr>& scores)
+{
+  unsigned ls = q_.layer_size;
+  if (dst.layer_size() != ls || ori.layer_size() != ls || lnd.layer_size() != ls) {
+    std::cerr << "\n ERROR: index layer size does not match the query size " << ls << '\n';
+    return false;
+  }
+  if (n_ind == 0)
+    return true;
+  // two sets of layer buffers: one is scored while the other is read
+  std::size_t bytes = std::size_t(batch_size_)*ls;
+  std::vector<unsigned char> mem(6*bytes);
+  unsigned char* buf[2][3];
+  for (unsigned b = 0; b < 2; ++b)
+    for (unsigned l = 0; l < 3; ++l)
+      buf[b][l] = &mem[0] + (3*b+l)*bytes;
+
+  boxm2_volm_p1_reader reader(dst, ori, lnd, ls);
+  boxm2_volm_p1_batch_body body(*this);
+  body.leaf_id = leaf_id;
+  std::vector<volm_score_sptr> batch_out;
+  unsigned cur = 0, done = 0;
+  unsigned n = std::min(batch_size_, n_ind);
+  reader.start(buf[cur], n);
+  while (n > 0)
+  {
+    if (!reader.wait())
+      return false;
+    unsigned next = std::min(batch_size_, n_ind - done - n);
+    if (next > 0)
+      reader.start(buf[1-cur], next);
+    body.dst = buf[cur][0];  body.ori = buf[cur][1];  body.lnd = buf[cur][2];
+    body.first_hypo_id = first_hypo_id + done;
+    batch_out.assign(n, volm_score_sptr());
+    body.out = &batch_out;
+    vpl_parallel_for(n, body, n_threads_);
+    scores.insert(scores.end(), batch_out.begin(), batch_out.end());
+    done += n;
+    n = next;
+    cur = 1-cur;
+  }
+  return true;
+}
+
+std::vector<volm_score_sptr> boxm2_volm_matcher_p1_cpu::best_locations() const
+{
+  std::vector<volm_score_sptr> all;
+  for (unsigned t = 0; t < best_.size(); ++t)
+    all.insert(all.end(), best_[t].begin(), best_[t].end());
+  std::sort(all.begin(), all.end(), boxm2_volm_p1_better);
+  if (all.size() > n_best_)
+    all.resize(n_best_);
+  return all;
+}
+
+void boxm2_volm_matcher_p1_cpu::clear_best()
+{
+  for (unsigned t = 0; t < best_.size(); ++t)
+    best_[t].clear();
+}
@@ -0,0 +1,149 @@
+// This is brl/bseg/boxm2/volm/boxm2_volm_matcher_p1_cpu.h
+#ifndef boxm2_volm_matcher_p1_cpu_h_
+#define boxm2_volm_matcher_p1_cpu_h_
+//:
+// \file
+// \brief Pass 1 matcher on the CPU, for machines without an OpenCL device
+//
+// boxm2_volm_p1_query holds the query in the flat layout that
+// boxm2_volm_matcher_p1 transfers to the device, together with lookup tables
+// over the byte values of the depth, orientation and land layers of an index.
+// The per voxel tests of the kernel (valid depth, minimum distance, ground
+// distance tolerance, orientation, land fallback weight) become single table
+// reads, and the order test compares a voxel depth against the largest mean
+// depth of the objects before it and the smallest of those after it.
+//
+// boxm2_volm_matcher_p1_cpu computes the scores of the kernel
+// generalized_volm_obj_based_matching_with_orient (and of its no ground / no
+// sky variants) for every location and camera.  The locations of a batch are
+// scored on several threads, while a helper thread reads the next batch from
+// the three volm_buffered_index files.  Each thread keeps the best locations
+// it has seen in its own heap; the heaps are merged on request, with ties
+// broken by leaf and hypothesis id so that the result does not depend on the
+// number of threads.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <volm/volm_io.h>
+#include <volm/volm_query_sptr.h>
+#include <volm/volm_buffered_index.h>
+#include <vcl_compiler.h>
+
+class boxm2_volm_p1_query
+{
+ public:
+  boxm2_volm_p1_query();
+
+  //: Flatten a volm_query, as boxm2_volm_matcher_p1 does for the device.
+  //  The weights are ordered as in the weight parameter file: sky, ground, then the objects.
+  //  Fails (with a message) if the query has no object region or the weights do not fit it.
+  bool set(volm_query_sptr const& query, std::vector<volm_weight> const& weights,
+           std::vector<float> const& depth_interval);
+
+  //: Compute the lookup tables from the arrays; set() calls it, call it after filling the arrays by hand
+  void build_tables();
+
+  bool has_ground() const { return !grd_offset.empty(); }
+  bool has_sky() const { return !sky_offset.empty(); }
+
+  unsigned n_cam;
+  unsigned n_obj;
+  //: number of voxels in an index
+  unsigned layer_size;
+  //: number of land categories in a fallback list
+  unsigned fallback_size;
+  std::vector<float> depth_interval;
+
+  //: ground voxels of camera c are grd_id[grd_offset[c]] .. grd_id[grd_offset[c+1]-1] (no ground: empty offsets)
+  std::vector<unsigned> grd_id, grd_offset;
+  std::vector<unsigned char> grd_dist;
+  //: fallback_size land categories and weights per ground voxel
+  std::vector<unsigned char> grd_land;
+  std::vector<float> grd_land_wgt;
+  float grd_weight;
+  //: ground weights for orientation, land and distance
+  float grd_wgt_attri[3];
+
+  //: sky voxels of camera c, as for the ground (no sky: empty offsets)
+  std::vector<unsigned> sky_id, sky_offset;
+  float sky_weight;
+
+  //: voxels of object k for camera c start at obj_id[obj_offset[k+n_obj*c]]
+  std::vector<unsigned> obj_id, obj_offset;
+  std::vector<unsigned char> obj_min_dist;
+  //: 1 horizontal, 2 vertical, 0 invalid
+  std::vector<unsigned char> obj_orient;
+  //: fallback_size land categories and weights per object
+  std::vector<unsigned char> obj_land;
+  std::vector<float> obj_land_wgt;
+  std::vector<float> obj_weight;
+  //: weights for orientation, land, minimum distance and order, 4 per object
+  std::vector<float> obj_wgt_attri;
+
+  //: tables over byte values, filled by build_tables()
+  float depth_value[256];
+  //: depth byte d is a valid object depth (d < 253 and inside the depth interval table)
+  unsigned char depth_valid[256];
+  //: grd_dst_ok[256*grd_d + d] - index depth d is within the ground distance tolerance of grd_d
+  std::vector<unsigned char> grd_dst_ok;
+  //: obj_min_ok[256*k + d], obj_ori_ok[256*k + orientation], obj_lnd_score[256*k + land]
+  std::vector<unsigned char> obj_min_ok, obj_ori_ok;
+  std::vector<float> obj_lnd_score;
+};
+
+class boxm2_volm_matcher_p1_cpu
+{
+ public:
+  //: Cameras above threshold are kept for each location, at most max_cam_per_loc of them.
+  //  valid_cam_ids maps query cameras to camera space ids.  n_best locations are kept
+  //  over all calls to match().  num_threads = 0 uses one thread per processor.
+  boxm2_volm_matcher_p1_cpu(boxm2_volm_p1_query const& query,
+                            std::vector<unsigned> const& valid_cam_ids,
+                            float threshold, unsigned max_cam_per_loc,
+                            unsigned n_best = 0, unsigned num_threads = 0,
+                            unsigned batch_size = 64);
+
+  //: Score n locations for every camera; the layers hold n*layer_size bytes.
+  //  scores receives n*n_cam values, camera c of location i at c + n_cam*i.
+  void score(unsigned char const* dst, unsigned char const* ori, unsigned char const* lnd,
+             unsigned n, float* scores) const;
+
+  //: Score the next n_ind locations of three index files opened for reading.
+  //  One volm_score per location is appended to scores, with the given leaf id and
+  //  hypothesis ids first_hypo_id, first_hypo_id+1, ...  Returns false if a file runs out.
+  bool match(volm_buffered_index& dst, volm_buffered_index& ori, volm_buffered_index& lnd,
+             unsigned n_ind, unsigned leaf_id, unsigned first_hypo_id,
+             std::vector<volm_score_sptr>& scores);
+
+  //: The n_best locations with the highest max score seen by match(), best first
+  std::vector<volm_score_sptr> best_locations() const;
+
+  //: Forget the best locations
+  void clear_best();
+
+  unsigned num_threads() const { return n_threads_; }
+
+ private:
+  boxm2_volm_p1_query const& q_;
+  std::vector<unsigned> cam_ids_;
+  float threshold_;
+  unsigned max_cam_per_loc_;
+  unsigned n_best_;
+  unsigned n_threads_;
+  unsigned batch_size_;
+  //: per thread heaps of the best locations, worst on top
+  std::vector<std::vector<volm_score_sptr> > best_;
+
+  friend class boxm2_volm_p1_batch_body;
+
+  //: score location at layers dst, ori, lnd for all cameras; mu and gathered are scratch
+  void score_location(unsigned char const* dst, unsigned char const* ori, unsigned char const* lnd,
+                      float* scores, std::vector<float>& mu, std::vector<unsigned char>& gathered) const;
+  //: max score and the cameras kept for one location
+  volm_score_sptr summarize(float const* scores, unsigned leaf_id, unsigned hypo_id) const;
+};
+
+#endif // boxm2_volm_matcher_p1_cpu_h_
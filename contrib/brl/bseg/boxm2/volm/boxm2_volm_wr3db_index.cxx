@@ -269,10 +269,10 @@ bool boxm2_volm_wr3db_index::inflate_index_vis_and_prob(std::vector<uchar>& valu
 
   unsigned int offset, end_offset; double depth;
   cont->first_res(cont->min_voxel_res()*2, offset, end_offset, depth);
+  const std::vector<unsigned int>& closest_ids = cont->closest_voxels(offset, end_offset);
 
   std::map<double, unsigned int>& depth_offset_map = cont->get_depth_offset_map();
   std::map<double, unsigned int>::iterator iter = depth_offset_map.begin();
-  vgl_point_3d<double> origin(0,0,0);
   unsigned char current_depth_interval = 0; // to count the depth intervals
 
   while (iter != depth_offset_map.end())
@@ -300,26 +300,8 @@ bool boxm2_volm_wr3db_index::inflate_index_vis_and_prob(std::vector<uchar>& valu
     else {
       for (unsigned ii = begin; ii < end; ii++)
       {
-        // first find the voxel at the indexed layer that is closest
-        unsigned int closest = 0;
-        double theta_closest = vnl_math::pi;
-        double dist_closest = 1000000.0;
-
-        vgl_vector_3d<double> dir2 = voxels[ii].center_-origin;
-        vgl_vector_3d<double> dir2n = dir2;
-        normalize(dir2n);
-        for (unsigned jj = offset; jj < end_offset; jj++) {
-          vgl_vector_3d<double> dir1 = voxels[jj].center_-origin;
-          vgl_vector_3d<double> dif = dir1-dir2;
-          double dist = dif.length();
-          normalize(dir1);
-          double theta = std::acos(dot_product(dir1, dir2n));
-          if (theta < theta_closest && dist < dist_closest) {
-            closest = jj;
-            theta_closest = theta;
-            dist_closest = dist;
-          }
-        }
+        // the voxel at the indexed layer in the closest direction
+        unsigned int closest = closest_ids[ii];
 
         unsigned char observed_depth_interval = values[closest-offset]; // depth of the voxel as observed at this voxel during indexing
         if (observed_depth_interval < current_depth_interval)
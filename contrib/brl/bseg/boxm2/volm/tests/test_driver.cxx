@@ -4,6 +4,7 @@ DECLARE( test_volm_wr3db_ind );
 DECLARE( test_volm_locations );
 DECLARE( test_volm_matcher_p1 );
 DECLARE( test_volm_matcher_p0 );
+DECLARE( test_volm_matcher_p1_cpu );
 
 void register_tests()
 {
@@ -11,6 +12,7 @@ void register_tests()
   REGISTER( test_volm_wr3db_ind );
   REGISTER( test_volm_matcher_p1 );
   REGISTER( test_volm_matcher_p0 );
+  REGISTER( test_volm_matcher_p1_cpu );
 }
 
 
@@ -4,6 +4,7 @@
 #include <boxm2/volm/boxm2_volm_io.h>
 #include <boxm2/volm/boxm2_volm_locations.h>
 #include <boxm2/volm/boxm2_volm_wr3db_index.h>
+#include <boxm2/volm/boxm2_volm_matcher_p1_cpu.h>
 #ifdef HAS_OPENCL
 #include <boxm2/volm/boxm2_volm_matcher_p0.h>
 #include <boxm2/volm/boxm2_volm_matcher_p1.h>
@@ -0,0 +1,289 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <boxm2/volm/boxm2_volm_matcher_p1_cpu.h>
+#include <volm/volm_buffered_index.h>
+#include <vnl/vnl_random.h>
+#include <vpl/vpl.h>
+#include <vcl_compiler.h>
+
+// a query with ground, sky and three objects over random voxels
+static void make_query(boxm2_volm_p1_query& q, vnl_random& rng)
+{
+  q.n_cam = 7;  q.n_obj = 3;  q.layer_size = 300;  q.fallback_size = 4;
+  for (unsigned d = 0; d < 40; ++d)
+    q.depth_interval.push_back(1.0f + 1.3f*d*d);
+  q.grd_weight = 0.3f;
+  q.grd_wgt_attri[0] = 0.2f;  q.grd_wgt_attri[1] = 0.3f;  q.grd_wgt_attri[2] = 0.5f;
+  q.sky_weight = 0.2f;
+  for (unsigned c = 0; c < q.n_cam; ++c) {
+    q.grd_offset.push_back((unsigned)q.grd_id.size());
+    unsigned ng = rng.lrand32(5, 30);
+    for (unsigned v = 0; v < ng; ++v) {
+      q.grd_id.push_back(rng.lrand32(0, q.layer_size-1));
+      q.grd_dist.push_back((unsigned char)rng.lrand32(0, 45));
+      for (unsigned f = 0; f < q.fallback_size; ++f) {
+        q.grd_land.push_back((unsigned char)rng.lrand32(0, 8));
+        q.grd_land_wgt.push_back(float(rng.drand32()));
+      }
+    }
+    q.sky_offset.push_back((unsigned)q.sky_id.size());
+    unsigned ns = rng.lrand32(0, 20);
+    for (unsigned v = 0; v < ns; ++v)
+      q.sky_id.push_back(rng.lrand32(0, q.layer_size-1));
+    for (unsigned k = 0; k < q.n_obj; ++k) {
+      q.obj_offset.push_back((unsigned)q.obj_id.size());
+      unsigned no = (c == 2 && k == 1) ? 0 : rng.lrand32(3, 25);
+      for (unsigned v = 0; v < no; ++v)
+        q.obj_id.push_back(rng.lrand32(0, q.layer_size-1));
+    }
+  }
+  q.grd_offset.push_back((unsigned)q.grd_id.size());
+  q.sky_offset.push_back((unsigned)q.sky_id.size());
+  q.obj_offset.push_back((unsigned)q.obj_id.size());
+  for (unsigned k = 0; k < q.n_obj; ++k) {
+    q.obj_min_dist.push_back((unsigned char)(5*k));
+    q.obj_orient.push_back((unsigned char)k);
+    q.obj_weight.push_back(0.5f/q.n_obj);
+    for (unsigned a = 0; a < 4; ++a)
+      q.obj_wgt_attri.push_back(0.25f);
+    for (unsigned f = 0; f < q.fallback_size; ++f) {
+      q.obj_land.push_back((unsigned char)rng.lrand32(0, 8));
+      q.obj_land_wgt.push_back(float(rng.drand32()));
+    }
+  }
+  q.build_tables();
+}
+
+// the kernel generalized_volm_obj_based_matching_with_orient, written out for one location
+static void reference_scores(boxm2_volm_p1_query const& q, unsigned char const* index,
+                             unsigned char const* index_orient, unsigned char const* index_land,
+                             std::vector<float>& score)
+{
+  unsigned ln_depth_size = (unsigned)q.depth_interval.size();
+  unsigned ln_obj = q.n_obj;
+  score.assign(q.n_cam, 0.0f);
+  for (unsigned cam_id = 0; cam_id < q.n_cam; ++cam_id)
+  {
+    unsigned start_sky = q.sky_offset[cam_id], end_sky = q.sky_offset[cam_id+1];
+    unsigned sky_count = 0;
+    for (unsigned k = start_sky; k < end_sky; ++k)
+      if (index[q.sky_id[k]] == 254)
+        sky_count += 1;
+    float score_sky = (end_sky != start_sky) ? (float)sky_count/(end_sky-start_sky) : 0;
+    score_sky = score_sky * q.sky_weight;
+
+    unsigned char alt_ratio = 2;
+    unsigned start_grd = q.grd_offset[cam_id], end_grd = q.grd_offset[cam_id+1];
+    unsigned score_grd_dst = 0, score_grd_ori = 0;
+    float score_grd_lnd = 0.0;
+    for (unsigned k = start_grd; k < end_grd; ++k) {
+      unsigned id = q.grd_id[k];
+      if (index[id] < ln_depth_size && q.grd_dist[k] < ln_depth_size) {
+        float ind_d = q.depth_interval[index[id]];
+        float grd_d = q.depth_interval[q.grd_dist[k]];
+        float delta_d = alt_ratio * grd_d;
+        if (ind_d >= (grd_d - delta_d) && ind_d <= (grd_d+delta_d))
+          score_grd_dst += 1;
+      }
+      unsigned ind_ori = index_orient[id];
+      unsigned ind_lnd = index_land[id];
+      if (ind_ori == 1)
+        score_grd_ori += 1;
+      if (ind_lnd != 0)
+        for (unsigned ii = 0; ii < q.fallback_size; ii++)
+          if (ind_lnd == q.grd_land[k*q.fallback_size+ii]) {
+            score_grd_lnd += q.grd_land_wgt[k*q.fallback_size+ii];
+            break;
+          }
+    }
+    float score_grd = q.grd_wgt_attri[0]*score_grd_ori + q.grd_wgt_attri[1]*score_grd_lnd + q.grd_wgt_attri[2]*score_grd_dst;
+    score_grd = (end_grd != start_grd) ? score_grd / (end_grd-start_grd) : 0;
+    score_grd = score_grd * q.grd_weight;
+
+    std::vector<float> mu(ln_obj);
+    for (unsigned k = 0; k < ln_obj; ++k) {
+      unsigned offset_id = k + ln_obj * cam_id;
+      float mu_obj = 0;
+      unsigned count = 0;
+      for (unsigned i = q.obj_offset[offset_id]; i < q.obj_offset[offset_id+1]; ++i) {
+        unsigned d = index[q.obj_id[i]];
+        if (d < 253 && d < ln_depth_size) {
+          mu_obj += q.depth_interval[d];
+          count += 1;
+        }
+      }
+      mu[k] = (count > 0) ? mu_obj/count : 0;
+    }
+    float score_obj = 0.0f;
+    for (unsigned k = 0; k < ln_obj; ++k)
+    {
+      unsigned offset_id = k + ln_obj * cam_id;
+      unsigned start_obj = q.obj_offset[offset_id], end_obj = q.obj_offset[offset_id+1];
+      float score_k_ord = 0.0f, score_k_min = 0.0f, score_k_ori = 0.0f, score_k_lnd = 0.0f;
+      for (unsigned i = start_obj; i < end_obj; ++i) {
+        unsigned id = q.obj_id[i];
+        unsigned d = index[id];
+        unsigned s_vox_ord = 0, s_vox_min = 0, s_vox_ori = 0;
+        if (d < 253 && d < ln_depth_size) {
+          s_vox_ord = 1;
+          for (unsigned mu_id = 0; (s_vox_ord && mu_id < k); ++mu_id)
+            if (mu[mu_id]*mu[mu_id] > 1E-7)
+              s_vox_ord = s_vox_ord * (q.depth_interval[d] - mu[mu_id] > -1E-5);
+          for (unsigned mu_id = k+1; (s_vox_ord && mu_id < ln_obj); ++mu_id)
+            if (mu[mu_id]*mu[mu_id] > 1E-7)
+              s_vox_ord = s_vox_ord * (q.depth_interval[d] - mu[mu_id] < 1E-5);
+          s_vox_min = (d > q.obj_min_dist[k]) ? 1 : 0;
+        }
+        unsigned char ind_ori = index_orient[id];
+        unsigned char ind_lnd = index_land[id];
+        if (q.obj_orient[k] == 1)
+          s_vox_ori = (ind_ori == 1) ? 1 : 0;
+        else
+          s_vox_ori = (ind_ori > 1 && ind_ori < 10 && q.obj_orient[k] != 0) ? 1: 0;
+        if (ind_lnd != 0)
+          for (unsigned ii = k*q.fallback_size; ii < (k+1)*q.fallback_size; ii++)
+            if (ind_lnd == q.obj_land[ii]) {
+              score_k_lnd += q.obj_land_wgt[ii];
+              break;
+            }
+        score_k_ord += (float)s_vox_ord;
+        score_k_min += (float)s_vox_min;
+        score_k_ori += (float)s_vox_ori;
+      }
+      float score_k = q.obj_wgt_attri[4*k] * score_k_ori + q.obj_wgt_attri[4*k+1] * score_k_lnd +
+                      q.obj_wgt_attri[4*k+2] * score_k_min + q.obj_wgt_attri[4*k+3] * score_k_ord;
+      score_k = (end_obj != start_obj) ? score_k/(end_obj-start_obj) : 0;
+      score_k *= q.obj_weight[k];
+      score_obj += score_k;
+    }
+    score[cam_id] = score_sky + score_grd + score_obj;
+  }
+}
+
+static void random_layers(vnl_random& rng, unsigned n, std::vector<unsigned char>& dst,
+                          std::vector<unsigned char>& ori, std::vector<unsigned char>& lnd)
+{
+  for (unsigned i = 0; i < n; ++i) {
+    // depths are mostly valid, with some sky (254) and invalid (253, 255) values
+    unsigned r = rng.lrand32(0, 99);
+    dst.push_back((unsigned char)(r < 10 ? 254 : r < 14 ? 253 : r < 16 ? 255 : rng.lrand32(0, 39)));
+    ori.push_back((unsigned char)rng.lrand32(0, 11));
+    lnd.push_back((unsigned char)rng.lrand32(0, 9));
+  }
+}
+
+static bool write_index(std::string const& file, std::vector<unsigned char>& values, unsigned layer_size)
+{
+  volm_buffered_index ind(layer_size, 0.0001f);
+  if (!ind.initialize_write(file))
+    return false;
+  for (unsigned i = 0; i*layer_size < values.size(); ++i)
+    ind.add_to_index(&values[i*layer_size]);
+  ind.finalize();
+  return true;
+}
+
+static void test_volm_matcher_p1_cpu()
+{
+  vnl_random rng(9876);
+  boxm2_volm_p1_query q;
+  make_query(q, rng);
+  std::vector<unsigned> cam_ids;
+  for (unsigned c = 0; c < q.n_cam; ++c)
+    cam_ids.push_back(100 + 3*c);
+
+  const unsigned n_loc = 150;
+  std::vector<unsigned char> dst, ori, lnd;
+  random_layers(rng, n_loc*q.layer_size, dst, ori, lnd);
+
+  // the scores of every location and camera against the kernel
+  boxm2_volm_matcher_p1_cpu matcher(q, cam_ids, 0.3f, 3, 10, 1);
+  std::vector<float> scores(n_loc*q.n_cam), ref;
+  matcher.score(&dst[0], &ori[0], &lnd[0], n_loc, &scores[0]);
+  double max_err = 0.0;
+  for (unsigned i = 0; i < n_loc; ++i) {
+    std::size_t off = std::size_t(i)*q.layer_size;
+    reference_scores(q, &dst[off], &ori[off], &lnd[off], ref);
+    for (unsigned c = 0; c < q.n_cam; ++c)
+      max_err = std::max(max_err, (double)std::fabs(ref[c] - scores[c + q.n_cam*i]));
+  }
+  TEST_NEAR("scores equal the kernel's", max_err, 0.0, 1e-6);
+
+  // match through index files, with different threads and batch sizes
+  std::string fd = "test_p1_cpu_dst.bin", fo = "test_p1_cpu_ori.bin", fl = "test_p1_cpu_lnd.bin";
+  bool written = write_index(fd, dst, q.layer_size) && write_index(fo, ori, q.layer_size) &&
+                 write_index(fl, lnd, q.layer_size);
+  TEST("write index files", written, true);
+
+  const unsigned threads[3] = { 1, 3, 0 }, batches[3] = { 1, 16, 64 };
+  std::vector<volm_score_sptr> first, first_best;
+  bool same = true, ok = true;
+  for (unsigned t = 0; t < 3; ++t)
+    for (unsigned b = 0; b < 3; ++b) {
+      volm_buffered_index id(q.layer_size, 0.001f), io(q.layer_size, 0.001f), il(q.layer_size, 0.001f);
+      ok = ok && id.initialize_read(fd) && io.initialize_read(fo) && il.initialize_read(fl);
+      boxm2_volm_matcher_p1_cpu m(q, cam_ids, 0.3f, 3, 10, threads[t], batches[b]);
+      std::vector<volm_score_sptr> out;
+      // two calls, as for two leaves
+      ok = ok && m.match(id, io, il, 100, 4, 0, out) && m.match(id, io, il, n_loc-100, 5, 0, out);
+      std::vector<volm_score_sptr> best = m.best_locations();
+      id.finalize();  io.finalize();  il.finalize();
+      if (first.empty()) {
+        first = out;
+        first_best = best;
+        continue;
+      }
+      same = same && out.size() == first.size() && best.size() == first_best.size();
+      for (unsigned i = 0; same && i < out.size(); ++i)
+        same = out[i]->max_score_ == first[i]->max_score_ && out[i]->max_cam_id_ == first[i]->max_cam_id_ &&
+               out[i]->cam_id_ == first[i]->cam_id_ && out[i]->hypo_id_ == first[i]->hypo_id_;
+      for (unsigned i = 0; same && i < best.size(); ++i)
+        same = best[i]->leaf_id_ == first_best[i]->leaf_id_ && best[i]->hypo_id_ == first_best[i]->hypo_id_;
+    }
+  TEST("match index files", ok && first.size() == n_loc, true);
+  TEST("independent of threads and batch size", same, true);
+
+  // the summary of each location, as boxm2_volm_matcher_p1 computes it
+  bool summary = true;
+  std::vector<std::pair<float, unsigned> > ranked;
+  for (unsigned i = 0; i < n_loc && i < first.size(); ++i) {
+    float const* s = &scores[q.n_cam*i];
+    float mx = 0.0f;
+    unsigned mc = 0, n_above = 0;
+    for (unsigned c = 0; c < q.n_cam; ++c) {
+      if (s[c] > mx) { mx = s[c]; mc = cam_ids[c]; }
+      n_above += s[c] > 0.3f;
+    }
+    summary = summary && first[i]->max_score_ == mx && first[i]->max_cam_id_ == mc &&
+              first[i]->cam_id_.size() == std::min(n_above, 3u) &&
+              first[i]->leaf_id_ == (i < 100 ? 4u : 5u) && first[i]->hypo_id_ == (i < 100 ? i : i-100);
+    ranked.push_back(std::make_pair(-mx, i));
+  }
+  TEST("location summaries", summary, true);
+
+  std::sort(ranked.begin(), ranked.end());
+  bool best_ok = first_best.size() == 10;
+  for (unsigned i = 0; best_ok && i < first_best.size(); ++i) {
+    unsigned loc = ranked[i].second;
+    best_ok = first_best[i]->max_score_ == -ranked[i].first &&
+              first_best[i]->leaf_id_ == (loc < 100 ? 4u : 5u) &&
+              first_best[i]->hypo_id_ == (loc < 100 ? loc : loc-100);
+  }
+  TEST("best locations", best_ok, true);
+
+  // more locations than the files hold
+  volm_buffered_index id(q.layer_size, 0.001f), io(q.layer_size, 0.001f), il(q.layer_size, 0.001f);
+  id.initialize_read(fd);  io.initialize_read(fo);  il.initialize_read(fl);
+  std::vector<volm_score_sptr> out;
+  TEST("index runs out", matcher.match(id, io, il, n_loc+1, 0, 0, out), false);
+  id.finalize();  io.finalize();  il.finalize();
+
+  vpl_unlink(fd.c_str());
+  vpl_unlink(fo.c_str());
+  vpl_unlink(fl.c_str());
+}
+
+TESTMAIN(test_volm_matcher_p1_cpu);
@@ -0,0 +1,341 @@
+// This is brl/bseg/brip/brip_batch_match.cxx
+#include <cmath>
+#include <complex>
+#include <algorithm>
+#include "brip_batch_match.h"
+//:
+// \file
+#include "brip_mutual_info.h"
+#include "brip_vil_float_ops.h"
+#include <vcl_cassert.h>
+#include <vnl/vnl_matrix.h>
+#include <vnl/vnl_matrix_fixed.h>
+#include <vnl/algo/vnl_fft_2d.h>
+#include <vpl/vpl_parallel_for.h>
+
+//: the columns [lo, hi) of an image of size n0 that overlap an image of size n1 shifted by d
+static bool brip_overlap(int n0, int n1, int d, int& lo, int& hi)
+{
+  lo = std::max(0, -d);
+  hi = std::min(n0, n1-d);
+  return lo < hi;
+}
+
+//: normalized cross correlation from the moment sums of n pixels
+static double brip_ncc_from_sums(double n, double s0, double s1,
+                                 double s00, double s11, double s01)
+{
+  if (n <= 0.0)
+    return 0.0;
+  double v0 = s00 - s0*s0/n, v1 = s11 - s1*s1/n;
+  // the summed area tables leave rounding noise on constant regions
+  if (v0 <= 1e-12*s00 || v1 <= 1e-12*s11)
+    return 0.0;
+  return (s01 - s0*s1/n)/std::sqrt(v0*v1);
+}
+
+//: smallest size >= n with no prime factors other than 2, 3 and 5
+static int brip_fft_size(int n)
+{
+  for (int m = std::max(n, 1); ; ++m)
+  {
+    int r = m;
+    while (r%2 == 0) r /= 2;
+    while (r%3 == 0) r /= 3;
+    while (r%5 == 0) r /= 5;
+    if (r == 1)
+      return m;
+  }
+}
+
+//: the histogram bin of brip_histogram, -1 outside [min, max]
+static inline int brip_bin(double v, double min, double scale, int n_bins)
+{
+  int index = int(0.5 + scale*(v - min));
+  return (index >= 0 && index < n_bins) ? index : -1;
+}
+
+//: mutual information from the marginal and joint histograms, as brip_mutual_info
+static double brip_mi_from_hists(std::vector<double> const& h0,
+                                 std::vector<double> const& h1,
+                                 std::vector<double> const& hj)
+{
+  double m0 = 0.0, m1 = 0.0, mj = 0.0;
+  for (unsigned b = 0; b<h0.size(); ++b) {
+    m0 += h0[b];
+    m1 += h1[b];
+  }
+  for (unsigned b = 0; b<hj.size(); ++b)
+    mj += hj[b];
+  if (m0 == 0.0 || m1 == 0.0 || mj == 0.0)
+    return 0.0;
+  return brip_hist_entropy(h0, m0) + brip_hist_entropy(h1, m1) - brip_hist_entropy(hj, mj);
+}
+
+//: NCC of a range of shifts
+struct brip_ncc_shift_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const* image0;
+  vil_image_view<float> const* image1;
+  brip_integral_image const *sum0, *sum00, *sum1, *sum11;
+  //: correlation surface, or empty to sum the cross term directly
+  vil_image_view<double> const* surface;
+  std::vector<vgl_vector_2d<int> > const* shifts;
+  std::vector<double>* scores;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    int ni0 = image0->ni(), nj0 = image0->nj(), ni1 = image1->ni(), nj1 = image1->nj();
+    for (unsigned k = begin; k<end; ++k)
+    {
+      int du = (*shifts)[k].x(), dv = (*shifts)[k].y();
+      int i0, i1, j0, j1;
+      if (!brip_overlap(ni0, ni1, du, i0, i1) || !brip_overlap(nj0, nj1, dv, j0, j1)) {
+        (*scores)[k] = 0.0;
+        continue;
+      }
+      double n = double(i1-i0)*double(j1-j0);
+      double s0 = sum0->sum(i0, j0, i1-1, j1-1);
+      double s00 = sum00->sum(i0, j0, i1-1, j1-1);
+      double s1 = sum1->sum(i0+du, j0+dv, i1-1+du, j1-1+dv);
+      double s11 = sum11->sum(i0+du, j0+dv, i1-1+du, j1-1+dv);
+      double s01 = 0.0;
+      if (*surface) {
+        int P = surface->ni(), Q = surface->nj();
+        s01 = (*surface)((du+P)%P, (dv+Q)%Q);
+      }
+      else {
+        for (int j = j0; j<j1; ++j) {
+          float const* r0 = &(*image0)(0, j);
+          float const* r1 = &(*image1)(0, j+dv);
+          std::ptrdiff_t is0 = image0->istep(), is1 = image1->istep();
+          double row = 0.0;
+          for (int i = i0; i<i1; ++i)
+            row += double(r0[i*is0])*r1[(i+du)*is1];
+          s01 += row;
+        }
+      }
+      (*scores)[k] = brip_ncc_from_sums(n, s0, s1, s00, s11, s01);
+    }
+  }
+};
+
+//: MI of a range of shifts
+struct brip_mi_shift_body : public vpl_parallel_for_body
+{
+  vil_image_view<int> bins0, bins1;
+  unsigned n_bins;
+  std::vector<vgl_vector_2d<int> > const* shifts;
+  std::vector<double>* scores;
+  //: per thread histograms
+  std::vector<std::vector<double> > h0, h1, hj;
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    int ni0 = bins0.ni(), nj0 = bins0.nj(), ni1 = bins1.ni(), nj1 = bins1.nj();
+    std::vector<double>& g0 = h0[thread_id];
+    std::vector<double>& g1 = h1[thread_id];
+    std::vector<double>& gj = hj[thread_id];
+    for (unsigned k = begin; k<end; ++k)
+    {
+      int du = (*shifts)[k].x(), dv = (*shifts)[k].y();
+      int i0, i1, j0, j1;
+      if (!brip_overlap(ni0, ni1, du, i0, i1) || !brip_overlap(nj0, nj1, dv, j0, j1)) {
+        (*scores)[k] = 0.0;
+        continue;
+      }
+      std::fill(g0.begin(), g0.end(), 0.0);
+      std::fill(g1.begin(), g1.end(), 0.0);
+      std::fill(gj.begin(), gj.end(), 0.0);
+      for (int j = j0; j<j1; ++j)
+        for (int i = i0; i<i1; ++i)
+        {
+          int b0 = bins0(i, j), b1 = bins1(i+du, j+dv);
+          if (b0 >= 0) g0[b0] += 1.0;
+          if (b1 >= 0) g1[b1] += 1.0;
+          if (b0 >= 0 && b1 >= 0) gj[b0*n_bins + b1] += 1.0;
+        }
+      (*scores)[k] = brip_mi_from_hists(g0, g1, gj);
+    }
+  }
+};
+
+//: NCC or MI of a range of homographies
+struct brip_homography_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const* image0;
+  vil_image_view<float> const* image1;
+  std::vector<vgl_h_matrix_2d<double> > const* homographies;
+  std::vector<double>* scores;
+  //: MI if n_bins > 0, NCC otherwise
+  unsigned n_bins;
+  double min, scale;
+  std::vector<std::vector<double> > h0, h1, hj;
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    int ni0 = image0->ni(), nj0 = image0->nj();
+    double xmax = double(image1->ni())-1.0, ymax = double(image1->nj())-1.0;
+    for (unsigned k = begin; k<end; ++k)
+    {
+      vnl_matrix_fixed<double, 3, 3> const& M = (*homographies)[k].get_matrix();
+      double n = 0.0, s0 = 0.0, s1 = 0.0, s00 = 0.0, s11 = 0.0, s01 = 0.0;
+      if (n_bins) {
+        std::fill(h0[thread_id].begin(), h0[thread_id].end(), 0.0);
+        std::fill(h1[thread_id].begin(), h1[thread_id].end(), 0.0);
+        std::fill(hj[thread_id].begin(), hj[thread_id].end(), 0.0);
+      }
+      for (int j = 0; j<nj0; ++j)
+        for (int i = 0; i<ni0; ++i)
+        {
+          double w = M[2][0]*i + M[2][1]*j + M[2][2];
+          if (w == 0.0)
+            continue;
+          double x = (M[0][0]*i + M[0][1]*j + M[0][2])/w;
+          double y = (M[1][0]*i + M[1][1]*j + M[1][2])/w;
+          // the domain where bilinear interpolation is defined
+          if (!(x >= 0.0 && y >= 0.0 && x < xmax && y < ymax))
+            continue;
+          double v0 = (*image0)(i, j);
+          double v1 = brip_vil_float_ops::bilinear_interpolation(*image1, x, y);
+          if (n_bins) {
+            int b0 = brip_bin(v0, min, scale, n_bins), b1 = brip_bin(v1, min, scale, n_bins);
+            if (b0 >= 0) h0[thread_id][b0] += 1.0;
+            if (b1 >= 0) h1[thread_id][b1] += 1.0;
+            if (b0 >= 0 && b1 >= 0) hj[thread_id][b0*n_bins + b1] += 1.0;
+          }
+          else {
+            n += 1.0; s0 += v0; s1 += v1;
+            s00 += v0*v0; s11 += v1*v1; s01 += v0*v1;
+          }
+        }
+      (*scores)[k] = n_bins ? brip_mi_from_hists(h0[thread_id], h1[thread_id], hj[thread_id])
+                            : brip_ncc_from_sums(n, s0, s1, s00, s11, s01);
+    }
+  }
+};
+
+brip_batch_match::brip_batch_match(vil_image_view<float> const& image0,
+                                   vil_image_view<float> const& image1,
+                                   unsigned num_threads)
+  : image0_(image0), image1_(image1), num_threads_(num_threads), ncc_method_(AUTO),
+    sum0_(image0), sum00_(image0, image0), sum1_(image1), sum11_(image1, image1)
+{
+}
+
+void brip_batch_match::correlation_surface(vil_image_view<double>& surface) const
+{
+  int ni0 = image0_.ni(), nj0 = image0_.nj(), ni1 = image1_.ni(), nj1 = image1_.nj();
+  // zero padding to the full range of shifts avoids wrap around
+  int P = brip_fft_size(ni0+ni1-1), Q = brip_fft_size(nj0+nj1-1);
+  vnl_matrix<std::complex<double> > A(Q, P, std::complex<double>(0.0)), B(Q, P, std::complex<double>(0.0));
+  for (int j = 0; j<nj0; ++j)
+    for (int i = 0; i<ni0; ++i)
+      A(j, i) = image0_(i, j);
+  for (int j = 0; j<nj1; ++j)
+    for (int i = 0; i<ni1; ++i)
+      B(j, i) = image1_(i, j);
+  vnl_fft_2d<double> fft(Q, P);
+  fft.fwd_transform(A);
+  fft.fwd_transform(B);
+  for (int j = 0; j<Q; ++j)
+    for (int i = 0; i<P; ++i)
+      A(j, i) = std::conj(A(j, i))*B(j, i);
+  fft.bwd_transform(A);
+  double norm = double(P)*double(Q);
+  surface.set_size(P, Q);
+  for (int j = 0; j<Q; ++j)
+    for (int i = 0; i<P; ++i)
+      surface(i, j) = A(j, i).real()/norm;
+}
+
+void brip_batch_match::ncc(std::vector<vgl_vector_2d<int> > const& shifts,
+                           std::vector<double>& scores) const
+{
+  scores.assign(shifts.size(), 0.0);
+  if (shifts.empty())
+    return;
+  int ni0 = image0_.ni(), nj0 = image0_.nj(), ni1 = image1_.ni(), nj1 = image1_.nj();
+  bool use_fft = ncc_method_ == FFT;
+  if (ncc_method_ == AUTO)
+  {
+    // pixel products summed directly, against three transforms of the padded size
+    double direct = 0.0;
+    for (unsigned k = 0; k<shifts.size(); ++k) {
+      int i0, i1, j0, j1;
+      if (brip_overlap(ni0, ni1, shifts[k].x(), i0, i1) && brip_overlap(nj0, nj1, shifts[k].y(), j0, j1))
+        direct += double(i1-i0)*double(j1-j0);
+    }
+    double size = double(brip_fft_size(ni0+ni1-1))*double(brip_fft_size(nj0+nj1-1));
+    use_fft = direct > 3.0*size*std::log(size)/std::log(2.0)*4.0;
+  }
+  vil_image_view<double> surface;
+  if (use_fft)
+    this->correlation_surface(surface);
+
+  brip_ncc_shift_body body;
+  body.image0 = &image0_; body.image1 = &image1_;
+  body.sum0 = &sum0_; body.sum00 = &sum00_; body.sum1 = &sum1_; body.sum11 = &sum11_;
+  body.surface = &surface;
+  body.shifts = &shifts;
+  body.scores = &scores;
+  vpl_parallel_for(shifts.size(), body, num_threads_);
+}
+
+void brip_batch_match::ncc(std::vector<vgl_h_matrix_2d<double> > const& homographies,
+                           std::vector<double>& scores) const
+{
+  scores.assign(homographies.size(), 0.0);
+  brip_homography_body body;
+  body.image0 = &image0_; body.image1 = &image1_;
+  body.homographies = &homographies;
+  body.scores = &scores;
+  body.n_bins = 0; body.min = 0.0; body.scale = 0.0;
+  vpl_parallel_for(homographies.size(), body, num_threads_);
+}
+
+void brip_batch_match::mutual_info(std::vector<vgl_vector_2d<int> > const& shifts,
+                                   std::vector<double>& scores,
+                                   double min, double max, unsigned n_bins) const
+{
+  assert(n_bins > 0 && max > min);
+  scores.assign(shifts.size(), 0.0);
+  if (shifts.empty())
+    return;
+  double scale = double(n_bins-1)/(max-min);
+  brip_mi_shift_body body;
+  body.bins0.set_size(image0_.ni(), image0_.nj());
+  body.bins1.set_size(image1_.ni(), image1_.nj());
+  for (unsigned j = 0; j<image0_.nj(); ++j)
+    for (unsigned i = 0; i<image0_.ni(); ++i)
+      body.bins0(i, j) = brip_bin(image0_(i, j), min, scale, n_bins);
+  for (unsigned j = 0; j<image1_.nj(); ++j)
+    for (unsigned i = 0; i<image1_.ni(); ++i)
+      body.bins1(i, j) = brip_bin(image1_(i, j), min, scale, n_bins);
+  unsigned nt = vpl_parallel_for_num_threads(num_threads_);
+  body.h0.assign(nt, std::vector<double>(n_bins));
+  body.h1.assign(nt, std::vector<double>(n_bins));
+  body.hj.assign(nt, std::vector<double>(n_bins*n_bins));
+  body.n_bins = n_bins;
+  body.shifts = &shifts;
+  body.scores = &scores;
+  vpl_parallel_for(shifts.size(), body, num_threads_);
+}
+
+void brip_batch_match::mutual_info(std::vector<vgl_h_matrix_2d<double> > const& homographies,
+                                   std::vector<double>& scores,
+                                   double min, double max, unsigned n_bins) const
+{
+  assert(n_bins > 0 && max > min);
+  scores.assign(homographies.size(), 0.0);
+  brip_homography_body body;
+  body.image0 = &image0_; body.image1 = &image1_;
+  body.homographies = &homographies;
+  body.scores = &scores;
+  body.n_bins = n_bins; body.min = min; body.scale = double(n_bins-1)/(max-min);
+  unsigned nt = vpl_parallel_for_num_threads(num_threads_);
+  body.h0.assign(nt, std::vector<double>(n_bins));
+  body.h1.assign(nt, std::vector<double>(n_bins));
+  body.hj.assign(nt, std::vector<double>(n_bins*n_bins));
+  vpl_parallel_for(homographies.size(), body, num_threads_);
+}
@@ -0,0 +1,85 @@
+// This is brl/bseg/brip/brip_batch_match.h
+#ifndef brip_batch_match_h_
+#define brip_batch_match_h_
+//:
+// \file
+// \brief Normalized cross correlation and mutual information for a batch of candidate registrations
+//
+// Registration searches evaluate a match score for thousands of candidate
+// shifts (or homographies) between the same pair of images.  Calling
+// brip_vil_float_ops::cross_correlate or brip_mutual_info once per
+// candidate repeats the work that does not depend on the candidate.
+// brip_batch_match does that work once and then scores all the candidates,
+// spreading them over threads:
+//
+// - NCC of a shift: the sums and sums of squares of both images over the
+//   overlap come from summed area tables (brip_integral_image).  The cross
+//   term is either summed directly for each shift or, for large batches,
+//   read from the full correlation surface computed with one FFT.
+// - NCC of a homography: image1 is sampled with bilinear interpolation at
+//   the mapped image0 pixels.
+// - MI: the bin of every pixel is computed once; each candidate only
+//   accumulates its joint histogram, in a buffer reused by each thread.
+//   The bins and entropies are those of brip_mutual_info, so for a shift
+//   the score equals brip_mutual_info of the two overlapping views.
+//
+// A shift (du,dv) compares image0(i,j) with image1(i+du, j+dv); a
+// homography H compares image0(i,j) with image1 at H(i,j).  Only pixels
+// where both images are defined take part.  A candidate with no overlap
+// (or with a constant image over the overlap, for NCC) scores 0.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <vil/vil_image_view.h>
+#include <vgl/vgl_vector_2d.h>
+#include <vgl/algo/vgl_h_matrix_2d.h>
+#include <brip/brip_integral_image.h>
+#include <vcl_compiler.h>
+
+class brip_batch_match
+{
+ public:
+  //: How the NCC cross term of shifts is computed
+  enum ncc_method { AUTO, DIRECT, FFT };
+
+  //: Score candidate registrations of image1 to image0, on num_threads threads (0 = one per processor)
+  brip_batch_match(vil_image_view<float> const& image0,
+                   vil_image_view<float> const& image1,
+                   unsigned num_threads = 0);
+
+  //: The NCC cross term method for shifts; AUTO picks the cheaper one for each batch
+  void set_ncc_method(ncc_method m) { ncc_method_ = m; }
+
+  //: Normalized cross correlation for each shift
+  void ncc(std::vector<vgl_vector_2d<int> > const& shifts,
+           std::vector<double>& scores) const;
+
+  //: Normalized cross correlation for each homography
+  void ncc(std::vector<vgl_h_matrix_2d<double> > const& homographies,
+           std::vector<double>& scores) const;
+
+  //: Mutual information (bits) for each shift, with n_bins bins over [min, max]
+  void mutual_info(std::vector<vgl_vector_2d<int> > const& shifts,
+                   std::vector<double>& scores,
+                   double min, double max, unsigned n_bins) const;
+
+  //: Mutual information (bits) for each homography, with n_bins bins over [min, max]
+  void mutual_info(std::vector<vgl_h_matrix_2d<double> > const& homographies,
+                   std::vector<double>& scores,
+                   double min, double max, unsigned n_bins) const;
+
+ private:
+  vil_image_view<float> image0_;
+  vil_image_view<float> image1_;
+  unsigned num_threads_;
+  ncc_method ncc_method_;
+  brip_integral_image sum0_, sum00_, sum1_, sum11_;
+
+  //: The correlation sum_x image0(x)*image1(x+d) for every shift d, by FFT
+  void correlation_surface(vil_image_view<double>& surface) const;
+};
+
+#endif // brip_batch_match_h_
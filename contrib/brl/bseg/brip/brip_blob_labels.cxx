@@ -0,0 +1,274 @@
+// This is brl/bseg/brip/brip_blob_labels.cxx
+#include <vector>
+#include <cstddef>
+#include "brip_blob_labels.h"
+//:
+// \file
+#include <vcl_cassert.h>
+#include <vpl/vpl_parallel_for.h>
+
+// The image is seen as a volume of ni x nj x nk pixels with index
+// p = i + ni*(j + nj*k), cut into tiles of whole k slices; a 2d image is an
+// ni x 1 x nj volume.  The label of pixel p is held in lab[p] and the
+// provisional label created at pixel p is p+1.
+struct brip_blob_geometry
+{
+  unsigned ni, nj, nk;
+  bool const* src;
+  std::ptrdiff_t istep, jstep, kstep;
+  //: the neighbours before a pixel in raster order
+  unsigned n_prev;
+  int di[13], dj[13], dk[13];
+  //: first k slice of each tile, and nk at the end
+  std::vector<unsigned> tile_k;
+  unsigned* lab;
+  std::vector<unsigned> parent;
+  std::vector<unsigned> number;
+  std::vector<unsigned> n_roots;
+
+  bool fg(unsigned i, unsigned j, unsigned k) const
+  { return src[i*istep + j*jstep + k*kstep]; }
+  std::size_t index(unsigned i, unsigned j, unsigned k) const
+  { return i + std::size_t(ni)*(j + std::size_t(nj)*k); }
+
+  //: the root of label x, halving the path
+  unsigned find(unsigned x)
+  {
+    while (parent[x] != x) {
+      parent[x] = parent[parent[x]];
+      x = parent[x];
+    }
+    return x;
+  }
+  //: the root of label x, without changing the forest
+  unsigned root(unsigned x) const
+  {
+    while (parent[x] != x)
+      x = parent[x];
+    return x;
+  }
+  //: merge the trees of roots a and b under the smaller one, returning it
+  unsigned link(unsigned a, unsigned b)
+  {
+    if (a == b) return a;
+    if (a < b) { parent[b] = a; return a; }
+    parent[a] = b;
+    return b;
+  }
+};
+
+//: Label each tile on its own, with only the neighbours inside the tile
+class brip_blob_tile_body : public vpl_parallel_for_body
+{
+ public:
+  brip_blob_tile_body(brip_blob_geometry& g) : g_(g) {}
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    brip_blob_geometry& g = g_;
+    for (unsigned t = begin; t<end; ++t)
+    {
+      unsigned k0 = g.tile_k[t], k1 = g.tile_k[t+1];
+      for (unsigned k = k0; k<k1; ++k)
+        for (unsigned j = 0; j<g.nj; ++j)
+          for (unsigned i = 0; i<g.ni; ++i) {
+            std::size_t p = g.index(i, j, k);
+            if (!g.fg(i, j, k)) {
+              g.lab[p] = 0;
+              continue;
+            }
+            unsigned r = 0;
+            for (unsigned m = 0; m<g.n_prev; ++m) {
+              // unsigned wraparound rejects -1
+              unsigned ii = i + g.di[m], jj = j + g.dj[m], kk = k + g.dk[m];
+              if (ii >= g.ni || jj >= g.nj || kk >= k1 || kk < k0)
+                continue;
+              unsigned l = g.lab[g.index(ii, jj, kk)];
+              if (l == 0)
+                continue;
+              l = g.find(l);
+              r = r ? g.link(r, l) : l;
+            }
+            if (r == 0) {
+              r = unsigned(p+1);
+              g.parent[r] = r;
+            }
+            g.lab[p] = r;
+          }
+      // point every pixel at the root of its tree in the tile
+      std::size_t p0 = g.index(0, 0, k0), p1 = g.index(0, 0, k1);
+      for (std::size_t p = p0; p<p1; ++p)
+        if (g.lab[p])
+          g.lab[p] = g.find(g.lab[p]);
+    }
+  }
+ private:
+  brip_blob_geometry& g_;
+};
+
+//: Count the trees rooted in each tile, or number them once the counts are known
+class brip_blob_root_body : public vpl_parallel_for_body
+{
+ public:
+  brip_blob_root_body(brip_blob_geometry& g, std::vector<unsigned> const* first)
+  : g_(g), first_(first) {}
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    brip_blob_geometry& g = g_;
+    for (unsigned t = begin; t<end; ++t)
+    {
+      std::size_t p0 = g.index(0, 0, g.tile_k[t]), p1 = g.index(0, 0, g.tile_k[t+1]);
+      unsigned c = first_ ? (*first_)[t] : 0;
+      for (std::size_t p = p0; p<p1; ++p) {
+        unsigned l = unsigned(p+1);
+        if (g.lab[p] != l || g.parent[l] != l)
+          continue;
+        ++c;
+        if (first_)
+          g.number[l] = c;
+      }
+      if (!first_)
+        g.n_roots[t] = c;
+    }
+  }
+ private:
+  brip_blob_geometry& g_;
+  std::vector<unsigned> const* first_;
+};
+
+//: Replace the provisional labels by the numbers of their roots
+class brip_blob_relabel_body : public vpl_parallel_for_body
+{
+ public:
+  brip_blob_relabel_body(brip_blob_geometry& g) : g_(g) {}
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    brip_blob_geometry& g = g_;
+    for (unsigned t = begin; t<end; ++t)
+    {
+      std::size_t p0 = g.index(0, 0, g.tile_k[t]), p1 = g.index(0, 0, g.tile_k[t+1]);
+      for (std::size_t p = p0; p<p1; ++p)
+        if (g.lab[p])
+          g.lab[p] = g.number[g.root(g.lab[p])];
+    }
+  }
+ private:
+  brip_blob_geometry& g_;
+};
+
+//: Label g.lab, which must hold ni*nj*nk values
+static unsigned brip_blob_label(brip_blob_geometry& g, unsigned num_threads, unsigned tile_k)
+{
+  std::size_t n = std::size_t(g.ni)*g.nj*g.nk;
+  assert(n < std::size_t(static_cast<unsigned>(-1)));
+  if (n == 0)
+    return 0;
+  unsigned nt = vpl_parallel_for_num_threads(num_threads);
+  if (tile_k == 0)
+    tile_k = (g.nk + 4*nt - 1)/(4*nt);
+  if (tile_k == 0)
+    tile_k = 1;
+  g.tile_k.clear();
+  for (unsigned k = 0; k<g.nk; k += tile_k)
+    g.tile_k.push_back(k);
+  g.tile_k.push_back(g.nk);
+  unsigned n_tiles = unsigned(g.tile_k.size()) - 1;
+  g.parent.resize(n+1);
+  g.parent[0] = 0;
+
+  brip_blob_tile_body tiles(g);
+  vpl_parallel_for(n_tiles, tiles, nt);
+
+  // merge the trees that touch across the first slice of each tile
+  for (unsigned t = 1; t<n_tiles; ++t) {
+    unsigned k = g.tile_k[t];
+    for (unsigned j = 0; j<g.nj; ++j)
+      for (unsigned i = 0; i<g.ni; ++i) {
+        unsigned l = g.lab[g.index(i, j, k)];
+        if (l == 0)
+          continue;
+        for (unsigned m = 0; m<g.n_prev; ++m) {
+          if (g.dk[m] == 0)
+            continue;
+          unsigned ii = i + g.di[m], jj = j + g.dj[m];
+          if (ii >= g.ni || jj >= g.nj)
+            continue;
+          unsigned lq = g.lab[g.index(ii, jj, k-1)];
+          if (lq)
+            g.link(g.find(l), g.find(lq));
+        }
+      }
+  }
+
+  // number the roots in raster order: count per tile, then offset each tile
+  g.n_roots.assign(n_tiles, 0);
+  brip_blob_root_body count(g, VXL_NULLPTR);
+  vpl_parallel_for(n_tiles, count, nt);
+  std::vector<unsigned> first(n_tiles, 0);
+  unsigned total = 0;
+  for (unsigned t = 0; t<n_tiles; ++t) {
+    first[t] = total;
+    total += g.n_roots[t];
+  }
+  g.number.resize(n+1);
+  g.number[0] = 0;
+  brip_blob_root_body assign(g, &first);
+  vpl_parallel_for(n_tiles, assign, nt);
+
+  brip_blob_relabel_body relabel(g);
+  vpl_parallel_for(n_tiles, relabel, nt);
+  return total;
+}
+
+unsigned brip_blob_labels(vil_image_view<bool> const& src,
+                          vil_blob_connectivity conn,
+                          vil_image_view<unsigned>& dest,
+                          unsigned num_threads, unsigned tile_rows)
+{
+  unsigned ni = src.ni(), nj = src.nj();
+  dest.set_size(ni, nj);
+  if (dest.istep() != 1 || dest.jstep() != std::ptrdiff_t(ni))
+    dest = vil_image_view<unsigned>(ni, nj);
+
+  brip_blob_geometry g;
+  g.ni = ni; g.nj = 1; g.nk = nj;
+  g.src = src.top_left_ptr();
+  g.istep = src.istep(); g.jstep = 0; g.kstep = src.jstep();
+  // the rows of the image are the k slices
+  static const int di[] = { -1,  0, -1, +1 };
+  static const int dk[] = {  0, -1, -1, -1 };
+  g.n_prev = conn == vil_blob_8_conn ? 4 : 2;
+  for (unsigned m = 0; m<g.n_prev; ++m) {
+    g.di[m] = di[m]; g.dj[m] = 0; g.dk[m] = dk[m];
+  }
+  g.lab = dest.top_left_ptr();
+  return brip_blob_label(g, num_threads, tile_rows);
+}
+
+#if BRIP_HAS_VIL3D
+unsigned brip_blob_labels(vil3d_image_view<bool> const& src,
+                          vil3d_find_blob_connectivity conn,
+                          vil3d_image_view<unsigned>& dest,
+                          unsigned num_threads, unsigned tile_slices)
+{
+  unsigned ni = src.ni(), nj = src.nj(), nk = src.nk();
+  dest.set_size(ni, nj, nk);
+  if (dest.istep() != 1 || dest.jstep() != std::ptrdiff_t(ni) ||
+      dest.kstep() != std::ptrdiff_t(ni)*std::ptrdiff_t(nj))
+    dest = vil3d_image_view<unsigned>(ni, nj, nk);
+
+  brip_blob_geometry g;
+  g.ni = ni; g.nj = nj; g.nk = nk;
+  g.src = src.origin_ptr();
+  g.istep = src.istep(); g.jstep = src.jstep(); g.kstep = src.kstep();
+  // the neighbours of vil3d_find_blobs
+  static const int di[] = { -1, 0, 0, -1,  0, +1, -1, +1, -1,  0, +1, -1, +1 };
+  static const int dj[] = { 0, -1, 0, -1, -1, -1,  0,  0, +1, +1, +1, -1, -1 };
+  static const int dk[] = { 0, 0, -1, -1, -1, -1, -1, -1, -1, -1, -1,  0,  0 };
+  g.n_prev = conn == vil3d_find_blob_connectivity_26_conn ? 13 : 3;
+  for (unsigned m = 0; m<g.n_prev; ++m) {
+    g.di[m] = di[m]; g.dj[m] = dj[m]; g.dk[m] = dk[m];
+  }
+  g.lab = dest.origin_ptr();
+  return brip_blob_label(g, num_threads, tile_slices);
+}
+#endif // BRIP_HAS_VIL3D
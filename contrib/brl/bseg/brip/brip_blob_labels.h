@@ -0,0 +1,52 @@
+// This is brl/bseg/brip/brip_blob_labels.h
+#ifndef brip_blob_labels_h_
+#define brip_blob_labels_h_
+//:
+// \file
+// \brief Connected component labelling of binary images and volumes on several threads
+//
+// The labels are those of vil_blob_labels and vil3d_find_blobs: 0 for the
+// background and 1..n for the blobs, numbered in raster order of their first
+// pixel.  Only the way they are found differs.
+//
+// The image is cut into tiles of whole rows (whole slices of a volume).
+// Each tile is labelled on its own thread with a union-find forest whose
+// provisional labels are pixel indices, so tiles need no coordination and
+// the root of every tree is its first pixel in raster order.  The trees that
+// meet across tile borders are then merged, which only visits the border
+// rows, and the final compact labels are written by tiles in parallel.
+//
+// The labelling of volumes needs vil3d, from the mul package; it is only
+// built with BUILD_MUL, which defines BRIP_HAS_VIL3D.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vil/vil_image_view.h>
+#include <vil/algo/vil_blob.h>
+#include <vcl_compiler.h>
+#if BRIP_HAS_VIL3D
+#include <vil3d/vil3d_image_view.h>
+#include <vil3d/algo/vil3d_find_blobs.h>
+#endif
+
+//: Label the blobs of a binary image, as vil_blob_labels()
+//  Tiles have tile_rows rows (0 chooses a size from the number of threads).
+//  num_threads = 0 uses one thread per processor.  Returns the number of blobs.
+unsigned brip_blob_labels(vil_image_view<bool> const& src,
+                          vil_blob_connectivity conn,
+                          vil_image_view<unsigned>& dest,
+                          unsigned num_threads = 0, unsigned tile_rows = 0);
+
+#if BRIP_HAS_VIL3D
+//: Label the blobs of a binary volume, as vil3d_find_blobs()
+//  Tiles have tile_slices k slices (0 chooses a size from the number of
+//  threads).  Returns the number of blobs.
+unsigned brip_blob_labels(vil3d_image_view<bool> const& src,
+                          vil3d_find_blob_connectivity conn,
+                          vil3d_image_view<unsigned>& dest,
+                          unsigned num_threads = 0, unsigned tile_slices = 0);
+#endif // BRIP_HAS_VIL3D
+
+#endif // brip_blob_labels_h_
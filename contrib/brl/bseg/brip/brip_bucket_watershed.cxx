@@ -0,0 +1,232 @@
+// This is brl/bseg/brip/brip_bucket_watershed.cxx
+#include <algorithm>
+#include "brip_bucket_watershed.h"
+//:
+// \file
+
+// internal pixel states, above any marker label
+static const unsigned brip_ws_queued = static_cast<unsigned>(-1);
+static const unsigned brip_ws_boundary = static_cast<unsigned>(-2);
+
+//: The neighbour offsets of a pixel, in raster order
+struct brip_ws_stencil
+{
+  int n;
+  int di[26], dj[26], dk[26];
+  int d[26];
+};
+
+static void brip_ws_make_stencil(bool full, bool volume, unsigned ni, unsigned nj,
+                                 brip_ws_stencil& s)
+{
+  s.n = 0;
+  int kr = volume ? 1 : 0;
+  for (int dk = -kr; dk<=kr; ++dk)
+    for (int dj = -1; dj<=1; ++dj)
+      for (int di = -1; di<=1; ++di) {
+        int nz = (di != 0) + (dj != 0) + (dk != 0);
+        if (nz == 0 || (!full && nz > 1))
+          continue;
+        s.di[s.n] = di; s.dj[s.n] = dj; s.dk[s.n] = dk;
+        s.d[s.n] = di + int(ni)*(dj + int(nj)*dk);
+        ++s.n;
+      }
+}
+
+//: The neighbours of pixel p inside the image, returns their number
+static int brip_ws_neighbours(brip_ws_stencil const& s, int p,
+                              unsigned ni, unsigned nj, unsigned nk, int* nb)
+{
+  unsigned i = p % ni, r = p / ni, j = r % nj, k = r / nj;
+  bool inside = i>0 && i+1<ni && j>0 && j+1<nj && (nk == 1 || (k>0 && k+1<nk));
+  if (inside) {
+    for (int m = 0; m<s.n; ++m)
+      nb[m] = p + s.d[m];
+    return s.n;
+  }
+  int c = 0;
+  for (int m = 0; m<s.n; ++m) {
+    // unsigned wraparound rejects -1
+    unsigned ii = i + s.di[m], jj = j + s.dj[m], kk = k + s.dk[m];
+    if (ii<ni && jj<nj && kk<nk)
+      nb[c++] = p + s.d[m];
+  }
+  return c;
+}
+
+brip_bucket_watershed::brip_bucket_watershed(bool full_connectivity,
+                                             bool mark_boundaries,
+                                             unsigned boundary_label)
+  : full_connectivity_(full_connectivity), mark_boundaries_(mark_boundaries),
+    boundary_label_(boundary_label), ni_(0), nj_(0), nk_(0), n_boundary_(0)
+{
+}
+
+template <class T>
+unsigned brip_bucket_watershed::load(T const* cost, std::ptrdiff_t cistep, std::ptrdiff_t cjstep, std::ptrdiff_t ckstep,
+                                     unsigned const* labels, std::ptrdiff_t listep, std::ptrdiff_t ljstep, std::ptrdiff_t lkstep,
+                                     unsigned ni, unsigned nj, unsigned nk)
+{
+  ni_ = ni; nj_ = nj; nk_ = nk;
+  std::size_t n = std::size_t(ni)*nj*nk;
+  cost_.resize(n);
+  label_.resize(n);
+  next_.resize(n);
+  unsigned max_cost = 0;
+  std::size_t p = 0;
+  for (unsigned k = 0; k<nk; ++k)
+    for (unsigned j = 0; j<nj; ++j) {
+      T const* c = cost + k*ckstep + j*cjstep;
+      unsigned const* l = labels + k*lkstep + j*ljstep;
+      for (unsigned i = 0; i<ni; ++i, ++p, c += cistep, l += listep) {
+        cost_[p] = static_cast<vxl_uint_16>(*c);
+        label_[p] = *l;
+        max_cost = std::max(max_cost, static_cast<unsigned>(*c));
+      }
+    }
+  return max_cost;
+}
+
+void brip_bucket_watershed::store(unsigned* labels, std::ptrdiff_t listep, std::ptrdiff_t ljstep, std::ptrdiff_t lkstep) const
+{
+  std::size_t p = 0;
+  for (unsigned k = 0; k<nk_; ++k)
+    for (unsigned j = 0; j<nj_; ++j) {
+      unsigned* l = labels + k*lkstep + j*ljstep;
+      for (unsigned i = 0; i<ni_; ++i, ++p, l += listep)
+        *l = label_[p] == brip_ws_boundary ? boundary_label_ : label_[p];
+    }
+}
+
+bool brip_bucket_watershed::run(unsigned n_levels, bool volume)
+{
+  n_boundary_ = 0;
+  brip_ws_stencil s;
+  brip_ws_make_stencil(full_connectivity_, volume, ni_, nj_, s);
+  head_.assign(n_levels, -1);
+  tail_.assign(n_levels, -1);
+  int n = int(label_.size());
+  int nb[26];
+
+  // queue the unlabelled neighbours of the markers
+  bool any = false;
+  for (int p = 0; p<n; ++p) {
+    if (label_[p] == 0 || label_[p] == brip_ws_queued)
+      continue;
+    any = true;
+    int c = brip_ws_neighbours(s, p, ni_, nj_, nk_, nb);
+    for (int m = 0; m<c; ++m) {
+      int q = nb[m];
+      if (label_[q] != 0)
+        continue;
+      label_[q] = brip_ws_queued;
+      unsigned lev = cost_[q];
+      next_[q] = -1;
+      if (tail_[lev] < 0) head_[lev] = q; else next_[tail_[lev]] = q;
+      tail_[lev] = q;
+    }
+  }
+  if (!any)
+    return false;
+
+  // flood, lowest bucket first; pixels queued below the current level go
+  // to the end of the current bucket, so the level never decreases
+  unsigned level = 0;
+  while (level < n_levels)
+  {
+    int p = head_[level];
+    if (p < 0) {
+      ++level;
+      continue;
+    }
+    head_[level] = next_[p];
+    if (head_[level] < 0)
+      tail_[level] = -1;
+
+    int c = brip_ws_neighbours(s, p, ni_, nj_, nk_, nb);
+    unsigned lab = 0;
+    bool contested = false;
+    for (int m = 0; m<c && !contested; ++m) {
+      unsigned l = label_[nb[m]];
+      if (l == 0 || l >= brip_ws_boundary)
+        continue;
+      if (lab == 0)
+        lab = l;
+      else if (l != lab)
+        contested = true;
+    }
+    if (contested && mark_boundaries_) {
+      label_[p] = brip_ws_boundary;
+      ++n_boundary_;
+      continue;
+    }
+    label_[p] = lab;
+    for (int m = 0; m<c; ++m) {
+      int q = nb[m];
+      if (label_[q] != 0)
+        continue;
+      label_[q] = brip_ws_queued;
+      unsigned lev = std::max(static_cast<unsigned>(cost_[q]), level);
+      next_[q] = -1;
+      if (tail_[lev] < 0) head_[lev] = q; else next_[tail_[lev]] = q;
+      tail_[lev] = q;
+    }
+  }
+  return true;
+}
+
+bool brip_bucket_watershed::flood(vil_image_view<vxl_byte> const& cost,
+                                  vil_image_view<unsigned>& labels)
+{
+  if (labels.ni() != cost.ni() || labels.nj() != cost.nj())
+    return false;
+  this->load(cost.top_left_ptr(), cost.istep(), cost.jstep(), 0,
+             labels.top_left_ptr(), labels.istep(), labels.jstep(), 0,
+             cost.ni(), cost.nj(), 1);
+  bool ok = this->run(256, false);
+  this->store(labels.top_left_ptr(), labels.istep(), labels.jstep(), 0);
+  return ok;
+}
+
+bool brip_bucket_watershed::flood(vil_image_view<vxl_uint_16> const& cost,
+                                  vil_image_view<unsigned>& labels)
+{
+  if (labels.ni() != cost.ni() || labels.nj() != cost.nj())
+    return false;
+  unsigned max_cost =
+    this->load(cost.top_left_ptr(), cost.istep(), cost.jstep(), 0,
+               labels.top_left_ptr(), labels.istep(), labels.jstep(), 0,
+               cost.ni(), cost.nj(), 1);
+  bool ok = this->run(max_cost+1, false);
+  this->store(labels.top_left_ptr(), labels.istep(), labels.jstep(), 0);
+  return ok;
+}
+
+#if BRIP_HAS_VIL3D
+bool brip_bucket_watershed::flood(vil3d_image_view<vxl_byte> const& cost,
+                                  vil3d_image_view<unsigned>& labels)
+{
+  if (labels.ni() != cost.ni() || labels.nj() != cost.nj() || labels.nk() != cost.nk())
+    return false;
+  this->load(cost.origin_ptr(), cost.istep(), cost.jstep(), cost.kstep(),
+             labels.origin_ptr(), labels.istep(), labels.jstep(), labels.kstep(),
+             cost.ni(), cost.nj(), cost.nk());
+  bool ok = this->run(256, true);
+  this->store(labels.origin_ptr(), labels.istep(), labels.jstep(), labels.kstep());
+  return ok;
+}
+
+bool brip_bucket_watershed::flood(vil3d_image_view<vxl_uint_16> const& cost,
+                                  vil3d_image_view<unsigned>& labels)
+{
+  if (labels.ni() != cost.ni() || labels.nj() != cost.nj() || labels.nk() != cost.nk())
+    return false;
+  unsigned max_cost =
+    this->load(cost.origin_ptr(), cost.istep(), cost.jstep(), cost.kstep(),
+               labels.origin_ptr(), labels.istep(), labels.jstep(), labels.kstep(),
+               cost.ni(), cost.nj(), cost.nk());
+  bool ok = this->run(max_cost+1, true);
+  this->store(labels.origin_ptr(), labels.istep(), labels.jstep(), labels.kstep());
+  return ok;
+}
+#endif // BRIP_HAS_VIL3D
@@ -0,0 +1,92 @@
+// This is brl/bseg/brip/brip_bucket_watershed.h
+#ifndef brip_bucket_watershed_h_
+#define brip_bucket_watershed_h_
+//:
+// \file
+// \brief Marker based watershed of an integer cost image, flooded with a bucket queue
+//
+// The regions grow from a set of markers (labels > 0 in the label image) in
+// order of increasing cost, as in Meyer's flooding algorithm.  A pixel joins
+// the region of its labelled neighbours; a pixel whose labelled neighbours
+// belong to different regions becomes a boundary pixel and stops the flood.
+//
+// brip_watershed keeps a priority queue of reference counted pixel objects,
+// one heap allocation per pixel.  Here the costs are integers (bytes or
+// 16 bit values), so the queue is an array of FIFO buckets, one per cost
+// level, chained through a single "next" index per pixel.  Pushing and
+// popping are constant time and no memory is allocated during the flood;
+// the buffers are kept between calls, so images of the same size reuse them.
+// Pixels of equal cost are processed in the order they were queued, and a
+// pixel queued below the current flood level is queued at that level, so
+// the result is fully determined by the images.
+//
+// The same code floods vil3d volumes, with 6 or 26 connectivity.  vil3d is
+// part of the mul package, so the volume floods are only built with
+// BUILD_MUL, which defines BRIP_HAS_VIL3D.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <cstddef>
+#include <vil/vil_image_view.h>
+#include <vxl_config.h> // for vxl_byte & vxl_uint_16
+#include <vcl_compiler.h>
+#if BRIP_HAS_VIL3D
+#include <vil3d/vil3d_image_view.h>
+#endif
+
+class brip_bucket_watershed
+{
+ public:
+  //: full_connectivity selects 8 (26 in 3d) instead of 4 (6) neighbours.
+  //  If mark_boundaries is false the regions meet without a boundary, and a
+  //  contested pixel joins the region of its first labelled neighbour.
+  brip_bucket_watershed(bool full_connectivity = true, bool mark_boundaries = true,
+                        unsigned boundary_label = 0);
+
+  //: Flood the cost image from the markers in labels
+  //  On input labels holds the markers (> 0) and 0 elsewhere; it must have
+  //  the size of cost.  On output each pixel reached by the flood has the
+  //  label of its region, or boundary_label() on a boundary.  Pixels not
+  //  connected to any marker keep 0.  Returns false if there is no marker.
+  bool flood(vil_image_view<vxl_byte> const& cost, vil_image_view<unsigned>& labels);
+  bool flood(vil_image_view<vxl_uint_16> const& cost, vil_image_view<unsigned>& labels);
+#if BRIP_HAS_VIL3D
+  bool flood(vil3d_image_view<vxl_byte> const& cost, vil3d_image_view<unsigned>& labels);
+  bool flood(vil3d_image_view<vxl_uint_16> const& cost, vil3d_image_view<unsigned>& labels);
+#endif
+
+  //: Number of boundary pixels found by the last flood
+  unsigned n_boundary_pixels() const { return n_boundary_; }
+
+  unsigned boundary_label() const { return boundary_label_; }
+
+ private:
+  //: Load the costs and markers into the flat buffers (index i + ni*(j + nj*k)), returning the largest cost
+  template <class T>
+  unsigned load(T const* cost, std::ptrdiff_t cistep, std::ptrdiff_t cjstep, std::ptrdiff_t ckstep,
+            unsigned const* labels, std::ptrdiff_t listep, std::ptrdiff_t ljstep, std::ptrdiff_t lkstep,
+            unsigned ni, unsigned nj, unsigned nk);
+  //: Write the flat labels back, mapping the internal states to their labels
+  void store(unsigned* labels, std::ptrdiff_t listep, std::ptrdiff_t ljstep, std::ptrdiff_t lkstep) const;
+  //: Run the flood on the loaded buffers with costs in [0, n_levels)
+  bool run(unsigned n_levels, bool volume);
+
+  bool full_connectivity_;
+  bool mark_boundaries_;
+  unsigned boundary_label_;
+  unsigned ni_, nj_, nk_;
+  unsigned n_boundary_;
+  //: cost of each pixel
+  std::vector<vxl_uint_16> cost_;
+  //: label of each pixel, or one of the internal queued / boundary states
+  std::vector<unsigned> label_;
+  //: next pixel in the same bucket, -1 at the end of a bucket
+  std::vector<int> next_;
+  //: first and last pixel of each bucket, -1 if empty
+  std::vector<int> head_, tail_;
+};
+
+#endif // brip_bucket_watershed_h_
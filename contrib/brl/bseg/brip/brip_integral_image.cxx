@@ -0,0 +1,51 @@
+// This is brl/bseg/brip/brip_integral_image.cxx
+#include "brip_integral_image.h"
+//:
+// \file
+#include <vcl_cassert.h>
+
+brip_integral_image::brip_integral_image(vil_image_view<float> const& a)
+{
+  unsigned ni = a.ni(), nj = a.nj();
+  sum_.set_size(ni+1, nj+1);
+  sum_.fill(0.0);
+  for (unsigned j = 0; j<nj; ++j)
+  {
+    double row = 0.0;
+    for (unsigned i = 0; i<ni; ++i)
+    {
+      row += a(i,j);
+      sum_(i+1, j+1) = sum_(i+1, j) + row;
+    }
+  }
+}
+
+brip_integral_image::brip_integral_image(vil_image_view<float> const& a,
+                                         vil_image_view<float> const& b)
+{
+  assert(a.ni() == b.ni() && a.nj() == b.nj());
+  unsigned ni = a.ni(), nj = a.nj();
+  sum_.set_size(ni+1, nj+1);
+  sum_.fill(0.0);
+  for (unsigned j = 0; j<nj; ++j)
+  {
+    double row = 0.0;
+    for (unsigned i = 0; i<ni; ++i)
+    {
+      row += double(a(i,j))*double(b(i,j));
+      sum_(i+1, j+1) = sum_(i+1, j) + row;
+    }
+  }
+}
+
+void brip_integral_image::window_sums(unsigned i_radius, unsigned j_radius,
+                                      vil_image_view<float>& out, double norm,
+                                      float border_value) const
+{
+  unsigned ni = this->ni(), nj = this->nj();
+  out.set_size(ni, nj);
+  out.fill(border_value);
+  for (unsigned j = j_radius; j+j_radius<nj; ++j)
+    for (unsigned i = i_radius; i+i_radius<ni; ++i)
+      out(i,j) = float(this->window_sum(i, j, i_radius, j_radius)/norm);
+}
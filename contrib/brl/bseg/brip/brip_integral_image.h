@@ -0,0 +1,66 @@
+// This is brl/bseg/brip/brip_integral_image.h
+#ifndef brip_integral_image_h_
+#define brip_integral_image_h_
+//:
+// \file
+// \brief Summed area tables for constant time box sums over an image
+//
+// A brip_integral_image holds S(i,j) = sum of f(u,v) for u<i, v<j, where f
+// is an image, the square of an image or the product of two images.  The
+// sum of f over any rectangular window is then found from four table
+// entries, whatever the size of the window.  The local statistics
+// operators of brip_vil_float_ops (the gradient matrix, local standard
+// deviation, ...) use it so that their cost does not grow with the radius.
+// The sums are accumulated in double precision.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vil/vil_image_view.h>
+#include <vcl_compiler.h>
+
+class brip_integral_image
+{
+ public:
+  //: Empty table
+  brip_integral_image() {}
+
+  //: Table of the sums of image a
+  explicit brip_integral_image(vil_image_view<float> const& a);
+
+  //: Table of the sums of the products a(i,j)*b(i,j), e.g. sums of squares when b is a
+  brip_integral_image(vil_image_view<float> const& a,
+                      vil_image_view<float> const& b);
+
+  //: Width of the summed image
+  unsigned ni() const { return sum_.ni() > 0 ? sum_.ni()-1 : 0; }
+
+  //: Height of the summed image
+  unsigned nj() const { return sum_.nj() > 0 ? sum_.nj()-1 : 0; }
+
+  //: Sum over the pixels i0<=i<=i1, j0<=j<=j1. No bounds check
+  double sum(unsigned i0, unsigned j0, unsigned i1, unsigned j1) const
+  {
+    return sum_(i1+1, j1+1) - sum_(i0, j1+1) - sum_(i1+1, j0) + sum_(i0, j0);
+  }
+
+  //: Sum over the (2*i_radius+1) x (2*j_radius+1) window centred on (i,j). No bounds check
+  double window_sum(unsigned i, unsigned j,
+                    unsigned i_radius, unsigned j_radius) const
+  {
+    return this->sum(i-i_radius, j-j_radius, i+i_radius, j+j_radius);
+  }
+
+  //: The window sums about each pixel, divided by norm
+  //  Pixels closer than the radius to the image border are set to border_value.
+  void window_sums(unsigned i_radius, unsigned j_radius,
+                   vil_image_view<float>& out, double norm = 1.0,
+                   float border_value = 0.0f) const;
+
+ private:
+  //: (ni+1) x (nj+1) table with a zero first row and column
+  vil_image_view<double> sum_;
+};
+
+#endif // brip_integral_image_h_
@@ -0,0 +1,518 @@
+// This is brl/bseg/brip/brip_optical_flow.cxx
+#include <cmath>
+#include <algorithm>
+#include "brip_optical_flow.h"
+//:
+// \file
+#include <vcl_cassert.h>
+#include <vil/algo/vil_gauss_reduce.h>
+#include <vpl/vpl_parallel_for.h>
+
+//: rows processed together by one task of the row loops
+static const unsigned brip_flow_grain = 8;
+
+//: bilinear interpolation of a contiguous image at (x,y), clamped to the image
+static inline float brip_flow_bilinear(float const* im, std::ptrdiff_t jstep,
+                                       int ni, int nj, float x, float y)
+{
+  x = std::min(std::max(x, 0.0f), float(ni-1));
+  y = std::min(std::max(y, 0.0f), float(nj-1));
+  int i0 = static_cast<int>(x), j0 = static_cast<int>(y);
+  int i1 = i0+1<ni ? i0+1 : i0, j1 = j0+1<nj ? j0+1 : j0;
+  float fx = x - float(i0), fy = y - float(j0);
+  float const* r0 = im + j0*jstep;
+  float const* r1 = im + j1*jstep;
+  float top = r0[i0] + fx*(r0[i1]-r0[i0]);
+  float bot = r1[i0] + fx*(r1[i1]-r1[i0]);
+  return top + fy*(bot-top);
+}
+
+//: whether (x,y) lies inside an ni x nj image
+static inline bool brip_flow_inside(float x, float y, int ni, int nj)
+{
+  return x >= 0.0f && y >= 0.0f && x <= float(ni-1) && y <= float(nj-1);
+}
+
+//: central difference gradients of a range of rows
+struct brip_flow_gradient_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const* image;
+  vil_image_view<float>* gx;
+  vil_image_view<float>* gy;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    const int ni = image->ni(), nj = image->nj();
+    for (unsigned j = begin; j<end; ++j)
+    {
+      int jm = j>0 ? int(j)-1 : 0, jp = int(j)+1<nj ? int(j)+1 : int(j);
+      float sy = jp>jm ? 1.0f/float(jp-jm) : 0.0f;
+      float const* r = &(*image)(0, j);
+      float const* up = &(*image)(0, jm);
+      float const* down = &(*image)(0, jp);
+      float* ox = &(*gx)(0, j);
+      float* oy = &(*gy)(0, j);
+      for (int i = 0; i<ni; ++i)
+        oy[i] = sy*(down[i] - up[i]);
+      if (ni < 2) {
+        ox[0] = 0.0f;
+        continue;
+      }
+      ox[0] = r[1] - r[0];
+      for (int i = 1; i+1<ni; ++i)
+        ox[i] = 0.5f*(r[i+1] - r[i-1]);
+      ox[ni-1] = r[ni-1] - r[ni-2];
+    }
+  }
+};
+
+//: One pass of a (2r+1)x(2r+1) box mean, clipped at the image border, of several images
+//  The horizontal pass writes tmp, the vertical pass reads it.
+struct brip_flow_box_body : public vpl_parallel_for_body
+{
+  std::vector<vil_image_view<float> const*> src;
+  std::vector<vil_image_view<float>*> tmp;
+  std::vector<vil_image_view<float>*> dst;
+  int r;
+  bool horizontal;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned k = 0; k<src.size(); ++k) {
+      if (horizontal)
+        rows_horizontal(*src[k], *tmp[k], begin, end);
+      else
+        rows_vertical(*tmp[k], *dst[k], begin, end);
+    }
+  }
+
+  void rows_horizontal(vil_image_view<float> const& in, vil_image_view<float>& out,
+                       unsigned begin, unsigned end) const
+  {
+    const int ni = in.ni();
+    std::vector<double> prefix(ni+1);
+    for (unsigned j = begin; j<end; ++j) {
+      float const* a = &in(0, j);
+      float* b = &out(0, j);
+      prefix[0] = 0.0;
+      for (int i = 0; i<ni; ++i)
+        prefix[i+1] = prefix[i] + a[i];
+      for (int i = 0; i<ni; ++i) {
+        int lo = std::max(i-r, 0), hi = std::min(i+r+1, ni);
+        b[i] = float((prefix[hi]-prefix[lo])/double(hi-lo));
+      }
+    }
+  }
+
+  void rows_vertical(vil_image_view<float> const& in, vil_image_view<float>& out,
+                     unsigned begin, unsigned end) const
+  {
+    const int ni = in.ni(), nj = in.nj();
+    for (unsigned j = begin; j<end; ++j) {
+      int lo = std::max(int(j)-r, 0), hi = std::min(int(j)+r+1, nj);
+      float* b = &out(0, j);
+      float const* a = &in(0, lo);
+      for (int i = 0; i<ni; ++i)
+        b[i] = a[i];
+      for (int jj = lo+1; jj<hi; ++jj) {
+        a = &in(0, jj);
+        for (int i = 0; i<ni; ++i)
+          b[i] += a[i];
+      }
+      const float s = 1.0f/float(hi-lo);
+      for (int i = 0; i<ni; ++i)
+        b[i] *= s;
+    }
+  }
+};
+
+//: box means of a set of images, on threads by rows
+static void brip_flow_box_mean(std::vector<vil_image_view<float> const*> const& src,
+                               std::vector<vil_image_view<float>*> const& dst,
+                               int r, unsigned num_threads)
+{
+  assert(!src.empty() && src.size() == dst.size());
+  std::vector<vil_image_view<float> > tmp(src.size());
+  brip_flow_box_body body;
+  body.src = src;
+  body.dst = dst;
+  body.r = r;
+  for (unsigned k = 0; k<src.size(); ++k) {
+    tmp[k].set_size(src[k]->ni(), src[k]->nj());
+    dst[k]->set_size(src[k]->ni(), src[k]->nj());
+    body.tmp.push_back(&tmp[k]);
+  }
+  const unsigned nj = src[0]->nj();
+  body.horizontal = true;
+  vpl_parallel_for(nj, body, num_threads, brip_flow_grain);
+  body.horizontal = false;
+  vpl_parallel_for(nj, body, num_threads, brip_flow_grain);
+}
+
+//: Per pixel terms of the Lucas-Kanade normal equations
+//  Each pixel y of the window of x contributes g(y) g(y)^T u(y) - g(y) It(y)
+//  to the right hand side for the new flow of x, where g is the gradient of
+//  frame0 and It the difference of frame1, warped by the flow u(y) of y, and
+//  frame0.  This is the first order correction of the residual at y for the
+//  flow of x instead of that of y, so every pixel of a window is warped only
+//  once.  The difference is 0 where the flow leaves frame1.  When tensor is
+//  set the body computes the gradient products of the structure tensor.
+struct brip_flow_products_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const *image0, *image1, *gx, *gy, *vx, *vy;
+  //: the two terms, or gx*gx, gy*gy and gx*gy
+  vil_image_view<float> *px, *py, *pxy;
+  bool tensor;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    const int ni = gx->ni(), nj = gx->nj();
+    for (unsigned j = begin; j<end; ++j) {
+      float const* x = &(*gx)(0, j);
+      float const* y = &(*gy)(0, j);
+      float* ox = &(*px)(0, j);
+      float* oy = &(*py)(0, j);
+      if (tensor) {
+        float* oxy = &(*pxy)(0, j);
+        for (int i = 0; i<ni; ++i) {
+          ox[i] = x[i]*x[i];
+          oxy[i] = x[i]*y[i];
+          oy[i] = y[i]*y[i];
+        }
+        continue;
+      }
+      float const* a = &(*image0)(0, j);
+      float const* u = &(*vx)(0, j);
+      float const* v = &(*vy)(0, j);
+      float const* im1 = image1->top_left_ptr();
+      const std::ptrdiff_t jstep1 = image1->jstep();
+      for (int i = 0; i<ni; ++i) {
+        float wx = float(i)+u[i], wy = float(j)+v[i];
+        float it = brip_flow_inside(wx, wy, ni, nj) ? brip_flow_bilinear(im1, jstep1, ni, nj, wx, wy) - a[i] : 0.0f;
+        float gu = x[i]*u[i] + y[i]*v[i] - it;
+        ox[i] = x[i]*gu;
+        oy[i] = y[i]*gu;
+      }
+    }
+  }
+};
+
+//: Lucas-Kanade flow from the window means of the tensor and of the per pixel terms
+struct brip_flow_lk_solve_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const *sxx, *sxy, *syy, *bx, *by;
+  vil_image_view<float> *vx, *vy;
+  float min_eigenvalue;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    const int ni = vx->ni();
+    for (unsigned j = begin; j<end; ++j) {
+      float const* a = &(*sxx)(0, j);
+      float const* b = &(*sxy)(0, j);
+      float const* c = &(*syy)(0, j);
+      float const* ex = &(*bx)(0, j);
+      float const* ey = &(*by)(0, j);
+      float* u = &(*vx)(0, j);
+      float* v = &(*vy)(0, j);
+      for (int i = 0; i<ni; ++i) {
+        float det = a[i]*c[i] - b[i]*b[i];
+        float h = 0.5f*(a[i] + c[i]);
+        float lmin = h - std::sqrt(std::max(h*h - det, 0.0f));
+        if (!(lmin >= min_eigenvalue) || det <= 0.0f)
+          continue;
+        u[i] = (c[i]*ex[i] - b[i]*ey[i])/det;
+        v[i] = (a[i]*ey[i] - b[i]*ex[i])/det;
+      }
+    }
+  }
+};
+
+//: The difference of frame1, warped by the flow, and frame0, and the mean gradient of both
+//  Where the flow leaves frame1 the difference and gradients are 0, so only
+//  the smoothness term acts there.
+struct brip_flow_residual_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const *image0, *image1, *gx, *gy, *gx1, *gy1, *vx, *vy;
+  vil_image_view<float> *it, *mgx, *mgy;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    const int ni = image0->ni(), nj = image0->nj();
+    const std::ptrdiff_t jstep1 = image1->jstep();
+    float const* im1 = image1->top_left_ptr();
+    for (unsigned j = begin; j<end; ++j) {
+      float const* a = &(*image0)(0, j);
+      float const* u = &(*vx)(0, j);
+      float const* v = &(*vy)(0, j);
+      float const* x = &(*gx)(0, j);
+      float const* y = &(*gy)(0, j);
+      float* o = &(*it)(0, j);
+      float* ox = &(*mgx)(0, j);
+      float* oy = &(*mgy)(0, j);
+      for (int i = 0; i<ni; ++i) {
+        float wx = float(i)+u[i], wy = float(j)+v[i];
+        bool in = brip_flow_inside(wx, wy, ni, nj);
+        o[i] = in ? brip_flow_bilinear(im1, jstep1, ni, nj, wx, wy) - a[i] : 0.0f;
+        ox[i] = in ? 0.5f*(x[i] + brip_flow_bilinear(gx1->top_left_ptr(), jstep1, ni, nj, wx, wy)) : 0.0f;
+        oy[i] = in ? 0.5f*(y[i] + brip_flow_bilinear(gy1->top_left_ptr(), jstep1, ni, nj, wx, wy)) : 0.0f;
+      }
+    }
+  }
+};
+
+//: One Jacobi iteration of Horn-Schunck, linearized about the flow (u0, v0) of the last warp
+struct brip_flow_hs_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const *gx, *gy, *it, *u0, *v0, *u_in, *v_in;
+  vil_image_view<float> *u_out, *v_out;
+  float alpha;
+
+  //: Horn and Schunck's neighbourhood mean: 1/6 of each edge neighbour, 1/12 of each corner
+  static void row_mean(float const* up, float const* r, float const* down, int ni, float* m)
+  {
+    for (int i = 0; i<ni; ++i) {
+      int il = i>0 ? i-1 : 0, ir = i+1<ni ? i+1 : i;
+      m[i] = (up[i] + down[i] + r[il] + r[ir])*(1.0f/6.0f) +
+             (up[il] + up[ir] + down[il] + down[ir])*(1.0f/12.0f);
+    }
+  }
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    const int ni = gx->ni(), nj = gx->nj();
+    std::vector<float> ub(ni), vb(ni);
+    for (unsigned j = begin; j<end; ++j) {
+      int jm = j>0 ? int(j)-1 : 0, jp = int(j)+1<nj ? int(j)+1 : int(j);
+      row_mean(&(*u_in)(0, jm), &(*u_in)(0, j), &(*u_in)(0, jp), ni, &ub[0]);
+      row_mean(&(*v_in)(0, jm), &(*v_in)(0, j), &(*v_in)(0, jp), ni, &vb[0]);
+      float const* x = &(*gx)(0, j);
+      float const* y = &(*gy)(0, j);
+      float const* t = &(*it)(0, j);
+      float const* a = &(*u0)(0, j);
+      float const* b = &(*v0)(0, j);
+      float* u = &(*u_out)(0, j);
+      float* v = &(*v_out)(0, j);
+      for (int i = 0; i<ni; ++i) {
+        float term = (x[i]*(ub[i]-a[i]) + y[i]*(vb[i]-b[i]) + t[i])/(alpha + x[i]*x[i] + y[i]*y[i]);
+        u[i] = ub[i] - x[i]*term;
+        v[i] = vb[i] - y[i]*term;
+      }
+    }
+  }
+};
+
+//: The flow of a finer level from that of the coarser level, doubled and interpolated
+struct brip_flow_upsample_body : public vpl_parallel_for_body
+{
+  vil_image_view<float> const *cu, *cv;
+  vil_image_view<float> *fu, *fv;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    const int ni = fu->ni(), cni = cu->ni(), cnj = cu->nj();
+    const std::ptrdiff_t js = cu->jstep();
+    for (unsigned j = begin; j<end; ++j) {
+      float* u = &(*fu)(0, j);
+      float* v = &(*fv)(0, j);
+      for (int i = 0; i<ni; ++i) {
+        u[i] = 2.0f*brip_flow_bilinear(cu->top_left_ptr(), js, cni, cnj, 0.5f*i, 0.5f*j);
+        v[i] = 2.0f*brip_flow_bilinear(cv->top_left_ptr(), js, cni, cnj, 0.5f*i, 0.5f*j);
+      }
+    }
+  }
+};
+
+brip_optical_flow::brip_optical_flow(brip_optical_flow_params const& params)
+  : params_(params), last_(-1)
+{
+}
+
+unsigned brip_optical_flow::n_levels(unsigned ni, unsigned nj) const
+{
+  unsigned n = 1;
+  while (n < params_.max_levels_) {
+    ni = (ni+1)/2;
+    nj = (nj+1)/2;
+    if (ni < params_.min_level_size_ || nj < params_.min_level_size_)
+      break;
+    ++n;
+  }
+  return n;
+}
+
+void brip_optical_flow::build_pyramid(vil_image_view<float> const& frame, frame_pyramid& pyr) const
+{
+  const unsigned ni = frame.ni(), nj = frame.nj(), nl = n_levels(ni, nj);
+  // reuse the level images of a pyramid of the same size
+  if (pyr.images.nlevels() != nl || pyr.images(0).ni() != ni || pyr.images(0).nj() != nj) {
+    std::vector<vil_image_view_base_sptr> views(nl);
+    std::vector<double> scales(nl);
+    for (unsigned l = 0; l<nl; ++l) {
+      views[l] = new vil_image_view<float>;
+      scales[l] = std::ldexp(1.0, -int(l));
+    }
+    pyr.images = vil_pyramid_image_view<float>(views, scales);
+  }
+  pyr.has_gradients = false;
+
+  // level 0 is a contiguous copy of the first plane of the frame
+  vil_image_view<float>& im0 = pyr.images(0);
+  im0.set_size(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      im0(i, j) = frame(i, j);
+  vil_image_view<float> work;
+  for (unsigned l = 1; l<nl; ++l)
+    vil_gauss_reduce(pyr.images(l-1), pyr.images(l), work);
+}
+
+void brip_optical_flow::compute_gradients(frame_pyramid& pyr) const
+{
+  if (pyr.has_gradients)
+    return;
+  const unsigned nl = pyr.images.nlevels();
+  const bool lk = params_.method_ == brip_optical_flow_params::LUCAS_KANADE;
+  pyr.gx.resize(nl); pyr.gy.resize(nl);
+  if (lk) {
+    pyr.sxx.resize(nl); pyr.sxy.resize(nl); pyr.syy.resize(nl);
+  }
+  for (unsigned l = 0; l<nl; ++l) {
+    vil_image_view<float>& im = pyr.images(l);
+    pyr.gx[l].set_size(im.ni(), im.nj());
+    pyr.gy[l].set_size(im.ni(), im.nj());
+    brip_flow_gradient_body gb;
+    gb.image = &im;
+    gb.gx = &pyr.gx[l];
+    gb.gy = &pyr.gy[l];
+    vpl_parallel_for(im.nj(), gb, params_.num_threads_, brip_flow_grain);
+    if (!lk)
+      continue;
+    vil_image_view<float> xx(im.ni(), im.nj()), xy(im.ni(), im.nj()), yy(im.ni(), im.nj());
+    brip_flow_products_body pb;
+    pb.image0 = pb.image1 = pb.vx = pb.vy = VXL_NULLPTR;
+    pb.gx = &pyr.gx[l];
+    pb.gy = &pyr.gy[l];
+    pb.px = &xx; pb.pxy = &xy; pb.py = &yy;
+    pb.tensor = true;
+    vpl_parallel_for(im.nj(), pb, params_.num_threads_, brip_flow_grain);
+    std::vector<vil_image_view<float> const*> src(3);
+    std::vector<vil_image_view<float>*> dst(3);
+    src[0] = &xx; src[1] = &xy; src[2] = &yy;
+    dst[0] = &pyr.sxx[l]; dst[1] = &pyr.sxy[l]; dst[2] = &pyr.syy[l];
+    brip_flow_box_mean(src, dst, int(params_.lk_radius_), params_.num_threads_);
+  }
+  pyr.has_gradients = true;
+}
+
+void brip_optical_flow::flow(frame_pyramid& pyr0, frame_pyramid& pyr1,
+                             vil_image_view<float>& vx, vil_image_view<float>& vy) const
+{
+  compute_gradients(pyr0);
+  const bool lk = params_.method_ == brip_optical_flow_params::LUCAS_KANADE;
+  // Horn-Schunck linearizes about the warped frame1 as well; in a stream its
+  // gradients are kept for the next pair
+  if (!lk)
+    compute_gradients(pyr1);
+  const unsigned nl = pyr0.images.nlevels(), nt = params_.num_threads_;
+  vil_image_view<float> u, v, cu, cv, px, py, bx, by, u0, v0, u1, v1, it;
+  for (int l = int(nl)-1; l>=0; --l)
+  {
+    vil_image_view<float>& im0 = pyr0.images(l);
+    vil_image_view<float>& im1 = pyr1.images(l);
+    const unsigned ni = im0.ni(), nj = im0.nj();
+    u = vil_image_view<float>(ni, nj);
+    v = vil_image_view<float>(ni, nj);
+    if (l == int(nl)-1) {
+      u.fill(0.0f);
+      v.fill(0.0f);
+    }
+    else {
+      brip_flow_upsample_body ub;
+      ub.cu = &cu; ub.cv = &cv;
+      ub.fu = &u; ub.fv = &v;
+      vpl_parallel_for(nj, ub, nt, brip_flow_grain);
+    }
+    px.set_size(ni, nj);
+    py.set_size(ni, nj);
+    for (unsigned w = 0; w<params_.warps_; ++w)
+    {
+      if (lk) {
+        brip_flow_products_body pb;
+        pb.image0 = &im0; pb.image1 = &im1;
+        pb.gx = &pyr0.gx[l]; pb.gy = &pyr0.gy[l];
+        pb.vx = &u; pb.vy = &v;
+        pb.px = &px; pb.py = &py; pb.pxy = VXL_NULLPTR;
+        pb.tensor = false;
+        vpl_parallel_for(nj, pb, nt, brip_flow_grain);
+        std::vector<vil_image_view<float> const*> src(2);
+        std::vector<vil_image_view<float>*> dst(2);
+        src[0] = &px; src[1] = &py;
+        dst[0] = &bx; dst[1] = &by;
+        brip_flow_box_mean(src, dst, int(params_.lk_radius_), nt);
+        brip_flow_lk_solve_body sb;
+        sb.sxx = &pyr0.sxx[l]; sb.sxy = &pyr0.sxy[l]; sb.syy = &pyr0.syy[l];
+        sb.bx = &bx; sb.by = &by;
+        sb.vx = &u; sb.vy = &v;
+        sb.min_eigenvalue = params_.lk_min_eigenvalue_;
+        vpl_parallel_for(nj, sb, nt, brip_flow_grain);
+        continue;
+      }
+      // Horn-Schunck: the residual at the flow of this warp, then Jacobi iterations
+      brip_flow_residual_body rb;
+      rb.image0 = &im0; rb.image1 = &im1;
+      rb.gx = &pyr0.gx[l]; rb.gy = &pyr0.gy[l];
+      rb.gx1 = &pyr1.gx[l]; rb.gy1 = &pyr1.gy[l];
+      rb.vx = &u; rb.vy = &v;
+      it.set_size(ni, nj);
+      rb.it = &it; rb.mgx = &px; rb.mgy = &py;
+      vpl_parallel_for(nj, rb, nt, brip_flow_grain);
+      u0.deep_copy(u);
+      v0.deep_copy(v);
+      u1.set_size(ni, nj);
+      v1.set_size(ni, nj);
+      brip_flow_hs_body hb;
+      hb.gx = &px; hb.gy = &py;
+      hb.it = &it;
+      hb.u0 = &u0; hb.v0 = &v0;
+      hb.alpha = params_.hs_alpha_;
+      for (unsigned k = 0; k<params_.hs_iterations_; ++k) {
+        hb.u_in = &u; hb.v_in = &v;
+        hb.u_out = &u1; hb.v_out = &v1;
+        vpl_parallel_for(nj, hb, nt, brip_flow_grain);
+        std::swap(u, u1);
+        std::swap(v, v1);
+      }
+    }
+    cu = u;
+    cv = v;
+  }
+  vx = u;
+  vy = v;
+}
+
+void brip_optical_flow::compute(vil_image_view<float> const& frame0,
+                                vil_image_view<float> const& frame1,
+                                vil_image_view<float>& vx, vil_image_view<float>& vy)
+{
+  assert(frame0.ni() == frame1.ni() && frame0.nj() == frame1.nj());
+  frame_pyramid pyr0, pyr1;
+  build_pyramid(frame0, pyr0);
+  build_pyramid(frame1, pyr1);
+  flow(pyr0, pyr1, vx, vy);
+}
+
+bool brip_optical_flow::add_frame(vil_image_view<float> const& frame,
+                                  vil_image_view<float>& vx, vil_image_view<float>& vy)
+{
+  // the pyramid of this frame is built in the buffers of the frame before last
+  const int next = last_ == 0 ? 1 : 0;
+  build_pyramid(frame, pyramids_[next]);
+  bool ok = last_ >= 0 &&
+            pyramids_[last_].images(0).ni() == frame.ni() &&
+            pyramids_[last_].images(0).nj() == frame.nj();
+  if (ok)
+    flow(pyramids_[last_], pyramids_[next], vx, vy);
+  last_ = next;
+  return ok;
+}
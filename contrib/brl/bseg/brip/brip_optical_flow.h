@@ -0,0 +1,120 @@
+// This is brl/bseg/brip/brip_optical_flow.h
+#ifndef brip_optical_flow_h_
+#define brip_optical_flow_h_
+//:
+// \file
+// \brief Coarse to fine Lucas-Kanade and Horn-Schunck optical flow on Gaussian pyramids
+//
+// brip_vil_float_ops::Lucas_KanadeMotion and Horn_SchunckMotion work at a
+// single resolution, so they only recover motions of about a pixel.
+// brip_optical_flow estimates the flow on a Gaussian pyramid of each frame,
+// from the coarsest level to the finest.  The flow of each level is doubled
+// and interpolated to start the next, and the second frame is warped by the
+// current flow (bilinear interpolation) before each refinement, so the
+// refinements only solve for the residual motion.
+//
+// The gradients of the first frame, and for Lucas-Kanade the window means
+// of their products (the structure tensor), are computed once per level and
+// kept fixed while the second frame is warped and the flow refined.  All the
+// image passes work on contiguous rows and are spread over threads by rows;
+// the result does not depend on the number of threads.
+//
+// For video, add_frame() keeps the pyramid of the last frame, so each frame
+// is reduced and differentiated only once although it takes part in two
+// consecutive pairs.
+//
+// The flow (vx, vy) at pixel (i,j) of frame0 is the displacement to the
+// matching point of frame1: frame1(i+vx, j+vy) ~ frame0(i,j).  Frames have
+// one plane.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <vil/vil_image_view.h>
+#include <vil/vil_pyramid_image_view.h>
+#include <vcl_compiler.h>
+
+//: Parameters of brip_optical_flow
+struct brip_optical_flow_params
+{
+  enum method_type { LUCAS_KANADE, HORN_SCHUNCK };
+
+  brip_optical_flow_params(method_type method = LUCAS_KANADE)
+  : method_(method), max_levels_(6), min_level_size_(16), warps_(3),
+    lk_radius_(2), lk_min_eigenvalue_(1e-4f),
+    hs_alpha_(1.0f), hs_iterations_(40), num_threads_(0) {}
+
+  method_type method_;
+  //: maximum number of pyramid levels, including the full resolution
+  unsigned max_levels_;
+  //: no level is smaller than this in either dimension (unless the frame is)
+  unsigned min_level_size_;
+  //: number of times the flow is refined at each level, warping frame1 each time
+  unsigned warps_;
+  //: Lucas-Kanade sums over (2*lk_radius_+1)^2 windows
+  unsigned lk_radius_;
+  //: Lucas-Kanade leaves the flow unchanged where the smaller eigenvalue of the mean structure tensor is below this (squared intensity gradient units)
+  float lk_min_eigenvalue_;
+  //: Horn-Schunck smoothness weight, in squared intensity gradient units (1 suits a 0-255 range)
+  float hs_alpha_;
+  //: Horn-Schunck Jacobi iterations after each warp
+  unsigned hs_iterations_;
+  //: number of threads (0 = one per processor)
+  unsigned num_threads_;
+};
+
+class brip_optical_flow
+{
+ public:
+  brip_optical_flow(brip_optical_flow_params const& params = brip_optical_flow_params());
+
+  brip_optical_flow_params const& params() const { return params_; }
+
+  //: The flow from frame0 to frame1, which must have the same size
+  void compute(vil_image_view<float> const& frame0,
+               vil_image_view<float> const& frame1,
+               vil_image_view<float>& vx, vil_image_view<float>& vy);
+
+  //: The flow from the previous frame of a stream to this one
+  //  Returns false, leaving vx and vy unchanged, for the first frame and for
+  //  a frame whose size differs from the previous one.
+  bool add_frame(vil_image_view<float> const& frame,
+                 vil_image_view<float>& vx, vil_image_view<float>& vy);
+
+  //: Forget the previous frame of the stream
+  void reset() { last_ = -1; }
+
+  //: Number of pyramid levels used for frames of size ni x nj
+  unsigned n_levels(unsigned ni, unsigned nj) const;
+
+  //: Gaussian pyramid of the last frame given to add_frame()
+  vil_pyramid_image_view<float>& last_pyramid() { return pyramids_[last_ < 0 ? 0 : last_].images; }
+
+ private:
+  //: The pyramid of a frame and, once it is the first of a pair, its gradients
+  struct frame_pyramid
+  {
+    frame_pyramid() : has_gradients(false) {}
+
+    vil_pyramid_image_view<float> images;
+    bool has_gradients;
+    std::vector<vil_image_view<float> > gx, gy;
+    //: window means of gx*gx, gx*gy and gy*gy (Lucas-Kanade only)
+    std::vector<vil_image_view<float> > sxx, sxy, syy;
+  };
+
+  void build_pyramid(vil_image_view<float> const& frame, frame_pyramid& pyr) const;
+  void compute_gradients(frame_pyramid& pyr) const;
+  void flow(frame_pyramid& pyr0, frame_pyramid& pyr1,
+            vil_image_view<float>& vx, vil_image_view<float>& vy) const;
+
+  brip_optical_flow_params params_;
+  //: the pyramids of the last two frames of a stream, so their buffers are reused
+  frame_pyramid pyramids_[2];
+  //: index of the pyramid of the last frame, -1 before the first frame
+  int last_;
+};
+
+#endif // brip_optical_flow_h_
@@ -0,0 +1,181 @@
+// This is brl/bseg/brip/brip_sliding_histogram.cxx
+#include <cmath>
+#include "brip_sliding_histogram.h"
+//:
+// \file
+#include <vcl_cassert.h>
+#include <vnl/vnl_math.h>
+
+brip_sliding_histogram::brip_sliding_histogram(float range, unsigned nbins)
+  : min_(0.0f), max_(range), delta_(0.0f), nbins_(nbins),
+    i_radius_(0), j_radius_(0), row_(-1), col_(-1)
+{
+  this->init();
+}
+
+brip_sliding_histogram::brip_sliding_histogram(float min, float max,
+                                               unsigned nbins)
+  : min_(min), max_(max), delta_(0.0f), nbins_(nbins),
+    i_radius_(0), j_radius_(0), row_(-1), col_(-1)
+{
+  this->init();
+}
+
+void brip_sliding_histogram::init()
+{
+  if (nbins_ == 0)
+    return;
+  delta_ = (max_-min_)/nbins_;
+  edges_.resize(nbins_);
+  for (unsigned b = 0; b<nbins_; ++b)
+    edges_[b] = float((b+1)*delta_) + min_;
+  hist_.resize(nbins_, 0.0);
+}
+
+int brip_sliding_histogram::bin(float x) const
+{
+  // the negated test also rejects NaN
+  if (!(x>=min_ && x<=max_) || nbins_ == 0)
+    return -1;
+  // guess from the bin width, then settle on the first bin whose upper
+  // edge is not below x, which is the bin bsta_histogram::upcount picks
+  int b = delta_ > 0.0f ? static_cast<int>((x-min_)/delta_) : 0;
+  int nb = static_cast<int>(nbins_);
+  if (b >= nb) b = nb-1;
+  if (b < 0) b = 0;
+  while (b>0 && edges_[b-1] >= x)
+    --b;
+  while (b<nb && edges_[b] < x)
+    ++b;
+  return b<nb ? b : -1;
+}
+
+void brip_sliding_histogram::set_image(vil_image_view<float> const& values,
+                                       unsigned i_radius, unsigned j_radius)
+{
+  this->set_image(values, vil_image_view<float>(), i_radius, j_radius);
+}
+
+void brip_sliding_histogram::set_image(vil_image_view<float> const& values,
+                                       vil_image_view<float> const& weights,
+                                       unsigned i_radius, unsigned j_radius)
+{
+  unsigned ni = values.ni(), nj = values.nj();
+  assert(!weights || (weights.ni() == ni && weights.nj() == nj));
+  bins_.set_size(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      bins_(i,j) = this->bin(values(i,j));
+  weights_ = weights;
+  i_radius_ = i_radius;
+  j_radius_ = j_radius;
+  col_hist_.assign(ni*nbins_, 0.0);
+  hist_.assign(nbins_, 0.0);
+  row_ = -1;
+  col_ = -1;
+}
+
+//: add (sign = 1) or remove (sign = -1) row j of every column histogram
+void brip_sliding_histogram::update_column(unsigned i, unsigned j, double sign)
+{
+  int b = bins_(i,j);
+  if (b < 0)
+    return;
+  col_hist_[i*nbins_ + b] += weights_ ? sign*weights_(i,j) : sign;
+}
+
+void brip_sliding_histogram::set_row(unsigned j)
+{
+  unsigned ni = bins_.ni();
+  unsigned r = j_radius_;
+  if (row_ >= 0 && j > unsigned(row_) && j-unsigned(row_) <= 2*r+1)
+  {
+    // slide down: one row out and one row in for each step
+    for (unsigned jj = unsigned(row_)+1; jj<=j; ++jj)
+      for (unsigned i = 0; i<ni; ++i)
+      {
+        this->update_column(i, jj-r-1, -1.0);
+        this->update_column(i, jj+r, 1.0);
+      }
+  }
+  else
+  {
+    col_hist_.assign(ni*nbins_, 0.0);
+    for (unsigned jj = j-r; jj<=j+r; ++jj)
+      for (unsigned i = 0; i<ni; ++i)
+        this->update_column(i, jj, 1.0);
+  }
+  row_ = static_cast<int>(j);
+  col_ = -1;
+}
+
+void brip_sliding_histogram::set_col(unsigned i)
+{
+  unsigned r = i_radius_;
+  if (col_ >= 0 && i > unsigned(col_) && i-unsigned(col_) <= 2*r+1)
+  {
+    // slide right: subtract the column leaving the window, add the one entering
+    for (unsigned ii = unsigned(col_)+1; ii<=i; ++ii)
+    {
+      double const* out = &col_hist_[(ii-r-1)*nbins_];
+      double const* in = &col_hist_[(ii+r)*nbins_];
+      for (unsigned b = 0; b<nbins_; ++b)
+        hist_[b] += in[b] - out[b];
+    }
+  }
+  else
+  {
+    hist_.assign(nbins_, 0.0);
+    for (unsigned ii = i-r; ii<=i+r; ++ii)
+    {
+      double const* in = &col_hist_[ii*nbins_];
+      for (unsigned b = 0; b<nbins_; ++b)
+        hist_[b] += in[b];
+    }
+  }
+  col_ = static_cast<int>(i);
+}
+
+void brip_sliding_histogram::move_to(unsigned i, unsigned j)
+{
+  if (row_ != static_cast<int>(j))
+    this->set_row(j);
+  if (col_ != static_cast<int>(i))
+    this->set_col(i);
+}
+
+double brip_sliding_histogram::area() const
+{
+  double area = 0.0;
+  for (unsigned b = 0; b<nbins_; ++b)
+    area += hist_[b];
+  return area;
+}
+
+float brip_sliding_histogram::entropy() const
+{
+  double area = this->area();
+  if (area <= 0.0)
+    return 0.0f;
+  double ent = 0.0;
+  for (unsigned b = 0; b<nbins_; ++b)
+  {
+    double p = hist_[b]/area;
+    if (p>0.0)
+      ent -= p*std::log(p);
+  }
+  return float(ent*vnl_math::log2e);
+}
+
+float brip_sliding_histogram::median() const
+{
+  double half = 0.5*this->area(), sum = 0.0;
+  unsigned b = 0;
+  for (; b+1<nbins_; ++b)
+  {
+    sum += hist_[b];
+    if (sum >= half)
+      break;
+  }
+  return min_ + (b+0.5f)*delta_;
+}
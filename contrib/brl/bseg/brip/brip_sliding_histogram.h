@@ -0,0 +1,99 @@
+// This is brl/bseg/brip/brip_sliding_histogram.h
+#ifndef brip_sliding_histogram_h_
+#define brip_sliding_histogram_h_
+//:
+// \file
+// \brief The histogram of a window sliding over an image, updated in constant time
+//
+// The histogram of the (2*i_radius+1) x (2*j_radius+1) window centred on a
+// pixel is maintained as in Perreault and Hebert's constant time median
+// filter: a histogram is kept for every image column over the rows of the
+// window.  Moving the window down a row updates each column histogram by one
+// pixel out and one pixel in, and moving it along the row adds one column
+// histogram and subtracts another.  The cost per window is thus independent
+// of the radius; only the number of bins matters.
+//
+// The bins are those of bsta_histogram<float>, so entropy() agrees with
+// bsta_histogram::entropy() for the same window.  Each pixel may carry a
+// weight (e.g. gradient magnitude) instead of a unit count.
+//
+// Windows are visited with move_to(i, j).  Visiting them row by row, left to
+// right, with increasing j gives the constant time updates; any other move
+// rebuilds the histogram.  There is no bounds check: the window must lie
+// inside the image.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <vil/vil_image_view.h>
+#include <vcl_compiler.h>
+
+class brip_sliding_histogram
+{
+ public:
+  //: nbins bins over [0, range]
+  brip_sliding_histogram(float range, unsigned nbins);
+
+  //: nbins bins over [min, max]
+  brip_sliding_histogram(float min, float max, unsigned nbins);
+
+  //: The image to histogram with unit count per pixel, and the window radii
+  void set_image(vil_image_view<float> const& values,
+                 unsigned i_radius, unsigned j_radius);
+
+  //: The image to histogram, the weight of each pixel and the window radii
+  void set_image(vil_image_view<float> const& values,
+                 vil_image_view<float> const& weights,
+                 unsigned i_radius, unsigned j_radius);
+
+  //: Centre the window on pixel (i,j)
+  void move_to(unsigned i, unsigned j);
+
+  //: Bin of value x, -1 if x is outside the histogram range
+  int bin(float x) const;
+
+  //: Number of bins
+  unsigned nbins() const { return nbins_; }
+
+  //: The (weighted) count of a bin in the current window
+  double count(unsigned bin) const { return hist_[bin]; }
+
+  //: Total count of the current window
+  double area() const;
+
+  //: Entropy of the current window in bits
+  float entropy() const;
+
+  //: Centre value of the bin that holds the median of the current window
+  float median() const;
+
+ private:
+  float min_;
+  float max_;
+  float delta_;
+  unsigned nbins_;
+  //: upper edge of each bin, computed as bsta_histogram does
+  std::vector<float> edges_;
+  //: bin of each pixel, -1 for values outside the range
+  vil_image_view<int> bins_;
+  //: pixel weights, empty for unit counts
+  vil_image_view<float> weights_;
+  unsigned i_radius_;
+  unsigned j_radius_;
+  //: per column histograms of the window rows, nbins_ entries per column
+  std::vector<double> col_hist_;
+  //: histogram of the current window
+  std::vector<double> hist_;
+  //: centre of the current window, -1 if not set
+  int row_;
+  int col_;
+
+  void init();
+  void update_column(unsigned i, unsigned j, double sign);
+  void set_row(unsigned j);
+  void set_col(unsigned i);
+};
+
+#endif // brip_sliding_histogram_h_
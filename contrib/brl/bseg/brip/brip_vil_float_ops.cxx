@@ -37,6 +37,8 @@
 #include <bsta/bsta_histogram.h>
 #include <bsta/bsta_joint_histogram.h>
 #include <brip/brip_roi.h>
+#include <brip/brip_integral_image.h>
+#include <brip/brip_sliding_histogram.h>
 
 // === Local utility functions ===
 
@@ -822,21 +824,14 @@ brip_vil_float_ops::grad_matrix_NxN(vil_image_view<float> const& input,
   output.set_size(w,h);
   brip_vil_float_ops::gradient_3x3(input, grad_x, grad_y);
   vul_timer t;
+  // the window sums come from summed area tables, so the cost is independent of n
+  brip_integral_image sxx(grad_x, grad_x), sxy(grad_x, grad_y), syy(grad_y, grad_y);
   for (int y = ni; y<h-ni;y++)
     for (int x = ni; x<w-ni;x++)
     {
-      float xx=0, xy=0, yy=0;
-      for (int i = -ni; i<=ni; i++)
-        for (int j = -ni; j<=ni; j++)
-        {
-          float gx = grad_x(x+i, y+j), gy = grad_y(x+i, y+j);
-          xx += gx*gx;
-          xy += gx*gy;
-          yy += gy*gy;
-        }
-      IxIx(x,y) = xx/(float)N;
-      IxIy(x,y) = xy/(float)N;
-      IyIy(x,y) = yy/(float)N;
+      IxIx(x,y) = float(sxx.window_sum(x, y, n, n)/N);
+      IxIy(x,y) = float(sxy.window_sum(x, y, n, n)/N);
+      IyIy(x,y) = float(syy.window_sum(x, y, n, n)/N);
     }
   brip_vil_float_ops::fill_x_border(IxIx, ni, 0.0f);
   brip_vil_float_ops::fill_y_border(IxIx, ni, 0.0f);
@@ -853,14 +848,18 @@ vil_image_view<float> brip_vil_float_ops::
 trace_grad_matrix_NxN(vil_image_view<float> const& input, unsigned n)
 {
   unsigned ni = input.ni(), nj = input.nj();
-  vil_image_view<float> IxIx;
-  vil_image_view<float> IxIy;
-  vil_image_view<float> IyIy;
+  double N = (2*n+1)*(2*n+1);
+  vil_image_view<float> grad_x, grad_y;
   vil_image_view<float> tr;
-  IxIx.set_size(ni, nj);   IxIy.set_size(ni, nj);   IyIy.set_size(ni, nj);
+  grad_x.set_size(ni, nj);   grad_y.set_size(ni, nj);
   tr.set_size(ni, nj);
-  brip_vil_float_ops::grad_matrix_NxN(input, n, IxIx, IxIy, IyIy);
-  vil_math_image_sum<float, float, float>(IxIx, IyIy, tr);
+  tr.fill(0.0f);
+  brip_vil_float_ops::gradient_3x3(input, grad_x, grad_y);
+  // only the diagonal of the gradient matrix is needed
+  brip_integral_image sxx(grad_x, grad_x), syy(grad_y, grad_y);
+  for (unsigned y = n; y+n<nj; ++y)
+    for (unsigned x = n; x+n<ni; ++x)
+      tr(x,y) = float((sxx.window_sum(x, y, n, n) + syy.window_sum(x, y, n, n))/N);
   return tr;
 }
 
@@ -910,20 +909,15 @@ brip_vil_float_ops::sqrt_grad_singular_values(vil_image_view<float>& input,
   output.set_size(w,h);
   brip_vil_float_ops::gradient_3x3(input, grad_x, grad_y);
   vul_timer t;
+  brip_integral_image sxx(grad_x, grad_x), sxy(grad_x, grad_y), syy(grad_y, grad_y);
   for (int y = n; y<h-n;y++)
     for (int x = n; x<w-n;x++)
     {
-      float IxIx=0, IxIy=0, IyIy=0;
-      for (int i = -n; i<=n; i++)
-        for (int j = -n; j<=n; j++)
-        {
-          float gx = grad_x(x+i, y+j), gy = grad_y(x+i, y+j);
-          IxIx += gx*gx;
-          IxIy += gx*gy;
-          IyIy += gy*gy;
-        }
-      float det = (IxIx*IyIy-IxIy*IxIy)/(float)N;
-      output(x,y)=std::sqrt(std::fabs(det));
+      double IxIx = sxx.window_sum(x, y, n, n);
+      double IxIy = sxy.window_sum(x, y, n, n);
+      double IyIy = syy.window_sum(x, y, n, n);
+      double det = (IxIx*IyIy-IxIy*IxIy)/N;
+      output(x,y)=float(std::sqrt(std::fabs(det)));
     }
   brip_vil_float_ops::fill_x_border(output, n, 0.0f);
   brip_vil_float_ops::fill_y_border(output, n, 0.0f);
@@ -3299,11 +3293,19 @@ brip_vil_float_ops::entropy(const unsigned i_radius,
   unsigned ni = img->ni(), nj = img->nj();
   ent.set_size(ni/step+1, nj/step+1);
   ent.fill(0.0f);
+  // The window histograms slide over the image (see brip_sliding_histogram),
+  // with the same bins as entropy_i, entropy_g and entropy_hs
   if (intensity)
+  {
+    brip_sliding_histogram hi(255.0f, bins);
+    hi.set_image(gimage, i_radius, j_radius);
     for (unsigned j = j_radius; j<(nj-j_radius); j+=step)
       for (unsigned i = i_radius; i<(ni-i_radius); i+=step)
-        ent(i/step,j/step) =
-          brip_vil_float_ops::entropy_i(i, j, i_radius, j_radius, gimage, 255.0f, bins);
+      {
+        hi.move_to(i, j);
+        ent(i/step,j/step) = hi.entropy();
+      }
+  }
 
   if (gradient)
   {
@@ -3311,22 +3313,38 @@ brip_vil_float_ops::entropy(const unsigned i_radius,
     grad_x.set_size(ni, nj);
     grad_y.set_size(ni, nj);
     brip_vil_float_ops::gradient_3x3 (gimage , grad_x , grad_y);
+    // gradient direction weighted by magnitude, as in entropy_g
+    static const float deg_rad = (float)(vnl_math::deg_per_rad);
+    vil_image_view<float> ang(ni, nj), mag(ni, nj);
+    for (unsigned j = 0; j<nj; ++j)
+      for (unsigned i = 0; i<ni; ++i)
+      {
+        float Ix = grad_x(i,j), Iy = grad_y(i,j);
+        ang(i,j) = deg_rad*std::atan2(Iy, Ix) + 180.0f;
+        mag(i,j) = std::abs(Ix)+std::abs(Iy);
+      }
+    brip_sliding_histogram hg(360.0f, 8);
+    hg.set_image(ang, mag, i_radius, j_radius);
     for (unsigned j = j_radius; j<(nj-j_radius); j+=step)
       for (unsigned i = i_radius; i<(ni-i_radius); i+=step)
-        ent(i/step,j/step) +=
-          brip_vil_float_ops::entropy_g(i, j, i_radius, j_radius,
-                                        grad_x, grad_y);
+      {
+        hg.move_to(i, j);
+        ent(i/step,j/step) += hg.entropy();
+      }
   }
   if (ihs&&img->nplanes()==3)
   {
     vil_image_view<float> inten, hue, sat;
     vil_image_view<vil_rgb<vxl_byte> > cimage = img->get_view();
     brip_vil_float_ops::convert_to_IHS(cimage, inten, hue, sat);
+    brip_sliding_histogram hh(360.0f, 8);
+    hh.set_image(hue, sat, i_radius, j_radius);
     for (unsigned j = j_radius; j<(nj-j_radius); j+=step)
       for (unsigned i = i_radius; i<(ni-i_radius); i+=step)
-        ent(i/step,j/step) +=
-          brip_vil_float_ops::entropy_hs(i, j, i_radius, j_radius,
-                                         hue, sat);
+      {
+        hh.move_to(i, j);
+        ent(i/step,j/step) += hh.entropy();
+      }
   }
   return ent;
 }
@@ -3906,6 +3924,40 @@ void brip_vil_float_ops::gaussian_kernel_square_mask(float lambda, vbl_array_2d<
 }
 
 
+//: a non-zero kernel coefficient at offset (i,j) from the kernel centre
+struct brip_kernel_tap
+{
+  int i, j;
+  float w;
+};
+
+//: The non-zero coefficients (squared or absolute) of a kernel.
+//  Returns true if the kernel is a box, i.e. all the coefficients are
+//  non-zero and equal, so that window sums can replace the taps.
+static bool brip_kernel_taps(vbl_array_2d<float> const& kernel, bool square,
+                             std::vector<brip_kernel_tap>& taps)
+{
+  int rrad = (int(kernel.rows())-1)/2, crad = (int(kernel.cols())-1)/2;
+  taps.clear();
+  bool constant = true;
+  for (int r = 0; r<=2*rrad; ++r)
+    for (int c = 0; c<=2*crad; ++c)
+    {
+      float k = kernel[r][c];
+      brip_kernel_tap t;
+      t.i = c-crad; t.j = r-rrad;
+      t.w = square ? k*k : std::abs(k);
+      if (t.w == 0.0f) {
+        constant = false;
+        continue;
+      }
+      if (!taps.empty() && t.w != taps[0].w)
+        constant = false;
+      taps.push_back(t);
+    }
+  return constant;
+}
+
 // Compute the standard deviation of an operator response
 // given the image intensity standard deviation at each pixel
 vil_image_view<float> brip_vil_float_ops::
@@ -3921,21 +3973,27 @@ std_dev_operator(vil_image_view<float> const& sd_image,
   vil_image_view<float> res(ni, nj);
   res.fill(sd_max);
 
-  vbl_array_2d<float>ksq(nrows, ncols);
-  for (unsigned r = 0; r<nrows; ++r)
-    for (unsigned c = 0; c<ncols; ++c)
-      ksq[r][c] = kernel[r][c]*kernel[r][c];
+  vil_image_view<float> sd_sq(ni, nj);
+  vil_math_image_product(sd_image, sd_image, sd_sq);
 
+  std::vector<brip_kernel_tap> taps;
+  bool constant = brip_kernel_taps(kernel, true, taps);
+  if (constant)
+  {
+    // a box kernel: the window sums come from a summed area table
+    brip_integral_image ssq(sd_sq);
+    double w = taps.empty() ? 0.0 : taps[0].w;
+    for (int j = rrad; j<static_cast<int>(nj-rrad); ++j)
+      for (int i = crad; i<static_cast<int>(ni-crad); ++i)
+        res(i,j) = float(std::sqrt(std::fabs(w*ssq.window_sum(i, j, crad, rrad))));
+    return res;
+  }
   for (int j = rrad; j<static_cast<int>(nj-rrad); ++j)
     for (int i = crad; i<static_cast<int>(ni-crad); ++i)
     {
       float sum = 0;
-      for (int jj = -rrad; jj<=rrad; ++jj)
-        for (int ii = -crad; ii<=crad; ++ii) {
-          float sd_sq = sd_image(i+ii, j+jj);
-          sd_sq *= sd_sq;
-          sum += sd_sq*ksq[jj+rrad][ii+crad];
-        }
+      for (std::vector<brip_kernel_tap>::const_iterator t = taps.begin(); t != taps.end(); ++t)
+        sum += sd_sq(i+t->i, j+t->j)*t->w;
       res(i,j) = std::sqrt(sum);
     }
   return res;
@@ -3957,15 +4015,23 @@ std_dev_operator_method2(vil_image_view<float> const& sd_image,
   vil_image_view<float> res(ni, nj);
   res.fill(sd_max);
 
+  std::vector<brip_kernel_tap> taps;
+  bool constant = brip_kernel_taps(kernel, false, taps);
+  if (constant)
+  {
+    brip_integral_image s(sd_image);
+    double w = taps.empty() ? 0.0 : taps[0].w;
+    for (int j = rrad; j<static_cast<int>(nj-rrad); ++j)
+      for (int i = crad; i<static_cast<int>(ni-crad); ++i)
+        res(i,j) = float(w*s.window_sum(i, j, crad, rrad));
+    return res;
+  }
   for (int j = rrad; j<static_cast<int>(nj-rrad); ++j)
     for (int i = crad; i<static_cast<int>(ni-crad); ++i)
     {
       float sum = 0;
-      for (int jj = -rrad; jj<=rrad; ++jj)
-        for (int ii = -crad; ii<=crad; ++ii) {
-          float sd = sd_image(i+ii, j+jj);
-          sum += (float)(sd*std::abs(kernel[jj+rrad][ii+crad]));
-        }
+      for (std::vector<brip_kernel_tap>::const_iterator t = taps.begin(); t != taps.end(); ++t)
+        sum += sd_image(i+t->i, j+t->j)*t->w;
       res(i,j) = sum;
     }
   return res;
@@ -19,6 +19,9 @@
 //   Dec 11 2011 - Peter Vanroose - replaced all unsigned char by vxl_byte
 //                                  (before there was a mix of the two)
 //                                  and all unsigned short by vxl_uint_16
+//   Oct 2026 - the gradient matrix, std_dev_operator and entropy operators use
+//              summed area tables and sliding histograms, so their cost does
+//              not grow with the window radius
 // \endverbatim
 //
 //-----------------------------------------------------------------------------
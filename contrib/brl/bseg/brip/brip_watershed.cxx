@@ -1,5 +1,6 @@
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include "brip_watershed.h"
 //:
 // \file
@@ -8,7 +9,9 @@
 #include <vnl/vnl_math.h>
 #include <vgl/vgl_point_2d.h>
 #include <vil1/vil1_rgb.h>
+#include <vil/vil_image_view.h>
 #include "brip_vil1_float_ops.h"
+#include "brip_bucket_watershed.h"
 
 //Define 8-connected neighbors
 static int n_col[8]={-1, 0, 1,-1,1,-1,0,1};
@@ -325,6 +328,67 @@ bool brip_watershed::compute_regions()
   return true;
 }
 
+bool brip_watershed::compute_regions_bucket_queue(unsigned n_levels)
+{
+  if (n_levels < 2 || n_levels > 65536)
+  {
+    std::cout << "In brip_watershed::compute_regions_bucket_queue() - n_levels out of range\n";
+    return false;
+  }
+  if (!compute_seeds())
+  {
+    std::cout << "In brip_watershed::compute_regions_bucket_queue() - no seeds\n";
+    return false;
+  }
+  int w = gradient_mag_image_.width(), h = gradient_mag_image_.height();
+  float max_grad = 0.0f;
+  for (int r = 0; r<h; r++)
+    for (int c = 0; c<w; c++)
+      max_grad = std::max(max_grad, gradient_mag_image_(c,r));
+  float scale = max_grad > 0.0f ? (n_levels-1)/max_grad : 0.0f;
+  vil_image_view<vxl_uint_16> cost(w, h);
+  vil_image_view<unsigned> labels(w, h);
+  for (int r = 0; r<h; r++)
+    for (int c = 0; c<w; c++)
+    {
+      cost(c,r) = static_cast<vxl_uint_16>(gradient_mag_image_(c,r)*scale + 0.5f);
+      labels(c,r) = region_label_array_[r][c];
+    }
+  brip_bucket_watershed flood(eight_connected_, true, BOUNDARY);
+  if (!flood.flood(cost, labels))
+  {
+    std::cout << "In brip_watershed::compute_regions_bucket_queue() - flood failed\n";
+    return false;
+  }
+  for (int r = 0; r<h; r++)
+    for (int c = 0; c<w; c++)
+      region_label_array_[r][c] = labels(c,r);
+
+  //the regions around each boundary pixel are adjacent
+  for (int r = 0; r<h; r++)
+    for (int c = 0; c<w; c++)
+    {
+      if (labels(c,r) != BOUNDARY)
+        continue;
+      unsigned int around[8];
+      int na = 0;
+      for (int n = 0; n<8; n++)
+      {
+        int rn = r+n_row[n], cn = c+n_col[n];
+        if (rn<0||cn<0||rn>=h||cn>=w)
+          continue;
+        unsigned int lab = labels(cn,rn);
+        if (lab>BOUNDARY)
+          around[na++] = lab;
+      }
+      for (int a = 0; a<na; a++)
+        for (int b = 0; b<na; b++)
+          if (around[a]!=around[b])
+            this->add_adjacency(around[a], around[b]);
+    }
+  return true;
+}
+
 //compute a color image with the original monochrome image and green
 //region boundary overlay
 vil1_image brip_watershed::overlay_image()
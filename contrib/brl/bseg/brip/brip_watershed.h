@@ -26,6 +26,8 @@
 // \verbatim
 //  Modifications
 //   Initial version June 18, 2004
+//   Oct 2026 - compute_regions_bucket_queue(), the same seeds flooded by
+//              brip_bucket_watershed on the quantized gradient magnitude
 // \endverbatim
 //
 //-----------------------------------------------------------------------------
@@ -57,6 +59,12 @@ class brip_watershed : public brip_watershed_params
                         std::vector<unsigned int>& adj_regs);
   //: Main process method
   bool compute_regions();
+  //: Grow the regions from the same seeds with a bucket queue flood
+  //  The gradient magnitude is quantized to n_levels (at most 65536) levels
+  //  and flooded by brip_bucket_watershed, which allocates nothing per
+  //  pixel.  Regions and boundaries have the same labels as compute_regions()
+  //  and each pair of regions meeting at a boundary pixel is adjacent.
+  bool compute_regions_bucket_queue(unsigned n_levels = 1024);
   //: Debug methods
   void print_region_array();
   void print_adjacency_map();
@@ -0,0 +1,119 @@
+//:
+// \file
+// \brief Timings of brip_batch_match against a loop that scores one shift at a time
+//        A window of a synthetic image is registered back to the image over
+//        a square search range of shifts.  The per shift loop crops the
+//        overlapping views and calls brip_mutual_info, or sums the NCC
+//        moments directly, as the registration searches do today.
+//        Usage: brip_batch_match_timings [width [height [search_radius [n_threads]]]]
+
+#include <iostream>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include <brip/brip_batch_match.h>
+#include <brip/brip_mutual_info.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_crop.h>
+#include <vnl/vnl_random.h>
+#include <vul/vul_timer.h>
+#include <vcl_compiler.h>
+
+static void overlap(int n0, int n1, int d, int& lo, int& hi)
+{
+  lo = std::max(0, -d);
+  hi = std::min(n0, n1-d);
+}
+
+static double loop_ncc(vil_image_view<float> const& a, vil_image_view<float> const& b, int du, int dv)
+{
+  int i0, i1, j0, j1;
+  overlap(a.ni(), b.ni(), du, i0, i1);
+  overlap(a.nj(), b.nj(), dv, j0, j1);
+  double n = 0, s0 = 0, s1 = 0, s00 = 0, s11 = 0, s01 = 0;
+  for (int j = j0; j<j1; ++j)
+    for (int i = i0; i<i1; ++i) {
+      double v0 = a(i,j), v1 = b(i+du, j+dv);
+      n += 1; s0 += v0; s1 += v1; s00 += v0*v0; s11 += v1*v1; s01 += v0*v1;
+    }
+  if (n == 0)
+    return 0.0;
+  double v0 = s00-s0*s0/n, v1 = s11-s1*s1/n;
+  return (v0 <= 0 || v1 <= 0) ? 0.0 : (s01-s0*s1/n)/std::sqrt(v0*v1);
+}
+
+static double loop_mi(vil_image_view<float> const& a, vil_image_view<float> const& b, int du, int dv)
+{
+  int i0, i1, j0, j1;
+  overlap(a.ni(), b.ni(), du, i0, i1);
+  overlap(a.nj(), b.nj(), dv, j0, j1);
+  if (i0 >= i1 || j0 >= j1)
+    return 0.0;
+  vil_image_view<float> va = vil_crop(a, i0, i1-i0, j0, j1-j0);
+  vil_image_view<float> vb = vil_crop(b, i0+du, i1-i0, j0+dv, j1-j0);
+  return brip_mutual_info(va, vb, 0.0, 255.0, 16);
+}
+
+static void report(char const* what, long msecs, std::vector<double> const& scores,
+                   std::vector<vgl_vector_2d<int> > const& shifts)
+{
+  unsigned best = std::max_element(scores.begin(), scores.end()) - scores.begin();
+  std::cout << what << ": " << msecs << " ms, best shift ("
+            << shifts[best].x() << ',' << shifts[best].y() << ")\n";
+}
+
+int main(int argc, char* argv[])
+{
+  int sx = argc > 1 ? std::atoi(argv[1]) : 256;
+  int sy = argc > 2 ? std::atoi(argv[2]) : 256;
+  int radius = argc > 3 ? std::atoi(argv[3]) : 16;
+  unsigned nthreads = argc > 4 ? std::atoi(argv[4]) : 0;
+
+  vnl_random rng(4451);
+  vil_image_view<float> image1(sx + 2*radius, sy + 2*radius), image0(sx, sy);
+  for (unsigned j = 0; j<image1.nj(); ++j)
+    for (unsigned i = 0; i<image1.ni(); ++i)
+      image1(i,j) = float(120.0 + 50.0*std::sin(0.3*i+0.1*j)*std::cos(0.25*j) + rng.normal()*15.0);
+  for (int j = 0; j<sy; ++j)
+    for (int i = 0; i<sx; ++i)
+      image0(i,j) = image1(i+radius+3, j+radius-2) + float(rng.normal()*2.0);
+
+  std::vector<vgl_vector_2d<int> > shifts;
+  for (int dv = 0; dv<=2*radius; ++dv)
+    for (int du = 0; du<=2*radius; ++du)
+      shifts.push_back(vgl_vector_2d<int>(du, dv));
+  std::cout << "image " << sx << 'x' << sy << ", " << shifts.size() << " shifts\n";
+
+  std::vector<double> scores(shifts.size());
+  vul_timer timer;
+  for (unsigned k = 0; k<shifts.size(); ++k)
+    scores[k] = loop_ncc(image0, image1, shifts[k].x(), shifts[k].y());
+  report("NCC, one shift at a time", timer.real(), scores, shifts);
+
+  brip_batch_match one(image0, image1, 1), all(image0, image1, nthreads);
+  one.set_ncc_method(brip_batch_match::DIRECT);
+  all.set_ncc_method(brip_batch_match::DIRECT);
+  timer.mark();
+  one.ncc(shifts, scores);
+  report("NCC batch, direct, 1 thread", timer.real(), scores, shifts);
+  timer.mark();
+  all.ncc(shifts, scores);
+  report("NCC batch, direct, all threads", timer.real(), scores, shifts);
+  all.set_ncc_method(brip_batch_match::FFT);
+  timer.mark();
+  all.ncc(shifts, scores);
+  report("NCC batch, FFT", timer.real(), scores, shifts);
+
+  timer.mark();
+  for (unsigned k = 0; k<shifts.size(); ++k)
+    scores[k] = loop_mi(image0, image1, shifts[k].x(), shifts[k].y());
+  report("MI, one shift at a time", timer.real(), scores, shifts);
+  timer.mark();
+  one.mutual_info(shifts, scores, 0.0, 255.0, 16);
+  report("MI batch, 1 thread", timer.real(), scores, shifts);
+  timer.mark();
+  all.mutual_info(shifts, scores, 0.0, 255.0, 16);
+  report("MI batch, all threads", timer.real(), scores, shifts);
+  return 0;
+}
@@ -0,0 +1,131 @@
+// This is brl/bseg/brip/tests/test_batch_match.cxx
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_crop.h>
+#include <vnl/vnl_random.h>
+#include <vnl/vnl_matrix_fixed.h>
+#include <brip/brip_batch_match.h>
+#include <brip/brip_mutual_info.h>
+
+//: direct NCC of image0(i,j) against image1(i+du, j+dv)
+static double reference_ncc(vil_image_view<float> const& a, vil_image_view<float> const& b, int du, int dv)
+{
+  double n = 0, s0 = 0, s1 = 0, s00 = 0, s11 = 0, s01 = 0;
+  for (int j = 0; j<int(a.nj()); ++j)
+    for (int i = 0; i<int(a.ni()); ++i) {
+      int x = i+du, y = j+dv;
+      if (x<0 || y<0 || x>=int(b.ni()) || y>=int(b.nj()))
+        continue;
+      double v0 = a(i,j), v1 = b(x,y);
+      n += 1; s0 += v0; s1 += v1; s00 += v0*v0; s11 += v1*v1; s01 += v0*v1;
+    }
+  if (n == 0)
+    return 0.0;
+  double v0 = s00-s0*s0/n, v1 = s11-s1*s1/n;
+  return (v0 <= 0 || v1 <= 0) ? 0.0 : (s01-s0*s1/n)/std::sqrt(v0*v1);
+}
+
+//: brip_mutual_info of the views that overlap under the shift, the last column
+//  and row of image1 excluded when bilinear sampling is used
+static double reference_mi(vil_image_view<float> const& a, vil_image_view<float> const& b,
+                           int du, int dv, int border)
+{
+  int i0 = std::max(0, -du), i1 = std::min(int(a.ni()), int(b.ni())-border-du);
+  int j0 = std::max(0, -dv), j1 = std::min(int(a.nj()), int(b.nj())-border-dv);
+  if (i0 >= i1 || j0 >= j1)
+    return 0.0;
+  vil_image_view<float> va = vil_crop(a, i0, i1-i0, j0, j1-j0);
+  vil_image_view<float> vb = vil_crop(b, i0+du, i1-i0, j0+dv, j1-j0);
+  return brip_mutual_info(va, vb, 0.0, 255.0, 16);
+}
+
+static void test_batch_match()
+{
+  // image0 is a noisy window of image1 at offset (7,4)
+  vnl_random rng(77123);
+  vil_image_view<float> image1(60, 50), image0(40, 30);
+  for (unsigned j = 0; j<image1.nj(); ++j)
+    for (unsigned i = 0; i<image1.ni(); ++i)
+      image1(i,j) = float(120.0 + 50.0*std::sin(0.3*i+0.1*j)*std::cos(0.25*j) + rng.normal()*15.0);
+  for (unsigned j = 0; j<image0.nj(); ++j)
+    for (unsigned i = 0; i<image0.ni(); ++i)
+      image0(i,j) = image1(i+7, j+4) + float(rng.normal()*2.0);
+
+  std::vector<vgl_vector_2d<int> > shifts;
+  for (int dv = -31; dv<=52; ++dv)
+    for (int du = -41; du<=62; ++du)
+      shifts.push_back(vgl_vector_2d<int>(du, dv));
+
+  // NCC by direct sums and by FFT, on one and on several threads
+  brip_batch_match bm1(image0, image1, 1), bm3(image0, image1, 3);
+  bm1.set_ncc_method(brip_batch_match::DIRECT);
+  bm3.set_ncc_method(brip_batch_match::DIRECT);
+  std::vector<double> direct1, direct3, fft;
+  bm1.ncc(shifts, direct1);
+  bm3.ncc(shifts, direct3);
+  bm3.set_ncc_method(brip_batch_match::FFT);
+  bm3.ncc(shifts, fft);
+  double err_direct = 0.0, err_fft = 0.0;
+  unsigned best = 0, nrange = 0;
+  for (unsigned k = 0; k<shifts.size(); ++k) {
+    double r = reference_ncc(image0, image1, shifts[k].x(), shifts[k].y());
+    err_direct = std::max(err_direct, std::fabs(direct1[k]-r));
+    // one pixel overlaps have no variance; FFT rounding decides there
+    int ox = std::min(40, 60-shifts[k].x()) - std::max(0, -shifts[k].x());
+    int oy = std::min(30, 50-shifts[k].y()) - std::max(0, -shifts[k].y());
+    if (ox*oy >= 16)
+      err_fft = std::max(err_fft, std::fabs(fft[k]-r));
+    if (std::fabs(direct1[k]) > 1.0 + 1e-9)
+      ++nrange;
+    if (ox*oy >= 100 && direct1[k] > direct1[best])
+      best = k;
+  }
+  TEST_NEAR("Direct NCC", err_direct, 0.0, 1e-6);
+  TEST_NEAR("FFT NCC", err_fft, 0.0, 1e-5);
+  TEST("NCC in [-1, 1]", nrange, 0);
+  TEST("Same NCC on 3 threads", direct1 == direct3, true);
+  TEST("Best NCC shift", shifts[best].x() == 7 && shifts[best].y() == 4, true);
+  TEST("No overlap scores 0", direct1[0], 0.0);
+
+  // MI over the overlap equals brip_mutual_info of the overlapping views
+  std::vector<vgl_vector_2d<int> > few;
+  for (int dv = -5; dv<=12; dv += 3)
+    for (int du = -8; du<=25; du += 3)
+      few.push_back(vgl_vector_2d<int>(du, dv));
+  few.push_back(vgl_vector_2d<int>(8, 4));
+  few.push_back(vgl_vector_2d<int>(7, 4));
+  std::vector<double> mi1, mi3;
+  bm1.mutual_info(few, mi1, 0.0, 255.0, 16);
+  bm3.mutual_info(few, mi3, 0.0, 255.0, 16);
+  double err_mi = 0.0;
+  for (unsigned k = 0; k<few.size(); ++k)
+    err_mi = std::max(err_mi, std::fabs(mi1[k] - reference_mi(image0, image1, few[k].x(), few[k].y(), 0)));
+  TEST_NEAR("Shift MI", err_mi, 0.0, 1e-9);
+  TEST("Same MI on 3 threads", mi1 == mi3, true);
+  TEST("Best MI shift", *std::max_element(mi1.begin(), mi1.end()), mi1.back());
+
+  // homographies: translations agree with the shifts, up to the bilinear border
+  std::vector<vgl_h_matrix_2d<double> > hs;
+  for (unsigned k = 0; k<few.size(); ++k) {
+    vnl_matrix_fixed<double, 3, 3> M;
+    M.set_identity();
+    M[0][2] = few[k].x(); M[1][2] = few[k].y();
+    hs.push_back(vgl_h_matrix_2d<double>(M));
+  }
+  std::vector<double> hmi, hncc;
+  bm3.mutual_info(hs, hmi, 0.0, 255.0, 16);
+  bm3.ncc(hs, hncc);
+  err_mi = 0.0;
+  for (unsigned k = 0; k<few.size(); ++k)
+    err_mi = std::max(err_mi, std::fabs(hmi[k] - reference_mi(image0, image1, few[k].x(), few[k].y(), 1)));
+  TEST_NEAR("Homography MI", err_mi, 0.0, 1e-9);
+  TEST("Best homography NCC", *std::max_element(hncc.begin(), hncc.end()), hncc.back());
+  TEST("Homography NCC of the true shift", hncc.back() > 0.99, true);
+}
+
+TESTMAIN(test_batch_match);
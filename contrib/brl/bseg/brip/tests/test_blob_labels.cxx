@@ -0,0 +1,125 @@
+// This is brl/bseg/brip/tests/test_blob_labels.cxx
+#include <iostream>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <brip/brip_blob_labels.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_crop.h>
+#include <vil/algo/vil_blob.h>
+#if BRIP_HAS_VIL3D
+#include <vil3d/vil3d_image_view.h>
+#include <vil3d/algo/vil3d_find_blobs.h>
+#endif
+#include <vnl/vnl_random.h>
+
+static bool same_2d(vil_image_view<unsigned> const& a, vil_image_view<unsigned> const& b)
+{
+  if (a.ni() != b.ni() || a.nj() != b.nj())
+    return false;
+  for (unsigned j = 0; j<a.nj(); ++j)
+    for (unsigned i = 0; i<a.ni(); ++i)
+      if (a(i,j) != b(i,j))
+        return false;
+  return true;
+}
+
+#if BRIP_HAS_VIL3D
+static bool same_3d(vil3d_image_view<unsigned> const& a, vil3d_image_view<unsigned> const& b)
+{
+  if (a.ni() != b.ni() || a.nj() != b.nj() || a.nk() != b.nk())
+    return false;
+  for (unsigned k = 0; k<a.nk(); ++k)
+    for (unsigned j = 0; j<a.nj(); ++j)
+      for (unsigned i = 0; i<a.ni(); ++i)
+        if (a(i,j,k) != b(i,j,k))
+          return false;
+  return true;
+}
+#endif // BRIP_HAS_VIL3D
+
+static unsigned max_label(vil_image_view<unsigned> const& a)
+{
+  unsigned m = 0;
+  for (unsigned j = 0; j<a.nj(); ++j)
+    for (unsigned i = 0; i<a.ni(); ++i)
+      m = a(i,j) > m ? a(i,j) : m;
+  return m;
+}
+
+static void test_2d(vnl_random& rng)
+{
+  // random pixels give many small blobs that wind across the tile borders
+  vil_image_view<bool> im(61, 47);
+  for (unsigned j = 0; j<im.nj(); ++j)
+    for (unsigned i = 0; i<im.ni(); ++i)
+      im(i,j) = rng.drand32() < 0.45;
+  // and one blob spanning every row
+  for (unsigned j = 0; j<im.nj(); ++j)
+    im(30,j) = true;
+
+  const vil_blob_connectivity conns[2] = { vil_blob_4_conn, vil_blob_8_conn };
+  const unsigned threads[3] = { 1, 3, 0 }, rows[4] = { 0, 1, 2, 7 };
+  for (unsigned c = 0; c<2; ++c) {
+    vil_image_view<unsigned> ref, lab;
+    vil_blob_labels(im, conns[c], ref);
+    bool ok = true;
+    unsigned n = 0;
+    for (unsigned t = 0; t<3; ++t)
+      for (unsigned r = 0; r<4; ++r) {
+        n = brip_blob_labels(im, conns[c], lab, threads[t], rows[r]);
+        ok = ok && same_2d(ref, lab) && n == max_label(ref);
+      }
+    std::cout << n << " blobs with connectivity " << (c ? 8 : 4) << '\n';
+    TEST(c ? "8 connected labels" : "4 connected labels", ok, true);
+  }
+
+  // a window of a larger image; a destination that is not a plain image is replaced
+  vil_image_view<bool> win = vil_crop(im, 5, 40, 3, 31);
+  vil_image_view<unsigned> big(80, 80), ref;
+  vil_image_view<unsigned> dest = vil_crop(big, 10, 40, 20, 31);
+  vil_blob_labels(win, vil_blob_8_conn, ref);
+  brip_blob_labels(win, vil_blob_8_conn, dest, 2, 4);
+  TEST("cropped views", same_2d(ref, dest), true);
+
+  vil_image_view<bool> empty(10, 10);
+  empty.fill(false);
+  vil_image_view<unsigned> lab;
+  TEST("no blobs", brip_blob_labels(empty, vil_blob_4_conn, lab) == 0 && max_label(lab) == 0, true);
+}
+
+#if BRIP_HAS_VIL3D
+static void test_3d(vnl_random& rng)
+{
+  vil3d_image_view<bool> vol(17, 13, 23);
+  for (unsigned k = 0; k<vol.nk(); ++k)
+    for (unsigned j = 0; j<vol.nj(); ++j)
+      for (unsigned i = 0; i<vol.ni(); ++i)
+        vol(i,j,k) = rng.drand32() < 0.3;
+
+  const vil3d_find_blob_connectivity conns[2] = { vil3d_find_blob_connectivity_6_conn,
+                                                  vil3d_find_blob_connectivity_26_conn };
+  const unsigned threads[3] = { 1, 3, 0 }, slices[3] = { 0, 1, 5 };
+  for (unsigned c = 0; c<2; ++c) {
+    vil3d_image_view<unsigned> ref, lab;
+    vil3d_find_blobs(vol, conns[c], ref);
+    bool ok = true;
+    for (unsigned t = 0; t<3; ++t)
+      for (unsigned s = 0; s<3; ++s) {
+        brip_blob_labels(vol, conns[c], lab, threads[t], slices[s]);
+        ok = ok && same_3d(ref, lab);
+      }
+    TEST(c ? "26 connected labels" : "6 connected labels", ok, true);
+  }
+}
+#endif // BRIP_HAS_VIL3D
+
+static void test_blob_labels()
+{
+  vnl_random rng(1234);
+  test_2d(rng);
+#if BRIP_HAS_VIL3D
+  test_3d(rng);
+#endif
+}
+
+TESTMAIN(test_blob_labels);
@@ -0,0 +1,238 @@
+// This is brl/bseg/brip/tests/test_bucket_watershed.cxx
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include <utility>
+#include <cstdlib>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <brip/brip_bucket_watershed.h>
+#include <brip/brip_watershed.h>
+#include <brip/brip_watershed_params.h>
+#include <vil/vil_image_view.h>
+#if BRIP_HAS_VIL3D
+#include <vil3d/vil3d_image_view.h>
+#endif
+#include <vil1/vil1_memory_image_of.h>
+#include <vnl/vnl_random.h>
+
+// Meyer's flooding with a heap ordered by (level, arrival), the behaviour
+// the bucket queue must reproduce.  Labels are flat, boundaries get bl.
+static void reference_flood(std::vector<unsigned> const& cost, std::vector<unsigned>& lab,
+                            int ni, int nj, int nk, bool full, unsigned bl)
+{
+  const unsigned queued = unsigned(-1), boundary = unsigned(-2);
+  std::vector<int> di, dj, dk;
+  int kr = nk > 1 ? 1 : 0;
+  for (int c = -kr; c<=kr; ++c)
+    for (int b = -1; b<=1; ++b)
+      for (int a = -1; a<=1; ++a) {
+        int nz = (a != 0) + (b != 0) + (c != 0);
+        if (nz == 0 || (!full && nz > 1)) continue;
+        di.push_back(a); dj.push_back(b); dk.push_back(c);
+      }
+  typedef std::pair<std::pair<unsigned, unsigned>, int> entry;
+  std::priority_queue<entry, std::vector<entry>, std::greater<entry> > q;
+  unsigned arrival = 0, level = 0;
+  int n = ni*nj*nk;
+  std::vector<int> nb;
+  // queue the unlabelled neighbours of the markers
+  for (int p = 0; p<n; ++p) {
+    if (lab[p] == 0 || lab[p] == queued) continue;
+    int i = p % ni, j = (p / ni) % nj, k = p / (ni*nj);
+    for (unsigned m = 0; m<di.size(); ++m) {
+      int ii = i+di[m], jj = j+dj[m], kk = k+dk[m];
+      if (ii<0 || jj<0 || kk<0 || ii>=ni || jj>=nj || kk>=nk) continue;
+      int r = ii + ni*(jj + nj*kk);
+      if (lab[r] != 0) continue;
+      lab[r] = queued;
+      q.push(entry(std::make_pair(cost[r], arrival++), r));
+    }
+  }
+  while (!q.empty()) {
+    entry e = q.top(); q.pop();
+    int p = e.second;
+    level = e.first.first;
+    int i = p % ni, j = (p / ni) % nj, k = p / (ni*nj);
+    nb.clear();
+    for (unsigned m = 0; m<di.size(); ++m) {
+      int ii = i+di[m], jj = j+dj[m], kk = k+dk[m];
+      if (ii<0 || jj<0 || kk<0 || ii>=ni || jj>=nj || kk>=nk) continue;
+      nb.push_back(ii + ni*(jj + nj*kk));
+    }
+    unsigned l = 0;
+    bool contested = false;
+    for (unsigned m = 0; m<nb.size(); ++m) {
+      unsigned x = lab[nb[m]];
+      if (x == 0 || x >= boundary) continue;
+      if (l == 0) l = x; else if (x != l) contested = true;
+    }
+    if (contested) { lab[p] = boundary; continue; }
+    lab[p] = l;
+    for (unsigned m = 0; m<nb.size(); ++m) {
+      int r = nb[m];
+      if (lab[r] != 0) continue;
+      lab[r] = queued;
+      q.push(entry(std::make_pair(cost[r] > level ? cost[r] : level, arrival++), r));
+    }
+  }
+  for (int p = 0; p<n; ++p)
+    if (lab[p] == boundary) lab[p] = bl;
+}
+
+static void test_two_basins()
+{
+  // two V shaped valleys meeting at a ridge between columns 9 and 10
+  vil_image_view<vxl_byte> cost(20, 7);
+  vil_image_view<unsigned> lab(20, 7);
+  lab.fill(0);
+  for (unsigned j = 0; j<7; ++j)
+    for (unsigned i = 0; i<20; ++i) {
+      int d0 = std::abs(int(i)-5), d1 = std::abs(int(i)-14);
+      cost(i,j) = vxl_byte(10*(d0 < d1 ? d0 : d1));
+    }
+  lab(5,3) = 1;
+  lab(14,3) = 2;
+  brip_bucket_watershed ws(true, true, 99);
+  TEST("flood", ws.flood(cost, lab), true);
+  bool sides = true, separated = true;
+  for (unsigned j = 0; j<7; ++j)
+    for (unsigned i = 0; i<20; ++i) {
+      if (i <= 8) sides = sides && lab(i,j) == 1;
+      if (i >= 11) sides = sides && lab(i,j) == 2;
+      if (i+1 < 20 && lab(i,j) != 99 && lab(i+1,j) != 99)
+        separated = separated && lab(i,j) == lab(i+1,j);
+    }
+  TEST("each valley has its marker's label", sides, true);
+  TEST("regions are separated by boundaries", separated && ws.n_boundary_pixels() >= 7, true);
+
+  lab.fill(0);
+  TEST("no markers", ws.flood(cost, lab), false);
+
+  // without boundaries every pixel joins a region
+  lab(5,3) = 1;
+  lab(14,3) = 2;
+  brip_bucket_watershed wn(false, false);
+  wn.flood(cost, lab);
+  bool all = wn.n_boundary_pixels() == 0;
+  for (unsigned j = 0; j<7; ++j)
+    for (unsigned i = 0; i<20; ++i)
+      all = all && (lab(i,j) == 1 || lab(i,j) == 2);
+  TEST("no boundaries", all, true);
+}
+
+static void test_against_reference(vnl_random& rng)
+{
+  const unsigned ni = 37, nj = 29;
+  vil_image_view<vxl_byte> cost(ni, nj);
+  vil_image_view<vxl_uint_16> cost16(ni, nj);
+  vil_image_view<unsigned> markers(ni, nj);
+  markers.fill(0);
+  std::vector<unsigned> fcost(ni*nj), fmark(ni*nj, 0);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i) {
+      // coarse levels so that plateaus occur
+      cost(i,j) = vxl_byte(16*rng.lrand32(0, 15));
+      cost16(i,j) = vxl_uint_16(cost(i,j)*257);
+      fcost[i+ni*j] = cost(i,j);
+    }
+  for (unsigned m = 1; m<=12; ++m) {
+    unsigned i = rng.lrand32(0, ni-1), j = rng.lrand32(0, nj-1);
+    markers(i,j) = m;
+    fmark[i+ni*j] = m;
+  }
+  for (int full = 0; full<2; ++full) {
+    std::vector<unsigned> ref = fmark;
+    reference_flood(fcost, ref, ni, nj, 1, full != 0, 0);
+    vil_image_view<unsigned> lab, lab16;
+    lab.deep_copy(markers);
+    lab16.deep_copy(markers);
+    brip_bucket_watershed ws(full != 0);
+    ws.flood(cost, lab);
+    ws.flood(cost16, lab16);
+    bool same = true;
+    for (unsigned j = 0; j<nj; ++j)
+      for (unsigned i = 0; i<ni; ++i)
+        same = same && lab(i,j) == ref[i+ni*j] && lab16(i,j) == ref[i+ni*j];
+    TEST(full ? "8 connected flood equals heap flood" : "4 connected flood equals heap flood", same, true);
+  }
+
+#if BRIP_HAS_VIL3D
+  // volumes
+  const unsigned vi = 13, vj = 11, vk = 9;
+  vil3d_image_view<vxl_byte> vcost(vi, vj, vk);
+  vil3d_image_view<unsigned> vmark(vi, vj, vk);
+  vmark.fill(0);
+  std::vector<unsigned> gcost(vi*vj*vk), gmark(vi*vj*vk, 0);
+  for (unsigned k = 0; k<vk; ++k)
+    for (unsigned j = 0; j<vj; ++j)
+      for (unsigned i = 0; i<vi; ++i) {
+        vcost(i,j,k) = vxl_byte(rng.lrand32(0, 20));
+        gcost[i+vi*(j+vj*k)] = vcost(i,j,k);
+      }
+  for (unsigned m = 1; m<=9; ++m) {
+    unsigned i = rng.lrand32(0, vi-1), j = rng.lrand32(0, vj-1), k = rng.lrand32(0, vk-1);
+    vmark(i,j,k) = m;
+    gmark[i+vi*(j+vj*k)] = m;
+  }
+  for (int full = 0; full<2; ++full) {
+    std::vector<unsigned> ref = gmark;
+    reference_flood(gcost, ref, vi, vj, vk, full != 0, 7777);
+    vil3d_image_view<unsigned> lab;
+    lab.deep_copy(vmark);
+    brip_bucket_watershed ws(full != 0, true, 7777);
+    ws.flood(vcost, lab);
+    bool same = true;
+    for (unsigned k = 0; k<vk; ++k)
+      for (unsigned j = 0; j<vj; ++j)
+        for (unsigned i = 0; i<vi; ++i)
+          same = same && lab(i,j,k) == ref[i+vi*(j+vj*k)];
+    TEST(full ? "26 connected volume flood" : "6 connected volume flood", same, true);
+  }
+#endif // BRIP_HAS_VIL3D
+}
+
+static void test_watershed_regions()
+{
+  // three dishes, as in test_watershed
+  int w = 24, h = 24;
+  vil1_memory_image_of<float> input(w,h);
+  for (int r = 0; r<h; r++)
+    for (int c = 0; c<w; c++) {
+      float d0 = float((c-7)*(c-7)+(r-7)*(r-7)), d1 = float((c-16)*(c-16)+(r-15)*(r-15)),
+            d2 = float((c-6)*(c-6)+(r-17)*(r-17));
+      float d = d0 < d1 ? d0 : d1;
+      input(c,r) = 20.0f*(d < d2 ? d : d2);
+    }
+  brip_watershed_params wp;
+  brip_watershed ws(wp);
+  ws.set_image(input);
+  TEST("bucket queue regions", ws.compute_regions_bucket_queue(), true);
+  unsigned n_reg = ws.max_region_label() - brip_watershed::min_region_label() + 1;
+  std::cout << n_reg << " regions\n";
+  bool symmetric = true, any = false;
+  for (unsigned r = brip_watershed::min_region_label(); r<=ws.max_region_label(); ++r) {
+    std::vector<unsigned int> adj;
+    if (!ws.adjacent_regions(r, adj))
+      continue;
+    any = true;
+    for (unsigned a = 0; a<adj.size(); ++a) {
+      std::vector<unsigned int> back;
+      ws.adjacent_regions(adj[a], back);
+      symmetric = symmetric && std::find(back.begin(), back.end(), r) != back.end();
+    }
+  }
+  TEST("symmetric region adjacency", any && symmetric, true);
+}
+
+static void test_bucket_watershed()
+{
+  vnl_random rng(77);
+  test_two_basins();
+  test_against_reference(rng);
+  test_watershed_regions();
+}
+
+TESTMAIN(test_bucket_watershed);
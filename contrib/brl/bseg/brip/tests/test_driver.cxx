@@ -16,6 +16,11 @@ DECLARE( test_filter_bank );
 DECLARE( test_gain_offset_solver );
 DECLARE( test_nitf_ops );
 DECLARE( test_phase_correlation );
+DECLARE( test_local_stats );
+DECLARE( test_batch_match );
+DECLARE( test_optical_flow );
+DECLARE( test_bucket_watershed );
+DECLARE( test_blob_labels );
 void
 register_tests()
 {
@@ -35,6 +40,11 @@ register_tests()
   REGISTER( test_gain_offset_solver );
   REGISTER( test_nitf_ops );
   REGISTER( test_phase_correlation );
+  REGISTER( test_local_stats );
+  REGISTER( test_batch_match );
+  REGISTER( test_optical_flow );
+  REGISTER( test_bucket_watershed );
+  REGISTER( test_blob_labels );
 }
 
 DEFINE_MAIN;
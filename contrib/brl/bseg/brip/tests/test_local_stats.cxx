@@ -0,0 +1,210 @@
+// This is brl/bseg/brip/tests/test_local_stats.cxx
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <vil/vil_image_view.h>
+#include <vil/vil_new.h>
+#include <vnl/vnl_random.h>
+#include <vbl/vbl_array_2d.h>
+#include <brip/brip_integral_image.h>
+#include <brip/brip_sliding_histogram.h>
+#include <brip/brip_vil_float_ops.h>
+
+static vil_image_view<float> random_image(unsigned ni, unsigned nj, vnl_random& rng)
+{
+  vil_image_view<float> img(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      img(i,j) = float(100.0 + 40.0*std::sin(0.2*i)*std::cos(0.15*j) + rng.normal()*10.0);
+  return img;
+}
+
+static float max_abs_diff(vil_image_view<float> const& a, vil_image_view<float> const& b)
+{
+  float d = 0.0f;
+  for (unsigned j = 0; j<a.nj(); ++j)
+    for (unsigned i = 0; i<a.ni(); ++i)
+      d = std::max(d, std::fabs(a(i,j)-b(i,j)));
+  return d;
+}
+
+static void test_integral_image(vil_image_view<float> const& a, vil_image_view<float> const& b)
+{
+  brip_integral_image s(a), sab(a, b);
+  TEST("Integral image size", s.ni() == a.ni() && s.nj() == a.nj(), true);
+  double err = 0.0;
+  unsigned boxes[][4] = { {0, 0, 0, 0}, {3, 5, 17, 9}, {0, 0, 40, 30}, {12, 1, 12, 29} };
+  for (unsigned k = 0; k<4; ++k)
+  {
+    double sum = 0.0, prod = 0.0;
+    for (unsigned j = boxes[k][1]; j<=boxes[k][3]; ++j)
+      for (unsigned i = boxes[k][0]; i<=boxes[k][2]; ++i) {
+        sum += a(i,j);
+        prod += double(a(i,j))*b(i,j);
+      }
+    err = std::max(err, std::fabs(sum - s.sum(boxes[k][0], boxes[k][1], boxes[k][2], boxes[k][3])));
+    err = std::max(err, std::fabs(prod - sab.sum(boxes[k][0], boxes[k][1], boxes[k][2], boxes[k][3]))/prod);
+  }
+  TEST_NEAR("Box sums", err, 0.0, 1e-6);
+}
+
+static void test_sliding_histogram(vil_image_view<float> const& img, vil_image_view<float> const& w)
+{
+  unsigned ni = img.ni(), nj = img.nj();
+  brip_sliding_histogram bins(255.0f, 16);
+  TEST("Bin below range", bins.bin(-1.0f), -1);
+  TEST("Bin above range", bins.bin(256.0f), -1);
+  TEST("First bin", bins.bin(0.0f), 0);
+  TEST("Upper bin edge", bins.bin(255.0f/16.0f), 0);
+  TEST("Last bin", bins.bin(255.0f), 15);
+
+  // entropy against the bsta_histogram based single window version
+  const unsigned ir = 4, jr = 3;
+  brip_sliding_histogram hi(255.0f, 16), hg(360.0f, 8);
+  hi.set_image(img, ir, jr);
+  vil_image_view<float> ang(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      ang(i,j) = float(std::fmod(img(i,j)*3.0f, 360.0f));
+  hg.set_image(ang, w, ir, jr);
+  float ei = 0.0f, eg = 0.0f;
+  for (unsigned j = jr; j+jr<nj; ++j)
+    for (unsigned i = ir; i+ir<ni; ++i) {
+      hi.move_to(i, j);
+      hg.move_to(i, j);
+      ei = std::max(ei, std::fabs(hi.entropy() -
+                                  brip_vil_float_ops::entropy_i(i, j, ir, jr, img, 255.0f, 16)));
+      eg = std::max(eg, std::fabs(hg.entropy() -
+                                  brip_vil_float_ops::entropy_hs(i, j, ir, jr, ang, w, 360.0f, 8)));
+    }
+  TEST_NEAR("Sliding intensity entropy", ei, 0.0f, 1e-4f);
+  TEST_NEAR("Sliding weighted entropy", eg, 0.0f, 1e-4f);
+
+  // an out of order visit rebuilds the histogram
+  hi.move_to(ni/2, nj/2);
+  hi.move_to(ir, jr);
+  TEST_NEAR("Rebuilt window", hi.entropy(),
+            brip_vil_float_ops::entropy_i(ir, jr, ir, jr, img, 255.0f, 16), 1e-4f);
+
+  // median of integer levels, one bin per level
+  vil_image_view<float> levels(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i)
+      levels(i,j) = std::floor(std::max(0.0f, std::min(255.0f, img(i,j)))) + 0.5f;
+  brip_sliding_histogram hm(256.0f, 256);
+  hm.set_image(levels, 2, 2);
+  unsigned nwrong = 0;
+  for (unsigned j = 2; j+2<nj; ++j)
+    for (unsigned i = 2; i+2<ni; ++i) {
+      std::vector<float> v;
+      for (unsigned jj = j-2; jj<=j+2; ++jj)
+        for (unsigned ii = i-2; ii<=i+2; ++ii)
+          v.push_back(levels(ii,jj));
+      std::nth_element(v.begin(), v.begin()+12, v.end());
+      hm.move_to(i, j);
+      if (hm.median() != v[12])
+        ++nwrong;
+    }
+  TEST("Sliding median", nwrong, 0);
+}
+
+static void test_operators(vil_image_view<float> const& img)
+{
+  unsigned ni = img.ni(), nj = img.nj();
+  const int n = 3, N = (2*n+1)*(2*n+1);
+
+  // gradient matrix against direct window sums
+  vil_image_view<float> gx(ni, nj), gy(ni, nj), IxIx(ni, nj), IxIy(ni, nj), IyIy(ni, nj);
+  brip_vil_float_ops::gradient_3x3(img, gx, gy);
+  brip_vil_float_ops::grad_matrix_NxN(img, n, IxIx, IxIy, IyIy);
+  vil_image_view<float> rxx(ni, nj), rxy(ni, nj), ryy(ni, nj), rsv(ni, nj), rtr(ni, nj);
+  rxx.fill(0.0f); rxy.fill(0.0f); ryy.fill(0.0f); rsv.fill(0.0f); rtr.fill(0.0f);
+  for (int y = n; y<int(nj)-n; ++y)
+    for (int x = n; x<int(ni)-n; ++x) {
+      double xx = 0, xy = 0, yy = 0;
+      for (int j = -n; j<=n; ++j)
+        for (int i = -n; i<=n; ++i) {
+          xx += gx(x+i,y+j)*gx(x+i,y+j);
+          xy += gx(x+i,y+j)*gy(x+i,y+j);
+          yy += gy(x+i,y+j)*gy(x+i,y+j);
+        }
+      rxx(x,y) = float(xx/N); rxy(x,y) = float(xy/N); ryy(x,y) = float(yy/N);
+      rtr(x,y) = float((xx+yy)/N);
+      rsv(x,y) = float(std::sqrt(std::fabs((xx*yy-xy*xy)/N)));
+    }
+  TEST_NEAR("grad_matrix_NxN IxIx", max_abs_diff(IxIx, rxx), 0.0f, 1e-2f);
+  TEST_NEAR("grad_matrix_NxN IxIy", max_abs_diff(IxIy, rxy), 0.0f, 1e-2f);
+  TEST_NEAR("grad_matrix_NxN IyIy", max_abs_diff(IyIy, ryy), 0.0f, 1e-2f);
+  TEST_NEAR("trace_grad_matrix_NxN",
+            max_abs_diff(brip_vil_float_ops::trace_grad_matrix_NxN(img, n), rtr), 0.0f, 1e-2f);
+  vil_image_view<float> in = img;
+  TEST_NEAR("sqrt_grad_singular_values",
+            max_abs_diff(brip_vil_float_ops::sqrt_grad_singular_values(in, n), rsv), 0.0f, 1e-1f);
+
+  // std_dev_operator with a box and with a gaussian kernel
+  vbl_array_2d<float> box(5, 7, 0.5f), gauss;
+  vbl_array_2d<bool> mask;
+  brip_vil_float_ops::gaussian_kernel_mask(2.0f, gauss, mask);
+  vbl_array_2d<float>* kernels[] = { &box, &gauss };
+  for (unsigned k = 0; k<2; ++k)
+  {
+    vbl_array_2d<float> const& kern = *kernels[k];
+    int rrad = (kern.rows()-1)/2, crad = (kern.cols()-1)/2;
+    vil_image_view<float> sd1 = brip_vil_float_ops::std_dev_operator(img, kern);
+    vil_image_view<float> sd2 = brip_vil_float_ops::std_dev_operator_method2(img, kern);
+    vil_image_view<float> r1, r2;
+    r1.deep_copy(sd1);
+    r2.deep_copy(sd2);
+    for (int j = rrad; j<int(nj)-rrad; ++j)
+      for (int i = crad; i<int(ni)-crad; ++i) {
+        double s1 = 0, s2 = 0;
+        for (int jj = -rrad; jj<=rrad; ++jj)
+          for (int ii = -crad; ii<=crad; ++ii) {
+            double sd = img(i+ii, j+jj), kv = kern[jj+rrad][ii+crad];
+            s1 += sd*sd*kv*kv;
+            s2 += sd*std::fabs(kv);
+          }
+        r1(i,j) = float(std::sqrt(s1));
+        r2(i,j) = float(s2);
+      }
+    TEST_NEAR(k == 0 ? "std_dev_operator, box kernel" : "std_dev_operator, gaussian kernel",
+              max_abs_diff(sd1, r1), 0.0f, 1e-2f);
+    TEST_NEAR(k == 0 ? "std_dev_operator_method2, box kernel" : "std_dev_operator_method2, gaussian kernel",
+              max_abs_diff(sd2, r2), 0.0f, 1e-2f);
+  }
+
+  // entropy operator against the single window functions
+  const unsigned ir = 3, jr = 2, step = 2;
+  vil_image_view<float> ent =
+    brip_vil_float_ops::entropy(ir, jr, step, vil_new_image_resource_of_view(img), 1.0f, 16, true, true);
+  vil_image_view<float> smooth = brip_vil_float_ops::gaussian(img, 1.0f);
+  vil_image_view<float> sx(ni, nj), sy(ni, nj);
+  brip_vil_float_ops::gradient_3x3(smooth, sx, sy);
+  float err = 0.0f;
+  for (unsigned j = jr; j<nj-jr; j+=step)
+    for (unsigned i = ir; i<ni-ir; i+=step) {
+      float e = brip_vil_float_ops::entropy_i(i, j, ir, jr, smooth, 255.0f, 16) +
+                brip_vil_float_ops::entropy_g(i, j, ir, jr, sx, sy);
+      err = std::max(err, std::fabs(e - ent(i/step, j/step)));
+    }
+  TEST_NEAR("entropy operator", err, 0.0f, 1e-3f);
+}
+
+static void test_local_stats()
+{
+  vnl_random rng(8734);
+  vil_image_view<float> a = random_image(45, 33, rng);
+  vil_image_view<float> b = random_image(45, 33, rng);
+  vil_image_view<float> w(45, 33);
+  for (unsigned j = 0; j<w.nj(); ++j)
+    for (unsigned i = 0; i<w.ni(); ++i)
+      w(i,j) = float(rng.drand32(0.0, 5.0));
+  test_integral_image(a, b);
+  test_sliding_histogram(a, w);
+  test_operators(a);
+}
+
+TESTMAIN(test_local_stats);
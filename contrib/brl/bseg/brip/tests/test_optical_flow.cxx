@@ -0,0 +1,100 @@
+// This is brl/bseg/brip/tests/test_optical_flow.cxx
+#include <iostream>
+#include <cmath>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <brip/brip_optical_flow.h>
+#include <vil/vil_image_view.h>
+
+// a smooth texture, translated by (dx, dy)
+static vil_image_view<float> make_frame(unsigned ni, unsigned nj, float dx, float dy)
+{
+  vil_image_view<float> im(ni, nj);
+  for (unsigned j = 0; j<nj; ++j)
+    for (unsigned i = 0; i<ni; ++i) {
+      double x = i - dx, y = j - dy;
+      im(i,j) = float(128.0 + 40.0*std::sin(0.21*x + 0.10*y) + 30.0*std::cos(0.17*y - 0.05*x) +
+                      20.0*std::sin(0.13*x)*std::cos(0.11*y) + 25.0*std::sin(0.3*x - 0.3*y));
+    }
+  return im;
+}
+
+// mean distance of the flow from (dx, dy) away from the border
+static double flow_error(vil_image_view<float> const& vx, vil_image_view<float> const& vy,
+                         float dx, float dy, unsigned margin)
+{
+  double sum = 0.0;
+  unsigned n = 0;
+  for (unsigned j = margin; j+margin<vx.nj(); ++j)
+    for (unsigned i = margin; i+margin<vx.ni(); ++i, ++n)
+      sum += std::sqrt((vx(i,j)-dx)*(vx(i,j)-dx) + (vy(i,j)-dy)*(vy(i,j)-dy));
+  return n ? sum/n : 1e9;
+}
+
+static bool same_flow(vil_image_view<float> const& ax, vil_image_view<float> const& ay,
+                      vil_image_view<float> const& bx, vil_image_view<float> const& by)
+{
+  if (ax.ni() != bx.ni() || ax.nj() != bx.nj())
+    return false;
+  for (unsigned j = 0; j<ax.nj(); ++j)
+    for (unsigned i = 0; i<ax.ni(); ++i)
+      if (ax(i,j) != bx(i,j) || ay(i,j) != by(i,j))
+        return false;
+  return true;
+}
+
+static void test_method(brip_optical_flow_params::method_type method, char const* name, double tol)
+{
+  const unsigned ni = 97, nj = 83, margin = 12;
+  const float dx = 4.6f, dy = -3.2f;
+  vil_image_view<float> f0 = make_frame(ni, nj, 0.0f, 0.0f), f1 = make_frame(ni, nj, dx, dy);
+
+  brip_optical_flow_params params(method);
+  params.num_threads_ = 1;
+  brip_optical_flow flow1(params);
+  TEST("number of levels", flow1.n_levels(ni, nj), 3);
+  vil_image_view<float> vx, vy;
+  flow1.compute(f0, f1, vx, vy);
+  TEST("flow size", vx.ni() == ni && vx.nj() == nj && vy.ni() == ni && vy.nj() == nj, true);
+  double err = flow_error(vx, vy, dx, dy, margin);
+  std::cout << name << " mean flow error " << err << '\n';
+  TEST_NEAR(name, err, 0.0, tol);
+
+  // one level cannot follow a motion of several pixels
+  brip_optical_flow_params single = params;
+  single.max_levels_ = 1;
+  vil_image_view<float> sx, sy;
+  brip_optical_flow(single).compute(f0, f1, sx, sy);
+  double serr = flow_error(sx, sy, dx, dy, margin);
+  std::cout << name << " single level mean flow error " << serr << '\n';
+  TEST("pyramid beats a single level", serr > 4.0*err, true);
+
+  // the threads do not change the result
+  params.num_threads_ = 3;
+  brip_optical_flow flow3(params);
+  vil_image_view<float> tx, ty;
+  flow3.compute(f0, f1, tx, ty);
+  TEST("same flow on 3 threads", same_flow(vx, vy, tx, ty), true);
+
+  // a stream reuses the pyramid of the previous frame
+  vil_image_view<float> f2 = make_frame(ni, nj, 2.0f*dx, 2.0f*dy);
+  vil_image_view<float> ax, ay, bx, by;
+  TEST("first frame of stream", flow3.add_frame(f0, ax, ay), false);
+  TEST("pyramid of first frame", flow3.last_pyramid().nlevels(), 3);
+  bool ok = flow3.add_frame(f1, ax, ay);
+  TEST("second frame of stream", ok && same_flow(vx, vy, ax, ay), true);
+  ok = flow3.add_frame(f2, ax, ay);
+  flow1.compute(f1, f2, bx, by);
+  TEST("third frame of stream", ok && same_flow(bx, by, ax, ay), true);
+  TEST("frame of another size", flow3.add_frame(make_frame(ni/2, nj, 0.0f, 0.0f), ax, ay), false);
+  flow3.reset();
+  TEST("after reset", flow3.add_frame(f1, ax, ay), false);
+}
+
+static void test_optical_flow()
+{
+  test_method(brip_optical_flow_params::LUCAS_KANADE, "Lucas-Kanade", 0.08);
+  test_method(brip_optical_flow_params::HORN_SCHUNCK, "Horn-Schunck", 0.15);
+}
+
+TESTMAIN(test_optical_flow);
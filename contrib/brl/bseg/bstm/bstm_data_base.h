@@ -43,6 +43,13 @@ class bstm_data_base : public vbl_ref_count
     char *            cell_buffer(int i, std::size_t cell_size);
 
     //: setter for swapping out data buffer
+    //  The new buffer becomes OWNED by this class, the old one is deleted.
+    void set_data_buffer(char * data_buffer, std::size_t length)
+    { if (data_buffer_) delete [] data_buffer_; data_buffer_ = data_buffer; buffer_length_ = length; }
+
+    //: gives up ownership of the data buffer and returns it; the data_base is left empty
+    char * release_data_buffer()
+    { char * buf = data_buffer_; data_buffer_ = VXL_NULLPTR; buffer_length_ = 0; return buf; }
 
     //: by default data is read-only, i.e. cache doesn't save it before destroying it
     bool read_only_;
@@ -0,0 +1,151 @@
+#include "bstm_data_pool.h"
+//:
+// \file
+
+bstm_data_pool::bstm_data_pool(std::size_t max_free_bytes)
+: free_bytes_(0), max_free_bytes_(max_free_bytes), num_reused_(0), num_allocated_(0)
+{
+}
+
+bstm_data_pool::~bstm_data_pool()
+{
+  this->clear();
+}
+
+void bstm_data_pool::lock()
+{
+#if VXL_HAS_PTHREAD_H
+  mutex_.lock();
+#endif
+}
+
+void bstm_data_pool::unlock()
+{
+#if VXL_HAS_PTHREAD_H
+  mutex_.unlock();
+#endif
+}
+
+char* bstm_data_pool::allocate(std::size_t num_bytes)
+{
+  if (num_bytes == 0)
+    return new char[1];
+  this->lock();
+  // smallest unused buffer that fits, unless it would waste more than a quarter of it
+  std::multimap<std::size_t, char*>::iterator it = free_.lower_bound(num_bytes);
+  if (it != free_.end() && it->first - num_bytes <= it->first/4) {
+    char* buf = it->second;
+    free_bytes_ -= it->first;
+    free_.erase(it);
+    ++num_reused_;
+    this->unlock();
+    return buf;
+  }
+  ++num_allocated_;
+  this->unlock();
+  return new char[num_bytes];
+}
+
+void bstm_data_pool::release(char* buffer, std::size_t num_bytes)
+{
+  if (!buffer)
+    return;
+  this->lock();
+  if (num_bytes == 0 || (max_free_bytes_ > 0 && free_bytes_ + num_bytes > max_free_bytes_)) {
+    this->unlock();
+    delete [] buffer;
+    return;
+  }
+  free_.insert(std::pair<const std::size_t, char*>(num_bytes, buffer));
+  free_bytes_ += num_bytes;
+  this->unlock();
+}
+
+bstm_data_base* bstm_data_pool::new_data_base(std::size_t num_bytes, bstm_block_id id)
+{
+  return new bstm_data_base(this->allocate(num_bytes), num_bytes, id);
+}
+
+void bstm_data_pool::recycle(bstm_data_base* data)
+{
+  if (!data)
+    return;
+  std::size_t len = data->buffer_length();
+  this->release(data->release_data_buffer(), len);
+  delete data;
+}
+
+void bstm_data_pool::commit(bstm_cache& cache, bstm_block_replacement& r)
+{
+  if (r.time_blk_) {
+    cache.replace_time_block(r.id_, r.time_blk_);
+    r.time_blk_ = VXL_NULLPTR;
+  }
+
+  // keep the cached data base objects (and their read only flags), only swap the buffers
+  std::map<std::string, bstm_data_base*>::iterator it;
+  for (it = r.datas_.begin(); it != r.datas_.end(); ++it) {
+    bstm_data_base* cached = cache.get_data_base(r.id_, it->first);
+    std::size_t old_len = cached->buffer_length();
+    this->release(cached->release_data_buffer(), old_len);
+    std::size_t len = it->second->buffer_length();
+    cached->set_data_buffer(it->second->release_data_buffer(), len);
+    delete it->second;
+  }
+  r.datas_.clear();
+
+  for (it = r.new_datas_.begin(); it != r.new_datas_.end(); ++it) {
+    std::size_t len = it->second->buffer_length();
+    bstm_data_base* cached = cache.get_data_base_new(r.id_, it->first, len);
+    cached->set_data_buffer(it->second->release_data_buffer(), len);
+    delete it->second;
+  }
+  r.new_datas_.clear();
+}
+
+void bstm_data_pool::clear()
+{
+  this->lock();
+  std::multimap<std::size_t, char*>::iterator it;
+  for (it = free_.begin(); it != free_.end(); ++it)
+    delete [] it->second;
+  free_.clear();
+  free_bytes_ = 0;
+  this->unlock();
+}
+
+//-----------------------------------------------------------------------------
+
+bstm_data_base* bstm_new_data_base(bstm_block_replacement* out, std::size_t num_bytes, bstm_block_id id)
+{
+  if (out && out->pool_)
+    return out->pool_->new_data_base(num_bytes, id);
+  return new bstm_data_base(new char[num_bytes], num_bytes, id);
+}
+
+void bstm_replace_data_base(bstm_block_replacement* out, bstm_block_id id, std::string const& prefix, bstm_data_base* data)
+{
+  if (!out) {
+    bstm_cache::instance()->replace_data_base(id, prefix, data);
+    return;
+  }
+  std::map<std::string, bstm_data_base*>::iterator it = out->datas_.find(prefix);
+  if (it != out->datas_.end()) {
+    if (out->pool_)
+      out->pool_->recycle(it->second);
+    else
+      delete it->second;
+  }
+  out->datas_[prefix] = data;
+}
+
+void bstm_replace_time_block(bstm_block_replacement* out, bstm_block_id id, bstm_time_block* blk_t)
+{
+  if (!out) {
+    bstm_cache::instance()->replace_time_block(id, blk_t);
+    return;
+  }
+  if (out->time_blk_ && out->time_blk_ != blk_t)
+    delete out->time_blk_;
+  out->time_blk_ = blk_t;
+}
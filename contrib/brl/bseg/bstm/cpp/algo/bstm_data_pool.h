@@ -0,0 +1,113 @@
+#ifndef bstm_data_pool_h_
+#define bstm_data_pool_h_
+//:
+// \file
+// \brief Recycles the data buffers that the refine/merge/ingest functions reallocate for every block.
+//
+// Refining, merging or ingesting a block builds new alpha/appearance buffers
+// and throws the old ones away.  When many blocks (or many time steps) are
+// processed, bstm_data_pool keeps the discarded buffers and hands them out
+// again for later requests of a similar size.  All members are thread safe,
+// so workers processing different blocks can share one pool.
+//
+// bstm_block_replacement collects the new time block and data buffers of one
+// block, so that a worker thread does not have to touch the (not thread safe)
+// bstm_cache; bstm_data_pool::commit() swaps them into the cache afterwards.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <map>
+#include <string>
+#include <cstddef>
+#include <vxl_config.h>
+#include <bstm/io/bstm_cache.h>
+#include <vcl_compiler.h>
+#if VXL_HAS_PTHREAD_H
+#include <vpl/vpl_mutex.h>
+#endif
+
+class bstm_data_pool;
+
+//: The new time block and data bases of one block, waiting to be swapped into the cache
+struct bstm_block_replacement
+{
+  bstm_block_replacement(bstm_block_metadata const& metadata, bstm_data_pool* pool = VXL_NULLPTR)
+  : id_(metadata.id_), metadata_(metadata), pool_(pool), time_blk_(VXL_NULLPTR) {}
+
+  bstm_block_id id_;
+  bstm_block_metadata metadata_;
+  //: pool the new buffers are taken from (may be null)
+  bstm_data_pool* pool_;
+  //: replaces the cached time block if not null
+  bstm_time_block* time_blk_;
+  //: replace the cached data of the same type
+  std::map<std::string, bstm_data_base*> datas_;
+  //: replace the data of the same type as bstm_cache::get_data_base_new() does
+  std::map<std::string, bstm_data_base*> new_datas_;
+};
+
+class bstm_data_pool
+{
+ public:
+  //: Keep at most max_free_bytes in unused buffers (0 means no limit)
+  bstm_data_pool(std::size_t max_free_bytes = 0);
+  ~bstm_data_pool();
+
+  //: A buffer of at least num_bytes; its contents are undefined
+  //  To be freed with delete[] or given back through release().
+  char* allocate(std::size_t num_bytes);
+
+  //: Give a buffer of (at least) num_bytes back to the pool
+  void release(char* buffer, std::size_t num_bytes);
+
+  //: A data base for block id whose buffer of num_bytes comes from the pool
+  bstm_data_base* new_data_base(std::size_t num_bytes, bstm_block_id id);
+
+  //: Delete data, keeping its buffer
+  void recycle(bstm_data_base* data);
+
+  //: Swap the new time block and data of r into the cache, recycling the old buffers
+  //  Must not be called concurrently with other users of the cache.
+  void commit(bstm_cache& cache, bstm_block_replacement& r);
+
+  //: Delete all unused buffers
+  void clear();
+
+  //: Number of bytes held in unused buffers
+  std::size_t free_bytes() const { return free_bytes_; }
+  //: Number of allocate() calls served from unused buffers
+  unsigned num_reused() const { return num_reused_; }
+  //: Number of allocate() calls that had to allocate memory
+  unsigned num_allocated() const { return num_allocated_; }
+
+ private:
+  //: unused buffers by size
+  std::multimap<std::size_t, char*> free_;
+  std::size_t free_bytes_;
+  std::size_t max_free_bytes_;
+  unsigned num_reused_;
+  unsigned num_allocated_;
+#if VXL_HAS_PTHREAD_H
+  vpl_mutex mutex_;
+#endif
+
+  void lock();
+  void unlock();
+
+  bstm_data_pool(bstm_data_pool const&);
+  bstm_data_pool& operator=(bstm_data_pool const&);
+};
+
+//: A data base of num_bytes for block id, from the pool of out if there is one
+bstm_data_base* bstm_new_data_base(bstm_block_replacement* out, std::size_t num_bytes, bstm_block_id id);
+
+//: Replace the data of type prefix of block id: in out if not null, otherwise directly in the cache
+//  A data base stored in out earlier for the same type is recycled.
+void bstm_replace_data_base(bstm_block_replacement* out, bstm_block_id id, std::string const& prefix, bstm_data_base* data);
+
+//: Replace the time block of block id: in out if not null, otherwise directly in the cache
+void bstm_replace_time_block(bstm_block_replacement* out, bstm_block_id id, bstm_time_block* blk_t);
+
+#endif // bstm_data_pool_h_
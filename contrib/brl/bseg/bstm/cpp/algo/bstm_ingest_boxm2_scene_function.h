@@ -19,6 +19,7 @@
 #include <boxm2/io/boxm2_cache.h>
 
 #include <bstm/cpp/algo/bstm_data_similarity_traits.h>
+#include <bstm/cpp/algo/bstm_data_pool.h>
 
 
 template <bstm_data_type APM_TYPE, boxm2_data_type BOXM2_APM_TYPE>
@@ -33,11 +34,23 @@ class bstm_ingest_boxm2_scene_function
    typedef vnl_vector_fixed<ushort, 4> ushort4;
 
    //: "default" constructor does all the work
+   //  If out is not null the new time block and data are stored in out instead
+   //  of the cache (see bstm_data_pool), so that blocks can be ingested
+   //  concurrently.
    bstm_ingest_boxm2_scene_function(bstm_block* blk,bstm_time_block* blk_t, std::map<std::string, bstm_data_base*> & datas,
-                                    boxm2_block* boxm2_blk, std::map<std::string, boxm2_data_base*> & boxm2_datas, double local_time, double p_threshold, double app_threshold);
+                                    boxm2_block* boxm2_blk, std::map<std::string, boxm2_data_base*> & boxm2_datas, double local_time, double p_threshold, double app_threshold,
+                                    bstm_block_replacement* out = VXL_NULLPTR);
+
+   //: true if no time tree had to be refined for the new frame
+   //  In that case the new frame was written into the data buffers in place,
+   //  without moving the data of the other time trees.
+   bool ingested_in_place() const { return in_place_; }
 
  private:
 
+   //: writes the current boxm2 data into the existing buffers, used when no tree has to be refined
+   void ingest_in_place();
+
    //: initialize generic data base pointers as their data type
    bool init_data(bstm_block* blk,bstm_time_block* blk_t,  std::map<std::string, bstm_data_base*> & datas,
                   boxm2_block* boxm2_blk, std::map<std::string, boxm2_data_base*> & boxm2_datas, double time);
@@ -109,6 +122,9 @@ class bstm_ingest_boxm2_scene_function
 
    double p_threshold_;
    double app_threshold_;
+
+   bstm_block_replacement* out_;
+   bool in_place_;
 };
 
 
@@ -13,10 +13,14 @@ bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::bstm_ingest_boxm2_sc
                                                                                              boxm2_block* boxm2_blk,
                                                                                              std::map<std::string,
                                                                                              boxm2_data_base*> & boxm2_datas,
-                                                                                             double local_time, double p_threshold, double app_threshold)
+                                                                                             double local_time, double p_threshold, double app_threshold,
+                                                                                             bstm_block_replacement* out)
 {
   p_threshold_ = p_threshold;
   app_threshold_ = app_threshold;
+  out_ = out;
+  in_place_ = false;
+  change_array_ = VXL_NULLPTR;
 
   init_data(blk, blk_t, datas, boxm2_blk, boxm2_datas, local_time);
   conform();
@@ -121,6 +125,7 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::conform()
   int* dataIndex = new int[trees.size()];           //data index for each new tree
   int currIndex = 0;                                //curr tree being looked at
   int dataSize = 0;                                 //running sum of data size
+  bool any_refined = false;                         //true if any tree was refined
 
   //1. loop over each tree, refine it in place
   boxm2_array_3d<uchar16>::iterator blk_iter;
@@ -144,6 +149,15 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::conform()
     //cache refined tree
     std::memcpy (trees_copy[currIndex].data_block(), refined_tree.get_bits(), 16);
     dataSize += newSize;
+    if (newSize != curr_tree.num_cells())
+      any_refined = true;
+  }
+
+  //nothing to conform, leave the time trees and data where they are
+  if (!any_refined) {
+    delete[] dataIndex;
+    delete[] trees_copy;
+    return true;
   }
 
   //2. allocate new time blk of the appropriate size
@@ -206,11 +220,9 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::conform()
   }
 
   //5. alloc new data buffers with appropriate size
-  bstm_data_base* newA = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_ALPHA>::datasize() ],
-                                                     dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
+  bstm_data_base* newA = bstm_new_data_base(out_, dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
 
-  bstm_data_base* newM = new bstm_data_base(new char[dataSize * bstm_data_traits<APM_TYPE>::datasize() ],
-                                                     dataSize * bstm_data_traits<APM_TYPE>::datasize() , id);
+  bstm_data_base* newM = bstm_new_data_base(out_, dataSize * bstm_data_traits<APM_TYPE>::datasize(), id);
 
   bstm_data_traits<BSTM_ALPHA>::datatype *   alpha_cpy = (bstm_data_traits<BSTM_ALPHA>::datatype *) newA->data_buffer();
   typename bstm_data_traits<APM_TYPE>::datatype *  mog_cpy = (typename bstm_data_traits<APM_TYPE>::datatype *) newM->data_buffer();
@@ -248,11 +260,10 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::conform()
   delete[] dataIndex;
   delete[] depth_diff;
 
-  //7. update cache, replace time trees
-  bstm_cache_sptr cache = bstm_cache::instance();
-  cache->replace_time_block(id, newTimeBlk);
-  cache->replace_data_base(id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
-  cache->replace_data_base(id, bstm_data_traits<APM_TYPE>::prefix(), newM);
+  //7. update cache (or out_), replace time trees
+  bstm_replace_time_block(out_, id, newTimeBlk);
+  bstm_replace_data_base(out_, id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
+  bstm_replace_data_base(out_, id, bstm_data_traits<APM_TYPE>::prefix(), newM);
 
   blk_t_ = newTimeBlk;
   alpha_ = alpha_cpy;
@@ -371,12 +382,20 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::ingest()
 
   //alloc new data buffers with appropriate size
   bstm_block_id id = blk_->block_id();
-  bstm_cache_sptr cache = bstm_cache::instance();
-  bstm_data_base *change_buffer   =   cache->get_data_base_new(id,bstm_data_traits<BSTM_CHANGE>::prefix(), blk_t_->tree_buff_length() * bstm_data_traits<BSTM_CHANGE>::datasize()  );
+  std::size_t change_size = blk_t_->tree_buff_length() * bstm_data_traits<BSTM_CHANGE>::datasize();
+  bstm_data_base *change_buffer;
+  if (out_) {
+    change_buffer = bstm_new_data_base(out_, change_size, id);
+    change_buffer->set_default_value(bstm_data_traits<BSTM_CHANGE>::prefix(), out_->metadata_);
+    out_->new_datas_[bstm_data_traits<BSTM_CHANGE>::prefix()] = change_buffer;
+  }
+  else
+    change_buffer = bstm_cache::instance()->get_data_base_new(id,bstm_data_traits<BSTM_CHANGE>::prefix(), change_size);
 
   change_array_ = (bstm_data_traits<BSTM_CHANGE>::datatype*) change_buffer->data_buffer();
 
   int tree_index = 0;
+  bool refined_time_tree = false;
   boxm2_array_3d<uchar16>::const_iterator blk_iter, boxm2_blk_iter;
   for (blk_iter = trees.begin(), boxm2_blk_iter = boxm2_trees.begin(); blk_iter != trees.end(); ++blk_iter, ++boxm2_blk_iter)
   {
@@ -406,8 +425,9 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::ingest()
          int boxm2_data_offset =  boxm2_curr_tree.get_data_index( i_boxm2, false);
 
          //refine all the time trees associated with curr cell.
-         bool refined_time_tree = this->refine_all_time_trees(bstm_data_offset, boxm2_data_offset, dataIndex, currIndex, dataSize,
-                                     curr_tree.depth_at(i), boxm2_curr_tree.depth_at(i_boxm2), is_leaf );
+         if (this->refine_all_time_trees(bstm_data_offset, boxm2_data_offset, dataIndex, currIndex, dataSize,
+                                         curr_tree.depth_at(i), boxm2_curr_tree.depth_at(i_boxm2), is_leaf ))
+           refined_time_tree = true;
          num_processed_cells++;
        }
     }
@@ -416,10 +436,18 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::ingest()
 
   //std::cout << "New data size is " << dataSize << std::endl;
 
+  //no time tree was refined: the data layout is unchanged, so only the
+  //cells of the new frame have to be written.
+  if (!refined_time_tree) {
+    delete[] time_tree_copy_buffer;
+    delete[] dataIndex;
+    this->ingest_in_place();
+    return true;
+  }
 
 
-  bstm_data_base* newA = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_ALPHA>::datasize() ], dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
-  bstm_data_base* newM = new bstm_data_base(new char[dataSize * bstm_data_traits<APM_TYPE>::datasize()], dataSize * bstm_data_traits<APM_TYPE>::datasize(), id);
+  bstm_data_base* newA = bstm_new_data_base(out_, dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
+  bstm_data_base* newM = bstm_new_data_base(out_, dataSize * bstm_data_traits<APM_TYPE>::datasize(), id);
   bstm_data_traits<BSTM_ALPHA>::datatype *   alpha_cpy = (bstm_data_traits<BSTM_ALPHA>::datatype*) newA->data_buffer();
   typename bstm_data_traits<APM_TYPE>::datatype *  apm_cpy   = (typename bstm_data_traits<APM_TYPE>::datatype *) newM->data_buffer();
 
@@ -466,8 +494,8 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::ingest()
   //std::cout<<"Number of new cells: "<<newInitCount<<std::endl;
 
   //replace databases
-  cache->replace_data_base(id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
-  cache->replace_data_base(id, bstm_data_traits<APM_TYPE>::prefix(), newM);
+  bstm_replace_data_base(out_, id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
+  bstm_replace_data_base(out_, id, bstm_data_traits<APM_TYPE>::prefix(), newM);
 
   delete[] time_tree_copy_buffer;
   delete[] dataIndex;
@@ -475,6 +503,52 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::ingest()
   return true;
 }
 
+template <bstm_data_type APM_TYPE, boxm2_data_type BOXM2_APM_TYPE>
+void bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::ingest_in_place()
+{
+  const boxm2_array_3d<uchar16>&  trees = blk_->trees();
+  const boxm2_array_3d<uchar16>&  boxm2_trees = boxm2_blk_->trees();
+  const unsigned int t = blk_t_->tree_index(local_time_);
+  const double trees_local_time = local_time_ - t;
+
+  boxm2_array_3d<uchar16>::const_iterator blk_iter, boxm2_blk_iter;
+  for (blk_iter = trees.begin(), boxm2_blk_iter = boxm2_trees.begin(); blk_iter != trees.end(); ++blk_iter, ++boxm2_blk_iter)
+  {
+     uchar16 tree  = (*blk_iter);
+     boct_bit_tree curr_tree( (unsigned char*) tree.data_block(), max_level_);
+
+     uchar16 boxm2_tree  = (*boxm2_blk_iter);
+     boct_bit_tree boxm2_curr_tree( (unsigned char*) boxm2_tree.data_block(), max_level_);
+
+     int num_cells = curr_tree.num_cells();
+     int num_processed_cells = 0;
+     for (int i=0; i<MAX_CELLS_ && num_processed_cells< num_cells; ++i)
+     {
+       int pi = (i-1)>>3;           //Bit_index of parent bit
+       if ( (i==0) || curr_tree.bit_at(pi) )
+       {
+         int i_boxm2 = i;
+         while ( i_boxm2 != 0 && !boxm2_curr_tree.bit_at( boxm2_curr_tree.parent_index(i_boxm2)) )
+           i_boxm2 = boxm2_curr_tree.parent_index(i_boxm2);
+
+         int bstm_data_offset = curr_tree.get_data_index( i, false);
+         int boxm2_data_offset =  boxm2_curr_tree.get_data_index( i_boxm2, false);
+         int depth_diff = curr_tree.depth_at(i) - boxm2_curr_tree.depth_at(i_boxm2);
+
+         //only the time tree containing the queried time receives data
+         boxm2_array_1d<uchar8> time_trees = blk_t_->get_cell_all_tt(bstm_data_offset);
+         bstm_time_tree time_tree( time_trees[t].data_block(), max_level_t_);
+         float cell_min,cell_max;
+         time_tree.cell_range(time_tree.traverse(trees_local_time), cell_min,cell_max);
+         if ( cell_min == trees_local_time )
+           this->place_curr_data(time_tree, boxm2_data_offset, alpha_, apm_model_, depth_diff);
+         num_processed_cells++;
+       }
+     }
+  }
+  in_place_ = true;
+}
+
 template <bstm_data_type APM_TYPE, boxm2_data_type BOXM2_APM_TYPE>
 int bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::move_all_time_trees_data(boxm2_array_1d<uchar8>& time_trees_blk_copy,
                                                                                          int bstm_data_offset,int boxm2_data_offset,
@@ -544,7 +618,7 @@ bool bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE>::refine_all_time
     else
       newSize = tmp_tree.num_leaves();                                                     //count up the number of cells needed
 
-    if(tmp_tree.num_cells() != newSize)
+    if(tmp_tree.num_leaves() != newSize)
       refined_any_time_tree = true;
 
     dataSize += newSize;
@@ -1,8 +1,56 @@
 #include <iostream>
 #include <set>
 #include "bstm_merge_tt_function.h"
+#include <vpl/vpl_parallel_for.h>
 #include <vcl_compiler.h>
 
+//: merges a range of time trees (merge pass) or moves their data to the new buffers (move pass)
+//  Time trees are independent and own disjoint ranges of the new buffers, so ranges can be processed concurrently.
+class bstm_merge_tt_function::move_data_body : public vpl_parallel_for_body
+{
+ public:
+  bstm_merge_tt_function* f;
+  bool merge_pass;
+  boxm2_array_1d<uchar8>* old_time_trees;
+  uchar8* trees_copy;
+  int* dataIndex;   // number of leaves of the merged trees in the merge pass
+  int* old_sizes;
+  char* depths;
+  bstm_data_traits<BSTM_ALPHA>::datatype* alpha_cpy;
+  bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datatype* mog_cpy;
+  bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datatype* numobs_cpy;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned i = begin; i < end; ++i)
+    {
+      //1. get old time tree
+      bstm_time_tree old_tree((unsigned char*) (*old_time_trees)[i].data_block(), f->max_level_t_);
+      if (merge_pass) {
+        //2. merge time tree
+        bstm_time_tree new_time_tree = f->merge_tt(old_tree, depths[i]);
+        //3. copy new tree into trees_copy
+        std::memcpy (trees_copy[i].data_block(), new_time_tree.get_bits(), TT_NUM_BYTES);
+        //4. account new datasize
+        dataIndex[i] = new_time_tree.num_leaves();
+        old_sizes[i] = old_tree.num_leaves();
+        continue;
+      }
+      //2. merged tree
+      bstm_time_tree merged_tree( (unsigned char*) trees_copy[i].data_block(), f->max_level_t_);
+
+      //2.5 pack data bits into merged tree
+      merged_tree.set_data_ptr(dataIndex[i]);
+
+      //3. swap data from old location to new location
+      f->move_data(old_tree, merged_tree, depths[i], alpha_cpy, mog_cpy, numobs_cpy);
+
+      //4. store old tree in new tree, swap data out
+      std::memcpy((*old_time_trees)[i].data_block(), merged_tree.get_bits(), TT_NUM_BYTES);
+    }
+  }
+};
+
 bool bstm_merge_tt_function::init_data(bstm_time_block* blk_t, bstm_block* blk, std::vector<bstm_data_base*> & datas, float prob_thresh)
 {
   //store block and pointer to uchar16 3d block
@@ -67,7 +115,8 @@ bool bstm_merge_tt_function::init_data(bstm_time_block* blk_t, bstm_block* blk,
 }
 
 
-bool bstm_merge_tt_function::merge(std::vector<bstm_data_base*>& datas)
+bool bstm_merge_tt_function::merge(std::vector<bstm_data_base*>& datas,
+                                   bstm_block_replacement* out, unsigned num_threads)
 {
   //1. loop over each tree to save spatial depth of each time tree
   boxm2_array_1d<uchar8>&  old_time_trees = blk_t_->time_trees();    //old time trees
@@ -96,35 +145,36 @@ bool bstm_merge_tt_function::merge(std::vector<bstm_data_base*>& datas)
 
 
   //2. loop over time trees to merge them
-  boxm2_array_1d<uchar8>::iterator old_time_trees_iter;
   uchar8* trees_copy = new uchar8[old_time_trees.size()];  //copy of time trees
   int* dataIndex = new int[old_time_trees.size()]; //data index for each new tree
-  int currIndex = 0;                                //curr tree being looked at
+  int* old_sizes = new int[old_time_trees.size()];
+  move_data_body body;
+  body.f = this;
+  body.merge_pass = true;
+  body.old_time_trees = &old_time_trees;
+  body.trees_copy = trees_copy;
+  body.dataIndex = dataIndex;
+  body.old_sizes = old_sizes;
+  body.depths = depths;
+  vpl_parallel_for((unsigned)old_time_trees.size(), body, num_threads, 4096);
+
+  //  turn the sizes into data indices
   int dataSize = 0;                                 //running sum of data size
   int old_dataSize = 0;
-  for (old_time_trees_iter = old_time_trees.begin(); old_time_trees_iter != old_time_trees.end(); ++old_time_trees_iter, ++currIndex)
+  for (unsigned currIndex = 0; currIndex < old_time_trees.size(); ++currIndex)
   {
-      //0. store data index for each tree.
-      dataIndex[currIndex] = dataSize;
-      //1. get old time tree
-      bstm_time_tree old_time_tree((unsigned char*) (*old_time_trees_iter).data_block(), max_level_t_);
-      //2. merge time tree
-      bstm_time_tree new_time_tree = this->merge_tt(old_time_tree, depths[currIndex]);
-      //3. copy new tree into trees_copy
-      std::memcpy (trees_copy[currIndex].data_block(), new_time_tree.get_bits(), TT_NUM_BYTES);
-      //4. account new datasize
-      dataSize += new_time_tree.num_leaves();
-      old_dataSize += old_time_tree.num_leaves();
+    int newSize = dataIndex[currIndex];
+    dataIndex[currIndex] = dataSize;
+    dataSize += newSize;
+    old_dataSize += old_sizes[currIndex];
   }
+  delete[] old_sizes;
 
   //3. alloc new buffers
   bstm_block_id id = blk_->block_id();
-  bstm_data_base* newA = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_ALPHA>::datasize() ],
-                                                      dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
-  bstm_data_base* newM = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize() ],
-                                                      dataSize * bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize() , id);
-  bstm_data_base* newN = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize() ],
-                                                      dataSize * bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize(), id);
+  bstm_data_base* newA = bstm_new_data_base(out, dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
+  bstm_data_base* newM = bstm_new_data_base(out, dataSize * bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize(), id);
+  bstm_data_base* newN = bstm_new_data_base(out, dataSize * bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize(), id);
   bstm_data_traits<BSTM_ALPHA>::datatype *   alpha_cpy = (bstm_data_traits<BSTM_ALPHA>::datatype *) newA->data_buffer();
   bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datatype *  mog_cpy = (bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datatype *) newM->data_buffer();
   bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datatype *  numobs_cpy = (bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datatype *) newN->data_buffer();
@@ -133,34 +183,18 @@ bool bstm_merge_tt_function::merge(std::vector<bstm_data_base*>& datas)
 
   std::cout << "Num elements saved: " << old_dataSize - dataSize << "." << std::endl;
 
-  //43. loop through trees again, putting the time trees in the right place as well as refining the time trees
-  currIndex = 0;
-  for (old_time_trees_iter = old_time_trees.begin(); old_time_trees_iter != old_time_trees.end(); ++old_time_trees_iter, ++currIndex)
-  {
-      //1. get current tree information
-      bstm_time_tree old_tree( (unsigned char*) (*old_time_trees_iter).data_block(), max_level_t_);
-
-      //2. merged tree
-      bstm_time_tree merged_tree( (unsigned char*) trees_copy[currIndex].data_block(), max_level_t_);
-
-      //2.5 pack data bits into merged tree
-      //store data index in bits [10, 11, 12, 13] ;
-      int root_index = dataIndex[currIndex];
-      merged_tree.set_data_ptr(root_index);
-
-      //3. swap data from old location to new location
-      this->move_data(old_tree, merged_tree,  depths[currIndex], alpha_cpy, mog_cpy, numobs_cpy);
-
-      //4. store old tree in new tree, swap data out
-      std::memcpy(old_time_trees_iter, merged_tree.get_bits(), TT_NUM_BYTES);
-  }
+  //4. loop through trees again, moving the data to the merged time trees
+  body.merge_pass = false;
+  body.alpha_cpy = alpha_cpy;
+  body.mog_cpy = mog_cpy;
+  body.numobs_cpy = numobs_cpy;
+  vpl_parallel_for((unsigned)old_time_trees.size(), body, num_threads, 4096);
 
 
-  //5. update cache, replace time trees
-  bstm_cache_sptr cache = bstm_cache::instance();
-  cache->replace_data_base(id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
-  cache->replace_data_base(id, bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix(), newM);
-  cache->replace_data_base(id, bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::prefix(), newN);
+  //5. update cache (or out), replace data
+  bstm_replace_data_base(out, id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
+  bstm_replace_data_base(out, id, bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix(), newM);
+  bstm_replace_data_base(out, id, bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::prefix(), newN);
 
   delete[] trees_copy;
   delete[] dataIndex;
@@ -278,9 +312,11 @@ bstm_time_tree bstm_merge_tt_function::merge_tt(const bstm_time_tree& old_tree,
 ////////////////////////////////////////////////////////////////////////////////
 void bstm_merge_tt_blk(bstm_time_block* t_blk, bstm_block* blk,
                           std::vector<bstm_data_base*> & datas,
-                          float prob_thresh)
+                          float prob_thresh,
+                          bstm_block_replacement* out,
+                          unsigned num_threads)
 {
   bstm_merge_tt_function merge_block;
   merge_block.init_data(t_blk, blk, datas, prob_thresh);
-  merge_block.merge(datas);
+  merge_block.merge(datas, out, num_threads);
 }
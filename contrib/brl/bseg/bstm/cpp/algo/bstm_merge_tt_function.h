@@ -13,6 +13,7 @@
 #include <vnl/vnl_vector_fixed.h>
 #include <vcl_compiler.h>
 #include <bstm/io/bstm_cache.h>
+#include <bstm/cpp/algo/bstm_data_pool.h>
 
 class bstm_merge_tt_function
 {
@@ -29,9 +30,14 @@ class bstm_merge_tt_function
   //: initialize generic data base pointers as their data type
   bool init_data(bstm_time_block* t_blk, bstm_block* blk, std::vector<bstm_data_base*> & datas, float prob_thresh);
 
-  bool merge(std::vector<bstm_data_base*>& datas);
+  //: merge the time trees of the block
+  //  If out is not null the new data are stored in out instead of the cache
+  //  (see bstm_data_pool).  The time trees are processed by up to num_threads threads.
+  bool merge(std::vector<bstm_data_base*>& datas, bstm_block_replacement* out = VXL_NULLPTR,
+             unsigned num_threads = 1);
 
  private:
+  class move_data_body;
 
   //merge time tree
   bstm_time_tree merge_tt(const bstm_time_tree& old_tree, int curr_depth);
@@ -70,6 +76,8 @@ class bstm_merge_tt_function
 ////////////////////////////////////////////////////////////////////////////////
 void bstm_merge_tt_blk( bstm_time_block* t_blk, bstm_block* blk,
                          std::vector<bstm_data_base*> & datas,
-                         float prob_thresh);
+                         float prob_thresh,
+                         bstm_block_replacement* out = VXL_NULLPTR,
+                         unsigned num_threads = 1);
 
 #endif //bstm_merge_tt_function_h
@@ -0,0 +1,222 @@
+#include <iostream>
+#include <vector>
+#include <map>
+#include "bstm_parallel_driver.h"
+//:
+// \file
+#include <bstm/cpp/algo/bstm_refine_blk_in_spacetime_function.h>
+#include <bstm/cpp/algo/bstm_merge_tt_function.h>
+#include <bstm/cpp/algo/bstm_ingest_boxm2_scene_function.h>
+#include <vpl/vpl_parallel_for.h>
+#include <vcl_compiler.h>
+
+namespace
+{
+  //: everything a worker needs to process one block
+  struct block_task
+  {
+    block_task(bstm_block_metadata const& m, bstm_data_pool* pool)
+    : out(m, pool), blk(VXL_NULLPTR), blk_t(VXL_NULLPTR), boxm2_blk(VXL_NULLPTR),
+      local_time(0.0), in_place(false) {}
+
+    bstm_block_replacement out;
+    bstm_block* blk;
+    bstm_time_block* blk_t;
+    std::vector<bstm_data_base*> datas;
+    std::map<std::string, bstm_data_base*> data_map;
+    boxm2_block* boxm2_blk;
+    std::map<std::string, boxm2_data_base*> boxm2_datas;
+    double local_time;
+    bool in_place;
+  };
+
+  //: the threads left for each block when all blocks are processed concurrently
+  unsigned threads_per_block(unsigned num_threads, unsigned num_blocks)
+  {
+    unsigned n = vpl_parallel_for_num_threads(num_threads);
+    return num_blocks >= n ? 1 : n / num_blocks;
+  }
+
+  class refine_body : public vpl_parallel_for_body
+  {
+   public:
+    std::vector<block_task*>* tasks;
+    float prob_thresh;
+    bool merge;
+    unsigned inner_threads;
+
+    void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+    {
+      for (unsigned i = begin; i < end; ++i) {
+        block_task& t = *(*tasks)[i];
+        if (merge)
+          bstm_merge_tt_blk(t.blk_t, t.blk, t.datas, prob_thresh, &t.out, inner_threads);
+        else
+          bstm_refine_block_spacetime(t.blk_t, t.blk, t.datas, prob_thresh, &t.out, inner_threads);
+      }
+    }
+  };
+
+  template <bstm_data_type APM_TYPE, boxm2_data_type BOXM2_APM_TYPE>
+  bool ingest_block(block_task& t, double p_threshold, double app_threshold)
+  {
+    bstm_ingest_boxm2_scene_function<APM_TYPE, BOXM2_APM_TYPE> f(t.blk, t.blk_t, t.data_map, t.boxm2_blk, t.boxm2_datas,
+                                                                 t.local_time, p_threshold, app_threshold, &t.out);
+    return f.ingested_in_place();
+  }
+
+  typedef bool (*ingest_fn)(block_task&, double, double);
+
+  class ingest_body : public vpl_parallel_for_body
+  {
+   public:
+    std::vector<block_task*>* tasks;
+    ingest_fn fn;
+    double p_threshold;
+    double app_threshold;
+
+    void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+    {
+      for (unsigned i = begin; i < end; ++i)
+        (*tasks)[i]->in_place = fn(*(*tasks)[i], p_threshold, app_threshold);
+    }
+  };
+}
+
+bstm_parallel_driver::bstm_parallel_driver(bstm_scene_sptr scene, bstm_cache_sptr cache,
+                                           unsigned num_threads, bstm_data_pool* pool)
+: scene_(scene), cache_(cache), num_threads_(num_threads),
+  pool_(pool ? pool : &own_pool_), num_in_place_(0)
+{
+}
+
+void bstm_parallel_driver::refine_spacetime(double time, float prob_thresh)
+{
+  this->refine_or_merge(time, prob_thresh, false);
+}
+
+void bstm_parallel_driver::merge_tt(double time, float prob_thresh)
+{
+  this->refine_or_merge(time, prob_thresh, true);
+}
+
+void bstm_parallel_driver::refine_or_merge(double time, float prob_thresh, bool merge)
+{
+  //1. load the blocks containing time
+  std::vector<block_task*> tasks;
+  std::map<bstm_block_id, bstm_block_metadata> blocks = scene_->blocks();
+  std::map<bstm_block_id, bstm_block_metadata>::iterator blk_iter;
+  for (blk_iter = blocks.begin(); blk_iter != blocks.end(); ++blk_iter)
+  {
+    bstm_block_id id = blk_iter->first;
+    double local_time;
+    if (!blk_iter->second.contains_t(time,local_time))
+      continue;
+
+    block_task* t = new block_task(blk_iter->second, pool_);
+    t->blk   = cache_->get_block(id);
+    t->blk_t = cache_->get_time_block(id);
+    bstm_data_base * alph    = cache_->get_data_base(id,bstm_data_traits<BSTM_ALPHA>::prefix());
+    int num_el = alph->buffer_length() / bstm_data_traits<BSTM_ALPHA>::datasize();
+    t->datas.push_back(alph);
+    t->datas.push_back(cache_->get_data_base(id,bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix(), bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize() * num_el));
+    t->datas.push_back(cache_->get_data_base(id,bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::prefix(),bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize() * num_el));
+    tasks.push_back(t);
+  }
+  if (tasks.empty())
+    return;
+
+  //2. process them concurrently
+  refine_body body;
+  body.tasks = &tasks;
+  body.prob_thresh = prob_thresh;
+  body.merge = merge;
+  body.inner_threads = threads_per_block(num_threads_, (unsigned)tasks.size());
+  vpl_parallel_for((unsigned)tasks.size(), body, num_threads_);
+
+  //3. swap the results into the cache
+  for (unsigned i = 0; i < tasks.size(); ++i) {
+    pool_->commit(*cache_, tasks[i]->out);
+    delete tasks[i];
+  }
+}
+
+bool bstm_parallel_driver::ingest(boxm2_scene_sptr boxm2_scene, boxm2_cache_sptr boxm2_cache,
+                                  std::string const& data_type, std::string const& boxm2_data_type,
+                                  double time, double p_threshold, double app_threshold)
+{
+  num_in_place_ = 0;
+
+  ingest_fn fn = VXL_NULLPTR;
+  if (boxm2_data_type == boxm2_data_traits<BOXM2_MOG3_GREY>::prefix() && data_type == bstm_data_traits<BSTM_MOG3_GREY>::prefix())
+    fn = &ingest_block<BSTM_MOG3_GREY, BOXM2_MOG3_GREY>;
+  else if (boxm2_data_type == boxm2_data_traits<BOXM2_MOG6_VIEW>::prefix() && data_type == bstm_data_traits<BSTM_MOG6_VIEW>::prefix())
+    fn = &ingest_block<BSTM_MOG6_VIEW, BOXM2_MOG6_VIEW>;
+  else if (boxm2_data_type == boxm2_data_traits<BOXM2_MOG6_VIEW_COMPACT>::prefix() && data_type == bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix())
+    fn = &ingest_block<BSTM_MOG6_VIEW_COMPACT, BOXM2_MOG6_VIEW_COMPACT>;
+  else if (boxm2_data_type == boxm2_data_traits<BOXM2_GAUSS_RGB>::prefix() && data_type == bstm_data_traits<BSTM_GAUSS_RGB>::prefix())
+    fn = &ingest_block<BSTM_GAUSS_RGB, BOXM2_GAUSS_RGB>;
+  else if (boxm2_data_type == boxm2_data_traits<BOXM2_GAUSS_RGB_VIEW_COMPACT>::prefix() && data_type == bstm_data_traits<BSTM_GAUSS_RGB_VIEW_COMPACT>::prefix())
+    fn = &ingest_block<BSTM_GAUSS_RGB_VIEW_COMPACT, BOXM2_GAUSS_RGB_VIEW_COMPACT>;
+  else {
+    std::cerr << "bstm_parallel_driver::ingest ERROR! appearance models do not match, boxm2_data_type: "
+              << boxm2_data_type << " bstm_data_type: " << data_type << std::endl;
+    return false;
+  }
+
+  //1. load the matching blocks of both scenes
+  std::vector<block_task*> tasks;
+  std::map<bstm_block_id, bstm_block_metadata> blocks = scene_->blocks();
+  std::map<boxm2_block_id, boxm2_block_metadata> boxm2_blocks = boxm2_scene->blocks();
+  std::map<boxm2_block_id, boxm2_block_metadata>::const_iterator iter;
+  for (iter = boxm2_blocks.begin(); iter != boxm2_blocks.end(); ++iter)
+  {
+    boxm2_block_id boxm2_id = iter->first;
+    std::map<bstm_block_id, bstm_block_metadata>::const_iterator bstm_iter;
+    for (bstm_iter = blocks.begin(); bstm_iter != blocks.end(); ++bstm_iter)
+    {
+      bstm_block_metadata const& bstm_metadata = bstm_iter->second;
+      if (!(bstm_iter->first == boxm2_id))
+        continue;
+      if (!(bstm_metadata == iter->second)) {
+        std::cerr << "bstm scene and boxm2 scene are not consistent! block " << boxm2_id << " metadata not consistent!\n";
+        for (unsigned i = 0; i < tasks.size(); ++i)
+          delete tasks[i];
+        return false;
+      }
+      double local_time;
+      if (!bstm_metadata.contains_t(time,local_time))
+        continue;
+
+      block_task* t = new block_task(bstm_metadata, pool_);
+      t->local_time = local_time;
+      t->blk   = cache_->get_block(bstm_metadata.id_);
+      t->blk_t = cache_->get_time_block(bstm_metadata.id_);
+      t->data_map[bstm_data_traits<BSTM_ALPHA>::prefix()] = cache_->get_data_base(bstm_metadata.id_, bstm_data_traits<BSTM_ALPHA>::prefix());
+      t->data_map[data_type] = cache_->get_data_base(bstm_metadata.id_, data_type);
+      t->boxm2_blk = boxm2_cache->get_block(boxm2_scene, boxm2_id);
+      t->boxm2_datas[boxm2_data_traits<BOXM2_ALPHA>::prefix()] = boxm2_cache->get_data_base(boxm2_scene, boxm2_id, boxm2_data_traits<BOXM2_ALPHA>::prefix());
+      t->boxm2_datas[boxm2_data_type] = boxm2_cache->get_data_base(boxm2_scene, boxm2_id, boxm2_data_type);
+      tasks.push_back(t);
+    }
+  }
+  if (tasks.empty())
+    return true;
+
+  //2. ingest them concurrently
+  ingest_body body;
+  body.tasks = &tasks;
+  body.fn = fn;
+  body.p_threshold = p_threshold;
+  body.app_threshold = app_threshold;
+  vpl_parallel_for((unsigned)tasks.size(), body, num_threads_);
+
+  //3. swap the results into the cache
+  for (unsigned i = 0; i < tasks.size(); ++i) {
+    if (tasks[i]->in_place)
+      ++num_in_place_;
+    pool_->commit(*cache_, tasks[i]->out);
+    delete tasks[i];
+  }
+  return true;
+}
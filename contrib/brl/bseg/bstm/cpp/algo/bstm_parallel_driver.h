@@ -0,0 +1,74 @@
+#ifndef bstm_parallel_driver_h_
+#define bstm_parallel_driver_h_
+//:
+// \file
+// \brief Runs the space-time refine, merge and ingest functions on many blocks concurrently.
+//
+// The blocks of a bstm scene are independent, so the driver loads every block
+// that contains the requested time (the caches are not thread safe, so this
+// is done serially), processes the blocks on a team of threads and finally
+// swaps the new time blocks and data into the cache in block order.  When
+// there are fewer blocks than threads, the remaining threads work on ranges of
+// time trees within each block.  The buffers of the replaced data are kept in
+// a bstm_data_pool and reused for the next blocks or time steps.
+//
+// Ingest writes a new frame into the existing buffers when none of the time
+// trees of a block have to be refined (see bstm_ingest_boxm2_scene_function),
+// so appending a frame that matches the stored model does not rewrite the
+// block.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <string>
+#include <bstm/bstm_scene.h>
+#include <bstm/io/bstm_cache.h>
+#include <boxm2/boxm2_scene.h>
+#include <boxm2/io/boxm2_cache.h>
+#include <bstm/cpp/algo/bstm_data_pool.h>
+#include <vcl_compiler.h>
+
+class bstm_parallel_driver
+{
+ public:
+  //: num_threads = 0 means one thread per processor
+  //  If pool is null the driver uses a pool of its own.
+  bstm_parallel_driver(bstm_scene_sptr scene, bstm_cache_sptr cache,
+                       unsigned num_threads = 0, bstm_data_pool* pool = VXL_NULLPTR);
+
+  void set_num_threads(unsigned num_threads) { num_threads_ = num_threads; }
+
+  //: bstm_refine_block_spacetime() on all blocks containing time
+  //  The scene must have BSTM_MOG6_VIEW_COMPACT and BSTM_NUM_OBS_VIEW_COMPACT data.
+  void refine_spacetime(double time, float prob_thresh);
+
+  //: bstm_merge_tt_blk() on all blocks containing time
+  void merge_tt(double time, float prob_thresh);
+
+  //: Ingest the boxm2 scene as the frame at time
+  //  data_type and boxm2_data_type are the appearance prefixes of the two
+  //  scenes, which must be one of the pairs supported by
+  //  bstm_cpp_ingest_boxm2_scene_process.  Returns false if they are not.
+  bool ingest(boxm2_scene_sptr boxm2_scene, boxm2_cache_sptr boxm2_cache,
+              std::string const& data_type, std::string const& boxm2_data_type,
+              double time, double p_threshold, double app_threshold);
+
+  //: Number of blocks of the last ingest() that were updated in place
+  unsigned num_ingested_in_place() const { return num_in_place_; }
+
+  bstm_data_pool& pool() { return *pool_; }
+
+ private:
+  bstm_scene_sptr scene_;
+  bstm_cache_sptr cache_;
+  unsigned num_threads_;
+  bstm_data_pool own_pool_;
+  bstm_data_pool* pool_;
+  unsigned num_in_place_;
+
+  //: refine_spacetime() or merge_tt()
+  void refine_or_merge(double time, float prob_thresh, bool merge);
+};
+
+#endif // bstm_parallel_driver_h_
@@ -2,8 +2,40 @@
 #include <algorithm>
 #include "bstm_refine_blk_in_spacetime_function.h"
 #include <bstm/io/bstm_lru_cache.h>
+#include <vpl/vpl_parallel_for.h>
 #include <vcl_compiler.h>
 
+//: moves the data of a range of time trees to the new buffers
+//  Every time tree owns a disjoint range of the new buffers, so ranges can be moved concurrently.
+class bstm_refine_blk_in_spacetime_function::move_data_body : public vpl_parallel_for_body
+{
+ public:
+  bstm_refine_blk_in_spacetime_function* f;
+  boxm2_array_1d<uchar8>* refined_trees;
+  boxm2_array_1d<uchar8>* unrefined_trees;
+  int* dataIndex;
+  char* depths;
+  bstm_data_traits<BSTM_ALPHA>::datatype* alpha_cpy;
+  bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datatype* mog_cpy;
+  bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datatype* numobs_cpy;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned i = begin; i < end; ++i)
+    {
+      //1. get refined and unrefined tree
+      bstm_time_tree refined_time_tree((unsigned char*) (*refined_trees)[i].data_block(), f->max_level_t_);
+      bstm_time_tree unrefined_time_tree((unsigned char*) (*unrefined_trees)[i].data_block(), f->max_level_t_);
+      //2. correct data ptr
+      refined_time_tree.set_data_ptr(dataIndex[i]);
+      //3. save it back to newRefinedTimeBlk
+      std::memcpy((*refined_trees)[i].data_block(), refined_time_tree.get_bits(), TT_NUM_BYTES);
+      //4. move the data
+      f->move_data(unrefined_time_tree, refined_time_tree, alpha_cpy, mog_cpy, numobs_cpy, (int)( depths[i / f->sub_block_num_t_]) );
+    }
+  }
+};
+
 
 bool bstm_refine_blk_in_spacetime_function::init_data(bstm_time_block* blk_t, bstm_block* blk, std::vector<bstm_data_base*> & datas, float prob_thresh)
 {
@@ -72,7 +104,8 @@ bool bstm_refine_blk_in_spacetime_function::init_data(bstm_time_block* blk_t, bs
    return true;
 }
 
-bool bstm_refine_blk_in_spacetime_function::refine(std::vector<bstm_data_base*>& datas)
+bool bstm_refine_blk_in_spacetime_function::refine(std::vector<bstm_data_base*>& datas,
+                                                   bstm_block_replacement* out, unsigned num_threads)
 {
 
   //1. loop over each tree, refine it in place
@@ -147,7 +180,7 @@ bool bstm_refine_blk_in_spacetime_function::refine(std::vector<bstm_data_base*>&
   //4. figure out new data size
   boxm2_array_1d<uchar8>&  new_refined_time_trees = newRefinedTimeBlk->time_trees();    //refined new time trees
   boxm2_array_1d<uchar8>&  new_unrefined_time_trees = newTimeBlk->time_trees();         //unrefined new time treesunrefined_time_tree
-  boxm2_array_1d<uchar8>::iterator refined_time_trees_iter, unrefined_time_trees_iter;
+  boxm2_array_1d<uchar8>::iterator refined_time_trees_iter;
   dataIndex = new int[new_refined_time_trees.size()];                  //data index for each new tree
   currIndex = 0;                                                        //curr tree being looked at
   dataSize = 0;
@@ -163,41 +196,31 @@ bool bstm_refine_blk_in_spacetime_function::refine(std::vector<bstm_data_base*>&
   std::cout << "New data size: " << dataSize << std::endl;
 
   //alloc new buffers
-  bstm_data_base* newA = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_ALPHA>::datasize() ],
-                                                      dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
-  bstm_data_base* newM = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize() ],
-                                                      dataSize * bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize() , id);
-  bstm_data_base* newN = new bstm_data_base(new char[dataSize * bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize() ],
-                                                      dataSize * bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize(), id);
+  bstm_data_base* newA = bstm_new_data_base(out, dataSize * bstm_data_traits<BSTM_ALPHA>::datasize(), id);
+  bstm_data_base* newM = bstm_new_data_base(out, dataSize * bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize(), id);
+  bstm_data_base* newN = bstm_new_data_base(out, dataSize * bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize(), id);
   bstm_data_traits<BSTM_ALPHA>::datatype *   alpha_cpy = (bstm_data_traits<BSTM_ALPHA>::datatype *) newA->data_buffer();
   bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datatype *  mog_cpy = ( bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datatype *) newM->data_buffer();
   bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datatype *  numobs_cpy = (bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datatype *) newN->data_buffer();
 
 
   //5. move data from old data buffers to new data buffers
-  currIndex = 0;
-  for (refined_time_trees_iter = new_refined_time_trees.begin(), unrefined_time_trees_iter = new_unrefined_time_trees.begin();
-        refined_time_trees_iter != new_refined_time_trees.end(); ++refined_time_trees_iter, ++currIndex, ++unrefined_time_trees_iter)
-  {
-      //1. get refined and unrefined tree
-      bstm_time_tree refined_time_tree((unsigned char*) (*refined_time_trees_iter).data_block(), max_level_t_);
-      bstm_time_tree unrefined_time_tree((unsigned char*) (*unrefined_time_trees_iter).data_block(), max_level_t_);
-      //2. correct data ptr
-      refined_time_tree.set_data_ptr(dataIndex[currIndex]);
-      //3. save it back to newRefinedTimeBlk
-      std::memcpy(refined_time_trees_iter, refined_time_tree.get_bits(), TT_NUM_BYTES);
-      //4. move the data
-      this->move_data(unrefined_time_tree, refined_time_tree, alpha_cpy, mog_cpy, numobs_cpy, (int)( depths[currIndex / sub_block_num_t_]) );
-  }
-
-
-
-  //6. update cache, replace time trees
-  bstm_cache_sptr cache = bstm_cache::instance();
-  cache->replace_time_block(id, newRefinedTimeBlk);
-  cache->replace_data_base(id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
-  cache->replace_data_base(id, bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix(), newM);
-  cache->replace_data_base(id, bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::prefix(), newN);
+  move_data_body body;
+  body.f = this;
+  body.refined_trees = &new_refined_time_trees;
+  body.unrefined_trees = &new_unrefined_time_trees;
+  body.dataIndex = dataIndex;
+  body.depths = depths;
+  body.alpha_cpy = alpha_cpy;
+  body.mog_cpy = mog_cpy;
+  body.numobs_cpy = numobs_cpy;
+  vpl_parallel_for((unsigned)new_refined_time_trees.size(), body, num_threads, 4096);
+
+  //6. update cache (or out), replace time trees
+  bstm_replace_time_block(out, id, newRefinedTimeBlk);
+  bstm_replace_data_base(out, id, bstm_data_traits<BSTM_ALPHA>::prefix(), newA);
+  bstm_replace_data_base(out, id, bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix(), newM);
+  bstm_replace_data_base(out, id, bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::prefix(), newN);
 
   delete[] dataIndex;
   delete newTimeBlk;
@@ -434,10 +457,12 @@ boct_bit_tree bstm_refine_blk_in_spacetime_function::refine_bit_tree(const boct_
 ////////////////////////////////////////////////////////////////////////////////
 void bstm_refine_block_spacetime(bstm_time_block* t_blk, bstm_block* blk,
                         std::vector<bstm_data_base*> & datas,
-                        float prob_thresh)
+                        float prob_thresh,
+                        bstm_block_replacement* out,
+                        unsigned num_threads)
 {
   bstm_refine_blk_in_spacetime_function refine_block;
   refine_block.init_data(t_blk, blk, datas, prob_thresh);
 
-  refine_block.refine(datas);
+  refine_block.refine(datas, out, num_threads);
 }
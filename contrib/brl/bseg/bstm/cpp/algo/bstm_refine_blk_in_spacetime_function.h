@@ -13,6 +13,7 @@
 #include <vnl/vnl_vector_fixed.h>
 #include <vcl_compiler.h>
 #include <bstm/io/bstm_cache.h>
+#include <bstm/cpp/algo/bstm_data_pool.h>
 
 class bstm_refine_blk_in_spacetime_function
 {
@@ -29,9 +30,15 @@ class bstm_refine_blk_in_spacetime_function
   //: initialize generic data base pointers as their data type
   bool init_data(bstm_time_block* t_blk, bstm_block* blk, std::vector<bstm_data_base*> & datas, float prob_thresh);
 
-  bool refine(std::vector<bstm_data_base*>& datas);
+  //: refine the block
+  //  If out is not null the new time block and data are stored in out instead
+  //  of the cache (see bstm_data_pool).  The data of the time trees is moved
+  //  by up to num_threads threads.
+  bool refine(std::vector<bstm_data_base*>& datas, bstm_block_replacement* out = VXL_NULLPTR,
+              unsigned num_threads = 1);
 
  private:
+  class move_data_body;
 
   //: refine input tree and return refined tree
   boct_bit_tree refine_bit_tree(const boct_bit_tree& input_tree);
@@ -86,6 +93,8 @@ class bstm_refine_blk_in_spacetime_function
 ////////////////////////////////////////////////////////////////////////////////
 void bstm_refine_block_spacetime( bstm_time_block* t_blk, bstm_block* blk,
                          std::vector<bstm_data_base*> & datas,
-                         float prob_thresh);
+                         float prob_thresh,
+                         bstm_block_replacement* out = VXL_NULLPTR,
+                         unsigned num_threads = 1);
 
 #endif //bstm_refine_blk_in_spacetime_function_h
@@ -0,0 +1,59 @@
+#include <iostream>
+#include <testlib/testlib_test.h>
+
+#include <bstm/cpp/algo/bstm_data_pool.h>
+
+#include <vcl_compiler.h>
+
+void test_data_pool()
+{
+  bstm_data_pool pool;
+
+  //a released buffer is handed out again for a request of a similar size
+  char* a = pool.allocate(1000);
+  pool.release(a, 1000);
+  TEST_EQUAL("released bytes are kept", pool.free_bytes(), 1000);
+  char* b = pool.allocate(900);
+  TEST("similar size reuses the buffer", b == a, true);
+  TEST_EQUAL("no unused buffers left", pool.free_bytes(), 0);
+  TEST_EQUAL("one buffer reused", pool.num_reused(), 1);
+
+  //but neither a much smaller nor a larger one
+  pool.release(b, 1000);
+  char* c = pool.allocate(100);
+  char* d = pool.allocate(2000);
+  TEST("small request does not waste a large buffer", c != b && d != b, true);
+  TEST_EQUAL("three buffers allocated", pool.num_allocated(), 3);
+  delete [] c;
+  delete [] d;
+
+  //data bases give their buffers back when recycled
+  bstm_block_id id(0,0,0,0);
+  bstm_data_base* data = pool.new_data_base(1000, id);
+  TEST("data base from the pool", data->data_buffer() == b && data->buffer_length() == 1000, true);
+  pool.recycle(data);
+  TEST_EQUAL("recycled buffer is kept", pool.free_bytes(), 1000);
+
+  //a limited pool frees what does not fit
+  bstm_data_pool small_pool(1500);
+  small_pool.release(new char[1000], 1000);
+  small_pool.release(new char[1000], 1000);
+  TEST_EQUAL("limited pool", small_pool.free_bytes(), 1000);
+
+  //deferred replacements: the second data of a type replaces (and recycles) the first
+  bstm_block_metadata mdata;
+  mdata.id_ = id;
+  bstm_block_replacement out(mdata, &pool);
+  bstm_data_base* first = bstm_new_data_base(&out, 1000, id);
+  char* first_buf = first->data_buffer();
+  bstm_replace_data_base(&out, id, "alpha", first);
+  bstm_data_base* second = bstm_new_data_base(&out, 400, id);
+  bstm_replace_data_base(&out, id, "alpha", second);
+  TEST("replacement keeps the last data", out.datas_.size() == 1 && out.datas_["alpha"] == second, true);
+  char* again = pool.allocate(1000);
+  TEST("replaced data was recycled", again == first_buf, true);
+  delete [] again;
+  delete second;
+}
+
+TESTMAIN(test_data_pool);
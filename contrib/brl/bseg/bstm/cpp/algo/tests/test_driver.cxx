@@ -2,10 +2,12 @@
 
 
 DECLARE( test_time_tree_ingestion);
+DECLARE( test_data_pool );
 
 void register_tests()
 {
   REGISTER( test_time_tree_ingestion );
+  REGISTER( test_data_pool );
 
 
 }
@@ -1,5 +1,7 @@
 #include <bstm/cpp/algo/bstm_data_similarity_traits.h>
 #include <bstm/cpp/algo/bstm_ingest_boxm2_scene_function.h>
 #include <bstm/cpp/algo/bstm_label_bb_function.h>
+#include <bstm/cpp/algo/bstm_data_pool.h>
+#include <bstm/cpp/algo/bstm_parallel_driver.h>
 
 int main() { return 0; }
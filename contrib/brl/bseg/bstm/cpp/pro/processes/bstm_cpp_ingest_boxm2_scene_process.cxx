@@ -17,7 +17,7 @@
 #include <bstm/bstm_data_base.h>
 //brdb stuff
 #include <brdb/brdb_value.h>
-#include <bstm/cpp/algo/bstm_ingest_boxm2_scene_function.h>
+#include <bstm/cpp/algo/bstm_parallel_driver.h>
 
 //directory utility
 #include <vcl_where_root_dir.h>
@@ -32,6 +32,13 @@ namespace bstm_cpp_ingest_boxm2_scene_process_globals
 {
   const unsigned n_inputs_ =  7;
   const unsigned n_outputs_ = 0;
+
+  //: data buffers recycled between the ingested time steps (at most 256MB are kept)
+  bstm_data_pool& data_pool()
+  {
+    static bstm_data_pool pool(std::size_t(256) << 20);
+    return pool;
+  }
 }
 
 bool bstm_cpp_ingest_boxm2_scene_process_cons(bprb_func_process& pro)
@@ -107,87 +114,10 @@ bool bstm_cpp_ingest_boxm2_scene_process(bprb_func_process& pro)
     return false;
   }
 
-  //next check individual block meta data
-  std::map<bstm_block_id, bstm_block_metadata> blocks = scene->blocks();
-  std::map<boxm2_block_id, boxm2_block_metadata> boxm2_blocks = boxm2_scene->blocks();
-
-  //iter over boxm2 blocks to make sure meta data and id's are consistent
-  std::map<boxm2_block_id, boxm2_block_metadata>::const_iterator iter = boxm2_blocks.begin();
-  for(; iter != boxm2_blocks.end(); iter++)
-  {
-    //given a boxm2 block and metadata
-    boxm2_block_id boxm2_id = iter->first;
-    boxm2_block_metadata boxm2_metadata = iter->second;
-
-    //search for it in the bstm scene
-    std::map<bstm_block_id, bstm_block_metadata> ::const_iterator bstm_iter = blocks.begin();
-    for(; bstm_iter != blocks.end() ; bstm_iter++)
-    {
-      bstm_block_id bstm_id = bstm_iter->first;
-      bstm_block_metadata bstm_metadata = bstm_iter->second;
-      if(bstm_id == boxm2_id)
-      {
-        //found same block id, check block metadata
-         bstm_block_metadata bstm_metadata = bstm_iter->second;
-         if(! (bstm_metadata == boxm2_metadata)) {
-           std::cerr << "bstm scene and boxm2 scene are not consistent! block " << boxm2_id << " metadata not consistent!\n";
-           std::cerr << "Exiting..." << std::endl;
-           return false;
-         }
-
-         double local_time;
-         if(!bstm_metadata.contains_t(time,local_time))
-           continue;
-
-
-         //now do the work
-         //std::cout << "Ingesting " << boxm2_id << " into " <<  bstm_metadata.id_ << std::endl;
-
-         //get data from bstm scene
-         bstm_block* blk = cache->get_block(bstm_metadata.id_);
-         bstm_time_block* blk_t = cache->get_time_block(bstm_metadata.id_);
-         bstm_data_base * alph    = cache->get_data_base(bstm_metadata.id_, bstm_data_traits<BSTM_ALPHA>::prefix());
-         bstm_data_base * mog     = cache->get_data_base(bstm_metadata.id_, data_type);
-
-
-         std::map<std::string, bstm_data_base*> datas;
-         datas[bstm_data_traits<BSTM_ALPHA>::prefix()] = alph;
-         datas[data_type] = mog;
-
-         //get data from boxm2 scene
-         boxm2_block *     boxm2_blk     = boxm2_cache->get_block(boxm2_scene, bstm_metadata.id_);
-         boxm2_data_base * boxm2_alph    = boxm2_cache->get_data_base(boxm2_scene, bstm_metadata.id_,boxm2_data_traits<BOXM2_ALPHA>::prefix());
-         boxm2_data_base * boxm2_mog     = boxm2_cache->get_data_base(boxm2_scene, bstm_metadata.id_,boxm2_data_type);
-
-
-
-         std::map<std::string, boxm2_data_base*> boxm2_datas;
-         boxm2_datas[boxm2_data_traits<BOXM2_ALPHA>::prefix()] = boxm2_alph;
-         boxm2_datas[boxm2_data_type] = boxm2_mog;
-
-
-         if(boxm2_data_type == boxm2_data_traits<BOXM2_MOG3_GREY>::prefix() &&  data_type == bstm_data_traits<BSTM_MOG3_GREY>::prefix()  )
-         {
-           bstm_ingest_boxm2_scene_function<BSTM_MOG3_GREY, BOXM2_MOG3_GREY>(blk,blk_t,datas,boxm2_blk,boxm2_datas,local_time, p_threshold, app_threshold);
-         }
-         else if( boxm2_data_type == boxm2_data_traits<BOXM2_MOG6_VIEW>::prefix() && data_type == bstm_data_traits<BSTM_MOG6_VIEW>::prefix()  )
-         {
-           bstm_ingest_boxm2_scene_function<BSTM_MOG6_VIEW, BOXM2_MOG6_VIEW>(blk,blk_t,datas,boxm2_blk,boxm2_datas,local_time, p_threshold, app_threshold);
-         }
-         else if( boxm2_data_type == boxm2_data_traits<BOXM2_MOG6_VIEW_COMPACT>::prefix() && data_type == bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix()  ) {
-           bstm_ingest_boxm2_scene_function<BSTM_MOG6_VIEW_COMPACT, BOXM2_MOG6_VIEW_COMPACT>(blk,blk_t,datas,boxm2_blk,boxm2_datas,local_time, p_threshold, app_threshold);
-         }
-         else if( boxm2_data_type == boxm2_data_traits<BOXM2_GAUSS_RGB>::prefix() && data_type == bstm_data_traits<BSTM_GAUSS_RGB>::prefix()  ) {
-           bstm_ingest_boxm2_scene_function<BSTM_GAUSS_RGB, BOXM2_GAUSS_RGB>(blk,blk_t,datas,boxm2_blk,boxm2_datas,local_time, p_threshold, app_threshold);
-         }
-         else if( boxm2_data_type == boxm2_data_traits<BOXM2_GAUSS_RGB_VIEW_COMPACT>::prefix() && data_type == bstm_data_traits<BSTM_GAUSS_RGB_VIEW_COMPACT>::prefix()  )
-           bstm_ingest_boxm2_scene_function<BSTM_GAUSS_RGB_VIEW_COMPACT, BOXM2_GAUSS_RGB_VIEW_COMPACT>(blk,blk_t,datas,boxm2_blk,boxm2_datas,local_time, p_threshold, app_threshold);
-         else
-           std::cout << "bstm_cpp_ingest_boxm2_scene_process ERROR! appearance models do not match, boxm2_data_type: " << boxm2_data_type << " bstm_data_type: " <<  data_type << std::endl;
-      }
-    }
-  }
-
+  //ingest all blocks concurrently; blocks whose time trees need no refinement are updated in place
+  bstm_parallel_driver driver(scene, cache, 0, &data_pool());
+  if (!driver.ingest(boxm2_scene, boxm2_cache, data_type, boxm2_data_type, time, p_threshold, app_threshold))
+    return false;
 
   std::cout << "Finished ingesting scene..." << std::endl;
   return true;
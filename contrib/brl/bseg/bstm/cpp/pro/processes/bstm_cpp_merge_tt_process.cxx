@@ -17,7 +17,7 @@
 #include <bstm/bstm_data_base.h>
 //brdb stuff
 #include <brdb/brdb_value.h>
-#include <bstm/cpp/algo/bstm_merge_tt_function.h>
+#include <bstm/cpp/algo/bstm_parallel_driver.h>
 
 #include <boxm2/basic/boxm2_array_1d.h>
 
@@ -84,34 +84,9 @@ bool bstm_cpp_merge_tt_process(bprb_func_process& pro)
     return false;
   }
 
-  std::map<bstm_block_id, bstm_block_metadata> blocks = scene->blocks();
-  std::map<bstm_block_id, bstm_block_metadata>::iterator blk_iter;
-  for (blk_iter = blocks.begin(); blk_iter != blocks.end(); ++blk_iter)
-  {
-    bstm_block_id id = blk_iter->first;
-
-    //skip block if it doesn't contain curr time.
-    bstm_block_metadata mdata =  blk_iter->second;
-    double local_time;
-    if(!mdata.contains_t(time,local_time))
-      continue;
-    std::cout<<"Merging Block: "<<id<<std::endl;
-
-    bstm_block     * blk     = cache->get_block(id);
-    bstm_time_block* blk_t   = cache->get_time_block(id);
-    bstm_data_base * alph    = cache->get_data_base(id,bstm_data_traits<BSTM_ALPHA>::prefix());
-    int num_el = alph->buffer_length() / bstm_data_traits<BSTM_ALPHA>::datasize();
-    bstm_data_base * mog     = cache->get_data_base(id, bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::prefix(), bstm_data_traits<BSTM_MOG6_VIEW_COMPACT>::datasize() * num_el);
-    bstm_data_base * num_obs = cache->get_data_base(id, bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::prefix(),bstm_data_traits<BSTM_NUM_OBS_VIEW_COMPACT>::datasize() * num_el );
-
-    std::vector<bstm_data_base*> datas;
-    datas.push_back(alph);
-    datas.push_back(mog);
-    datas.push_back(num_obs);
-
-    //refine block and datas
-    bstm_merge_tt_blk( blk_t, blk, datas, p_threshold);
-  }
+  //merge the time trees of all blocks concurrently
+  bstm_parallel_driver driver(scene, cache);
+  driver.merge_tt(time, p_threshold);
 
   std::cout << "Finished merging scene..." << std::endl;
   return true;
@@ -0,0 +1,315 @@
+#ifndef bvxm_update_rows_h_
+#define bvxm_update_rows_h_
+//:
+// \file
+// \brief Row ranges of the per-slab steps of bvxm_voxel_world::update_impl() and update_lidar_impl()
+//
+// Each step of the slab by slab update is written as a vpl_parallel_for_body
+// that processes rows [begin,end) of its output slabs, so the work on one
+// slab is split between threads.  Every voxel (pixel) is computed exactly as
+// in a single threaded pass, hence the result does not depend on the number
+// of threads.  The appearance and LIDAR processors are copied for each worker,
+// so they need not be safe to call from several threads at once.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <vector>
+#include <vcl_compiler.h>
+#include <vgl/vgl_box_2d.h>
+#include <vgl/vgl_point_2d.h>
+#include <vgl/vgl_homg_point_2d.h>
+#include <vgl/algo/vgl_h_matrix_2d.h>
+#include <vnl/vnl_vector_fixed.h>
+#include <vil/vil_image_view_base.h>
+#include <vpl/vpl_parallel_for.h>
+
+#include "grid/bvxm_voxel_slab.h"
+#include "bvxm_voxel_traits.h"
+#include "bvxm_lidar_processor.h"
+#include "bvxm_util.h"
+
+//: Pass 1, voxel plane: back-project the image and the accumulated preX/visX to a slab and update its appearance
+template <bvxm_voxel_type APM_T>
+class bvxm_update_apm_rows : public vpl_parallel_for_body
+{
+ public:
+  typedef typename bvxm_voxel_traits<APM_T>::voxel_datatype apm_datatype;
+  typedef typename bvxm_voxel_traits<APM_T>::obs_datatype obs_datatype;
+  typedef typename bvxm_voxel_traits<APM_T>::appearance_processor apm_processor_type;
+
+  bvxm_update_apm_rows(apm_processor_type const& apm_processor, unsigned num_threads,
+                       bvxm_voxel_slab<obs_datatype> const& image_slab,
+                       bvxm_voxel_slab<float> const& preX_accum,
+                       bvxm_voxel_slab<float> const& visX_accum)
+  : apm_processors_(num_threads, apm_processor), image_slab_(image_slab), preX_accum_(preX_accum), visX_accum_(visX_accum) {}
+
+  //: the slab to process: its homography and its voxel slabs, all nx by ny by 1
+  vgl_h_matrix_2d<double> H_plane_to_img;
+  bvxm_voxel_slab<float> ocp;                  // P(X)
+  bvxm_voxel_slab<apm_datatype> apm;           // updated
+  bvxm_voxel_slab<float> preX;                 // output
+  bvxm_voxel_slab<float> PIvisX;               // output: PI(X)*visX
+  bvxm_voxel_slab<float> PIPX;                 // output: PI(X)*P(X)
+  bvxm_voxel_slab<float> visX;                 // scratch
+  bvxm_voxel_slab<float> PXvisX;               // scratch
+  bvxm_voxel_slab<obs_datatype> frame_backproj; // scratch
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    apm_processor_type& apm_processor = apm_processors_[thread_id];
+    bvxm_voxel_slab<obs_datatype> frame_backproj_r = frame_backproj.rows(begin,end);
+    bvxm_voxel_slab<float> preX_r = preX.rows(begin,end);
+    bvxm_voxel_slab<float> visX_r = visX.rows(begin,end);
+    bvxm_voxel_slab<float> ocp_r = ocp.rows(begin,end);
+    bvxm_voxel_slab<apm_datatype> apm_r = apm.rows(begin,end);
+    bvxm_voxel_slab<float> PIvisX_r = PIvisX.rows(begin,end);
+    bvxm_voxel_slab<float> PXvisX_r = PXvisX.rows(begin,end);
+    bvxm_voxel_slab<float> PIPX_r = PIPX.rows(begin,end);
+
+    // backproject image onto voxel plane
+    bvxm_util::warp_slab_bilinear(image_slab_, H_plane_to_img, frame_backproj_r, begin);
+    // transform preX to voxel plane for this level
+    bvxm_util::warp_slab_bilinear(preX_accum_, H_plane_to_img, preX_r, begin);
+    // transform visX to voxel plane for this level
+    bvxm_util::warp_slab_bilinear(visX_accum_, H_plane_to_img, visX_r, begin);
+
+    // initialize PIvisX with PI(X)
+    bvxm_voxel_slab<float> PI = apm_processor.prob_density(apm_r, frame_backproj_r);
+
+    // now multiply by visX
+    bvxm_util::multiply_slabs(visX_r,PI,PIvisX_r);
+
+    // update appearance model, using PX*visX as the weights
+    bvxm_util::multiply_slabs(visX_r,ocp_r,PXvisX_r);
+    apm_processor.update(apm_r, frame_backproj_r, PXvisX_r);
+
+    // multiply to get PIPX
+    bvxm_util::multiply_slabs(PI,ocp_r,PIPX_r);
+  }
+
+ private:
+  //: one processor per worker
+  std::vector<apm_processor_type> apm_processors_;
+  bvxm_voxel_slab<obs_datatype> const& image_slab_;
+  bvxm_voxel_slab<float> const& preX_accum_;
+  bvxm_voxel_slab<float> const& visX_accum_;
+};
+
+
+//: Pass 1, voxel plane: the LIDAR counterpart of bvxm_update_apm_rows (without appearance update)
+template <class T>
+class bvxm_update_lidar_rows : public vpl_parallel_for_body
+{
+ public:
+  bvxm_update_lidar_rows(bvxm_lidar_processor const& lidar_processor, unsigned num_threads,
+                         vil_image_view_base_sptr const& lidar,
+                         vnl_vector_fixed<float,3> const& vars,
+                         float voxel_length,
+                         bvxm_voxel_slab<float> const& preX_accum,
+                         bvxm_voxel_slab<float> const& visX_accum)
+  : lidar_processors_(num_threads, lidar_processor), lidar_(lidar), vars_(vars), voxel_length_(voxel_length),
+    preX_accum_(preX_accum), visX_accum_(visX_accum) {}
+
+  //: the slab to process: its homography, the one of the slab below, the height of the slab and its voxel slabs
+  vgl_h_matrix_2d<double> H_plane_to_img;
+  vgl_h_matrix_2d<double> H_plane_to_img_below;
+  float z;
+  bvxm_voxel_slab<T> ocp;                      // P(X)
+  bvxm_voxel_slab<float> preX;                 // output
+  bvxm_voxel_slab<float> PLvisX;               // output: PL(X)*visX
+  bvxm_voxel_slab<float> PLPX;                 // output: PL(X)*P(X)
+  bvxm_voxel_slab<float> visX;                 // scratch
+  bvxm_voxel_slab<float> PL;                   // scratch
+
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    bvxm_lidar_processor& lidar_processor = lidar_processors_[thread_id];
+    vnl_vector_fixed<float,3> vars = vars_;
+    bvxm_voxel_slab<float> preX_r = preX.rows(begin,end);
+    bvxm_voxel_slab<float> visX_r = visX.rows(begin,end);
+    bvxm_voxel_slab<T> ocp_r = ocp.rows(begin,end);
+    bvxm_voxel_slab<float> PL_r = PL.rows(begin,end);
+    bvxm_voxel_slab<float> PLvisX_r = PLvisX.rows(begin,end);
+    bvxm_voxel_slab<float> PLPX_r = PLPX.rows(begin,end);
+
+    // transform preX to voxel plane for this level
+    bvxm_util::warp_slab_bilinear(preX_accum_, H_plane_to_img, preX_r, begin);
+    // transform visX to voxel plane for this level
+    bvxm_util::warp_slab_bilinear(visX_accum_, H_plane_to_img, visX_r, begin);
+
+    // PL(X): probability of the LIDAR returns in the footprint of each voxel
+    for (unsigned i_idx=0; i_idx<PL_r.nx(); i_idx++)
+    {
+      for (unsigned j_idx=begin; j_idx<end; j_idx++)
+      {
+        std::vector<vgl_homg_point_2d<double> > vp(4);
+        int i = i_idx+1;
+        int j = j_idx-1;
+        vp[0] = vgl_homg_point_2d<double>(i, j);
+        vp[1] = vgl_homg_point_2d<double>(i+1, j);
+        vp[2] = vgl_homg_point_2d<double>(i, j+1);
+        vp[3] = vgl_homg_point_2d<double>(i+1, j+1);
+
+        vgl_box_2d<double> lidar_roi;
+        for (unsigned k=0; k<4; k++) {
+          vgl_homg_point_2d<double> img_pos_h_min = H_plane_to_img_below*vp[k];
+          vgl_point_2d<double> img_pos_min(img_pos_h_min);
+          lidar_roi.add(img_pos_min);
+        }
+        PL_r(i_idx, j_idx-begin) = lidar_processor.prob_density(lidar_, z, vars, lidar_roi, voxel_length_);
+      }
+    }
+
+    // now multiply by visX
+    bvxm_util::multiply_slabs(visX_r,PL_r,PLvisX_r);
+
+    // multiply to get PLPX
+    bvxm_util::multiply_slabs(ocp_r,PL_r,PLPX_r);
+  }
+
+ private:
+  //: one processor per worker
+  std::vector<bvxm_lidar_processor> lidar_processors_;
+  vil_image_view_base_sptr const& lidar_;
+  vnl_vector_fixed<float,3> vars_;
+  float voxel_length_;
+  bvxm_voxel_slab<float> const& preX_accum_;
+  bvxm_voxel_slab<float> const& visX_accum_;
+};
+
+
+//: Pass 1, image plane: accumulate preX and visX along the rays through a slab
+template <class T>
+class bvxm_update_accum_rows : public vpl_parallel_for_body
+{
+ public:
+  bvxm_update_accum_rows(bvxm_voxel_slab<float>& preX_accum,
+                         bvxm_voxel_slab<float>& visX_accum,
+                         bvxm_voxel_slab<float>& mask_slab,
+                         bool return_mask)
+  : preX_accum_(preX_accum), visX_accum_(visX_accum), mask_slab_(mask_slab), return_mask_(return_mask),
+    PIPX_img_(preX_accum.nx(), preX_accum.ny(), 1), PX_img_(preX_accum.nx(), preX_accum.ny(), 1) {}
+
+  //: the slab to process: its homography, P(X) and PI(X)*P(X) (voxel plane)
+  vgl_h_matrix_2d<double> H_img_to_plane;
+  bvxm_voxel_slab<T> ocp;
+  bvxm_voxel_slab<float> PIPX;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    bvxm_voxel_slab<float> PIPX_img_r = PIPX_img_.rows(begin,end);
+    bvxm_voxel_slab<float> PX_img_r = PX_img_.rows(begin,end);
+    bvxm_voxel_slab<float> preX_accum_r = preX_accum_.rows(begin,end);
+    bvxm_voxel_slab<float> visX_accum_r = visX_accum_.rows(begin,end);
+
+    // warp PIPX back to image domain
+    bvxm_util::warp_slab_bilinear(PIPX, H_img_to_plane, PIPX_img_r, begin);
+
+    // multiply PIPX by visX and add to preX_accum
+    typename bvxm_voxel_slab<float>::iterator PIPX_img_it = PIPX_img_r.begin();
+    typename bvxm_voxel_slab<float>::iterator visX_accum_it = visX_accum_r.begin();
+    typename bvxm_voxel_slab<float>::iterator preX_accum_it = preX_accum_r.begin();
+    for (; preX_accum_it != preX_accum_r.end(); ++preX_accum_it, ++PIPX_img_it, ++visX_accum_it) {
+      *preX_accum_it += (*PIPX_img_it) * (*visX_accum_it);
+    }
+
+    // transform (1-P(X)) to image plane to accumulate visX for next level
+    bvxm_util::warp_slab_bilinear(ocp, H_img_to_plane, PX_img_r, begin);
+
+    if (return_mask_) {
+      bvxm_voxel_slab<float> mask_r = mask_slab_.rows(begin,end);
+      bvxm_util::add_slabs(PX_img_r,mask_r,mask_r);
+    }
+
+    // note: doing scale and offset in image domain so invalid pixels become 1.0 and don't affect visX
+    typename bvxm_voxel_slab<float>::iterator PX_img_it = PX_img_r.begin();
+    visX_accum_it = visX_accum_r.begin();
+    for (; visX_accum_it != visX_accum_r.end(); ++visX_accum_it, ++PX_img_it) {
+      *visX_accum_it *= (1 - *PX_img_it);
+    }
+  }
+
+ private:
+  bvxm_voxel_slab<float>& preX_accum_;
+  bvxm_voxel_slab<float>& visX_accum_;
+  bvxm_voxel_slab<float>& mask_slab_;
+  bool return_mask_;
+  bvxm_voxel_slab<float> PIPX_img_;
+  bvxm_voxel_slab<float> PX_img_;
+};
+
+
+//: Pass 2, voxel plane: compute the new P(X) of a slab
+template <class T>
+class bvxm_update_ocp_rows : public vpl_parallel_for_body
+{
+ public:
+  bvxm_update_ocp_rows(bvxm_voxel_slab<float> const& preX_accum,
+                       bvxm_voxel_slab<float> const& visX_accum,
+                       unsigned nx, unsigned ny,
+                       T min_vox_prob, T max_vox_prob,
+                       float preX_sum_thresh, bool ray_norm)
+  : preX_accum_(preX_accum), visX_accum_(visX_accum),
+    preX_accum_vox_(nx,ny,1), visX_accum_vox_(nx,ny,1),
+    min_vox_prob_(min_vox_prob), max_vox_prob_(max_vox_prob),
+    preX_sum_thresh_(preX_sum_thresh), ray_norm_(ray_norm) {}
+
+  //: the slab to process: its homography, preX and PI(X)*visX from pass 1, and P(X) (updated)
+  vgl_h_matrix_2d<double> H_plane_to_img;
+  bvxm_voxel_slab<float> preX;
+  bvxm_voxel_slab<float> PIvisX;
+  bvxm_voxel_slab<T> ocp;
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    bvxm_voxel_slab<float> preX_accum_vox_r = preX_accum_vox_.rows(begin,end);
+    bvxm_voxel_slab<float> visX_accum_vox_r = visX_accum_vox_.rows(begin,end);
+    bvxm_voxel_slab<T> ocp_r = ocp.rows(begin,end);
+
+    // transform preX_sum to current level
+    bvxm_util::warp_slab_bilinear(preX_accum_, H_plane_to_img, preX_accum_vox_r, begin);
+
+    // transform visX_sum to current level
+    bvxm_util::warp_slab_bilinear(visX_accum_, H_plane_to_img, visX_accum_vox_r, begin);
+
+    bvxm_voxel_slab<float> preX_r = preX.rows(begin,end);
+    bvxm_voxel_slab<float> PIvisX_r = PIvisX.rows(begin,end);
+    typename bvxm_voxel_slab<float>::const_iterator preX_it = preX_r.begin(),
+                                                    PIvisX_it = PIvisX_r.begin(),
+                                                    preX_sum_it = preX_accum_vox_r.begin(),
+                                                    visX_sum_it = visX_accum_vox_r.begin();
+    typename bvxm_voxel_slab<T>::iterator PX_it = ocp_r.begin();
+
+    for (; PX_it != ocp_r.end(); ++PX_it, ++preX_it, ++PIvisX_it, ++preX_sum_it, ++visX_sum_it) {
+      // if preX_sum is zero at the voxel, no ray passed through the voxel (out of image)
+      if (*preX_sum_it > preX_sum_thresh_) {
+        float multiplier = (*PIvisX_it + *preX_it) / *preX_sum_it;
+        if (ray_norm_) {
+          // normalize based on probability that a surface voxel is located along the ray. This was not part of the original Pollard + Mundy algorithm.
+          float ray_norm = 1 - *visX_sum_it;
+          *PX_it *= multiplier * ray_norm;
+        }
+        else
+          *PX_it *= multiplier;
+      }
+      if (*PX_it < min_vox_prob_)
+        *PX_it = min_vox_prob_;
+      if (*PX_it > max_vox_prob_)
+        *PX_it = max_vox_prob_;
+    }
+  }
+
+ private:
+  bvxm_voxel_slab<float> const& preX_accum_;
+  bvxm_voxel_slab<float> const& visX_accum_;
+  bvxm_voxel_slab<float> preX_accum_vox_;
+  bvxm_voxel_slab<float> visX_accum_vox_;
+  T min_vox_prob_;
+  T max_vox_prob_;
+  float preX_sum_thresh_;
+  bool ray_norm_;
+};
+
+#endif // bvxm_update_rows_h_
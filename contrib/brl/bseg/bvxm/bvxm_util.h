@@ -68,10 +68,14 @@ class bvxm_util
                           bvxm_voxel_slab<bool> const& s2,
                           bvxm_voxel_slab<bool> &result);
 
+  //: Warp slab_in into slab_out; invH maps output (x,y) to input coordinates.
+  //  If slab_out holds rows [y_offset, y_offset+slab_out.ny()) of a larger output
+  //  (see bvxm_voxel_slab::rows()), pass the index of its first row as y_offset.
   template <class T, class M>
   static void warp_slab_bilinear(bvxm_voxel_slab<M> const& slab_in,
                                  vgl_h_matrix_2d<double> invH,
-                                 bvxm_voxel_slab<T> &slab_out);
+                                 bvxm_voxel_slab<T> &slab_out,
+                                 unsigned y_offset = 0);
 
   template <class T>
   static void warp_slab_nearest_neighbor(bvxm_voxel_slab<T> const& slab_in,
@@ -156,7 +160,8 @@ class bvxm_util
 
 template <class T, class M>
 void bvxm_util::warp_slab_bilinear(bvxm_voxel_slab<M> const& slab_in,
-                                   vgl_h_matrix_2d<double> invH, bvxm_voxel_slab<T> &slab_out)
+                                   vgl_h_matrix_2d<double> invH, bvxm_voxel_slab<T> &slab_out,
+                                   unsigned y_offset)
 {
   // smoothing radius of filter
   // TODO: is gaussian convolution with std = projected_size the right amount to get us to Nyquist res?
@@ -184,9 +189,13 @@ void bvxm_util::warp_slab_bilinear(bvxm_voxel_slab<M> const& slab_in,
   std::cout << "xsize = " << xsize << " ysize = " << ysize << std::endl;
 #endif // 0
 
-  bvxm_voxel_slab<M> slab_in_smooth;
-  slab_in_smooth.deep_copy(slab_in);
-  smooth_gaussian(slab_in_smooth, xstd, ystd);
+  // only copy the input if it actually needs smoothing; the shallow copy shares its memory
+  bvxm_voxel_slab<M> slab_in_smooth = slab_in;
+  if (xstd > 0.0f || ystd > 0.0f) {
+    slab_in_smooth = bvxm_voxel_slab<M>();
+    slab_in_smooth.deep_copy(slab_in);
+    smooth_gaussian(slab_in_smooth, xstd, ystd);
+  }
 
   // perform bilinear interpolation.
   vnl_matrix_fixed<float,3,3> H;
@@ -208,7 +217,7 @@ void bvxm_util::warp_slab_bilinear(bvxm_voxel_slab<M> const& slab_in,
     {
       for (unsigned x=0; x<slab_out.nx(); ++x, ++out_it)
       {
-        vnl_vector_fixed<float,3> pix_in_homg = H*vnl_vector_fixed<float,3>((float)x,(float)y,1.0f);
+        vnl_vector_fixed<float,3> pix_in_homg = H*vnl_vector_fixed<float,3>((float)x,(float)(y+y_offset),1.0f);
         // normalize homogeneous coordinate
 
         float pix_in_x = pix_in_homg[0] / pix_in_homg[2];
@@ -144,6 +144,9 @@ bool bvxm_voxel_world::save_occupancy_vff(std::string filename,unsigned scale_id
 //: remove all voxel data from disk - use with caution!
 bool bvxm_voxel_world::clean_grids()
 {
+  // release the grids first, cached storage writes its slabs back when it is destroyed
+  grid_map_.clear();
+
   // look for existing grids in the directory
   std::string storage_directory = params_->model_dir();
 
@@ -151,8 +154,6 @@ bool bvxm_voxel_world::clean_grids()
   grid_glob << storage_directory << "/*.vox";
   bool result = vul_file::delete_file_glob(grid_glob.str().c_str());
 
-  grid_map_.clear();
-
   return result;
 }
 
@@ -66,6 +66,10 @@
 //   Gamze Tunali - 06/16/2009 - update_lidar and save_occupancy_raw methods are templated and moved from .cxx file to the header
 //
 //   Yi Dong - 11/26/2013 - added the option to use memory-based voxel grid in update method (require sufficient memory if chosen and all previous voxel grid on the disk will be ignored)
+//
+//   update() and update_lidar() split the work on each slab between threads (set_num_threads());
+//   set_slab_cache_size() selects double buffered disk storage, which reads the next slabs and writes
+//   back the previous ones while a slab is processed.
 // \endverbatim
 //
 ////////////////////////////////////////////////////////////////////////////////
@@ -73,10 +77,12 @@
 #include <string>
 #include <vector>
 #include <set>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 #include <utility>
 #include <vcl_cassert.h>
+#include <vxl_config.h>
 #include <vbl/vbl_ref_count.h>
 
 #include <vgl/vgl_point_3d.h>
@@ -95,6 +101,7 @@
 #include "bvxm_voxel_traits.h"
 #include "bvxm_world_params.h"
 #include "bvxm_util.h"
+#include "bvxm_update_rows.h"
 
 // These includes are for the implementations of the templated methods,
 // which should be moved from the header file if possible.
@@ -116,10 +123,10 @@ class bvxm_voxel_world: public vbl_ref_count
  public:
 
   //: default constructor
-  bvxm_voxel_world() {}
+  bvxm_voxel_world() : num_threads_(0), slab_cache_size_(0), sparse_memory_grids_(false) {}
 
   //: construct world with parameters
-  bvxm_voxel_world(bvxm_world_params_sptr params) { params_ = params; }
+  bvxm_voxel_world(bvxm_world_params_sptr params) : num_threads_(0), slab_cache_size_(0), sparse_memory_grids_(false) { params_ = params; }
 
   //: destructor
   ~bvxm_voxel_world();
@@ -248,6 +255,24 @@ class bvxm_voxel_world: public vbl_ref_count
   //: set the world parameters
   void set_params(bvxm_world_params_sptr params) { params_ = params; }
 
+  //: number of threads that share the rows of each slab in update() and update_lidar(); 0 (the default) means one per processor
+  void set_num_threads(unsigned num_threads) { num_threads_ = num_threads; }
+  unsigned num_threads() const { return num_threads_; }
+
+  //: Cache size (in bytes) of the disk based grids that are opened from now on.
+  //  If non-zero, the grids use bvxm_voxel_storage_disk_cached in double buffered mode,
+  //  i.e. half of the cache holds the slabs that follow the ones being processed.
+  //  The default, 0, selects the uncached bvxm_voxel_storage_disk.
+  void set_slab_cache_size(vxl_int_64 cache_size) { slab_cache_size_ = cache_size; }
+  vxl_int_64 slab_cache_size() const { return slab_cache_size_; }
+
+  //: If set, the in-memory grids (use_memory = true) that are created from now on use bvxm_voxel_storage_sparse,
+  //  which only allocates the 8x8x8 bricks that differ from the initial value of the voxel type.
+  //  An update changes every voxel in the view of the camera, so this saves memory only for the
+  //  parts of the world that no image covers; the updates still process every slab.
+  void set_sparse_memory_grids(bool sparse) { sparse_memory_grids_ = sparse; }
+  bool sparse_memory_grids() const { return sparse_memory_grids_; }
+
   // === Operators that allow voxel world to be placed in a brdb database ===
 
   //: equality operator
@@ -302,8 +327,25 @@ class bvxm_voxel_world: public vbl_ref_count
   //: the world parameters
   bvxm_world_params_sptr params_;
 
+  //: number of threads used by the updates, 0 for one per processor
+  unsigned num_threads_;
+
+  //: cache size of the disk based grids, 0 for uncached storage
+  vxl_int_64 slab_cache_size_;
+
+  //: whether the in-memory grids use sparse storage
+  bool sparse_memory_grids_;
+
  private:
 
+  //: a new disk based grid, with the storage selected by slab_cache_size_
+  template <class T>
+  bvxm_voxel_grid<T>* new_disk_grid(std::string const& storage_fname, vgl_vector_3d<unsigned int> const& grid_size) const;
+
+  //: a new in-memory grid, with the storage selected by sparse_memory_grids_
+  template <bvxm_voxel_type VOX_T>
+  bvxm_voxel_grid<typename bvxm_voxel_traits<VOX_T>::voxel_datatype>* new_mem_grid(vgl_vector_3d<unsigned int> const& grid_size) const;
+
   template <bvxm_voxel_type APM_T>
   bool update_impl(bvxm_image_metadata const& metadata,
                    bool return_prob, vil_image_view<float> &pix_prob_density,
@@ -412,9 +454,9 @@ bvxm_voxel_grid_base_sptr bvxm_voxel_world::get_grid(unsigned bin_index, unsigne
         bvxm_voxel_grid_base_sptr grid;
         typedef typename bvxm_voxel_traits<VOX_T>::voxel_datatype voxel_datatype;
         if (use_memory)
-          grid = new bvxm_voxel_grid<voxel_datatype>(grid_size_scale, grid_size_scale.z());
+          grid = this->new_mem_grid<VOX_T>(grid_size_scale);
         else
-          grid = new bvxm_voxel_grid<voxel_datatype>(file_it(), grid_size_scale);
+          grid = this->new_disk_grid<voxel_datatype>(file_it(), grid_size_scale);
         std::map<unsigned, bvxm_voxel_grid_base_sptr > scale_map;
         scale_map.insert(std::make_pair((unsigned)scale, grid));
 
@@ -447,9 +489,9 @@ bvxm_voxel_grid_base_sptr bvxm_voxel_world::get_grid(unsigned bin_index, unsigne
     typedef typename bvxm_voxel_traits<VOX_T>::voxel_datatype voxel_datatype;
     bvxm_voxel_grid<voxel_datatype> * grid;
     if (use_memory)
-      grid = new bvxm_voxel_grid<voxel_datatype>(grid_size, grid_size.z());
+      grid = this->new_mem_grid<VOX_T>(grid_size);
     else
-      grid = new bvxm_voxel_grid<voxel_datatype>(apm_fname.str(),grid_size);
+      grid = this->new_disk_grid<voxel_datatype>(apm_fname.str(),grid_size);
     // fill grid with default value
     if (!grid->initialize_data(bvxm_voxel_traits<VOX_T>::initial_val())) {
       std::cerr << "error initializing voxel grid\n";
@@ -480,10 +522,10 @@ bvxm_voxel_grid_base_sptr bvxm_voxel_world::get_grid(unsigned bin_index, unsigne
     typedef typename bvxm_voxel_traits<VOX_T>::voxel_datatype voxel_datatype;
     bvxm_voxel_grid<voxel_datatype> *grid;
     if (use_memory) {
-      grid = new bvxm_voxel_grid<voxel_datatype>(grid_size, grid_size.z());
+      grid = this->new_mem_grid<VOX_T>(grid_size);
     }
     else
-      grid = new bvxm_voxel_grid<voxel_datatype>(apm_fname.str(), grid_size);
+      grid = this->new_disk_grid<voxel_datatype>(apm_fname.str(), grid_size);
 
     // fill grid with default value
     if (!grid->initialize_data(bvxm_voxel_traits<VOX_T>::initial_val())) {
@@ -499,6 +541,25 @@ bvxm_voxel_grid_base_sptr bvxm_voxel_world::get_grid(unsigned bin_index, unsigne
   return grid_map_[VOX_T][bin_index][scale_idx];
 }
 
+template <class T>
+bvxm_voxel_grid<T>* bvxm_voxel_world::new_disk_grid(std::string const& storage_fname, vgl_vector_3d<unsigned int> const& grid_size) const
+{
+  if (slab_cache_size_ == 0)
+    return new bvxm_voxel_grid<T>(storage_fname, grid_size);
+  // each half of the cache must hold at least one slab
+  vxl_int_64 slab_size = vxl_int_64(grid_size.x())*grid_size.y()*vxl_int_64(sizeof(T));
+  return new bvxm_voxel_grid<T>(storage_fname, grid_size, std::max(slab_cache_size_, 2*slab_size), true);
+}
+
+template <bvxm_voxel_type VOX_T>
+bvxm_voxel_grid<typename bvxm_voxel_traits<VOX_T>::voxel_datatype>* bvxm_voxel_world::new_mem_grid(vgl_vector_3d<unsigned int> const& grid_size) const
+{
+  typedef typename bvxm_voxel_traits<VOX_T>::voxel_datatype voxel_datatype;
+  if (!sparse_memory_grids_)
+    return new bvxm_voxel_grid<voxel_datatype>(grid_size, grid_size.z());
+  return new bvxm_voxel_grid<voxel_datatype>(new bvxm_voxel_storage_sparse<voxel_datatype>(grid_size, bvxm_voxel_traits<VOX_T>::initial_val()));
+}
+
 
 // Update a voxel grid with data from image/camera pair
 template <bvxm_voxel_type APM_T>
@@ -577,13 +638,11 @@ bool bvxm_voxel_world::update_impl(bvxm_image_metadata const& metadata,
 
   bvxm_voxel_slab<float> preX_accum(image_slab.nx(),image_slab.ny(),1);
   bvxm_voxel_slab<float> visX_accum(image_slab.nx(),image_slab.ny(),1);
-  bvxm_voxel_slab<float> img_scratch(image_slab.nx(),image_slab.ny(),1);
-  bvxm_voxel_slab<float> PIPX_img(image_slab.nx(), image_slab.ny(),1);
-  bvxm_voxel_slab<float> PX_img(image_slab.nx(), image_slab.ny(),1);
   bvxm_voxel_slab<float> mask_slab(image_slab.nx(), image_slab.ny(),1);
 
   preX_accum.fill(0.0f);
   visX_accum.fill(1.0f);
+  mask_slab.fill(0.0f);
 
   // slabs for holding backprojections of visX
   bvxm_voxel_slab<float> visX(grid_size.x(),grid_size.y(),1);
@@ -605,6 +664,19 @@ bool bvxm_voxel_world::update_impl(bvxm_image_metadata const& metadata,
   typename bvxm_voxel_grid<float>::iterator preX_slab_it = preX.begin();
   typename bvxm_voxel_grid<float>::iterator PIvisX_slab_it = PIvisX.begin();
 
+  // the rows of each slab are shared between threads
+  unsigned nthreads = vpl_parallel_for_num_threads(num_threads_);
+  unsigned vox_grain = std::max(1u, grid_size.y()/(4*nthreads));
+  unsigned img_grain = std::max(1u, image_slab.ny()/(4*nthreads));
+
+  bvxm_update_apm_rows<APM_T> apm_rows(apm_processor, nthreads, image_slab, preX_accum, visX_accum);
+  apm_rows.PIPX = PIPX;
+  apm_rows.PXvisX = PXvisX;
+  apm_rows.visX = visX;
+  apm_rows.frame_backproj = frame_backproj;
+  bvxm_update_accum_rows<ocp_datatype> accum_rows(preX_accum, visX_accum, mask_slab, return_mask);
+  accum_rows.PIPX = PIPX;
+
   for (unsigned z=0; z<(unsigned)grid_size.z(); ++z, ++ocp_slab_it, ++apm_slab_it, ++preX_slab_it, ++PIvisX_slab_it)
   {
     std::cout << '.';
@@ -615,67 +687,30 @@ bool bvxm_voxel_world::update_impl(bvxm_image_metadata const& metadata,
       return false;
     }
 
-    // backproject image onto voxel plane
-    bvxm_util::warp_slab_bilinear(image_slab, H_plane_to_img[z], frame_backproj);
+    // back-project image, preX and visX onto the voxel plane, update the appearance model
+    // and compute PI(X)*visX and PI(X)*P(X)
+    apm_rows.H_plane_to_img = H_plane_to_img[z];
+    apm_rows.ocp = *ocp_slab_it;
+    apm_rows.apm = *apm_slab_it;
+    apm_rows.preX = *preX_slab_it;
+    apm_rows.PIvisX = *PIvisX_slab_it;
+    vpl_parallel_for(grid_size.y(), apm_rows, nthreads, vox_grain);
 #ifdef BVXM_DEBUG
     bvxm_util::write_slab_as_image(frame_backproj,"C:/research/registration/output/frame_backproj.tiff");
-#endif
-    // transform preX to voxel plane for this level
-    bvxm_util::warp_slab_bilinear(preX_accum, H_plane_to_img[z], *preX_slab_it);
-    // transform visX to voxel plane for this level
-    bvxm_util::warp_slab_bilinear(visX_accum, H_plane_to_img[z], visX);
-
-    // initialize PIvisX with PI(X)
-    bvxm_voxel_slab<float> PI = apm_processor.prob_density(*apm_slab_it, frame_backproj);
-
-    // now multiply by visX
-    bvxm_util::multiply_slabs(visX,PI,*PIvisX_slab_it);
-
-    // update appearance model, using PX*visX as the weights
-    bvxm_util::multiply_slabs(visX,*ocp_slab_it,PXvisX);
-    apm_processor.update(*apm_slab_it, frame_backproj, PXvisX);
-
-    // multiply to get PIPX
-    bvxm_util::multiply_slabs(PI,*ocp_slab_it,PIPX);
-#ifdef BVXM_DEBUG
-    bvxm_util::write_slab_as_image(PI,"PI.tiff");
     bvxm_util::write_slab_as_image(*ocp_slab_it,"PX.tiff");
 #endif
-    // warp PIPX back to image domain
-    bvxm_util::warp_slab_bilinear(PIPX, H_img_to_plane[z], PIPX_img);
-
-    // multiply PIPX by visX and add to preX_accum
-    typename bvxm_voxel_slab<float>::iterator PIPX_img_it = PIPX_img.begin();
-    typename bvxm_voxel_slab<float>::iterator visX_accum_it = visX_accum.begin();
-    typename bvxm_voxel_slab<float>::iterator preX_accum_it = preX_accum.begin();
 
-    for (; preX_accum_it != preX_accum.end(); ++preX_accum_it, ++PIPX_img_it, ++visX_accum_it) {
-      *preX_accum_it += (*PIPX_img_it) * (*visX_accum_it);
-    }
+    // warp PIPX and P(X) back to the image, accumulate preX and visX for the next level
+    accum_rows.H_img_to_plane = H_img_to_plane[z];
+    accum_rows.ocp = *ocp_slab_it;
+    vpl_parallel_for(image_slab.ny(), accum_rows, nthreads, img_grain);
 #ifdef BVXM_DEBUG
-    bvxm_util::write_slab_as_image(PIPX_img,"PIPX_img.tiff");
     bvxm_util::write_slab_as_image(visX_accum,"visX_accum.tiff");
     bvxm_util::write_slab_as_image(preX_accum,"preX_accum.tiff");
 #endif
-    // scale and offset voxel probabilities to get (1-P(X))
-    // transform (1-P(X)) to image plane to accumulate visX for next level
-    bvxm_util::warp_slab_bilinear(*ocp_slab_it, H_img_to_plane[z], PX_img);
-
-    if (return_mask) {
-      bvxm_util::add_slabs(PX_img,mask_slab,mask_slab);
-    }
-
-    // note: doing scale and offset in image domain so invalid pixels become 1.0 and don't affect visX
-    typename bvxm_voxel_slab<float>::iterator PX_img_it = PX_img.begin();
-    visX_accum_it = visX_accum.begin();
-    for (; visX_accum_it != visX_accum.end(); ++visX_accum_it, ++PX_img_it) {
-      *visX_accum_it *= (1 - *PX_img_it);
-    }
   }
   // now traverse a second time, computing new P(X) along the way.
 
-  bvxm_voxel_slab<float> preX_accum_vox(grid_size.x(),grid_size.y(),1);
-  bvxm_voxel_slab<float> visX_accum_vox(grid_size.x(),grid_size.y(),1);
 #ifdef BVXM_DEBUG
   bvxm_util::write_slab_as_image(visX_accum,"visX_accum.tiff");
   bvxm_util::write_slab_as_image(preX_accum,"preX_accum.tiff");
@@ -684,36 +719,18 @@ bool bvxm_voxel_world::update_impl(bvxm_image_metadata const& metadata,
   PIvisX_slab_it = PIvisX.begin();
   preX_slab_it = preX.begin();
   typename bvxm_voxel_grid<ocp_datatype>::iterator ocp_slab_it2 = ocp_grid->begin();
+  const float preX_sum_thresh = 0.01f;
+  bvxm_update_ocp_rows<ocp_datatype> ocp_rows(preX_accum, visX_accum, grid_size.x(), grid_size.y(),
+                                              min_vox_prob, max_vox_prob, preX_sum_thresh, true);
   for (unsigned z = 0; z < (unsigned)grid_size.z(); ++z, ++PIvisX_slab_it, ++preX_slab_it, ++ocp_slab_it2)
   {
     std::cout << '.';
     std::cout.flush();
-    // transform preX_sum to current level
-    bvxm_util::warp_slab_bilinear(preX_accum, H_plane_to_img[z], preX_accum_vox);
-
-    // transform visX_sum to current level
-    bvxm_util::warp_slab_bilinear(visX_accum, H_plane_to_img[z], visX_accum_vox);
-
-    const float preX_sum_thresh = 0.01f;
-
-    typename bvxm_voxel_slab<float>::const_iterator preX_it = preX_slab_it->begin(),
-                                                    PIvisX_it = PIvisX_slab_it->begin(),
-                                                    preX_sum_it = preX_accum_vox.begin(),
-                                                    visX_sum_it = visX_accum_vox.begin();
-    typename bvxm_voxel_slab<float>::iterator PX_it = ocp_slab_it2->begin();
-
-    for (; PX_it != ocp_slab_it2->end(); ++PX_it, ++preX_it, ++PIvisX_it, ++preX_sum_it, ++visX_sum_it) {
-      // if preX_sum is zero at the voxel, no ray passed through the voxel (out of image)
-      if (*preX_sum_it > preX_sum_thresh) {
-        float multiplier = (*PIvisX_it + *preX_it) / *preX_sum_it;
-        float ray_norm = 1 - *visX_sum_it; // normalize based on probability that a surface voxel is located along the ray. This was not part of the original Pollard + Mundy algorithm.
-        *PX_it *= multiplier * ray_norm;
-      }
-      if (*PX_it < min_vox_prob)
-        *PX_it = min_vox_prob;
-      if (*PX_it > max_vox_prob)
-        *PX_it = max_vox_prob;
-    }
+    ocp_rows.H_plane_to_img = H_plane_to_img[z];
+    ocp_rows.preX = *preX_slab_it;
+    ocp_rows.PIvisX = *PIvisX_slab_it;
+    ocp_rows.ocp = *ocp_slab_it2;
+    vpl_parallel_for(grid_size.y(), ocp_rows, nthreads, vox_grain);
   }
   std::cout << "\ndone." << std::endl;
 
@@ -825,22 +842,19 @@ bool bvxm_voxel_world::update_lidar_impl(bvxm_image_metadata const& metadata,
   bvxm_voxel_grid<float> PLvisX(grid_size);
 
   bvxm_voxel_slab<float> PLPX(grid_size.x(),grid_size.y(),1);
-  bvxm_voxel_slab<float> PXvisX(grid_size.x(), grid_size.y(),1);
 
   bvxm_voxel_slab<float> preX_accum(image_slab.nx(),image_slab.ny(),1);
   bvxm_voxel_slab<float> visX_accum(image_slab.nx(),image_slab.ny(),1);
-  bvxm_voxel_slab<float> img_scratch(image_slab.nx(),image_slab.ny(),1);
-  bvxm_voxel_slab<float> PLPX_img(image_slab.nx(), image_slab.ny(),1);
-  bvxm_voxel_slab<float> PX_img(image_slab.nx(), image_slab.ny(),1);
   bvxm_voxel_slab<float> mask_slab(image_slab.nx(), image_slab.ny(),1);
 
   preX_accum.fill(0.0f);
   visX_accum.fill(1.0f);
+  mask_slab.fill(0.0f);
 
   // slabs for holding backprojections of visX
   bvxm_voxel_slab<float> visX(grid_size.x(),grid_size.y(),1);
-
-  bvxm_voxel_slab<obs_datatype> frame_backproj(grid_size.x(),grid_size.y(),1);
+  // probabilities of the LIDAR returns at the voxels of a slab
+  bvxm_voxel_slab<float> PL(grid_size.x(),grid_size.y(),1);
 
   std::cout << "Pass 1:" << std::endl;
 
@@ -851,9 +865,7 @@ bool bvxm_voxel_world::update_lidar_impl(bvxm_image_metadata const& metadata,
   typename bvxm_voxel_grid<ocp_datatype>::const_iterator ocp_slab_it = ocp_grid->begin();
   typename bvxm_voxel_grid<float>::iterator preX_slab_it = preX.begin();
   typename bvxm_voxel_grid<float>::iterator PLvisX_slab_it = PLvisX.begin();
-#ifdef DEBUG
-  double p_max = 0.0;
-#endif
+
   // The default values for the LIDAR Gaussian error ellipsoid
   // X-Y standard deviation set to 1/Sqrt(2) pixel spacing (arbitrary)
   // standard deviation in z measured from actual Buckeye data (0.03 m)
@@ -862,137 +874,56 @@ bool bvxm_voxel_world::update_lidar_impl(bvxm_image_metadata const& metadata,
   // The vector of spherical Gaussian variances
   vnl_vector_fixed<float,3> vars(xy_var, xy_var, 0.0009f);
 
+  // the rows of each slab are shared between threads
+  unsigned nthreads = vpl_parallel_for_num_threads(num_threads_);
+  unsigned vox_grain = std::max(1u, grid_size.y()/(4*nthreads));
+  unsigned img_grain = std::max(1u, image_slab.ny()/(4*nthreads));
+
+  bvxm_update_lidar_rows<ocp_datatype> lidar_rows(lidar_processor, nthreads, metadata.img, vars, params_->voxel_length(scale),
+                                                  preX_accum, visX_accum);
+  lidar_rows.PLPX = PLPX;
+  lidar_rows.visX = visX;
+  lidar_rows.PL = PL;
+  bvxm_update_accum_rows<ocp_datatype> accum_rows(preX_accum, visX_accum, mask_slab, return_mask);
+  accum_rows.PIPX = PLPX;
+
   for (unsigned k_idx=0; k_idx<(unsigned)grid_size.z(); ++k_idx, ++ocp_slab_it, ++preX_slab_it, ++PLvisX_slab_it)
   {
     std::cout << k_idx << std::endl;
 
-    // backproject image onto voxel plane
-    bvxm_util::warp_slab_bilinear(image_slab, H_plane_to_img[k_idx], frame_backproj);
-
-#ifdef DEBUG
-    std::stringstream ss;
-    ss << "./frame_backproj_" << k_idx <<".tiff";
-    bvxm_util::write_slab_as_image(frame_backproj,ss.str());
-#endif
-    // transform preX to voxel plane for this level
-    bvxm_util::warp_slab_bilinear(preX_accum, H_plane_to_img[k_idx], *preX_slab_it);
-    // transform visX to voxel plane for this level
-    bvxm_util::warp_slab_bilinear(visX_accum, H_plane_to_img[k_idx], visX);
-
-    // initialize PLvisX with PL(X)
-
-    bvxm_voxel_slab<float> PL(frame_backproj.nx(), frame_backproj.ny(), frame_backproj.nz());
-    PL.fill(0.0);
-
-    vil_image_view_base_sptr lidar = metadata.img;
-
-    vgl_point_3d<float> local_xyz = voxel_index_to_xyz(0, 0, k_idx,scale);
-
-    for (unsigned i_idx=0; i_idx<frame_backproj.nx(); i_idx++)
-    {
-      for (unsigned j_idx=0; j_idx<frame_backproj.ny(); j_idx++)
-      {
-        std::vector<vgl_homg_point_2d<double> > vp(4);
-        int i = i_idx+1;
-        int j = j_idx-1;
-        vp[0] = vgl_homg_point_2d<double>(i, j);
-        vp[1] = vgl_homg_point_2d<double>(i+1, j);
-        vp[2] = vgl_homg_point_2d<double>(i, j+1);
-        vp[3] = vgl_homg_point_2d<double>(i+1, j+1);
-
-        vgl_h_matrix_2d<double> h_max = H_plane_to_img[k_idx];
-        vgl_h_matrix_2d<double> h_min;
-        if (k_idx == (unsigned)grid_size.z()-1)
-          h_min = H_plane_to_img[k_idx];
-        else
-          h_min = H_plane_to_img[k_idx+1];
-        vgl_box_2d<double> lidar_roi;
-
-        for (unsigned i=0; i<4; i++) {
-          vgl_homg_point_2d<double> img_pos_h_min = h_min*vp[i];
-          vgl_point_2d<double> img_pos_min(img_pos_h_min);
-          lidar_roi.add(img_pos_min);
-        }
-
-        float p = lidar_processor.prob_density(lidar, local_xyz.z(), vars, lidar_roi, params_->voxel_length(scale));
-
-#ifdef DEBUG
-        if (p > p_max) {
-          p_max = p;
-          std::cout << "-------------max_p=" << p << std::endl;
-        }
-        if (p >1.0) {
-          std::cout << "ERROR!" << std::endl;
-//       /   p=max_vox_prob;
-        }
-#endif
-        PL(i_idx, j_idx) = p;
-      }
-    }
-
-    // now multiply by visX
-    bvxm_util::multiply_slabs(visX,PL,*PLvisX_slab_it);
-
-    // Is this needed? - FIXME
-    // update appearance model, using PX*visX as the weights
-    bvxm_util::multiply_slabs(*ocp_slab_it,visX,PXvisX);
-
-    // multiply to get PLPX
-    bvxm_util::multiply_slabs(*ocp_slab_it,PL,PLPX);
+    // back-project preX and visX onto the voxel plane, compute PL(X)*visX and PL(X)*P(X)
+    lidar_rows.H_plane_to_img = H_plane_to_img[k_idx];
+    if (k_idx == (unsigned)grid_size.z()-1)
+      lidar_rows.H_plane_to_img_below = H_plane_to_img[k_idx];
+    else
+      lidar_rows.H_plane_to_img_below = H_plane_to_img[k_idx+1];
+    lidar_rows.z = voxel_index_to_xyz(0, 0, k_idx,scale).z();
+    lidar_rows.ocp = *ocp_slab_it;
+    lidar_rows.preX = *preX_slab_it;
+    lidar_rows.PLvisX = *PLvisX_slab_it;
+    vpl_parallel_for(grid_size.y(), lidar_rows, nthreads, vox_grain);
 #ifdef DEBUG
-    std::stringstream ss1, ss2, ss3;
+    std::stringstream ss1, ss2;
     ss1 << "PL_" << k_idx <<".tiff";
     ss2 <<"PX_" << k_idx <<".tiff";
-    ss3 << "PL_P" << k_idx <<".tiff";
     bvxm_util::write_slab_as_image(PL,ss1.str());
     bvxm_util::write_slab_as_image(*ocp_slab_it,ss2.str());
-#if 0
-    bvxm_util::write_slab_as_image(PL_p,ss3.str());
-#endif // 0
 #endif // DEBUG
-    // warp PLPX back to image domain
-    bvxm_util::warp_slab_bilinear(PLPX, H_img_to_plane[k_idx], PLPX_img);
-
-    // multiply PLPX by visX and add to preX_accum
-    typename bvxm_voxel_slab<float>::iterator PLPX_img_it = PLPX_img.begin();
-    typename bvxm_voxel_slab<float>::iterator visX_accum_it = visX_accum.begin();
-    typename bvxm_voxel_slab<float>::iterator preX_accum_it = preX_accum.begin();
 
-    for (; preX_accum_it != preX_accum.end(); ++preX_accum_it, ++PLPX_img_it, ++visX_accum_it) {
-      *preX_accum_it += (*PLPX_img_it) * (*visX_accum_it);
-    }
+    // warp PLPX and P(X) back to the image, accumulate preX and visX for the next level
+    accum_rows.H_img_to_plane = H_img_to_plane[k_idx];
+    accum_rows.ocp = *ocp_slab_it;
+    vpl_parallel_for(image_slab.ny(), accum_rows, nthreads, img_grain);
 #ifdef DEBUG
-    std::stringstream plpx, vis, prex;
-    plpx << "PLPX_" << k_idx <<".tiff";
+    std::stringstream vis, prex;
     vis  << "visX_" << k_idx <<".tiff";
     prex << "preX_" << k_idx <<".tiff";
-    bvxm_util::write_slab_as_image(PLPX_img,plpx.str());
     bvxm_util::write_slab_as_image(visX_accum,vis.str());
     bvxm_util::write_slab_as_image(preX_accum,prex.str());
 #endif
-    // scale and offset voxel probabilities to get (1-P(X))
-    // transform (1-P(X)) to image plane to accumulate visX for next level
-    bvxm_util::warp_slab_bilinear(*ocp_slab_it, H_img_to_plane[k_idx], PX_img);
-
-    if (return_mask) {
-      bvxm_util::add_slabs(PX_img,mask_slab,mask_slab);
-    }
-
-    // note: doing scale and offset in image domain so invalid pixels become 1.0 and don't affect visX
-    typename bvxm_voxel_slab<float>::iterator PX_img_it = PX_img.begin();
-    visX_accum_it = visX_accum.begin();
-    for (; visX_accum_it != visX_accum.end(); ++visX_accum_it, ++PX_img_it) {
-#if 0
-      ocp_datatype o = *PX_img_it;
-#endif // 0
-      *visX_accum_it *= 1 - *PX_img_it; //-(o - 1);
-    }
   }
   // now traverse a second time, computing new P(X) along the way.
 
-  bvxm_voxel_slab<float> preX_accum_vox(grid_size.x(),grid_size.y(),1);
-  bvxm_voxel_slab<float> visX_accum_vox(grid_size.x(),grid_size.y(),1);
-
 #ifdef DEBUG
   std::stringstream vis2, prex2;
   vis2  << "visX2_.tiff";
@@ -1005,38 +936,18 @@ bool bvxm_voxel_world::update_lidar_impl(bvxm_image_metadata const& metadata,
   PLvisX_slab_it = PLvisX.begin();
   preX_slab_it = preX.begin();
   typename bvxm_voxel_grid<ocp_datatype>::iterator ocp_slab_it2 = ocp_grid->begin();
+  // leave out the ray normalization for now - results seem a little better without it.  -DEC
+  const float preX_sum_thresh = 0.0f;
+  bvxm_update_ocp_rows<ocp_datatype> ocp_rows(preX_accum, visX_accum, grid_size.x(), grid_size.y(),
+                                              min_vox_prob, max_vox_prob, preX_sum_thresh, false);
   for (unsigned k_idx = 0; k_idx < (unsigned)grid_size.z(); ++k_idx, ++PLvisX_slab_it, ++preX_slab_it, ++ocp_slab_it2)
   {
     std::cout << '.';
-
-    // transform preX_sum to current level
-    bvxm_util::warp_slab_bilinear(preX_accum, H_plane_to_img[k_idx], preX_accum_vox);
-
-    // transform visX_sum to current level
-    bvxm_util::warp_slab_bilinear(visX_accum, H_plane_to_img[k_idx], visX_accum_vox);
-
-    const float preX_sum_thresh = 0.0f;
-
-    typename bvxm_voxel_slab<float>::const_iterator preX_it = preX_slab_it->begin(),
-                                                    PLvisX_it = PLvisX_slab_it->begin(),
-                                                    preX_sum_it = preX_accum_vox.begin(),
-                                                    visX_sum_it = visX_accum_vox.begin();
-    typename bvxm_voxel_slab<ocp_datatype>::iterator PX_it = ocp_slab_it2->begin();
-
-    for (; PX_it != ocp_slab_it2->end(); ++PX_it, ++preX_it, ++PLvisX_it, ++preX_sum_it, ++visX_sum_it) {
-      // if preX_sum is zero at the voxel, no ray passed through the voxel (out of image)
-      if (*preX_sum_it > preX_sum_thresh) {
-        float multiplier = (*PLvisX_it + *preX_it) / *preX_sum_it;
-#if 0 // leave out normalization for now - results seem a little better without it.  -DEC
-        float ray_norm = 1 - *visX_sum_it; // normalize based on probability that a surface voxel is located along the ray. This was not part of the original Pollard + Mundy algorithm.
-#endif // 0
-        *PX_it *= multiplier; // * ray_norm;
-      }
-      if (*PX_it < min_vox_prob)
-        *PX_it = min_vox_prob;
-      if (*PX_it > max_vox_prob)
-        *PX_it = max_vox_prob;
-    }
+    ocp_rows.H_plane_to_img = H_plane_to_img[k_idx];
+    ocp_rows.preX = *preX_slab_it;
+    ocp_rows.PIvisX = *PLvisX_slab_it;
+    ocp_rows.ocp = *ocp_slab_it2;
+    vpl_parallel_for(grid_size.y(), ocp_rows, nthreads, vox_grain);
   }
   std::cout << "\ndone." << std::endl;
 
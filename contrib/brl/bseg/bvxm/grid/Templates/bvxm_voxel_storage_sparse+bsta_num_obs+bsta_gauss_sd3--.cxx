@@ -0,0 +1,8 @@
+#include <bvxm/grid/bvxm_voxel_storage_sparse.hxx>
+#include <bsta/bsta_gauss_sd3.h>
+#include <bsta/bsta_attributes.h>
+#include <bsta/io/bsta_io_attributes.h>
+#include <bsta/io/bsta_io_gaussian_sphere.h>
+
+typedef bsta_num_obs<bsta_gauss_sd3> gauss_type;
+BVXM_VOXEL_STORAGE_SPARSE_INSTANTIATE(gauss_type);
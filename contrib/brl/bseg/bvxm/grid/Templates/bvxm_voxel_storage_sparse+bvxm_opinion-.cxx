@@ -0,0 +1,4 @@
+#include <bvxm/grid/bvxm_voxel_storage_sparse.hxx>
+#include <bvxm/grid/bvxm_opinion.h>
+
+BVXM_VOXEL_STORAGE_SPARSE_INSTANTIATE(bvxm_opinion);
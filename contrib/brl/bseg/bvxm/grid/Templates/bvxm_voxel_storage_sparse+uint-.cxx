@@ -0,0 +1,3 @@
+#include <bvxm/grid/bvxm_voxel_storage_sparse.hxx>
+
+BVXM_VOXEL_STORAGE_SPARSE_INSTANTIATE(unsigned int);
@@ -0,0 +1,114 @@
+#include <iostream>
+#include "bvxm_async_slab_io.h"
+//:
+// \file
+#include <vcl_compiler.h>
+#include <vxl_config.h>
+#ifdef BVXM_USE_FSTREAM64
+#include <vil/vil_stream_fstream64.h>
+#else
+#include <vil/vil_stream_fstream.h>
+#endif
+
+#if VXL_HAS_PTHREAD_H
+#include <pthread.h>
+#endif
+
+bvxm_async_slab_io::bvxm_async_slab_io(std::string const& filename)
+: fname_(filename), running_(false), ok_(true), thread_(VXL_NULLPTR)
+{
+#if VXL_HAS_PTHREAD_H
+  thread_ = new pthread_t;
+#endif
+}
+
+bvxm_async_slab_io::~bvxm_async_slab_io()
+{
+  wait();
+#if VXL_HAS_PTHREAD_H
+  delete static_cast<pthread_t*>(thread_);
+#endif
+}
+
+void bvxm_async_slab_io::add_read(vil_streampos pos, char* buf, vil_streampos len)
+{
+  request r = { false, pos, buf, len };
+  queued_.push_back(r);
+}
+
+void bvxm_async_slab_io::add_write(vil_streampos pos, char* buf, vil_streampos len)
+{
+  request r = { true, pos, buf, len };
+  queued_.push_back(r);
+}
+
+bool bvxm_async_slab_io::start()
+{
+  bool prev_ok = wait();
+  batch_.swap(queued_);
+  queued_.clear();
+  if (batch_.empty())
+    return prev_ok;
+  running_ = true;
+#if VXL_HAS_PTHREAD_H
+  if (pthread_create(static_cast<pthread_t*>(thread_), VXL_NULLPTR, &bvxm_async_slab_io::thread_main, this) == 0)
+    return prev_ok;
+  std::cerr << "warning: bvxm_async_slab_io could not create a thread, doing synchronous I/O\n";
+#endif
+  run_batch();
+  running_ = false;
+  return prev_ok;
+}
+
+bool bvxm_async_slab_io::wait()
+{
+  if (running_) {
+#if VXL_HAS_PTHREAD_H
+    pthread_join(*static_cast<pthread_t*>(thread_), VXL_NULLPTR);
+#endif
+    running_ = false;
+  }
+  bool ok = ok_;
+  ok_ = true;
+  return ok;
+}
+
+void* bvxm_async_slab_io::thread_main(void* self)
+{
+  static_cast<bvxm_async_slab_io*>(self)->run_batch();
+  return VXL_NULLPTR;
+}
+
+void bvxm_async_slab_io::run_batch()
+{
+  // the stream is opened per batch, so that every write is on disk once the batch is done
+#ifdef BVXM_USE_FSTREAM64
+  vil_stream* fio = new vil_stream_fstream64(fname_.c_str(),"rw");
+#else
+  vil_stream* fio = new vil_stream_fstream(fname_.c_str(),"rw");
+#endif
+  fio->ref();
+  if (!fio->ok()) {
+    std::cerr << "error opening file " << fname_ << " for read/write!\n";
+    ok_ = false;
+  }
+  for (unsigned i = 0; ok_ && i < batch_.size(); ++i) {
+    request const& r = batch_[i];
+    fio->seek(r.pos);
+    if (fio->tell() != r.pos) {
+      std::cerr << "error seeking to file position " << r.pos << " in " << fname_ << '\n';
+      ok_ = false;
+      break;
+    }
+    vil_streampos n = r.write ? fio->write(r.buf, r.len) : fio->read(r.buf, r.len);
+    if (n != r.len) {
+      std::cerr << "error: " << (r.write ? "wrote " : "read ") << n << " of " << r.len
+                << " bytes at file position " << r.pos << " in " << fname_ << '\n';
+      ok_ = false;
+    }
+  }
+  batch_.clear();
+  // this will delete the stream object.
+  fio->unref();
+  return;
+}
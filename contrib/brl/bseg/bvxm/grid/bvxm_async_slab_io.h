@@ -0,0 +1,74 @@
+#ifndef bvxm_async_slab_io_h_
+#define bvxm_async_slab_io_h_
+//:
+// \file
+// \brief Background reads and writes of slab data in a voxel grid file
+//
+// Requests are queued with add_read()/add_write() and executed in order, on a
+// helper thread, after start().  The caller must not touch the buffers of a
+// batch until wait() has returned.  Used by the double buffered mode of
+// bvxm_voxel_storage_disk_cached to read the next slabs and write back the
+// previous ones while the current ones are processed.
+//
+// Without pthreads start() executes the batch before returning.
+//
+// \verbatim
+//  Modifications
+// \endverbatim
+
+#include <string>
+#include <vector>
+#include <vcl_compiler.h>
+#include <vil/vil_stream.h>
+
+class bvxm_async_slab_io
+{
+ public:
+  bvxm_async_slab_io(std::string const& filename);
+
+  //: waits for the running batch
+  ~bvxm_async_slab_io();
+
+  //: Queue a read of len bytes at file position pos into buf
+  void add_read(vil_streampos pos, char* buf, vil_streampos len);
+
+  //: Queue a write of len bytes from buf to file position pos
+  void add_write(vil_streampos pos, char* buf, vil_streampos len);
+
+  //: Start executing the queued requests; waits for the previous batch first.
+  //  Returns false if the previous batch failed.
+  bool start();
+
+  //: Wait for the running batch, returns false if one of its requests failed
+  bool wait();
+
+  //: True if a batch is running
+  bool busy() const { return running_; }
+
+ private:
+  struct request
+  {
+    bool write;
+    vil_streampos pos;
+    char* buf;
+    vil_streampos len;
+  };
+
+  std::string fname_;
+  std::vector<request> queued_;
+  std::vector<request> batch_;
+  bool running_;
+  bool ok_;
+  // the thread handle lives in the implementation file
+  void* thread_;
+
+  //: execute batch_ (runs on the helper thread)
+  void run_batch();
+  static void* thread_main(void* self);
+
+  // not copyable
+  bvxm_async_slab_io(bvxm_async_slab_io const&);
+  bvxm_async_slab_io& operator=(bvxm_async_slab_io const&);
+};
+
+#endif // bvxm_async_slab_io_h_
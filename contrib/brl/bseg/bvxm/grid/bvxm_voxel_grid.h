@@ -6,6 +6,7 @@
 #include <iostream>
 #include <string>
 #include <vcl_compiler.h>
+#include <vxl_config.h>
 #include <vgl/vgl_vector_3d.h>
 
 #include "bvxm_voxel_grid_base.h"
@@ -15,6 +16,7 @@
 #include "bvxm_voxel_storage_disk_cached.h"
 #include "bvxm_voxel_storage_mem.h"
 #include "bvxm_voxel_storage_slab_mem.h"
+#include "bvxm_voxel_storage_sparse.h"
 #include "bvxm_voxel_slab_iterator.h"
 
 
@@ -40,10 +42,12 @@ class bvxm_voxel_grid : public bvxm_voxel_grid_base
   }
 
    //: Constructor for cached disk-based voxel grid.
-  bvxm_voxel_grid(std::string storage_fname, vgl_vector_3d<unsigned int> grid_size, unsigned max_cache_size)
+   //  If double_buffered is set, half of the cache is used to read the following slabs in the background.
+  bvxm_voxel_grid(std::string storage_fname, vgl_vector_3d<unsigned int> grid_size, vxl_int_64 max_cache_size,
+                  bool double_buffered = false)
     : bvxm_voxel_grid_base(grid_size)
   {
-    storage_ = new bvxm_voxel_storage_disk_cached<T>(storage_fname, grid_size, max_cache_size);
+    storage_ = new bvxm_voxel_storage_disk_cached<T>(storage_fname, grid_size, max_cache_size, double_buffered);
   }
 
   //: Constructor for memory-based voxel grid.
@@ -60,6 +64,11 @@ class bvxm_voxel_grid : public bvxm_voxel_grid_base
     storage_ = new bvxm_voxel_storage_slab_mem<T>(grid_size, num_slabs);
   }
 
+  //: Constructor for a voxel grid using the given storage, e.g. a bvxm_voxel_storage_sparse.
+  //  The grid takes ownership of storage.
+  bvxm_voxel_grid(bvxm_voxel_storage<T>* storage)
+    : bvxm_voxel_grid_base(vgl_vector_3d<unsigned int>(storage->nx(), storage->ny(), storage->nz())), storage_(storage) {}
+
   //: Destructor
   virtual ~bvxm_voxel_grid()
   {
@@ -71,6 +71,12 @@ class bvxm_voxel_slab : public bvxm_voxel_slab_base
     return !operator==(rhs);
   }
 
+  //: A slab sharing the memory of rows [y0,y1) of this (single plane) slab.
+  //  Used to split the processing of a slab between threads.
+  bvxm_voxel_slab<T> rows(unsigned y0, unsigned y1) const {
+    assert(nz_ == 1); assert(y0 <= y1); assert(y1 <= ny_);
+    return bvxm_voxel_slab<T>(nx_, y1-y0, 1, mem_, first_voxel_ + nx_*y0); }
+
   //: deep copy data in slab
   void deep_copy(bvxm_voxel_slab<T> const& src);
 
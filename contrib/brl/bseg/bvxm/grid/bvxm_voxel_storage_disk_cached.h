@@ -15,14 +15,25 @@
 
 #include "bvxm_voxel_storage.h"
 #include "bvxm_voxel_storage_disk.h" // for header
+#include "bvxm_async_slab_io.h"
 
 
 //: object for reading and writing voxel data from a file on disk.
+//  The slices of the grid are cached in memory (max_cache_size bytes) and
+//  written back to disk when they are replaced in the cache.
+//
+//  In double buffered mode the cache is split into two halves: while the
+//  slices of one half are processed, the slices following them are read into
+//  the other half in the background, and a half that is replaced is written
+//  back in the background as well.  A top-down traversal of the grid (e.g.
+//  with bvxm_voxel_slab_iterator) thus overlaps disk I/O and processing;
+//  other access patterns fall back to synchronous reads.
 template <class T>
 class bvxm_voxel_storage_disk_cached : public bvxm_voxel_storage<T>
 {
  public:
-  bvxm_voxel_storage_disk_cached(std::string storage_filename, vgl_vector_3d<unsigned int> grid_size, vxl_int_64 max_cache_size);
+  bvxm_voxel_storage_disk_cached(std::string storage_filename, vgl_vector_3d<unsigned int> grid_size, vxl_int_64 max_cache_size,
+                                 bool double_buffered = false);
   virtual ~bvxm_voxel_storage_disk_cached();
 
   virtual bool initialize_data(T const& value);
@@ -35,11 +46,19 @@ class bvxm_voxel_storage_disk_cached : public bvxm_voxel_storage<T>
   virtual void increment_observations();
   //: zero the number of observations
   virtual void zero_observations();
+
+  //: true if the slices following the cached ones are read in the background
+  bool double_buffered() const { return aio_ != 0; }
  protected:
 
    bool fill_cache(unsigned start_slice_idx);
    bool purge_cache();
 
+   //: double buffered mode: make the prefetched half the active one and start the next prefetch
+   bool swap_cache();
+   //: double buffered mode: queue a prefetch of the slices following the cached ones
+   void prefetch_next();
+
    bvxm_memory_chunk_sptr cache_mem_;
    unsigned n_cache_slices_;
 
@@ -47,6 +66,13 @@ class bvxm_voxel_storage_disk_cached : public bvxm_voxel_storage<T>
    int first_cache_slice_;
    int last_cache_slice_;
 
+   //: double buffered mode: the second half of the cache and the slices it holds
+   bvxm_memory_chunk_sptr prefetch_mem_;
+   int first_prefetch_slice_;
+   int last_prefetch_slice_;
+   //: background I/O, only used in double buffered mode
+   bvxm_async_slab_io *aio_;
+
    std::string storage_fname_;
 
   // input and output file stream
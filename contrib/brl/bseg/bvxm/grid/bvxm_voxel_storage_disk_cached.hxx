@@ -5,6 +5,7 @@
 
 #include <string>
 #include <iostream>
+#include <algorithm>
 #include "bvxm_voxel_storage_disk_cached.h"
 //
 #include <vcl_compiler.h>
@@ -21,23 +22,31 @@
 #include "bvxm_voxel_slab.h"
 
 template <class T>
-bvxm_voxel_storage_disk_cached<T>::bvxm_voxel_storage_disk_cached(std::string storage_filename, vgl_vector_3d<unsigned int> grid_size, vxl_int_64 max_cache_size)
-:  bvxm_voxel_storage<T>(grid_size), first_cache_slice_(-1), last_cache_slice_(-1), storage_fname_(storage_filename), fio_(0)
+bvxm_voxel_storage_disk_cached<T>::bvxm_voxel_storage_disk_cached(std::string storage_filename, vgl_vector_3d<unsigned int> grid_size, vxl_int_64 max_cache_size,
+                                                                  bool double_buffered)
+:  bvxm_voxel_storage<T>(grid_size), first_cache_slice_(-1), last_cache_slice_(-1),
+   first_prefetch_slice_(-1), last_prefetch_slice_(-1), aio_(0), storage_fname_(storage_filename), fio_(0)
 {
   //set up cache
   vxl_int_64 slice_size = sizeof(T)*grid_size.x()*grid_size.y();
-  n_cache_slices_ = (unsigned)(max_cache_size / slice_size);
+  // in double buffered mode each half of the cache gets half of the memory
+  n_cache_slices_ = (unsigned)(max_cache_size / (double_buffered ? 2*slice_size : slice_size));
   if (n_cache_slices_ > this->grid_size_.z()) {
     n_cache_slices_ = this->grid_size_.z();
   }
   vxl_int_64 cache_size = slice_size * n_cache_slices_;
 
-  std::cout << "allocating cache size of " << cache_size << " bytes ( " << n_cache_slices_ << " slices )." << std::endl;
+  std::cout << "allocating cache size of " << (double_buffered ? 2 : 1)*cache_size << " bytes ( "
+            << (double_buffered ? "2 x " : "") << n_cache_slices_ << " slices )." << std::endl;
 
   cache_mem_ = new bvxm_memory_chunk(cache_size);
   if (!cache_mem_) {
     std::cerr << "ERROR allocating cache memory!\n";
   }
+  if (double_buffered) {
+    prefetch_mem_ = new bvxm_memory_chunk(cache_size);
+    aio_ = new bvxm_async_slab_io(storage_fname_);
+  }
 
   // check if file exists already or not
   if (vul_file::exists(storage_fname_))  {
@@ -81,6 +90,9 @@ bvxm_voxel_storage_disk_cached<T>::~bvxm_voxel_storage_disk_cached()
   // purge the cache
   std::cout << " ------------ destructor: purging cache --------------" << std::endl;
   purge_cache();
+  // waits for a running prefetch
+  delete aio_;
+  aio_ = 0;
 
   // this will delete the stream object
   if (fio_) {
@@ -90,6 +102,7 @@ bvxm_voxel_storage_disk_cached<T>::~bvxm_voxel_storage_disk_cached()
   }
 
   cache_mem_ = 0;
+  prefetch_mem_ = 0;
 }
 
 
@@ -114,6 +127,9 @@ bool bvxm_voxel_storage_disk_cached<T>::initialize_data(T const& value)
       return false;
     }
   }
+  // a running prefetch must not read the file while it is rewritten
+  if (aio_)
+    aio_->wait();
   // everything looks ok. open file for write and fill with data
 #ifdef BVXM_USE_FSTREAM64
   fio_ = new vil_stream_fstream64(storage_fname_.c_str(),"w");
@@ -141,6 +157,8 @@ bool bvxm_voxel_storage_disk_cached<T>::initialize_data(T const& value)
   // no longer have any active slabs
   first_cache_slice_ = -1;
   last_cache_slice_ = -1;
+  first_prefetch_slice_ = -1;
+  last_prefetch_slice_ = -1;
 
   // close output stream
   // this will delete the stream object.
@@ -172,25 +190,29 @@ bvxm_voxel_slab<T> bvxm_voxel_storage_disk_cached<T>::get_slab(unsigned slice_id
   unsigned last_slice_idx = slice_idx + slab_thickness - 1;
 
   // check to see if slab is already in cache
-  T* first_voxel = 0;
-  if ( ((int)slice_idx < first_cache_slice_ ) || ((int)slice_idx > last_cache_slice_) ){
+  if ( ((int)slice_idx < first_cache_slice_ ) || ((int)last_slice_idx > last_cache_slice_) ){
     // slab is not in cache
-    purge_cache();
-    fill_cache(slice_idx);
+    if ( aio_ && ((int)slice_idx >= first_prefetch_slice_) && ((int)last_slice_idx <= last_prefetch_slice_) ) {
+      // but it has been (or is being) read into the other half
+      if (!swap_cache()) {
+        bvxm_voxel_slab<T> slab;
+        return slab;
+      }
+    }
+    else {
+      purge_cache();
+      fill_cache(slice_idx);
+    }
     // make sure fill cache was successful
     if ( ((int)slice_idx < first_cache_slice_ ) || ((int)last_slice_idx > last_cache_slice_) ) {
       std::cerr << "error: slices " << slice_idx << "through " << last_slice_idx << " still not in cache after fill.\n";
       bvxm_voxel_slab<T> slab;
       return slab;
     }
-    // fill was successful
-    first_voxel = reinterpret_cast<T*>(cache_mem_->data());
-  }
-  else {
-    // entire slab is already in cache.
-    vxl_uint_64 slice_size = this->grid_size_.x()*this->grid_size_.y();
-    first_voxel = reinterpret_cast<T*>(cache_mem_->data()) + ((slice_idx - first_cache_slice_)*slice_size);
   }
+  // entire slab is in cache.
+  vxl_uint_64 slice_size = this->grid_size_.x()*this->grid_size_.y();
+  T* first_voxel = reinterpret_cast<T*>(cache_mem_->data()) + ((slice_idx - first_cache_slice_)*slice_size);
   bvxm_voxel_slab<T> slab(this->grid_size_.x(),this->grid_size_.y(), slab_thickness, cache_mem_, first_voxel);
   return slab;
 }
@@ -205,6 +227,19 @@ bool bvxm_voxel_storage_disk_cached<T>::purge_cache()
     return true;
   }
 
+  if (aio_) {
+    // the prefetched slices are not modified, so they are simply dropped
+    vil_streampos write_len = (last_cache_slice_ - first_cache_slice_ + 1)*this->grid_size_.x()*this->grid_size_.y()*sizeof(T);
+    aio_->add_write(slab_filepos(first_cache_slice_), reinterpret_cast<char*>(cache_mem_->data()), write_len);
+    bool ok = aio_->start();
+    ok = aio_->wait() && ok;
+    first_cache_slice_ = -1;
+    last_cache_slice_ = -1;
+    first_prefetch_slice_ = -1;
+    last_prefetch_slice_ = -1;
+    return ok;
+  }
+
   // check to see if file is already open
   if (!fio_) {
 #ifdef BVXM_USE_FSTREAM64
@@ -240,6 +275,20 @@ bool bvxm_voxel_storage_disk_cached<T>::purge_cache()
 template<class T>
 bool bvxm_voxel_storage_disk_cached<T>::fill_cache(unsigned start_slice_idx)
 {
+  if (aio_) {
+    unsigned last_slice_idx = std::min(start_slice_idx + n_cache_slices_, this->grid_size_.z()) - 1;
+    vil_streampos read_size = (last_slice_idx - start_slice_idx + 1)*this->grid_size_.x()*this->grid_size_.y()*sizeof(T);
+    aio_->add_read(slab_filepos(start_slice_idx), reinterpret_cast<char*>(cache_mem_->data()), read_size);
+    bool ok = aio_->start();
+    ok = aio_->wait() && ok;
+    if (!ok)
+      return false;
+    first_cache_slice_ = start_slice_idx;
+    last_cache_slice_ = last_slice_idx;
+    prefetch_next();
+    return true;
+  }
+
   // check to see if file is already open
   if (!fio_) {
 #ifdef BVXM_USE_FSTREAM64
@@ -271,6 +320,45 @@ bool bvxm_voxel_storage_disk_cached<T>::fill_cache(unsigned start_slice_idx)
   return true;
 }
 
+template<class T>
+bool bvxm_voxel_storage_disk_cached<T>::swap_cache()
+{
+  // wait for the prefetch to complete
+  bool ok = aio_->wait();
+
+  std::swap(cache_mem_, prefetch_mem_);
+  std::swap(first_cache_slice_, first_prefetch_slice_);
+  std::swap(last_cache_slice_, last_prefetch_slice_);
+
+  // the slices that were just replaced are now in the other half: write them
+  // back, then reuse that half for the slices following the new ones.
+  // The requests of a batch are executed in order.
+  if (first_prefetch_slice_ >= 0) {
+    vil_streampos write_len = (last_prefetch_slice_ - first_prefetch_slice_ + 1)*this->grid_size_.x()*this->grid_size_.y()*sizeof(T);
+    aio_->add_write(slab_filepos(first_prefetch_slice_), reinterpret_cast<char*>(prefetch_mem_->data()), write_len);
+  }
+  first_prefetch_slice_ = -1;
+  last_prefetch_slice_ = -1;
+  prefetch_next();
+
+  return ok;
+}
+
+template<class T>
+void bvxm_voxel_storage_disk_cached<T>::prefetch_next()
+{
+  unsigned start_slice_idx = (unsigned)(last_cache_slice_ + 1);
+  if (last_cache_slice_ >= 0 && start_slice_idx < this->grid_size_.z()) {
+    unsigned last_slice_idx = std::min(start_slice_idx + n_cache_slices_, this->grid_size_.z()) - 1;
+    vil_streampos read_size = (last_slice_idx - start_slice_idx + 1)*this->grid_size_.x()*this->grid_size_.y()*sizeof(T);
+    aio_->add_read(slab_filepos(start_slice_idx), reinterpret_cast<char*>(prefetch_mem_->data()), read_size);
+    first_prefetch_slice_ = start_slice_idx;
+    last_prefetch_slice_ = last_slice_idx;
+  }
+  // errors of the previous batch were already reported by the I/O thread
+  aio_->start();
+}
+
 template <class T>
 void bvxm_voxel_storage_disk_cached<T>::put_slab()
 {
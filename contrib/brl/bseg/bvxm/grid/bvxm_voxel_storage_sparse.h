@@ -0,0 +1,87 @@
+// This is contrib/brl/bseg/bvxm/grid/bvxm_voxel_storage_sparse.h
+#ifndef bvxm_voxel_storage_sparse_h_
+#define bvxm_voxel_storage_sparse_h_
+//:
+// \file
+// \brief A template class for in-memory voxel grid storage that only allocates the bricks which differ from a default value
+//
+//  The grid is divided into bricks of 8x8x8 voxels.  A brick whose voxels all
+//  hold the default value is not stored at all, so the memory used is
+//  proportional to the part of the world that has been changed by updates.
+//
+//  This saves memory, not work: every slab is still assembled and processed.
+//  Note that bvxm_voxel_world::update() changes the occupancy and appearance
+//  of every voxel a camera sees, so only the regions no image has covered yet
+//  (e.g. outside the footprints of the images of a large area) stay sparse.
+//
+//  get_slab() assembles the requested slices in a slab buffer and put_slab()
+//  writes them back, allocating the bricks that now hold other values and
+//  releasing the ones that went back to the default.  As with the disk based
+//  storage only one slab can be active at a time.  Voxels are copied bytewise,
+//  like the disk storage writes them, but compared with T's operator==, so
+//  padding bytes and unused members never make a voxel differ from the default.
+//
+// \verbatim
+//  Modifications:
+// \endverbatim
+
+#include <vector>
+#include "bvxm_voxel_storage.h"
+#include "bvxm_memory_chunk.h"
+#include <vgl/vgl_vector_3d.h>
+#include <vcl_compiler.h>
+
+
+template <class T>
+class bvxm_voxel_storage_sparse : public bvxm_voxel_storage<T>
+{
+ public:
+  //: Edge length (in voxels) of the bricks
+  static const unsigned brick_dim = 8;
+
+  //: Storage of grid_size voxels that all hold default_value
+  bvxm_voxel_storage_sparse(vgl_vector_3d<unsigned int> grid_size, T const& default_value);
+  virtual ~bvxm_voxel_storage_sparse();
+
+  //: Release all bricks and make value the default
+  virtual bool initialize_data(T const& value);
+  virtual bvxm_voxel_slab<T> get_slab(unsigned slice_idx, unsigned slab_thickness);
+  virtual void put_slab();
+
+  //: return number of observations
+  virtual unsigned num_observations() const { return nobservations_; }
+  //: increment the number of observations
+  virtual void increment_observations() { ++nobservations_; }
+  //: zero the number of observations
+  virtual void zero_observations() { nobservations_ = 0; }
+
+  //: Number of allocated bricks
+  unsigned num_bricks() const { return nbricks_; }
+  //: Number of bricks of a dense grid of the same size
+  unsigned max_num_bricks() const { return (unsigned)bricks_.size(); }
+
+ private:
+  //: the default value
+  T default_;
+  //: bricks in z-major order; a null brick holds the default value only
+  std::vector<char*> bricks_;
+  unsigned nbx_, nby_, nbz_;
+  unsigned nbricks_;
+  bvxm_memory_chunk_sptr slab_buffer_;
+  int active_slab_start_;
+  unsigned active_slab_thickness_;
+  unsigned nobservations_;
+
+  char*& brick(unsigned bx, unsigned by, unsigned bz) { return bricks_[(bz*nby_ + by)*nbx_ + bx]; }
+  char* const& brick(unsigned bx, unsigned by, unsigned bz) const { return bricks_[(bz*nby_ + by)*nbx_ + bx]; }
+
+  //: true if all n voxels starting at v hold the default value
+  bool is_default(char const* v, unsigned n) const;
+  void clear_bricks();
+
+  // not implemented
+  bvxm_voxel_storage_sparse(bvxm_voxel_storage_sparse<T> const&);
+  bvxm_voxel_storage_sparse<T>& operator=(bvxm_voxel_storage_sparse<T> const&);
+};
+
+#endif // bvxm_voxel_storage_sparse_h_
@@ -0,0 +1,159 @@
+// This is contrib/brl/bseg/bvxm/grid/bvxm_voxel_storage_sparse.hxx
+#ifndef bvxm_voxel_storage_sparse_hxx_
+#define bvxm_voxel_storage_sparse_hxx_
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "bvxm_voxel_storage_sparse.h"
+// \file
+#include "bvxm_voxel_storage.h"
+#include "bvxm_memory_chunk.h"
+
+#include <vgl/vgl_vector_3d.h>
+#include <vxl_config.h>
+#include <vcl_compiler.h>
+
+template <class T>
+const unsigned bvxm_voxel_storage_sparse<T>::brick_dim;
+
+template <class T>
+bvxm_voxel_storage_sparse<T>::bvxm_voxel_storage_sparse(vgl_vector_3d<unsigned int> grid_size, T const& default_value)
+: bvxm_voxel_storage<T>(grid_size), default_(default_value), nbricks_(0), active_slab_start_(-1), active_slab_thickness_(0),
+  nobservations_(0)
+{
+  nbx_ = (grid_size.x() + brick_dim - 1) / brick_dim;
+  nby_ = (grid_size.y() + brick_dim - 1) / brick_dim;
+  nbz_ = (grid_size.z() + brick_dim - 1) / brick_dim;
+  bricks_.resize(nbx_*nby_*nbz_, VXL_NULLPTR);
+  slab_buffer_ = new bvxm_memory_chunk(vxl_uint_64(grid_size.x())*grid_size.y()*sizeof(T));
+}
+
+template <class T>
+bvxm_voxel_storage_sparse<T>::~bvxm_voxel_storage_sparse()
+{
+  this->clear_bricks();
+}
+
+template <class T>
+void bvxm_voxel_storage_sparse<T>::clear_bricks()
+{
+  for (unsigned i = 0; i < bricks_.size(); ++i) {
+    delete [] bricks_[i];
+    bricks_[i] = VXL_NULLPTR;
+  }
+  nbricks_ = 0;
+}
+
+template <class T>
+bool bvxm_voxel_storage_sparse<T>::is_default(char const* v, unsigned n) const
+{
+  for (unsigned i = 0; i < n; ++i, v += sizeof(T))
+    if (!(*reinterpret_cast<T const*>(v) == default_))
+      return false;
+  return true;
+}
+
+template <class T>
+bool bvxm_voxel_storage_sparse<T>::initialize_data(const T& value)
+{
+  this->clear_bricks();
+  default_ = value;
+  active_slab_start_ = -1;
+  nobservations_ = 0;
+  return true;
+}
+
+template <class T>
+bvxm_voxel_slab<T> bvxm_voxel_storage_sparse<T>::get_slab(unsigned slice_idx, unsigned slab_thickness)
+{
+  if (slice_idx >= this->grid_size_.z() || slab_thickness == 0) {
+    bvxm_voxel_slab<T> slab;
+    return slab;
+  }
+  if (slice_idx + slab_thickness > this->grid_size_.z())
+    slab_thickness = this->grid_size_.z() - slice_idx;
+
+  const unsigned nx = this->grid_size_.x(), ny = this->grid_size_.y();
+  const vxl_uint_64 slab_bytes = vxl_uint_64(nx)*ny*slab_thickness*sizeof(T);
+  if (slab_buffer_->size() != slab_bytes)
+    slab_buffer_->set_size(slab_bytes);
+
+  // copy the rows of the allocated bricks, replicate the default value elsewhere
+  char* row = static_cast<char*>(slab_buffer_->data());
+  for (unsigned z = slice_idx; z < slice_idx + slab_thickness; ++z) {
+    const unsigned bz = z / brick_dim, lz = z % brick_dim;
+    for (unsigned y = 0; y < ny; ++y) {
+      const unsigned by = y / brick_dim, ly = y % brick_dim;
+      for (unsigned bx = 0; bx < nbx_; ++bx) {
+        const unsigned n = std::min(brick_dim, nx - bx*brick_dim);
+        char const* b = this->brick(bx, by, bz);
+        if (b)
+          std::memcpy(row, b + (lz*brick_dim + ly)*brick_dim*sizeof(T), n*sizeof(T));
+        else
+          for (unsigned i = 0; i < n; ++i)
+            std::memcpy(row + i*sizeof(T), &default_, sizeof(T));
+        row += n*sizeof(T);
+      }
+    }
+  }
+  active_slab_start_ = slice_idx;
+  active_slab_thickness_ = slab_thickness;
+
+  bvxm_voxel_slab<T> slab(nx, ny, slab_thickness, slab_buffer_, static_cast<T*>(slab_buffer_->data()));
+  return slab;
+}
+
+template <class T>
+void bvxm_voxel_storage_sparse<T>::put_slab()
+{
+  if (active_slab_start_ < 0) {
+    std::cerr << "error: attempted to put_slab() with no active slab\n";
+    return;
+  }
+  const unsigned nx = this->grid_size_.x(), ny = this->grid_size_.y();
+  const unsigned brick_bytes = brick_dim*brick_dim*brick_dim*sizeof(T);
+  const unsigned z0 = active_slab_start_, z1 = z0 + active_slab_thickness_;
+  char const* slab = static_cast<char const*>(slab_buffer_->data());
+
+  for (unsigned bz = z0 / brick_dim; bz*brick_dim < z1; ++bz) {
+    const unsigned zb = std::max(z0, bz*brick_dim), ze = std::min(z1, (bz+1)*brick_dim);
+    for (unsigned by = 0; by < nby_; ++by) {
+      const unsigned ye = std::min(ny, (by+1)*brick_dim);
+      for (unsigned bx = 0; bx < nbx_; ++bx) {
+        const unsigned n = std::min(brick_dim, nx - bx*brick_dim);
+        char*& b = this->brick(bx, by, bz);
+        bool all_default = true;
+        for (unsigned z = zb; z < ze; ++z) {
+          for (unsigned y = by*brick_dim; y < ye; ++y) {
+            char const* src = slab + ((vxl_uint_64(z - z0)*ny + y)*nx + bx*brick_dim)*sizeof(T);
+            bool row_default = this->is_default(src, n);
+            all_default = all_default && row_default;
+            if (!b) {
+              if (row_default)
+                continue;
+              // the first voxel that differs from the default: allocate the brick
+              b = new char[brick_bytes];
+              for (unsigned i = 0; i < brick_dim*brick_dim*brick_dim; ++i)
+                std::memcpy(b + i*sizeof(T), &default_, sizeof(T));
+              ++nbricks_;
+            }
+            std::memcpy(b + (((z % brick_dim)*brick_dim + (y % brick_dim))*brick_dim)*sizeof(T), src, n*sizeof(T));
+          }
+        }
+        // release a brick that went back to the default value
+        if (b && all_default && this->is_default(b, brick_dim*brick_dim*brick_dim)) {
+          delete [] b;
+          b = VXL_NULLPTR;
+          --nbricks_;
+        }
+      }
+    }
+  }
+}
+
+#define BVXM_VOXEL_STORAGE_SPARSE_INSTANTIATE(T) \
+template class bvxm_voxel_storage_sparse<T >
+
+#endif // bvxm_voxel_storage_sparse_hxx_
@@ -4,5 +4,6 @@
 #include <bvxm/grid/bvxm_voxel_storage_disk_cached.hxx>
 #include <bvxm/grid/bvxm_voxel_storage_disk.hxx>
 #include <bvxm/grid/bvxm_voxel_storage_mem.hxx>
+#include <bvxm/grid/bvxm_voxel_storage_sparse.hxx>
 
 int main() { return 0; }
@@ -17,6 +17,7 @@ static void test_voxel_grid()
   // we need temporary disk storage for this test.
   std::string storage_fname("bvxm_voxel_grid_test_temp.vox");
   std::string storage_cached_fname("bvxm_voxel_grid_cached_test_temp.vox");
+  std::string storage_double_buffered_fname("bvxm_voxel_grid_double_buffered_test_temp.vox");
   // remove file if exists from previous test.
   if (vul_file::exists(storage_fname.c_str())) {
     vul_file::delete_file_glob(storage_fname.c_str());
@@ -24,6 +25,9 @@ static void test_voxel_grid()
   if (vul_file::exists(storage_cached_fname.c_str())) {
     vul_file::delete_file_glob(storage_cached_fname.c_str());
   }
+  if (vul_file::exists(storage_double_buffered_fname.c_str())) {
+    vul_file::delete_file_glob(storage_double_buffered_fname.c_str());
+  }
 
   vgl_vector_3d<unsigned> grid_size(300,300,120);
   unsigned max_cache_size = grid_size.x()*grid_size.y()*18;
@@ -37,6 +41,8 @@ static void test_voxel_grid()
   grid_types.push_back("memory storage");
   grids.push_back(new bvxm_voxel_grid<float>(storage_cached_fname,grid_size,max_cache_size)); // cached disk storage
   grid_types.push_back("disk_cached_storage");
+  grids.push_back(new bvxm_voxel_grid<float>(storage_double_buffered_fname,grid_size,max_cache_size,true)); // cached disk storage, reading ahead
+  grid_types.push_back("disk_cached_double_buffered_storage");
 
   std::string test_name;
 
@@ -119,8 +125,9 @@ static void test_voxel_grid()
     delete grids[i];
   }
 
-  // remove temporary file
+  // remove temporary files
   vul_file::delete_file_glob(storage_fname.c_str());
+  vul_file::delete_file_glob(storage_double_buffered_fname.c_str());
 }
 
 TESTMAIN( test_voxel_grid );
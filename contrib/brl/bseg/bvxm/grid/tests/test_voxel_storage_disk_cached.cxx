@@ -82,6 +82,58 @@ static void test_voxel_storage_disk_cached()
 
   } // end of block, storage should go out of scope here and files should close.
 
+  // double buffered: the slices following the cached ones are read in the background
+  {
+    unsigned max_cache_size = grid_size.x()*grid_size.y()*6*sizeof(float);
+    bvxm_voxel_storage_disk_cached<float> storage(storage_fname,grid_size,max_cache_size,true);
+    TEST("double buffered", storage.double_buffered(), true);
+
+    // top-down traversal: check the values written above and write new ones
+    bool db_read_check = true;
+    unsigned count = 0;
+    for (unsigned i=0; i < storage.nz(); i++) {
+      bvxm_voxel_slab<float> slab = storage.get_slab(i,1);
+      bvxm_voxel_slab<float>::iterator vit;
+      for (vit = slab.begin(); vit != slab.end(); vit++, count++) {
+        if (*vit != static_cast<float>(count))
+          db_read_check = false;
+        *vit = -static_cast<float>(count);
+      }
+      storage.put_slab();
+    }
+    TEST("Double buffered: read in voxel values match written values?",db_read_check,true);
+
+    // slabs of two slices, bottom-up, so every access misses the prefetched slices
+    bool db_reverse_check = true;
+    unsigned slice_size = grid_size.x()*grid_size.y();
+    for (int i=storage.nz()-2; i >= 0; i-=2) {
+      bvxm_voxel_slab<float> slab = storage.get_slab(i,2);
+      count = i*slice_size;
+      bvxm_voxel_slab<float>::iterator vit;
+      for (vit = slab.begin(); vit != slab.end(); vit++, count++)
+        if (*vit != -static_cast<float>(count))
+          db_reverse_check = false;
+    }
+    TEST("Double buffered: out of order slabs match written values?",db_reverse_check,true);
+  }
+
+  // check that the double buffered storage wrote everything back to disk
+  {
+    unsigned max_cache_size = grid_size.x()*grid_size.y()*7*sizeof(float);
+    bvxm_voxel_storage_disk_cached<float> storage(storage_fname,grid_size,max_cache_size);
+
+    bool db_write_check = true;
+    unsigned count = 0;
+    for (unsigned i=0; i < storage.nz(); i++) {
+      bvxm_voxel_slab<float> slab = storage.get_slab(i,1);
+      bvxm_voxel_slab<float>::iterator vit;
+      for (vit = slab.begin(); vit != slab.end(); vit++, count++)
+        if (*vit != -static_cast<float>(count))
+          db_write_check = false;
+    }
+    TEST("Double buffered: values written back to disk?",db_write_check,true);
+  }
+
   // remove temporary file
   vul_file::delete_file_glob(storage_fname.c_str());
 }
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+
+#include <vgl/vgl_vector_3d.h>
+#include <bsta/bsta_attributes.h>
+#include <bsta/bsta_mixture_fixed.h>
+#include <bsta/bsta_gauss_sf1.h>
+
+#include "../bvxm_voxel_storage.h"
+#include "../bvxm_voxel_storage_sparse.h"
+#include "../bvxm_voxel_grid.h"
+#include "../bvxm_voxel_slab.h"
+
+static void test_voxel_storage_sparse()
+{
+  // a size that is not a multiple of the brick size
+  vgl_vector_3d<unsigned int> grid_size(21, 13, 19);
+
+  float init_val = 0.5f;
+  bvxm_voxel_storage_sparse<float> storage(grid_size, init_val);
+  TEST_EQUAL("No bricks allocated", storage.num_bricks(), 0);
+  TEST_EQUAL("Number of bricks of a dense grid", storage.max_num_bricks(), 3*2*3);
+
+  // read in each slice, check the default value, and fill every other slice
+  bool init_check = true;
+  unsigned cnt = 0;
+  for (unsigned i = 0; i < storage.nz(); i++) {
+    bvxm_voxel_slab<float> slab = storage.get_slab(i,1);
+    bvxm_voxel_slab<float>::iterator vit;
+    for (vit = slab.begin(); vit != slab.end(); vit++, cnt++) {
+      if (*vit != init_val)
+        init_check = false;
+      if (i % 2 == 0)
+        *vit = static_cast<float>(cnt);
+    }
+    storage.put_slab();
+  }
+  TEST("Initialization correctly set voxel values?", init_check, true);
+  TEST_EQUAL("All bricks allocated", storage.num_bricks(), storage.max_num_bricks());
+
+  // read back with thicker slabs
+  bool write_read_check = true;
+  cnt = 0;
+  for (unsigned i = 0; i < storage.nz(); i += 4) {
+    bvxm_voxel_slab<float> slab = storage.get_slab(i, 4);
+    for (unsigned k = 0; k < slab.nz(); ++k)
+      for (unsigned y = 0; y < slab.ny(); ++y)
+        for (unsigned x = 0; x < slab.nx(); ++x, ++cnt) {
+          float expected = (i+k) % 2 == 0 ? static_cast<float>(cnt) : init_val;
+          if (slab(x,y,k) != expected)
+            write_read_check = false;
+        }
+  }
+  TEST("Read in voxel values match written values?", write_read_check, true);
+
+  // resetting a brick to the default releases it
+  for (unsigned i = 8; i < 16; i++) {
+    bvxm_voxel_slab<float> slab = storage.get_slab(i,1);
+    slab.fill(init_val);
+    storage.put_slab();
+  }
+  TEST_EQUAL("Middle layer of bricks released", storage.num_bricks(), 2*3*2);
+
+  // a single voxel allocates a single brick
+  storage.initialize_data(1.0f);
+  {
+    bvxm_voxel_slab<float> slab = storage.get_slab(17,1);
+    slab(20,12) = 2.0f;
+    storage.put_slab();
+  }
+  TEST_EQUAL("One brick allocated", storage.num_bricks(), 1);
+  bvxm_voxel_slab<float> slab = storage.get_slab(17,1);
+  TEST("Changed voxel is kept", slab(20,12) == 2.0f && slab(19,12) == 1.0f && slab(20,11) == 1.0f, true);
+
+  // the grid interface works unchanged
+  bvxm_voxel_grid<float> grid(new bvxm_voxel_storage_sparse<float>(grid_size, 0.0f));
+  TEST("Grid size from storage", grid.grid_size() == grid_size, true);
+  bvxm_voxel_grid<float>::iterator it = grid.begin();
+  for (unsigned i = 0; it != grid.end(); ++it, ++i)
+    if (i == 3)
+      (*it)(0,0) = 1.0f;
+  TEST_EQUAL("Value written through iterator", (*grid.slab_iterator(3))(0,0), 1.0f);
+
+  // voxels are compared by value: a mixture that equals the default one except in
+  // its unused components does not allocate a brick
+  typedef bsta_num_obs<bsta_mixture_fixed<bsta_num_obs<bsta_gauss_sf1>, 3> > mix_type;
+  bvxm_voxel_storage_sparse<mix_type> mix_storage(grid_size, mix_type());
+  {
+    bvxm_voxel_slab<mix_type> mix_slab = mix_storage.get_slab(0,1);
+    mix_slab(0,0).insert(bsta_num_obs<bsta_gauss_sf1>(bsta_gauss_sf1(0.5f, 0.01f), 1.0f), 1.0f);
+    mix_slab(0,0).remove_last();
+    mix_slab(20,12).insert(bsta_num_obs<bsta_gauss_sf1>(bsta_gauss_sf1(0.5f, 0.01f), 1.0f), 1.0f);
+    mix_storage.put_slab();
+  }
+  TEST_EQUAL("Only the changed mixture allocates a brick", mix_storage.num_bricks(), 1);
+  TEST_EQUAL("Changed mixture is kept", mix_storage.get_slab(0,1)(20,12).num_components(), 1);
+}
+
+TESTMAIN( test_voxel_storage_sparse );
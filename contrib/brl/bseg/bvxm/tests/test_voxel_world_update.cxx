@@ -1,3 +1,4 @@
+#include <vector>
 #include <testlib/testlib_test.h>
 #include <vul/vul_file.h>
 
@@ -76,6 +77,46 @@ static void test_voxel_world_update()
   TEST("world update", result, true);
 
   //TO DO: check update for other processors
+
+  // the update splits the slabs between threads and may read ahead from disk;
+  // neither may change the result
+  vgl_vector_3d<unsigned> grid_size2(6,5,4);
+  vil_image_view<vxl_byte>* img2 = new vil_image_view<vxl_byte>(7,6,1,1);
+  for (unsigned j=0; j<img2->nj(); ++j)
+    for (unsigned i=0; i<img2->ni(); ++i)
+      (*img2)(i,j) = vxl_byte(40*((i+2*j)%6));
+  bvxm_image_metadata observation2(img2,camera);
+  vil_image_view<float> prob_map2(img2->ni(),img2->nj(),1);
+  vil_image_view<bool> mask2(img2->ni(),img2->nj(),1);
+
+  std::vector<float> ocp[2];
+  for (unsigned run=0; run<2; ++run)
+  {
+    std::string run_dir = run == 0 ? "test_world_dir_serial" : "test_world_dir_threads";
+    if (!vul_file::is_directory(run_dir))
+      vul_file::make_directory(run_dir);
+    bvxm_world_params_sptr params2 = new bvxm_world_params;
+    params2->set_params(run_dir,grid_corner,grid_size2,vox_len,lvcs);
+    bvxm_voxel_world world2(params2);
+    world2.clean_grids();
+    if (run == 0) {
+      world2.set_num_threads(1);
+    }
+    else {
+      world2.set_num_threads(3);
+      // two slabs per half of the cache
+      world2.set_slab_cache_size(4*grid_size2.x()*grid_size2.y()*sizeof(float));
+    }
+    bool ok = world2.update<APM_MOG_GREY>(observation2, prob_map2, mask2, 0);
+    ok = ok && world2.update<APM_MOG_GREY>(observation2, prob_map2, mask2, 0);
+    TEST("world update (threads / read ahead)", ok, true);
+
+    bvxm_voxel_grid<float>* ocp_grid = static_cast<bvxm_voxel_grid<float>*>(world2.get_grid<OCCUPANCY>(0,0).ptr());
+    for (bvxm_voxel_grid<float>::iterator slab_it = ocp_grid->begin(); slab_it != ocp_grid->end(); ++slab_it)
+      ocp[run].insert(ocp[run].end(), slab_it->begin(), slab_it->end());
+    world2.clean_grids();
+  }
+  TEST("occupancy does not depend on threads and storage", ocp[0] == ocp[1] && !ocp[0].empty(), true);
 }
 
 TESTMAIN( test_voxel_world_update );
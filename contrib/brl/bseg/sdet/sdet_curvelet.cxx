@@ -3,6 +3,7 @@
 #include <deque>
 #include <algorithm>
 #include "sdet_curvelet.h"
+#include "sdet_curvelet_pool.h"
 
 #include <vcl_cassert.h>
 #include <vcl_compiler.h>
@@ -65,6 +66,25 @@ sdet_curvelet::~sdet_curvelet()
   edgel_chain.clear();
 }
 
+//: allocate from the curvelet pool
+void* sdet_curvelet::operator new(std::size_t size)
+{
+  sdet_curvelet_pool& pool = sdet_curvelet_pool::instance();
+  if (size > pool.object_size()) // not a plain sdet_curvelet
+    return ::operator new(size);
+  return pool.allocate();
+}
+
+//: give the memory back to the curvelet pool
+void sdet_curvelet::operator delete(void* p, std::size_t size)
+{
+  sdet_curvelet_pool& pool = sdet_curvelet_pool::instance();
+  if (size > pool.object_size())
+    ::operator delete(p);
+  else
+    pool.release(p);
+}
+
 // weighting constants for the heuristic
 #define alpha3 1.0
 #define alpha4 1.0
@@ -13,6 +13,8 @@
 //
 //  Ozge Can Ozcanli Jan 12, 2007   Added copy constructor
 //
+//  Curvelets are allocated from sdet_curvelet_pool
+//
 //\endverbatim
 
 #include <vector>
@@ -21,6 +23,7 @@
 #include <set>
 #include <map>
 #include <utility>
+#include <cstddef>
 #include <vbl/vbl_ref_count.h>
 #include <vcl_compiler.h>
 
@@ -89,6 +92,10 @@ public:
   //: destructor
   ~sdet_curvelet();
 
+  //: curvelets are allocated from sdet_curvelet_pool::instance()
+  static void* operator new(std::size_t size);
+  static void operator delete(void* p, std::size_t size);
+
   //: return the order of this grouping
   unsigned order() const { return edgel_chain.size(); }
 
@@ -1,6 +1,7 @@
 #include "sdet_curvelet_map.h"
 
 #include "sdet_curvelet.h"
+#include "sdet_curvelet_pool.h"
 #include "sdet_edgemap.h"
 
 //: constructor
@@ -40,6 +41,9 @@ sdet_curvelet_map
   clear_all_curvelets();
   map_.clear();
   map2_.clear();
+
+  //hand the curvelet memory back to the heap if no other map holds curvelets
+  sdet_curvelet_pool::instance().trim();
 }
 
 //: clear all the curvelets in the graph
@@ -0,0 +1,210 @@
+// This is brl/bseg/sdet/sdet_curvelet_pool.cxx
+#include "sdet_curvelet_pool.h"
+//:
+// \file
+#include "sdet_curvelet.h"
+
+#include <vcl_cassert.h>
+
+//: the pool behind sdet_curvelet::operator new
+//  It is created on first use and never destroyed, so that curvelets held by
+//  static objects can still be deleted at exit.
+sdet_curvelet_pool& sdet_curvelet_pool::instance()
+{
+  static sdet_curvelet_pool* pool = new sdet_curvelet_pool(sizeof(sdet_curvelet));
+  return *pool;
+}
+
+sdet_curvelet_pool::sdet_curvelet_pool(std::size_t object_size, unsigned slab_size)
+: slab_size_(slab_size > 0 ? slab_size : 1), free_(VXL_NULLPTR), num_allocated_(0)
+{
+  // keep every object aligned like the slab itself
+  const std::size_t align = 16;
+  if (object_size < sizeof(free_node))
+    object_size = sizeof(free_node);
+  object_size_ = (object_size + align - 1) / align * align;
+#if VXL_HAS_PTHREAD_H
+  has_key_ = pthread_key_create(&key_, &sdet_curvelet_pool::destroy_cache) == 0;
+#else
+  cache_.pool = this;
+  cache_.head = VXL_NULLPTR;
+  cache_.count = 0;
+#endif
+}
+
+sdet_curvelet_pool::~sdet_curvelet_pool()
+{
+  this->flush();
+#if VXL_HAS_PTHREAD_H
+  if (has_key_) {
+    delete static_cast<cache*>(pthread_getspecific(key_));
+    pthread_key_delete(key_);
+  }
+#endif
+  assert(num_allocated_ == 0);
+  this->free_slabs();
+}
+
+void sdet_curvelet_pool::lock()
+{
+#if VXL_HAS_PTHREAD_H
+  mutex_.lock();
+#endif
+}
+
+void sdet_curvelet_pool::unlock()
+{
+#if VXL_HAS_PTHREAD_H
+  mutex_.unlock();
+#endif
+}
+
+sdet_curvelet_pool::cache* sdet_curvelet_pool::local_cache()
+{
+#if VXL_HAS_PTHREAD_H
+  if (!has_key_)
+    return VXL_NULLPTR;
+  cache* c = static_cast<cache*>(pthread_getspecific(key_));
+  if (!c) {
+    c = new cache;
+    c->pool = this;
+    c->head = VXL_NULLPTR;
+    c->count = 0;
+    pthread_setspecific(key_, c);
+  }
+  return c;
+#else
+  return &cache_;
+#endif
+}
+
+void sdet_curvelet_pool::destroy_cache(void* p)
+{
+  cache* c = static_cast<cache*>(p);
+  c->pool->give_back(c, c->count);
+  delete c;
+}
+
+void sdet_curvelet_pool::refill(cache* c)
+{
+  this->lock();
+  if (!free_) {
+    // thread a new slab onto the free list, first object at the head
+    char* slab = new char[slab_size_*object_size_];
+    slabs_.push_back(slab);
+    for (unsigned i = slab_size_; i > 0; --i) {
+      free_node* n = reinterpret_cast<free_node*>(slab + (i-1)*object_size_);
+      n->next = free_;
+      free_ = n;
+    }
+  }
+  // keep the order of the free list, so objects are handed out in address order
+  free_node* first = free_;
+  free_node* last = free_;
+  unsigned n = 1;
+  while (n < cache_batch && last->next) {
+    last = last->next;
+    ++n;
+  }
+  free_ = last->next;
+  last->next = c->head;
+  c->head = first;
+  c->count += n;
+  num_allocated_ += n;
+  this->unlock();
+}
+
+void sdet_curvelet_pool::give_back(cache* c, unsigned n)
+{
+  if (n == 0)
+    return;
+  free_node* first = c->head;
+  free_node* last = first;
+  for (unsigned i = 1; i < n; ++i)
+    last = last->next;
+  c->head = last->next;
+  c->count -= n;
+  this->lock();
+  last->next = free_;
+  free_ = first;
+  num_allocated_ -= n;
+  this->unlock();
+}
+
+void* sdet_curvelet_pool::allocate()
+{
+  cache* c = this->local_cache();
+  if (!c) {
+    // no thread specific storage, every object goes through the lock
+    cache tmp;
+    tmp.pool = this;
+    tmp.head = VXL_NULLPTR;
+    tmp.count = 0;
+    this->refill(&tmp);
+    free_node* n = tmp.head;
+    tmp.head = n->next;
+    --tmp.count;
+    this->give_back(&tmp, tmp.count);
+    return n;
+  }
+  if (!c->head)
+    this->refill(c);
+  free_node* n = c->head;
+  c->head = n->next;
+  --c->count;
+  return n;
+}
+
+void sdet_curvelet_pool::release(void* p)
+{
+  if (!p)
+    return;
+  cache* c = this->local_cache();
+  free_node* n = static_cast<free_node*>(p);
+  if (!c) {
+    cache tmp;
+    tmp.pool = this;
+    tmp.head = n;
+    tmp.count = 1;
+    n->next = VXL_NULLPTR;
+    this->give_back(&tmp, 1);
+    return;
+  }
+  n->next = c->head;
+  c->head = n;
+  // a thread that releases more than it allocates hands the surplus back in bulk
+  if (++c->count > 2*cache_batch)
+    this->give_back(c, cache_batch);
+}
+
+void sdet_curvelet_pool::flush()
+{
+  cache* c = this->local_cache();
+  if (c)
+    this->give_back(c, c->count);
+}
+
+unsigned sdet_curvelet_pool::num_cached()
+{
+  cache* c = this->local_cache();
+  return c ? c->count : 0;
+}
+
+bool sdet_curvelet_pool::trim()
+{
+  this->flush();
+  this->lock();
+  bool freed = num_allocated_ == 0 && !slabs_.empty();
+  if (freed)
+    this->free_slabs();
+  this->unlock();
+  return freed;
+}
+
+void sdet_curvelet_pool::free_slabs()
+{
+  for (unsigned i = 0; i < slabs_.size(); ++i)
+    delete [] slabs_[i];
+  slabs_.clear();
+  free_ = VXL_NULLPTR;
+}
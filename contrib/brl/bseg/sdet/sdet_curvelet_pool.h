@@ -0,0 +1,113 @@
+// This is brl/bseg/sdet/sdet_curvelet_pool.h
+#ifndef sdet_curvelet_pool_h
+#define sdet_curvelet_pool_h
+//:
+//\file
+//\brief A fixed size block allocator for the curvelets formed by the linker
+//
+// The symbolic edge linker forms (and throws away) millions of small
+// sdet_curvelet objects.  sdet_curvelet::operator new takes them from
+// sdet_curvelet_pool::instance(), which carves them out of large slabs and
+// recycles the freed ones, instead of going to the heap for every curvelet.
+// All members are thread safe, so curvelets can be formed concurrently.
+//
+// Each thread allocates from and releases to a small free list of its own,
+// without locking.  Only when that list runs empty, or grows beyond twice
+// cache_batch objects, does the thread lock the pool to move cache_batch
+// objects from or to the shared slabs.  The list of a thread goes back to
+// the slabs when the thread exits, or when it calls flush() or trim().
+//
+//\verbatim
+//  Modifications
+//\endverbatim
+
+#include <vector>
+#include <cstddef>
+#include <vxl_config.h>
+#include <vcl_compiler.h>
+#if VXL_HAS_PTHREAD_H
+#include <pthread.h>
+#include <vpl/vpl_mutex.h>
+#endif
+
+class sdet_curvelet_pool
+{
+public:
+  //: A pool of objects of object_size bytes, obtained slab_size objects at a time
+  sdet_curvelet_pool(std::size_t object_size, unsigned slab_size = 1024);
+
+  //: Frees the slabs (all objects must have been released)
+  //  No other thread may still hold objects of this pool in its cache.
+  ~sdet_curvelet_pool();
+
+  //: Number of objects a thread moves between its cache and the slabs at a time
+  enum { cache_batch = 64 };
+
+  //: The pool used by sdet_curvelet::operator new
+  static sdet_curvelet_pool& instance();
+
+  //: Memory for one object
+  void* allocate();
+
+  //: Give back the memory of an object obtained from allocate()
+  void release(void* p);
+
+  //: Give the objects cached by the calling thread back to the slabs
+  void flush();
+
+  //: Flush the calling thread and free the slabs if no object is in use; returns true if they were freed
+  bool trim();
+
+  //: Number of objects taken from the slabs, in use or in the cache of a thread
+  unsigned num_allocated() const { return num_allocated_; }
+
+  //: Number of objects in the cache of the calling thread
+  unsigned num_cached();
+
+  //: Number of slabs obtained from the heap
+  unsigned num_slabs() const { return slabs_.size(); }
+
+  //: Size of the objects in bytes
+  std::size_t object_size() const { return object_size_; }
+
+private:
+  struct free_node { free_node* next; };
+
+  //: The free list of one thread
+  struct cache
+  {
+    sdet_curvelet_pool* pool;
+    free_node* head;
+    unsigned count;
+  };
+
+  std::size_t object_size_;
+  unsigned slab_size_;
+  std::vector<char*> slabs_;
+  free_node* free_;
+  unsigned num_allocated_;
+#if VXL_HAS_PTHREAD_H
+  vpl_mutex mutex_;
+  pthread_key_t key_;
+  bool has_key_;
+#else
+  cache cache_;
+#endif
+
+  void lock();
+  void unlock();
+  void free_slabs();
+  //: The cache of the calling thread, created on first use
+  cache* local_cache();
+  //: Move up to cache_batch objects from the slabs to \p c
+  void refill(cache* c);
+  //: Move up to \p n objects from \p c back to the slabs
+  void give_back(cache* c, unsigned n);
+  //: Called when a thread with a cache exits
+  static void destroy_cache(void* c);
+
+  sdet_curvelet_pool(sdet_curvelet_pool const&);
+  sdet_curvelet_pool& operator=(sdet_curvelet_pool const&);
+};
+
+#endif // sdet_curvelet_pool_h
@@ -229,6 +229,7 @@ bool sdet_detector::DoStep()
     return false;
   }
   gevd_step step(this->smooth, this->noise, this->contourFactor, this->junctionFactor);
+  step.SetTiling(this->tile_size, this->num_threads);
 
   step.DetectEdgels(*source, edgel, direction, locationx, locationy, grad_mag, angle);
 
@@ -11,7 +11,7 @@
 //
 
 sdet_detector_params::sdet_detector_params(const sdet_detector_params& dp)
-  : gevd_param_mixin()
+  : gevd_param_mixin(), tile_size(dp.tile_size), num_threads(dp.num_threads)
 {
   InitParams(dp.smooth, dp.noise_weight, dp.noise_multiplier,
              dp.automatic_threshold, dp.aggressive_junction_closure,
@@ -33,6 +33,7 @@ sdet_detector_params::sdet_detector_params(float smooth_sigma, float noise_w,
                                            bool valleys_only,
                                            float ang, float sep, int min_corner_len,
                                            int cyc, int ndim)
+  : tile_size(0), num_threads(0)
 {
   InitParams(smooth_sigma, noise_w, noise_m, automatic_t,
              aggressive_jc, minl, maxgp, minjmp,
@@ -229,6 +230,13 @@ bool sdet_detector_params::SanityCheck()
     valid = false;
   }
 
+  if (tile_size < 0)
+  {
+    msg << "ERROR: Value of tile size is negative: "
+        << tile_size << " < 0\0";
+    tile_size = 0;
+  }
+
   SetErrorMsg(msg.str().c_str());
   return valid;
 }
@@ -255,7 +263,9 @@ std::ostream& operator << (std::ostream& os, const sdet_detector_params& dp)
      << " Recover Junctions " << dp.junctionp << std::endl
      << " Minimum Chain Length " << dp.minLength << std::endl
      << " Peaks Only " << dp.peaks_only << std::endl
-     << " Valleys Only " << dp.valleys_only << std::endl << std::endl
+     << " Valleys Only " << dp.valleys_only << std::endl
+     << " Tile Size " << dp.tile_size << std::endl
+     << " Threads " << dp.num_threads << std::endl << std::endl
      << "Corner Detection Params:\n"
      << " Corner Angle " << dp.corner_angle << std::endl
      << " Corner Separation " << dp.separation  << std::endl
@@ -56,6 +56,12 @@
 // - bool borderp:              If true, insert virtual contours at the border
 //                              to close regions. Nominally false.
 //
+// - int tile_size:             If positive, the step edgels are detected on
+//                              tiles of tile_size rows, processed in parallel
+//                              on num_threads threads (0 = one per processor).
+//                              The result is identical to the untiled
+//                              detection. Nominally 0 (untiled).
+//
 // \author
 //             Joseph L. Mundy - November 1997
 //             GE Corporate Research and Development
@@ -125,6 +131,8 @@ class sdet_detector_params : public gevd_param_mixin
   float maxGap;   //!< Bridge small gaps up to max_gap across.
   bool spacingp;  //!< equalize spacing?
   bool borderp;   //!< insert virtual border for closure?
+  int tile_size;  //!< rows per tile of the step detection, 0 if untiled
+  unsigned num_threads; //!< threads for the tiles, 0 for one per processor
   //
   // Fold detection parameters
   //
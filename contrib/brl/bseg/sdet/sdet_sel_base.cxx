@@ -11,8 +11,135 @@
 #include <pdf1d/pdf1d_calc_mean_var.h>
 #include <mbl/mbl_stats_1d.h>
 
+#include <vpl/vpl_parallel_for.h>
+#include <bvgl/algo/bvgl_eulerspiral.h>
+
 #include "sdet_edgemap.h"
 
+//: Forms the curvelets of the edgels in a range of edgemap rows.
+//  A curvelet is only stored with its anchor edgel and forming it only reads
+//  the curvelets already anchored there, so the rows can be processed
+//  concurrently and in any order.
+class sdet_sel_curvelet_body : public vpl_parallel_for_body
+{
+ public:
+  sdet_sel_curvelet_body(sdet_sel_base& sel, sdet_edgemap& edgemap, unsigned max_size_to_group, bool use_flag)
+  : sel_(sel), edgemap_(edgemap), max_size_to_group_(max_size_to_group), use_flag_(use_flag) {}
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned y=begin; y<end; y++)
+      for (unsigned x=0; x<edgemap_.ncols(); x++) {
+        const std::vector<sdet_edgel*>& cell = edgemap_.cell(x, y);
+        for (unsigned k=0; k<cell.size(); k++)
+          sel_.build_curvelets_greedy_at_edgel(cell[k], max_size_to_group_, use_flag_);
+      }
+  }
+
+ private:
+  sdet_sel_base& sel_;
+  sdet_edgemap& edgemap_;
+  unsigned max_size_to_group_;
+  bool use_flag_;
+};
+
+//: A link to be added to the link graph
+struct sdet_pending_link
+{
+  sdet_edgel* e1;
+  sdet_edgel* e2;
+  sdet_curvelet* cvlet;
+};
+
+//: Links formed by a curvelet when all of them are linked (method 0) or only the immediate ones (method 1)
+static void sdet_curvelet_links(sdet_edgel* eA, sdet_curvelet* cvlet, int method,
+                                std::vector<sdet_pending_link>& links)
+{
+  sdet_pending_link l;
+  l.cvlet = cvlet;
+  if (method==0)
+  {
+    for (unsigned k=0; k+1<cvlet->edgel_chain.size(); k++) {
+      l.e1 = cvlet->edgel_chain[k]; l.e2 = cvlet->edgel_chain[k+1];
+      links.push_back(l);
+    }
+  }
+  else
+  {
+    for (unsigned k=0; k<cvlet->edgel_chain.size(); k++) {
+      if (k>0 && cvlet->edgel_chain[k-1]==eA) { //the link after it (eA --> edgel_chain[k])
+        l.e1 = eA; l.e2 = cvlet->edgel_chain[k];
+        links.push_back(l);
+      }
+      if (k<cvlet->edgel_chain.size()-1 && cvlet->edgel_chain[k+1]==eA) { //the link before it (edgel_chain[k] --> eA)
+        l.e1 = cvlet->edgel_chain[k]; l.e2 = eA;
+        links.push_back(l);
+      }
+    }
+  }
+}
+
+//: Collects the links of method 0 or 1 formed by the curvelets of consecutive blocks of edgels.
+//  Each block keeps its own list, so that adding the lists to the link graph
+//  block after block gives the same graph as the serial loop.
+class sdet_sel_link_body : public vpl_parallel_for_body
+{
+ public:
+  sdet_sel_link_body(sdet_curvelet_map& cvlet_map, std::vector<sdet_edgel*> const& edgels,
+                     unsigned block_size, unsigned min_group_size, int method)
+  : cvlet_map_(cvlet_map), edgels_(edgels), block_size_(block_size),
+    min_group_size_(min_group_size), method_(method),
+    links_((edgels.size()+block_size-1)/block_size), cvlets_(links_.size()) {}
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned b=begin; b<end; b++) {
+      unsigned last = std::min<unsigned>((b+1)*block_size_, edgels_.size());
+      for (unsigned i=b*block_size_; i<last; i++) {
+        sdet_curvelet_list_iter cv_it = cvlet_map_.curvelets(i).begin();
+        for ( ; cv_it!=cvlet_map_.curvelets(i).end(); cv_it++)
+          if ((*cv_it)->order() >= min_group_size_) {
+            sdet_curvelet_links(edgels_[i], *cv_it, method_, links_[b]);
+            cvlets_[b].push_back(*cv_it);
+          }
+      }
+    }
+  }
+
+  unsigned num_blocks() const { return links_.size(); }
+  std::vector<sdet_pending_link> const& links(unsigned b) const { return links_[b]; }
+  std::vector<sdet_curvelet*> const& curvelets(unsigned b) const { return cvlets_[b]; }
+
+ private:
+  sdet_curvelet_map& cvlet_map_;
+  std::vector<sdet_edgel*> const& edgels_;
+  unsigned block_size_;
+  unsigned min_group_size_;
+  int method_;
+  std::vector<std::vector<sdet_pending_link> > links_;
+  std::vector<std::vector<sdet_curvelet*> > cvlets_;
+};
+
+//: Counts the degree of overlap of the child links of a range of edgels
+class sdet_sel_overlap_body : public vpl_parallel_for_body
+{
+ public:
+  sdet_sel_overlap_body(sdet_sel_base& sel, sdet_edgel_link_graph& ELG) : sel_(sel), ELG_(ELG) {}
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned i=begin; i<end; i++) {
+      sdet_link_list_iter l_it = ELG_.cLinks[i].begin();
+      for (; l_it != ELG_.cLinks[i].end(); l_it++)
+        (*l_it)->deg_overlap = sel_.count_degree_overlap((*l_it));
+    }
+  }
+
+ private:
+  sdet_sel_base& sel_;
+  sdet_edgel_link_graph& ELG_;
+};
+
 //: Constructor
 sdet_sel_base
 ::sdet_sel_base(sdet_edgemap_sptr edgemap,
@@ -42,6 +169,7 @@ sdet_sel_base
   bidir_(cvlet_params.bidirectional_),
   use_anchored_curvelets_(true),
   min_deg_to_link_(4),
+  num_threads_(0),
   use_hybrid_(false),
   DHT_mode_(true),
   propagate_constraints(true)
@@ -160,44 +288,46 @@ sdet_sel_base
   //store this parameter
   maxN_ = max_size_to_group;
 
+  //load the Euler spiral table before the curve bundles are formed concurrently
+  if (curvelet_map_.params_.C_type == sdet_curve_model::ES)
+    bvgl_eulerspiral_lookup_table::instance();
+
+  //form the curvelets of the edgels, one edgemap row at a time
+  sdet_sel_curvelet_body body(*this, *edgemap_, max_size_to_group, use_flag);
+  vpl_parallel_for(nrows_, body, num_threads_);
+
+  if (verbose)
+    std::cout << "done!" << std::endl;
+}
+
+
+//: form the curvelets anchored at eA in all the directions set by the grouping parameters
+void
+sdet_sel_base
+::build_curvelets_greedy_at_edgel(sdet_edgel* eA, unsigned max_size_to_group, bool use_flag)
+{
   if (centered_) {
     if (bidir_) {
-      for (unsigned i=0; i<edgemap_->edgels.size(); i++) {
-        sdet_edgel* eA = edgemap_->edgels[i];
-        // centered_ && bidir_
-        build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, false); //first in the forward direction
-        build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, false, centered_, false); //then in the other direction
-      }
+      // centered_ && bidir_
+      build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, false); //first in the forward direction
+      build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, false, centered_, false); //then in the other direction
     } else {
-      for (unsigned i=0; i<edgemap_->edgels.size(); i++) {
-        sdet_edgel* eA = edgemap_->edgels[i];
-        // centered_ && !bidir_
-        build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, false); //first in the forward direction
-      }
+      // centered_ && !bidir_
+      build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, false); //first in the forward direction
     }
   } else {
     if (bidir_) {
-      for (unsigned i=0; i<edgemap_->edgels.size(); i++) {
-        sdet_edgel* eA = edgemap_->edgels[i];
-        build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, true); //forward half
-        build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, false, centered_, true); //backward half
-        // !centered_ && bidir_
-      }
+      // !centered_ && bidir_
+      build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, true); //forward half
+      build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, false, centered_, true); //backward half
     } else {
-      for (unsigned i=0; i<edgemap_->edgels.size(); i++) {
-        sdet_edgel* eA = edgemap_->edgels[i];
-        build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, true); //forward half
-        build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, false); //ENO style forward
-        // !centered_ && !bidir_
-      }
+      // !centered_ && !bidir_
+      build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, true); //forward half
+      build_curvelets_greedy_for_edge(eA, max_size_to_group, use_flag, true, centered_, false); //ENO style forward
     }
   }
-
-  if (verbose)
-    std::cout << "done!" << std::endl;
 }
 
-
 //: form the full curvelet map (curvelet map lists all the curvelets it participated in and not just the ones anchored to it)
 void
 sdet_sel_base
@@ -534,18 +664,39 @@ sdet_sel_base
   }
 
   // 2b) go over all the curvelets above the min size and determine which links can be formed
-  for (unsigned i=0; i<edgemap_->edgels.size(); i++)
+  if (method==0 || method==1)
   {
-    sdet_edgel* eA = edgemap_->edgels[i];
+    // the links of a curvelet only depend on the curvelet: collect them concurrently
+    // and add them to the link graph in the order of the edgels
+    sdet_sel_link_body body(curvelet_map_, edgemap_->edgels, 256, min_group_size, method);
+    vpl_parallel_for(body.num_blocks(), body, num_threads_);
+    for (unsigned b=0; b<body.num_blocks(); b++) {
+      std::vector<sdet_pending_link> const& links = body.links(b);
+      for (unsigned k=0; k<links.size(); k++)
+        edge_link_graph_.link(links[k].e1, links[k].e2, links[k].cvlet);
 
-    //for all curvelets that are larger than the group size threshold
-    sdet_curvelet_list_iter cv_it = curvelet_map_.curvelets(i).begin();
-    for ( ; cv_it!=curvelet_map_.curvelets(i).end(); cv_it++){
-      sdet_curvelet* cvlet = (*cv_it);
-      if (cvlet->order() < min_group_size) continue;
+      //all cvlets are used
+      std::vector<sdet_curvelet*> const& cvlets = body.curvelets(b);
+      for (unsigned k=0; k<cvlets.size(); k++)
+        cvlets[k]->used = true;
+    }
+  }
+  else
+  {
+    // the support tests of the other methods flag the curvelets of the neighbors
+    for (unsigned i=0; i<edgemap_->edgels.size(); i++)
+    {
+      sdet_edgel* eA = edgemap_->edgels[i];
+
+      //for all curvelets that are larger than the group size threshold
+      sdet_curvelet_list_iter cv_it = curvelet_map_.curvelets(i).begin();
+      for ( ; cv_it!=curvelet_map_.curvelets(i).end(); cv_it++){
+        sdet_curvelet* cvlet = (*cv_it);
+        if (cvlet->order() < min_group_size) continue;
 
-      //form all possible links from this curvelet
-      form_links_from_a_curvelet(eA, cvlet, min_group_size, method);
+        //form all possible links from this curvelet
+        form_links_from_a_curvelet(eA, cvlet, min_group_size, method);
+      }
     }
   }
   std::cout << "done!" << std::endl;
@@ -560,13 +711,9 @@ sdet_sel_base
   //}
 
   //4) after forming the link graph, determine the degree of overlap of the links in the graph
-  for (unsigned i=0; i<edge_link_graph_.cLinks.size(); i++){
-    //all child links of each edgel covers all the links
-    sdet_link_list_iter l_it = edge_link_graph_.cLinks[i].begin();
-    for (; l_it != edge_link_graph_.cLinks[i].end(); l_it++){
-      (*l_it)->deg_overlap = count_degree_overlap((*l_it));
-    }
-  }
+  //   (all child links of each edgel covers all the links)
+  sdet_sel_overlap_body overlap_body(*this, edge_link_graph_);
+  vpl_parallel_for(edge_link_graph_.cLinks.size(), overlap_body, num_threads_, 64);
 
 }
 
@@ -654,8 +801,10 @@ void sdet_sel_base::form_links_from_a_curvelet(sdet_edgel* eA, sdet_curvelet* cv
     //Amir: new feature
     //      since some curvelets are constructed in the reverse direction and the link graph is a directed graph,
     //      we ought to either make the link graph an undirected graph or add the links from the reverse curvelet in reverse
-      for (unsigned k=0; k<cvlet->edgel_chain.size()-1; k++)
-       edge_link_graph_.link(cvlet->edgel_chain[k], cvlet->edgel_chain[k+1], cvlet);
+    std::vector<sdet_pending_link> links;
+    sdet_curvelet_links(eA, cvlet, method, links);
+    for (unsigned k=0; k<links.size(); k++)
+      edge_link_graph_.link(links[k].e1, links[k].e2, cvlet);
     //all cvlets are used
     cvlet->used = true;
   }
@@ -665,14 +814,10 @@ void sdet_sel_base::form_links_from_a_curvelet(sdet_edgel* eA, sdet_curvelet* cv
     //
     // Explanation:
     // if -zAb- then Z-A and A-B
-
-    for (unsigned k=0; k<cvlet->edgel_chain.size(); k++){
-      if (k>0 && cvlet->edgel_chain[k-1]==eA) //the link after it (eA --> edgel_chain[k])
-        edge_link_graph_.link(eA, cvlet->edgel_chain[k], cvlet);
-
-      if (k<cvlet->edgel_chain.size()-1 && cvlet->edgel_chain[k+1]==eA) //the link before it (edgel_chain[k] --> eA)
-        edge_link_graph_.link(cvlet->edgel_chain[k], eA, cvlet);
-    }
+    std::vector<sdet_pending_link> links;
+    sdet_curvelet_links(eA, cvlet, method, links);
+    for (unsigned k=0; k<links.size(); k++)
+      edge_link_graph_.link(links[k].e1, links[k].e2, cvlet);
 
     //all cvlets are used
     cvlet->used = true;
@@ -28,6 +28,8 @@
 //  Amir Tamrakar            Curvelets can be formed in 4 ways now: regular anchor centered/ anchor centered bidirectional /
 //                           Anchor leading bidirectional / ENO style (anchor leading or trailing but in the same direction)
 //
+//                           Curvelets and the link graph are formed on several threads
+//
 //\endverbatim
 
 #include <vector>
@@ -94,6 +96,11 @@ public:
 
   unsigned maxN() { return maxN_; }
 
+  //: number of threads forming the curvelets and the link graph (0 means one per processor)
+  //  The curvelet map and the link graph do not depend on it.
+  unsigned num_threads() const { return num_threads_; }
+  void set_num_threads(unsigned num_threads) { num_threads_ = num_threads; }
+
   //: return a reference to the edgel buckets
   vbl_array_2d<std::vector<sdet_edgel*> > & cells() { return edgemap_->edge_cells; }
 
@@ -140,6 +147,8 @@ public:
 
     //: form curvelets around each edgel in a greedy fashion
     void build_curvelets_greedy(unsigned max_size_to_group, bool use_flag=false,  bool clear_existing=true, bool verbose=false);
+    //: form the curvelets anchored at eA in all the directions set by the grouping parameters
+    void build_curvelets_greedy_at_edgel(sdet_edgel* eA, unsigned max_size_to_group, bool use_flag=false);
     //: form curvelets around the given edgel in a greedy fashion
     virtual void build_curvelets_greedy_for_edge(sdet_edgel* eA, unsigned max_size_to_group,
         bool use_flag=false, bool forward=true,  bool centered=true, bool leading=true) = 0;
@@ -415,6 +424,8 @@ protected:
   bool use_anchored_curvelets_; ///< the curvelet set to use for linking
   unsigned min_deg_to_link_; ///< minimum degree of a link before it is linked
 
+  unsigned num_threads_; ///< threads for forming curvelets and links (0 = one per processor)
+
   //for the connected components algo to separate the link graph and the cvlet map
   std::set<sdet_curvelet*> cv_set1;
   std::map<std::pair<int, int>, sdet_link*> link_map;
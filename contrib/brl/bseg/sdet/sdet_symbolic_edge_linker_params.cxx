@@ -20,7 +20,8 @@ sdet_symbolic_edge_linker_params(const sdet_symbolic_edge_linker_params& dp)
   InitParams(dp.nrad_, dp.gap_, dp.badap_uncer_, dp.dx_, dp.dt_, dp.curve_model_type_, dp.token_len_, dp.max_k_, dp.max_gamma_,
              dp.grouping_algo_, dp.cvlet_type_, dp.app_usage_, dp.app_thresh_, dp.max_size_to_group_,
              dp.bFormCompleteCvletMap_, dp.bFormLinkGraph_, dp.b_use_all_cvlets_, dp.linkgraph_algo_,
-             dp.min_size_to_link_, dp.linking_algo_, dp.num_link_iters_, dp.bGetfinalcontours_);
+             dp.min_size_to_link_, dp.linking_algo_, dp.num_link_iters_, dp.bGetfinalcontours_,
+             dp.num_threads_);
 }
 
 sdet_symbolic_edge_linker_params::
@@ -32,12 +33,14 @@ sdet_symbolic_edge_linker_params(double nrad, double gap, bool adap_uncer,
                                  bool formCompleteCvletMap, bool formLinkGraph,
                                  bool use_all_cvlet, unsigned linkgraph_algo,
                                  unsigned min_size_to_link, unsigned linking_algo,
-                                 unsigned num_link_iters, bool get_final_contours)
+                                 unsigned num_link_iters, bool get_final_contours,
+                                 unsigned num_threads)
 {
   InitParams(nrad, gap, adap_uncer, dx, dt, curve_model, token_len, max_k, max_gamma,
              grouping_algo, cvlet_type, app_usage, app_thresh, max_size_to_group,
              formCompleteCvletMap, formLinkGraph, use_all_cvlet, linkgraph_algo,
-             min_size_to_link, linking_algo, num_link_iters, get_final_contours);
+             min_size_to_link, linking_algo, num_link_iters, get_final_contours,
+             num_threads);
 }
 
 void sdet_symbolic_edge_linker_params::InitParams(double nrad, double gap, bool adap_uncer,
@@ -48,7 +51,8 @@ void sdet_symbolic_edge_linker_params::InitParams(double nrad, double gap, bool
                                                   bool formCompleteCvletMap, bool formLinkGraph,
                                                   bool use_all_cvlet, unsigned linkgraph_algo,
                                                   unsigned min_size_to_link, unsigned linking_algo,
-                                                  unsigned num_link_iters, bool get_final_contours)
+                                                  unsigned num_link_iters, bool get_final_contours,
+                                                  unsigned num_threads)
 {
   nrad_ = nrad;
   gap_ = gap;
@@ -72,6 +76,7 @@ void sdet_symbolic_edge_linker_params::InitParams(double nrad, double gap, bool
   linking_algo_ = linking_algo;
   num_link_iters_ = num_link_iters;
   bGetfinalcontours_ = get_final_contours;
+  num_threads_ = num_threads;
 
   switch(cvlet_type) //set the grouping flags from the choice of cvlet type
   {
@@ -52,6 +52,7 @@ class sdet_symbolic_edge_linker_params : public gevd_param_mixin
    *        linkgraph_algo - Extract image contours
    *        num_link_iters - Number of linking iterations
    *    get_final_contours - Get final contours
+   *           num_threads - Threads forming curvelets and links (0 = one per processor)
    */
 
   sdet_symbolic_edge_linker_params(double nrad = 3.5, double gap = 2.0, bool adap_uncer = true,
@@ -62,7 +63,8 @@ class sdet_symbolic_edge_linker_params : public gevd_param_mixin
                                    bool formCompleteCvletMap = false, bool formLinkGraph = true,
                                    bool use_all_cvlet = false, unsigned linkgraph_algo = 0,
                                    unsigned min_size_to_link = 4, unsigned linking_algo = 0,
-                                   unsigned num_link_iters = 7, bool get_final_contours = true);
+                                   unsigned num_link_iters = 7, bool get_final_contours = true,
+                                   unsigned num_threads = 0);
 
   sdet_symbolic_edge_linker_params(const sdet_symbolic_edge_linker_params& old_params);
   ~sdet_symbolic_edge_linker_params(){}
@@ -81,7 +83,8 @@ protected:
                   bool formCompleteCvletMap, bool formLinkGraph,
                   bool use_all_cvlet, unsigned linkgraph_algo,
                   unsigned min_size_to_link, unsigned linking_algo,
-                  unsigned num_link_iters, bool get_final_contours);
+                  unsigned num_link_iters, bool get_final_contours,
+                  unsigned num_threads);
 
 ///////////////////////
 
@@ -112,6 +115,7 @@ protected:
   unsigned num_link_iters_;
 
   bool bGetfinalcontours_;
+  unsigned num_threads_;
 };
 
 #endif // sdet_symbolic_edge_linker_params_h_
@@ -11,6 +11,139 @@
 #include <sdet/sdet_edgemap_sptr.h>
 #include <sdet/sdet_edgemap.h>
 #include <sdet/sdet_edgel.h>
+#include <vpl/vpl_parallel_for.h>
+
+//: convolve im with kernel at 2^interp_factor subpixel positions
+template <class srcT, class destT, class kernelT>
+static void sdet_subpix_convolve(const vil_image_view<srcT>& im, vil_image_view<destT>& dest,
+                                 kernelT kernel, unsigned conv_algo, unsigned interp_factor)
+{
+  if (conv_algo==0) //2-d convolutions
+    brip_subpix_convolve_2d(im, dest, kernel, destT(), interp_factor);
+  else
+    brip_subpix_convolve_2d_sep(im, dest, kernel, destT(), interp_factor);
+}
+
+//: Computes the x and y gradients of a set of images, one gradient per task.
+template <class srcT, class destT>
+class sdet_subpix_gradient_body : public vpl_parallel_for_body
+{
+ public:
+  sdet_subpix_gradient_body(unsigned grad_op, unsigned conv_algo, double sigma, unsigned interp_factor)
+  : grad_op_(grad_op), conv_algo_(conv_algo), sigma_(sigma), interp_factor_(interp_factor) {}
+
+  //: add the tasks computing the gradients gx and gy of im
+  void add(const vil_image_view<srcT>& im, vil_image_view<destT>& gx, vil_image_view<destT>& gy)
+  {
+    images_.push_back(&im); images_.push_back(&im);
+    grads_.push_back(&gx);  grads_.push_back(&gy);
+  }
+
+  unsigned size() const { return grads_.size(); }
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned t=begin; t<end; t++) {
+      const vil_image_view<srcT>& im = *images_[t];
+      vil_image_view<destT>& g = *grads_[t];
+      const bool dx = t%2 == 0;
+      switch (grad_op_)
+      {
+        case 0: //Interpolated Gaussian
+          if (dx) sdet_subpix_convolve(im, g, brip_Gx_kernel(sigma_), conv_algo_, interp_factor_);
+          else    sdet_subpix_convolve(im, g, brip_Gy_kernel(sigma_), conv_algo_, interp_factor_);
+          break;
+        case 1: //h0-operator
+          if (dx) sdet_subpix_convolve(im, g, brip_h0_Gx_kernel(sigma_), conv_algo_, interp_factor_);
+          else    sdet_subpix_convolve(im, g, brip_h0_Gy_kernel(sigma_), conv_algo_, interp_factor_);
+          break;
+        case 2: //h1-operator
+          if (dx) sdet_subpix_convolve(im, g, brip_h1_Gx_kernel(sigma_), conv_algo_, interp_factor_);
+          else    sdet_subpix_convolve(im, g, brip_h1_Gy_kernel(sigma_), conv_algo_, interp_factor_);
+          break;
+      }
+    }
+  }
+
+ private:
+  unsigned grad_op_, conv_algo_;
+  double sigma_;
+  unsigned interp_factor_;
+  std::vector<const vil_image_view<srcT>*> images_;
+  std::vector<vil_image_view<destT>*> grads_;
+};
+
+//: Computes the derivatives up to third order of a set of images at the edge locations, one derivative per task.
+template <class srcT>
+class sdet_third_order_body : public vpl_parallel_for_body
+{
+ public:
+  sdet_third_order_body(const std::vector<vgl_point_2d<double> >& pts, unsigned grad_op, double sigma, unsigned interp_factor)
+  : pts_(pts), grad_op_(grad_op), sigma_(sigma), interp_factor_(interp_factor) {}
+
+  //: add the tasks computing the derivatives of im
+  void add(const vil_image_view<srcT>& im, std::vector<double>& Ix, std::vector<double>& Iy,
+           std::vector<double>& Ixx, std::vector<double>& Ixy, std::vector<double>& Iyy,
+           std::vector<double>& Ixxx, std::vector<double>& Ixxy, std::vector<double>& Ixyy, std::vector<double>& Iyyy)
+  {
+    std::vector<double>* res[] = { &Ix, &Iy, &Ixx, &Ixy, &Iyy, &Ixxx, &Ixxy, &Ixyy, &Iyyy };
+    for (unsigned k=0; k<9; k++) {
+      images_.push_back(&im);
+      res_.push_back(res[k]);
+    }
+  }
+
+  unsigned size() const { return res_.size(); }
+
+  void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+  {
+    for (unsigned t=begin; t<end; t++) {
+      const vil_image_view<srcT>& im = *images_[t];
+      std::vector<double>& r = *res_[t];
+      switch (grad_op_*9 + t%9)
+      {
+        //Interpolated Gaussian
+        case  0: brip_subpix_convolve_2d(im, pts_, r, brip_Gx_kernel(sigma_),   double(), interp_factor_); break;
+        case  1: brip_subpix_convolve_2d(im, pts_, r, brip_Gy_kernel(sigma_),   double(), interp_factor_); break;
+        case  2: brip_subpix_convolve_2d(im, pts_, r, brip_Gxx_kernel(sigma_),  double(), interp_factor_); break;
+        case  3: brip_subpix_convolve_2d(im, pts_, r, brip_Gxy_kernel(sigma_),  double(), interp_factor_); break;
+        case  4: brip_subpix_convolve_2d(im, pts_, r, brip_Gyy_kernel(sigma_),  double(), interp_factor_); break;
+        case  5: brip_subpix_convolve_2d(im, pts_, r, brip_Gxxx_kernel(sigma_), double(), interp_factor_); break;
+        case  6: brip_subpix_convolve_2d(im, pts_, r, brip_Gxxy_kernel(sigma_), double(), interp_factor_); break;
+        case  7: brip_subpix_convolve_2d(im, pts_, r, brip_Gxyy_kernel(sigma_), double(), interp_factor_); break;
+        case  8: brip_subpix_convolve_2d(im, pts_, r, brip_Gyyy_kernel(sigma_), double(), interp_factor_); break;
+        //h0-operator
+        case  9: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gx_kernel(sigma_),   double(), interp_factor_); break;
+        case 10: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gy_kernel(sigma_),   double(), interp_factor_); break;
+        case 11: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gxx_kernel(sigma_),  double(), interp_factor_); break;
+        case 12: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gxy_kernel(sigma_),  double(), interp_factor_); break;
+        case 13: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gyy_kernel(sigma_),  double(), interp_factor_); break;
+        case 14: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gxxx_kernel(sigma_), double(), interp_factor_); break;
+        case 15: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gxxy_kernel(sigma_), double(), interp_factor_); break;
+        case 16: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gxyy_kernel(sigma_), double(), interp_factor_); break;
+        case 17: brip_subpix_convolve_2d(im, pts_, r, brip_h0_Gyyy_kernel(sigma_), double(), interp_factor_); break;
+        //h1-operator
+        case 18: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gx_kernel(sigma_),   double(), interp_factor_); break;
+        case 19: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gy_kernel(sigma_),   double(), interp_factor_); break;
+        case 20: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gxx_kernel(sigma_),  double(), interp_factor_); break;
+        case 21: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gxy_kernel(sigma_),  double(), interp_factor_); break;
+        case 22: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gyy_kernel(sigma_),  double(), interp_factor_); break;
+        case 23: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gxxx_kernel(sigma_), double(), interp_factor_); break;
+        case 24: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gxxy_kernel(sigma_), double(), interp_factor_); break;
+        case 25: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gxyy_kernel(sigma_), double(), interp_factor_); break;
+        case 26: brip_subpix_convolve_2d(im, pts_, r, brip_h1_Gyyy_kernel(sigma_), double(), interp_factor_); break;
+      }
+    }
+  }
+
+ private:
+  const std::vector<vgl_point_2d<double> >& pts_;
+  unsigned grad_op_;
+  double sigma_;
+  unsigned interp_factor_;
+  std::vector<const vil_image_view<srcT>*> images_;
+  std::vector<std::vector<double>*> res_;
+};
 
 // function to compute generic edges
 void sdet_third_order_edge_det::apply(vil_image_view<vxl_byte> const& image)
@@ -34,46 +167,9 @@ void sdet_third_order_edge_det::apply(vil_image_view<vxl_byte> const& image)
   int scale = 1 << interp_factor_; // 2^interp_factor_
 
   //compute gradients
-  switch (grad_op_)
-  {
-    case 0: //Interpolated Gaussian
-    {
-      if (conv_algo_==0) { //2-d convolutions
-        brip_subpix_convolve_2d(greyscale_view, grad_x, brip_Gx_kernel(sigma_), double(), interp_factor_);
-        brip_subpix_convolve_2d(greyscale_view, grad_y, brip_Gy_kernel(sigma_), double(), interp_factor_);
-      }
-      else {
-        brip_subpix_convolve_2d_sep(greyscale_view, grad_x, brip_Gx_kernel(sigma_), double(), interp_factor_);
-        brip_subpix_convolve_2d_sep(greyscale_view, grad_y, brip_Gy_kernel(sigma_), double(), interp_factor_);
-      }
-
-      break;
-    }
-    case 1: //h0-operator
-    {
-      if (conv_algo_==0) { //2-d convolutions
-        brip_subpix_convolve_2d(greyscale_view, grad_x, brip_h0_Gx_kernel(sigma_), double(), interp_factor_);
-        brip_subpix_convolve_2d(greyscale_view, grad_y, brip_h0_Gy_kernel(sigma_), double(), interp_factor_);
-      }
-      else {
-        brip_subpix_convolve_2d_sep(greyscale_view, grad_x, brip_h0_Gx_kernel(sigma_), double(), interp_factor_);
-        brip_subpix_convolve_2d_sep(greyscale_view, grad_y, brip_h0_Gy_kernel(sigma_), double(), interp_factor_);
-      }
-      break;
-    }
-    case 2:  //h1-operator
-    {
-      if (conv_algo_==0) { //2-d convolutions
-        brip_subpix_convolve_2d(greyscale_view, grad_x, brip_h1_Gx_kernel(sigma_), double(), interp_factor_);
-        brip_subpix_convolve_2d(greyscale_view, grad_y, brip_h1_Gy_kernel(sigma_), double(), interp_factor_);
-      }
-      else {
-        brip_subpix_convolve_2d_sep(greyscale_view, grad_x, brip_h1_Gx_kernel(sigma_), double(), interp_factor_);
-        brip_subpix_convolve_2d_sep(greyscale_view, grad_y, brip_h1_Gy_kernel(sigma_), double(), interp_factor_);
-      }
-      break;
-    }
-  }
+  sdet_subpix_gradient_body<vxl_byte, double> grads(grad_op_, conv_algo_, sigma_, interp_factor_);
+  grads.add(greyscale_view, grad_x, grad_y);
+  vpl_parallel_for(grads.size(), grads, num_threads_);
 
   //compute gradient magnitude
   grad_mag.set_size(grad_x.ni(), grad_x.nj());
@@ -116,48 +212,9 @@ void sdet_third_order_edge_det::apply(vil_image_view<vxl_byte> const& image)
   //for each edge, compute all the gradients to compute the new orientation
   std::vector<double> Ix, Iy, Ixx, Ixy, Iyy, Ixxy, Ixyy, Ixxx, Iyyy;
 
-  switch (grad_op_)
-  {
-    case 0: //Interpolated Gaussian
-    {
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ix,   brip_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iy,   brip_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixx,  brip_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixy,  brip_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iyy,  brip_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixxx, brip_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixxy, brip_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixyy, brip_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iyyy, brip_Gyyy_kernel(sigma_), double(), interp_factor_);
-      break;
-    }
-    case 1: //h0-operator
-    {
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ix,   brip_h0_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iy,   brip_h0_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixx,  brip_h0_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixy,  brip_h0_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iyy,  brip_h0_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixxx, brip_h0_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixxy, brip_h0_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixyy, brip_h0_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iyyy, brip_h0_Gyyy_kernel(sigma_), double(), interp_factor_);
-      break;
-    }
-    case 2:  //h1-operator
-    {
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ix,   brip_h1_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iy,   brip_h1_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixx,  brip_h1_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixy,  brip_h1_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iyy,  brip_h1_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixxx, brip_h1_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixxy, brip_h1_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Ixyy, brip_h1_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(greyscale_view, edge_locations, Iyyy, brip_h1_Gyyy_kernel(sigma_), double(), interp_factor_);
-      break;
-    }
-  }
+  sdet_third_order_body<vxl_byte> derivs(edge_locations, grad_op_, sigma_, interp_factor_);
+  derivs.add(greyscale_view, Ix, Iy, Ixx, Ixy, Iyy, Ixxx, Ixxy, Ixyy, Iyyy);
+  vpl_parallel_for(derivs.size(), derivs, num_threads_);
 
   //Now, compute and update each edge with its new orientation
   std::vector<double> edge_orientations(edge_locations.size());
@@ -268,78 +325,15 @@ bool sdet_third_order_edge_det::apply_color(vil_image_view<vxl_byte> const& imag
   vil_image_view<float> f1_dx, f1_dy, f2_dx, f2_dy, f3_dx, f3_dy;
   int scale=1;
 
-  switch (grad_op_)
-  {
-    case 0: //Gaussian
-    {
-      scale = 1 << interp_factor_; // 2^interp_factor_
-      //compute gradients
-      if (conv_algo_==0) {
-        brip_subpix_convolve_2d(comp1, f1_dx, brip_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp1, f1_dy, brip_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp2, f2_dx, brip_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp2, f2_dy, brip_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp3, f3_dx, brip_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp3, f3_dy, brip_Gy_kernel(sigma_), float(), interp_factor_);
-      }
-      else {
-        brip_subpix_convolve_2d_sep(comp1, f1_dx, brip_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp1, f1_dy, brip_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp2, f2_dx, brip_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp2, f2_dy, brip_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp3, f3_dx, brip_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp3, f3_dy, brip_Gy_kernel(sigma_), float(), interp_factor_);
-      }
-      break;
-    }
-    case 1: //h0-operator
-    {
-      scale = 1 << interp_factor_; // 2^interp_factor_
-
-      //compute gradients
-      if (conv_algo_==0) {
-        brip_subpix_convolve_2d(comp1, f1_dx, brip_h0_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp1, f1_dy, brip_h0_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp2, f2_dx, brip_h0_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp2, f2_dy, brip_h0_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp3, f3_dx, brip_h0_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp3, f3_dy, brip_h0_Gy_kernel(sigma_), float(), interp_factor_);
-      }
-      else {
-        brip_subpix_convolve_2d_sep(comp1, f1_dx, brip_h0_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp1, f1_dy, brip_h0_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp2, f2_dx, brip_h0_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp2, f2_dy, brip_h0_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp3, f3_dx, brip_h0_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp3, f3_dy, brip_h0_Gy_kernel(sigma_), float(), interp_factor_);
-      }
+  if (grad_op_ <= 2)
+    scale = 1 << interp_factor_; // 2^interp_factor_
 
-      break;
-    }
-    case 2:  //h1-operator
-    {
-      scale = 1 << interp_factor_; // 2^interp_factor_
-
-      //compute gradients
-      if (conv_algo_==0) {
-        brip_subpix_convolve_2d(comp1, f1_dx, brip_h1_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp1, f1_dy, brip_h1_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp2, f2_dx, brip_h1_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp2, f2_dy, brip_h1_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp3, f3_dx, brip_h1_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d(comp3, f3_dy, brip_h1_Gy_kernel(sigma_), float(), interp_factor_);
-      }
-      else {
-        brip_subpix_convolve_2d_sep(comp1, f1_dx, brip_h1_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp1, f1_dy, brip_h1_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp2, f2_dx, brip_h1_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp2, f2_dy, brip_h1_Gy_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp3, f3_dx, brip_h1_Gx_kernel(sigma_), float(), interp_factor_);
-        brip_subpix_convolve_2d_sep(comp3, f3_dy, brip_h1_Gy_kernel(sigma_), float(), interp_factor_);
-      }
-      break;
-    }
-  }
+  //compute gradients
+  sdet_subpix_gradient_body<float, float> grads(grad_op_, conv_algo_, sigma_, interp_factor_);
+  grads.add(comp1, f1_dx, f1_dy);
+  grads.add(comp2, f2_dx, f2_dy);
+  grads.add(comp3, f3_dx, f3_dy);
+  vpl_parallel_for(grads.size(), grads, num_threads_);
 
   //5) compute the squared norm of the vector-gradient
   vil_image_view<double> grad_mag, nu1, nu2; //eigenvalue and eigenvector
@@ -401,111 +395,11 @@ bool sdet_third_order_edge_det::apply_color(vil_image_view<vxl_byte> const& imag
   std::vector<double> If2x, If2y, If2xx, If2xy, If2yy, If2xxy, If2xyy, If2xxx, If2yyy;
   std::vector<double> If3x, If3y, If3xx, If3xy, If3yy, If3xxy, If3xyy, If3xxx, If3yyy;
 
-  switch (grad_op_)
-  {
-    case 0: //Interpolated Gaussian
-    {
-      brip_subpix_convolve_2d(comp1, edge_locations, If1x,   brip_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1y,   brip_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xx,  brip_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xy,  brip_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1yy,  brip_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xxx, brip_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xxy, brip_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xyy, brip_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1yyy, brip_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      brip_subpix_convolve_2d(comp2, edge_locations, If2x,   brip_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2y,   brip_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xx,  brip_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xy,  brip_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2yy,  brip_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xxx, brip_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xxy, brip_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xyy, brip_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2yyy, brip_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      brip_subpix_convolve_2d(comp3, edge_locations, If3x,   brip_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3y,   brip_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xx,  brip_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xy,  brip_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3yy,  brip_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xxx, brip_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xxy, brip_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xyy, brip_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3yyy, brip_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      break;
-    }
-    case 1: //h0-operator
-    {
-      brip_subpix_convolve_2d(comp1, edge_locations, If1x,   brip_h0_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1y,   brip_h0_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xx,  brip_h0_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xy,  brip_h0_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1yy,  brip_h0_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xxx, brip_h0_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xxy, brip_h0_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xyy, brip_h0_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1yyy, brip_h0_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      brip_subpix_convolve_2d(comp2, edge_locations, If2x,   brip_h0_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2y,   brip_h0_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xx,  brip_h0_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xy,  brip_h0_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2yy,  brip_h0_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xxx, brip_h0_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xxy, brip_h0_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xyy, brip_h0_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2yyy, brip_h0_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      brip_subpix_convolve_2d(comp3, edge_locations, If3x,   brip_h0_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3y,   brip_h0_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xx,  brip_h0_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xy,  brip_h0_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3yy,  brip_h0_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xxx, brip_h0_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xxy, brip_h0_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xyy, brip_h0_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3yyy, brip_h0_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      break;
-    }
-    case 2:  //h1-operator
-    {
-      brip_subpix_convolve_2d(comp1, edge_locations, If1x,   brip_h1_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1y,   brip_h1_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xx,  brip_h1_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xy,  brip_h1_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1yy,  brip_h1_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xxx, brip_h1_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xxy, brip_h1_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1xyy, brip_h1_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp1, edge_locations, If1yyy, brip_h1_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      brip_subpix_convolve_2d(comp2, edge_locations, If2x,   brip_h1_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2y,   brip_h1_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xx,  brip_h1_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xy,  brip_h1_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2yy,  brip_h1_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xxx, brip_h1_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xxy, brip_h1_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2xyy, brip_h1_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp2, edge_locations, If2yyy, brip_h1_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      brip_subpix_convolve_2d(comp3, edge_locations, If3x,   brip_h1_Gx_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3y,   brip_h1_Gy_kernel(sigma_),   double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xx,  brip_h1_Gxx_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xy,  brip_h1_Gxy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3yy,  brip_h1_Gyy_kernel(sigma_),  double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xxx, brip_h1_Gxxx_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xxy, brip_h1_Gxxy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3xyy, brip_h1_Gxyy_kernel(sigma_), double(), interp_factor_);
-      brip_subpix_convolve_2d(comp3, edge_locations, If3yyy, brip_h1_Gyyy_kernel(sigma_), double(), interp_factor_);
-
-      break;
-    }
-  }
+  sdet_third_order_body<float> derivs(edge_locations, grad_op_, sigma_, interp_factor_);
+  derivs.add(comp1, If1x, If1y, If1xx, If1xy, If1yy, If1xxx, If1xxy, If1xyy, If1yyy);
+  derivs.add(comp2, If2x, If2y, If2xx, If2xy, If2yy, If2xxx, If2xxy, If2xyy, If2yyy);
+  derivs.add(comp3, If3x, If3y, If3xx, If3xy, If3yy, If3xxx, If3xxy, If3xyy, If3yyy);
+  vpl_parallel_for(derivs.size(), derivs, num_threads_);
 
   //Now, compute and update each edge with its new orientation
   std::vector<double> edge_orientations(edge_locations.size());
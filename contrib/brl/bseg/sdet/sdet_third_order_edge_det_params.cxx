@@ -18,7 +18,7 @@ sdet_third_order_edge_det_params(const sdet_third_order_edge_det_params& dp)
   : gevd_param_mixin()
 {
   InitParams(dp.sigma_, dp.thresh_, dp.interp_factor_, dp.pfit_type_,
-             dp.grad_op_, dp.conv_algo_,dp.adapt_thresh_);
+             dp.grad_op_, dp.conv_algo_,dp.adapt_thresh_, dp.num_threads_);
 }
 
 sdet_third_order_edge_det_params::
@@ -27,9 +27,10 @@ sdet_third_order_edge_det_params(const double sigma, const double thresh,
                                  const unsigned pfit_type,
                                  const unsigned grad_op,
                                  const unsigned conv_algo,
-                                 const bool adapt_thresh)
+                                 const bool adapt_thresh,
+                                 const unsigned num_threads)
 {
-  InitParams(sigma, thresh, interp_factor, pfit_type, grad_op, conv_algo, adapt_thresh);
+  InitParams(sigma, thresh, interp_factor, pfit_type, grad_op, conv_algo, adapt_thresh, num_threads);
 }
 
 void sdet_third_order_edge_det_params::InitParams(double sigma, double thresh,
@@ -37,7 +38,8 @@ void sdet_third_order_edge_det_params::InitParams(double sigma, double thresh,
                                                   unsigned pfit_type,
                                                   unsigned grad_op,
                                                   unsigned conv_algo,
-                                                  bool adapt_thresh)
+                                                  bool adapt_thresh,
+                                                  unsigned num_threads)
 {
   sigma_ = sigma,
   thresh_ = thresh;
@@ -46,6 +48,7 @@ void sdet_third_order_edge_det_params::InitParams(double sigma, double thresh,
   grad_op_ = grad_op;
   conv_algo_ = conv_algo;
   adapt_thresh_ = adapt_thresh;
+  num_threads_ = num_threads;
 }
 
 //-----------------------------------------------------------------------------
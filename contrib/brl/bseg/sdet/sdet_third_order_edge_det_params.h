@@ -22,7 +22,7 @@ class sdet_third_order_edge_det_params : public gevd_param_mixin
 // enumeration for the parabola fit type
   enum {PFIT_3_POINTS, PFIT_9_POINTS};
 
-  sdet_third_order_edge_det_params(const double sigma=1.0, const double thresh = 2.0, const unsigned interp_factor = 1, const unsigned pfit_type = 0, const unsigned grad_op = 0, const unsigned conv_algo=0, const bool adapt_thresh = false);
+  sdet_third_order_edge_det_params(const double sigma=1.0, const double thresh = 2.0, const unsigned interp_factor = 1, const unsigned pfit_type = 0, const unsigned grad_op = 0, const unsigned conv_algo=0, const bool adapt_thresh = false, const unsigned num_threads = 0);
 
   sdet_third_order_edge_det_params(const sdet_third_order_edge_det_params& old_params);
   ~sdet_third_order_edge_det_params(){}
@@ -32,7 +32,8 @@ class sdet_third_order_edge_det_params : public gevd_param_mixin
     std::ostream& operator<<(std::ostream&,const sdet_third_order_edge_det_params& dp);
  protected:
   void InitParams(double sigma, double thresh, unsigned interp_factor,
-                  unsigned pfit_type, unsigned grad_op, unsigned conv_algo, bool adapt_thresh);
+                  unsigned pfit_type, unsigned grad_op, unsigned conv_algo, bool adapt_thresh,
+                  unsigned num_threads);
  public:
   //: points with gradient magnitude below thresh_*maximum_gradient_magnitude/100 will not be processed.
   double sigma_;
@@ -42,6 +43,8 @@ class sdet_third_order_edge_det_params : public gevd_param_mixin
   unsigned grad_op_;
   unsigned conv_algo_;
   bool adapt_thresh_;
+  //: threads computing the convolutions (0 = one per processor)
+  unsigned num_threads_;
 };
 
 #endif // sdet_third_order_edge_det_params_h_
@@ -40,6 +40,23 @@ static void test_detector(int argc, char * argv[])
       std::cout << "v(" << x << ' ' << y << ")\n";
       TEST("(x,y) is (229,235)", x==229&&y==235, true);
     }
+
+    // The same edges when the image is processed in strips of 32 rows
+    dp.tile_size = 32;
+    dp.num_threads = 2;
+    sdet_detector tdet(dp);
+    tdet.SetImage(image);
+    tdet.DoContour();
+    std::vector<vtol_edge_2d_sptr>* tedges = tdet.GetEdges();
+    int tn = tedges ? (int)tedges->size() : 0;
+    TEST_EQUAL("tiled nedges", tn, n);
+    bool same = tn == n;
+    for (int i = 0; same && i < n; ++i)
+      same = (*edges)[i]->v1()->cast_to_vertex_2d()->x() == (*tedges)[i]->v1()->cast_to_vertex_2d()->x() &&
+             (*edges)[i]->v1()->cast_to_vertex_2d()->y() == (*tedges)[i]->v1()->cast_to_vertex_2d()->y() &&
+             (*edges)[i]->v2()->cast_to_vertex_2d()->x() == (*tedges)[i]->v2()->cast_to_vertex_2d()->x() &&
+             (*edges)[i]->v2()->cast_to_vertex_2d()->y() == (*tedges)[i]->v2()->cast_to_vertex_2d()->y();
+    TEST("tiled edges have the same end points", same, true);
   }else{
     TEST("image could not be loaded so no fault", true, true);
   }
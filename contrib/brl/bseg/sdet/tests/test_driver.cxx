@@ -7,6 +7,7 @@ DECLARE(test_denoise_mrf);
 DECLARE(test_denoise_mrf_bp);
 DECLARE(test_segmentation);
 DECLARE(test_sel);
+DECLARE(test_sel_parallel);
 
 
 void
@@ -19,6 +20,7 @@ register_tests()
   REGISTER(test_denoise_mrf_bp);
   REGISTER(test_segmentation);
   REGISTER(test_sel);
+  REGISTER(test_sel_parallel);
 }
 
 DEFINE_MAIN;
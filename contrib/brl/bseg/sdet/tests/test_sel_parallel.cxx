@@ -0,0 +1,184 @@
+// This is brl/bseg/sdet/tests/test_sel_parallel.cxx
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <vil/vil_image_view.h>
+#include <vnl/vnl_random.h>
+#include <sdet/sdet_third_order_edge_det.h>
+#include <sdet/sdet_curve_model.h>
+#include <sdet/sdet_curvelet_pool.h>
+#include <sdet/sdet_sel.h>
+#include <vpl/vpl_parallel_for.h>
+
+// Discs and a bar of different contrast on a noisy background
+static vil_image_view<vxl_byte> test_image()
+{
+  vil_image_view<vxl_byte> image(160, 120);
+  vnl_random rng(5542341);
+  for (unsigned j = 0; j < image.nj(); ++j)
+    for (unsigned i = 0; i < image.ni(); ++i) {
+      double v = 60.0 + rng.normal() * 3.0;
+      int x = int(i), y = int(j);
+      if ((x-50)*(x-50) + (y-50)*(y-50) < 900) v += 90.0;
+      if ((x-115)*(x-115) + (y-70)*(y-70) < 500) v += 50.0;
+      if (y > 95 && x > 20 && x < 140) v += 40.0;
+      image(i, j) = vxl_byte(v);
+    }
+  return image;
+}
+
+static std::vector<vdgl_edgel> detect_edgels(const vil_image_view<vxl_byte>& image, unsigned num_threads,
+                                             sdet_edgemap_sptr& edgemap)
+{
+  sdet_third_order_edge_det_params params(1.0, 2.0, 1, 0, 0, 0, false, num_threads);
+  sdet_third_order_edge_det det(params);
+  det.apply(image);
+  edgemap = det.edgemap();
+  return det.edgels();
+}
+
+// Number of edgels whose curvelets differ between the two maps
+static unsigned num_different_curvelets(sdet_curvelet_map& cm1, sdet_curvelet_map& cm2)
+{
+  unsigned n = 0;
+  for (unsigned i = 0; i < cm1.map_.size(); ++i) {
+    cvlet_list& l1 = cm1.curvelets(i);
+    cvlet_list& l2 = cm2.curvelets(i);
+    bool same = l1.size() == l2.size();
+    for (cvlet_list_iter c1 = l1.begin(), c2 = l2.begin(); same && c1 != l1.end(); ++c1, ++c2) {
+      same = (*c1)->edgel_chain.size() == (*c2)->edgel_chain.size() &&
+             (*c1)->forward == (*c2)->forward && (*c1)->quality == (*c2)->quality &&
+             (*c1)->used == (*c2)->used;
+      for (unsigned k = 0; same && k < (*c1)->edgel_chain.size(); ++k)
+        same = (*c1)->edgel_chain[k]->id == (*c2)->edgel_chain[k]->id;
+    }
+    if (!same)
+      ++n;
+  }
+  return n;
+}
+
+// Number of edgels whose child links differ between the two link graphs
+static unsigned num_different_links(sdet_edgel_link_graph& g1, sdet_edgel_link_graph& g2)
+{
+  unsigned n = 0;
+  for (unsigned i = 0; i < g1.cLinks.size(); ++i) {
+    bool same = g1.cLinks[i].size() == g2.cLinks[i].size() && g1.pLinks[i].size() == g2.pLinks[i].size();
+    for (sdet_link_list_iter l1 = g1.cLinks[i].begin(), l2 = g2.cLinks[i].begin();
+         same && l1 != g1.cLinks[i].end(); ++l1, ++l2)
+      same = (*l1)->ce->id == (*l2)->ce->id && (*l1)->vote == (*l2)->vote &&
+             (*l1)->deg_overlap == (*l2)->deg_overlap &&
+             (*l1)->curvelets.size() == (*l2)->curvelets.size();
+    if (!same)
+      ++n;
+  }
+  return n;
+}
+
+// Each index allocates objects and releases half of them, the rest on the next index
+class pool_body : public vpl_parallel_for_body
+{
+ public:
+  pool_body(sdet_curvelet_pool& pool, unsigned nthreads) : unbounded_(nthreads, 0), pool_(pool) {}
+  void execute(unsigned begin, unsigned end, unsigned thread_id)
+  {
+    std::vector<void*> kept;
+    for (unsigned i = begin; i < end; ++i) {
+      std::vector<void*> objects;
+      for (unsigned k = 0; k < 300; ++k)
+        objects.push_back(pool_.allocate());
+      for (unsigned k = 0; k < kept.size(); ++k)
+        pool_.release(kept[k]);
+      kept.assign(objects.begin() + 150, objects.end());
+      for (unsigned k = 0; k < 150; ++k)
+        pool_.release(objects[k]);
+      if (pool_.num_cached() > 2*sdet_curvelet_pool::cache_batch)
+        unbounded_[thread_id] = 1;
+    }
+    for (unsigned k = 0; k < kept.size(); ++k)
+      pool_.release(kept[k]);
+  }
+  //: set for a thread whose cache grew beyond its bound
+  std::vector<char> unbounded_;
+ private:
+  sdet_curvelet_pool& pool_;
+};
+
+static void test_curvelet_pool()
+{
+  sdet_curvelet_pool pool(20, 4);
+  TEST("Object size is aligned", pool.object_size() % 16, 0);
+  std::vector<void*> objects;
+  for (unsigned i = 0; i < 6; ++i)
+    objects.push_back(pool.allocate());
+  TEST_EQUAL("Objects in use", pool.num_allocated() - pool.num_cached(), 6);
+  TEST_EQUAL("Slabs allocated", pool.num_slabs(), 2);
+  TEST("Objects do not overlap", (char*)objects[1] - (char*)objects[0] >= (long)pool.object_size(), true);
+  TEST("Trim keeps slabs in use", pool.trim(), false);
+  pool.release(objects[2]);
+  TEST("Released object is reused", pool.allocate() == objects[2], true);
+  for (unsigned i = 0; i < objects.size(); ++i)
+    pool.release(objects[i]);
+  TEST_EQUAL("No objects in use", pool.num_allocated(), pool.num_cached());
+  TEST("Trim frees the slabs", pool.trim() && pool.num_slabs() == 0, true);
+
+  // threads allocate from their own caches, which go back to the slabs when the threads exit
+  sdet_curvelet_pool shared(20, 256);
+  pool_body body(shared, 4);
+  vpl_parallel_for(40, body, 4, 4);
+  TEST("Thread caches stay bounded", std::count(body.unbounded_.begin(), body.unbounded_.end(), 1), 0);
+  TEST_EQUAL("Thread caches returned", shared.num_allocated(), shared.num_cached());
+  TEST("Trim after the threads", shared.trim() && shared.num_allocated() == 0, true);
+}
+
+static void test_sel_parallel()
+{
+  test_curvelet_pool();
+
+  // third order edge detection with and without threads
+  vil_image_view<vxl_byte> image = test_image();
+  sdet_edgemap_sptr em1, em3;
+  std::vector<vdgl_edgel> edgels1 = detect_edgels(image, 1, em1);
+  std::vector<vdgl_edgel> edgels3 = detect_edgels(image, 3, em3);
+  std::cout << edgels1.size() << " edgels\n";
+  TEST("Edgels found", edgels1.size() > 100, true);
+  bool same_edgels = edgels1.size() == edgels3.size();
+  for (unsigned i = 0; same_edgels && i < edgels1.size(); ++i)
+    same_edgels = edgels1[i].get_pt() == edgels3[i].get_pt() &&
+                  edgels1[i].get_theta() == edgels3[i].get_theta() &&
+                  edgels1[i].get_grad() == edgels3[i].get_grad();
+  TEST("Same edgels on 3 threads", same_edgels, true);
+
+  // curvelets and link graphs on 1 and 3 threads
+  sdet_curvelet_params cvlet_params(sdet_curve_model::CC3d, 3.5, 2.0, 15.0, 0.4, true, 1.0, 0.2, 0.05, true, false);
+  for (int method = 0; method <= 2; ++method) {
+    sdet_curvelet_map cm1, cm3;
+    sdet_edgel_link_graph elg1, elg3;
+    sdet_curve_fragment_graph cfg1, cfg3;
+    sdet_sel<sdet_CC_curve_model_3d> sel1(em1, cm1, elg1, cfg1, cvlet_params);
+    sdet_sel<sdet_CC_curve_model_3d> sel3(em1, cm3, elg3, cfg3, cvlet_params);
+    sel1.set_num_threads(1);
+    sel3.set_num_threads(3);
+    sel1.build_curvelets_greedy(7);
+    sel3.build_curvelets_greedy(7);
+    sel1.construct_the_link_graph(4, method);
+    sel3.construct_the_link_graph(4, method);
+
+    unsigned ncvlets = 0, nlinks = 0;
+    for (unsigned i = 0; i < cm1.map_.size(); ++i)
+      ncvlets += cm1.curvelets(i).size();
+    for (unsigned i = 0; i < elg1.cLinks.size(); ++i)
+      nlinks += elg1.cLinks[i].size();
+    std::cout << "link method " << method << ": " << ncvlets << " curvelets, " << nlinks << " links\n";
+    TEST("Curvelets formed", ncvlets > 0 && nlinks > 0, true);
+    TEST("Pool holds the curvelets", sdet_curvelet_pool::instance().num_allocated() >= 2*ncvlets, true);
+    TEST_EQUAL("Same curvelets on 3 threads", num_different_curvelets(cm1, cm3), 0);
+    TEST_EQUAL("Same link graph on 3 threads", num_different_links(elg1, elg3), 0);
+  }
+  TEST_EQUAL("Curvelets returned to the pool", sdet_curvelet_pool::instance().num_allocated(), 0);
+  TEST_EQUAL("Pool memory released", sdet_curvelet_pool::instance().num_slabs(), 0);
+}
+
+TESTMAIN(test_sel_parallel);
@@ -1,6 +1,7 @@
 // This is gel/gevd/gevd_bufferxy.cxx
 #include <fstream>
 #include <iostream>
+#include <cstddef>
 #include <cstdio>
 #include <cstring>
 #include "gevd_bufferxy.h"
@@ -21,11 +22,31 @@
 
 //============== Constructors and Destructors ======================
 
-void gevd_bufferxy::Init(int x, int y, int b)
+//: Bytes to allocate for a buffer of width x, height y, and b bits per entry.
+// An ALIGNED_ROWS buffer needs up to ROW_ALIGNMENT-1 extra bytes to align its first row.
+int gevd_bufferxy::MemorySize(int x, int y, int b, RowLayout layout)
+{
+  int row = x*(int)((b+7)/8);
+  if (layout == CONTIGUOUS_ROWS)
+    return row*y;
+  row = (row + ROW_ALIGNMENT-1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+  return row*y + ROW_ALIGNMENT-1;
+}
+
+void gevd_bufferxy::Init(int x, int y, int b, RowLayout layout)
 {
   SetBitsPixel(b);
   SetSizeX(x);
   SetSizeY(y);
+  L = layout;
+  S = x*GetBytesPixel();
+  unsigned char* first = GetBufferPtr();
+  if (layout == ALIGNED_ROWS) {
+    S = (S + ROW_ALIGNMENT-1) / ROW_ALIGNMENT * ROW_ALIGNMENT;
+    std::size_t misalign = reinterpret_cast<std::size_t>(first) % ROW_ALIGNMENT;
+    if (misalign)
+      first += ROW_ALIGNMENT - misalign;
+  }
 
   // Set the pointers appropriately
   typedef unsigned char * byteptr;
@@ -35,7 +56,7 @@ void gevd_bufferxy::Init(int x, int y, int b)
     xra[i] = i * GetBytesPixel();
 
   for (int j=0; j < y; j++)
-    yra[j] = GetBufferPtr() + j*x*GetBytesPixel();
+    yra[j] = first + j*S;
 }
 
 //: Construct a gevd_bufferxy of width x, height y, and b bits per entry.
@@ -57,6 +78,13 @@ gevd_bufferxy::gevd_bufferxy(int x, int y, int b, void* memptr) : gevd_memory_mi
   SetStatus(MM_PROTECTED);
 }
 
+//: Construct a gevd_bufferxy of width x, height y, and b bits per entry, with the given row layout.
+gevd_bufferxy::gevd_bufferxy(int x, int y, int b, RowLayout layout)
+  : gevd_memory_mixin(MemorySize(x, y, b, layout))
+{
+  Init(x, y, b, layout);
+}
+
 //: Construct a gevd_bufferxy from a vil1_image
 gevd_bufferxy::gevd_bufferxy(vil1_image const& image) : gevd_memory_mixin( image.get_size_bytes() )
 {
@@ -71,7 +99,8 @@ gevd_bufferxy::gevd_bufferxy(vil1_image const& image) : gevd_memory_mixin( image
 
 //: Construct a gevd_bufferxy from a vil_image
 gevd_bufferxy::gevd_bufferxy(vil_image_resource_sptr const& image_s) :
-  gevd_memory_mixin(image_s->nplanes()*image_s->ni()*image_s->nj()*vil_pixel_format_sizeof_components(image_s->pixel_format()))
+  gevd_memory_mixin(image_s->nplanes()*image_s->ni()*image_s->nj()*vil_pixel_format_sizeof_components(image_s->pixel_format())),
+  L(CONTIGUOUS_ROWS)
 {
   if (!image_s)
   {
@@ -145,8 +174,12 @@ gevd_bufferxy::~gevd_bufferxy()
 
 gevd_bufferxy::gevd_bufferxy(gevd_bufferxy const& buf) : gevd_memory_mixin(buf)
 {
-  Init(buf.GetSizeX(), buf.GetSizeY(), buf.GetBitsPixel());
-  std::memcpy(yra[0], buf.yra[0], GetSizeX()*GetSizeY()*GetBytesPixel());
+  Init(buf.GetSizeX(), buf.GetSizeY(), buf.GetBitsPixel(), buf.GetRowLayout());
+  if (IsContiguous())
+    std::memcpy(yra[0], buf.yra[0], GetSizeX()*GetSizeY()*GetBytesPixel());
+  else // the first row need not be at the same offset in the copy
+    for (int j=0; j < GetSizeY(); ++j)
+      std::memcpy(yra[j], buf.yra[j], GetSizeX()*GetBytesPixel());
 }
 
 //: Write to file.  Note that this can be OS-specific!
@@ -160,8 +193,8 @@ void gevd_bufferxy::dump(const char* filename)
 #else
     << " LITTLEENDIAN DATA\n";
 #endif
-  iostream_char const* buf = (iostream_char const*)GetBuffer();
-  f.write(buf, gevd_memory_mixin::GetSize());
+  for (int j=0; j < GetSizeY(); ++j)
+    f.write((iostream_char const*)GetRow(j), GetSizeX()*GetBytesPixel());
 }
 
 static int read_from_file(const char* filename)
@@ -185,7 +218,7 @@ static int read_from_file(const char* filename)
 
 //: Read from file.  Note that this can be OS-specific!
 gevd_bufferxy::gevd_bufferxy(const char* filename) : gevd_memory_mixin(read_from_file(filename)),
-  yra(VXL_NULLPTR), xra(VXL_NULLPTR)
+  L(CONTIGUOUS_ROWS), yra(VXL_NULLPTR), xra(VXL_NULLPTR)
 {
   if (gevd_memory_mixin::GetSize() > 0) {
     std::ifstream f(filename,std::ios::in|std::ios::binary); // ios::nocreate is on by default for VCL_WIN32
@@ -194,7 +227,7 @@ gevd_bufferxy::gevd_bufferxy(const char* filename) : gevd_memory_mixin(read_from
     int x=-1, y=-1, b=-1;
     std::sscanf(l, "BUFFERXYDUMP %d %d %d", &x, &y, &b);
     f.get(l[0]); // read end-of-line
-    Init(x, y, b);
+    Init(x, y, b); // contiguous rows, so the memory holds exactly the pixel data
     iostream_char* buf = (iostream_char*)GetBuffer();
     f.read(buf, gevd_memory_mixin::GetSize());
   }
@@ -8,6 +8,15 @@
 // (x,y) coordinate.  Addressing is performed using a pair of arrays
 // which store pointers to the x columns and y rows.
 //
+// By default the rows are stored one after the other.  A buffer created
+// with ALIGNED_ROWS starts each row on a ROW_ALIGNMENT byte boundary and
+// pads it to a multiple of ROW_ALIGNMENT bytes, so that vectorized loops
+// over a row never straddle a cache line at its start.  Code which
+// walks through the whole buffer with a single pointer must then step
+// from row to row with GetRow() or GetRowStride().  Buffers made by the
+// gevd_float_operators helpers Allocate() and SimilarBuffer() have
+// contiguous rows unless aligned rows are asked for.
+//
 // \author   Brian DeCleene
 // \date     Nov. 16, 1990.
 //
@@ -21,6 +30,7 @@
 //     - File dump I/O added.
 //   J.L. Mundy - Dec 27 2004.
 //     - added support for vil
+//   Oct 2026 - added aligned, padded row storage (ALIGNED_ROWS)
 // \endverbatim
 //=======================================================================
 
@@ -32,17 +42,28 @@
 
 class gevd_bufferxy : public gevd_memory_mixin
 {
+ public:
+  //: Storage of the rows in memory
+  enum RowLayout { CONTIGUOUS_ROWS, ALIGNED_ROWS };
+  //: Alignment and padding in bytes of the rows of an ALIGNED_ROWS buffer
+  enum { ROW_ALIGNMENT = 32 };
+
+ private:
   // Parameters which define the size of the buffer.
   int B;    // Bits per pixel
   int X;    // X dimension in pixels.
   int Y;    // Y dimension in pixels.
+  int S;    // Bytes from the start of a row to the start of the next one.
+  RowLayout L;
 
   // Array for accessing the memory.
   unsigned char** yra;
   unsigned int*   xra;
 
+  static int MemorySize(int X, int Y, int B, RowLayout layout);
+
  protected:
-  void Init(int X, int Y, int B);
+  void Init(int X, int Y, int B, RowLayout layout = CONTIGUOUS_ROWS);
   gevd_bufferxy(); // the default constructor should not be used.
 
   // SET ROUTINES FOR BUFFER SIZE
@@ -55,6 +76,7 @@ class gevd_bufferxy : public gevd_memory_mixin
 
   gevd_bufferxy(int X, int Y, int B);
   gevd_bufferxy(int X, int Y, int B, void* memptr);
+  gevd_bufferxy(int X, int Y, int B, RowLayout layout);
   gevd_bufferxy(vil1_image const &img);
   gevd_bufferxy(vil_image_resource_sptr const& img);
   ~gevd_bufferxy();
@@ -66,11 +88,21 @@ class gevd_bufferxy : public gevd_memory_mixin
   inline int GetSizeX()           const { return X; }
   inline int GetSizeY()           const { return Y; }
   inline int GetArea()            const { return GetSizeX()*GetSizeY(); }
+  //: Bytes of pixel data, i.e. GetArea()*GetBytesPixel().
+  //  This excludes the padding and alignment of ALIGNED_ROWS buffers;
+  //  gevd_memory_mixin::GetSize() is the size of the allocated memory.
   inline int GetSize()            const { return GetArea()*GetBytesPixel(); }
+  inline int GetRowStride()       const { return S; }
+  inline RowLayout GetRowLayout() const { return L; }
+  //: True if the rows follow each other without padding
+  inline bool IsContiguous()      const { return S == X*GetBytesPixel(); }
 
   // ELEMENT ADDRESSING METHOD
-  inline void* GetBuffer()             { return GetBufferPtr(); }
-  inline const void* GetBuffer() const { return GetBufferPtr(); }
+  //: Start of the first row.
+  inline void* GetBuffer()             { return L == ALIGNED_ROWS ? (void*)yra[0] : (void*)GetBufferPtr(); }
+  inline const void* GetBuffer() const { return L == ALIGNED_ROWS ? (const void*)yra[0] : (const void*)GetBufferPtr(); }
+  inline void* GetRow(int y)             { return yra[y]; }
+  inline const void* GetRow(int y) const { return yra[y]; }
   inline void* GetElementAddr(int x, int y)          { return xra[x]+yra[y]; }
   inline const void* GetElementAddr(int x,int y)const{ return xra[x]+yra[y]; }
 
@@ -10,6 +10,7 @@
 
 #include <vcl_compiler.h>
 #include <vcl_cassert.h>
+#include <vxl_config.h>
 #include <vnl/vnl_math.h> // for pi_over_2
 #include <vnl/vnl_float_3.h>
 #include <vnl/vnl_cross.h>
@@ -21,6 +22,9 @@
 #ifdef DEBUG
 # include <vul/vul_timer.h>
 #endif
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+# include <emmintrin.h>
+#endif
 
 #if defined(VCL_VC)
 inline static double rint(double v)
@@ -29,7 +33,69 @@ inline static double rint(double v)
 }
 #endif
 
+//: The filters keep the row layout of their input in their outputs.
+static inline bool HasAlignedRows(const gevd_bufferxy& buf)
+{
+  return buf.GetRowLayout() == gevd_bufferxy::ALIGNED_ROWS;
+}
+
 const unsigned char DIR0 = 8, DIR1 = 9, DIR2 = 10, DIR3 = 11, DIR4 = 12;
+
+//:
+// Filter len values with an even/odd kernel across the 2*radius+1 lines
+// lines[-radius] ... lines[radius]:
+//   to[x] = kernel[radius]*lines[0][x]
+//         + sum_k kernel[radius-k]*(lines[-k][x] +/- lines[k][x]).
+// The lines are rows of an image for a convolution along y, or shifted
+// pointers into the same row for a convolution along x.
+// The terms are added in the same order for all x, with or without SSE2,
+// so that the vectorized sums are identical to the scalar ones.
+
+static void
+ConvolveLines(float* to, const float* const* lines, const int len,
+              const float* kernel, const int radius, const bool evenp)
+{
+  int x = 0;
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+  // a - b == a + (-b) in IEEE arithmetic: flip the sign bit for odd kernels
+  const __m128 sign = evenp ? _mm_setzero_ps() : _mm_set1_ps(-0.0f);
+  const __m128 kc = _mm_set1_ps(kernel[radius]);
+  for (; x+4 <= len; x += 4) {
+    __m128 sum = _mm_mul_ps(kc, _mm_loadu_ps(lines[0]+x));
+    for (int k = 1; k <= radius; k++) {
+      __m128 b = _mm_xor_ps(_mm_loadu_ps(lines[k]+x), sign);
+      __m128 ab = _mm_add_ps(_mm_loadu_ps(lines[-k]+x), b);
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(kernel[radius-k]), ab));
+    }
+    _mm_storeu_ps(to+x, sum);
+  }
+#endif
+  if (evenp)
+    for (; x < len; x++) {
+      float sum = kernel[radius] * lines[0][x];
+      for (int k = 1; k <= radius; k++)
+        sum += kernel[radius-k] * (lines[-k][x] + lines[k][x]);
+      to[x] = sum;
+    }
+  else
+    for (; x < len; x++) {
+      float sum = kernel[radius] * lines[0][x];
+      for (int k = 1; k <= radius; k++)
+        sum += kernel[radius-k] * (lines[-k][x] - lines[k][x]);
+      to[x] = sum;
+    }
+}
+
+//: Value at index i of a linear array, reflected or wrapped at the 2 ends.
+static inline float
+BorderValue(const float* data, const int len, int i, const bool wrap)
+{
+  if (i < 0)
+    i = wrap ? len + i : -i;
+  else if (i >= len)
+    i = wrap ? i - len : 2*len - 2 - i;
+  return data[i < 0 ? 0 : i >= len ? len-1 : i]; // arrays shorter than the kernel
+}
 // const int DIS[] = { 1, 1, 0,-1,-1,-1, 0, 1, // 8-connected neighbors
 //                     1, 1, 0,-1,-1,-1, 0, 1, // wrapped by 2PI
 //                     1, 1, 0,-1,-1,-1, 0, 1};
@@ -57,7 +123,7 @@ gevd_float_operators::Convolve(const gevd_bufferxy& from,
   bool overwrite = to == &from;
   gevd_bufferxy*& t = to;
   if (overwrite) to=VXL_NULLPTR;
-  to = gevd_float_operators::Allocate(to, from);
+  to = gevd_float_operators::Allocate(to, from, 0, 0, 0, HasAlignedRows(from));
   const int wx = kernel.GetSizeX(), wy = kernel.GetSizeY();
   const int rx = wx/2, ry = wy/2;
   const int xhi = from.GetSizeX() - wx + 1;
@@ -241,7 +307,7 @@ gevd_float_operators::Convolve(const gevd_bufferxy& from, gevd_bufferxy*& to,
   bool overwrite = to == &from;
   gevd_bufferxy*& t = to;
   if (overwrite) to=VXL_NULLPTR;
-  to = gevd_float_operators::Allocate(to, from);
+  to = gevd_float_operators::Allocate(to, from, 0, 0, 0, HasAlignedRows(from));
   const int sizeX = to->GetSizeX(), sizeY = to->GetSizeY();
   const int ylo = yradius, yhi = sizeY - yradius;
   const int kborder = 2*yradius;
@@ -278,90 +344,28 @@ gevd_float_operators::Convolve(const gevd_bufferxy& from, gevd_bufferxy*& to,
     }
 
   // 2. Convolve along y-axis, shifting pipeline by 1 each time.
-  if (yevenp)
-  {
-    int y=0;
-    for (int yy = 0; y < ylo; ++y, ++yy) { // reflect/wrap at ymin
-      row = &floatPixel(*to, 0, y); // row-major order
-      for (int x = 0; x < sizeX; x++) {
-        float sum = ykernel[yradius] * pipeline[yy][x];
-        for (int k = 1; k <= yradius; k++)
-          sum += ykernel[yradius-k] * (pipeline[yy-k][x] + pipeline[yy+k][x]);
-        row[x] = sum;
-      }
-    }
-    int p = kborder+1;
-    for ( ; y < yhi; ++y) {     // convolution along y-axis
-      row = &floatPixel(*to, 0, y);
-      for (int x = 0; x < sizeX; x++) {
-        float sum = ykernel[yradius] * pipeline[yradius][x];
-        for (int k = 1; k <= yradius; k++)
-          sum += ykernel[yradius-k] * (pipeline[yradius-k][x] + // even kernel
-                                       pipeline[yradius+k][x]);
-        row[x] = sum;
-      }
-      if (p < sizeY) {
-        row = pipeline[0];      // next line
-        for (int k = 0; k < kborder; k++) // shift the lines of
-          pipeline[k] = pipeline[k+1]; // the pipeline by 1
-        gevd_float_operators::Convolve(&floatPixel(from, 0, p++), // row-major order
-                                       row, sizeX,
-                                       xkernel, xradius, xevenp, xwrap); // new line x-conv
-        pipeline[kborder] = row; // update pipeline
-      }
-    }
-    for (int yy = yradius+1; y < sizeY; y++, yy++) {  // reflect/wrap at ymax
-      row = &floatPixel(*to, 0, y); // row-major order
-      for (int x = 0; x < sizeX; x++) {
-        float sum = ykernel[yradius] * pipeline[yy][x];
-        for (int k = 1; k <= yradius; k++)  // convolution along y-axis
-          sum += ykernel[yradius-k] * (pipeline[yy-k][x] + pipeline[yy+k][x]);
-        row[x] = sum;
-      }
-    }
-  }
-  else
-  {
-    int y=0;
-    for (int yy = 0; y < ylo; y++, yy++) { // reflect at ymin
-      row = &floatPixel(*to, 0, y); // row-major order
-      for (int x = 0; x < sizeX; x++) {
-        float sum = ykernel[yradius] * pipeline[yy][x];
-        for (int k = 1; k <= yradius; k++)
-          sum += ykernel[yradius-k] * (pipeline[yy-k][x] - pipeline[yy+k][x]);
-        row[x] = sum;
-      }
-    }
-    int p = kborder+1;
-    for ( ; y < yhi; y++) {
-      row = &floatPixel(*to, 0, y);
-      for (int x = 0; x < sizeX; x++) {
-        float sum = ykernel[yradius] * pipeline[yradius][x];
-        for (int k = 1; k <= yradius; k++)  // convolution along y-axis
-          sum += ykernel[yradius-k] * (pipeline[yradius-k][x] - // odd kernel
-                                       pipeline[yradius+k][x]);
-        row[x] = sum;
-      }
-      if (p < sizeY) {
-        row = pipeline[0];      // next line
-        for (int k = 0; k < kborder; k++)   // shift the lines of
-          pipeline[k] = pipeline[k+1];  // the pipeline by 1
-        gevd_float_operators::Convolve(&floatPixel(from, 0, p++), // row-major order
-                                       row, sizeX,
-                                       xkernel, xradius, xevenp, xwrap); // new line x-conv
-        pipeline[kborder] = row; // update pipeline
-      }
-    }
-    for (int yy = yradius+1; y < sizeY; y++, yy++) { // reflect/wrap at ymax
-      row = &floatPixel(*to, 0, y); // row-major order
-      for (int x = 0; x < sizeX; x++) {
-        float sum = ykernel[yradius] * pipeline[yy][x];
-        for (int k = 1; k <= yradius; k++)  // convolution along y-axis
-          sum += ykernel[yradius-k] * (pipeline[yy-k][x] - pipeline[yy+k][x]);
-        row[x] = sum;
-      }
+  // The even/odd y-kernel is applied to whole lines of the pipeline.
+  int y=0;
+  for (int yy = 0; y < ylo; ++y, ++yy)  // reflect/wrap at ymin
+    ConvolveLines(&floatPixel(*to, 0, y), pipeline+yy, sizeX, // row-major order
+                  ykernel, yradius, yevenp);
+  int p = kborder+1;
+  for ( ; y < yhi; ++y) {       // convolution along y-axis
+    ConvolveLines(&floatPixel(*to, 0, y), pipeline+yradius, sizeX,
+                  ykernel, yradius, yevenp);
+    if (p < sizeY) {
+      row = pipeline[0];        // next line
+      for (int k = 0; k < kborder; k++) // shift the lines of
+        pipeline[k] = pipeline[k+1]; // the pipeline by 1
+      gevd_float_operators::Convolve(&floatPixel(from, 0, p++), // row-major order
+                                     row, sizeX,
+                                     xkernel, xradius, xevenp, xwrap); // new line x-conv
+      pipeline[kborder] = row; // update pipeline
     }
   }
+  for (int yy = yradius+1; y < sizeY; y++, yy++) // reflect/wrap at ymax
+    ConvolveLines(&floatPixel(*to, 0, y), pipeline+yy, sizeX,
+                  ykernel, yradius, yevenp);
   for (int p = 0; p <= 4*yradius; p++)
     delete[] cache[p];         // Free lines in pipeline cache
   delete[] cache;
@@ -401,7 +405,7 @@ gevd_float_operators::Convolve(const gevd_bufferxy& from, gevd_bufferxy*& to,
   vul_timer t;
   std::cout << "Convolve image";
 #endif
-  to = gevd_float_operators::Allocate(to, from);
+  to = gevd_float_operators::Allocate(to, from, 0, 0, 0, HasAlignedRows(from));
   const int sizeX = to->GetSizeX(), sizeY = to->GetSizeY();
   const int ylo = yradius, yhi = sizeY - yradius;
   const int kborder = 2*yradius;
@@ -495,78 +499,35 @@ gevd_float_operators::Convolve(const float* from, float*& to, const int len,
                                const float* kernel, const int kradius,
                                const bool evenp, const bool wrap)
 {
+  float* orig = to;
   bool overwrite = to == from;
-  float*& t = to;
   if (!to || overwrite) to = new float[len];
-  const int xlo = kradius, xhi = len - kradius;
-  const int kborder = 2*kradius;
-  float *cache, *pipeline;
-  int p = gevd_float_operators::SetupPipeline(from, len, kradius, wrap,
-                                              cache, pipeline);
-
-  // Convolution along x with above pipeline
-  float sum;
-  if (evenp)
-  {
-    int x=0;
-    for (int xx = 0; x < xlo; ++x, ++xx) {
-      sum = kernel[kradius] * pipeline[xx];
-      for (int k = 1; k <= kradius; k++)
-        sum += kernel[kradius-k] * (pipeline[xx-k] + pipeline[xx+k]);
-      to[x] = sum;
-    }
-    for ( ; x < xhi; x++) {
-      sum = kernel[kradius] * pipeline[kradius];
-      for (int k = 1; k <= kradius; k++)
-        sum += kernel[kradius-k] * (pipeline[kradius-k] + // plus for
-                                    pipeline[kradius+k]); // symmetric
-      to[x] = sum;
-      if (p < len) {
-        for (int k = 0; k < kborder; k++)   // shift the floats of
-          pipeline[k] = pipeline[k+1];  // the pipeline by 1
-        pipeline[kborder] = from[p++];  // update pipeline
-      }
-    }
-    for (int xx = kradius+1; x < len; x++, xx++) {
-      sum = kernel[kradius] * pipeline[xx];
-      for (int k = 1; k <= kradius; k++)
-        sum += kernel[kradius-k] * (pipeline[xx-k] + pipeline[xx+k]);
-      to[x] = sum;
-    }
+  const int xlo = std::min(kradius, len), xhi = std::max(len - kradius, xlo);
+
+  // Reflect/wrap at the 2 ends
+  const float sign = evenp ? 1.0f : -1.0f;
+  for (int x = 0; x < len; x++) {
+    if (x == xlo) x = xhi;
+    if (x == len) break;
+    float sum = kernel[kradius] * from[x];
+    for (int k = 1; k <= kradius; k++)
+      sum += kernel[kradius-k] * (BorderValue(from, len, x-k, wrap) +
+                                  sign * BorderValue(from, len, x+k, wrap));
+    to[x] = sum;
   }
-  else
-  {
-    int x=0;
-    for (int xx = 0; x < xlo; ++x, ++xx) {
-      sum = kernel[kradius] * pipeline[xx];
-      for (int k = 1; k <= kradius; k++)
-        sum += kernel[kradius-k] * (pipeline[xx-k] - pipeline[xx+k]);
-      to[x] = sum;
-    }
-    for ( ; x < xhi; x++) {
-      sum = kernel[kradius] * from[x];
-      for (int k = 1; k <= kradius; k++)
-        sum += kernel[kradius-k] * (pipeline[kradius-k] - // minus for
-                                    pipeline[kradius+k]); // antisymmetric
-      to[x] = sum;
-      if (p < len) {
-        for (int k = 0; k < kborder; k++)   // shift the floats of
-          pipeline[k] = pipeline[k+1];  // the pipeline by 1
-        pipeline[kborder] = from[p++];  // update pipeline
-      }
-    }
-    for (int xx = kradius+1; x < len; x++, xx++) {
-      sum = kernel[kradius] * pipeline[xx];
-      for (int k = 1; k <= kradius; k++)
-        sum += kernel[kradius-k] * (pipeline[xx-k] - pipeline[xx+k]);
-      to[x] = sum;
-    }
+
+  // Convolution along x inside, with the kernel centered on from[x]
+  if (xhi > xlo) {
+    const float** lines = new const float*[2*kradius+1];
+    for (int k = -kradius; k <= kradius; k++)
+      lines[kradius+k] = from + xlo + k;
+    ConvolveLines(to + xlo, lines + kradius, xhi - xlo, kernel, kradius, evenp);
+    delete[] lines;
   }
-  delete[] cache;
   if (overwrite) {
-    for (int x=0 ; x < len; ++x) t[x] = to[x];
+    for (int x=0 ; x < len; ++x) orig[x] = to[x];
     delete[] to;
-    to = t;
+    to = orig;
   }
   return 1;                     // assume normalized kernel
 }
@@ -583,8 +544,8 @@ gevd_float_operators::RunningSum(float* from, float*& to, const int len,
   const int xlo = kradius, xhi = len - kradius;
   const int kborder = 2*kradius;
   float *cache, *pipeline;
-  int p = gevd_float_operators::SetupPipeline(from, len, kradius, wrap,
-                                              cache, pipeline);
+  gevd_float_operators::SetupPipeline(from, len, kradius, wrap,
+                                      cache, pipeline);
   // Running sum along x with above pipeline
   int x = 0, xx = 0;
   float sum = pipeline[x];      // pre-compute running sum
@@ -595,14 +556,17 @@ gevd_float_operators::RunningSum(float* from, float*& to, const int len,
     sum += pipeline[xx+kradius] - pipeline[xx-kradius-1];
     to[x] = sum;
   }
-  for ( ; x < xhi; x++) {
-    sum += pipeline[kborder] - pipeline[-1];
+  if (x < xhi) {
+    sum += pipeline[kborder] - pipeline[-1]; // from[-1] is reflected/wrapped
     to[x] = sum;
-    if (p < len) {
-      for (int k = -1; k < kborder; k++)    // shift the floats of
-        pipeline[k] = pipeline[k+1];    // the pipeline by 1
-      pipeline[kborder] = from[p++];    // update pipeline
+    for (x++; x < xhi; x++) {   // no need to shift the pipeline inside
+      sum += from[x+kradius] - from[x-kradius-1];
+      to[x] = sum;
     }
+    const int shift = xhi - xlo - 1; // the pipeline was shifted by 1
+    if (shift > 0)                   // after each x but the last
+      for (int k = -1; k <= kborder; k++)
+        pipeline[k] = from[k+shift];
   }
   for ( ; x < len; x++, xx++) {
     sum += pipeline[xx+kradius] - pipeline[xx-kradius-1];
@@ -665,7 +629,7 @@ gevd_float_operators::Gaussian(gevd_bufferxy& from, gevd_bufferxy*& to, const fl
   float* kernel = VXL_NULLPTR;
   int radius = 0;
   if (!gevd_float_operators::Find1dGaussianKernel(sigma, kernel, radius)) {
-    to = gevd_float_operators::Allocate(to, from);
+    to = gevd_float_operators::Allocate(to, from, 0, 0, 0, HasAlignedRows(from));
     if (to != &from)
       gevd_float_operators::Update(*to, from); // just a copy, no smoothing needed
   }
@@ -779,17 +743,46 @@ gevd_float_operators::WrapAlongY(const gevd_bufferxy& img)
   return wrap;
 }
 
+// Rows j-1, j, j+1 of a float buffer, for the 3x3 window operators
+struct gevd_rows3
+{
+  const float *up, *mid, *down;
+  gevd_rows3(const gevd_bufferxy& buf, const int j)
+    : up((const float*)buf.GetRow(j-1)), mid((const float*)buf.GetRow(j)),
+      down((const float*)buf.GetRow(j+1)) {}
+};
+
 // Local gradient magnitude and direction in 3x3 window
 
 inline void
-LocalGradient(const gevd_bufferxy& smooth, const int i, const int j,
+LocalGradient(const gevd_rows3& s, const int i,
               float& mag, float& gx, float& gy)
 {
-  gx = floatPixel(smooth, i+1, j) - floatPixel(smooth, i-1, j);
-  gy = floatPixel(smooth, i, j+1) - floatPixel(smooth, i, j-1);
+  gx = s.mid[i+1] - s.mid[i-1];
+  gy = s.down[i] - s.up[i];
   mag = std::sqrt(gx*gx + gy*gy);
 }
 
+//: Gradient at pixels [lo, hi) of row j, vectorized with SSE2 when available.
+static void
+GradientRow(const gevd_bufferxy& smooth, const int j, const int lo, const int hi,
+            float* mag, float* gx, float* gy)
+{
+  const gevd_rows3 s(smooth, j);
+  int i = lo;
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+  for (; i+4 <= hi; i += 4) {
+    __m128 dx = _mm_sub_ps(_mm_loadu_ps(s.mid+i+1), _mm_loadu_ps(s.mid+i-1));
+    __m128 dy = _mm_sub_ps(_mm_loadu_ps(s.down+i), _mm_loadu_ps(s.up+i));
+    _mm_storeu_ps(gx+i, dx);
+    _mm_storeu_ps(gy+i, dy);
+    _mm_storeu_ps(mag+i, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy))));
+  }
+#endif
+  for (; i < hi; ++i)
+    LocalGradient(s, i, mag[i], gx[i], gy[i]);
+}
+
 //: Compute the gradient of the intensity surface.
 // O(m*n).
 // The intensity surface is assumed smoothed by a Gaussian filter,
@@ -814,31 +807,30 @@ gevd_float_operators::Gradient(const gevd_bufferxy& smooth,
   vul_timer t;
   std::cout << "Compute local gradient magnitude/direction";
 #endif
-  magnitude = gevd_float_operators::Allocate(magnitude, smooth);
-  gradx = gevd_float_operators::Allocate(gradx, smooth);
-  grady = gevd_float_operators::Allocate(grady, smooth);
+  magnitude = gevd_float_operators::Allocate(magnitude, smooth, 0, 0, 0, HasAlignedRows(smooth));
+  gradx = gevd_float_operators::Allocate(gradx, smooth, 0, 0, 0, HasAlignedRows(smooth));
+  grady = gevd_float_operators::Allocate(grady, smooth, 0, 0, 0, HasAlignedRows(smooth));
 
   // 1. Inside image frame, compute values based on 3x3 window.
   const int frame = 1;
   const int highx = smooth.GetSizeX() - frame; // exclusive bounds
   const int highy = smooth.GetSizeY() - frame;
   for (int j = frame; j < highy; ++j)
-    for (int i = frame; i < highx; ++i)
-      LocalGradient(smooth, i, j,
-                    floatPixel(*magnitude, i, j),
-                    floatPixel(*gradx, i, j),
-                    floatPixel(*grady, i, j));
+    GradientRow(smooth, j, frame, highx,
+                (float*)magnitude->GetRow(j),
+                (float*)gradx->GetRow(j),
+                (float*)grady->GetRow(j));
 
   // 2. Along horizontal/vertical borders
   if (xwrap) {                  //  each row wrap at border
     const int lo = 2, hi = 1;
     gevd_bufferxy* pad = gevd_float_operators::WrapAlongX(smooth);
     for (int j = 1; j < highy; ++j) {
-      LocalGradient(*pad, lo, j,
+      LocalGradient(gevd_rows3(*pad, j), lo,
                     floatPixel(*magnitude, 0, j),
                     floatPixel(*gradx, 0, j),
                     floatPixel(*grady, 0, j));
-      LocalGradient(*pad, hi, j,
+      LocalGradient(gevd_rows3(*pad, j), hi,
                     floatPixel(*magnitude, highx, j),
                     floatPixel(*gradx, highx, j),
                     floatPixel(*grady, highx, j));
@@ -854,11 +846,11 @@ gevd_float_operators::Gradient(const gevd_bufferxy& smooth,
     const int lo = 2, hi = 1;
     gevd_bufferxy* pad = gevd_float_operators::WrapAlongY(smooth);
     for (int i = 1; i < highx; ++i) {
-      LocalGradient(*pad, i, lo,
+      LocalGradient(gevd_rows3(*pad, lo), i,
                     floatPixel(*magnitude, i, 0),
                     floatPixel(*gradx, i, 0),
                     floatPixel(*grady, i, 0));
-      LocalGradient(*pad, i, hi,
+      LocalGradient(gevd_rows3(*pad, hi), i,
                     floatPixel(*magnitude, i, highy),
                     floatPixel(*gradx, i, highy),
                     floatPixel(*grady, i, highy));
@@ -913,17 +905,17 @@ gevd_float_operators::Slope(float* from, float*& to, const int len,
 // corresponding to largest eigenvalue, in absolute magnitude.
 // Encode the sign of the curvature in the angle (dirx, diry).
 
-void
-LocalHessian(const gevd_bufferxy& smooth, const int i, const int j,
+static void
+LocalHessian(const gevd_rows3& s, const int i,
              float& mag, float& dirx, float& diry)
 {
-  float two_pij = 2 * floatPixel(smooth, i, j);
-  float ddx = floatPixel(smooth, i+1, j) + floatPixel(smooth, i-1, j) - two_pij;
-  float ddy = floatPixel(smooth, i, j+1) + floatPixel(smooth, i, j-1) - two_pij;
-  float two_dxdy = (floatPixel(smooth, i+1, j+1) +
-                    floatPixel(smooth, i-1, j-1) -
-                    floatPixel(smooth, i-1, j+1) -
-                    floatPixel(smooth, i+1, j-1)) / 2;
+  float two_pij = 2 * s.mid[i];
+  float ddx = s.mid[i+1] + s.mid[i-1] - two_pij;
+  float ddy = s.down[i] + s.up[i] - two_pij;
+  float two_dxdy = (s.down[i+1] +
+                    s.up[i-1] -
+                    s.down[i-1] -
+                    s.up[i+1]) / 2;
   float ddx_plus_ddy = ddx + ddy;
   float ddx_minus_ddy = ddx - ddy;
   float theta = (two_dxdy==0 && ddx_minus_ddy==0) ? 0 : // DOMAIN cond. on atan2
@@ -963,31 +955,33 @@ gevd_float_operators::Hessian(const gevd_bufferxy& smooth,
   vul_timer t;
   std::cout << "Compute local Hessian magnitude/direction";
 #endif
-  magnitude = gevd_float_operators::Allocate(magnitude, smooth);
-  dirx = gevd_float_operators::Allocate(dirx, smooth);
-  diry = gevd_float_operators::Allocate(diry, smooth);
+  magnitude = gevd_float_operators::Allocate(magnitude, smooth, 0, 0, 0, HasAlignedRows(smooth));
+  dirx = gevd_float_operators::Allocate(dirx, smooth, 0, 0, 0, HasAlignedRows(smooth));
+  diry = gevd_float_operators::Allocate(diry, smooth, 0, 0, 0, HasAlignedRows(smooth));
 
   // 1. Inside image frame, compute values based on 3x3 window.
   const int frame = 1;
   const int highx = smooth.GetSizeX() - frame;  // exclusive bounds
   const int highy = smooth.GetSizeY() - frame;
-  for (int j = frame; j < highy; ++j)
+  for (int j = frame; j < highy; ++j) {
+    const gevd_rows3 s(smooth, j);
+    float* m = (float*)magnitude->GetRow(j);
+    float* dx = (float*)dirx->GetRow(j);
+    float* dy = (float*)diry->GetRow(j);
     for (int i = frame; i < highx; ++i)
-      LocalHessian(smooth, i, j,
-                   floatPixel(*magnitude, i, j),
-                   floatPixel(*dirx, i, j),
-                   floatPixel(*diry, i, j));
+      LocalHessian(s, i, m[i], dx[i], dy[i]);
+  }
 
   // 2. Along horizontal/vertical borders
   if (xwrap) {                  //  each row wrap at border
     const int lo = 2, hi = 1;
     gevd_bufferxy* pad = gevd_float_operators::WrapAlongX(smooth);
     for (int j = 1; j < highy; ++j) {
-      LocalHessian(*pad, lo, j,
+      LocalHessian(gevd_rows3(*pad, j), lo,
                    floatPixel(*magnitude, 0, j),
                    floatPixel(*dirx, 0, j),
                    floatPixel(*diry, 0, j));
-      LocalHessian(*pad, hi, j,
+      LocalHessian(gevd_rows3(*pad, j), hi,
                    floatPixel(*magnitude, highx, j),
                    floatPixel(*dirx, highx, j),
                    floatPixel(*diry, highx, j));
@@ -1003,11 +997,11 @@ gevd_float_operators::Hessian(const gevd_bufferxy& smooth,
     const int lo = 2, hi = 1;
     gevd_bufferxy* pad = gevd_float_operators::WrapAlongY(smooth);
     for (int i = 1; i < highx; ++i) {
-      LocalHessian(*pad, i, lo,
+      LocalHessian(gevd_rows3(*pad, lo), i,
                    floatPixel(*magnitude, i, 0),
                    floatPixel(*dirx, i, 0),
                    floatPixel(*diry, i, 0));
-      LocalHessian(*pad, i, hi,
+      LocalHessian(gevd_rows3(*pad, hi), i,
                    floatPixel(*magnitude, i, highy),
                    floatPixel(*dirx, i, highy),
                    floatPixel(*diry, i, highy));
@@ -1028,15 +1022,15 @@ gevd_float_operators::Hessian(const gevd_bufferxy& smooth,
 // Local Laplacian in 3x3 neighborhood, sum of curvature,
 // and eigenvector corresponding to largest absolute eigenvalue.
 
-void
-LocalLaplacian(const gevd_bufferxy& smooth, const int i, const int j,
+static void
+LocalLaplacian(const gevd_rows3& s, const int i,
                float& mag, float& dirx, float& diry)
 {
-  float two_pij = 2 * floatPixel(smooth, i, j);
-  float ddx = floatPixel(smooth, i+1, j) + floatPixel(smooth, i-1, j) - two_pij;
-  float ddy = floatPixel(smooth, i, j+1) + floatPixel(smooth, i, j-1) - two_pij;
-  float diag1 = floatPixel(smooth, i+1, j+1) + floatPixel(smooth, i-1, j-1);
-  float diag2 = floatPixel(smooth, i-1, j+1) + floatPixel(smooth, i+1, j-1);
+  float two_pij = 2 * s.mid[i];
+  float ddx = s.mid[i+1] + s.mid[i-1] - two_pij;
+  float ddy = s.down[i] + s.up[i] - two_pij;
+  float diag1 = s.down[i+1] + s.up[i-1];
+  float diag2 = s.down[i-1] + s.up[i+1];
   mag = 4*(ddx + ddy) - 2*two_pij + diag1 + diag2; // save division by 6
 #if 0 // commented out
   mag = (floatPixel(smooth, i+1, j+1) + floatPixel(smooth, i-1, j-1) +
@@ -1076,31 +1070,33 @@ gevd_float_operators::Laplacian(const gevd_bufferxy& smooth,
   vul_timer t;
   std::cout << "Compute local Laplacian magnitude/direction";
 #endif
-  magnitude = gevd_float_operators::Allocate(magnitude, smooth);
-  dirx = gevd_float_operators::Allocate(dirx, smooth);
-  diry = gevd_float_operators::Allocate(diry, smooth);
+  magnitude = gevd_float_operators::Allocate(magnitude, smooth, 0, 0, 0, HasAlignedRows(smooth));
+  dirx = gevd_float_operators::Allocate(dirx, smooth, 0, 0, 0, HasAlignedRows(smooth));
+  diry = gevd_float_operators::Allocate(diry, smooth, 0, 0, 0, HasAlignedRows(smooth));
 
   // 1. Inside image frame, compute values based on 3x3 window.
   const int frame = 1;
   const int highx = smooth.GetSizeX() - frame;// exclusive bounds
   const int highy = smooth.GetSizeY() - frame;
-  for (int j = frame; j < highy; ++j)
+  for (int j = frame; j < highy; ++j) {
+    const gevd_rows3 s(smooth, j);
+    float* m = (float*)magnitude->GetRow(j);
+    float* dx = (float*)dirx->GetRow(j);
+    float* dy = (float*)diry->GetRow(j);
     for (int i = frame; i < highx; ++i)
-      LocalLaplacian(smooth, i, j,
-                     floatPixel(*magnitude, i, j),
-                     floatPixel(*dirx, i, j),
-                     floatPixel(*diry, i, j));
+      LocalLaplacian(s, i, m[i], dx[i], dy[i]);
+  }
 
   // 2. Along horizontal/vertical borders
   if (xwrap) {                  //  each row wrap at border
     const int lo = 2, hi = 1;
     gevd_bufferxy* pad = gevd_float_operators::WrapAlongX(smooth);
     for (int j = 1; j < highy; ++j) {
-      LocalLaplacian(*pad, lo, j,
+      LocalLaplacian(gevd_rows3(*pad, j), lo,
                      floatPixel(*magnitude, 0, j),
                      floatPixel(*dirx, 0, j),
                      floatPixel(*diry, 0, j));
-      LocalLaplacian(*pad, hi, j,
+      LocalLaplacian(gevd_rows3(*pad, j), hi,
                      floatPixel(*magnitude, highx, j),
                      floatPixel(*dirx, highx, j),
                      floatPixel(*diry, highx, j));
@@ -1116,11 +1112,11 @@ gevd_float_operators::Laplacian(const gevd_bufferxy& smooth,
     const int lo = 2, hi = 1;
     gevd_bufferxy* pad = gevd_float_operators::WrapAlongY(smooth);
     for (int i = 1; i < highx; ++i) {
-      LocalLaplacian(*pad, i, lo,
+      LocalLaplacian(gevd_rows3(*pad, lo), i,
                      floatPixel(*magnitude, i, 0),
                      floatPixel(*dirx, i, 0),
                      floatPixel(*diry, i, 0));
-      LocalLaplacian(*pad, i, hi,
+      LocalLaplacian(gevd_rows3(*pad, hi), i,
                      floatPixel(*magnitude, i, highy),
                      floatPixel(*dirx, i, highy),
                      floatPixel(*diry, i, highy));
@@ -3033,14 +3029,20 @@ gevd_float_operators::WaveletTransformByIndex(const gevd_bufferxy& from, gevd_bu
                                               const int waveletno)
 {
   to = gevd_float_operators::Allocate(to, from);
+  if (!to->IsContiguous()) {    // the transform needs a plain 2d array
+    delete to;
+    to = new gevd_bufferxy(from.GetSizeX(), from.GetSizeY(), from.GetBitsPixel());
+  }
   int dims[3];
   dims[0] = to->GetSizeY();
   dims[1] = to->GetSizeX();
   dims[2] = dims[0] * dims[1];
-  const float* from_array = (const float*) from.GetBuffer(); // copy the image
   float* to_array = (float*) to->GetBuffer();
-  for (int i = 0; i < dims[2]; i++)
-    to_array[i] = from_array[i];
+  for (int y = 0; y < from.GetSizeY(); y++) { // copy the image
+    const float* from_row = (const float*) from.GetRow(y);
+    for (int x = 0; x < from.GetSizeX(); x++)
+      to_array[y*dims[1]+x] = from_row[x];
+  }
   return gevd_float_operators::WaveletTransformByIndex(to_array, // transform in place
                                                        dims, 2,
                                                        forwardp, nlevels,
@@ -3060,14 +3062,20 @@ gevd_float_operators::WaveletTransformByBlock(const gevd_bufferxy& from, gevd_bu
                                               const int waveletno)
 {
   to = gevd_float_operators::Allocate(to, from);
+  if (!to->IsContiguous()) {    // the transform needs a plain 2d array
+    delete to;
+    to = new gevd_bufferxy(from.GetSizeX(), from.GetSizeY(), from.GetBitsPixel());
+  }
   int dims[3];
   dims[0] = to->GetSizeY();
   dims[1] = to->GetSizeX();
   dims[2] = dims[0] * dims[1];
-  const float* from_array = (const float*) from.GetBuffer(); // copy the image
   float* to_array = (float*) to->GetBuffer();
-  for (int i = 0; i < dims[2]; i++)
-    to_array[i] = from_array[i];
+  for (int y = 0; y < from.GetSizeY(); y++) { // copy the image
+    const float* from_row = (const float*) from.GetRow(y);
+    for (int x = 0; x < from.GetSizeX(); x++)
+      to_array[y*dims[1]+x] = from_row[x];
+  }
   return gevd_float_operators::WaveletTransformByBlock(to_array, // transform in place
                                                        dims, 2,
                                                        forwardp, nlevels,
@@ -3509,18 +3517,23 @@ gevd_float_operators::CoarseFineCorrelation(const float* dataPyr, const int dlen
 void
 gevd_float_operators::Apply(gevd_bufferxy& buf, float (*func)(float))
 {
-  int size = buf.GetSizeX() * buf.GetSizeY();
-  float* data = (float*) buf.GetBuffer();
-  for (int i = 1; i < size; i++)
-    data[i] = func(data[i]);
+  const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
+  for (int y = 0; y < sizeY; y++) {
+    float* data = (float*) buf.GetRow(y);
+    for (int i = 0; i < sizeX; i++)
+      data[i] = func(data[i]);
+  }
 }
 
 
 //: Allocate new space if desired depth and sizes are not the same.
+// New buffers have contiguous rows unless aligned_rows is set; the layout
+// of the model is not copied.  An existing buffer is reused whatever its layout.
 
 gevd_bufferxy*
 gevd_float_operators::Allocate(gevd_bufferxy* space, const gevd_bufferxy& model,
-                               int bits_per_pixel, int sizeX, int sizeY)
+                               int bits_per_pixel, int sizeX, int sizeY,
+                               bool aligned_rows)
 {
   if (!bits_per_pixel)          // find defaults from model
     bits_per_pixel = model.GetBitsPixel();
@@ -3532,17 +3545,20 @@ gevd_float_operators::Allocate(gevd_bufferxy* space, const gevd_bufferxy& model,
       space->GetBitsPixel() != bits_per_pixel ||
       space->GetSizeX() < sizeX || space->GetSizeY() < sizeY) {
     delete space;
-    space = new gevd_bufferxy(sizeX, sizeY, bits_per_pixel);
+    space = new gevd_bufferxy(sizeX, sizeY, bits_per_pixel,
+                              aligned_rows ? gevd_bufferxy::ALIGNED_ROWS : gevd_bufferxy::CONTIGUOUS_ROWS);
   }
   return space;
 }
 
 //: Creates a new buffer similar to buf, unless dimension and precision are given.
+// The rows are contiguous unless aligned_rows is set, whatever the layout of buf.
 
 gevd_bufferxy*
 gevd_float_operators::SimilarBuffer(const gevd_bufferxy& buf,
                                     int bits_per_pixel,
-                                    int sizeX, int sizeY)
+                                    int sizeX, int sizeY,
+                                    bool aligned_rows)
 {
   if (bits_per_pixel == 0)                      // find default pixel
     bits_per_pixel = buf.GetBitsPixel();
@@ -3550,7 +3566,8 @@ gevd_float_operators::SimilarBuffer(const gevd_bufferxy& buf,
     sizeX = buf.GetSizeX();
   if (sizeY == 0)
     sizeY = buf.GetSizeY();
-  return new gevd_bufferxy(sizeX, sizeY, bits_per_pixel);
+  return new gevd_bufferxy(sizeX, sizeY, bits_per_pixel,
+                           aligned_rows ? gevd_bufferxy::ALIGNED_ROWS : gevd_bufferxy::CONTIGUOUS_ROWS);
 }
 
 
@@ -3759,22 +3776,26 @@ gevd_float_operators::Threshold(gevd_bufferxy& buf, float noise,
 void
 gevd_float_operators::Normalize(gevd_bufferxy& buf, const float lo, const float hi)
 {
-  int size = (buf.GetSizeX() * buf.GetSizeY());
-  float* data = (float*) buf.GetBuffer();
+  const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
   float flo, fhi, f;
-  flo = fhi = data[0];
-  for (int i = 1; i < size; i++) {
-    f = data[i];
-    if (f < flo) flo = f;
-    if (f > fhi) fhi = f;
+  flo = fhi = floatPixel(buf, 0, 0);
+  for (int y = 0; y < sizeY; y++) {
+    const float* data = (const float*) buf.GetRow(y);
+    for (int i = 0; i < sizeX; i++) {
+      f = data[i];
+      if (f < flo) flo = f;
+      if (f > fhi) fhi = f;
+    }
   }
   if (fhi == flo)
-    for (int i = 0; i < size; i++)
-      data[i] = lo;
+    gevd_float_operators::Fill(buf, lo);
   else {
     float scale = (hi - lo) / (fhi - flo);
-    for (int i = 0; i < size; i++)
-      data[i] = scale * (data[i] - flo)  + lo;
+    for (int y = 0; y < sizeY; y++) {
+      float* data = (float*) buf.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        data[i] = scale * (data[i] - flo)  + lo;
+    }
   }
 }
 
@@ -3785,15 +3806,17 @@ void
 gevd_float_operators::ShiftToPositive(gevd_bufferxy& buf)
 {
   const float zero = 30000, lo = 0, hi = 60000;
-  int size = (buf.GetSizeX() * buf.GetSizeY());
-  float* data = (float*) buf.GetBuffer();
-  for (int i = 0; i < size; i++) {
-    float f = data[i] + zero;
-    if (f < lo)
-      f = lo;
-    else if (f > hi)
-      f = hi;
-    data[i] = f;
+  const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
+  for (int y = 0; y < sizeY; y++) {
+    float* data = (float*) buf.GetRow(y);
+    for (int i = 0; i < sizeX; i++) {
+      float f = data[i] + zero;
+      if (f < lo)
+        f = lo;
+      else if (f > hi)
+        f = hi;
+      data[i] = f;
+    }
   }
 }
 
@@ -3803,15 +3826,17 @@ gevd_float_operators::ShiftToPositive(gevd_bufferxy& buf)
 float
 gevd_float_operators::TruncateToPositive(gevd_bufferxy& buf)
 {
-  int size = (buf.GetSizeX() * buf.GetSizeY());
-  float* data = (float*) buf.GetBuffer();
+  const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
   float diff = 0, d;
-  for (int i = 0; i < size; i++) {
-    d = data[i];
-    if (d < 0) {
-      data[i] = 0;
-      d = - d;
-      if (d > diff) diff = d;
+  for (int y = 0; y < sizeY; y++) {
+    float* data = (float*) buf.GetRow(y);
+    for (int i = 0; i < sizeX; i++) {
+      d = data[i];
+      if (d < 0) {
+        data[i] = 0;
+        d = - d;
+        if (d > diff) diff = d;
+      }
     }
   }
   return diff;
@@ -3823,10 +3848,12 @@ void
 gevd_float_operators::Scale(gevd_bufferxy& buf, float factor)
 {
   if (factor != 0) {
-    int size = (buf.GetSizeX() * buf.GetSizeY());
-    float* data = (float*) buf.GetBuffer();
-    for (int i = 0; i < size; i++)
-      data[i] *= factor;
+    const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
+    for (int y = 0; y < sizeY; y++) {
+      float* data = (float*) buf.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        data[i] *= factor;
+    }
   }
 }
 
@@ -3835,11 +3862,13 @@ gevd_float_operators::Scale(gevd_bufferxy& buf, float factor)
 void
 gevd_float_operators::Absolute(gevd_bufferxy& buf)
 {
-  int size = (buf.GetSizeX() * buf.GetSizeY());
-  float* data = (float*) buf.GetBuffer();
-  for (int i = 0; i < size; i++)
-    if (data[i] < 0)
-      data[i] = - data[i];
+  const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
+  for (int y = 0; y < sizeY; y++) {
+    float* data = (float*) buf.GetRow(y);
+    for (int i = 0; i < sizeX; i++)
+      if (data[i] < 0)
+        data[i] = - data[i];
+  }
 }
 
 //: Negate all values.
@@ -3847,25 +3876,29 @@ gevd_float_operators::Absolute(gevd_bufferxy& buf)
 void
 gevd_float_operators::Negate(gevd_bufferxy& buf)
 {
-  int size = (buf.GetSizeX() * buf.GetSizeY());
-  float* data = (float*) buf.GetBuffer();
-  for (int i = 0; i < size; i++)
-    data[i] = - data[i];
+  const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
+  for (int y = 0; y < sizeY; y++) {
+    float* data = (float*) buf.GetRow(y);
+    for (int i = 0; i < sizeX; i++)
+      data[i] = - data[i];
+  }
 }
 
 
 float
 gevd_float_operators::TruncateToCeiling(gevd_bufferxy& buf, float ceilng)
 {
-  int size = (buf.GetSizeX() * buf.GetSizeY());
-  float* data = (float*) buf.GetBuffer();
+  const int sizeX = buf.GetSizeX(), sizeY = buf.GetSizeY();
   float diff = 0, d;
-  for (int i = 0; i < size; i++) {
-    d = data[i];
-    if (d > ceilng) {
-      data[i] = ceilng;
-      d -= ceilng;
-      if (d > diff) diff = d;
+  for (int y = 0; y < sizeY; y++) {
+    float* data = (float*) buf.GetRow(y);
+    for (int i = 0; i < sizeX; i++) {
+      d = data[i];
+      if (d > ceilng) {
+        data[i] = ceilng;
+        d -= ceilng;
+        if (d > diff) diff = d;
+      }
     }
   }
   return diff;
@@ -3883,36 +3916,44 @@ gevd_float_operators::BufferToFloat(const gevd_bufferxy& from, gevd_bufferxy& to
   assert (&to != &from);
   assert (from.GetSizeX() == to.GetSizeX() && from.GetSizeY() == to.GetSizeY());
   assert (to.GetBytesPixel() == sizeof(float));
-  int size = (to.GetSizeX() * to.GetSizeY());
+  const int sizeX = to.GetSizeX(), sizeY = to.GetSizeY();
   switch (from.GetBytesPixel())
   {
    case sizeof(unsigned char): {
-    const unsigned char* frombuf = (const unsigned char*) from.GetBuffer();
-    float* tobuf = (float*) to.GetBuffer();
-    for (int i = 0; i < size; i++)
-      tobuf[i] = (float) frombuf[i];
+    for (int y = 0; y < sizeY; y++) {
+      const unsigned char* frombuf = (const unsigned char*) from.GetRow(y);
+      float* tobuf = (float*) to.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        tobuf[i] = (float) frombuf[i];
+    }
     break;
    }
    case sizeof(short): {
-    const short* frombuf = (const short*) from.GetBuffer();
-    float* tobuf = (float*) to.GetBuffer();
-    for (int i = 0; i < size; i++)
-      tobuf[i] = (float) frombuf[i];
+    for (int y = 0; y < sizeY; y++) {
+      const short* frombuf = (const short*) from.GetRow(y);
+      float* tobuf = (float*) to.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        tobuf[i] = (float) frombuf[i];
+    }
     break;
    }
    case 3*sizeof(unsigned char): { // assume RGB, and take luminance
     std::cerr << "gevd_float_operators::BufferToFloat: taking luminance of RGB buffer\n";
-    const unsigned char* frombuf = (const unsigned char*) from.GetBuffer();
-    float* tobuf = (float*) to.GetBuffer();
-    for (int i = 0; i < size; i++)
-      tobuf[i] = 0.299f*frombuf[3*i]+0.587f*frombuf[3*i+1]+0.114f*frombuf[3*i+2];
+    for (int y = 0; y < sizeY; y++) {
+      const unsigned char* frombuf = (const unsigned char*) from.GetRow(y);
+      float* tobuf = (float*) to.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        tobuf[i] = 0.299f*frombuf[3*i]+0.587f*frombuf[3*i+1]+0.114f*frombuf[3*i+2];
+    }
     break;
    }
    case sizeof(int): {
-    const unsigned int* frombuf = (const unsigned int*) from.GetBuffer();
-    float* tobuf = (float*) to.GetBuffer();
-    for (int i = 0; i < size; i++)
-      tobuf[i] = (float)frombuf[i];
+    for (int y = 0; y < sizeY; y++) {
+      const unsigned int* frombuf = (const unsigned int*) from.GetRow(y);
+      float* tobuf = (float*) to.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        tobuf[i] = (float)frombuf[i];
+    }
     break;
    }
    default:
@@ -3928,28 +3969,34 @@ gevd_float_operators::FloatToBuffer (const gevd_bufferxy& from, gevd_bufferxy& t
   assert (&to != &from);
   assert (from.GetSizeX() == to.GetSizeX() && from.GetSizeY() == to.GetSizeY());
   assert (from.GetBytesPixel() == sizeof(float));
-  int size = (to.GetSizeX() * to.GetSizeY());
+  const int sizeX = to.GetSizeX(), sizeY = to.GetSizeY();
   switch (to.GetBytesPixel())
   {
    case sizeof(unsigned char): {
-    const float* frombuf = (const float*) from.GetBuffer();
-    unsigned char* tobuf = (unsigned char*) to.GetBuffer();
-    for (int i = 0; i < size; i++)
-      tobuf[i] = (unsigned char) int(frombuf[i]);
+    for (int y = 0; y < sizeY; y++) {
+      const float* frombuf = (const float*) from.GetRow(y);
+      unsigned char* tobuf = (unsigned char*) to.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        tobuf[i] = (unsigned char) int(frombuf[i]);
+    }
     return true;
    }
    case sizeof(short): {
-    const float* frombuf = (const float*) from.GetBuffer();
-    short* tobuf = (short*) to.GetBuffer();
-    for (int i = 0; i < size; i++)
-      tobuf[i] = (short) int(frombuf[i]);
+    for (int y = 0; y < sizeY; y++) {
+      const float* frombuf = (const float*) from.GetRow(y);
+      short* tobuf = (short*) to.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        tobuf[i] = (short) int(frombuf[i]);
+    }
     return true;
    }
    case 3*sizeof(unsigned char): { // assume RGB ==> restore luminance
-    const float* frombuf = (const float*) from.GetBuffer();
-    unsigned char* tobuf = (unsigned char*) to.GetBuffer();
-    for (int i = 0; i < size; i++)
-      tobuf[3*i] = tobuf[3*i+1] = tobuf[3*i+2] = (unsigned char) int(frombuf[i]);
+    for (int y = 0; y < sizeY; y++) {
+      const float* frombuf = (const float*) from.GetRow(y);
+      unsigned char* tobuf = (unsigned char*) to.GetRow(y);
+      for (int i = 0; i < sizeX; i++)
+        tobuf[3*i] = tobuf[3*i+1] = tobuf[3*i+2] = (unsigned char) int(frombuf[i]);
+    }
     return true;
    }
    default:
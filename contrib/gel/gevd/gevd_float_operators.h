@@ -264,10 +264,12 @@ class gevd_float_operators
 
   // utilities
   static gevd_bufferxy* Allocate(gevd_bufferxy* space, const gevd_bufferxy& model,
-                                 int bits_per_pixel=0, int sizeX=0, int sizeY=0);
+                                 int bits_per_pixel=0, int sizeX=0, int sizeY=0,
+                                 bool aligned_rows=false);
   static gevd_bufferxy* SimilarBuffer(const gevd_bufferxy& buffer, // use default
                                       int bits_per_pixel=0,// from buffer
-                                      int sizeX=0, int sizeY=0);
+                                      int sizeX=0, int sizeY=0,
+                                      bool aligned_rows=false);
   static bool IsSimilarBuffer(const gevd_bufferxy& buf1,    // same dimension
                               const gevd_bufferxy& buf2);       // & precision
   static gevd_bufferxy* Extract(const gevd_bufferxy& buf,
@@ -91,29 +91,59 @@ gevd_noise::~gevd_noise()
 float*
 gevd_noise::EdgelsInCenteredROI(const gevd_bufferxy& magnitude,
                                 const gevd_bufferxy& dirx, const gevd_bufferxy& diry,
-                                int& nedgel, const int
+                                int& nedgel, const int roiArea)
+{
+  nedgel = 0;
+  int xmin, xmax, ymin, ymax;
+  if (!gevd_noise::CenteredROI(magnitude.GetSizeX(), magnitude.GetSizeY(), roiArea,
+                               xmin, xmax, ymin, ymax))
+    return VXL_NULLPTR;
+  float* edgels = new float [(xmax-xmin)*(ymax-ymin)];
+  nedgel = gevd_noise::EdgelsInROI(magnitude, dirx, diry,
+                                   xmin, xmax, ymin, ymax, edgels);
+  return edgels;
+}
+
+//: Find the ROI at the center of an image of size sizeX x sizeY, used by EdgelsInCenteredROI.
+// Returns false if the image is smaller than the minimum ROI.
+
+bool
+gevd_noise::CenteredROI(const int sizeX, const int sizeY, const int
 #ifdef MINROI
-                                roiArea
+                        roiArea
 #endif
-                               )
+                        , int& xmin, int& xmax, int& ymin, int& ymax)
 {
-  nedgel = 0;
 #ifdef MINROI
-  int area = magnitude.GetSizeX() * magnitude.GetSizeY();
+  int area = sizeX * sizeY;
   if (area < roiArea) {
     std::cerr << "Image is smaller than minimum ROI\n";
-    return NULL;
+    return false;
   }
   float k = std::sqrt(float(roiArea) / area); // reduction factor
 #else
   float k = 1.0;
 #endif
-  const int sx = int(k*magnitude.GetSizeX()), sy = int(k*magnitude.GetSizeY());
-  float* edgels = new float [sx*sy];
-  const int xmin = (magnitude.GetSizeX() - sx) / 2;
-  const int xmax = xmin + sx;
-  const int ymin = (magnitude.GetSizeY() - sy) / 2;
-  const int ymax = ymin + sy;
+  const int sx = int(k*sizeX), sy = int(k*sizeY);
+  xmin = (sizeX - sx) / 2;
+  xmax = xmin + sx;
+  ymin = (sizeY - sy) / 2;
+  ymax = ymin + sy;
+  return true;
+}
+
+//: Collect the edgels above zero in rows [ymin,ymax) and columns [xmin,xmax), in row-major order.
+// The edgels array must have room for all pixels of the ROI.
+// Returns the number of edgels found.
+
+int
+gevd_noise::EdgelsInROI(const gevd_bufferxy& magnitude,
+                        const gevd_bufferxy& dirx, const gevd_bufferxy& diry,
+                        const int xmin, const int xmax,
+                        const int ymin, const int ymax,
+                        float* edgels)
+{
+  int nedgel = 0;
   for (int j = ymin; j < ymax; j++)
     for (int i = xmin; i < xmax; i++)
     {
@@ -158,7 +188,7 @@ gevd_noise::EdgelsInCenteredROI(const gevd_bufferxy& magnitude,
           edgels[nedgel++] = strength;
       }
     }
-  return edgels;
+  return nedgel;
 }
 
 //:
@@ -43,6 +43,14 @@ class gevd_noise
                                     const gevd_bufferxy& diry,
                                     int& nedgel,
                                     const int roiArea=250*250); // ROI
+  static bool CenteredROI(const int sizeX, const int sizeY, const int roiArea,
+                          int& xmin, int& xmax, int& ymin, int& ymax);
+  static int EdgelsInROI(const gevd_bufferxy& magnitude,
+                         const gevd_bufferxy& dirx,
+                         const gevd_bufferxy& diry,
+                         const int xmin, const int xmax, // columns [xmin,xmax)
+                         const int ymin, const int ymax, // rows [ymin,ymax)
+                         float* edgels);
   bool EstimateSensorTexture(float& sensor, // sensor noise is would-be zc
                              float& texture) const; // texture is real zc
 
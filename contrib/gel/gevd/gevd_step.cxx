@@ -1,6 +1,8 @@
 // This is gel/gevd/gevd_step.cxx
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include "gevd_step.h"
 //:
 // \file
@@ -26,6 +28,7 @@
 
 #include <vcl_compiler.h>
 #include <vnl/vnl_math.h>
+#include <vpl/vpl_parallel_for.h>
 #include <gevd/gevd_noise.h>
 #include <gevd/gevd_float_operators.h>
 #include <gevd/gevd_pixel.h>
@@ -82,7 +85,8 @@ gevd_step::gevd_step(float smooth_sigma, // width of filter dG
                      float contour_factor, float junction_factor)
   : smoothSigma(smooth_sigma), noiseSigma(noise_sigma),
     contourFactor(contour_factor), junctionFactor(junction_factor),
-    filterFactor(2)              // factor from gevd_float_operators::Gradient
+    filterFactor(2),             // factor from gevd_float_operators::Gradient
+    tileSize(0), numThreads(0)
 {
   if (smoothSigma < 0.5)        // no guarantee for 2-pixel separation
     std::cerr << "gevd_step::gevd_step -- too small smooth_sigma: "
@@ -134,8 +138,15 @@ gevd_step::DetectEdgels(const gevd_bufferxy& image,
 
   // -tpk @@ missing check if the requested buffer size is too small to contain the convolution operations
 
-  // 1. Smooth image to regularize data, before taking derivatives
-  gevd_bufferxy* smooth = VXL_NULLPTR;      // Gaussian smoothed image
+  if (tileSize > 0 && image.GetSizeY() > tileSize)
+    return this->DetectEdgelsTiled(image, contour, direction,
+                                   locationx, locationy, grad_mag, angle);
+
+  // 1. Smooth image to regularize data, before taking derivatives.
+  //    The smoothed image, and the buffers derived from it, have aligned
+  //    rows for the vectorized filters.
+  gevd_bufferxy* smooth = new gevd_bufferxy(image.GetSizeX(), image.GetSizeY(), // Gaussian smoothed image
+                                            bits_per_float, gevd_bufferxy::ALIGNED_ROWS);
   // use float to avoid overflow/truncation
   filterFactor = gevd_float_operators::Gaussian((gevd_bufferxy&)image, // well-condition before
                                                 smooth, smoothSigma); // 1st-difference
@@ -150,8 +161,8 @@ gevd_step::DetectEdgels(const gevd_bufferxy& image,
   //           directions later.  The angle definition here is consistent with
   //           EdgeDetector, i.e. angle = (180/M_PI)*std::atan2(dI/dy, dI/dx);
 
-  grad_mag = gevd_float_operators::SimilarBuffer(image);
-  angle = gevd_float_operators::SimilarBuffer(image);
+  grad_mag = gevd_float_operators::Allocate(grad_mag, image);
+  angle = gevd_float_operators::Allocate(angle, image);
   const double kdeg = vnl_math::deg_per_rad;
   for (int j = 0; j < image.GetSizeY(); j++)
     for (int i = 0; i < image.GetSizeX(); i++)
@@ -167,25 +178,8 @@ gevd_step::DetectEdgels(const gevd_bufferxy& image,
     int nedgel = 0;             // all edgels in ROI at center of image
     float* edgels = gevd_noise::EdgelsInCenteredROI(*slope, *dirx, *diry,
                                                     nedgel);
-    if ((edgels) && (nedgel > 0 )) {
-      gevd_noise noise(edgels, nedgel); // histogram of weak edgels only
-      delete [] edgels;
-      float sensorNoise, textureNoise;
-      if (noise.EstimateSensorTexture(sensorNoise, textureNoise)) {
-        const float k = -noiseSigma; // given linear interpolation factor
-        noiseSigma = ((1-k)*sensorNoise + k*textureNoise) /
-          NoiseResponseToFilter(1, smoothSigma, filterFactor);
-      }
-      else {
-        std::cout << "Can not estimate sensor & texture noise\n";
-        noiseSigma = 1;         // reasonable default for 8-bit
-      }
-    }
-    else {
-      std::cout << "Not enough edge elements to estimate noise\n";
-      noiseSigma = 1;
-    }
-    //std::cout << "Set noise sigma = " << noiseSigma << std::endl;
+    this->EstimateNoise(edgels, nedgel);
+    delete [] edgels;
   }
 
   // 4. Find contour pixels as local maxima along slope direction
@@ -220,6 +214,189 @@ gevd_step::DetectEdgels(const gevd_bufferxy& image,
   return true;
 }
 
+//: Set noiseSigma from the histogram of the weak step edgels found by gevd_noise::EdgelsInCenteredROI.
+void
+gevd_step::EstimateNoise(const float* edgels, int nedgel)
+{
+  if ((edgels) && (nedgel > 0 )) {
+    gevd_noise noise(edgels, nedgel); // histogram of weak edgels only
+    float sensorNoise, textureNoise;
+    if (noise.EstimateSensorTexture(sensorNoise, textureNoise)) {
+      const float k = -noiseSigma; // given linear interpolation factor
+      noiseSigma = ((1-k)*sensorNoise + k*textureNoise) /
+        NoiseResponseToFilter(1, smoothSigma, filterFactor);
+    }
+    else {
+      std::cout << "Can not estimate sensor & texture noise\n";
+      noiseSigma = 1;         // reasonable default for 8-bit
+    }
+  }
+  else {
+    std::cout << "Not enough edge elements to estimate noise\n";
+    noiseSigma = 1;
+  }
+  //std::cout << "Set noise sigma = " << noiseSigma << std::endl;
+}
+
+namespace
+{
+  //: Smoothing, gradient and non maximum suppression on the tiles of an image.
+  // Tile t covers rows [y0,y1) of the image; it is processed on rows
+  // [top,bot), which extend it by the support of the filters, and only
+  // rows [y0,y1) of the result are copied to the output buffers.
+  class step_tile_body : public vpl_parallel_for_body
+  {
+   public:
+    const gevd_bufferxy* image;
+    int tile_size, margin;
+    float smooth_sigma;
+    bool gradient_pass;         // fill grad_mag/angle
+    bool collect_edgels;        // collect weak edgels for the noise estimation
+    bool nms_pass;              // non maximum suppression with threshold
+    float threshold;
+    int roi_xmin, roi_xmax, roi_ymin, roi_ymax; // ROI of weak edgels
+    gevd_bufferxy *contour, *direction, *locationx, *locationy, *grad_mag, *angle;
+    std::vector<float> factors;
+    std::vector<std::vector<float> > edgels;
+
+    void rows(int t, int& y0, int& y1, int& top, int& bot) const
+    {
+      const int sizeY = image->GetSizeY();
+      y0 = t*tile_size;
+      y1 = std::min(sizeY, y0 + tile_size);
+      top = std::max(0, y0 - margin);
+      bot = std::min(sizeY, y1 + margin);
+      if (bot - top < 4*margin) // keep enough rows for the convolution
+        top = std::max(0, bot - 4*margin);
+    }
+
+    void execute(unsigned begin, unsigned end, unsigned /*thread_id*/)
+    {
+      for (unsigned t = begin; t < end; ++t)
+        this->process(t);
+    }
+
+    void process(int t)
+    {
+      int y0, y1, top, bot;
+      this->rows(t, y0, y1, top, bot);
+      const int sizeX = image->GetSizeX();
+      gevd_bufferxy* sub = gevd_float_operators::Extract(*image, sizeX, bot-top, 0, top);
+      gevd_bufferxy* smooth = new gevd_bufferxy(sizeX, bot-top, bits_per_float, gevd_bufferxy::ALIGNED_ROWS);
+      float factor = gevd_float_operators::Gaussian(*sub, smooth, smooth_sigma);
+      delete sub;
+      gevd_bufferxy *slope = VXL_NULLPTR, *dirx=VXL_NULLPTR, *diry=VXL_NULLPTR;
+      factor *= gevd_float_operators::Gradient(*smooth, slope, dirx, diry);
+      delete smooth;
+      factors[t] = factor;
+
+      if (gradient_pass) {
+        const double kdeg = vnl_math::deg_per_rad;
+        for (int j = y0; j < y1; j++)
+          for (int i = 0; i < sizeX; i++)
+            if ((floatPixel(*grad_mag, i, j) = floatPixel(*slope, i, j-top)))
+              floatPixel(*angle, i, j) = float(kdeg*std::atan2(floatPixel(*diry, i, j-top),
+                                                              floatPixel(*dirx, i, j-top)));
+            else
+              floatPixel(*angle, i, j) = 0;
+      }
+      if (gradient_pass && collect_edgels) {
+        const int ylo = std::max(y0, roi_ymin), yhi = std::min(y1, roi_ymax);
+        if (ylo < yhi) {
+          edgels[t].resize((yhi-ylo)*(roi_xmax-roi_xmin));
+          int n = gevd_noise::EdgelsInROI(*slope, *dirx, *diry, roi_xmin, roi_xmax,
+                                          ylo-top, yhi-top, &edgels[t][0]);
+          edgels[t].resize(n);
+        }
+      }
+
+      if (nms_pass) {
+        gevd_bufferxy *c = VXL_NULLPTR, *d = VXL_NULLPTR, *lx = VXL_NULLPTR, *ly = VXL_NULLPTR;
+        gevd_float_operators::NonMaximumSuppression(*slope, *dirx, *diry, threshold,
+                                                    c, d, lx, ly);
+        for (int j = y0; j < y1; j++)
+          for (int i = 0; i < sizeX; i++) {
+            floatPixel(*contour, i, j) = floatPixel(*c, i, j-top);
+            bytePixel(*direction, i, j) = bytePixel(*d, i, j-top);
+            floatPixel(*locationx, i, j) = floatPixel(*lx, i, j-top);
+            floatPixel(*locationy, i, j) = floatPixel(*ly, i, j-top);
+          }
+        delete c; delete d; delete lx; delete ly;
+      }
+      delete slope; delete dirx; delete diry;
+    }
+  };
+}
+
+//: DetectEdgels on tiles of tileSize rows, processed in parallel.
+// Each tile is extended by the radius of the Gaussian plus one row for the
+// gradient and one for non maximum suppression, so that its rows are computed
+// exactly as in the untiled detection.  If the noise has to be estimated, the
+// weak edgels of all tiles are needed before non maximum suppression, so the
+// smoothing and gradient of each tile are computed twice rather than keeping
+// full size gradient buffers.  The tiles are written to the full size output
+// buffers, so these are still allocated here unless the caller supplies them.
+bool
+gevd_step::DetectEdgelsTiled(const gevd_bufferxy& image,
+                             gevd_bufferxy*& contour, gevd_bufferxy*& direction,
+                             gevd_bufferxy*& locationx, gevd_bufferxy*& locationy,
+                             gevd_bufferxy*& grad_mag, gevd_bufferxy*& angle)
+{
+  float* kernel = VXL_NULLPTR;
+  int radius = 0;
+  if (gevd_float_operators::Find1dGaussianKernel(smoothSigma, kernel, radius))
+    delete [] kernel;
+
+  step_tile_body body;
+  body.image = &image;
+  body.margin = radius + 2;
+  body.tile_size = std::max(tileSize, 2*body.margin);
+  body.smooth_sigma = smoothSigma;
+  body.threshold = 0;
+  const int ntiles = (image.GetSizeY() + body.tile_size - 1) / body.tile_size;
+  body.factors.resize(ntiles, 1.0f);
+  body.edgels.resize(ntiles);
+  gevd_noise::CenteredROI(image.GetSizeX(), image.GetSizeY(), 250*250,
+                          body.roi_xmin, body.roi_xmax, body.roi_ymin, body.roi_ymax);
+
+  grad_mag = gevd_float_operators::Allocate(grad_mag, image);
+  angle = gevd_float_operators::Allocate(angle, image);
+  contour = gevd_float_operators::Allocate(contour, image);
+  direction = gevd_float_operators::Allocate(direction, image, bits_per_byte);
+  locationx = gevd_float_operators::Allocate(locationx, image);
+  locationy = gevd_float_operators::Allocate(locationy, image);
+  body.grad_mag = grad_mag; body.angle = angle;
+  body.contour = contour; body.direction = direction;
+  body.locationx = locationx; body.locationy = locationy;
+
+  // 1-3. Smooth, gradient and noise estimation
+  // With a given noise sigma the threshold is known beforehand, since
+  // filterFactor is the constant factor of the Gaussian and Gradient filters.
+  body.gradient_pass = true;
+  body.collect_edgels = noiseSigma <= 0;
+  body.nms_pass = !body.collect_edgels;
+  if (body.nms_pass)
+    body.threshold = NoiseThreshold();
+  vpl_parallel_for(ntiles, body, numThreads);
+  filterFactor = body.factors[0];
+  if (body.collect_edgels) {
+    std::vector<float> edgels;  // weak edgels in row-major order
+    for (int t = 0; t < ntiles; ++t)
+      edgels.insert(edgels.end(), body.edgels[t].begin(), body.edgels[t].end());
+    this->EstimateNoise(edgels.empty() ? VXL_NULLPTR : &edgels[0], (int)edgels.size());
+
+    // 4. Non maximum suppression, once the threshold is known
+    body.gradient_pass = false;
+    body.collect_edgels = false;
+    body.nms_pass = true;
+    body.threshold = NoiseThreshold();
+    vpl_parallel_for(ntiles, body, numThreads);
+  }
+  gevd_float_operators::FillFrameX(*contour, 0, FRAME); // erase pixels in frame border
+  gevd_float_operators::FillFrameY(*contour, 0, FRAME);
+  return true;
+}
+
 //:
 // Return -/+ PI/2, to encode the existence of an end point
 // on the left/right side of the current contour point i,j.
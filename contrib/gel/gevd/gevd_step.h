@@ -85,6 +85,20 @@ class gevd_step
                        gevd_bufferxy& locationx, gevd_bufferxy& locationy,
                        int*& junctionx, int*& junctiony);
 
+  //: Run DetectEdgels on horizontal tiles of tile_size rows, using num_threads threads.
+  // The tiles overlap by the support of the smoothing, gradient and non maximum
+  // suppression filters, so the result is identical to the untiled detection,
+  // while only the tiles being processed need smoothing/gradient buffers.
+  // The six output buffers still cover the whole image, so peak memory is
+  // O(image): 21 bytes per pixel plus the tiles, instead of 33 bytes per pixel
+  // for the untiled detection.
+  // Output buffers passed in that are large enough are reused rather than
+  // reallocated, so the caller can provide their storage.
+  // tile_size = 0 (the default) processes the whole image at once;
+  // num_threads = 0 uses one thread per processor.
+  void SetTiling(int tile_size, unsigned num_threads = 0)
+  { tileSize = tile_size; numThreads = num_threads; }
+
   float NoiseSigma() const;     //!< query stored/estimated noise sigma
   float NoiseResponse() const;  //!< response of noise sigma to filter ddG
   float NoiseThreshold(bool shortp=false) const; //!< elongated/directional?
@@ -101,6 +115,14 @@ class gevd_step
   float noiseSigma;                    //!< sensor/texture noise
   float contourFactor, junctionFactor; //!< threshold factor for edgels
   float filterFactor;                  //!< factor in convolution filter
+  int tileSize;                        //!< rows per tile, 0 if untiled
+  unsigned numThreads;                 //!< threads used for the tiles
+
+  bool DetectEdgelsTiled(const gevd_bufferxy& image,
+                         gevd_bufferxy*& edgels, gevd_bufferxy*& direction,
+                         gevd_bufferxy*& locationx, gevd_bufferxy*& locationy,
+                         gevd_bufferxy*& grad_mag, gevd_bufferxy*& angle);
+  void EstimateNoise(const float* edgels, int nedgel); //!< from weak edgels
 };
 
 #endif // gevd_step_h_
@@ -0,0 +1,100 @@
+//:
+// \file
+// \brief Timings of the gevd_float_operators filters used by the step and fold detectors
+//        Runs Gaussian smoothing, Gradient, Hessian, Laplacian and a full
+//        gevd_step edgel detection on a synthetic float image stored with
+//        contiguous and with aligned rows, and the 1d RunningSum, and reports
+//        the time per call.
+//        Usage: gevd_float_operators_timings [width [height [n_iterations]]]
+
+#include <iostream>
+#include <cstdlib>
+#include <gevd/gevd_float_operators.h>
+#include <gevd/gevd_bufferxy.h>
+#include <gevd/gevd_pixel.h>
+#include <gevd/gevd_step.h>
+#include <vnl/vnl_random.h>
+#include <vul/vul_timer.h>
+#include <vcl_compiler.h>
+
+static void report(char const* what, char const* layout, long msecs, unsigned iters)
+{
+  std::cout << what << " (" << layout << "): " << double(msecs)/iters << " ms\n";
+}
+
+static void time_filters(const gevd_bufferxy& image, char const* layout, unsigned iters)
+{
+  vul_timer timer;
+  gevd_bufferxy* smooth = VXL_NULLPTR;
+  for (unsigned t = 0; t < iters; ++t)
+    gevd_float_operators::Gaussian((gevd_bufferxy&)image, smooth, 1.0f);
+  report("Gaussian sigma 1", layout, timer.real(), iters);
+
+  timer.mark();
+  gevd_bufferxy* smooth3 = VXL_NULLPTR;
+  for (unsigned t = 0; t < iters; ++t)
+    gevd_float_operators::Gaussian((gevd_bufferxy&)image, smooth3, 3.0f);
+  report("Gaussian sigma 3", layout, timer.real(), iters);
+  delete smooth3;
+
+  gevd_bufferxy *mag = VXL_NULLPTR, *dirx = VXL_NULLPTR, *diry = VXL_NULLPTR;
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    gevd_float_operators::Gradient(*smooth, mag, dirx, diry);
+  report("Gradient", layout, timer.real(), iters);
+
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    gevd_float_operators::Hessian(*smooth, mag, dirx, diry);
+  report("Hessian", layout, timer.real(), iters);
+
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t)
+    gevd_float_operators::Laplacian(*smooth, mag, dirx, diry);
+  report("Laplacian", layout, timer.real(), iters);
+  delete mag; delete dirx; delete diry;
+  delete smooth;
+
+  timer.mark();
+  for (unsigned t = 0; t < iters; ++t) {
+    gevd_bufferxy *contour = VXL_NULLPTR, *direction = VXL_NULLPTR, *locx = VXL_NULLPTR,
+                  *locy = VXL_NULLPTR, *grad_mag = VXL_NULLPTR, *angle = VXL_NULLPTR;
+    gevd_step step(1.0f, -0.5f, 1.0f, 1.5f);
+    step.DetectEdgels(image, contour, direction, locx, locy, grad_mag, angle);
+    delete contour; delete direction; delete locx; delete locy; delete grad_mag; delete angle;
+  }
+  report("gevd_step::DetectEdgels", layout, timer.real(), iters);
+}
+
+int main(int argc, char* argv[])
+{
+  int sx = argc > 1 ? std::atoi(argv[1]) : 1024;
+  int sy = argc > 2 ? std::atoi(argv[2]) : 768;
+  unsigned iters = argc > 3 ? std::atoi(argv[3]) : 20;
+  std::cout << "image " << sx << 'x' << sy << ", " << iters << " iterations\n";
+
+  vnl_random rng(1234);
+  gevd_bufferxy image(sx, sy, bits_per_float);
+  gevd_bufferxy aimage(sx, sy, bits_per_float, gevd_bufferxy::ALIGNED_ROWS);
+  for (int j = 0; j < sy; ++j)
+    for (int i = 0; i < sx; ++i)
+      floatPixel(image, i, j) = floatPixel(aimage, i, j) =
+        float(((i/32 + j/32) % 2) * 100 + rng.normal() * 5.0);
+
+  time_filters(image, "contiguous rows", iters);
+  time_filters(aimage, "aligned rows", iters);
+
+  // 1d running sum, as used for the noise histograms
+  const int len = sx*sy;
+  float* data = new float[len];
+  float* sum = VXL_NULLPTR;
+  for (int i = 0; i < len; ++i)
+    data[i] = float(rng.drand32());
+  vul_timer timer;
+  for (unsigned t = 0; t < iters; ++t)
+    gevd_float_operators::RunningSum(data, sum, len, 5);
+  std::cout << "RunningSum radius 5: " << double(timer.real())/iters << " ms\n";
+  delete[] sum;
+  delete[] data;
+  return 0;
+}
@@ -5,6 +5,7 @@ DECLARE(test_gevd_float_operators);
 DECLARE(test_gevd_memory_mixin);
 DECLARE(test_gevd_noise);
 DECLARE(test_gevd_param_mixin);
+DECLARE(test_gevd_step);
 
 void
 register_tests()
@@ -14,6 +15,7 @@ register_tests()
   REGISTER(test_gevd_memory_mixin);
   REGISTER(test_gevd_noise);
   REGISTER(test_gevd_param_mixin);
+  REGISTER(test_gevd_step);
 }
 
 DEFINE_MAIN;
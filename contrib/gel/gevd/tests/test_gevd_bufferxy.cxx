@@ -2,6 +2,7 @@
 // Description: Test gevd_bufferxy class
 
 #include <iostream>
+#include <cstddef>
 #include <cstring>
 #include <vcl_compiler.h>
 #include <vpl/vpl.h>
@@ -72,6 +73,33 @@ test_gevd_bufferxy()
   delete gbxy1;
   delete gbxy2;
   delete gbxy3;
+
+  // test the aligned row layout
+  gevd_bufferxy abuf(13,5,32,gevd_bufferxy::ALIGNED_ROWS);
+  TEST("GetSizeX aligned", abuf.GetSizeX(), 13);
+  TEST("GetRowStride aligned", abuf.GetRowStride(), 64);
+  TEST("IsContiguous aligned", abuf.IsContiguous(), false);
+  bool aligned = true;
+  for (int j=0; j<5; ++j)
+    if (reinterpret_cast<std::size_t>(abuf.GetRow(j)) % gevd_bufferxy::ROW_ALIGNMENT != 0 ||
+        abuf.GetRow(j) != abuf.GetElementAddr(0,j))
+      aligned = false;
+  TEST("Rows aligned", aligned, true);
+  TEST("GetBuffer is first row", abuf.GetBuffer() == abuf.GetRow(0), true);
+  for (int j=0; j<5; ++j)
+    for (int i=0; i<13; ++i)
+      *(float*)abuf.GetElementAddr(i,j) = float(100*j+i);
+  gevd_bufferxy acopy(abuf);
+  bool same = acopy.GetRowLayout() == gevd_bufferxy::ALIGNED_ROWS;
+  for (int j=0; j<5; ++j)
+    for (int i=0; i<13; ++i)
+      if (*(float*)acopy.GetElementAddr(i,j) != float(100*j+i))
+        same = false;
+  TEST("Copy of aligned buffer", same, true);
+  gevd_bufferxy cbuf(13,5,32);
+  TEST("GetRowStride contiguous", cbuf.GetRowStride(), 52);
+  TEST("IsContiguous contiguous", cbuf.IsContiguous(), true);
+
   std::cout << "Test vil buffer constructor\n";
 
   // Test vil buffer constructor
@@ -68,6 +68,56 @@ test_gevd_float_operators()
     TEST_("CorrelationAlongAxis", i,j, 0.f);
   }
   delete buf_out;
+
+  // Same results with aligned, padded rows as with contiguous rows,
+  // on a width that is not a multiple of the vector size
+  gevd_bufferxy img(37,23,32), aimg(37,23,32,gevd_bufferxy::ALIGNED_ROWS);
+  for (int j=0; j<23; ++j)
+    for (int i=0; i<37; ++i)
+      *(float*)img.GetElementAddr(i,j) = *(float*)aimg.GetElementAddr(i,j) = float((i*7+j*13)%17) + (i>18 ? 20.f : 0.f);
+  gevd_bufferxy *smooth=VXL_NULLPTR, *asmooth=VXL_NULLPTR;
+  gevd_float_operators::Gaussian(img, smooth, 1.2f);
+  gevd_float_operators::Gaussian(aimg, asmooth, 1.2f);
+  TEST("Gaussian keeps the row layout", asmooth->GetRowLayout(), gevd_bufferxy::ALIGNED_ROWS);
+  gevd_bufferxy *amag=VXL_NULLPTR, *adirx=VXL_NULLPTR, *adiry=VXL_NULLPTR;
+  buf_mag = buf_dirx = buf_diry = VXL_NULLPTR;
+  gevd_float_operators::Gradient(*smooth, buf_mag, buf_dirx, buf_diry);
+  gevd_float_operators::Gradient(*asmooth, amag, adirx, adiry);
+  int ndiff = 0;
+  for (int j=0; j<23; ++j)
+    for (int i=0; i<37; ++i)
+      if (*(float*)smooth->GetElementAddr(i,j) != *(float*)asmooth->GetElementAddr(i,j) ||
+          *(float*)buf_mag->GetElementAddr(i,j) != *(float*)amag->GetElementAddr(i,j) ||
+          *(float*)buf_dirx->GetElementAddr(i,j) != *(float*)adirx->GetElementAddr(i,j) ||
+          *(float*)buf_diry->GetElementAddr(i,j) != *(float*)adiry->GetElementAddr(i,j))
+        ++ndiff;
+  TEST("Gaussian and Gradient on aligned rows", ndiff, 0);
+  gevd_bufferxy *acontour=VXL_NULLPTR, *adir=VXL_NULLPTR, *alocx=VXL_NULLPTR, *alocy=VXL_NULLPTR;
+  gevd_float_operators::NonMaximumSuppression(*amag, *adirx, *adiry, 0.1f, acontour, adir, alocx, alocy);
+  TEST("Non maximum suppression returns contiguous rows", acontour->IsContiguous() && adir->IsContiguous(), true);
+  gevd_bufferxy* asimilar = gevd_float_operators::SimilarBuffer(aimg);
+  TEST("SimilarBuffer has contiguous rows unless asked", asimilar->GetRowLayout(), gevd_bufferxy::CONTIGUOUS_ROWS);
+  delete asimilar;
+  asimilar = gevd_float_operators::SimilarBuffer(img, 0, 0, 0, true);
+  TEST("SimilarBuffer with aligned rows", asimilar->GetRowLayout(), gevd_bufferxy::ALIGNED_ROWS);
+  delete asimilar;
+  delete acontour; delete adir; delete alocx; delete alocy;
+  TEST_NEAR("Gradient across the step", *(float*)amag->GetElementAddr(19,11),
+            std::sqrt(*(float*)adirx->GetElementAddr(19,11) * *(float*)adirx->GetElementAddr(19,11) +
+                      *(float*)adiry->GetElementAddr(19,11) * *(float*)adiry->GetElementAddr(19,11)), 1e-5);
+  gevd_float_operators::Scale(*asmooth, 2.0f);
+  gevd_float_operators::Normalize(*asmooth, 0.0f, 1.0f);
+  float lo = 1, hi = 0;
+  for (int j=0; j<23; ++j)
+    for (int i=0; i<37; ++i) {
+      float v = *(float*)asmooth->GetElementAddr(i,j);
+      if (v < lo) lo = v;
+      if (v > hi) hi = v;
+    }
+  TEST("Normalize aligned rows", lo == 0.0f && hi == 1.0f, true);
+  delete smooth; delete asmooth;
+  delete buf_mag; delete buf_dirx; delete buf_diry;
+  delete amag; delete adirx; delete adiry;
 }
 
 TESTMAIN(test_gevd_float_operators);
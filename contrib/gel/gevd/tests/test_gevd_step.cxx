@@ -0,0 +1,92 @@
+// This is gel/gevd/tests/test_gevd_step.cxx
+#include <iostream>
+#include <cmath>
+#include <gevd/gevd_step.h>
+#include <gevd/gevd_bufferxy.h>
+#include <gevd/gevd_pixel.h>
+#include <testlib/testlib_test.h>
+#include <vnl/vnl_random.h>
+#include <vcl_compiler.h>
+
+// Number of pixels that differ between two buffers of the same type.
+// Non maximum suppression only sets the direction of pixels above the
+// threshold, so bytes are only compared at the contour pixels.
+static int num_different(const gevd_bufferxy& a, const gevd_bufferxy& b,
+                         const gevd_bufferxy& contour)
+{
+  int n = 0;
+  for (int j = 0; j < a.GetSizeY(); ++j)
+    for (int i = 0; i < a.GetSizeX(); ++i) {
+      if (a.GetBitsPixel() == bits_per_byte ? floatPixel(contour, i, j) && bytePixel(a, i, j) != bytePixel(b, i, j)
+                                            : floatPixel(a, i, j) != floatPixel(b, i, j))
+        ++n;
+    }
+  return n;
+}
+
+static void compare_tiled(const gevd_bufferxy& image, float noise_sigma, int tile_size)
+{
+  gevd_bufferxy* out[2][6];
+  float noise[2];
+  for (int t = 0; t < 2; ++t) {
+    for (int k = 0; k < 6; ++k)
+      out[t][k] = VXL_NULLPTR;
+    gevd_step step(1.0f, noise_sigma, 1.0f, 1.5f);
+    if (t == 1)
+      step.SetTiling(tile_size, 3);
+    step.DetectEdgels(image, out[t][0], out[t][1], out[t][2], out[t][3], out[t][4], out[t][5]);
+    noise[t] = step.NoiseSigma();
+  }
+  std::cout << "noise sigma " << noise_sigma << ", tile size " << tile_size << ":\n";
+  TEST("same noise sigma", noise[0], noise[1]);
+  const char* names[] = { "contour", "direction", "locationx", "locationy", "grad_mag", "angle" };
+  int nedgels = 0;
+  for (int j = 0; j < image.GetSizeY(); ++j)
+    for (int i = 0; i < image.GetSizeX(); ++i)
+      if (floatPixel(*out[0][0], i, j))
+        ++nedgels;
+  TEST("edgels found", nedgels > 0, true);
+  for (int k = 0; k < 6; ++k)
+    TEST_EQUAL(names[k], num_different(*out[0][k], *out[1][k], *out[0][0]), 0);
+
+  // the tiled detection writes to output buffers supplied by the caller
+  gevd_bufferxy* given[6];
+  for (int k = 0; k < 6; ++k)
+    given[k] = out[1][k];
+  gevd_step step(1.0f, noise_sigma, 1.0f, 1.5f);
+  step.SetTiling(tile_size, 3);
+  step.DetectEdgels(image, out[1][0], out[1][1], out[1][2], out[1][3], out[1][4], out[1][5]);
+  bool reused = true;
+  int ndifferent = 0;
+  for (int k = 0; k < 6; ++k) {
+    reused = reused && out[1][k] == given[k];
+    ndifferent += num_different(*out[0][k], *out[1][k], *out[0][0]);
+  }
+  TEST("output buffers reused", reused, true);
+  TEST_EQUAL("same result in reused buffers", ndifferent, 0);
+  for (int k = 0; k < 6; ++k) {
+    delete out[0][k]; delete out[1][k];
+  }
+}
+
+static void test_gevd_step()
+{
+  // Discs of different contrast on a noisy background
+  const int sx = 123, sy = 157;
+  gevd_bufferxy image(sx, sy, bits_per_float);
+  vnl_random rng(9667566);
+  for (int j = 0; j < sy; ++j)
+    for (int i = 0; i < sx; ++i) {
+      float v = 50.0f + float(rng.normal()) * 2.0f;
+      if ((i-40)*(i-40) + (j-50)*(j-50) < 900) v += 80.0f;
+      if ((i-80)*(i-80) + (j-110)*(j-110) < 600) v += 40.0f;
+      if (j > 130 && i < 60) v -= 30.0f;
+      floatPixel(image, i, j) = v;
+    }
+
+  compare_tiled(image, -0.5f, 16); // noise estimated from the weak edgels
+  compare_tiled(image, 2.0f, 16);  // given noise
+  compare_tiled(image, -0.5f, 50); // short last tile
+}
+
+TESTMAIN(test_gevd_step);
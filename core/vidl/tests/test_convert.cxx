@@ -1,12 +1,14 @@
 // This is core/vidl/tests/test_convert.cxx
 #include <iostream>
 #include <cstring>
+#include <vector>
 #include <testlib/testlib_test.h>
 #include <vcl_compiler.h>
 #include <vil/vil_image_view.h>
 #include <vil/vil_crop.h>
 #include <vidl/vidl_config.h>
 #include <vidl/vidl_convert.h>
+#include <vidl/vidl_color.h>
 #include <vul/vul_timer.h>
 
 #if VIDL_HAS_FFMPEG
@@ -162,6 +164,60 @@ static void test_convert()
                << " format pairs\n";
   }
 
+  // the optimized YUV conversions match the integer per pixel conversion
+  {
+    // not a multiple of 16 pixels per row, to also test the ends of the rows
+    const unsigned ni = 38, nj = 6, n = ni*nj;
+    std::vector<vxl_byte> packed(2*n), planar(n + n/2), mono(n), rgb(3*n), rgbp(3*n);
+    for (unsigned k = 0; k < packed.size(); ++k)
+      packed[k] = vxl_byte((k*97 + k*k*13) & 255);
+    for (unsigned k = 0; k < planar.size(); ++k)
+      planar[k] = vxl_byte((k*89 + k*k*7) & 255);
+    vidl_shared_frame mono_frame(&mono[0], ni, nj, VIDL_PIXEL_FORMAT_MONO_8);
+    vidl_shared_frame rgb_frame(&rgb[0], ni, nj, VIDL_PIXEL_FORMAT_RGB_24);
+    vidl_shared_frame rgbp_frame(&rgbp[0], ni, nj, VIDL_PIXEL_FORMAT_RGB_24P);
+
+    vidl_pixel_format packed_formats[] = { VIDL_PIXEL_FORMAT_UYVY_422, VIDL_PIXEL_FORMAT_YUYV_422 };
+    for (unsigned f = 0; f < 2; ++f) {
+      vidl_shared_frame in_frame(&packed[0], ni, nj, packed_formats[f]);
+      bool ok = vidl_convert_frame(in_frame, rgb_frame) &&
+                vidl_convert_frame(in_frame, rgbp_frame) &&
+                vidl_convert_frame(in_frame, mono_frame);
+      // the lumas of each pair, then U and V
+      unsigned y0 = f == 0 ? 1 : 0, u0 = f == 0 ? 0 : 1, v0 = u0 + 2;
+      for (unsigned p = 0; ok && p < n; ++p) {
+        const vxl_byte* m = &packed[4*(p/2)];
+        vxl_byte r, g, b;
+        vidl_color_convert_yuv2rgb(m[y0 + 2*(p%2)], m[u0], m[v0], r, g, b);
+        ok = rgb[3*p] == r && rgb[3*p+1] == g && rgb[3*p+2] == b &&
+             rgbp[p] == r && rgbp[p+n] == g && rgbp[p+2*n] == b &&
+             mono[p] == m[y0 + 2*(p%2)];
+      }
+      TEST(f == 0 ? "UYVY_422 to RGB_24, RGB_24P and MONO_8" :
+                    "YUYV_422 to RGB_24, RGB_24P and MONO_8", ok, true);
+    }
+
+    vidl_shared_frame yuv_frame(&planar[0], ni, nj, VIDL_PIXEL_FORMAT_YUV_420P);
+    bool ok = vidl_convert_frame(yuv_frame, rgb_frame) &&
+              vidl_convert_frame(yuv_frame, rgbp_frame) &&
+              vidl_convert_frame(yuv_frame, mono_frame);
+    for (unsigned j = 0; ok && j < nj; ++j)
+      for (unsigned i = 0; ok && i < ni; ++i) {
+        unsigned p = j*ni + i, c = (j/2)*(ni/2) + i/2;
+        vxl_byte r, g, b;
+        vidl_color_convert_yuv2rgb(planar[p], planar[n + c], planar[n + n/4 + c], r, g, b);
+        ok = rgb[3*p] == r && rgb[3*p+1] == g && rgb[3*p+2] == b &&
+             rgbp[p] == r && rgbp[p+n] == g && rgbp[p+2*n] == b &&
+             mono[p] == planar[p];
+      }
+    TEST("YUV_420P to RGB_24, RGB_24P and MONO_8", ok, true);
+
+    // odd sizes take the generic path
+    vidl_shared_frame odd_frame(&planar[0], 5, 3, VIDL_PIXEL_FORMAT_YUV_420P);
+    vidl_shared_frame odd_rgb(&rgb[0], 5, 3, VIDL_PIXEL_FORMAT_RGB_24);
+    TEST("YUV_420P with an odd size", vidl_convert_frame(odd_frame, odd_rgb), true);
+  }
+
   // timing tests
   {
     const int ni = 640, nj = 480;
@@ -14,6 +14,7 @@
 #include <vidl/vidl_ostream.h>
 #include <vidl/vidl_ostream_sptr.h>
 #include <vidl/vidl_image_list_ostream.h>
+#include <vidl/vidl_pipelined_istream.h>
 #include <vidl/vidl_iidc1394_params.h>
 #if VIDL_HAS_VIDEODEV2
 #include <vidl/vidl_v4l2_device.h>
@@ -0,0 +1,175 @@
+// This is core/vidl/tests/test_pipelined_istream.cxx
+#include <iostream>
+#include <vector>
+#include <testlib/testlib_test.h>
+#include <vcl_compiler.h>
+#include <vil/vil_image_view.h>
+#include <vidl/vidl_pipelined_istream.h>
+#include <vidl/vidl_convert.h>
+#include <vidl/vidl_frame.h>
+
+//: A stream of synthetic frames that reuses one buffer, as a decoder does
+class test_synthetic_istream : public vidl_istream
+{
+ public:
+  test_synthetic_istream(unsigned n, unsigned ni, unsigned nj, vidl_pixel_format fmt)
+    : n_(n), ni_(ni), nj_(nj), fmt_(fmt), index_(unsigned(-1)), open_(true),
+      buffer_(vidl_pixel_format_buffer_size(ni, nj, fmt)) {}
+
+  //: the value of byte \p k of frame \p f
+  static vxl_byte value(unsigned f, unsigned k) { return vxl_byte((f*37 + k*11) & 255); }
+
+  virtual bool is_open() const { return open_; }
+  virtual bool is_valid() const { return index_ < n_; }
+  virtual bool is_seekable() const { return true; }
+  virtual int num_frames() const { return int(n_); }
+  virtual unsigned int frame_number() const { return index_; }
+  virtual unsigned int width() const { return ni_; }
+  virtual unsigned int height() const { return nj_; }
+  virtual vidl_pixel_format format() const { return fmt_; }
+  virtual double frame_rate() const { return 25.0; }
+  virtual double duration() const { return n_/25.0; }
+  virtual void close() { open_ = false; }
+  virtual bool advance() { return seek_frame(index_+1); }
+  virtual vidl_frame_sptr read_frame() { advance(); return current_frame(); }
+  virtual vidl_frame_sptr current_frame()
+  {
+    if (!is_valid())
+      return VXL_NULLPTR;
+    return new vidl_shared_frame(&buffer_[0], ni_, nj_, fmt_);
+  }
+  virtual bool seek_frame(unsigned int frame_number)
+  {
+    index_ = frame_number;
+    if (!is_valid())
+      return false;
+    for (unsigned k = 0; k < buffer_.size(); ++k)
+      buffer_[k] = value(index_, k);
+    return true;
+  }
+
+ private:
+  unsigned n_, ni_, nj_;
+  vidl_pixel_format fmt_;
+  unsigned index_;
+  bool open_;
+  std::vector<vxl_byte> buffer_;
+};
+
+//: true if \p frame holds frame \p f of a test_synthetic_istream
+static bool is_frame(const vidl_frame_sptr& frame, unsigned f)
+{
+  if (!frame)
+    return false;
+  const vxl_byte* data = static_cast<const vxl_byte*>(frame->data());
+  for (unsigned k = 0; k < frame->size(); ++k)
+    if (data[k] != test_synthetic_istream::value(f, k))
+      return false;
+  return true;
+}
+
+static void test_pipelined_istream()
+{
+  const unsigned n = 50, ni = 40, nj = 30;
+
+  // read every frame through a small ring
+  {
+    vidl_istream_sptr source = new test_synthetic_istream(n, ni, nj, VIDL_PIXEL_FORMAT_MONO_8);
+    vidl_pipelined_istream stream(source, 3);
+    TEST("open", stream.is_open() && !stream.is_valid(), true);
+    TEST("properties", stream.width() == ni && stream.height() == nj &&
+                       stream.format() == VIDL_PIXEL_FORMAT_MONO_8 &&
+                       stream.num_frames() == int(n) && stream.is_seekable() &&
+                       stream.frame_rate() == 25.0, true);
+    TEST("number of buffers", stream.num_buffers(), 3);
+    unsigned n_read = 0, n_good = 0;
+    while (stream.advance()) {
+      if (stream.frame_number() == n_read && is_frame(stream.current_frame(), n_read))
+        ++n_good;
+      ++n_read;
+    }
+    TEST("all frames read in order", n_read == n && n_good == n, true);
+    TEST("invalid at the end", stream.is_valid() || stream.current_frame(), false);
+    TEST("no advance past the end", stream.advance(), false);
+  }
+
+  // the view aliases the pooled buffer, which is reused
+  {
+    vidl_istream_sptr source = new test_synthetic_istream(n, ni, nj, VIDL_PIXEL_FORMAT_MONO_8);
+    vidl_pipelined_istream stream(source, 2);
+    std::vector<const void*> buffers;
+    bool aliased = true;
+    for (unsigned f = 0; f < 10 && stream.advance(); ++f) {
+      vil_image_view_base_sptr view = stream.current_view();
+      vil_image_view<vxl_byte> img = view ? vil_image_view<vxl_byte>(*view) : vil_image_view<vxl_byte>();
+      aliased = aliased && img.ni() == ni && img.nj() == nj &&
+                img.top_left_ptr() == stream.current_frame()->data() &&
+                img(1,0) == test_synthetic_istream::value(f, 1);
+      buffers.push_back(stream.current_frame()->data());
+    }
+    TEST("view aliases the current frame", aliased, true);
+    bool reused = buffers.size() == 10;
+    for (unsigned f = 2; f < buffers.size(); ++f)
+      reused = reused && buffers[f] == buffers[f-2];
+    TEST("buffers are reused", reused, true);
+
+    // a view kept by the caller stays valid
+    vil_image_view_base_sptr kept = stream.read_frame() ? stream.current_view() : VXL_NULLPTR;
+    unsigned kept_number = stream.frame_number();
+    vidl_frame_sptr kept_frame = new vidl_memory_chunk_frame(*kept);
+    for (unsigned f = 0; f < 5; ++f)
+      stream.advance();
+    TEST("kept view is not reused", kept && is_frame(kept_frame, kept_number), true);
+    TEST("later frames are right", is_frame(stream.current_frame(), stream.frame_number()) &&
+                                   stream.frame_number() == kept_number + 5, true);
+  }
+
+  // seeking discards the frames read ahead
+  {
+    vidl_istream_sptr source = new test_synthetic_istream(n, ni, nj, VIDL_PIXEL_FORMAT_MONO_8);
+    vidl_pipelined_istream stream(source, 4);
+    stream.advance();
+    stream.advance();
+    TEST("seek", stream.seek_frame(30), true);
+    TEST("current frame after seek", stream.frame_number() == 30 &&
+                                     is_frame(stream.current_frame(), 30), true);
+    TEST("advance after seek", stream.advance() && stream.frame_number() == 31 &&
+                               is_frame(stream.current_frame(), 31), true);
+    TEST("seek back", stream.seek_frame(3) && stream.advance() && stream.frame_number() == 4 &&
+                      is_frame(stream.current_frame(), 4), true);
+    TEST("seek past the end", stream.seek_frame(n) || stream.is_valid(), false);
+    stream.close();
+    TEST("closed", stream.is_open() || source->is_open(), false);
+  }
+
+  // frames are converted on the worker thread
+  {
+    vidl_istream_sptr source = new test_synthetic_istream(n, ni, nj, VIDL_PIXEL_FORMAT_YUYV_422);
+    vidl_istream_sptr check = new test_synthetic_istream(n, ni, nj, VIDL_PIXEL_FORMAT_YUYV_422);
+    vidl_pipelined_istream stream(source, 4, VIDL_PIXEL_FORMAT_RGB_24P);
+    TEST("converted format", stream.format(), VIDL_PIXEL_FORMAT_RGB_24P);
+    unsigned n_good = 0;
+    while (stream.advance() && check->advance()) {
+      vidl_frame_sptr expected = vidl_convert_frame(check->current_frame(), VIDL_PIXEL_FORMAT_RGB_24P);
+      vil_image_view_base_sptr view = stream.current_view();
+      vil_image_view<vxl_byte> img = view ? vil_image_view<vxl_byte>(*view) : vil_image_view<vxl_byte>();
+      bool same = expected && img.nplanes() == 3 && img.top_left_ptr() == stream.current_frame()->data();
+      const vxl_byte* b = same ? static_cast<const vxl_byte*>(expected->data()) : VXL_NULLPTR;
+      for (unsigned k = 0; same && k < expected->size(); ++k)
+        same = img.top_left_ptr()[k] == b[k];
+      if (same)
+        ++n_good;
+    }
+    TEST("converted frames", n_good, n);
+  }
+
+  // an unopened source
+  {
+    vidl_istream_sptr source = new test_synthetic_istream(n, ni, nj, VIDL_PIXEL_FORMAT_MONO_8);
+    source->close();
+    vidl_pipelined_istream stream(source);
+    TEST("closed source", stream.is_open() || stream.advance(), false);
+  }
+}
+
+TESTMAIN(test_pipelined_istream);
@@ -0,0 +1,136 @@
+//:
+// \file
+// \brief Timings of reading a video directly and through a vidl_pipelined_istream
+//        A synthetic stream stands in for a decoder: it spends some time
+//        making each YUV_420P frame.  Each frame is converted to RGB and
+//        then processed for a while, first reading the stream on the
+//        calling thread and then reading it ahead on a worker thread.
+//        Also reports the time of the YUV_420P to RGB_24P conversion.
+//        Usage: vidl_pipelined_istream_timings [n_frames [ni nj [n_buffers]]]
+
+#include <iostream>
+#include <cstdlib>
+#include <vector>
+#include <vidl/vidl_pipelined_istream.h>
+#include <vidl/vidl_convert.h>
+#include <vidl/vidl_frame.h>
+#include <vil/vil_image_view.h>
+#include <vul/vul_timer.h>
+#include <vcl_compiler.h>
+
+//: A YUV_420P stream whose frames take a while to make, as decoding does
+class timings_decoder_istream : public vidl_istream
+{
+ public:
+  timings_decoder_istream(unsigned n, unsigned ni, unsigned nj)
+    : n_(n), ni_(ni), nj_(nj), index_(unsigned(-1)), open_(true),
+      buffer_(vidl_pixel_format_buffer_size(ni, nj, VIDL_PIXEL_FORMAT_YUV_420P)) {}
+
+  virtual bool is_open() const { return open_; }
+  virtual bool is_valid() const { return index_ < n_; }
+  virtual bool is_seekable() const { return false; }
+  virtual int num_frames() const { return -1; }
+  virtual unsigned int frame_number() const { return index_; }
+  virtual unsigned int width() const { return ni_; }
+  virtual unsigned int height() const { return nj_; }
+  virtual vidl_pixel_format format() const { return VIDL_PIXEL_FORMAT_YUV_420P; }
+  virtual double frame_rate() const { return 0.0; }
+  virtual double duration() const { return 0.0; }
+  virtual void close() { open_ = false; }
+  virtual bool advance()
+  {
+    if (++index_ >= n_)
+      return false;
+    // a few passes of a hash over the frame
+    unsigned h = index_;
+    for (unsigned pass = 0; pass < 4; ++pass)
+      for (unsigned k = 0; k < buffer_.size(); ++k) {
+        h = h*1664525u + 1013904223u + k;
+        buffer_[k] = vxl_byte(h >> 24);
+      }
+    return true;
+  }
+  virtual vidl_frame_sptr read_frame() { advance(); return current_frame(); }
+  virtual vidl_frame_sptr current_frame()
+  {
+    if (!is_valid())
+      return VXL_NULLPTR;
+    return new vidl_shared_frame(&buffer_[0], ni_, nj_, VIDL_PIXEL_FORMAT_YUV_420P);
+  }
+  virtual bool seek_frame(unsigned int) { return false; }
+
+ private:
+  unsigned n_, ni_, nj_;
+  unsigned index_;
+  bool open_;
+  std::vector<vxl_byte> buffer_;
+};
+
+//: Stands in for the tracking done with each frame
+static unsigned process(const vil_image_view<vxl_byte>& img)
+{
+  unsigned sum = 0;
+  for (unsigned pass = 0; pass < 4; ++pass)
+    for (unsigned p = 0; p < img.nplanes(); ++p)
+      for (unsigned j = 0; j < img.nj(); ++j)
+        for (unsigned i = 0; i < img.ni(); ++i)
+          sum = sum*31 + img(i,j,p);
+  return sum;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned n = argc > 1 ? std::atoi(argv[1]) : 200;
+  unsigned ni = argc > 3 ? std::atoi(argv[2]) : 640;
+  unsigned nj = argc > 3 ? std::atoi(argv[3]) : 480;
+  unsigned n_buffers = argc > 4 ? std::atoi(argv[4]) : 4;
+
+  // the conversion alone
+  {
+    timings_decoder_istream stream(1, ni, nj);
+    stream.advance();
+    vidl_frame_sptr frame = stream.current_frame();
+    vidl_frame_sptr rgb = vidl_convert_frame(frame, VIDL_PIXEL_FORMAT_RGB_24P);
+    vul_timer t;
+    for (unsigned k = 0; k < 100; ++k)
+      vidl_convert_frame(*frame, *rgb);
+    std::cout << "YUV_420P to RGB_24P conversion of " << ni << 'x' << nj << ": "
+              << t.real()/100.0 << " ms\n";
+  }
+
+  // read, convert and process on the calling thread
+  unsigned sum_direct = 0, sum_pipelined = 0;
+  double fps_direct, fps_pipelined;
+  {
+    vidl_istream_sptr stream = new timings_decoder_istream(n, ni, nj);
+    vil_image_view<vxl_byte> img;
+    vul_timer t;
+    while (stream->advance()) {
+      vidl_convert_to_view(*stream->current_frame(), img, VIDL_PIXEL_COLOR_RGB);
+      sum_direct += process(img);
+    }
+    fps_direct = n/(t.real()/1000.0 + 1e-9);
+  }
+
+  // read and convert ahead on a worker thread, process the pooled views
+  {
+    vidl_pipelined_istream stream(new timings_decoder_istream(n, ni, nj), n_buffers,
+                                  VIDL_PIXEL_FORMAT_RGB_24P);
+    vul_timer t;
+    while (stream.advance()) {
+      vil_image_view<vxl_byte> img(*stream.current_view());
+      sum_pipelined += process(img);
+    }
+    fps_pipelined = n/(t.real()/1000.0 + 1e-9);
+  }
+
+  std::cout << "reading " << n << " frames of " << ni << 'x' << nj << '\n'
+            << "  on the calling thread: " << fps_direct << " frames/s\n"
+            << "  pipelined with " << n_buffers << " buffers: " << fps_pipelined << " frames/s ("
+            << fps_pipelined/fps_direct << " times faster)\n";
+  if (sum_direct != sum_pipelined) {
+    std::cerr << "the frames differ\n";
+    return 1;
+  }
+  return 0;
+}
@@ -10,6 +10,7 @@
 // \verbatim
 //  Modifications
 //   10 Jul.2008 - Antonio Garrido - Added conversions for RGB_24(P),MONO8 and YUYV_422
+//   Oct 2026 - SSE2 conversions of UYVY_422, YUYV_422 and YUV_420P to RGB_24(P) and MONO_8
 // \endverbatim
 //
 //-----------------------------------------------------------------------------
@@ -32,6 +33,11 @@
 #include <vil/vil_memory_chunk.h>
 #include <vcl_cassert.h>
 #include <vcl_compiler.h>
+#include <vxl_config.h>
+#if VXL_HAS_EMMINTRIN_H && defined(__SSE2__)
+# include <emmintrin.h>
+# define VIDL_CONVERT_SSE2 1
+#endif
 
 //--------------------------------------------------------------------------------
 
@@ -114,6 +120,172 @@ bool convert_generic(vidl_frame const& in_frame,
 }
 
 
+//=============================================================================
+// Start of YUV to RGB row kernels
+// These give exactly the results of the integer vidl_color_convert_yuv2rgb()
+// and use SSE2 for 16 pixels at a time where it is available.
+
+#if VIDL_CONVERT_SSE2
+//: Convert the 16 lumas in \p y with the 8 chromas (16 bit words) in \p u and \p v to RGB
+//  Each chroma sample is shared by two neighbouring pixels.
+inline void yuv2rgb_sse2(__m128i y, __m128i u, __m128i v,
+                         __m128i& r, __m128i& g, __m128i& b)
+{
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i c128 = _mm_set1_epi16(128);
+  u = _mm_sub_epi16(u, c128);
+  v = _mm_sub_epi16(v, c128);
+  // (v*1436)>>10 and (u*1814)>>10 are the high words of (v<<6)*1436 and (u<<6)*1814
+  __m128i dr = _mm_mulhi_epi16(_mm_slli_epi16(v, 6), _mm_set1_epi16(1436));
+  __m128i db = _mm_mulhi_epi16(_mm_slli_epi16(u, 6), _mm_set1_epi16(1814));
+  // (u*352 + v*731)>>10 needs 32 bits before the shift
+  const __m128i cg = _mm_set1_epi32((731<<16) | 352);
+  __m128i dg = _mm_packs_epi32(_mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(u, v), cg), 10),
+                               _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(u, v), cg), 10));
+  __m128i ylo = _mm_unpacklo_epi8(y, zero), yhi = _mm_unpackhi_epi8(y, zero);
+  // packus clamps to [0,255] as the scalar version does
+  r = _mm_packus_epi16(_mm_add_epi16(ylo, _mm_unpacklo_epi16(dr, dr)),
+                       _mm_add_epi16(yhi, _mm_unpackhi_epi16(dr, dr)));
+  g = _mm_packus_epi16(_mm_sub_epi16(ylo, _mm_unpacklo_epi16(dg, dg)),
+                       _mm_sub_epi16(yhi, _mm_unpackhi_epi16(dg, dg)));
+  b = _mm_packus_epi16(_mm_add_epi16(ylo, _mm_unpacklo_epi16(db, db)),
+                       _mm_add_epi16(yhi, _mm_unpackhi_epi16(db, db)));
+}
+
+//: Store 16 pixels to planes (\p step == 1) or interleaved (\p step == 3)
+inline void store_rgb_sse2(__m128i r, __m128i g, __m128i b,
+                           vxl_byte* red, vxl_byte* green, vxl_byte* blue,
+                           unsigned step)
+{
+  if (step == 1) {
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(red), r);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(green), g);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(blue), b);
+    return;
+  }
+  vxl_byte tr[16], tg[16], tb[16];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(tr), r);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(tg), g);
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(tb), b);
+  for (unsigned i=0; i<16; ++i) {
+    red[i*step] = tr[i];
+    green[i*step] = tg[i];
+    blue[i*step] = tb[i];
+  }
+}
+#endif // VIDL_CONVERT_SSE2
+
+
+//: Convert \p n pixels (n even) of packed 4:2:2 data to RGB
+//  The lumas of each macro pixel are at \p y_offset and \p y_offset+2
+//  (0 for YUYV, 1 for UYVY), U and V are at 1-y_offset and 3-y_offset.
+//  The output is planar for \p step 1 and interleaved for \p step 3.
+void packed422_to_rgb(const vxl_byte* in, unsigned n, unsigned y_offset,
+                      vxl_byte* red, vxl_byte* green, vxl_byte* blue, unsigned step)
+{
+  unsigned c = 0;
+#if VIDL_CONVERT_SSE2
+  const __m128i low = _mm_set1_epi16(0x00ff);
+  for (; c+16 <= n; c+=16, in+=32, red+=16*step, green+=16*step, blue+=16*step) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+16));
+    __m128i even = _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low));
+    __m128i odd = _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8));
+    __m128i y = y_offset ? odd : even;
+    __m128i uv = y_offset ? even : odd;
+    __m128i r, g, bl;
+    yuv2rgb_sse2(y, _mm_and_si128(uv, low), _mm_srli_epi16(uv, 8), r, g, bl);
+    store_rgb_sse2(r, g, bl, red, green, blue, step);
+  }
+#endif
+  const unsigned u_offset = 1-y_offset, v_offset = 3-y_offset;
+  for (; c+2 <= n; c+=2, in+=4, red+=2*step, green+=2*step, blue+=2*step) {
+    vidl_color_convert_yuv2rgb(in[y_offset], in[u_offset], in[v_offset],
+                               red[0], green[0], blue[0]);
+    vidl_color_convert_yuv2rgb(in[y_offset+2], in[u_offset], in[v_offset],
+                               red[step], green[step], blue[step]);
+  }
+}
+
+
+//: Convert \p n pixels (n even) of one row of planar data with half as many chroma samples to RGB
+//  The output is planar for \p step 1 and interleaved for \p step 3.
+void planar_row_to_rgb(const vxl_byte* y, const vxl_byte* u, const vxl_byte* v, unsigned n,
+                       vxl_byte* red, vxl_byte* green, vxl_byte* blue, unsigned step)
+{
+  unsigned c = 0;
+#if VIDL_CONVERT_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  for (; c+16 <= n; c+=16, y+=16, u+=8, v+=8, red+=16*step, green+=16*step, blue+=16*step) {
+    __m128i r, g, b;
+    yuv2rgb_sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(y)),
+                 _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(u)), zero),
+                 _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(v)), zero),
+                 r, g, b);
+    store_rgb_sse2(r, g, b, red, green, blue, step);
+  }
+#endif
+  for (; c+2 <= n; c+=2, y+=2, ++u, ++v, red+=2*step, green+=2*step, blue+=2*step) {
+    vidl_color_convert_yuv2rgb(y[0], *u, *v, red[0], green[0], blue[0]);
+    vidl_color_convert_yuv2rgb(y[1], *u, *v, red[step], green[step], blue[step]);
+  }
+}
+
+
+//: Copy the lumas of \p n pixels (n even) of packed 4:2:2 data
+void packed422_to_mono(const vxl_byte* in, unsigned n, unsigned y_offset, vxl_byte* mono)
+{
+  unsigned c = 0;
+#if VIDL_CONVERT_SSE2
+  const __m128i low = _mm_set1_epi16(0x00ff);
+  for (; c+16 <= n; c+=16, in+=32, mono+=16) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in+16));
+    __m128i y = y_offset ? _mm_packus_epi16(_mm_srli_epi16(a, 8), _mm_srli_epi16(b, 8))
+                         : _mm_packus_epi16(_mm_and_si128(a, low), _mm_and_si128(b, low));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(mono), y);
+  }
+#endif
+  for (; c+2 <= n; c+=2, in+=4) {
+    *(mono++) = in[y_offset];
+    *(mono++) = in[y_offset+2];
+  }
+}
+
+
+//: Convert a packed 4:2:2 frame to RGB_24 or RGB_24P
+//  Frames with an odd number of pixels take the generic path.
+bool convert_packed422_to_rgb(vidl_frame const& in_frame, vidl_frame& out_frame,
+                              unsigned y_offset)
+{
+  const unsigned n = in_frame.ni() * in_frame.nj();
+  if (n % 2)
+    return convert_generic(in_frame, out_frame);
+  const vxl_byte* in = reinterpret_cast<const vxl_byte*>(in_frame.data());
+  vxl_byte* out = reinterpret_cast<vxl_byte*>(out_frame.data());
+  if (out_frame.pixel_format() == VIDL_PIXEL_FORMAT_RGB_24)
+    packed422_to_rgb(in, n, y_offset, out, out+1, out+2, 3);
+  else
+    packed422_to_rgb(in, n, y_offset, out, out+n, out+2*n, 1);
+  return true;
+}
+
+
+//: Convert a packed 4:2:2 frame to MONO_8
+bool convert_packed422_to_mono(vidl_frame const& in_frame, vidl_frame& out_frame,
+                               unsigned y_offset)
+{
+  const unsigned n = in_frame.ni() * in_frame.nj();
+  if (n % 2)
+    return convert_generic(in_frame, out_frame);
+  packed422_to_mono(reinterpret_cast<const vxl_byte*>(in_frame.data()), n, y_offset,
+                    reinterpret_cast<vxl_byte*>(out_frame.data()));
+  return true;
+}
+
+// End of YUV to RGB row kernels
+
+
 //=============================================================================
 // Start of pixel conversion specializations
 // Write optimized conversion specializations below
@@ -161,25 +333,22 @@ struct convert<VIDL_PIXEL_FORMAT_UYVY_422, VIDL_PIXEL_FORMAT_RGB_24>
   {
     assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_UYVY_422);
     assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_RGB_24);
-    const vxl_byte* uyvy = reinterpret_cast<const vxl_byte*>(in_frame.data());
-    vxl_byte* rgb = reinterpret_cast<vxl_byte*>(out_frame.data());
-    unsigned int num_half_pix = (in_frame.ni() * in_frame.nj() + 1)/2;
-    for (unsigned int c=0; c<num_half_pix; ++c) {
-      const vxl_byte& u1 = *(uyvy++);
-      const vxl_byte& y1 = *(uyvy++);
-      const vxl_byte& v1 = *(uyvy++);
-      const vxl_byte& y2 = *(uyvy++);
-      vxl_byte r,g,b;
-      vidl_color_convert_yuv2rgb(y1,u1,v1,r,g,b);
-      *(rgb++) = r;
-      *(rgb++) = g;
-      *(rgb++) = b;
-      vidl_color_convert_yuv2rgb(y2,u1,v1,r,g,b);
-      *(rgb++) = r;
-      *(rgb++) = g;
-      *(rgb++) = b;
-    }
-    return true;
+    return convert_packed422_to_rgb(in_frame, out_frame, 1);
+  }
+};
+
+
+// UYVY_422 to RGB_24P
+VCL_DEFINE_SPECIALIZATION
+struct convert<VIDL_PIXEL_FORMAT_UYVY_422, VIDL_PIXEL_FORMAT_RGB_24P>
+{
+  enum { defined = true };
+  static bool apply(vidl_frame const& in_frame,
+                    vidl_frame& out_frame)
+  {
+    assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_UYVY_422);
+    assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_RGB_24P);
+    return convert_packed422_to_rgb(in_frame, out_frame, 1);
   }
 };
 
@@ -194,18 +363,7 @@ struct convert<VIDL_PIXEL_FORMAT_UYVY_422, VIDL_PIXEL_FORMAT_MONO_8>
   {
     assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_UYVY_422);
     assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_MONO_8);
-    const vxl_byte* uyvy = reinterpret_cast<const vxl_byte*>(in_frame.data());
-    vxl_byte* mono = reinterpret_cast<vxl_byte*>(out_frame.data());
-    unsigned int num_half_pix = (in_frame.ni() * in_frame.nj() + 1)/2;
-    for (unsigned int c=0; c<num_half_pix; ++c) {
-      ++uyvy;
-      const vxl_byte& y1 = *(uyvy++);
-      ++uyvy;
-      const vxl_byte& y2 = *(uyvy++);
-      *(mono++) = y1;
-      *(mono++) = y2;
-    }
-    return true;
+    return convert_packed422_to_mono(in_frame, out_frame, 1);
   }
 };
 
@@ -253,25 +411,7 @@ struct convert<VIDL_PIXEL_FORMAT_YUYV_422, VIDL_PIXEL_FORMAT_RGB_24>
   {
     assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_YUYV_422);
     assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_RGB_24);
-    const vxl_byte* yuyv = reinterpret_cast<const vxl_byte*>(in_frame.data());
-    vxl_byte* rgb = reinterpret_cast<vxl_byte*>(out_frame.data());
-    unsigned int num_half_pix = (in_frame.ni() * in_frame.nj() + 1)/2;
-    for (unsigned int c=0; c<num_half_pix; ++c) {
-      const vxl_byte& y1 = *(yuyv++);
-      const vxl_byte& u1 = *(yuyv++);
-      const vxl_byte& y2 = *(yuyv++);
-      const vxl_byte& v1 = *(yuyv++);
-      vxl_byte r,g,b;
-      vidl_color_convert_yuv2rgb(y1,u1,v1,r,g,b);
-      *(rgb++) = r;
-      *(rgb++) = g;
-      *(rgb++) = b;
-      vidl_color_convert_yuv2rgb(y2,u1,v1,r,g,b);
-      *(rgb++) = r;
-      *(rgb++) = g;
-      *(rgb++) = b;
-    }
-    return true;
+    return convert_packed422_to_rgb(in_frame, out_frame, 0);
   }
 };
 
@@ -320,27 +460,7 @@ struct convert<VIDL_PIXEL_FORMAT_YUYV_422, VIDL_PIXEL_FORMAT_RGB_24P>
   {
     assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_YUYV_422);
     assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_RGB_24P);
-    const vxl_byte* yuyv = reinterpret_cast<const vxl_byte*>(in_frame.data());
-    vxl_byte* red = reinterpret_cast<vxl_byte*>(out_frame.data());
-    vxl_byte* green = red+out_frame.ni()*out_frame.nj();
-    vxl_byte* blue = green+out_frame.ni()*out_frame.nj();
-    unsigned int num_half_pix = (in_frame.ni() * in_frame.nj() + 1)/2;
-    for (unsigned int c=0; c<num_half_pix; ++c) {
-      const vxl_byte& y1 = *(yuyv++);
-      const vxl_byte& u1 = *(yuyv++);
-      const vxl_byte& y2 = *(yuyv++);
-      const vxl_byte& v1 = *(yuyv++);
-      vxl_byte r,g,b;
-      vidl_color_convert_yuv2rgb(y1,u1,v1,r,g,b);
-      *(red++) = r;
-      *(green++) = g;
-      *(blue++) = b;
-      vidl_color_convert_yuv2rgb(y2,u1,v1,r,g,b);
-      *(red++) = r;
-      *(green++) = g;
-      *(blue++) = b;
-    }
-    return true;
+    return convert_packed422_to_rgb(in_frame, out_frame, 0);
   }
 };
 
@@ -354,17 +474,77 @@ struct convert<VIDL_PIXEL_FORMAT_YUYV_422, VIDL_PIXEL_FORMAT_MONO_8>
   {
     assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_YUYV_422);
     assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_MONO_8);
-    const vxl_byte* yuyv = reinterpret_cast<const vxl_byte*>(in_frame.data());
-    vxl_byte* mono = reinterpret_cast<vxl_byte*>(out_frame.data());
-    unsigned int num_half_pix = (in_frame.ni() * in_frame.nj() + 1)/2;
-    for (unsigned int c=0; c<num_half_pix; ++c) {
-      const vxl_byte& y1 = *(yuyv++);
-      ++yuyv;
-      const vxl_byte& y2 = *(yuyv++);
-      ++yuyv;
-      *(mono++) = y1;
-      *(mono++) = y2;
+    return convert_packed422_to_mono(in_frame, out_frame, 0);
+  }
+};
+
+
+// YUV_420P to RGB_24 and RGB_24P
+// The planes are Y (ni x nj), U and V (ni/2 x nj/2).
+// Frames with an odd width or height take the generic path.
+bool convert_yuv420p_to_rgb(vidl_frame const& in_frame, vidl_frame& out_frame)
+{
+  const unsigned ni = in_frame.ni(), nj = in_frame.nj();
+  if (ni % 2 || nj % 2)
+    return convert_generic(in_frame, out_frame);
+  const unsigned n = ni*nj;
+  const vxl_byte* y = reinterpret_cast<const vxl_byte*>(in_frame.data());
+  const vxl_byte* u = y + n;
+  const vxl_byte* v = u + n/4;
+  vxl_byte* out = reinterpret_cast<vxl_byte*>(out_frame.data());
+  const bool interleaved = out_frame.pixel_format() == VIDL_PIXEL_FORMAT_RGB_24;
+  for (unsigned j=0; j<nj; ++j) {
+    const unsigned c = (j/2)*(ni/2);
+    if (interleaved) {
+      vxl_byte* rgb = out + 3*j*ni;
+      planar_row_to_rgb(y+j*ni, u+c, v+c, ni, rgb, rgb+1, rgb+2, 3);
+    }
+    else {
+      vxl_byte* red = out + j*ni;
+      planar_row_to_rgb(y+j*ni, u+c, v+c, ni, red, red+n, red+2*n, 1);
     }
+  }
+  return true;
+}
+
+VCL_DEFINE_SPECIALIZATION
+struct convert<VIDL_PIXEL_FORMAT_YUV_420P, VIDL_PIXEL_FORMAT_RGB_24>
+{
+  enum { defined = true };
+  static bool apply(vidl_frame const& in_frame,
+                    vidl_frame& out_frame)
+  {
+    assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_YUV_420P);
+    assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_RGB_24);
+    return convert_yuv420p_to_rgb(in_frame, out_frame);
+  }
+};
+
+VCL_DEFINE_SPECIALIZATION
+struct convert<VIDL_PIXEL_FORMAT_YUV_420P, VIDL_PIXEL_FORMAT_RGB_24P>
+{
+  enum { defined = true };
+  static bool apply(vidl_frame const& in_frame,
+                    vidl_frame& out_frame)
+  {
+    assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_YUV_420P);
+    assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_RGB_24P);
+    return convert_yuv420p_to_rgb(in_frame, out_frame);
+  }
+};
+
+// YUV_420P to MONO_8
+VCL_DEFINE_SPECIALIZATION
+struct convert<VIDL_PIXEL_FORMAT_YUV_420P, VIDL_PIXEL_FORMAT_MONO_8>
+{
+  enum { defined = true };
+  static bool apply(vidl_frame const& in_frame,
+                    vidl_frame& out_frame)
+  {
+    assert(in_frame.pixel_format()==VIDL_PIXEL_FORMAT_YUV_420P);
+    assert(out_frame.pixel_format()==VIDL_PIXEL_FORMAT_MONO_8);
+    // the Y plane is the greyscale image
+    std::memcpy(out_frame.data(), in_frame.data(), in_frame.ni() * in_frame.nj());
     return true;
   }
 };
@@ -0,0 +1,381 @@
+// This is core/vidl/vidl_pipelined_istream.cxx
+#ifdef VCL_NEEDS_PRAGMA_INTERFACE
+#pragma implementation
+#endif
+//:
+// \file
+//
+//-----------------------------------------------------------------------------
+
+#include <iostream>
+#include <vector>
+#include "vidl_pipelined_istream.h"
+#include "vidl_frame.h"
+#include "vidl_convert.h"
+#include <vil/vil_memory_chunk.h>
+#include <vcl_compiler.h>
+#include <vxl_config.h>
+
+#if VXL_HAS_PTHREAD_H
+#include <pthread.h>
+#endif
+
+//--------------------------------------------------------------------------------
+
+
+//: The worker thread, its lock and the pooled frame buffers
+struct vidl_pipelined_istream::worker
+{
+  worker() : threaded(false), stopping(false)
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_mutex_init(&mutex, VXL_NULLPTR);
+    pthread_cond_init(&changed, VXL_NULLPTR);
+#endif
+  }
+  ~worker()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_cond_destroy(&changed);
+    pthread_mutex_destroy(&mutex);
+#endif
+  }
+  void lock()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_mutex_lock(&mutex);
+#endif
+  }
+  void unlock()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_mutex_unlock(&mutex);
+#endif
+  }
+  //: wait for a change of state, with the lock held
+  void wait()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_cond_wait(&changed, &mutex);
+#endif
+  }
+  void broadcast()
+  {
+#if VXL_HAS_PTHREAD_H
+    pthread_cond_broadcast(&changed);
+#endif
+  }
+
+  //: The pooled buffers, null where the caller kept the last one
+  std::vector<vidl_frame_sptr> frames;
+  //: The frame number of the frame in each buffer
+  std::vector<unsigned int> frame_numbers;
+  //: true while the frames are read on the worker thread
+  bool threaded;
+  //: true when the worker thread should return
+  bool stopping;
+#if VXL_HAS_PTHREAD_H
+  pthread_mutex_t mutex;
+  pthread_cond_t changed;
+  pthread_t thread;
+#endif
+};
+
+
+//: Constructor - default
+vidl_pipelined_istream::
+vidl_pipelined_istream()
+  : worker_(new worker),
+    num_buffers_(0), current_(-1), head_(0), num_ready_(0), end_(true),
+    frame_number_(static_cast<unsigned int>(-1)), seekable_(false), num_frames_(-1),
+    width_(0), height_(0),
+    format_(VIDL_PIXEL_FORMAT_UNKNOWN), out_format_(VIDL_PIXEL_FORMAT_UNKNOWN),
+    frame_rate_(0.0), duration_(0.0) {}
+
+
+//: Constructor - read ahead from \p source into \p num_buffers frame buffers
+vidl_pipelined_istream::
+vidl_pipelined_istream(const vidl_istream_sptr& source, unsigned num_buffers,
+                       vidl_pixel_format format)
+  : worker_(new worker),
+    num_buffers_(0), current_(-1), head_(0), num_ready_(0), end_(true),
+    frame_number_(static_cast<unsigned int>(-1)), seekable_(false), num_frames_(-1),
+    width_(0), height_(0),
+    format_(VIDL_PIXEL_FORMAT_UNKNOWN), out_format_(VIDL_PIXEL_FORMAT_UNKNOWN),
+    frame_rate_(0.0), duration_(0.0)
+{
+  open(source, num_buffers, format);
+}
+
+
+//: Destructor
+vidl_pipelined_istream::
+~vidl_pipelined_istream()
+{
+  close();
+  delete worker_;
+}
+
+
+//: Open a new stream reading ahead from \p source
+bool
+vidl_pipelined_istream::
+open(const vidl_istream_sptr& source, unsigned num_buffers,
+     vidl_pixel_format format)
+{
+  close();
+  if (!source || !source->is_open() || num_buffers < 2)
+    return false;
+
+  source_ = source;
+  num_buffers_ = num_buffers;
+  out_format_ = format;
+  frame_number_ = source->frame_number();
+  seekable_ = source->is_seekable();
+  num_frames_ = source->num_frames();
+  width_ = source->width();
+  height_ = source->height();
+  format_ = format != VIDL_PIXEL_FORMAT_UNKNOWN ? format : source->format();
+  frame_rate_ = source->frame_rate();
+  duration_ = source->duration();
+
+  worker_->frames.assign(num_buffers, vidl_frame_sptr());
+  worker_->frame_numbers.assign(num_buffers, 0);
+  current_ = -1;
+  head_ = 0;
+  num_ready_ = 0;
+  end_ = false;
+  start();
+  return true;
+}
+
+
+//: Close the stream (and the source stream)
+void
+vidl_pipelined_istream::
+close()
+{
+  if (!source_)
+    return;
+  stop();
+  worker_->frames.clear();
+  worker_->frame_numbers.clear();
+  num_buffers_ = 0;
+  source_->close();
+  source_ = VXL_NULLPTR;
+}
+
+
+//: Start reading ahead on the worker thread
+void
+vidl_pipelined_istream::
+start()
+{
+  worker_->stopping = false;
+  worker_->threaded = false;
+#if VXL_HAS_PTHREAD_H
+  worker_->threaded =
+      pthread_create(&worker_->thread, VXL_NULLPTR, &vidl_pipelined_istream::thread_main, this) == 0;
+#endif
+}
+
+
+//: Stop the worker thread and discard the frames read ahead
+void
+vidl_pipelined_istream::
+stop()
+{
+  worker_->lock();
+  worker_->stopping = true;
+  worker_->broadcast();
+  worker_->unlock();
+#if VXL_HAS_PTHREAD_H
+  if (worker_->threaded)
+    pthread_join(worker_->thread, VXL_NULLPTR);
+#endif
+  worker_->threaded = false;
+  release_current();
+  head_ = 0;
+  num_ready_ = 0;
+  end_ = false;
+}
+
+
+void*
+vidl_pipelined_istream::
+thread_main(void* self)
+{
+  static_cast<vidl_pipelined_istream*>(self)->work();
+  return VXL_NULLPTR;
+}
+
+
+//: The loop of the worker thread
+void
+vidl_pipelined_istream::
+work()
+{
+  worker_->lock();
+  while (!worker_->stopping)
+  {
+    unsigned slot = (head_ + num_ready_) % num_buffers_;
+    // the current buffer is in use until the caller advances
+    if (end_ || num_ready_ == num_buffers_ || current_ == int(slot)) {
+      worker_->wait();
+      continue;
+    }
+    worker_->unlock();
+    bool read = read_into(slot);
+    worker_->lock();
+    if (read)
+      ++num_ready_;
+    else
+      end_ = true;
+    worker_->broadcast();
+  }
+  worker_->unlock();
+}
+
+
+//: Read the next frame of the source into buffer \p slot
+bool
+vidl_pipelined_istream::
+read_into(unsigned slot)
+{
+  if (!source_->advance())
+    return false;
+  vidl_frame_sptr frame = source_->current_frame();
+  if (!frame || !fill(slot, frame))
+    return false;
+  worker_->frame_numbers[slot] = source_->frame_number();
+  return true;
+}
+
+
+//: Copy or convert \p frame into buffer \p slot
+bool
+vidl_pipelined_istream::
+fill(unsigned slot, const vidl_frame_sptr& frame)
+{
+  unsigned ni = frame->ni(), nj = frame->nj();
+  vidl_pixel_format fmt = out_format_ != VIDL_PIXEL_FORMAT_UNKNOWN ? out_format_
+                                                                   : frame->pixel_format();
+  vidl_frame_sptr& buffer = worker_->frames[slot];
+  if (!buffer || buffer->ni() != ni || buffer->nj() != nj || buffer->pixel_format() != fmt)
+  {
+    unsigned size = vidl_pixel_format_buffer_size(ni, nj, fmt);
+    vil_memory_chunk_sptr memory = new vil_memory_chunk(size, VIL_PIXEL_FORMAT_BYTE);
+    buffer = new vidl_memory_chunk_frame(ni, nj, fmt, memory);
+  }
+  if (!vidl_convert_frame(*frame, *buffer)) {
+    std::cerr << "vidl_pipelined_istream: can not convert " << frame->pixel_format()
+              << " to " << fmt << '\n';
+    return false;
+  }
+  return true;
+}
+
+
+//: Give up the current buffer, replacing it if the caller still uses it
+void
+vidl_pipelined_istream::
+release_current()
+{
+  if (current_ < 0)
+    return;
+  vidl_frame_sptr& buffer = worker_->frames[current_];
+  const vidl_memory_chunk_frame* cf = dynamic_cast<const vidl_memory_chunk_frame*>(buffer.ptr());
+  // the buffer is only referred to by the pool unless the caller kept the frame or a view
+  if (buffer && (buffer->ref_count() > 1 ||
+                 (cf && cf->memory_chunk() && cf->memory_chunk()->ref_count() > 1)))
+    buffer = VXL_NULLPTR;
+  current_ = -1;
+}
+
+
+//: Advance to the next frame (but don't acquire an image)
+bool
+vidl_pipelined_istream::
+advance()
+{
+  if (!source_)
+    return false;
+  worker_->lock();
+  release_current();
+  worker_->broadcast();
+  if (!worker_->threaded && num_ready_ == 0 && !end_) {
+    // no worker thread, read on this one
+    if (read_into(head_))
+      ++num_ready_;
+    else
+      end_ = true;
+  }
+  while (num_ready_ == 0 && !end_)
+    worker_->wait();
+  bool advanced = num_ready_ > 0;
+  if (advanced) {
+    current_ = head_;
+    head_ = (head_ + 1) % num_buffers_;
+    --num_ready_;
+    frame_number_ = worker_->frame_numbers[current_];
+    worker_->broadcast();
+  }
+  worker_->unlock();
+  return advanced;
+}
+
+
+//: Read the next frame from the stream (advance and acquire)
+vidl_frame_sptr
+vidl_pipelined_istream::
+read_frame()
+{
+  advance();
+  return current_frame();
+}
+
+
+//: Return the current frame in the stream
+vidl_frame_sptr
+vidl_pipelined_istream::
+current_frame()
+{
+  if (current_ < 0)
+    return VXL_NULLPTR;
+  return worker_->frames[current_];
+}
+
+
+//: Return the current frame wrapped in an image view
+vil_image_view_base_sptr
+vidl_pipelined_istream::
+current_view()
+{
+  if (current_ < 0)
+    return VXL_NULLPTR;
+  return vidl_convert_wrap_in_view(*worker_->frames[current_]);
+}
+
+
+//: Seek to the given frame number
+bool
+vidl_pipelined_istream::
+seek_frame(unsigned int frame_number)
+{
+  if (!source_ || !seekable_)
+    return false;
+  stop();
+  bool found = source_->seek_frame(frame_number);
+  if (found) {
+    // the sought frame becomes the current one, the worker reads on from there
+    vidl_frame_sptr frame = source_->current_frame();
+    found = frame && fill(0, frame);
+    if (found) {
+      current_ = 0;
+      head_ = 1;
+      frame_number_ = worker_->frame_numbers[0] = source_->frame_number();
+    }
+  }
+  start();
+  return found;
+}
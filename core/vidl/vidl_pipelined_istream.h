@@ -0,0 +1,169 @@
+// This is core/vidl/vidl_pipelined_istream.h
+#ifndef vidl_pipelined_istream_h_
+#define vidl_pipelined_istream_h_
+#ifdef VCL_NEEDS_PRAGMA_INTERFACE
+#pragma interface
+#endif
+//:
+// \file
+// \brief A video input stream that reads ahead of the caller on a worker thread
+//
+//  Decoding a frame of a vidl_ffmpeg_istream (or reading it from a camera
+//  or a list of images) happens on the thread that calls advance().  This
+//  stream wraps any other stream and runs it on a worker thread instead.
+//  The worker reads frames ahead of the caller into a bounded ring of
+//  pooled frame buffers, converting them to a requested pixel format on
+//  the way, so that advance() only waits when the caller is faster than
+//  the source.
+//
+//  The buffers are allocated once and reused.  The current frame and the
+//  view of it from current_view() refer to the pooled memory directly.
+//  If the caller still holds the frame or a view of it when the stream
+//  advances, that buffer is left to the caller and a new one is made for
+//  the pool, so frames and views taken from this stream stay valid.
+//
+//  The properties of the source (size, format, frame rate, ...) are read
+//  when the stream is opened.  Without pthreads the frames are read on the
+//  calling thread.
+//
+// \verbatim
+//  Modifications
+//   None
+// \endverbatim
+
+#include "vidl_istream.h"
+#include "vidl_istream_sptr.h"
+#include <vil/vil_image_view_base.h>
+#include <vcl_compiler.h>
+
+//: A video input stream that reads ahead of the caller on a worker thread
+class vidl_pipelined_istream
+  : public vidl_istream
+{
+ public:
+  //: Constructor - default
+  vidl_pipelined_istream();
+
+  //: Constructor - read ahead from \p source into \p num_buffers frame buffers
+  //  If \p format is not VIDL_PIXEL_FORMAT_UNKNOWN the frames are converted
+  //  to it on the worker thread.
+  vidl_pipelined_istream(const vidl_istream_sptr& source, unsigned num_buffers = 4,
+                         vidl_pixel_format format = VIDL_PIXEL_FORMAT_UNKNOWN);
+
+  //: Destructor
+  virtual ~vidl_pipelined_istream();
+
+  //: Open a new stream reading ahead from \p source
+  //  \p source should not be used by anything else while this stream is open.
+  //  \returns false if \p source is not open or \p num_buffers is less than 2
+  bool open(const vidl_istream_sptr& source, unsigned num_buffers = 4,
+            vidl_pixel_format format = VIDL_PIXEL_FORMAT_UNKNOWN);
+
+  //: Close the stream (and the source stream)
+  virtual void close();
+
+
+  //: Return true if the stream is open for reading
+  virtual bool is_open() const { return source_ && source_->is_open(); }
+
+  //: Return true if the stream is in a valid state
+  virtual bool is_valid() const { return current_ >= 0; }
+
+  //: Return true if the stream supports seeking
+  virtual bool is_seekable() const { return seekable_; }
+
+  //: Return the number of frames if known
+  //  returns -1 for non-seekable streams
+  virtual int num_frames() const { return num_frames_; }
+
+  //: Return the current frame number
+  virtual unsigned int frame_number() const { return frame_number_; }
+
+  //: Return the width of each frame
+  virtual unsigned int width() const { return width_; }
+
+  //: Return the height of each frame
+  virtual unsigned int height() const { return height_; }
+
+  //: Return the pixel format
+  virtual vidl_pixel_format format() const { return format_; }
+
+  //: Return the frame rate (FPS, 0.0 if unspecified)
+  virtual double frame_rate() const { return frame_rate_; }
+
+  //: Return the duration in seconds (0.0 if unknown)
+  virtual double duration() const { return duration_; }
+
+  //: Advance to the next frame (but don't acquire an image)
+  //  Waits for the worker if the next frame has not been read yet.
+  virtual bool advance();
+
+  //: Read the next frame from the stream (advance and acquire)
+  virtual vidl_frame_sptr read_frame();
+
+  //: Return the current frame in the stream
+  //  The frame refers to the pooled buffer, it is not a copy.
+  virtual vidl_frame_sptr current_frame();
+
+  //: Seek to the given frame number
+  //  Frames read ahead are discarded.
+  // \returns true if successful
+  virtual bool seek_frame(unsigned int frame_number);
+
+  //: Return the current frame wrapped in an image view
+  //  The view shares the pooled buffer.  Returns a null pointer if the
+  //  pixel format can not be wrapped (see vidl_convert_wrap_in_view);
+  //  choose a format such as RGB_24P or MONO_8 when opening the stream.
+  vil_image_view_base_sptr current_view();
+
+  //: Return the stream the frames are read from
+  vidl_istream_sptr source() const { return source_; }
+
+  //: Return the number of pooled frame buffers
+  unsigned num_buffers() const { return num_buffers_; }
+
+ private:
+  struct worker;
+
+  //: Start reading ahead on the worker thread
+  void start();
+  //: Stop the worker thread and discard the frames read ahead
+  void stop();
+  //: The loop of the worker thread
+  void work();
+  static void* thread_main(void* self);
+  //: Read the next frame of the source into buffer \p slot
+  //  Returns false at the end of the source.
+  bool read_into(unsigned slot);
+  //: Copy or convert \p frame into buffer \p slot
+  bool fill(unsigned slot, const vidl_frame_sptr& frame);
+  //: Give up the current buffer, replacing it if the caller still uses it
+  void release_current();
+
+  //: The stream being read ahead
+  vidl_istream_sptr source_;
+  worker* worker_;
+
+  unsigned num_buffers_;
+  //: The buffer of the current frame, -1 if not valid
+  int current_;
+  //: The buffer of the next frame read ahead
+  unsigned head_;
+  //: The number of frames read ahead
+  unsigned num_ready_;
+  //: true once the source has no more frames
+  bool end_;
+
+  unsigned int frame_number_;
+  bool seekable_;
+  int num_frames_;
+  unsigned int width_;
+  unsigned int height_;
+  vidl_pixel_format format_;
+  //: The format the frames are converted to, UNKNOWN to keep the source format
+  vidl_pixel_format out_format_;
+  double frame_rate_;
+  double duration_;
+};
+
+#endif // vidl_pipelined_istream_h_
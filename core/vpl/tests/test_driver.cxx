@@ -2,11 +2,13 @@
 #include <testlib/testlib_register.h>
 
 DECLARE( test_unistd );
+DECLARE( test_parallel_for );
 
 void
 register_tests()
 {
   REGISTER( test_unistd );
+  REGISTER( test_parallel_for );
 }
 
 DEFINE_MAIN;
@@ -2,6 +2,7 @@
 #include <vpl/vpl.h>
 #include <vpl/vpl_fdopen.h>
 #include <vpl/vpl_fileno.h>
+#include <vpl/vpl_parallel_for.h>
 
 #include <vxl_config.h>
 #if VXL_HAS_PTHREAD_H
@@ -0,0 +1,56 @@
+// This is core/vpl/tests/test_parallel_for.cxx
+#include <vector>
+#include <vcl_compiler.h>
+
+#include <testlib/testlib_test.h>
+
+#include <vpl/vpl_parallel_for.h>
+
+namespace
+{
+  struct square_body : public vpl_parallel_for_body
+  {
+    std::vector<unsigned> out;
+    std::vector<unsigned> visits;
+    std::vector<double> partial;
+    void execute(unsigned begin, unsigned end, unsigned thread_id)
+    {
+      for (unsigned i = begin; i < end; ++i) {
+        out[i] = i*i;
+        ++visits[i];
+        partial[thread_id] += double(i);
+      }
+    }
+  };
+
+  bool run_square(unsigned n, unsigned nthreads, unsigned grain)
+  {
+    square_body body;
+    body.out.assign(n, 0u);
+    body.visits.assign(n, 0u);
+    body.partial.assign(vpl_parallel_for_num_threads(nthreads), 0.0);
+    vpl_parallel_for(n, body, nthreads, grain);
+    double sum = 0.0;
+    for (unsigned t = 0; t < body.partial.size(); ++t)
+      sum += body.partial[t];
+    bool ok = sum == 0.5*double(n)*double(n==0 ? 0 : n-1);
+    for (unsigned i = 0; i < n; ++i)
+      ok = ok && body.out[i] == i*i && body.visits[i] == 1;
+    return ok;
+  }
+}
+
+static void test_parallel_for()
+{
+  TEST("hardware concurrency", vpl_hardware_concurrency() >= 1, true);
+  TEST("team size of 0 is hardware concurrency or 1",
+       vpl_parallel_for_num_threads(0) >= 1, true);
+  TEST("empty range", run_square(0, 4, 1), true);
+  TEST("serial", run_square(1000, 1, 7), true);
+  TEST("four threads, grain 1", run_square(1000, 4, 1), true);
+  TEST("four threads, grain 64", run_square(1000, 4, 64), true);
+  TEST("more threads than chunks", run_square(5, 16, 2), true);
+  TEST("grain 0 treated as 1", run_square(37, 3, 0), true);
+}
+
+TESTMAIN(test_parallel_for);
@@ -0,0 +1,128 @@
+// This is core/vpl/vpl_parallel_for.cxx
+#include <vector>
+#include "vpl_parallel_for.h"
+#include <vxl_config.h>
+
+#if defined(VCL_WIN32) && !defined(__CYGWIN__)
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
+
+#if VXL_HAS_PTHREAD_H
+# include <pthread.h>
+#endif
+
+unsigned vpl_hardware_concurrency()
+{
+#if defined(VCL_WIN32) && !defined(__CYGWIN__)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? unsigned(info.dwNumberOfProcessors) : 1u;
+#elif defined(_SC_NPROCESSORS_ONLN)
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? unsigned(n) : 1u;
+#else
+  return 1u;
+#endif
+}
+
+unsigned vpl_parallel_for_num_threads(unsigned num_threads)
+{
+#if VXL_HAS_PTHREAD_H
+  return num_threads == 0 ? vpl_hardware_concurrency() : num_threads;
+#else
+  (void)num_threads;
+  return 1u;
+#endif
+}
+
+#if VXL_HAS_PTHREAD_H
+namespace
+{
+  //: State shared by the team executing one vpl_parallel_for() call.
+  struct vpl_parallel_for_team
+  {
+    vpl_parallel_for_body* body;
+    unsigned n;
+    unsigned grain;
+    unsigned next;   // first index not yet handed out, protected by mutex
+    pthread_mutex_t mutex;
+  };
+
+  struct vpl_parallel_for_worker
+  {
+    vpl_parallel_for_team* team;
+    unsigned thread_id;
+  };
+
+  void vpl_parallel_for_run(vpl_parallel_for_team& team, unsigned thread_id)
+  {
+    for (;;)
+    {
+      pthread_mutex_lock(&team.mutex);
+      unsigned begin = team.next;
+      unsigned end = (team.n - begin > team.grain) ? begin + team.grain : team.n;
+      team.next = end;
+      pthread_mutex_unlock(&team.mutex);
+      if (begin >= end)
+        return;
+      team.body->execute(begin, end, thread_id);
+    }
+  }
+
+  extern "C" void* vpl_parallel_for_launcher(void* arg)
+  {
+    vpl_parallel_for_worker* w = static_cast<vpl_parallel_for_worker*>(arg);
+    vpl_parallel_for_run(*w->team, w->thread_id);
+    return VXL_NULLPTR;
+  }
+}
+#endif // VXL_HAS_PTHREAD_H
+
+void vpl_parallel_for(unsigned n, vpl_parallel_for_body& body,
+                      unsigned num_threads, unsigned grain)
+{
+  if (n == 0)
+    return;
+  if (grain == 0)
+    grain = 1;
+  unsigned nchunks = (n + grain - 1) / grain;
+  unsigned nthreads = vpl_parallel_for_num_threads(num_threads);
+  if (nthreads > nchunks)
+    nthreads = nchunks;
+
+#if VXL_HAS_PTHREAD_H
+  if (nthreads > 1)
+  {
+    vpl_parallel_for_team team;
+    team.body = &body;
+    team.n = n;
+    team.grain = grain;
+    team.next = 0;
+    pthread_mutex_init(&team.mutex, VXL_NULLPTR);
+
+    std::vector<vpl_parallel_for_worker> workers(nthreads);
+    std::vector<pthread_t> threads(nthreads);
+    std::vector<bool> started(nthreads, false);
+    for (unsigned t = 1; t < nthreads; ++t)
+    {
+      workers[t].team = &team;
+      workers[t].thread_id = t;
+      started[t] = pthread_create(&threads[t], VXL_NULLPTR,
+                                  vpl_parallel_for_launcher, &workers[t]) == 0;
+    }
+    // the calling thread is worker 0; chunks not taken by a thread that
+    // failed to start are simply picked up by the others
+    vpl_parallel_for_run(team, 0);
+    for (unsigned t = 1; t < nthreads; ++t)
+      if (started[t])
+        pthread_join(threads[t], VXL_NULLPTR);
+    pthread_mutex_destroy(&team.mutex);
+    return;
+  }
+#endif // VXL_HAS_PTHREAD_H
+
+  for (unsigned begin = 0; begin < n; begin += grain)
+    body.execute(begin, (n - begin > grain) ? begin + grain : n, 0);
+}
@@ -0,0 +1,55 @@
+// This is core/vpl/vpl_parallel_for.h
+#ifndef vpl_parallel_for_h_
+#define vpl_parallel_for_h_
+//:
+// \file
+// \brief Minimal fork/join loop parallelism on top of POSIX threads.
+//
+// A loop over the index range [0,n) is cut into chunks of \a grain indices
+// which are handed out on demand to a small team of worker threads.  The
+// calling thread takes part in the work as worker 0, so a team of size one
+// runs the body inline with no thread creation at all.  When the platform
+// has no pthreads the loop always runs inline.
+//
+// The worker index passed to the body lies in [0,num_threads) and is meant
+// for indexing per-thread scratch space (partial sums, buffers etc.), e.g.
+// \code
+//   struct sum_body : public vpl_parallel_for_body
+//   {
+//     std::vector<double> partial; float const* data;
+//     void execute(unsigned begin, unsigned end, unsigned tid)
+//     { for (unsigned i=begin; i<end; ++i) partial[tid] += data[i]; }
+//   };
+//   sum_body body; body.data = v; body.partial.resize(vpl_parallel_for_num_threads(0), 0.0);
+//   vpl_parallel_for(n, body);
+// \endcode
+
+#include "vcl_compiler.h"
+#include "vpl/vpl_export.h"
+
+//: Body of a loop executed by vpl_parallel_for().
+class VPL_EXPORT vpl_parallel_for_body
+{
+ public:
+  virtual ~vpl_parallel_for_body() {}
+
+  //: Process the indices [begin,end) on worker \a thread_id.
+  //  Different chunks may be executed concurrently, so the body must not
+  //  write to shared state other than through \a thread_id or disjoint indices.
+  virtual void execute(unsigned begin, unsigned end, unsigned thread_id) = 0;
+};
+
+//: Number of processors available to this process (at least 1).
+extern VPL_EXPORT unsigned vpl_hardware_concurrency();
+
+//: Size of the team that vpl_parallel_for(n,body,num_threads) will use.
+//  A value of 0 for \a num_threads means vpl_hardware_concurrency().
+extern VPL_EXPORT unsigned vpl_parallel_for_num_threads(unsigned num_threads);
+
+//: Execute \a body over [0,n) in chunks of \a grain indices on up to \a num_threads threads.
+//  Returns when all chunks have been processed.
+//  A value of 0 for \a num_threads means vpl_hardware_concurrency().
+extern VPL_EXPORT void vpl_parallel_for(unsigned n, vpl_parallel_for_body& body,
+                                        unsigned num_threads = 0, unsigned grain = 1);
+
+#endif // vpl_parallel_for_h_